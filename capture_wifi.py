@@ -21,7 +21,9 @@ API Endpoints:
     GET /          - Status page
     GET /capture   - Capture and download image
     GET /status    - Get camera status JSON
+    GET /events    - Live status changes as Server-Sent Events (--watch)
     GET /control   - Apply camera settings
+    UDP 5006       - Still transfer with FEC for lossy links (--udp)
 """
 
 import sys
@@ -30,6 +32,8 @@ from datetime import datetime
 import json
 import time
 import socket
+import struct
+import random
 import argparse
 
 try:
@@ -76,29 +80,111 @@ def log(message, prefix="*"):
     """Print message with timestamp"""
     print(f"{get_timestamp()} [{prefix}] {message}")
 
+def parse_camera_txt(info):
+    """
+    Build an inventory entry from a camera's mDNS TXT records.
+    
+    Args:
+        info: zeroconf ServiceInfo of an _http._tcp service
+    
+    Returns:
+        Dictionary with host, ip, firmware, endpoints, profile and counters,
+        or None if the service is not a GrowPod camera
+    """
+    props = {k.decode(): (v.decode() if v is not None else '')
+             for k, v in (info.properties or {}).items()}
+    if props.get('txtvers') != '1' or 'fw' not in props:
+        return None
+    try:
+        return {
+            'host': info.server.rstrip('.'),
+            'ip': socket.inet_ntoa(info.addresses[0]) if info.addresses else None,
+            'port': info.port,
+            'firmware': props['fw'],
+            'endpoints': props.get('api', '').split(','),
+            'stream_port': int(props.get('sport', info.port)),
+            'udp_port': int(props['uport']) if 'uport' in props else None,
+            'framesize': props.get('fs'),
+            'quality': int(props.get('q', -1)),
+            'mode': props.get('mode'),
+            'captures': int(props.get('cap', 0)),
+        }
+    except ValueError:
+        # Not one of ours after all; raising would end the browser's thread
+        return None
+
 class CameraServiceListener(ServiceListener):
-    """Listener for mDNS camera service discovery"""
-    def __init__(self, hostname):
+    """
+    Listener for mDNS camera service discovery.
+    
+    Resolves one hostname, and keeps an inventory of every camera seen
+    (by service name) from the TXT records the cameras publish, which
+    update on profile changes and captures without polling /status.
+    """
+    def __init__(self, hostname=None):
         self.hostname = hostname
         self.ip_address = None
         self.found = False
+        self.inventory = {}
     
-    def add_service(self, zc, type_, name):
+    def _update(self, zc, type_, name):
         info = zc.get_service_info(type_, name)
-        if info:
-            # Check if this is our camera
-            server = info.server.rstrip('.')
-            if server == self.hostname or server == f"{self.hostname}.local":
-                if info.addresses:
-                    self.ip_address = socket.inet_ntoa(info.addresses[0])
-                    self.found = True
-                    log(f"Found {self.hostname} at {self.ip_address}", "+")
+        if not info:
+            return
+        camera = parse_camera_txt(info)
+        if camera:
+            self.inventory[name] = camera
+        
+        # Check if this is our camera
+        server = info.server.rstrip('.')
+        if self.hostname and (server == self.hostname or server == f"{self.hostname}.local"):
+            if info.addresses and not self.found:
+                self.ip_address = socket.inet_ntoa(info.addresses[0])
+                self.found = True
+                log(f"Found {self.hostname} at {self.ip_address}", "+")
+    
+    def add_service(self, zc, type_, name):
+        self._update(zc, type_, name)
     
     def remove_service(self, zc, type_, name):
-        pass
+        self.inventory.pop(name, None)
     
     def update_service(self, zc, type_, name):
-        pass
+        self._update(zc, type_, name)
+
+def discover_fleet(timeout=3.0):
+    """
+    List all cameras on the network from mDNS alone.
+    
+    Args:
+        timeout: How long to browse in seconds
+    
+    Returns:
+        List of inventory entries (see parse_camera_txt), sorted by host
+    """
+    if not ZEROCONF_AVAILABLE:
+        log("Fleet discovery needs the 'zeroconf' library", "!")
+        return []
+    
+    zeroconf = Zeroconf()
+    listener = CameraServiceListener()
+    browser = ServiceBrowser(zeroconf, "_http._tcp.local.", listener)
+    time.sleep(timeout)
+    browser.cancel()
+    zeroconf.close()
+    return sorted(listener.inventory.values(), key=lambda c: c['host'])
+
+def print_fleet(cameras):
+    """Print a fleet inventory table"""
+    if not cameras:
+        log("No cameras found", "!")
+        return
+    print(f"\n{'Host':28} {'IP':15} {'Firmware':16} {'Profile':11} {'Mode':7} {'Captures':>8}")
+    for c in cameras:
+        profile = f"{c['framesize']} q{c['quality']}"
+        print(f"{c['host']:28} {c['ip'] or '-':15} {c['firmware']:16} {profile:11} "
+              f"{c['mode']:7} {c['captures']:8}")
+    print()
 
 def resolve_mdns_fast(hostname, timeout=3.0):
     """
@@ -192,6 +278,263 @@ def capture_image(esp32_host, output_file=None):
         log(f"Error: {e}", "!")
         return False
 
+# UDP still transfer (see main/net/udp_still.h for the protocol)
+UDP_STILL_PORT = 5006
+UDP_BLOCK_SIZE = 1200
+UDP_GROUP_BLOCKS = 32
+UDP_REQ, UDP_DATA, UDP_END, UDP_NACK, UDP_DONE, UDP_ERR, UDP_COOKIE = range(1, 8)
+UDP_COOKIE_SIZE = 8
+UDP_ERRORS = {1: "camera busy with another transfer", 2: "capture failed", 3: "transfer timed out",
+              4: "rate limited, try again later"}
+UDP_DELAY_SAMPLES = 8       # Datagrams whose minimum delay starts/ends a pass
+
+class UdpPassReport:
+    """Arrival rate and one-way delay growth of one pass, for the camera's pacing"""
+
+    def __init__(self):
+        self.received = 0
+        self.first = self.last = None
+        self.bytes = 0
+        self.base = None
+        self.head = []
+        self.tail = []
+
+    def add(self, size, send_us):
+        now = time.monotonic()
+        self.received += 1
+        if self.first is None:
+            self.first = now
+        else:
+            self.bytes += size
+        self.last = now
+        # One-way delay relative to the first datagram; the clocks differ
+        raw = (int(now * 1e6) - send_us) & 0xffffffff
+        if self.base is None:
+            self.base = raw
+        delay = ((raw - self.base + (1 << 31)) & 0xffffffff) - (1 << 31)
+        if len(self.head) < UDP_DELAY_SAMPLES:
+            self.head.append(delay)
+        self.tail = self.tail[1 - UDP_DELAY_SAMPLES:] + [delay]
+
+    def pack(self):
+        rx_kbps = 0
+        queue_ms = 0
+        if self.received >= 4 * UDP_DELAY_SAMPLES and self.last > self.first:
+            rx_kbps = int(self.bytes * 8 / (self.last - self.first) / 1000)
+            queue_ms = max(0, min(self.tail) - min(self.head)) // 1000
+        return struct.pack('>IIH', self.received, rx_kbps, min(queue_ms, 0xffff))
+
+# GF(2^8) tables for the Reed-Solomon decoder, polynomial 0x11d as in fec_rs.c
+GF_EXP = [0] * 510
+GF_LOG = [0] * 256
+_x = 1
+for _i in range(255):
+    GF_EXP[_i] = GF_EXP[_i + 255] = _x
+    GF_LOG[_x] = _i
+    _x <<= 1
+    if _x & 0x100:
+        _x ^= 0x11d
+GF_MUL_TABLES = {}
+
+def gf_mul(a, b):
+    if a == 0 or b == 0:
+        return 0
+    return GF_EXP[GF_LOG[a] + GF_LOG[b]]
+
+def gf_inv(a):
+    return GF_EXP[255 - GF_LOG[a]]
+
+def gf_scale(block, c):
+    """Multiply every byte of a block by c, as an int for cheap XORs"""
+    table = GF_MUL_TABLES.get(c)
+    if table is None:
+        table = GF_MUL_TABLES[c] = bytes(gf_mul(c, v) for v in range(256))
+    return int.from_bytes(block.translate(table), 'big')
+
+def rs_decode(k, blocks):
+    """
+    Recover a group's k data blocks from any k received blocks.
+
+    Args:
+        k: Data blocks in the group
+        blocks: Dict index -> UDP_BLOCK_SIZE bytes (index >= k is parity row index - k)
+
+    Returns:
+        List of k data blocks
+    """
+    data = [blocks.get(i) for i in range(k)]
+    missing = [i for i in range(k) if data[i] is None]
+    if not missing:
+        return data
+    rows = [i - k for i in blocks if i >= k][:len(missing)]
+
+    # Parity row r is sum of data[i] / ((k + r) ^ i): move the known blocks to
+    # the left side, then solve for the missing ones
+    rhs = []
+    for r in rows:
+        acc = int.from_bytes(blocks[k + r], 'big')
+        for i in range(k):
+            if data[i] is not None:
+                acc ^= gf_scale(data[i], gf_inv((k + r) ^ i))
+        rhs.append(acc.to_bytes(UDP_BLOCK_SIZE, 'big'))
+
+    # Invert the square Cauchy submatrix (Gauss-Jordan)
+    n = len(missing)
+    m = [[gf_inv((k + r) ^ i) for i in missing] + [1 if j == row else 0 for j in range(n)]
+         for row, r in enumerate(rows)]
+    for col in range(n):
+        pivot = next(row for row in range(col, n) if m[row][col])
+        m[col], m[pivot] = m[pivot], m[col]
+        inv = gf_inv(m[col][col])
+        m[col] = [gf_mul(v, inv) for v in m[col]]
+        for row in range(n):
+            if row != col and m[row][col]:
+                f = m[row][col]
+                m[row] = [v ^ gf_mul(f, p) for v, p in zip(m[row], m[col])]
+
+    for j, i in enumerate(missing):
+        acc = 0
+        for row in range(n):
+            c = m[j][n + row]
+            if c:
+                acc ^= gf_scale(rhs[row], c)
+        data[i] = acc.to_bytes(UDP_BLOCK_SIZE, 'big')
+    return data
+
+def capture_image_udp(esp32_host, output_file=None, rate_kbps=0, fec_percent=10, last=False,
+                      timeout=20.0):
+    """
+    Capture an image over the UDP still transfer protocol.
+
+    Faster than /capture on lossy links: parity blocks repair most losses
+    without a round trip, and whatever is left is requested per group.
+
+    Args:
+        esp32_host: IP address of the ESP32
+        output_file: Optional filename for saved image (auto-generated if None)
+        rate_kbps: Initial send rate (0 = camera default)
+        fec_percent: Parity blocks per group, percent of data blocks
+        last: Send the last capture instead of taking a new one
+        timeout: Give up after this many seconds
+
+    Returns:
+        True if successful, False otherwise
+    """
+    transfer_id = random.getrandbits(32)
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    sock.setsockopt(socket.SOL_SOCKET, socket.SO_RCVBUF, 1 << 20)
+    sock.settimeout(0.25)
+    addr = (socket.gethostbyname(esp32_host), UDP_STILL_PORT)
+    request = struct.pack('>2sBBIIBB', b'GP', UDP_REQ, 0, transfer_id, rate_kbps, fec_percent,
+                          1 if last else 0)
+    cookie = bytes(UDP_COOKIE_SIZE)         # Until the camera sends one
+
+    log(f"Requesting image over UDP from {addr[0]}:{UDP_STILL_PORT}...")
+    request_start = time.time()
+    sock.sendto(request + cookie, addr)
+
+    total_len = None
+    groups = {}                 # group -> {index: block}
+    solved = {}                 # group -> data bytes
+    report = UdpPassReport()    # Current pass
+    datagrams = 0
+    passes = 0
+    last_nack = None            # (pass, datagram) to repeat for duplicate ENDs
+    result = None
+
+    try:
+        while time.time() - request_start < timeout:
+            try:
+                msg, peer = sock.recvfrom(2048)
+            except socket.timeout:
+                if total_len is None and last_nack is None:
+                    sock.sendto(request + cookie, addr)     # REQ lost or capture slow
+                continue
+            if len(msg) < 8 or msg[:2] != b'GP' or peer[0] != addr[0]:
+                continue
+            msg_type = msg[2]
+            if struct.unpack_from('>I', msg, 4)[0] != transfer_id:
+                continue
+
+            if msg_type == UDP_ERR:
+                log(f"Error: {UDP_ERRORS.get(msg[8], 'unknown error')}", "!")
+                return False
+
+            # The camera answers a first REQ with a cookie proving our address
+            if msg_type == UDP_COOKIE and total_len is None:
+                if len(msg) >= 8 + UDP_COOKIE_SIZE and msg[8:8 + UDP_COOKIE_SIZE] != cookie:
+                    cookie = msg[8:8 + UDP_COOKIE_SIZE]
+                    sock.sendto(request + cookie, addr)
+                continue
+
+            if msg_type == UDP_DATA and result is None:
+                total_len, group, index, k, send_us = struct.unpack_from('>IHBBI', msg, 8)
+                report.add(len(msg), send_us)
+                datagrams += 1
+                if group in solved:
+                    continue
+                block = msg[20:].ljust(UDP_BLOCK_SIZE, b'\0')
+                blocks = groups.setdefault(group, {})
+                blocks[index] = block
+                if len(blocks) < k:
+                    continue
+                solved[group] = b''.join(rs_decode(k, blocks))
+                del groups[group]
+                data_blocks = (total_len + UDP_BLOCK_SIZE - 1) // UDP_BLOCK_SIZE
+                if len(solved) == (data_blocks + UDP_GROUP_BLOCKS - 1) // UDP_GROUP_BLOCKS:
+                    result = b''.join(solved[g] for g in sorted(solved))[:total_len]
+                    done = struct.pack('>2sBBII', b'GP', UDP_DONE, 0, transfer_id, passes) + report.pack()
+                    sock.sendto(done, addr)
+                    break
+
+            elif msg_type == UDP_END and result is None:
+                end_pass, _ = struct.unpack_from('>II', msg, 8)
+                if last_nack and last_nack[0] == end_pass:
+                    sock.sendto(last_nack[1], addr)     # Our NACK was lost
+                    continue
+                needs = []
+                if total_len is not None:
+                    data_blocks = (total_len + UDP_BLOCK_SIZE - 1) // UDP_BLOCK_SIZE
+                    for g in range((data_blocks + UDP_GROUP_BLOCKS - 1) // UDP_GROUP_BLOCKS):
+                        if g not in solved:
+                            k = min(UDP_GROUP_BLOCKS, data_blocks - g * UDP_GROUP_BLOCKS)
+                            needs.append((g, k - len(groups.get(g, {}))))
+                nack = struct.pack('>2sBBII', b'GP', UDP_NACK, 0, transfer_id, end_pass)
+                nack += report.pack() + struct.pack('>H', len(needs))
+                nack += b''.join(struct.pack('>HB', g, n) for g, n in needs)
+                sock.sendto(nack, addr)
+                last_nack = (end_pass, nack)
+                passes = end_pass + 1
+                report = UdpPassReport()
+
+        if result is None:
+            log("Error: UDP transfer timed out", "!")
+            return False
+        request_time = (time.time() - request_start) * 1000
+
+        # Answer the ENDs of a camera that missed our DONE
+        sock.settimeout(0.3)
+        try:
+            while True:
+                msg, _ = sock.recvfrom(2048)
+                if len(msg) >= 8 and msg[2] == UDP_END:
+                    sock.sendto(done, addr)
+        except socket.timeout:
+            pass
+    finally:
+        sock.close()
+
+    if output_file is None:
+        timestamp = datetime.now().strftime("%Y%m%d_%H%M%S")
+        output_file = f"capture_{timestamp}.jpg"
+    with open(output_file, 'wb') as f:
+        f.write(result)
+
+    log(f"Image saved: {output_file}", "+")
+    log(f"Size: {len(result):,} bytes, Total time: {request_time:.0f} ms "
+        f"({datagrams} datagrams, {passes + 1} pass(es))", "+")
+    return True
+
 def get_status(esp32_host):
     """
     Get camera status from ESP32.
@@ -217,6 +560,62 @@ def get_status(esp32_host):
         log(f"Error getting status: {e}", "!")
         return None
 
+def parse_sse(lines):
+    """
+    Split a Server-Sent Events stream into events.
+    
+    Args:
+        lines: Iterable of decoded lines without line endings
+    
+    Yields:
+        (event name, data string) for every event; comments and retry
+        fields are skipped
+    """
+    event, data = 'message', []
+    for line in lines:
+        if not line:
+            if data:
+                yield event, '\n'.join(data)
+            event, data = 'message', []
+        elif line.startswith(':'):
+            continue
+        else:
+            field, _, value = line.partition(':')
+            value = value[1:] if value.startswith(' ') else value
+            if field == 'event':
+                event = value
+            elif field == 'data':
+                data.append(value)
+
+def watch_events(esp32_host):
+    """
+    Print the camera's live status changes from /events until interrupted.
+    
+    The camera sends its full state on connect and then only what changed,
+    so nothing is polled. Reconnects after a lost connection.
+    
+    Args:
+        esp32_host: IP address or hostname of the ESP32
+    """
+    url = f"http://{esp32_host}/events"
+    while True:
+        try:
+            # The read timeout only has to outlast the keep-alive comments
+            with requests.get(url, stream=True, timeout=(5, 30)) as response:
+                if response.status_code != 200:
+                    log(f"Error: Server returned status code {response.status_code}", "!")
+                    return False
+                log(f"Watching {url} (Ctrl+C to stop)", "+")
+                for event, data in parse_sse(response.iter_lines(decode_unicode=True)):
+                    fields = json.loads(data)
+                    text = ' '.join(f"{k}={v}" for k, v in fields.items())
+                    log(f"{event:8} {text}", "+" if event == 'state' else "*")
+        except KeyboardInterrupt:
+            return True
+        except Exception as e:
+            log(f"Event stream lost ({e}), reconnecting...", "!")
+            time.sleep(2)
+
 def apply_camera_settings(esp32_host, aec=None, aec_value=None, ae_level=None, 
                           gain_ctrl=None, agc_gain=None, quality=None, framesize=None,
                           brightness=None, contrast=None, saturation=None, sharpness=None):
@@ -610,9 +1009,18 @@ Examples:
   
   # Single capture with filename
   python capture_wifi.py 192.168.1.100 my_photo.jpg --exposure-comp -1
+  
+  # List every camera on the network from mDNS alone
+  python capture_wifi.py --fleet
+  
+  # Follow parameter changes, captures, motion and health live
+  python capture_wifi.py 192.168.1.100 --watch
+  
+  # Single capture over UDP with FEC (lossy links)
+  python capture_wifi.py 192.168.1.100 my_photo.jpg --udp
         """)
     
-    parser.add_argument('host', help='ESP32 IP address or hostname')
+    parser.add_argument('host', nargs='?', help='ESP32 IP address or hostname')
     parser.add_argument('output', nargs='?', help='Output filename (optional, for single capture)')
     
     # Camera settings
@@ -625,9 +1033,24 @@ Examples:
     parser.add_argument('--resolution', type=str, metavar='NAME', 
                         choices=list(RESOLUTIONS.keys()),
                         help='Resolution (qxga, uxga, sxga, xga, svga, vga, hvga, cif, qvga)')
+    parser.add_argument('--udp', action='store_true',
+                        help='Transfer the capture over UDP with FEC instead of HTTP')
+    parser.add_argument('--udp-rate', type=int, metavar='KBPS', default=0,
+                        help='Initial UDP send rate in kbit/s (default: camera default)')
+    
+    parser.add_argument('--watch', action='store_true',
+                        help='Print live status changes from /events until Ctrl+C')
+    parser.add_argument('--fleet', action='store_true',
+                        help='List all cameras on the network (mDNS only) and exit')
     
     args = parser.parse_args()
     
+    if args.fleet:
+        print_fleet(discover_fleet())
+        return 0
+    if args.host is None:
+        parser.error('host is required unless --fleet is given')
+    
     esp32_host = args.host
     
     # Strip http:// or https:// prefix if provided
@@ -693,9 +1116,15 @@ Examples:
     if settings_changed:
         time.sleep(0.5)
     
+    if args.watch:
+        return 0 if watch_events(esp32_host) else 1
+    
     # Check if output file is specified (single capture mode)
     if args.output:
-        success = capture_image(esp32_host, args.output)
+        if args.udp:
+            success = capture_image_udp(esp32_host, args.output, rate_kbps=args.udp_rate)
+        else:
+            success = capture_image(esp32_host, args.output)
         return 0 if success else 1
     else:
         # Interactive mode
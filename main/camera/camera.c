@@ -27,7 +27,26 @@ static const char *TAG = "camera";
 #define CAMERA_PIN_HREF    47
 #define CAMERA_PIN_PCLK    13
 
-esp_err_t camera_init(void)
+void camera_profile_default(camera_profile_t *profile)
+{
+    *profile = (camera_profile_t){
+        .pixel_format = PIXFORMAT_JPEG,     // JPEG format for easy transmission
+        .frame_size = FRAMESIZE_QXGA,       // 2048x1536 - Maximum quality for OV3660!
+                                             // For faster capture, try: FRAMESIZE_UXGA (1600x1200)
+                                             // or FRAMESIZE_SXGA (1280x1024)
+        .jpeg_quality = 4,                  // 0-63, lower means higher quality (4 = excellent)
+                                             // For smaller/faster files, try: 8-12
+        .fb_count = 1,                      // Single frame buffer for immediate fresh frames
+        .fb_location = CAMERA_FB_IN_PSRAM,  // Explicitly use PSRAM
+        .grab_mode = CAMERA_GRAB_LATEST,    // Always grab latest frame
+        .xclk_hz = CAMERA_XCLK_DEFAULT_HZ   // 20MHz XCLK
+    };
+}
+
+/**
+ * @brief Start the driver with the board pins and the given profile
+ */
+static esp_err_t camera_start(const camera_profile_t *profile)
 {
     camera_config_t config = {
         .pin_pwdn = CAMERA_PIN_PWDN,
@@ -48,25 +67,33 @@ esp_err_t camera_init(void)
         .pin_href = CAMERA_PIN_HREF,
         .pin_pclk = CAMERA_PIN_PCLK,
 
-        .xclk_freq_hz = 20000000,           // 20MHz XCLK
+        .xclk_freq_hz = profile->xclk_hz,
         .ledc_timer = LEDC_TIMER_0,
         .ledc_channel = LEDC_CHANNEL_0,
 
-        .pixel_format = PIXFORMAT_JPEG,     // JPEG format for easy transmission
-        .frame_size = FRAMESIZE_QXGA,       // 2048x1536 - Maximum quality for OV3660!
-                                             // For faster capture, try: FRAMESIZE_UXGA (1600x1200)
-                                             // or FRAMESIZE_SXGA (1280x1024)
-        .jpeg_quality = 4,                  // 0-63, lower means higher quality (4 = excellent)
-                                             // For smaller/faster files, try: 8-12
-        .fb_count = 1,                      // Single frame buffer for immediate fresh frames
-        .fb_location = CAMERA_FB_IN_PSRAM,  // Explicitly use PSRAM
-        .grab_mode = CAMERA_GRAB_LATEST     // Always grab latest frame
+        .pixel_format = profile->pixel_format,
+        .frame_size = profile->frame_size,
+        .jpeg_quality = profile->jpeg_quality,
+        .fb_count = profile->fb_count,
+        .fb_location = profile->fb_location,
+        .grab_mode = profile->grab_mode
     };
 
-    // Initialize the camera
     esp_err_t err = esp_camera_init(&config);
     if (err != ESP_OK) {
         ESP_LOGE(TAG, "Camera init failed with error 0x%x", err);
+    }
+    return err;
+}
+
+esp_err_t camera_init(void)
+{
+    camera_profile_t profile;
+    camera_profile_default(&profile);
+
+    // Initialize the camera
+    esp_err_t err = camera_start(&profile);
+    if (err != ESP_OK) {
         return err;
     }
 
@@ -85,6 +112,34 @@ esp_err_t camera_init(void)
     return ESP_OK;
 }
 
+esp_err_t camera_reconfigure(const camera_profile_t *profile)
+{
+    esp_err_t err = esp_camera_deinit();
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Camera deinit failed with error 0x%x", err);
+        return err;
+    }
+
+    err = camera_start(profile);
+    if (err != ESP_OK) {
+        // Fall back to the default profile so the camera stays usable
+        camera_profile_t fallback;
+        camera_profile_default(&fallback);
+        if (camera_start(&fallback) != ESP_OK) {
+            ESP_LOGE(TAG, "Camera could not be restarted");
+        }
+        return err;
+    }
+
+    ESP_LOGI(TAG, "Camera reconfigured (format: %d, framesize: %d, fb_count: %d in %s, grab: %s, "
+             "xclk: %lu kHz)",
+             profile->pixel_format, profile->frame_size, (int)profile->fb_count,
+             profile->fb_location == CAMERA_FB_IN_DRAM ? "DRAM" : "PSRAM",
+             profile->grab_mode == CAMERA_GRAB_LATEST ? "latest" : "when empty",
+             (unsigned long)(profile->xclk_hz / 1000));
+    return ESP_OK;
+}
+
 camera_fb_t* camera_capture_image(void)
 {
     // Discard the first frame to ensure we get a fresh image
@@ -11,6 +11,35 @@
 #include "esp_camera.h"
 #include "esp_err.h"
 
+// Sensor clock unless calibrated otherwise (see xclk_cal.h)
+#define CAMERA_XCLK_DEFAULT_HZ  20000000
+
+/**
+ * @brief Driver configuration that can change at runtime
+ *
+ * Pins are fixed by the board; everything else the driver only accepts at
+ * init time lives here.
+ */
+typedef struct {
+    pixformat_t pixel_format;
+    framesize_t frame_size;             // Also sizes the frame buffers
+    int jpeg_quality;                   // 0-63, lower means higher quality
+    size_t fb_count;
+    camera_fb_location_t fb_location;
+    camera_grab_mode_t grab_mode;
+    uint32_t xclk_hz;                   // Sensor clock
+} camera_profile_t;
+
+/**
+ * @brief Fill in the boot profile (JPEG, QXGA, one PSRAM frame buffer)
+ *
+ * This is also the still profile. The camera service derives stream and
+ * YUV profiles from it with their own buffer count and placement.
+ *
+ * @param profile Profile to populate
+ */
+void camera_profile_default(camera_profile_t *profile);
+
 /**
  * @brief Initialize the camera with XIAO ESP32S3 Sense configuration
  * 
@@ -24,6 +53,18 @@
  */
 esp_err_t camera_init(void);
 
+/**
+ * @brief Restart the camera driver with a different profile
+ *
+ * All frame buffers must have been returned. Sensor settings are reset by
+ * the driver and have to be re-applied by the caller. If the new profile
+ * fails, the default profile is restored and the error returned.
+ *
+ * @param profile Profile to apply
+ * @return ESP_OK on success, error code otherwise
+ */
+esp_err_t camera_reconfigure(const camera_profile_t *profile);
+
 /**
  * @brief Capture a fresh image from the camera
  * 
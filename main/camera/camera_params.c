@@ -0,0 +1,137 @@
+/**
+ * @file camera_params.c
+ * @brief Camera parameter metadata implementation
+ */
+
+#include "camera/camera_params.h"
+#include <string.h>
+
+// Indexed by camera_param_t; names match the /control and /status keys
+static const char *const s_param_names[CAMERA_PARAM_COUNT] = {
+    [CAMERA_PARAM_AEC]        = "aec",
+    [CAMERA_PARAM_AEC_VALUE]  = "aec_value",
+    [CAMERA_PARAM_AE_LEVEL]   = "ae_level",
+    [CAMERA_PARAM_GAIN_CTRL]  = "gain_ctrl",
+    [CAMERA_PARAM_AGC_GAIN]   = "agc_gain",
+    [CAMERA_PARAM_QUALITY]    = "quality",
+    [CAMERA_PARAM_FRAMESIZE]  = "framesize",
+    [CAMERA_PARAM_BRIGHTNESS] = "brightness",
+    [CAMERA_PARAM_CONTRAST]   = "contrast",
+    [CAMERA_PARAM_SATURATION] = "saturation",
+    [CAMERA_PARAM_SHARPNESS]  = "sharpness",
+    [CAMERA_PARAM_AWB]        = "awb",
+    [CAMERA_PARAM_HMIRROR]    = "hmirror",
+    [CAMERA_PARAM_VFLIP]      = "vflip",
+};
+
+camera_param_t camera_param_find(const char *name)
+{
+    for (int i = 0; i < CAMERA_PARAM_COUNT; i++) {
+        if (strcmp(name, s_param_names[i]) == 0) {
+            return (camera_param_t)i;
+        }
+    }
+    return CAMERA_PARAM_COUNT;
+}
+
+const char *camera_param_name(camera_param_t param)
+{
+    if (param < 0 || param >= CAMERA_PARAM_COUNT) {
+        return NULL;
+    }
+    return s_param_names[param];
+}
+
+int camera_param_get(const camera_status_t *status, camera_param_t param)
+{
+    switch (param) {
+        case CAMERA_PARAM_AEC:        return status->aec;
+        case CAMERA_PARAM_AEC_VALUE:  return status->aec_value;
+        case CAMERA_PARAM_AE_LEVEL:   return status->ae_level;
+        case CAMERA_PARAM_GAIN_CTRL:  return status->agc;
+        case CAMERA_PARAM_AGC_GAIN:   return status->agc_gain;
+        case CAMERA_PARAM_QUALITY:    return status->quality;
+        case CAMERA_PARAM_FRAMESIZE:  return status->framesize;
+        case CAMERA_PARAM_BRIGHTNESS: return status->brightness;
+        case CAMERA_PARAM_CONTRAST:   return status->contrast;
+        case CAMERA_PARAM_SATURATION: return status->saturation;
+        case CAMERA_PARAM_SHARPNESS:  return status->sharpness;
+        case CAMERA_PARAM_AWB:        return status->awb;
+        case CAMERA_PARAM_HMIRROR:    return status->hmirror;
+        case CAMERA_PARAM_VFLIP:      return status->vflip;
+        default:                      return 0;
+    }
+}
+
+int camera_param_apply(sensor_t *s, camera_param_t param, int value)
+{
+    // Not every sensor implements every setter
+    #define APPLY(setter) ((s->setter) ? s->setter(s, value) : -1)
+
+    switch (param) {
+        case CAMERA_PARAM_AEC:        return APPLY(set_exposure_ctrl);
+        case CAMERA_PARAM_AEC_VALUE:  return APPLY(set_aec_value);
+        case CAMERA_PARAM_AE_LEVEL:   return APPLY(set_ae_level);
+        case CAMERA_PARAM_GAIN_CTRL:  return APPLY(set_gain_ctrl);
+        case CAMERA_PARAM_AGC_GAIN:   return APPLY(set_agc_gain);
+        case CAMERA_PARAM_QUALITY:    return APPLY(set_quality);
+        case CAMERA_PARAM_FRAMESIZE:
+            return s->set_framesize ? s->set_framesize(s, (framesize_t)value) : -1;
+        case CAMERA_PARAM_BRIGHTNESS: return APPLY(set_brightness);
+        case CAMERA_PARAM_CONTRAST:   return APPLY(set_contrast);
+        case CAMERA_PARAM_SATURATION: return APPLY(set_saturation);
+        case CAMERA_PARAM_SHARPNESS:  return APPLY(set_sharpness);
+        case CAMERA_PARAM_AWB:        return APPLY(set_whitebal);
+        case CAMERA_PARAM_HMIRROR:    return APPLY(set_hmirror);
+        case CAMERA_PARAM_VFLIP:      return APPLY(set_vflip);
+        default:                      return -1;
+    }
+
+    #undef APPLY
+}
+
+bool camera_param_in_range(camera_param_t param, int value)
+{
+    switch (param) {
+        // The setters' own limits: 0-63, and the OV3660's largest size
+        case CAMERA_PARAM_QUALITY:    return value >= 0 && value <= 63;
+        case CAMERA_PARAM_FRAMESIZE:  return value >= 0 && value <= FRAMESIZE_QXGA;
+        default:                      return true;
+    }
+}
+
+// Frame sizes offered by the web UI (OV3660 range)
+static const struct {
+    framesize_t framesize;
+    const char *name;
+} s_framesizes[] = {
+    { FRAMESIZE_QXGA, "QXGA" },
+    { FRAMESIZE_UXGA, "UXGA" },
+    { FRAMESIZE_SXGA, "SXGA" },
+    { FRAMESIZE_XGA,  "XGA" },
+    { FRAMESIZE_SVGA, "SVGA" },
+    { FRAMESIZE_VGA,  "VGA" },
+    { FRAMESIZE_HVGA, "HVGA" },
+    { FRAMESIZE_CIF,  "CIF" },
+    { FRAMESIZE_QVGA, "QVGA" },
+};
+
+framesize_t camera_framesize_find(const char *name)
+{
+    for (size_t i = 0; i < sizeof(s_framesizes) / sizeof(s_framesizes[0]); i++) {
+        if (strcmp(name, s_framesizes[i].name) == 0) {
+            return s_framesizes[i].framesize;
+        }
+    }
+    return FRAMESIZE_INVALID;
+}
+
+const char *camera_framesize_name(framesize_t framesize)
+{
+    for (size_t i = 0; i < sizeof(s_framesizes) / sizeof(s_framesizes[0]); i++) {
+        if (s_framesizes[i].framesize == framesize) {
+            return s_framesizes[i].name;
+        }
+    }
+    return "UNKNOWN";
+}
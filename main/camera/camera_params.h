@@ -0,0 +1,96 @@
+/**
+ * @file camera_params.h
+ * @brief Camera parameter metadata shared by the control and status APIs
+ */
+
+#ifndef CAMERA_PARAMS_H
+#define CAMERA_PARAMS_H
+
+#include <stdbool.h>
+#include "esp_camera.h"
+
+/**
+ * @brief Adjustable camera parameters
+ */
+typedef enum {
+    CAMERA_PARAM_AEC = 0,       // Auto exposure control
+    CAMERA_PARAM_AEC_VALUE,     // Manual exposure value
+    CAMERA_PARAM_AE_LEVEL,      // Exposure compensation
+    CAMERA_PARAM_GAIN_CTRL,     // Auto gain control
+    CAMERA_PARAM_AGC_GAIN,      // Manual gain value
+    CAMERA_PARAM_QUALITY,       // JPEG quality
+    CAMERA_PARAM_FRAMESIZE,     // Frame size / resolution
+    CAMERA_PARAM_BRIGHTNESS,
+    CAMERA_PARAM_CONTRAST,
+    CAMERA_PARAM_SATURATION,
+    CAMERA_PARAM_SHARPNESS,
+    CAMERA_PARAM_AWB,           // Auto white balance
+    CAMERA_PARAM_HMIRROR,
+    CAMERA_PARAM_VFLIP,
+    CAMERA_PARAM_COUNT
+} camera_param_t;
+
+/**
+ * @brief Look up a parameter by its /control variable name
+ *
+ * @param name Variable name, e.g. "aec_value"
+ * @return Parameter id, or CAMERA_PARAM_COUNT if unknown
+ */
+camera_param_t camera_param_find(const char *name);
+
+/**
+ * @brief Get a parameter's /control variable name (also its JSON key)
+ *
+ * @param param Parameter id
+ * @return Name string, or NULL if param is out of range
+ */
+const char *camera_param_name(camera_param_t param);
+
+/**
+ * @brief Read a parameter's value from a sensor status snapshot
+ *
+ * @param status Sensor status
+ * @param param Parameter id
+ * @return Current value
+ */
+int camera_param_get(const camera_status_t *status, camera_param_t param);
+
+/**
+ * @brief Apply a parameter to the sensor
+ *
+ * @param s Camera sensor
+ * @param param Parameter id
+ * @param value New value
+ * @return 0 on success, sensor error code, or -1 if unsupported by the sensor
+ */
+int camera_param_apply(sensor_t *s, camera_param_t param, int value);
+
+/**
+ * @brief Check a deferred profile value against the range the sensor takes
+ *
+ * For framesize and quality changes that are stored while streaming and
+ * only reach the sensor later. Other parameters are checked by the sensor.
+ *
+ * @param param Parameter id
+ * @param value Value to check
+ * @return true if the sensor would accept the value
+ */
+bool camera_param_in_range(camera_param_t param, int value);
+
+/**
+ * @brief Look up a frame size by name
+ *
+ * @param name Frame size name as used by the web UI, e.g. "VGA", "QXGA"
+ * @return Frame size, or FRAMESIZE_INVALID if unknown
+ */
+framesize_t camera_framesize_find(const char *name);
+
+/**
+ * @brief Get a frame size's name
+ *
+ * @param framesize Frame size
+ * @return Frame size name, or "UNKNOWN"
+ */
+const char *camera_framesize_name(framesize_t framesize);
+
+#endif // CAMERA_PARAMS_H
@@ -0,0 +1,1276 @@
+/**
+ * @file camera_service.c
+ * @brief Camera service task implementation
+ */
+
+#include "camera/camera_service.h"
+#include "camera/camera.h"
+#include "camera/fb_placement.h"
+#if CONFIG_GROWPOD_XCLK_CAL
+#include "camera/xclk_cal.h"
+#endif
+#include "settings/settings.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_heap_caps.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include <stdatomic.h>
+#include <string.h>
+
+static const char *TAG = "camera_service";
+
+// The service owns the driver, so it runs on the driver's core
+#if CONFIG_CAMERA_CORE1
+#define CAMERA_SERVICE_CORE 1
+#else
+#define CAMERA_SERVICE_CORE 0
+#endif
+
+#define CAMERA_SERVICE_PRIORITY    6
+#define CAMERA_SERVICE_STACK_SIZE  4096
+#define CAMERA_SERVICE_QUEUE_LEN   8
+#define CAMERA_SERVICE_BATCH_MAX   8
+#define CAMERA_SERVICE_SUBMIT_MS   1000
+
+// Frames shared between batched capture requests
+#define CAMERA_SHARED_FRAMES       2
+
+// How long to wait for frames to come back before complaining
+#define CAMERA_RELEASE_WARN_MS     10000
+
+// One YUV stream frame can be encoded while the next is captured
+#define CAMERA_YUV_STREAM_FB_COUNT 2
+
+// Stream frame pacing
+#define STREAM_FRAME_INTERVAL_MS   100     // ~10 FPS
+
+// Calibration: frames dropped after each restart, time allowed per point
+#define XCLK_CAL_WARMUP_FRAMES     3
+#define XCLK_CAL_POINT_MAX_MS      10000
+
+static QueueHandle_t s_queue;
+static camera_frame_sink_t s_stream_sink;
+static camera_frame_sink_t s_yuv_stream_sink;
+
+// Owned by the service task
+static camera_mode_t s_mode = CAMERA_MODE_STILL;
+static framesize_t s_still_framesize;
+static int s_still_quality;
+static framesize_t s_stream_framesize;
+static int s_stream_quality;
+static int64_t s_batch_start_us;
+static int64_t s_last_stream_us;        // Timestamp of the last stream frame
+static bool s_stream_preempted;         // A still interrupted the stream since then
+static uint32_t s_xclk_hz = CAMERA_XCLK_DEFAULT_HZ; // Clock the driver runs at
+#if CONFIG_GROWPOD_XCLK_CAL
+static int s_cal_point = -1;            // Next calibration point, -1 when idle
+#endif
+
+/**
+ * @brief Reference count for a frame handed to several capture requests
+ */
+typedef struct {
+    camera_fb_t *fb;
+    int refs;
+} shared_frame_t;
+
+static shared_frame_t s_shared[CAMERA_SHARED_FRAMES];
+static portMUX_TYPE s_shared_lock = portMUX_INITIALIZER_UNLOCKED;
+
+// Outstanding YUV frame (capture or stream); the driver cannot be restarted
+// until it is back
+static camera_fb_t *volatile s_yuv_fb;
+static SemaphoreHandle_t s_yuv_released;
+
+// JPEG driver frames handed out (stills and stream frames); likewise
+static atomic_int s_jpeg_out;
+static SemaphoreHandle_t s_jpeg_released;
+
+// Driver the MJPEG stream runs on
+static const fb_plan_t STILL_DRIVER = { .still_driver = true, .location = CAMERA_FB_IN_PSRAM };
+static fb_plan_t s_fb_plan = { .still_driver = true, .location = CAMERA_FB_IN_PSRAM };
+
+/**
+ * @brief Mark a YUV frame as outstanding before handing it out
+ */
+static void track_yuv_frame(camera_fb_t *fb)
+{
+    // Clear a release signal left over from a frame nobody waited for
+    xSemaphoreTake(s_yuv_released, 0);
+    s_yuv_fb = fb;
+}
+
+static camera_service_stats_t s_stats;
+static uint32_t s_dequeued;
+static int64_t s_total_queue_us;
+static int64_t s_total_service_us;
+static int64_t s_total_still_us;
+static portMUX_TYPE s_stats_lock = portMUX_INITIALIZER_UNLOCKED;
+
+/**
+ * @brief Reply to a request and account its service time
+ */
+static void complete(camera_request_t *req, esp_err_t err)
+{
+    int64_t now = esp_timer_get_time();
+
+    portENTER_CRITICAL(&s_stats_lock);
+    s_stats.requests++;
+    s_total_service_us += now - s_batch_start_us;
+    s_stats.avg_service_us = (uint32_t)(s_total_service_us / s_stats.requests);
+    s_stats.mode = s_mode;
+    s_stats.still_framesize = s_still_framesize;
+    s_stats.still_quality = s_still_quality;
+    portEXIT_CRITICAL(&s_stats_lock);
+
+    // Giving the semaphore hands the future back; do not touch it afterwards
+    req->future->err = err;
+    xSemaphoreGive(req->future->done);
+}
+
+/**
+ * @brief Sensor status with framesize/quality replaced by the still profile
+ */
+static void still_status(sensor_t *s, camera_status_t *status)
+{
+    *status = s->status;
+    status->framesize = s_still_framesize;
+    status->quality = s_still_quality;
+}
+
+/**
+ * @brief Switch the sensor to the given framesize and quality if needed
+ */
+static void apply_profile(sensor_t *s, framesize_t framesize, int quality)
+{
+    if (s->status.framesize != framesize) {
+        s->set_framesize(s, framesize);
+    }
+    if (s->status.quality != quality) {
+        s->set_quality(s, quality);
+    }
+}
+
+/**
+ * @brief Copy a frame into one PSRAM block (header followed by data)
+ *
+ * Lets a still taken during a stream give the driver's only frame buffer
+ * back immediately, so stream production does not wait for the still to
+ * be sent.
+ */
+static camera_fb_t *clone_frame(const camera_fb_t *fb)
+{
+    camera_fb_t *clone = heap_caps_malloc(sizeof(camera_fb_t) + fb->len, MALLOC_CAP_SPIRAM);
+    if (clone == NULL) {
+        return NULL;
+    }
+    *clone = *fb;
+    clone->buf = (uint8_t *)(clone + 1);
+    memcpy(clone->buf, fb->buf, fb->len);
+    return clone;
+}
+
+/**
+ * @brief True if the frame was allocated by clone_frame()
+ */
+static bool is_clone(const camera_fb_t *fb)
+{
+    return fb->buf == (const uint8_t *)(fb + 1);
+}
+
+/**
+ * @brief Wait until the outstanding YUV frame, if any, has been released
+ */
+static void wait_yuv_release(void)
+{
+    while (s_yuv_fb != NULL &&
+           xSemaphoreTake(s_yuv_released, pdMS_TO_TICKS(CAMERA_RELEASE_WARN_MS)) != pdTRUE) {
+        ESP_LOGW(TAG, "Still waiting for YUV frame to be released");
+    }
+}
+
+/**
+ * @brief Wait until every JPEG driver frame handed out has been released
+ */
+static void wait_jpeg_release(void)
+{
+    while (atomic_load(&s_jpeg_out) > 0 &&
+           xSemaphoreTake(s_jpeg_released, pdMS_TO_TICKS(CAMERA_RELEASE_WARN_MS)) != pdTRUE) {
+        ESP_LOGW(TAG, "Still waiting for %d frame(s) to be released", atomic_load(&s_jpeg_out));
+    }
+}
+
+/**
+ * @brief Restart the driver with a profile and re-apply the sensor settings
+ *
+ * Waits for every frame of the old driver first: deinit frees them.
+ */
+static esp_err_t switch_profile(sensor_t *s, const camera_profile_t *profile)
+{
+    camera_status_t status;
+    camera_settings_t settings;
+
+    wait_yuv_release();
+    wait_jpeg_release();
+    still_status(s, &status);
+    settings_from_status(&status, &settings);
+
+    esp_err_t err = camera_reconfigure(profile);
+    // A failed restart falls back to the default profile
+    s_xclk_hz = (err == ESP_OK) ? profile->xclk_hz : CAMERA_XCLK_DEFAULT_HZ;
+    settings.framesize = profile->frame_size;
+    settings_apply_to_camera(&settings);
+    return err;
+}
+
+/**
+ * @brief Sensor clock for a JPEG profile at the given framesize
+ */
+static uint32_t profile_clock(framesize_t framesize)
+{
+#if CONFIG_GROWPOD_XCLK_CAL
+    return xclk_cal_get(framesize);
+#else
+    (void)framesize;
+    return CAMERA_XCLK_DEFAULT_HZ;
+#endif
+}
+
+/**
+ * @brief Restart the driver with the JPEG still profile
+ */
+static esp_err_t restore_jpeg_profile(void)
+{
+    camera_profile_t profile;
+
+    camera_profile_default(&profile);
+    profile.frame_size = s_still_framesize;
+    profile.jpeg_quality = s_still_quality;
+    profile.xclk_hz = profile_clock(s_still_framesize);
+    esp_err_t err = switch_profile(esp_camera_sensor_get(), &profile);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to restore JPEG profile");
+    }
+    return err;
+}
+
+/**
+ * @brief Record a driver restart for the stream's buffers
+ */
+static void set_fb_plan(const fb_plan_t *plan)
+{
+    s_fb_plan = *plan;
+    portENTER_CRITICAL(&s_stats_lock);
+    s_stats.fb_restarts++;
+    s_stats.stream_fb_count = plan->still_driver ? 0 : plan->fb_count;
+    s_stats.stream_fb_dram = !plan->still_driver && plan->location == CAMERA_FB_IN_DRAM;
+    portEXIT_CRITICAL(&s_stats_lock);
+}
+
+/**
+ * @brief Put the still driver back if the stream has its own
+ */
+static void restore_still_buffers(void)
+{
+    if (!s_fb_plan.still_driver) {
+        restore_jpeg_profile();
+        set_fb_plan(&STILL_DRIVER);
+    }
+}
+
+/**
+ * @brief Restart the driver for the stream with the planned buffers
+ */
+static esp_err_t start_stream_driver(const fb_plan_t *plan)
+{
+    camera_profile_t profile;
+
+    camera_profile_default(&profile);
+    profile.frame_size = plan->framesize;
+    profile.jpeg_quality = s_stream_quality;
+    profile.fb_count = plan->fb_count;
+    profile.fb_location = plan->location;
+    // The sensor fills one buffer while the others are being sent; always
+    // hand out the newest so a slow send does not add latency
+    profile.grab_mode = CAMERA_GRAB_LATEST;
+    // Clocked for the framesize the sensor streams at, not the buffer size
+    profile.xclk_hz = profile_clock(s_stream_framesize);
+
+    esp_err_t err = switch_profile(esp_camera_sensor_get(), &profile);
+    if (err == ESP_OK) {
+        ESP_LOGI(TAG, "Stream driver: %u x %u bytes in %s (%s, worst-case frame %u)",
+                 (unsigned)plan->fb_count, (unsigned)plan->fb_bytes,
+                 plan->location == CAMERA_FB_IN_DRAM ? "internal RAM" : "PSRAM",
+                 camera_framesize_name(plan->framesize), (unsigned)plan->jpeg_worst);
+        set_fb_plan(plan);
+    }
+    return err;
+}
+
+/**
+ * @brief Move the MJPEG stream to the driver its profile calls for
+ *
+ * The stream gets a driver of its own with CONFIG_GROWPOD_STREAM_FB_COUNT
+ * buffers, in internal RAM if they fit (fb_placement.h). A running stream
+ * driver is kept while it covers the profile and runs at the framesize's
+ * calibrated clock, so adaptive rung changes only restart it when frames
+ * grow or the clock changes. A stream on the still driver runs at the
+ * still clock. Ends with the stream profile applied.
+ */
+static void place_stream_buffers(void)
+{
+    bool reclock = !s_fb_plan.still_driver && s_xclk_hz != profile_clock(s_stream_framesize);
+
+    if (reclock || !fb_placement_covers(&s_fb_plan, s_stream_framesize, s_stream_quality)) {
+        fb_plan_t plan;
+        size_t dram_free = 0;
+        size_t dram_largest = 0;
+        size_t dram_reserve = 0;
+#if CONFIG_GROWPOD_DRAM_STREAM_FB
+        // The running driver's buffers are freed before new ones are allocated
+        dram_free = heap_caps_get_free_size(MALLOC_CAP_INTERNAL | MALLOC_CAP_DMA);
+        dram_largest = heap_caps_get_largest_free_block(MALLOC_CAP_INTERNAL | MALLOC_CAP_DMA);
+        dram_reserve = CONFIG_GROWPOD_DRAM_FB_RESERVE_KB * 1024;
+        if (!s_fb_plan.still_driver && s_fb_plan.location == CAMERA_FB_IN_DRAM) {
+            dram_free += s_fb_plan.fb_bytes * s_fb_plan.fb_count;
+            if (dram_largest < s_fb_plan.fb_bytes) {
+                dram_largest = s_fb_plan.fb_bytes;
+            }
+        }
+#endif
+
+        fb_placement_plan(s_stream_framesize, s_stream_quality, CONFIG_GROWPOD_STREAM_FB_COUNT,
+                          dram_free, dram_largest, dram_reserve, &plan);
+        if (plan.still_driver) {
+            ESP_LOGI(TAG, "Streaming on the still driver (worst-case frame %u)",
+                     (unsigned)plan.jpeg_worst);
+            restore_still_buffers();
+        } else if (start_stream_driver(&plan) != ESP_OK) {
+            ESP_LOGW(TAG, "Stream driver failed, streaming on the still driver");
+            restore_jpeg_profile();
+            set_fb_plan(&STILL_DRIVER);
+        }
+    }
+    apply_profile(esp_camera_sensor_get(), s_stream_framesize, s_stream_quality);
+}
+
+/**
+ * @brief Grab a JPEG still while the stream has its own driver
+ *
+ * The stream's buffers only hold stream frames, so this restarts the
+ * still driver for the grab and the stream's driver afterwards. The still
+ * is copied out before the second restart frees its buffer.
+ */
+static camera_fb_t *grab_still_stream_driver(void)
+{
+    camera_fb_t *clone = NULL;
+
+    restore_still_buffers();
+    camera_fb_t *fb = camera_capture_image();
+    if (fb) {
+        clone = clone_frame(fb);
+        esp_camera_fb_return(fb);
+        if (clone == NULL) {
+            ESP_LOGE(TAG, "No PSRAM for still copy");
+        }
+    }
+    place_stream_buffers();
+    s_stream_preempted = true;
+    return clone;
+}
+
+#if CONFIG_GROWPOD_H264_STREAM
+/**
+ * @brief Restart the driver in YUV422 mode for streaming
+ */
+static esp_err_t start_yuv_stream(sensor_t *s, framesize_t framesize)
+{
+    camera_profile_t profile;
+
+    camera_profile_default(&profile);
+    profile.pixel_format = PIXFORMAT_YUV422;
+    profile.frame_size = framesize;
+    profile.fb_count = CAMERA_YUV_STREAM_FB_COUNT;
+    return switch_profile(s, &profile);
+}
+
+/**
+ * @brief Grab a JPEG still in the middle of a YUV stream
+ *
+ * The driver only changes pixel format at init, so this restarts it in the
+ * still profile and back. The still is copied out before the second
+ * restart frees the driver's buffers.
+ */
+static camera_fb_t *grab_still_yuv_stream(void)
+{
+    camera_fb_t *clone = NULL;
+
+    if (restore_jpeg_profile() == ESP_OK) {
+        camera_fb_t *fb = camera_capture_image();
+        if (fb) {
+            clone = clone_frame(fb);
+            esp_camera_fb_return(fb);
+            if (clone == NULL) {
+                ESP_LOGE(TAG, "No PSRAM for still copy");
+            }
+        }
+    }
+    if (start_yuv_stream(esp_camera_sensor_get(), s_stream_framesize) != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to resume YUV stream");
+    }
+    s_stream_preempted = true;
+    return clone;
+}
+#endif
+
+/**
+ * @brief Grab a still, preempting the stream profile if streaming
+ *
+ * While streaming, the sensor is switched to the still profile for one
+ * grab and straight back; the stream resumes after a single resync frame.
+ */
+static camera_fb_t *grab_still(sensor_t *s)
+{
+    if (s_mode == CAMERA_MODE_STILL) {
+        return camera_capture_image();
+    }
+#if CONFIG_GROWPOD_H264_STREAM
+    if (s_mode == CAMERA_MODE_STREAM_YUV) {
+        return grab_still_yuv_stream();
+    }
+#endif
+    if (!s_fb_plan.still_driver) {
+        return grab_still_stream_driver();
+    }
+
+    apply_profile(s, s_still_framesize, s_still_quality);
+    camera_fb_t *fb = camera_capture_image();
+    if (fb) {
+        camera_fb_t *clone = clone_frame(fb);
+        if (clone) {
+            esp_camera_fb_return(fb);
+            fb = clone;
+        } else {
+            ESP_LOGW(TAG, "No PSRAM for still copy, stream waits until it is sent");
+        }
+    }
+    apply_profile(s, s_stream_framesize, s_stream_quality);
+    s_stream_preempted = true;
+    return fb;
+}
+
+/**
+ * @brief Serve a run of capture requests with a single frame
+ */
+static void handle_captures(sensor_t *s, camera_request_t **reqs, int n)
+{
+    bool streaming = (s_mode != CAMERA_MODE_STILL);
+    camera_fb_t *fb = grab_still(s);
+    if (!fb) {
+        for (int i = 0; i < n; i++) {
+            complete(reqs[i], ESP_FAIL);
+        }
+        return;
+    }
+    if (!is_clone(fb)) {
+        atomic_fetch_add(&s_jpeg_out, 1);
+    }
+
+    // Register the share before any requester can release the frame
+    int holders = 1;
+    if (n > 1) {
+        portENTER_CRITICAL(&s_shared_lock);
+        for (int i = 0; i < CAMERA_SHARED_FRAMES; i++) {
+            if (s_shared[i].fb == NULL) {
+                s_shared[i].fb = fb;
+                s_shared[i].refs = n;
+                holders = n;
+                break;
+            }
+        }
+        portEXIT_CRITICAL(&s_shared_lock);
+        ESP_LOGI(TAG, "Batched %d capture requests onto one frame", holders);
+    }
+
+    // Still latency: submit to frame ready, including any stream preemption
+    int64_t now = esp_timer_get_time();
+    portENTER_CRITICAL(&s_stats_lock);
+    for (int i = 0; i < n; i++) {
+        uint32_t still_us = (uint32_t)(now - reqs[i]->enqueue_us);
+        s_stats.stills++;
+        s_stats.last_still_us = still_us;
+        s_total_still_us += still_us;
+    }
+    s_stats.last_still_len = fb->len;
+    s_stats.avg_still_us = (uint32_t)(s_total_still_us / s_stats.stills);
+    portEXIT_CRITICAL(&s_stats_lock);
+    ESP_LOGI(TAG, "Still ready in %lld ms%s", (now - reqs[0]->enqueue_us) / 1000,
+             streaming ? " (preempted stream)" : "");
+
+    for (int i = 0; i < n; i++) {
+        if (i < holders) {
+            reqs[i]->future->fb = fb;
+            complete(reqs[i], ESP_OK);
+        } else {
+            complete(reqs[i], ESP_ERR_NO_MEM);
+        }
+    }
+}
+
+/**
+ * @brief Apply one parameter change
+ *
+ * @return 0 on success, non-zero if the value was rejected
+ */
+static int apply_param(camera_param_t param, int value)
+{
+    sensor_t *s = esp_camera_sensor_get();
+    int res;
+
+    if (s_mode != CAMERA_MODE_STILL &&
+        (param == CAMERA_PARAM_FRAMESIZE || param == CAMERA_PARAM_QUALITY)) {
+        // The stream owns the sensor profile; update what it restores to
+        // Checked now: the value is saved and only reaches the sensor later
+        res = camera_param_in_range(param, value) ? 0 : -1;
+        if (res == 0 && param == CAMERA_PARAM_FRAMESIZE) {
+            s_still_framesize = (framesize_t)value;
+        } else if (res == 0) {
+            s_still_quality = value;
+        }
+        ESP_LOGI(TAG, "Streaming, %s=%d deferred until stream ends",
+                 camera_param_name(param), value);
+    } else {
+        res = camera_param_apply(s, param, value);
+        if (res == 0 && param == CAMERA_PARAM_FRAMESIZE) {
+            s_still_framesize = (framesize_t)value;
+            if (s_xclk_hz != profile_clock(s_still_framesize)) {
+                // Calibrated for another clock, which needs a restart
+                restore_jpeg_profile();
+            }
+
+            // Discard any buffered frames after resolution change
+            camera_fb_t *fb = esp_camera_fb_get();
+            if (fb) {
+                ESP_LOGI(TAG, "Discarded old frame buffer (%dx%d)", fb->width, fb->height);
+                esp_camera_fb_return(fb);
+            }
+            // Get a fresh frame to verify new resolution
+            fb = esp_camera_fb_get();
+            if (fb) {
+                ESP_LOGI(TAG, "New frame buffer captured (%dx%d)", fb->width, fb->height);
+                esp_camera_fb_return(fb);
+            } else {
+                ESP_LOGW(TAG, "Failed to capture verification frame");
+            }
+        } else if (res == 0 && param == CAMERA_PARAM_QUALITY) {
+            s_still_quality = value;
+        }
+    }
+
+    ESP_LOGI(TAG, "Set %s to %d, result: %d", camera_param_name(param), value, res);
+    if (res == 0) {
+        // Counted before complete() so the change is visible once it returns
+        portENTER_CRITICAL(&s_stats_lock);
+        s_stats.param_changes++;
+        portEXIT_CRITICAL(&s_stats_lock);
+    }
+    return res;
+}
+
+/**
+ * @brief Apply a run of parameter change requests and persist them once
+ */
+static void handle_set_params(camera_request_t **reqs, int n)
+{
+    bool changed = false;
+
+    for (int i = 0; i < n; i++) {
+        esp_err_t err = ESP_OK;
+        for (int c = 0; c < reqs[i]->set_param.count; c++) {
+            const camera_param_change_t *change = &reqs[i]->set_param.changes[c];
+            if (apply_param(change->param, change->value) == 0) {
+                changed = true;
+            } else {
+                err = ESP_FAIL;
+            }
+        }
+        complete(reqs[i], err);
+    }
+
+    // One NVS write for the whole run
+    if (changed) {
+        camera_status_t status;
+        camera_settings_t settings;
+        still_status(esp_camera_sensor_get(), &status);
+        settings_from_status(&status, &settings);
+        esp_err_t err = settings_save(&settings);
+        if (err != ESP_OK) {
+            ESP_LOGW(TAG, "Failed to save settings to NVS: %s", esp_err_to_name(err));
+        }
+    }
+}
+
+#if CONFIG_GROWPOD_H264_STREAM
+/**
+ * @brief Enter YUV stream mode, or change its framesize
+ */
+static esp_err_t enter_yuv_stream(sensor_t *s, framesize_t framesize)
+{
+    if (s_mode == CAMERA_MODE_STREAM_YUV && s_stream_framesize == framesize) {
+        return ESP_OK;
+    }
+
+    esp_err_t err = start_yuv_stream(s, framesize);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "YUV stream start failed: %s", esp_err_to_name(err));
+        restore_jpeg_profile();
+        return err;
+    }
+    if (s_mode == CAMERA_MODE_STILL) {
+        ESP_LOGI(TAG, "Entering YUV stream mode (%s)", camera_framesize_name(framesize));
+        s_last_stream_us = 0;
+        s_stream_preempted = false;
+    }
+    s_stream_framesize = framesize;
+    return ESP_OK;
+}
+#endif
+
+/**
+ * @brief Switch between still and stream mode
+ */
+static void handle_set_mode(sensor_t *s, camera_request_t *req)
+{
+    camera_mode_t mode = req->set_mode.mode;
+
+    // The stream modes need different drivers; one has to end first
+    if (mode != CAMERA_MODE_STILL && s_mode != CAMERA_MODE_STILL && mode != s_mode) {
+        complete(req, ESP_ERR_INVALID_STATE);
+        return;
+    }
+
+    if (mode == CAMERA_MODE_STREAM_YUV) {
+#if CONFIG_GROWPOD_H264_STREAM
+        esp_err_t err = enter_yuv_stream(s, req->set_mode.framesize);
+        if (err != ESP_OK) {
+            // A failed framesize change leaves the still profile behind
+            s_mode = CAMERA_MODE_STILL;
+            complete(req, err);
+            return;
+        }
+#else
+        complete(req, ESP_ERR_NOT_SUPPORTED);
+        return;
+#endif
+    } else if (mode == CAMERA_MODE_STREAM) {
+        if (s_mode == CAMERA_MODE_STILL) {
+            ESP_LOGI(TAG, "Entering stream mode (%s, quality: %d, still framesize: %d)",
+                     camera_framesize_name(req->set_mode.framesize), req->set_mode.quality,
+                     s_still_framesize);
+            s_last_stream_us = 0;
+            s_stream_preempted = false;
+        }
+        s_stream_framesize = req->set_mode.framesize;
+        s_stream_quality = req->set_mode.quality;
+        place_stream_buffers();
+    } else if (s_mode == CAMERA_MODE_STREAM) {
+        restore_still_buffers();
+        s = esp_camera_sensor_get();
+        apply_profile(s, s_still_framesize, s_still_quality);
+        ESP_LOGI(TAG, "Left stream mode, restored framesize: %d, quality: %d",
+                 s_still_framesize, s_still_quality);
+    } else if (s_mode == CAMERA_MODE_STREAM_YUV) {
+#if CONFIG_GROWPOD_H264_STREAM
+        restore_jpeg_profile();
+        ESP_LOGI(TAG, "Left YUV stream mode, restored framesize: %d, quality: %d",
+                 s_still_framesize, s_still_quality);
+#endif
+    }
+
+    s_mode = mode;
+    complete(req, ESP_OK);
+}
+
+#if CONFIG_GROWPOD_YUV_MULTIRES
+/**
+ * @brief Grab one YUV422 frame and wait until the requester releases it
+ *
+ * The driver can only change pixel format at init, so this restarts it
+ * twice. Nothing else can use the camera meanwhile.
+ */
+static void handle_capture_yuv(sensor_t *s, camera_request_t *req)
+{
+    if (s_mode != CAMERA_MODE_STILL) {
+        complete(req, ESP_ERR_INVALID_STATE);
+        return;
+    }
+
+    camera_profile_t profile;
+    camera_profile_default(&profile);
+    profile.pixel_format = PIXFORMAT_YUV422;
+    profile.frame_size = req->capture_yuv.framesize;
+
+    esp_err_t err = switch_profile(s, &profile);
+    camera_fb_t *fb = NULL;
+    if (err == ESP_OK) {
+        fb = camera_capture_image();
+        if (fb == NULL) {
+            err = ESP_FAIL;
+        }
+    }
+
+    if (fb) {
+        track_yuv_frame(fb);
+        req->future->fb = fb;
+        complete(req, ESP_OK);
+        wait_yuv_release();
+    } else {
+        ESP_LOGE(TAG, "YUV capture failed: %s", esp_err_to_name(err));
+        complete(req, err);
+    }
+
+    restore_jpeg_profile();
+}
+#endif
+
+#if CONFIG_GROWPOD_XCLK_CAL
+/**
+ * @brief True if the frame holds a whole JPEG, SOI to EOI
+ */
+static bool is_complete_jpeg(const camera_fb_t *fb)
+{
+    return fb->len >= 4 && fb->buf[0] == 0xFF && fb->buf[1] == 0xD8 &&
+           fb->buf[fb->len - 2] == 0xFF && fb->buf[fb->len - 1] == 0xD9;
+}
+
+/**
+ * @brief Measure one framesize at one clock
+ *
+ * Two buffers grabbed when-empty hand over every frame the driver
+ * completes, in order, so gaps between frame timestamps are frames the
+ * driver lost. A clock the driver cannot start at is recorded as failed.
+ */
+static void calibrate_point(int size, int clock)
+{
+    camera_profile_t profile;
+    xclk_cal_point_t point = { .measured = true, .error_permille = 1000 };
+    int64_t stamps[CONFIG_GROWPOD_XCLK_CAL_FRAMES];
+    int quality;
+
+    camera_profile_default(&profile);
+    profile.frame_size = xclk_cal_framesize(size, &quality);
+    profile.jpeg_quality = quality;
+    profile.fb_count = 2;
+    profile.grab_mode = CAMERA_GRAB_WHEN_EMPTY;
+    profile.xclk_hz = xclk_cal_clock_hz(clock);
+
+    if (switch_profile(esp_camera_sensor_get(), &profile) != ESP_OK) {
+        ESP_LOGW(TAG, "Calibration: %s at %lu MHz did not start",
+                 camera_framesize_name(profile.frame_size),
+                 (unsigned long)(profile.xclk_hz / 1000000));
+        xclk_cal_record(size, clock, &point);
+        return;
+    }
+    // The saved settings came back with the still quality
+    apply_profile(esp_camera_sensor_get(), profile.frame_size, quality);
+
+    // Frames from before exposure and quality settled
+    for (int i = 0; i < XCLK_CAL_WARMUP_FRAMES; i++) {
+        camera_fb_t *fb = esp_camera_fb_get();
+        if (fb) {
+            esp_camera_fb_return(fb);
+        }
+    }
+
+    int count = 0;
+    int truncated = 0;
+    uint64_t bytes = 0;
+    int64_t deadline = esp_timer_get_time() + XCLK_CAL_POINT_MAX_MS * 1000LL;
+    while (count < CONFIG_GROWPOD_XCLK_CAL_FRAMES && esp_timer_get_time() < deadline) {
+        camera_fb_t *fb = esp_camera_fb_get();
+        if (fb == NULL) {
+            stamps[count++] = 0;
+            continue;
+        }
+        stamps[count++] = (int64_t)fb->timestamp.tv_sec * 1000000 + fb->timestamp.tv_usec;
+        if (is_complete_jpeg(fb)) {
+            bytes += fb->len;
+        } else {
+            truncated++;
+        }
+        esp_camera_fb_return(fb);
+    }
+
+    xclk_cal_measure(stamps, count, truncated, &point);
+    int complete_frames = count - truncated;
+    for (int i = 0; i < count; i++) {
+        complete_frames -= (stamps[i] == 0);
+    }
+    point.jpeg_bytes = complete_frames > 0 ? (uint32_t)(bytes / complete_frames) : 0;
+
+    ESP_LOGI(TAG, "Calibration: %s at %lu MHz: %lu us/frame, %u permille errors, %lu bytes",
+             camera_framesize_name(profile.frame_size),
+             (unsigned long)(profile.xclk_hz / 1000000), (unsigned long)point.interval_us,
+             point.error_permille, (unsigned long)point.jpeg_bytes);
+    xclk_cal_record(size, clock, &point);
+}
+
+/**
+ * @brief Start a calibration run; the service loop measures it point by point
+ */
+static void handle_calibrate(camera_request_t *req)
+{
+    if (s_mode != CAMERA_MODE_STILL) {
+        complete(req, ESP_ERR_INVALID_STATE);
+        return;
+    }
+    xclk_cal_begin();
+    s_cal_point = 0;
+    ESP_LOGI(TAG, "XCLK calibration started (%d points)", XCLK_CAL_POINTS);
+    complete(req, ESP_OK);
+}
+
+/**
+ * @brief Measure the next calibration point, finishing the run after the last
+ */
+static void calibrate_step(void)
+{
+    calibrate_point(s_cal_point / XCLK_CAL_CLOCKS, s_cal_point % XCLK_CAL_CLOCKS);
+    if (++s_cal_point < XCLK_CAL_POINTS) {
+        return;
+    }
+
+    s_cal_point = -1;
+    esp_err_t err = xclk_cal_finish();
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Calibration in use but not saved: %s", esp_err_to_name(err));
+    }
+    restore_jpeg_profile();
+    ESP_LOGI(TAG, "XCLK calibration finished");
+}
+#endif
+
+/**
+ * @brief Process a dequeued batch, grouping consecutive requests of one type
+ *
+ * Requests are handled strictly in arrival order; only adjacent runs of
+ * captures or parameter changes are merged.
+ */
+static void process_batch(sensor_t *s, camera_request_t *batch, int n)
+{
+    camera_request_t *run[CAMERA_SERVICE_BATCH_MAX];
+
+    s_batch_start_us = esp_timer_get_time();
+
+    portENTER_CRITICAL(&s_stats_lock);
+    s_stats.batches++;
+    for (int i = 0; i < n; i++) {
+        uint32_t queue_us = (uint32_t)(s_batch_start_us - batch[i].enqueue_us);
+        s_total_queue_us += queue_us;
+        if (queue_us > s_stats.max_queue_us) {
+            s_stats.max_queue_us = queue_us;
+        }
+    }
+    s_dequeued += n;
+    s_stats.avg_queue_us = (uint32_t)(s_total_queue_us / s_dequeued);
+    portEXIT_CRITICAL(&s_stats_lock);
+
+    int i = 0;
+    while (i < n) {
+        camera_req_type_t type = batch[i].type;
+        int count = 0;
+        while (i < n && batch[i].type == type) {
+            run[count++] = &batch[i++];
+        }
+
+#if CONFIG_GROWPOD_XCLK_CAL
+        // A calibration run owns the driver until it is done
+        if (s_cal_point >= 0 && type != CAMERA_REQ_GET_STATUS) {
+            for (int j = 0; j < count; j++) {
+                complete(run[j], ESP_ERR_INVALID_STATE);
+            }
+            continue;
+        }
+#endif
+
+        switch (type) {
+            case CAMERA_REQ_CAPTURE:
+                handle_captures(s, run, count);
+                // A still during a YUV stream restarts the driver
+                s = esp_camera_sensor_get();
+                break;
+            case CAMERA_REQ_SET_PARAM:
+                handle_set_params(run, count);
+                // A framesize calibrated for another clock restarts the driver
+                s = esp_camera_sensor_get();
+                break;
+            case CAMERA_REQ_SET_MODE:
+                for (int j = 0; j < count; j++) {
+                    handle_set_mode(s, run[j]);
+                    s = esp_camera_sensor_get();
+                }
+                break;
+            case CAMERA_REQ_GET_STATUS:
+                for (int j = 0; j < count; j++) {
+                    still_status(s, &run[j]->future->status);
+                    complete(run[j], ESP_OK);
+                }
+                break;
+            case CAMERA_REQ_CAPTURE_YUV:
+                for (int j = 0; j < count; j++) {
+#if CONFIG_GROWPOD_YUV_MULTIRES
+                    handle_capture_yuv(s, run[j]);
+                    // The driver was restarted, so is its sensor state
+                    s = esp_camera_sensor_get();
+#else
+                    complete(run[j], ESP_ERR_NOT_SUPPORTED);
+#endif
+                }
+                break;
+            case CAMERA_REQ_CALIBRATE_XCLK:
+                for (int j = 0; j < count; j++) {
+#if CONFIG_GROWPOD_XCLK_CAL
+                    handle_calibrate(run[j]);
+#else
+                    complete(run[j], ESP_ERR_NOT_SUPPORTED);
+#endif
+                }
+                break;
+        }
+    }
+}
+
+/**
+ * @brief Grab one stream frame and hand it to the stream sink
+ */
+static void produce_stream_frame(void)
+{
+    uint32_t gap_ms = 0;
+
+    if (s_stream_preempted) {
+        // The buffered frame may still be at the still profile
+        camera_fb_t *stale = esp_camera_fb_get();
+        if (stale) {
+            esp_camera_fb_return(stale);
+        }
+    }
+
+    camera_fb_t *fb = esp_camera_fb_get();
+    if (!fb) {
+        ESP_LOGE(TAG, "Camera capture failed during stream");
+        return;
+    }
+
+    int64_t now = esp_timer_get_time();
+    if (s_stream_preempted) {
+        s_stream_preempted = false;
+        if (s_last_stream_us != 0) {
+            gap_ms = (uint32_t)((now - s_last_stream_us) / 1000);
+            portENTER_CRITICAL(&s_stats_lock);
+            s_stats.last_gap_ms = gap_ms;
+            if (gap_ms > s_stats.max_gap_ms) {
+                s_stats.max_gap_ms = gap_ms;
+            }
+            portEXIT_CRITICAL(&s_stats_lock);
+            ESP_LOGI(TAG, "Stream resumed after still, gap %lu ms", (unsigned long)gap_ms);
+        }
+    }
+    s_last_stream_us = now;
+
+    // A stream frame is tracked before the sink sees it: it may be
+    // released from another task before the sink even returns. Only one
+    // YUV frame can be tracked; while one is out the YUV sink is busy and
+    // rejects the next.
+    bool yuv = (s_mode == CAMERA_MODE_STREAM_YUV);
+    bool track = yuv && s_yuv_fb == NULL;
+    camera_frame_sink_t sink = yuv ? s_yuv_stream_sink : s_stream_sink;
+    if (track) {
+        track_yuv_frame(fb);
+    } else if (!yuv) {
+        atomic_fetch_add(&s_jpeg_out, 1);
+    }
+    if (sink == NULL || !sink(fb, now, gap_ms)) {
+        if (track) {
+            s_yuv_fb = NULL;
+        } else if (!yuv) {
+            atomic_fetch_sub(&s_jpeg_out, 1);
+        }
+        esp_camera_fb_return(fb);
+    }
+}
+
+/**
+ * @brief Service task - sole owner of the sensor and driver
+ */
+static void service_task(void *arg)
+{
+    camera_request_t batch[CAMERA_SERVICE_BATCH_MAX];
+    sensor_t *s = esp_camera_sensor_get();
+    TickType_t next_frame = xTaskGetTickCount();
+    const TickType_t interval = pdMS_TO_TICKS(STREAM_FRAME_INTERVAL_MS);
+
+    while (true) {
+        // Block for requests until the next stream frame is due
+        TickType_t wait = portMAX_DELAY;
+        if (s_mode != CAMERA_MODE_STILL) {
+            int32_t remaining = (int32_t)(next_frame - xTaskGetTickCount());
+            wait = remaining > 0 ? (TickType_t)remaining : 0;
+        }
+#if CONFIG_GROWPOD_XCLK_CAL
+        if (s_cal_point >= 0) {
+            wait = 0;
+        }
+#endif
+
+        if (xQueueReceive(s_queue, &batch[0], wait) == pdTRUE) {
+            int n = 1;
+            while (n < CAMERA_SERVICE_BATCH_MAX &&
+                   xQueueReceive(s_queue, &batch[n], 0) == pdTRUE) {
+                n++;
+            }
+            camera_mode_t prev_mode = s_mode;
+            process_batch(s, batch, n);
+            s = esp_camera_sensor_get();
+            if (prev_mode == CAMERA_MODE_STILL && s_mode != CAMERA_MODE_STILL) {
+                next_frame = xTaskGetTickCount();
+            }
+        }
+
+        TickType_t now = xTaskGetTickCount();
+        if (s_mode != CAMERA_MODE_STILL && (int32_t)(now - next_frame) >= 0) {
+            produce_stream_frame();
+            next_frame += interval;
+            // Don't burst to catch up after a long request
+            if ((int32_t)(now - next_frame) > 0) {
+                next_frame = now + interval;
+            }
+        }
+
+#if CONFIG_GROWPOD_XCLK_CAL
+        // One point per pass, so status requests are answered in between
+        if (s_cal_point >= 0) {
+            calibrate_step();
+            s = esp_camera_sensor_get();
+        }
+#endif
+    }
+}
+
+esp_err_t camera_service_init(void)
+{
+    sensor_t *s = esp_camera_sensor_get();
+    if (s == NULL) {
+        ESP_LOGE(TAG, "Failed to get camera sensor");
+        return ESP_FAIL;
+    }
+    s_still_framesize = s->status.framesize;
+    s_still_quality = s->status.quality;
+    s_stats.still_framesize = s_still_framesize;
+    s_stats.still_quality = s_still_quality;
+
+    s_queue = xQueueCreate(CAMERA_SERVICE_QUEUE_LEN, sizeof(camera_request_t));
+    s_yuv_released = xSemaphoreCreateBinary();
+    s_jpeg_released = xSemaphoreCreateBinary();
+    if (s_queue == NULL || s_yuv_released == NULL || s_jpeg_released == NULL) {
+        ESP_LOGE(TAG, "Failed to create request queue");
+        return ESP_ERR_NO_MEM;
+    }
+
+    // The boot driver runs at the default clock
+    if (profile_clock(s_still_framesize) != s_xclk_hz) {
+        restore_jpeg_profile();
+    }
+
+    if (xTaskCreatePinnedToCore(service_task, "camera_svc", CAMERA_SERVICE_STACK_SIZE, NULL,
+                                CAMERA_SERVICE_PRIORITY, NULL, CAMERA_SERVICE_CORE) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create camera service task");
+        return ESP_ERR_NO_MEM;
+    }
+
+    ESP_LOGI(TAG, "Camera service started on core %d", CAMERA_SERVICE_CORE);
+    return ESP_OK;
+}
+
+void camera_service_set_stream_sink(camera_frame_sink_t sink)
+{
+    s_stream_sink = sink;
+}
+
+void camera_service_set_yuv_stream_sink(camera_frame_sink_t sink)
+{
+    s_yuv_stream_sink = sink;
+}
+
+void camera_future_init(camera_future_t *future)
+{
+    future->done = xSemaphoreCreateBinaryStatic(&future->done_buf);
+    future->err = ESP_OK;
+    future->fb = NULL;
+}
+
+esp_err_t camera_service_submit(camera_request_t *req)
+{
+    req->enqueue_us = esp_timer_get_time();
+
+    // Stills are high priority: they jump ahead of queued requests
+    BaseType_t queued = (req->type == CAMERA_REQ_CAPTURE || req->type == CAMERA_REQ_CAPTURE_YUV)
+        ? xQueueSendToFront(s_queue, req, pdMS_TO_TICKS(CAMERA_SERVICE_SUBMIT_MS))
+        : xQueueSend(s_queue, req, pdMS_TO_TICKS(CAMERA_SERVICE_SUBMIT_MS));
+    if (queued != pdTRUE) {
+        ESP_LOGW(TAG, "Request queue full");
+        return ESP_ERR_TIMEOUT;
+    }
+    return ESP_OK;
+}
+
+esp_err_t camera_future_wait(camera_future_t *future)
+{
+    // The service always replies, so waiting forever cannot leak the future
+    xSemaphoreTake(future->done, portMAX_DELAY);
+    vSemaphoreDelete(future->done);
+    return future->err;
+}
+
+/**
+ * @brief Submit a request and wait for its reply
+ */
+static esp_err_t call(camera_request_t *req, camera_future_t *future)
+{
+    camera_future_init(future);
+    req->future = future;
+
+    esp_err_t err = camera_service_submit(req);
+    if (err != ESP_OK) {
+        vSemaphoreDelete(future->done);
+        return err;
+    }
+    return camera_future_wait(future);
+}
+
+camera_fb_t *camera_service_capture(void)
+{
+    camera_future_t future;
+    camera_request_t req = { .type = CAMERA_REQ_CAPTURE };
+
+    if (call(&req, &future) != ESP_OK) {
+        return NULL;
+    }
+    return future.fb;
+}
+
+esp_err_t camera_service_capture_yuv(framesize_t framesize, camera_fb_t **fb)
+{
+    camera_future_t future;
+    camera_request_t req = {
+        .type = CAMERA_REQ_CAPTURE_YUV,
+        .capture_yuv = { .framesize = framesize },
+    };
+
+    esp_err_t err = call(&req, &future);
+    *fb = (err == ESP_OK) ? future.fb : NULL;
+    return err;
+}
+
+void camera_service_release(camera_fb_t *fb)
+{
+    bool last = true;
+
+    if (fb == s_yuv_fb) {
+        s_yuv_fb = NULL;
+        esp_camera_fb_return(fb);
+        xSemaphoreGive(s_yuv_released);
+        return;
+    }
+
+    portENTER_CRITICAL(&s_shared_lock);
+    for (int i = 0; i < CAMERA_SHARED_FRAMES; i++) {
+        if (s_shared[i].fb == fb) {
+            if (--s_shared[i].refs > 0) {
+                last = false;
+            } else {
+                s_shared[i].fb = NULL;
+            }
+            break;
+        }
+    }
+    portEXIT_CRITICAL(&s_shared_lock);
+
+    if (!last) {
+        return;
+    }
+    if (is_clone(fb)) {
+        heap_caps_free(fb);
+    } else {
+        esp_camera_fb_return(fb);
+        if (atomic_fetch_sub(&s_jpeg_out, 1) == 1) {
+            xSemaphoreGive(s_jpeg_released);
+        }
+    }
+}
+
+esp_err_t camera_service_set_param(camera_param_t param, int value)
+{
+    camera_param_change_t change = { .param = param, .value = value };
+    return camera_service_set_params(&change, 1);
+}
+
+esp_err_t camera_service_set_params(const camera_param_change_t *changes, int count)
+{
+    camera_future_t future;
+    camera_request_t req = {
+        .type = CAMERA_REQ_SET_PARAM,
+        .set_param = { .changes = changes, .count = count },
+    };
+
+    if (count > CAMERA_PARAM_COUNT) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    // The service reads the changes in place; call() waits until it is done
+    return call(&req, &future);
+}
+
+esp_err_t camera_service_set_mode(camera_mode_t mode, framesize_t framesize, int quality)
+{
+    camera_future_t future;
+    camera_request_t req = {
+        .type = CAMERA_REQ_SET_MODE,
+        .set_mode = { .mode = mode, .framesize = framesize, .quality = quality },
+    };
+    return call(&req, &future);
+}
+
+esp_err_t camera_service_calibrate_xclk(void)
+{
+    camera_future_t future;
+    camera_request_t req = { .type = CAMERA_REQ_CALIBRATE_XCLK };
+    return call(&req, &future);
+}
+
+esp_err_t camera_service_get_status(camera_status_t *status)
+{
+    camera_future_t future;
+    camera_request_t req = { .type = CAMERA_REQ_GET_STATUS };
+
+    esp_err_t err = call(&req, &future);
+    if (err == ESP_OK) {
+        *status = future.status;
+    }
+    return err;
+}
+
+void camera_service_get_stats(camera_service_stats_t *stats)
+{
+    portENTER_CRITICAL(&s_stats_lock);
+    *stats = s_stats;
+    portEXIT_CRITICAL(&s_stats_lock);
+}
+
+const char *camera_mode_name(camera_mode_t mode)
+{
+    switch (mode) {
+        case CAMERA_MODE_STREAM:     return "stream";
+        case CAMERA_MODE_STREAM_YUV: return "yuv";
+        default:                     return "still";
+    }
+}
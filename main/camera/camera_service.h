@@ -0,0 +1,324 @@
+/**
+ * @file camera_service.h
+ * @brief Camera service task serializing all sensor and driver access
+ *
+ * A single task pinned to the camera driver's core owns the sensor. HTTP
+ * handlers and the stream pipeline never touch the sensor directly; they
+ * submit typed requests to the service's queue and wait on a future for
+ * the reply. Runs of compatible requests are batched: consecutive captures
+ * share one frame, consecutive parameter changes are persisted with a
+ * single NVS write.
+ *
+ * The service also produces stream frames while stream mode is active,
+ * handling queued requests between frames. Still captures are high
+ * priority: they are queued ahead of other requests and, while streaming,
+ * briefly switch the sensor to the still profile before resuming the
+ * stream.
+ */
+
+#ifndef CAMERA_SERVICE_H
+#define CAMERA_SERVICE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_camera.h"
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "camera/camera_params.h"
+
+/**
+ * @brief Sensor operating mode
+ */
+typedef enum {
+    CAMERA_MODE_STILL = 0,      // Idle at the still profile, frames on request
+    CAMERA_MODE_STREAM,         // Stream profile, frames pushed to the stream sink
+    CAMERA_MODE_STREAM_YUV,     // YUV422 frames pushed to the YUV stream sink
+} camera_mode_t;
+
+/**
+ * @brief Request types accepted by the service
+ */
+typedef enum {
+    CAMERA_REQ_CAPTURE = 0,     // Grab a still frame
+    CAMERA_REQ_SET_PARAM,       // Change one or more sensor parameters
+    CAMERA_REQ_SET_MODE,        // Switch between still and stream mode
+    CAMERA_REQ_GET_STATUS,      // Snapshot the sensor status
+    CAMERA_REQ_CAPTURE_YUV,     // Grab one uncompressed YUV422 frame
+    CAMERA_REQ_CALIBRATE_XCLK,  // Start a sensor clock calibration run
+} camera_req_type_t;
+
+/**
+ * @brief Reply slot completed by the service task
+ *
+ * Lives in the requester's memory (typically its stack) and must stay valid
+ * until camera_future_wait() has returned.
+ */
+typedef struct {
+    StaticSemaphore_t done_buf;
+    SemaphoreHandle_t done;
+    esp_err_t err;              // Request result
+    camera_fb_t *fb;            // CAPTURE(_YUV): frame, release with camera_service_release()
+    camera_status_t status;     // GET_STATUS: sensor status with the still profile
+} camera_future_t;
+
+/**
+ * @brief One parameter change for camera_service_set_params()
+ */
+typedef struct {
+    camera_param_t param;
+    int value;
+} camera_param_change_t;
+
+/**
+ * @brief A request submitted to the service
+ */
+typedef struct {
+    camera_req_type_t type;
+    union {
+        struct {
+            const camera_param_change_t *changes;   // Requester's memory, valid until completed
+            int count;
+        } set_param;
+        struct {
+            camera_mode_t mode;
+            framesize_t framesize;  // Stream framesize (either stream mode)
+            int quality;        // Stream JPEG quality (CAMERA_MODE_STREAM)
+        } set_mode;
+        struct {
+            framesize_t framesize;
+        } capture_yuv;
+    };
+    int64_t enqueue_us;         // Set by camera_service_submit()
+    camera_future_t *future;
+} camera_request_t;
+
+/**
+ * @brief Stream frame sink
+ *
+ * Called from the service task with each stream frame. gap_ms is non-zero
+ * on the first frame after a still capture interrupted the stream and holds
+ * the time since the previous stream frame. Returns true if the sink took
+ * ownership of the frame (to be released with camera_service_release()),
+ * false to have the service return it to the driver.
+ */
+typedef bool (*camera_frame_sink_t)(camera_fb_t *fb, int64_t timestamp_us, uint32_t gap_ms);
+
+/**
+ * @brief Service queueing statistics
+ */
+typedef struct {
+    uint32_t requests;          // Requests handled since boot
+    uint32_t batches;           // Batches processed since boot
+    uint32_t avg_queue_us;      // Average enqueue-to-dequeue latency
+    uint32_t max_queue_us;      // Worst enqueue-to-dequeue latency
+    uint32_t avg_service_us;    // Average dequeue-to-reply time
+    uint32_t stills;            // Still captures served since boot
+    uint32_t last_still_us;     // Submit-to-frame latency of the last still
+    uint32_t last_still_len;    // JPEG bytes of the last still
+    uint32_t avg_still_us;      // Average submit-to-frame still latency
+    uint32_t last_gap_ms;       // Stream gap caused by the last preempting still
+    uint32_t max_gap_ms;        // Worst stream gap since boot
+    camera_mode_t mode;         // Mode after the last completed request
+    framesize_t still_framesize; // Still profile after the last completed request
+    int still_quality;
+    uint32_t param_changes;     // Successful parameter changes since boot
+    uint32_t stream_fb_count;   // MJPEG stream driver buffers, 0 on the still driver
+    bool stream_fb_dram;        // MJPEG stream frames are in internal RAM
+    uint32_t fb_restarts;       // Driver restarts between still and stream drivers
+} camera_service_stats_t;
+
+/**
+ * @brief Start the camera service task
+ *
+ * Must be called after camera_init() and after saved settings have been
+ * applied; from then on only the service may touch the sensor.
+ *
+ * @return ESP_OK on success, error code otherwise
+ */
+esp_err_t camera_service_init(void);
+
+/**
+ * @brief Register the sink that receives stream frames
+ *
+ * Frames the sink keeps must not be held while blocking on a service
+ * request: mode changes may restart the driver, which waits for all of
+ * its frames to come back.
+ *
+ * @param sink Sink function
+ */
+void camera_service_set_stream_sink(camera_frame_sink_t sink);
+
+/**
+ * @brief Register the sink that receives YUV stream frames
+ *
+ * The sink must hold on to at most one frame at a time and reject frames
+ * offered while it holds one: the service tracks a single outstanding YUV
+ * frame and cannot restart the driver until it is released.
+ *
+ * @param sink Sink function
+ */
+void camera_service_set_yuv_stream_sink(camera_frame_sink_t sink);
+
+/**
+ * @brief Prepare a future for use with a request
+ *
+ * @param future Future to initialize
+ */
+void camera_future_init(camera_future_t *future);
+
+/**
+ * @brief Submit a request without waiting for it
+ *
+ * Capture requests (JPEG and YUV) are queued at the front, ahead of
+ * anything pending.
+ *
+ * @param req Request (copied); req->future must be initialized
+ * @return ESP_OK if queued, ESP_ERR_TIMEOUT if the queue stayed full
+ */
+esp_err_t camera_service_submit(camera_request_t *req);
+
+/**
+ * @brief Wait for a submitted request to complete
+ *
+ * @param future Future passed with the request
+ * @return The request's result code
+ */
+esp_err_t camera_future_wait(camera_future_t *future);
+
+/**
+ * @brief Capture a fresh still frame (blocking)
+ *
+ * Always uses the still profile. If a stream is running, its frame
+ * production pauses for the duration of the grab. A YUV stream, or an
+ * MJPEG stream with its buffers in internal RAM, needs two driver
+ * restarts for this, so the pause is much longer.
+ *
+ * @return Frame buffer, release with camera_service_release(); NULL on failure
+ */
+camera_fb_t *camera_service_capture(void);
+
+/**
+ * @brief Capture one YUV422 frame (blocking)
+ *
+ * Restarts the driver in YUV422 mode at the given framesize, grabs a frame
+ * and hands it over. The service pauses until the frame is released, then
+ * restores the JPEG profile and sensor settings, so release it as soon as
+ * possible. Not available while streaming.
+ *
+ * @param framesize Frame size to capture at
+ * @param fb Receives the frame, release with camera_service_release()
+ * @return ESP_OK on success, ESP_ERR_INVALID_STATE while streaming,
+ *         ESP_ERR_NOT_SUPPORTED if CONFIG_GROWPOD_YUV_MULTIRES is disabled,
+ *         other error codes on driver failure
+ */
+esp_err_t camera_service_capture_yuv(framesize_t framesize, camera_fb_t **fb);
+
+/**
+ * @brief Release a frame obtained from the service
+ *
+ * Frames shared between batched capture requests are returned to the
+ * driver once the last holder releases them. Safe to call from any task.
+ *
+ * @param fb Frame buffer
+ */
+void camera_service_release(camera_fb_t *fb);
+
+/**
+ * @brief Change a sensor parameter (blocking)
+ *
+ * While streaming, framesize and quality changes update the still profile
+ * that is restored when the stream ends. Successful changes are persisted
+ * to NVS.
+ *
+ * @param param Parameter id
+ * @param value New value
+ * @return ESP_OK on success, ESP_FAIL if the sensor rejected the value
+ */
+esp_err_t camera_service_set_param(camera_param_t param, int value);
+
+/**
+ * @brief Change several sensor parameters (blocking)
+ *
+ * The changes go to the service as one request, so they are applied
+ * together, with nothing else in between and a single NVS write. Changes
+ * are applied in order; one the sensor rejects does not stop the others.
+ *
+ * @param changes Changes to apply
+ * @param count Number of changes, at most CAMERA_PARAM_COUNT
+ * @return ESP_OK if all were applied, ESP_FAIL if the sensor rejected
+ *         any, ESP_ERR_INVALID_ARG for too many changes, or the queueing
+ *         error
+ */
+esp_err_t camera_service_set_params(const camera_param_change_t *changes, int count);
+
+/**
+ * @brief Switch between still and stream mode (blocking)
+ *
+ * Once this returns with CAMERA_MODE_STILL, no further frames are pushed
+ * to the stream sink. Calling it again in stream mode changes the stream
+ * profile without leaving stream mode.
+ *
+ * CAMERA_MODE_STREAM restarts the driver with CONFIG_GROWPOD_STREAM_FB_COUNT
+ * buffers sized for the stream profile and grab-latest, in internal RAM if
+ * they fit (see fb_placement.h). Stills then need a driver restart each
+ * way. With a single buffer that does not fit internal RAM the stream
+ * runs on the still driver instead. Stream sinks keep their frames
+ * across the restart.
+ *
+ * CAMERA_MODE_STREAM_YUV restarts the driver in YUV422 mode with two frame
+ * buffers, and leaving it restores the JPEG still profile. The two stream
+ * modes exclude each other: one has to be left before the other is entered.
+ *
+ * @param mode New mode
+ * @param framesize Stream framesize (ignored for CAMERA_MODE_STILL)
+ * @param quality Stream JPEG quality (CAMERA_MODE_STREAM only)
+ * @return ESP_OK on success, ESP_ERR_INVALID_STATE while the other stream
+ *         mode is active or a calibration runs, ESP_ERR_NOT_SUPPORTED for CAMERA_MODE_STREAM_YUV
+ *         if CONFIG_GROWPOD_H264_STREAM is disabled, other error codes on
+ *         driver failure
+ */
+esp_err_t camera_service_set_mode(camera_mode_t mode, framesize_t framesize, int quality);
+
+/**
+ * @brief Start a sensor clock calibration run (see xclk_cal.h)
+ *
+ * Returns once the run has started. The service then restarts the driver
+ * at every candidate clock for every calibrated framesize, a few seconds
+ * each, and restores the still profile at the new clock when done. Until
+ * then every request but status is refused with ESP_ERR_INVALID_STATE.
+ * Progress and results are read with xclk_cal_progress() and
+ * xclk_cal_entry().
+ *
+ * @return ESP_OK once started, ESP_ERR_INVALID_STATE while streaming or
+ *         calibrating, ESP_ERR_NOT_SUPPORTED if CONFIG_GROWPOD_XCLK_CAL is
+ *         disabled, or the queueing error
+ */
+esp_err_t camera_service_calibrate_xclk(void);
+
+/**
+ * @brief Get the sensor status (blocking)
+ *
+ * framesize and quality report the still profile even while streaming.
+ *
+ * @param status Pointer to structure to populate
+ * @return ESP_OK on success, error code otherwise
+ */
+esp_err_t camera_service_get_status(camera_status_t *status);
+
+/**
+ * @brief Get the service queueing statistics
+ *
+ * @param stats Pointer to structure to populate
+ */
+void camera_service_get_stats(camera_service_stats_t *stats);
+
+/**
+ * @brief Get a mode's short name
+ *
+ * @param mode Camera mode
+ * @return "still", "stream" or "yuv"
+ */
+const char *camera_mode_name(camera_mode_t mode);
+
+#endif // CAMERA_SERVICE_H
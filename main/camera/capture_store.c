@@ -0,0 +1,72 @@
+/**
+ * @file capture_store.c
+ * @brief Copy of the most recent still capture
+ */
+
+#include "camera/capture_store.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_heap_caps.h"
+#include "freertos/FreeRTOS.h"
+#include <string.h>
+
+static const char *TAG = "capture_store";
+
+static capture_snapshot_t *s_latest;
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+
+esp_err_t capture_store_put(const camera_fb_t *fb)
+{
+    if (fb->format != PIXFORMAT_JPEG) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    // Header and data in one PSRAM block
+    capture_snapshot_t *snap = heap_caps_malloc(sizeof(capture_snapshot_t) + fb->len,
+                                                MALLOC_CAP_SPIRAM);
+    if (snap == NULL) {
+        ESP_LOGW(TAG, "No PSRAM for a %u byte copy", fb->len);
+        return ESP_ERR_NO_MEM;
+    }
+    memcpy(snap + 1, fb->buf, fb->len);
+    snap->data = (const uint8_t *)(snap + 1);
+    snap->len = fb->len;
+    snap->width = fb->width;
+    snap->height = fb->height;
+    snap->timestamp_us = esp_timer_get_time();
+    snap->refs = 1;                     // The store's own reference
+
+    portENTER_CRITICAL(&s_lock);
+    capture_snapshot_t *old = s_latest;
+    s_latest = snap;
+    portEXIT_CRITICAL(&s_lock);
+
+    capture_store_release(old);
+    return ESP_OK;
+}
+
+capture_snapshot_t *capture_store_get(void)
+{
+    portENTER_CRITICAL(&s_lock);
+    capture_snapshot_t *snap = s_latest;
+    if (snap) {
+        snap->refs++;
+    }
+    portEXIT_CRITICAL(&s_lock);
+    return snap;
+}
+
+void capture_store_release(capture_snapshot_t *snap)
+{
+    if (snap == NULL) {
+        return;
+    }
+
+    portENTER_CRITICAL(&s_lock);
+    bool last = --snap->refs == 0;
+    portEXIT_CRITICAL(&s_lock);
+
+    if (last) {
+        heap_caps_free(snap);
+    }
+}
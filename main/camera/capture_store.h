@@ -0,0 +1,56 @@
+/**
+ * @file capture_store.h
+ * @brief Copy of the most recent still capture
+ *
+ * Keeps the last JPEG served by /capture in PSRAM so it can be delivered
+ * again later, e.g. requantized for a slow link, without re-capturing.
+ * Readers take a reference to an immutable snapshot; storing a new capture
+ * replaces the snapshot while existing readers keep the old one until they
+ * release it.
+ */
+
+#ifndef CAPTURE_STORE_H
+#define CAPTURE_STORE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_camera.h"
+#include "esp_err.h"
+
+/**
+ * @brief Stored capture
+ */
+typedef struct {
+    const uint8_t *data;        // JPEG data
+    size_t len;
+    uint16_t width;
+    uint16_t height;
+    int64_t timestamp_us;       // esp_timer time of the capture
+    int refs;                   // Owned by capture_store
+} capture_snapshot_t;
+
+/**
+ * @brief Store a copy of a captured JPEG frame
+ *
+ * @param fb JPEG frame
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG for non-JPEG frames,
+ *         ESP_ERR_NO_MEM if PSRAM is exhausted
+ */
+esp_err_t capture_store_put(const camera_fb_t *fb);
+
+/**
+ * @brief Get a reference to the latest capture
+ *
+ * @return Snapshot to release with capture_store_release(), or NULL if
+ *         nothing was captured yet
+ */
+capture_snapshot_t *capture_store_get(void);
+
+/**
+ * @brief Release a snapshot reference
+ *
+ * @param snap Snapshot from capture_store_get(), may be NULL
+ */
+void capture_store_release(capture_snapshot_t *snap);
+
+#endif // CAPTURE_STORE_H
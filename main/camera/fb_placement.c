@@ -0,0 +1,104 @@
+/**
+ * @file fb_placement.c
+ * @brief Frame buffer size and placement implementation
+ */
+
+#include "camera/fb_placement.h"
+
+// JPEG headers, tables and markers
+#define JPEG_OVERHEAD 1024
+
+/**
+ * @brief Candidate driver framesizes, smallest first
+ *
+ * mbpp is a typical JPEG at quality 10 in thousandths of a byte per
+ * pixel, from the stream ladder's frame sizes.
+ */
+static const struct {
+    framesize_t framesize;
+    int width;
+    int height;
+    int mbpp;
+} SIZES[] = {
+    { FRAMESIZE_QVGA, 320,  240,  140 },
+    { FRAMESIZE_CIF,  400,  296,  120 },
+    { FRAMESIZE_HVGA, 480,  320,  100 },
+    { FRAMESIZE_VGA,  640,  480,  80 },
+    { FRAMESIZE_SVGA, 800,  600,  76 },
+    { FRAMESIZE_XGA,  1024, 768,  72 },
+};
+
+#define SIZE_COUNT (int)(sizeof(SIZES) / sizeof(SIZES[0]))
+
+static int size_index(framesize_t framesize)
+{
+    for (int i = 0; i < SIZE_COUNT; i++) {
+        if (SIZES[i].framesize == framesize) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+size_t fb_placement_buffer_bytes(framesize_t framesize)
+{
+    int i = size_index(framesize);
+    return i < 0 ? 0 : (size_t)SIZES[i].width * SIZES[i].height / 5;
+}
+
+size_t fb_placement_jpeg_worst(framesize_t framesize, int quality)
+{
+    int i = size_index(framesize);
+    if (i < 0) {
+        return 0;
+    }
+    if (quality < 0) {
+        quality = 0;
+    }
+    // Size goes roughly with 1 / (quality + 2); x1.5 margin, x12 for q10
+    size_t pixels = (size_t)SIZES[i].width * SIZES[i].height;
+    return JPEG_OVERHEAD + pixels * SIZES[i].mbpp * 18 / (1000 * (quality + 2));
+}
+
+void fb_placement_plan(framesize_t framesize, int quality, size_t fb_count,
+                       size_t dram_free, size_t dram_largest, size_t dram_reserve,
+                       fb_plan_t *plan)
+{
+    *plan = (fb_plan_t){
+        .still_driver = true,
+        .location = CAMERA_FB_IN_PSRAM,
+        .framesize = framesize,
+        .fb_count = fb_count,
+        .jpeg_worst = fb_placement_jpeg_worst(framesize, quality),
+    };
+
+    int first = size_index(framesize);
+    if (first < 0) {
+        return;
+    }
+    for (int i = first; i < SIZE_COUNT; i++) {
+        // Smallest buffer that holds the frame; a larger one only costs more
+        size_t bytes = fb_placement_buffer_bytes(SIZES[i].framesize);
+        if (bytes < plan->jpeg_worst) {
+            continue;
+        }
+        plan->framesize = SIZES[i].framesize;
+        plan->fb_bytes = bytes;
+        if (bytes <= dram_largest && bytes * fb_count + dram_reserve <= dram_free) {
+            plan->still_driver = false;
+            plan->location = CAMERA_FB_IN_DRAM;
+        } else if (fb_count > 1) {
+            plan->still_driver = false;
+        }
+        return;
+    }
+}
+
+bool fb_placement_covers(const fb_plan_t *current, framesize_t framesize, int quality)
+{
+    int have = size_index(current->framesize);
+    int want = size_index(framesize);
+
+    return !current->still_driver && have >= 0 && want >= 0 && want <= have &&
+           fb_placement_jpeg_worst(framesize, quality) <= current->fb_bytes;
+}
@@ -0,0 +1,88 @@
+/**
+ * @file fb_placement.h
+ * @brief Frame buffer count, size and placement for a stream profile
+ *
+ * esp32-camera sizes each JPEG frame buffer from the framesize it was
+ * started with (width x height / 5) and cannot grow it afterwards. The
+ * still driver starts at QXGA with one 629 KB PSRAM buffer, so a stream
+ * on it sends every frame from PSRAM, and the sensor cannot fill the next
+ * frame while the current one is being sent.
+ *
+ * The plan gives the stream a driver of its own, started at the smallest
+ * framesize that is at least the stream's and whose buffers hold a
+ * worst-case JPEG at the stream's quality. The buffers go to internal
+ * DMA-capable RAM if the budget allows, which lwIP and the camera DMA
+ * read and write much faster, and to PSRAM otherwise. A stream with a
+ * single PSRAM buffer gains nothing from its own driver and stays on the
+ * still driver.
+ *
+ * No ESP-IDF dependencies beyond the camera types: the internal RAM
+ * budget is passed in.
+ */
+
+#ifndef FB_PLACEMENT_H
+#define FB_PLACEMENT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "esp_camera.h"
+
+/**
+ * @brief Driver setup for a stream profile
+ */
+typedef struct {
+    bool still_driver;          // Stream runs on the still driver; the rest is unused
+    camera_fb_location_t location;
+    framesize_t framesize;      // Framesize the driver is started at
+    size_t fb_count;
+    size_t fb_bytes;            // Per buffer
+    size_t jpeg_worst;          // Worst-case JPEG of the stream profile
+} fb_plan_t;
+
+/**
+ * @brief Bytes esp32-camera allocates per JPEG buffer at a framesize
+ *
+ * @return 0 for framesizes the stream never uses
+ */
+size_t fb_placement_buffer_bytes(framesize_t framesize);
+
+/**
+ * @brief Worst-case JPEG size of a framesize and quality
+ *
+ * Scaled from the stream ladder's typical OV2640/OV3660 frame sizes with
+ * a 1.5x margin for detailed, noisy scenes. Smaller frames cost more per
+ * pixel: the same scene downscaled has more detail per pixel.
+ *
+ * @return 0 for framesizes the stream never uses
+ */
+size_t fb_placement_jpeg_worst(framesize_t framesize, int quality);
+
+/**
+ * @brief Plan the driver for a stream profile
+ *
+ * Framesizes above XGA always stay on the still driver.
+ *
+ * @param framesize Stream framesize
+ * @param quality Stream JPEG quality (0-63, lower is better)
+ * @param fb_count Buffers the stream's driver should have
+ * @param dram_free Free internal DMA-capable RAM, 0 to keep buffers in PSRAM
+ * @param dram_largest Its largest free block
+ * @param dram_reserve Internal RAM that must stay free for WiFi and lwIP
+ * @param plan Receives the plan
+ */
+void fb_placement_plan(framesize_t framesize, int quality, size_t fb_count,
+                       size_t dram_free, size_t dram_largest, size_t dram_reserve,
+                       fb_plan_t *plan);
+
+/**
+ * @brief Whether a running stream driver can serve another profile
+ *        without a restart
+ *
+ * True if the new framesize is no larger than the driver's and its
+ * worst-case JPEG still fits the buffers. Keeps adaptive rung changes
+ * from restarting the driver each time. Always false for the still
+ * driver.
+ */
+bool fb_placement_covers(const fb_plan_t *current, framesize_t framesize, int quality);
+
+#endif // FB_PLACEMENT_H
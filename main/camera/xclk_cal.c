@@ -0,0 +1,332 @@
+/**
+ * @file xclk_cal.c
+ * @brief Per-framesize sensor clock calibration implementation
+ */
+
+#include "camera/xclk_cal.h"
+#include "camera/camera.h"
+#include "camera/camera_params.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "nvs.h"
+#include <string.h>
+
+static const char *TAG = "xclk_cal";
+
+// Kept apart from the camera settings so either can be reset on its own
+#define NVS_NAMESPACE "xclk_cal"
+#define NVS_KEY "table"
+
+// Increment when the table layout, clocks or framesizes change
+#define XCLK_CAL_VERSION 1
+
+// A faster clock must beat a slower one by more than this to win
+#define XCLK_CAL_MARGIN_PERCENT 3
+
+// Within the 6-27 MHz the OV3660 takes, around the 20 MHz default
+static const uint32_t CLOCKS[XCLK_CAL_CLOCKS] = {
+    10000000, 16000000, 20000000, 24000000,
+};
+
+/**
+ * @brief Calibrated framesizes: the stream ladder's and the still sizes
+ *
+ * Each is measured at the quality it is normally used at, which sets how
+ * much data crosses the bus per frame.
+ */
+static const struct {
+    framesize_t framesize;
+    int quality;
+} SIZES[XCLK_CAL_SIZES] = {
+    { FRAMESIZE_QVGA, 12 },
+    { FRAMESIZE_VGA,  10 },
+    { FRAMESIZE_SVGA, 10 },
+    { FRAMESIZE_XGA,  10 },
+    { FRAMESIZE_SXGA, 4 },
+    { FRAMESIZE_UXGA, 4 },
+    { FRAMESIZE_QXGA, 4 },
+};
+
+/**
+ * @brief Calibration table as stored in NVS
+ */
+typedef struct {
+    uint8_t version;
+    uint8_t calibrated;         // Bit per size index
+    xclk_cal_entry_t entries[XCLK_CAL_SIZES];
+} cal_table_t;
+
+static cal_table_t s_table;     // In use
+static cal_table_t s_run;       // Being collected
+static bool s_running;
+static int s_done;
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+
+esp_err_t xclk_cal_init(void)
+{
+    nvs_handle_t nvs_handle;
+    cal_table_t table;
+
+    esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READONLY, &nvs_handle);
+    if (err == ESP_OK) {
+        size_t size = sizeof(table);
+        err = nvs_get_blob(nvs_handle, NVS_KEY, &table, &size);
+        nvs_close(nvs_handle);
+    }
+    if (err != ESP_OK) {
+        if (err == ESP_ERR_NVS_NOT_FOUND) {
+            ESP_LOGI(TAG, "No calibration saved, XCLK %lu MHz for all framesizes",
+                     (unsigned long)(CAMERA_XCLK_DEFAULT_HZ / 1000000));
+        } else {
+            ESP_LOGE(TAG, "Error reading calibration: %s", esp_err_to_name(err));
+        }
+        return err;
+    }
+    if (table.version != XCLK_CAL_VERSION) {
+        ESP_LOGW(TAG, "Calibration version mismatch (saved: %d, current: %d), ignoring it",
+                 table.version, XCLK_CAL_VERSION);
+        return ESP_ERR_INVALID_VERSION;
+    }
+
+    portENTER_CRITICAL(&s_lock);
+    s_table = table;
+    portEXIT_CRITICAL(&s_lock);
+
+    for (int i = 0; i < XCLK_CAL_SIZES; i++) {
+        if (table.calibrated & (1u << i)) {
+            ESP_LOGI(TAG, "  %s: XCLK %lu MHz", camera_framesize_name(SIZES[i].framesize),
+                     (unsigned long)(xclk_cal_get(SIZES[i].framesize) / 1000000));
+        }
+    }
+    return ESP_OK;
+}
+
+static int size_index(framesize_t framesize)
+{
+    for (int i = 0; i < XCLK_CAL_SIZES; i++) {
+        if (SIZES[i].framesize == framesize) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+uint32_t xclk_cal_get(framesize_t framesize)
+{
+    uint32_t hz = 0;
+    int i = size_index(framesize);
+
+    if (i >= 0) {
+        portENTER_CRITICAL(&s_lock);
+        if (s_table.calibrated & (1u << i)) {
+            hz = s_table.entries[i].xclk_hz;
+        }
+        portEXIT_CRITICAL(&s_lock);
+    }
+    return hz != 0 ? hz : CAMERA_XCLK_DEFAULT_HZ;
+}
+
+uint32_t xclk_cal_clock_hz(int clock)
+{
+    return CLOCKS[clock];
+}
+
+framesize_t xclk_cal_framesize(int size, int *quality)
+{
+    *quality = SIZES[size].quality;
+    return SIZES[size].framesize;
+}
+
+void xclk_cal_measure(const int64_t *stamps_us, int count, int truncated,
+                      xclk_cal_point_t *point)
+{
+    uint32_t intervals[XCLK_CAL_MAX_FRAMES];
+    int n = 0;
+    int lost = 0;
+
+    if (count > XCLK_CAL_MAX_FRAMES) {
+        count = XCLK_CAL_MAX_FRAMES;
+    }
+    for (int i = 0; i < count; i++) {
+        if (stamps_us[i] == 0) {
+            lost++;
+        } else if (i > 0 && stamps_us[i - 1] != 0 && stamps_us[i] > stamps_us[i - 1]) {
+            intervals[n++] = (uint32_t)(stamps_us[i] - stamps_us[i - 1]);
+        }
+    }
+
+    point->measured = true;
+    point->interval_us = 0;
+    point->error_permille = 1000;
+    if (n == 0) {
+        return;
+    }
+
+    // Insertion sort; there are only a few dozen
+    for (int i = 1; i < n; i++) {
+        uint32_t v = intervals[i];
+        int j = i;
+        for (; j > 0 && intervals[j - 1] > v; j--) {
+            intervals[j] = intervals[j - 1];
+        }
+        intervals[j] = v;
+    }
+    uint32_t median = intervals[n / 2];
+
+    // A gap of k intervals hides k - 1 frames the driver dropped
+    int skipped = 0;
+    for (int i = 0; i < n; i++) {
+        if (intervals[i] > median + median / 2) {
+            skipped += (int)((intervals[i] + median / 2) / median) - 1;
+        }
+    }
+
+    int slots = count + skipped;
+    int errors = lost + truncated + skipped;
+    point->interval_us = median;
+    point->error_permille = (uint16_t)(errors >= slots ? 1000 : errors * 1000 / slots);
+}
+
+int xclk_cal_pick(const xclk_cal_point_t *points)
+{
+    int best = -1;
+
+    // Clocks ascend, so a later clock has to be clearly faster to win
+    for (int i = 0; i < XCLK_CAL_CLOCKS; i++) {
+        const xclk_cal_point_t *p = &points[i];
+        if (!p->measured || p->interval_us == 0 ||
+            p->error_permille > XCLK_CAL_MAX_ERR_PERMILLE) {
+            continue;
+        }
+        if (best < 0 ||
+            (uint64_t)p->interval_us * 100 <
+            (uint64_t)points[best].interval_us * (100 - XCLK_CAL_MARGIN_PERCENT)) {
+            best = i;
+        }
+    }
+    return best;
+}
+
+void xclk_cal_begin(void)
+{
+    memset(&s_run, 0, sizeof(s_run));
+    s_run.version = XCLK_CAL_VERSION;
+    for (int i = 0; i < XCLK_CAL_SIZES; i++) {
+        s_run.entries[i].framesize = SIZES[i].framesize;
+        s_run.entries[i].quality = SIZES[i].quality;
+    }
+
+    portENTER_CRITICAL(&s_lock);
+    s_running = true;
+    s_done = 0;
+    portEXIT_CRITICAL(&s_lock);
+}
+
+void xclk_cal_record(int size, int clock, const xclk_cal_point_t *point)
+{
+    s_run.entries[size].points[clock] = *point;
+
+    portENTER_CRITICAL(&s_lock);
+    s_done++;
+    portEXIT_CRITICAL(&s_lock);
+}
+
+/**
+ * @brief Write a table to NVS
+ */
+static esp_err_t save_table(const cal_table_t *table)
+{
+    nvs_handle_t nvs_handle;
+
+    esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READWRITE, &nvs_handle);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Error opening NVS handle: %s", esp_err_to_name(err));
+        return err;
+    }
+    err = nvs_set_blob(nvs_handle, NVS_KEY, table, sizeof(*table));
+    if (err == ESP_OK) {
+        err = nvs_commit(nvs_handle);
+    }
+    nvs_close(nvs_handle);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Error saving calibration: %s", esp_err_to_name(err));
+    }
+    return err;
+}
+
+esp_err_t xclk_cal_finish(void)
+{
+    for (int i = 0; i < XCLK_CAL_SIZES; i++) {
+        xclk_cal_entry_t *e = &s_run.entries[i];
+        int best = xclk_cal_pick(e->points);
+
+        e->xclk_hz = best < 0 ? 0 : CLOCKS[best];
+        s_run.calibrated |= (uint8_t)(1u << i);
+        if (best < 0) {
+            ESP_LOGW(TAG, "%s: no stable clock, keeping %lu MHz",
+                     camera_framesize_name(e->framesize),
+                     (unsigned long)(CAMERA_XCLK_DEFAULT_HZ / 1000000));
+        } else {
+            ESP_LOGI(TAG, "%s: XCLK %lu MHz (%lu us/frame, %u permille errors, %lu bytes)",
+                     camera_framesize_name(e->framesize), (unsigned long)(e->xclk_hz / 1000000),
+                     (unsigned long)e->points[best].interval_us,
+                     e->points[best].error_permille,
+                     (unsigned long)e->points[best].jpeg_bytes);
+        }
+    }
+
+    portENTER_CRITICAL(&s_lock);
+    s_table = s_run;
+    s_running = false;
+    portEXIT_CRITICAL(&s_lock);
+
+    return save_table(&s_run);
+}
+
+esp_err_t xclk_cal_clear(void)
+{
+    nvs_handle_t nvs_handle;
+
+    portENTER_CRITICAL(&s_lock);
+    memset(&s_table, 0, sizeof(s_table));
+    portEXIT_CRITICAL(&s_lock);
+
+    esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READWRITE, &nvs_handle);
+    if (err != ESP_OK) {
+        return err;
+    }
+    err = nvs_erase_key(nvs_handle, NVS_KEY);
+    if (err == ESP_OK) {
+        err = nvs_commit(nvs_handle);
+    }
+    nvs_close(nvs_handle);
+    if (err == ESP_ERR_NVS_NOT_FOUND) {
+        err = ESP_OK;
+    }
+    ESP_LOGI(TAG, "Calibration cleared");
+    return err;
+}
+
+bool xclk_cal_entry(int size, xclk_cal_entry_t *entry)
+{
+    portENTER_CRITICAL(&s_lock);
+    bool calibrated = (s_table.calibrated & (1u << size)) != 0;
+    *entry = s_table.entries[size];
+    portEXIT_CRITICAL(&s_lock);
+
+    if (!calibrated) {
+        memset(entry, 0, sizeof(*entry));
+        entry->framesize = SIZES[size].framesize;
+        entry->quality = SIZES[size].quality;
+    }
+    return calibrated;
+}
+
+bool xclk_cal_progress(int *done)
+{
+    portENTER_CRITICAL(&s_lock);
+    bool running = s_running;
+    *done = s_done;
+    portEXIT_CRITICAL(&s_lock);
+    return running;
+}
@@ -0,0 +1,172 @@
+/**
+ * @file xclk_cal.h
+ * @brief Per-framesize sensor clock calibration
+ *
+ * The sensor's frame rate follows its XCLK, but a faster clock also means
+ * more data per second on the DVP bus: at large framesizes the DMA can
+ * fall behind, and frames arrive truncated or are dropped. Which clock is
+ * best depends on the framesize, the JPEG quality and the board.
+ *
+ * A calibration run (driven by the camera service) restarts the driver at
+ * each candidate clock for each framesize and measures the median frame
+ * interval, the share of lost, truncated and skipped frames, and the
+ * average JPEG size. The fastest clock whose error rate stays within
+ * XCLK_CAL_MAX_ERR_PERMILLE is chosen; clocks within 3% of it lose to the
+ * lower one, which leaves the bus more slack. The table is kept in NVS,
+ * and profiles at a calibrated framesize start the driver with its clock.
+ *
+ * esp32-camera derives PCLK from XCLK through the sensor's own PLL setup,
+ * so XCLK is the only clock that can be chosen here.
+ */
+
+#ifndef XCLK_CAL_H
+#define XCLK_CAL_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_camera.h"
+#include "esp_err.h"
+
+// Candidate clocks and calibrated framesizes
+#define XCLK_CAL_CLOCKS         4
+#define XCLK_CAL_SIZES          7
+#define XCLK_CAL_POINTS         (XCLK_CAL_CLOCKS * XCLK_CAL_SIZES)
+
+// Most frames a measurement can take
+#define XCLK_CAL_MAX_FRAMES     64
+
+// A clock with more lost, truncated or skipped frames is not stable
+#define XCLK_CAL_MAX_ERR_PERMILLE 20
+
+/**
+ * @brief Measurement of one framesize at one clock
+ */
+typedef struct {
+    uint32_t interval_us;       // Median frame interval, 0 if no frames arrived
+    uint16_t error_permille;    // Lost, truncated and skipped frames
+    bool measured;
+    uint32_t jpeg_bytes;        // Average JPEG size
+} xclk_cal_point_t;
+
+/**
+ * @brief Calibration result for one framesize
+ */
+typedef struct {
+    framesize_t framesize;
+    int quality;                // JPEG quality the points were measured at
+    uint32_t xclk_hz;           // Chosen clock, 0 if none was stable
+    xclk_cal_point_t points[XCLK_CAL_CLOCKS];
+} xclk_cal_entry_t;
+
+/**
+ * @brief Load the calibration table from NVS
+ *
+ * Call after settings_init() and before camera_service_init(). Without a
+ * saved table every framesize uses CAMERA_XCLK_DEFAULT_HZ.
+ *
+ * @return ESP_OK on success, ESP_ERR_NVS_NOT_FOUND if nothing was saved,
+ *         other error codes on NVS failure
+ */
+esp_err_t xclk_cal_init(void);
+
+/**
+ * @brief Clock to start the driver with for a framesize
+ *
+ * @param framesize Frame size the sensor runs at
+ * @return The calibrated clock, CAMERA_XCLK_DEFAULT_HZ if there is none
+ */
+uint32_t xclk_cal_get(framesize_t framesize);
+
+/**
+ * @brief Candidate clock of a calibration point
+ *
+ * @param clock Clock index, 0 to XCLK_CAL_CLOCKS - 1
+ * @return Clock in Hz
+ */
+uint32_t xclk_cal_clock_hz(int clock);
+
+/**
+ * @brief Framesize and JPEG quality of a calibration point
+ *
+ * @param size Size index, 0 to XCLK_CAL_SIZES - 1
+ * @param quality Receives the JPEG quality to measure at
+ * @return Frame size
+ */
+framesize_t xclk_cal_framesize(int size, int *quality);
+
+/**
+ * @brief Turn captured frame timestamps into a measurement
+ *
+ * Frames further apart than 1.5 median intervals count the frames that
+ * should have arrived in between as skipped. A zero timestamp marks a
+ * grab that timed out; it counts as lost and breaks the interval chain.
+ * Sets interval_us, error_permille and measured; jpeg_bytes is left to
+ * the caller.
+ *
+ * @param stamps_us Frame timestamps in arrival order
+ * @param count Number of timestamps, at most XCLK_CAL_MAX_FRAMES
+ * @param truncated Frames among them that were not a complete JPEG
+ * @param point Measurement to populate
+ */
+void xclk_cal_measure(const int64_t *stamps_us, int count, int truncated,
+                      xclk_cal_point_t *point);
+
+/**
+ * @brief Choose the best stable clock from a framesize's measurements
+ *
+ * @param points XCLK_CAL_CLOCKS measurements, by clock index
+ * @return Clock index, -1 if no clock was stable
+ */
+int xclk_cal_pick(const xclk_cal_point_t *points);
+
+/**
+ * @brief Start collecting a new table
+ *
+ * The current table stays in use until xclk_cal_finish().
+ */
+void xclk_cal_begin(void);
+
+/**
+ * @brief Store one measurement of the run in progress
+ *
+ * @param size Size index
+ * @param clock Clock index
+ * @param point Measurement
+ */
+void xclk_cal_record(int size, int clock, const xclk_cal_point_t *point);
+
+/**
+ * @brief Pick each framesize's clock, publish the table and save it to NVS
+ *
+ * @return ESP_OK on success, NVS error code otherwise (the table is in use
+ *         regardless)
+ */
+esp_err_t xclk_cal_finish(void);
+
+/**
+ * @brief Forget the table in memory and in NVS
+ *
+ * Drivers already started keep their clock until the next restart.
+ *
+ * @return ESP_OK on success, NVS error code otherwise
+ */
+esp_err_t xclk_cal_clear(void);
+
+/**
+ * @brief Get a framesize's entry of the table in use
+ *
+ * @param size Size index
+ * @param entry Receives the entry
+ * @return true if the framesize has been calibrated
+ */
+bool xclk_cal_entry(int size, xclk_cal_entry_t *entry);
+
+/**
+ * @brief Progress of the run in progress
+ *
+ * @param done Receives the points measured so far
+ * @return true while a run is in progress
+ */
+bool xclk_cal_progress(int *done);
+
+#endif // XCLK_CAL_H
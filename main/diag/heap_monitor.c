@@ -0,0 +1,299 @@
+/**
+ * @file heap_monitor.c
+ * @brief Heap and PSRAM fragmentation monitor implementation
+ */
+
+#include "diag/heap_monitor.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_heap_caps.h"
+#include "esp_memory_utils.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#if CONFIG_GROWPOD_HEAP_SITES
+#include "esp_heap_trace.h"
+#endif
+#include <string.h>
+
+static const char *TAG = "heap_monitor";
+
+#define HEAP_MONITOR_PRIORITY   1
+#define HEAP_MONITOR_STACK_SIZE 2560
+
+static const uint32_t CAPS[HEAP_MON_COUNT] = {
+    [HEAP_MON_INTERNAL] = MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT,
+    [HEAP_MON_DMA]      = MALLOC_CAP_DMA,
+    [HEAP_MON_PSRAM]    = MALLOC_CAP_SPIRAM,
+};
+
+static const char *const CAP_NAMES[HEAP_MON_COUNT] = {
+    [HEAP_MON_INTERNAL] = "internal",
+    [HEAP_MON_DMA]      = "dma",
+    [HEAP_MON_PSRAM]    = "psram",
+};
+
+// Written by the sampler and the failure callback, read by the web
+// server; all under s_lock
+static heap_mon_stats_t s_stats[HEAP_MON_COUNT];
+static heap_mon_point_t *s_history;     // HEAP_MON_COUNT x HEAP_MONITOR_HISTORY, in PSRAM
+static uint32_t s_samples;
+static heap_mon_failure_t s_failures[HEAP_MONITOR_FAILURES];
+static uint32_t s_failed;
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+
+// Sampler only
+static bool s_still_fb_fits = true;
+
+#if CONFIG_GROWPOD_HEAP_SITES
+static heap_trace_record_t *s_records;
+#endif
+
+static uint16_t frag_permille(uint32_t free, uint32_t largest)
+{
+    return free ? 1000 - (uint64_t)largest * 1000 / free : 0;
+}
+
+static void take_sample(void)
+{
+    int64_t now = esp_timer_get_time();
+
+    for (int cap = 0; cap < HEAP_MON_COUNT; cap++) {
+        // Walks the heap under its lock, so outside our own
+        multi_heap_info_t info;
+        heap_caps_get_info(&info, CAPS[cap]);
+        uint16_t frag = frag_permille(info.total_free_bytes, info.largest_free_block);
+
+        portENTER_CRITICAL(&s_lock);
+        heap_mon_stats_t *st = &s_stats[cap];
+        st->free = info.total_free_bytes;
+        st->largest = info.largest_free_block;
+        st->allocated = info.total_allocated_bytes;
+        st->min_free = info.minimum_free_bytes;
+        st->blocks = info.allocated_blocks;
+        st->free_blocks = info.free_blocks;
+        st->frag_permille = frag;
+        if (frag > st->frag_max_permille) {
+            st->frag_max_permille = frag;
+        }
+        if (s_samples == 0 || st->largest < st->largest_min) {
+            st->largest_min = st->largest;
+            st->largest_min_at_us = now;
+        }
+        s_history[cap * HEAP_MONITOR_HISTORY + s_samples % HEAP_MONITOR_HISTORY] =
+            (heap_mon_point_t){ st->free, st->largest };
+        portEXIT_CRITICAL(&s_lock);
+    }
+
+    portENTER_CRITICAL(&s_lock);
+    s_samples++;
+    uint32_t free = s_stats[HEAP_MON_PSRAM].free;
+    uint32_t largest = s_stats[HEAP_MON_PSRAM].largest;
+    portEXIT_CRITICAL(&s_lock);
+
+    // Only fragmentation is worth a warning: with too little free PSRAM
+    // altogether the largest block is small for a plainer reason
+    bool fits = largest >= HEAP_MONITOR_STILL_FB_BYTES || free < HEAP_MONITOR_STILL_FB_BYTES;
+    if (fits != s_still_fb_fits) {
+        if (!fits) {
+            ESP_LOGW(TAG, "PSRAM fragmented: %lu bytes free but the largest block is %lu, "
+                     "a QXGA frame buffer needs %u",
+                     (unsigned long)free, (unsigned long)largest, HEAP_MONITOR_STILL_FB_BYTES);
+        } else {
+            ESP_LOGI(TAG, "PSRAM largest block back to %lu bytes", (unsigned long)largest);
+        }
+        s_still_fb_fits = fits;
+    }
+}
+
+static void sample_task(void *arg)
+{
+    TickType_t wake = xTaskGetTickCount();
+
+    for (;;) {
+        vTaskDelayUntil(&wake, pdMS_TO_TICKS(CONFIG_GROWPOD_HEAP_MONITOR_PERIOD_S * 1000));
+        take_sample();
+    }
+}
+
+/**
+ * @brief heap_caps failure callback, runs in the allocating task
+ */
+static void on_alloc_failed(size_t size, uint32_t caps, const char *function_name)
+{
+    // Outside the heap locks here, so the heap can be asked again
+    heap_mon_failure_t failure = {
+        .at_us = esp_timer_get_time(),
+        .size = size,
+        .caps = caps,
+        .free = heap_caps_get_free_size(caps),
+        .largest = heap_caps_get_largest_free_block(caps),
+    };
+
+    portENTER_CRITICAL(&s_lock);
+    s_failures[s_failed++ % HEAP_MONITOR_FAILURES] = failure;
+    portEXIT_CRITICAL(&s_lock);
+
+    ESP_EARLY_LOGW(TAG, "%s(%u, 0x%lx) failed: %lu free, largest block %lu",
+                   function_name, (unsigned)size, (unsigned long)caps,
+                   (unsigned long)failure.free, (unsigned long)failure.largest);
+}
+
+esp_err_t heap_monitor_init(void)
+{
+    s_history = heap_caps_calloc(HEAP_MON_COUNT * HEAP_MONITOR_HISTORY, sizeof(heap_mon_point_t),
+                                 MALLOC_CAP_SPIRAM);
+    if (s_history == NULL) {
+        ESP_LOGE(TAG, "Failed to allocate history");
+        return ESP_ERR_NO_MEM;
+    }
+    take_sample();
+
+    esp_err_t err = heap_caps_register_failed_alloc_callback(on_alloc_failed);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to register allocation failure callback");
+        return err;
+    }
+
+#if CONFIG_GROWPOD_HEAP_SITES
+    // The trace buffer has to be in internal RAM; debug builds only
+    s_records = heap_caps_calloc(CONFIG_GROWPOD_HEAP_SITES_RECORDS, sizeof(heap_trace_record_t),
+                                 MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    if (s_records == NULL ||
+        heap_trace_init_standalone(s_records, CONFIG_GROWPOD_HEAP_SITES_RECORDS) != ESP_OK ||
+        heap_trace_start(HEAP_TRACE_LEAKS) != ESP_OK) {
+        ESP_LOGW(TAG, "Allocation site tracing unavailable");
+    }
+#endif
+
+    if (xTaskCreatePinnedToCore(sample_task, "heap_monitor", HEAP_MONITOR_STACK_SIZE, NULL,
+                                HEAP_MONITOR_PRIORITY, NULL, tskNO_AFFINITY) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create sampler task");
+        return ESP_ERR_NO_MEM;
+    }
+
+    ESP_LOGI(TAG, "Heap monitor ready (every %d s, PSRAM %lu free, largest %lu)",
+             CONFIG_GROWPOD_HEAP_MONITOR_PERIOD_S,
+             (unsigned long)s_stats[HEAP_MON_PSRAM].free,
+             (unsigned long)s_stats[HEAP_MON_PSRAM].largest);
+    return ESP_OK;
+}
+
+void heap_monitor_get_stats(heap_mon_cap_t cap, heap_mon_stats_t *stats)
+{
+    portENTER_CRITICAL(&s_lock);
+    *stats = s_stats[cap];
+    portEXIT_CRITICAL(&s_lock);
+}
+
+int heap_monitor_get_history(heap_mon_cap_t cap, heap_mon_point_t *points, int max_points)
+{
+    if (s_history == NULL) {
+        return 0;
+    }
+
+    portENTER_CRITICAL(&s_lock);
+    uint32_t stored = s_samples < HEAP_MONITOR_HISTORY ? s_samples : HEAP_MONITOR_HISTORY;
+    int n = stored < (uint32_t)max_points ? (int)stored : max_points;
+    // The newest n, oldest first
+    for (int i = 0; i < n; i++) {
+        points[i] = s_history[cap * HEAP_MONITOR_HISTORY + (s_samples - n + i) % HEAP_MONITOR_HISTORY];
+    }
+    portEXIT_CRITICAL(&s_lock);
+    return n;
+}
+
+bool heap_monitor_get_failure(int index, heap_mon_failure_t *failure)
+{
+    bool found = false;
+
+    portENTER_CRITICAL(&s_lock);
+    uint32_t stored = s_failed < HEAP_MONITOR_FAILURES ? s_failed : HEAP_MONITOR_FAILURES;
+    if (index >= 0 && (uint32_t)index < stored) {
+        *failure = s_failures[(s_failed - 1 - index) % HEAP_MONITOR_FAILURES];
+        found = true;
+    }
+    portEXIT_CRITICAL(&s_lock);
+    return found;
+}
+
+uint32_t heap_monitor_failures(void)
+{
+    return s_failed;
+}
+
+const char *heap_monitor_cap_name(heap_mon_cap_t cap)
+{
+    return cap < HEAP_MON_COUNT ? CAP_NAMES[cap] : "unknown";
+}
+
+#if CONFIG_GROWPOD_HEAP_SITES
+static bool same_stack(const heap_mon_site_t *site, const heap_trace_record_t *rec)
+{
+    for (int f = 0; f < CONFIG_HEAP_TRACING_STACK_DEPTH; f++) {
+        if (site->callers[f] != (uint32_t)(uintptr_t)rec->alloced_by[f]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+int heap_monitor_get_sites(heap_mon_site_t *sites, int max_sites, heap_mon_trace_t *trace)
+{
+    heap_trace_summary_t summary;
+    int n = 0;
+
+    memset(trace, 0, sizeof(*trace));
+    if (s_records == NULL || max_sites < 1 || heap_trace_summary(&summary) != ESP_OK) {
+        return 0;
+    }
+    trace->records = summary.count;
+    trace->capacity = summary.capacity;
+    trace->overflowed = summary.has_overflowed;
+
+    for (size_t i = 0; i < summary.count; i++) {
+        heap_trace_record_t rec;
+        if (heap_trace_get(i, &rec) != ESP_OK) {
+            break;
+        }
+
+        heap_mon_site_t *site = NULL;
+        for (int s = 0; s < n && site == NULL; s++) {
+            if (same_stack(&sites[s], &rec)) {
+                site = &sites[s];
+            }
+        }
+        if (site == NULL) {
+            if (n < max_sites - 1) {
+                site = &sites[n++];
+                memset(site, 0, sizeof(*site));
+                for (int f = 0; f < CONFIG_HEAP_TRACING_STACK_DEPTH; f++) {
+                    site->callers[f] = (uint32_t)(uintptr_t)rec.alloced_by[f];
+                }
+            } else {
+                // Stacks past the first max_sites - 1 share the last slot
+                site = &sites[max_sites - 1];
+                if (n < max_sites) {
+                    memset(site, 0, sizeof(*site));
+                    n = max_sites;
+                }
+            }
+        }
+        site->count++;
+        site->bytes += rec.size;
+        if (esp_ptr_external_ram(rec.address)) {
+            site->psram_bytes += rec.size;
+        }
+    }
+
+    // Most bytes first; at most HEAP_MONITOR_SITES, so insertion sort
+    for (int i = 1; i < n; i++) {
+        heap_mon_site_t site = sites[i];
+        int j = i;
+        for (; j > 0 && sites[j - 1].bytes < site.bytes; j--) {
+            sites[j] = sites[j - 1];
+        }
+        sites[j] = site;
+    }
+    return n;
+}
+#endif
@@ -0,0 +1,140 @@
+/**
+ * @file heap_monitor.h
+ * @brief Heap and PSRAM fragmentation monitor
+ *
+ * A low-priority task samples free bytes against the largest free block
+ * for internal, DMA-capable and PSRAM memory, keeping a short history and
+ * the worst values since boot. Failed allocations are caught through the
+ * heap_caps failure callback with the free and largest sizes at the time,
+ * which is what tells fragmentation apart from running out of memory.
+ *
+ * With CONFIG_GROWPOD_HEAP_SITES (debug builds, needs
+ * CONFIG_HEAP_TRACING_STANDALONE) live allocations are traced and grouped
+ * by their call stack, to be resolved with addr2line.
+ */
+
+#ifndef HEAP_MONITOR_H
+#define HEAP_MONITOR_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+// Samples kept per capability
+#define HEAP_MONITOR_HISTORY    60
+// Failed allocations kept
+#define HEAP_MONITOR_FAILURES   8
+// Call sites reported
+#define HEAP_MONITOR_SITES      24
+
+// The QXGA JPEG frame buffer esp32-camera allocates (width x height / 5),
+// the largest single block the firmware needs after boot
+#define HEAP_MONITOR_STILL_FB_BYTES (2048 * 1536 / 5)
+
+typedef enum {
+    HEAP_MON_INTERNAL,
+    HEAP_MON_DMA,
+    HEAP_MON_PSRAM,
+    HEAP_MON_COUNT
+} heap_mon_cap_t;
+
+/**
+ * @brief One history sample
+ */
+typedef struct {
+    uint32_t free;
+    uint32_t largest;
+} heap_mon_point_t;
+
+/**
+ * @brief Latest sample of a capability and its worst values since boot
+ */
+typedef struct {
+    uint32_t free;
+    uint32_t largest;           // Largest free block
+    uint32_t allocated;
+    uint32_t min_free;          // Low-water mark kept by the heap
+    uint32_t blocks;            // Allocated blocks
+    uint32_t free_blocks;
+    uint16_t frag_permille;     // 1000 - 1000 * largest / free
+    uint16_t frag_max_permille;
+    uint32_t largest_min;       // Smallest largest block seen
+    int64_t largest_min_at_us;
+} heap_mon_stats_t;
+
+/**
+ * @brief An allocation that failed
+ */
+typedef struct {
+    int64_t at_us;
+    uint32_t size;
+    uint32_t caps;              // MALLOC_CAP_* asked for
+    uint32_t free;              // For those caps, right after the failure
+    uint32_t largest;
+} heap_mon_failure_t;
+
+#if CONFIG_GROWPOD_HEAP_SITES
+/**
+ * @brief Live allocations sharing a call stack
+ */
+typedef struct {
+    uint32_t callers[CONFIG_HEAP_TRACING_STACK_DEPTH];
+    uint32_t count;
+    uint32_t bytes;
+    uint32_t psram_bytes;
+} heap_mon_site_t;
+
+/**
+ * @brief State of the trace buffer
+ */
+typedef struct {
+    uint32_t records;           // Live allocations traced
+    uint32_t capacity;
+    bool overflowed;            // Allocations were missed
+} heap_mon_trace_t;
+#endif
+
+/**
+ * @brief Take the first sample, hook allocation failures and start sampling
+ */
+esp_err_t heap_monitor_init(void);
+
+void heap_monitor_get_stats(heap_mon_cap_t cap, heap_mon_stats_t *stats);
+
+/**
+ * @brief Copy the history of a capability, oldest first
+ *
+ * @return Points copied
+ */
+int heap_monitor_get_history(heap_mon_cap_t cap, heap_mon_point_t *points, int max_points);
+
+/**
+ * @brief Copy a failed allocation, newest first
+ *
+ * @param index 0 for the newest
+ * @return false past the oldest record
+ */
+bool heap_monitor_get_failure(int index, heap_mon_failure_t *failure);
+
+/**
+ * @brief Allocation failures since boot
+ */
+uint32_t heap_monitor_failures(void);
+
+const char *heap_monitor_cap_name(heap_mon_cap_t cap);
+
+#if CONFIG_GROWPOD_HEAP_SITES
+/**
+ * @brief Group the traced live allocations by call stack
+ *
+ * @param sites Receives the sites, most bytes first; once max_sites - 1
+ *              stacks are taken, the rest share one site with an
+ *              all-zero stack
+ * @param max_sites Capacity of sites
+ * @param trace Receives the trace buffer state
+ * @return Sites filled
+ */
+int heap_monitor_get_sites(heap_mon_site_t *sites, int max_sites, heap_mon_trace_t *trace);
+#endif
+
+#endif // HEAP_MONITOR_H
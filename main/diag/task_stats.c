@@ -0,0 +1,192 @@
+/**
+ * @file task_stats.c
+ * @brief Task statistics sampler implementation
+ */
+
+#include "diag/task_stats.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_heap_caps.h"
+#include "esp_memory_utils.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include <string.h>
+
+static const char *TAG = "task_stats";
+
+#define TASK_STATS_PERIOD_MS    1000
+#define TASK_STATS_PRIORITY     1
+#define TASK_STATS_STACK_SIZE   2560
+
+// One more sample than the window: a window of N seconds spans N + 1
+#define TASK_STATS_RING         (CONFIG_GROWPOD_TASK_STATS_WINDOW_S + 1)
+
+typedef struct {
+    UBaseType_t number;         // xTaskNumber, stable for the task's lifetime
+    uint32_t runtime;
+} task_time_t;
+
+typedef struct {
+    uint32_t total;             // Run-time counter at the sample
+    int64_t at_us;
+    int count;
+    task_time_t tasks[TASK_STATS_MAX_TASKS];
+} sample_t;
+
+// Both live in PSRAM; s_lock guards them
+static sample_t *s_ring;
+static TaskStatus_t *s_status;  // Full status of the latest sample
+static int s_status_count;
+static uint32_t s_taken;        // Samples taken since boot
+static SemaphoreHandle_t s_lock;
+
+static void take_sample(void)
+{
+    configRUN_TIME_COUNTER_TYPE total;
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    UBaseType_t count = uxTaskGetSystemState(s_status, TASK_STATS_MAX_TASKS, &total);
+    if (count == 0) {
+        // More tasks than TASK_STATS_MAX_TASKS; keep the previous samples
+        xSemaphoreGive(s_lock);
+        ESP_LOGW(TAG, "More than %d tasks, sample skipped", TASK_STATS_MAX_TASKS);
+        return;
+    }
+    sample_t *sample = &s_ring[s_taken % TASK_STATS_RING];
+    sample->total = total;
+    sample->at_us = esp_timer_get_time();
+    sample->count = count;
+    for (int i = 0; i < sample->count; i++) {
+        sample->tasks[i].number = s_status[i].xTaskNumber;
+        sample->tasks[i].runtime = s_status[i].ulRunTimeCounter;
+    }
+    s_status_count = count;
+    s_taken++;
+    xSemaphoreGive(s_lock);
+}
+
+static void sample_task(void *arg)
+{
+    TickType_t wake = xTaskGetTickCount();
+
+    for (;;) {
+        take_sample();
+        vTaskDelayUntil(&wake, pdMS_TO_TICKS(TASK_STATS_PERIOD_MS));
+    }
+}
+
+static char state_letter(eTaskState state)
+{
+    switch (state) {
+        case eRunning:   return 'X';
+        case eReady:     return 'R';
+        case eBlocked:   return 'B';
+        case eSuspended: return 'S';
+        case eDeleted:   return 'D';
+        default:         return '?';
+    }
+}
+
+/**
+ * @brief Run time of a task in an older sample, 0 if it did not exist yet
+ */
+static uint32_t runtime_in(const sample_t *sample, UBaseType_t number)
+{
+    for (int i = 0; i < sample->count; i++) {
+        if (sample->tasks[i].number == number) {
+            return sample->tasks[i].runtime;
+        }
+    }
+    return 0;
+}
+
+esp_err_t task_stats_init(void)
+{
+    s_ring = heap_caps_calloc(TASK_STATS_RING, sizeof(sample_t), MALLOC_CAP_SPIRAM);
+    s_status = heap_caps_calloc(TASK_STATS_MAX_TASKS, sizeof(TaskStatus_t), MALLOC_CAP_SPIRAM);
+    if (s_ring == NULL || s_status == NULL) {
+        ESP_LOGE(TAG, "Failed to allocate sample ring");
+        return ESP_ERR_NO_MEM;
+    }
+
+    // Created last: task_stats_get() takes a NULL lock as not started
+    s_lock = xSemaphoreCreateMutex();
+    if (s_lock == NULL) {
+        ESP_LOGE(TAG, "Failed to create lock");
+        return ESP_ERR_NO_MEM;
+    }
+
+    if (xTaskCreatePinnedToCore(sample_task, "task_stats", TASK_STATS_STACK_SIZE, NULL,
+                                TASK_STATS_PRIORITY, NULL, tskNO_AFFINITY) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create sampler task");
+        return ESP_ERR_NO_MEM;
+    }
+
+    ESP_LOGI(TAG, "Task statistics ready (%d s window, %u bytes of PSRAM)",
+             CONFIG_GROWPOD_TASK_STATS_WINDOW_S,
+             (unsigned)(TASK_STATS_RING * sizeof(sample_t) + TASK_STATS_MAX_TASKS * sizeof(TaskStatus_t)));
+    return ESP_OK;
+}
+
+esp_err_t task_stats_get(int window_s, task_stats_row_t *rows, int max_rows,
+                         task_stats_summary_t *summary)
+{
+    if (s_lock == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    if (s_taken < 2) {
+        xSemaphoreGive(s_lock);
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    int available = s_taken - 1 < TASK_STATS_RING - 1 ? s_taken - 1 : TASK_STATS_RING - 1;
+    int back = window_s < 1 ? 1 : window_s > available ? available : window_s;
+    const sample_t *now = &s_ring[(s_taken - 1) % TASK_STATS_RING];
+    const sample_t *old = &s_ring[(s_taken - 1 - back) % TASK_STATS_RING];
+    // Counters wrap; unsigned differences stay right over any window
+    uint32_t elapsed = now->total - old->total;
+
+    memset(summary, 0, sizeof(*summary));
+    summary->window_ms = (now->at_us - old->at_us) / 1000;
+    summary->tasks_total = s_status_count;
+
+    int n = 0;
+    for (int i = 0; i < s_status_count && n < max_rows; i++) {
+        const TaskStatus_t *st = &s_status[i];
+        task_stats_row_t *row = &rows[n++];
+        uint32_t used = st->ulRunTimeCounter - runtime_in(old, st->xTaskNumber);
+
+        strlcpy(row->name, st->pcTaskName, sizeof(row->name));
+        row->priority = st->uxCurrentPriority;
+#if CONFIG_FREERTOS_VTASKLIST_INCLUDE_COREID
+        row->core = st->xCoreID == tskNO_AFFINITY ? -1 : st->xCoreID;
+#else
+        row->core = -1;
+#endif
+        row->state = state_letter(st->eCurrentState);
+        row->cpu_permille = elapsed ? (uint64_t)used * 1000 / elapsed : 0;
+        // StackType_t is a byte on this port, so the mark is in bytes
+        row->stack_free_min = st->usStackHighWaterMark;
+        row->stack_in_psram = esp_ptr_external_ram(st->pxStackBase);
+
+        if (strncmp(row->name, "IDLE", 4) == 0 && row->core >= 0 &&
+            row->core < portNUM_PROCESSORS) {
+            summary->core_load_permille[row->core] =
+                row->cpu_permille < 1000 ? 1000 - row->cpu_permille : 0;
+        }
+    }
+    xSemaphoreGive(s_lock);
+
+    // Busiest first; a handful of rows, so insertion sort
+    for (int i = 1; i < n; i++) {
+        task_stats_row_t row = rows[i];
+        int j = i;
+        for (; j > 0 && rows[j - 1].cpu_permille < row.cpu_permille; j--) {
+            rows[j] = rows[j - 1];
+        }
+        rows[j] = row;
+    }
+    summary->tasks = n;
+    return ESP_OK;
+}
@@ -0,0 +1,64 @@
+/**
+ * @file task_stats.h
+ * @brief Per-task CPU share and stack high-water marks
+ *
+ * A low-priority task samples FreeRTOS run-time stats once a second into
+ * a ring in PSRAM. CPU shares are taken over a sliding window of those
+ * samples, so a query reports recent load rather than load since boot.
+ * Needs CONFIG_FREERTOS_USE_TRACE_FACILITY and
+ * CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS (set in sdkconfig.defaults).
+ */
+
+#ifndef TASK_STATS_H
+#define TASK_STATS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+
+// Tasks tracked; more are left out of the report
+#define TASK_STATS_MAX_TASKS    40
+
+/**
+ * @brief One task over the window
+ */
+typedef struct {
+    char name[configMAX_TASK_NAME_LEN];
+    uint8_t priority;           // Current (possibly inherited) priority
+    int8_t core;                // Pinned core, -1 if unpinned
+    char state;                 // As vTaskList(): X running, R ready, B blocked, S suspended, D deleted
+    uint16_t cpu_permille;      // Share of one core over the window
+    uint32_t stack_free_min;    // Stack bytes never used since the task started
+    bool stack_in_psram;
+} task_stats_row_t;
+
+/**
+ * @brief Window summary
+ */
+typedef struct {
+    uint32_t window_ms;         // Time actually covered
+    uint16_t core_load_permille[portNUM_PROCESSORS]; // 1000 minus the idle task's share
+    int tasks;                  // Rows filled
+    int tasks_total;            // Tasks that exist, may exceed the rows
+} task_stats_summary_t;
+
+/**
+ * @brief Allocate the sample ring and start sampling
+ */
+esp_err_t task_stats_init(void);
+
+/**
+ * @brief Per-task figures over the last window_s seconds
+ *
+ * @param window_s Window length, clamped to 1..CONFIG_GROWPOD_TASK_STATS_WINDOW_S
+ *                 (and to the samples taken so far)
+ * @param rows Receives the tasks, highest CPU share first
+ * @param max_rows Capacity of rows
+ * @param summary Receives the window length and per-core load
+ * @return ESP_OK, or ESP_ERR_INVALID_STATE before the second sample
+ */
+esp_err_t task_stats_get(int window_s, task_stats_row_t *rows, int max_rows,
+                         task_stats_summary_t *summary);
+
+#endif // TASK_STATS_H
@@ -0,0 +1,126 @@
+/**
+ * @file h264_bits.h
+ * @brief NAL unit bit writer with emulation prevention
+ *
+ * Writes Annex B byte stream into a caller-owned buffer: start codes go out
+ * verbatim, RBSP bits get an emulation_prevention_three_byte after any two
+ * zero bytes followed by a byte <= 3 (7.4.1).
+ */
+
+#ifndef H264_BITS_H
+#define H264_BITS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct {
+    uint8_t *buf;
+    size_t cap;
+    size_t len;
+    bool overflow;              // Set once the buffer filled; later bytes drop
+    uint32_t bit_acc;
+    int bit_count;
+    int zeros;                  // Consecutive zero bytes just written
+} h264_bits_t;
+
+static inline void h264_bits_init(h264_bits_t *b, uint8_t *buf, size_t cap)
+{
+    b->buf = buf;
+    b->cap = cap;
+    b->len = 0;
+    b->overflow = false;
+    b->bit_acc = 0;
+    b->bit_count = 0;
+    b->zeros = 0;
+}
+
+static inline void h264_bits_raw_byte(h264_bits_t *b, uint8_t byte)
+{
+    if (b->len == b->cap) {
+        b->overflow = true;
+        return;
+    }
+    b->buf[b->len++] = byte;
+}
+
+static inline void h264_bits_byte(h264_bits_t *b, uint8_t byte)
+{
+    if (b->zeros >= 2 && byte <= 3) {
+        h264_bits_raw_byte(b, 0x03);
+        b->zeros = 0;
+    }
+    h264_bits_raw_byte(b, byte);
+    b->zeros = byte == 0 ? b->zeros + 1 : 0;
+}
+
+/**
+ * @brief Append up to 24 bits, most significant first
+ */
+static inline void h264_bits_put(h264_bits_t *b, uint32_t code, int size)
+{
+    b->bit_acc = (b->bit_acc << size) | code;
+    b->bit_count += size;
+    while (b->bit_count >= 8) {
+        b->bit_count -= 8;
+        h264_bits_byte(b, (b->bit_acc >> b->bit_count) & 0xff);
+    }
+}
+
+/**
+ * @brief Unsigned Exp-Golomb code, ue(v)
+ */
+static inline void h264_bits_ue(h264_bits_t *b, uint32_t value)
+{
+    uint32_t v = value + 1;
+    int size = 32 - __builtin_clz(v);
+
+    if (size > 1) {
+        h264_bits_put(b, 0, size - 1);
+    }
+    h264_bits_put(b, v, size);
+}
+
+/**
+ * @brief Signed Exp-Golomb code, se(v)
+ */
+static inline void h264_bits_se(h264_bits_t *b, int value)
+{
+    h264_bits_ue(b, value > 0 ? 2 * value - 1 : -2 * value);
+}
+
+/**
+ * @brief Length in bits of se(v), for rate estimates
+ */
+static inline int h264_bits_se_size(int value)
+{
+    uint32_t v = (value > 0 ? 2 * value - 1 : -2 * value) + 1;
+    return 2 * (32 - __builtin_clz(v)) - 1;
+}
+
+/**
+ * @brief Start a NAL unit: 4-byte start code and the NAL header
+ */
+static inline void h264_bits_nal_start(h264_bits_t *b, int ref_idc, int type)
+{
+    h264_bits_raw_byte(b, 0);
+    h264_bits_raw_byte(b, 0);
+    h264_bits_raw_byte(b, 0);
+    h264_bits_raw_byte(b, 1);
+    h264_bits_raw_byte(b, (ref_idc << 5) | type);
+    b->zeros = 0;
+}
+
+/**
+ * @brief rbsp_trailing_bits(): stop bit and zero alignment
+ */
+static inline void h264_bits_trailing(h264_bits_t *b)
+{
+    h264_bits_put(b, 1, 1);
+    if (b->bit_count > 0) {
+        h264_bits_put(b, 0, 8 - b->bit_count);
+    }
+    b->bit_acc = 0;
+}
+
+#endif // H264_BITS_H
@@ -0,0 +1,112 @@
+/**
+ * @file h264_cavlc.c
+ * @brief CAVLC residual block coding implementation
+ */
+
+#include "h264/h264_cavlc.h"
+#include "h264/h264_tables.h"
+
+/**
+ * @brief level_prefix and level_suffix for one levelCode (9.2.2.1)
+ */
+static void write_level(h264_bits_t *b, int code, int suffix_len)
+{
+    if (suffix_len == 0) {
+        if (code < 14) {
+            h264_bits_put(b, 1, code + 1);
+        } else if (code < 30) {
+            h264_bits_put(b, 1, 15);
+            h264_bits_put(b, code - 14, 4);
+        } else {
+            h264_bits_put(b, 1, 16);
+            h264_bits_put(b, code - 30, 12);
+        }
+    } else if (code < (15 << suffix_len)) {
+        h264_bits_put(b, 1, (code >> suffix_len) + 1);
+        h264_bits_put(b, code & ((1 << suffix_len) - 1), suffix_len);
+    } else {
+        h264_bits_put(b, 1, 16);
+        h264_bits_put(b, code - (15 << suffix_len), 12);
+    }
+}
+
+int h264_cavlc_block(h264_bits_t *b, const int16_t *coef, int count, int nc)
+{
+    int level[16];
+    int run[16];                // Zeros between each level and the next lower one
+    int total = 0;
+    int last = count - 1;
+
+    while (last >= 0 && coef[last] == 0) {
+        last--;
+    }
+    for (int i = last; i >= 0; i--) {
+        if (coef[i] != 0) {
+            level[total] = coef[i];
+            run[total] = 0;
+            total++;
+        } else {
+            run[total - 1]++;
+        }
+    }
+    int total_zeros = last + 1 - total;
+
+    int trailing = 0;
+    while (trailing < total && trailing < 3 &&
+           (level[trailing] == 1 || level[trailing] == -1)) {
+        trailing++;
+    }
+
+    // coeff_token
+    if (nc < 0) {
+        h264_bits_put(b, h264_chroma_dc_coeff_token_bits[total][trailing],
+                      h264_chroma_dc_coeff_token_len[total][trailing]);
+    } else {
+        int table = nc < 2 ? 0 : nc < 4 ? 1 : nc < 8 ? 2 : 3;
+        h264_bits_put(b, h264_coeff_token_bits[table][total][trailing],
+                      h264_coeff_token_len[table][total][trailing]);
+    }
+    if (total == 0) {
+        return 0;
+    }
+
+    // Trailing one signs, then the remaining levels, highest frequency first
+    for (int k = 0; k < trailing; k++) {
+        h264_bits_put(b, level[k] < 0, 1);
+    }
+    int suffix_len = total > 10 && trailing < 3 ? 1 : 0;
+    for (int k = trailing; k < total; k++) {
+        int v = level[k];
+        int code = v > 0 ? 2 * v - 2 : -2 * v - 1;
+        if (k == trailing && trailing < 3) {
+            code -= 2;
+        }
+        write_level(b, code, suffix_len);
+
+        if (suffix_len == 0) {
+            suffix_len = 1;
+        }
+        if ((v < 0 ? -v : v) > (3 << (suffix_len - 1)) && suffix_len < 6) {
+            suffix_len++;
+        }
+    }
+
+    // total_zeros and run_before
+    if (total < count) {
+        if (nc < 0) {
+            h264_bits_put(b, h264_chroma_dc_total_zeros_bits[total - 1][total_zeros],
+                          h264_chroma_dc_total_zeros_len[total - 1][total_zeros]);
+        } else {
+            h264_bits_put(b, h264_total_zeros_bits[total - 1][total_zeros],
+                          h264_total_zeros_len[total - 1][total_zeros]);
+        }
+    }
+    int zeros_left = total_zeros;
+    for (int k = 0; k < total - 1 && zeros_left > 0; k++) {
+        int table = (zeros_left < 7 ? zeros_left : 7) - 1;
+        h264_bits_put(b, h264_run_before_bits[table][run[k]],
+                      h264_run_before_len[table][run[k]]);
+        zeros_left -= run[k];
+    }
+    return total;
+}
@@ -0,0 +1,26 @@
+/**
+ * @file h264_cavlc.h
+ * @brief CAVLC residual block coding (ITU-T H.264 clause 9.2)
+ */
+
+#ifndef H264_CAVLC_H
+#define H264_CAVLC_H
+
+#include <stdint.h>
+#include "h264/h264_bits.h"
+
+// Largest level magnitude the Baseline escape (level_prefix 15) can carry
+#define H264_CAVLC_MAX_LEVEL 2047
+
+/**
+ * @brief Write residual_block_cavlc() for one block
+ *
+ * @param b Bit writer
+ * @param coef Levels in scan order, magnitudes up to H264_CAVLC_MAX_LEVEL
+ * @param count maxNumCoeff: 4 for chroma DC, 15 for AC blocks, 16 otherwise
+ * @param nc Predicted nC from the neighbouring blocks, -1 for chroma DC
+ * @return TotalCoeff of the block
+ */
+int h264_cavlc_block(h264_bits_t *b, const int16_t *coef, int count, int nc);
+
+#endif // H264_CAVLC_H
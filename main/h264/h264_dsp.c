@@ -0,0 +1,309 @@
+/**
+ * @file h264_dsp.c
+ * @brief Transform, quantization and deblocking primitives implementation
+ */
+
+#include "h264/h264_dsp.h"
+#include "h264/h264_cavlc.h"
+#include "h264/h264_tables.h"
+#include <stdlib.h>
+
+// Quantization position class of each raster position, see h264_quant_mf
+static const uint8_t s_pos_class[16] = {
+    0, 2, 0, 2,
+    2, 1, 2, 1,
+    0, 2, 0, 2,
+    2, 1, 2, 1,
+};
+
+static inline uint8_t clip1(int v)
+{
+    return v < 0 ? 0 : v > 255 ? 255 : v;
+}
+
+static inline int clip3(int lo, int hi, int v)
+{
+    return v < lo ? lo : v > hi ? hi : v;
+}
+
+void h264_dsp_sub_dct4(int16_t out[16], const uint8_t *src, int stride,
+                       const uint8_t *pred, int pred_stride)
+{
+    int tmp[16];
+
+    for (int i = 0; i < 4; i++) {
+        int d0 = src[0] - pred[0];
+        int d1 = src[1] - pred[1];
+        int d2 = src[2] - pred[2];
+        int d3 = src[3] - pred[3];
+        int s0 = d0 + d3, s3 = d0 - d3;
+        int s1 = d1 + d2, s2 = d1 - d2;
+        tmp[i * 4 + 0] = s0 + s1;
+        tmp[i * 4 + 1] = 2 * s3 + s2;
+        tmp[i * 4 + 2] = s0 - s1;
+        tmp[i * 4 + 3] = s3 - 2 * s2;
+        src += stride;
+        pred += pred_stride;
+    }
+    for (int j = 0; j < 4; j++) {
+        int s0 = tmp[j] + tmp[12 + j], s3 = tmp[j] - tmp[12 + j];
+        int s1 = tmp[4 + j] + tmp[8 + j], s2 = tmp[4 + j] - tmp[8 + j];
+        out[j] = s0 + s1;
+        out[4 + j] = 2 * s3 + s2;
+        out[8 + j] = s0 - s1;
+        out[12 + j] = s3 - 2 * s2;
+    }
+}
+
+static inline int16_t quant(int v, int mf, int round, int shift)
+{
+    int level = ((v < 0 ? -v : v) * mf + round) >> shift;
+
+    level = level > H264_CAVLC_MAX_LEVEL ? H264_CAVLC_MAX_LEVEL : level;
+    return v < 0 ? -level : level;
+}
+
+int h264_dsp_quant4(int16_t c[16], int qp, bool intra, int first)
+{
+    int qbits = 15 + qp / 6;
+    int round = (1 << qbits) / (intra ? 3 : 6);
+    const uint16_t *mf = h264_quant_mf[qp % 6];
+    int nonzero = 0;
+
+    for (int i = first; i < 16; i++) {
+        c[i] = quant(c[i], mf[s_pos_class[i]], round, qbits);
+        nonzero += c[i] != 0;
+    }
+    return nonzero;
+}
+
+void h264_dsp_dequant4(int16_t c[16], int qp, int first)
+{
+    const uint8_t *v = h264_dequant_v[qp % 6];
+    int shift = qp / 6;
+
+    for (int i = first; i < 16; i++) {
+        c[i] = (c[i] * v[s_pos_class[i]]) << shift;
+    }
+}
+
+void h264_dsp_idct4_add(uint8_t *dst, int stride, const uint8_t *pred, int pred_stride,
+                        const int16_t c[16])
+{
+    int tmp[16];
+
+    for (int i = 0; i < 4; i++) {
+        const int16_t *d = c + i * 4;
+        int e0 = d[0] + d[2], e1 = d[0] - d[2];
+        int e2 = (d[1] >> 1) - d[3], e3 = d[1] + (d[3] >> 1);
+        tmp[i * 4 + 0] = e0 + e3;
+        tmp[i * 4 + 1] = e1 + e2;
+        tmp[i * 4 + 2] = e1 - e2;
+        tmp[i * 4 + 3] = e0 - e3;
+    }
+    int r[16];
+    for (int j = 0; j < 4; j++) {
+        int e0 = tmp[j] + tmp[8 + j], e1 = tmp[j] - tmp[8 + j];
+        int e2 = (tmp[4 + j] >> 1) - tmp[12 + j], e3 = tmp[4 + j] + (tmp[12 + j] >> 1);
+        r[j] = (e0 + e3 + 32) >> 6;
+        r[4 + j] = (e1 + e2 + 32) >> 6;
+        r[8 + j] = (e1 - e2 + 32) >> 6;
+        r[12 + j] = (e0 - e3 + 32) >> 6;
+    }
+    for (int i = 0; i < 4; i++) {
+        for (int j = 0; j < 4; j++) {
+            dst[j] = clip1(pred[j] + r[i * 4 + j]);
+        }
+        dst += stride;
+        pred += pred_stride;
+    }
+}
+
+/**
+ * @brief Unnormalized 4x4 Hadamard transform in place
+ */
+static void hadamard4(int dc[16])
+{
+    for (int i = 0; i < 4; i++) {
+        int *d = dc + i * 4;
+        int s01 = d[0] + d[1], d01 = d[0] - d[1];
+        int s23 = d[2] + d[3], d23 = d[2] - d[3];
+        d[0] = s01 + s23;
+        d[1] = s01 - s23;
+        d[2] = d01 - d23;
+        d[3] = d01 + d23;
+    }
+    for (int j = 0; j < 4; j++) {
+        int s01 = dc[j] + dc[4 + j], d01 = dc[j] - dc[4 + j];
+        int s23 = dc[8 + j] + dc[12 + j], d23 = dc[8 + j] - dc[12 + j];
+        dc[j] = s01 + s23;
+        dc[4 + j] = s01 - s23;
+        dc[8 + j] = d01 - d23;
+        dc[12 + j] = d01 + d23;
+    }
+}
+
+void h264_dsp_luma_dc_fwd(int16_t dc[16])
+{
+    int tmp[16];
+
+    for (int i = 0; i < 16; i++) {
+        tmp[i] = dc[i];
+    }
+    hadamard4(tmp);
+    for (int i = 0; i < 16; i++) {
+        dc[i] = (tmp[i] + 1) >> 1;
+    }
+}
+
+void h264_dsp_luma_dc_inv(int16_t dc[16], int qp)
+{
+    int scale = 16 * h264_dequant_v[qp % 6][0];
+    int tmp[16];
+
+    for (int i = 0; i < 16; i++) {
+        tmp[i] = dc[i];
+    }
+    hadamard4(tmp);
+    for (int i = 0; i < 16; i++) {
+        if (qp >= 36) {
+            dc[i] = (tmp[i] * scale) << (qp / 6 - 6);
+        } else {
+            dc[i] = (tmp[i] * scale + (1 << (5 - qp / 6))) >> (6 - qp / 6);
+        }
+    }
+}
+
+void h264_dsp_chroma_dc_fwd(int16_t dc[4])
+{
+    int a = dc[0], b = dc[1], c = dc[2], d = dc[3];
+
+    dc[0] = a + b + c + d;
+    dc[1] = a - b + c - d;
+    dc[2] = a + b - c - d;
+    dc[3] = a - b - c + d;
+}
+
+void h264_dsp_chroma_dc_inv(int16_t dc[4], int qp)
+{
+    int scale = 16 * h264_dequant_v[qp % 6][0];
+
+    h264_dsp_chroma_dc_fwd(dc);
+    for (int i = 0; i < 4; i++) {
+        dc[i] = ((dc[i] * scale) << (qp / 6)) >> 5;
+    }
+}
+
+int h264_dsp_quant_dc(int16_t *dc, int count, int qp, bool intra)
+{
+    int qbits = 15 + qp / 6;
+    int round = (1 << qbits) / (intra ? 3 : 6);
+    int mf = h264_quant_mf[qp % 6][0];
+    int nonzero = 0;
+
+    for (int i = 0; i < count; i++) {
+        dc[i] = quant(dc[i], mf, 2 * round, qbits + 1);
+        nonzero += dc[i] != 0;
+    }
+    return nonzero;
+}
+
+int h264_dsp_sad16(const uint8_t *a, int a_stride, const uint8_t *b, int b_stride)
+{
+    int sad = 0;
+
+    for (int y = 0; y < 16; y++) {
+        for (int x = 0; x < 16; x++) {
+            sad += abs(a[x] - b[x]);
+        }
+        a += a_stride;
+        b += b_stride;
+    }
+    return sad;
+}
+
+void h264_dsp_deblock_luma(uint8_t *pix, int xstride, int ystride, int qp,
+                           const uint8_t bs[4])
+{
+    int alpha = h264_alpha[qp];
+    int beta = h264_beta[qp];
+
+    if (alpha == 0) {
+        return;
+    }
+    for (int k = 0; k < 16; k++, pix += ystride) {
+        int strength = bs[k >> 2];
+        if (strength == 0) {
+            continue;
+        }
+        int p0 = pix[-xstride], p1 = pix[-2 * xstride], p2 = pix[-3 * xstride];
+        int q0 = pix[0], q1 = pix[xstride], q2 = pix[2 * xstride];
+        if (abs(p0 - q0) >= alpha || abs(p1 - p0) >= beta || abs(q1 - q0) >= beta) {
+            continue;
+        }
+        bool ap = abs(p2 - p0) < beta;
+        bool aq = abs(q2 - q0) < beta;
+
+        if (strength < 4) {
+            int tc0 = h264_tc0[qp][strength - 1];
+            int tc = tc0 + ap + aq;
+            int delta = clip3(-tc, tc, (((q0 - p0) << 2) + (p1 - q1) + 4) >> 3);
+            if (ap) {
+                pix[-2 * xstride] = p1 + clip3(-tc0, tc0, (p2 + ((p0 + q0 + 1) >> 1) - (p1 << 1)) >> 1);
+            }
+            if (aq) {
+                pix[xstride] = q1 + clip3(-tc0, tc0, (q2 + ((p0 + q0 + 1) >> 1) - (q1 << 1)) >> 1);
+            }
+            pix[-xstride] = clip1(p0 + delta);
+            pix[0] = clip1(q0 - delta);
+        } else {
+            bool strong = abs(p0 - q0) < ((alpha >> 2) + 2);
+            int p3 = pix[-4 * xstride], q3 = pix[3 * xstride];
+            if (ap && strong) {
+                pix[-xstride] = (p2 + 2 * p1 + 2 * p0 + 2 * q0 + q1 + 4) >> 3;
+                pix[-2 * xstride] = (p2 + p1 + p0 + q0 + 2) >> 2;
+                pix[-3 * xstride] = (2 * p3 + 3 * p2 + p1 + p0 + q0 + 4) >> 3;
+            } else {
+                pix[-xstride] = (2 * p1 + p0 + q1 + 2) >> 2;
+            }
+            if (aq && strong) {
+                pix[0] = (p1 + 2 * p0 + 2 * q0 + 2 * q1 + q2 + 4) >> 3;
+                pix[xstride] = (p0 + q0 + q1 + q2 + 2) >> 2;
+                pix[2 * xstride] = (2 * q3 + 3 * q2 + q1 + q0 + p0 + 4) >> 3;
+            } else {
+                pix[0] = (2 * q1 + q0 + p1 + 2) >> 2;
+            }
+        }
+    }
+}
+
+void h264_dsp_deblock_chroma(uint8_t *pix, int xstride, int ystride, int qp,
+                             const uint8_t bs[4])
+{
+    int alpha = h264_alpha[qp];
+    int beta = h264_beta[qp];
+
+    if (alpha == 0) {
+        return;
+    }
+    for (int k = 0; k < 8; k++, pix += ystride) {
+        int strength = bs[k >> 1];
+        if (strength == 0) {
+            continue;
+        }
+        int p0 = pix[-xstride], p1 = pix[-2 * xstride];
+        int q0 = pix[0], q1 = pix[xstride];
+        if (abs(p0 - q0) >= alpha || abs(p1 - p0) >= beta || abs(q1 - q0) >= beta) {
+            continue;
+        }
+        if (strength < 4) {
+            int tc = h264_tc0[qp][strength - 1] + 1;
+            int delta = clip3(-tc, tc, (((q0 - p0) << 2) + (p1 - q1) + 4) >> 3);
+            pix[-xstride] = clip1(p0 + delta);
+            pix[0] = clip1(q0 - delta);
+        } else {
+            pix[-xstride] = (2 * p1 + p0 + q1 + 2) >> 2;
+            pix[0] = (2 * q1 + q0 + p1 + 2) >> 2;
+        }
+    }
+}
@@ -0,0 +1,96 @@
+/**
+ * @file h264_dsp.h
+ * @brief Transform, quantization and deblocking primitives for the H.264 encoder
+ *
+ * 4x4 blocks are int16_t[16] in raster order. Reconstruction follows the
+ * normative decoding process (clauses 8.5 and 8.7) exactly, so the encoder's
+ * reference frames match any conforming decoder's.
+ */
+
+#ifndef H264_DSP_H
+#define H264_DSP_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * @brief Forward core transform of src - pred
+ */
+void h264_dsp_sub_dct4(int16_t out[16], const uint8_t *src, int stride,
+                       const uint8_t *pred, int pred_stride);
+
+/**
+ * @brief Quantize a transformed block in place
+ *
+ * @param c Coefficients, replaced by levels
+ * @param qp Quantization parameter
+ * @param intra Intra rounding (1/3) rather than inter (1/6)
+ * @param first 1 to leave the DC position alone, 0 otherwise
+ * @return Number of nonzero levels
+ */
+int h264_dsp_quant4(int16_t c[16], int qp, bool intra, int first);
+
+/**
+ * @brief Scale levels back to coefficients in place (8.5.12.1), DC excluded
+ *        when first is 1
+ */
+void h264_dsp_dequant4(int16_t c[16], int qp, int first);
+
+/**
+ * @brief dst = clip(pred + inverse transform of c) (8.5.12.2)
+ */
+void h264_dsp_idct4_add(uint8_t *dst, int stride, const uint8_t *pred, int pred_stride,
+                        const int16_t c[16]);
+
+/**
+ * @brief Forward Hadamard of the 16 luma DC terms of an Intra16x16 macroblock
+ */
+void h264_dsp_luma_dc_fwd(int16_t dc[16]);
+
+/**
+ * @brief Inverse Hadamard and scaling of Intra16x16 DC levels (8.5.10)
+ */
+void h264_dsp_luma_dc_inv(int16_t dc[16], int qp);
+
+/**
+ * @brief Forward 2x2 Hadamard of the chroma DC terms
+ */
+void h264_dsp_chroma_dc_fwd(int16_t dc[4]);
+
+/**
+ * @brief Inverse 2x2 Hadamard and scaling of chroma DC levels (8.5.11)
+ */
+void h264_dsp_chroma_dc_inv(int16_t dc[4], int qp);
+
+/**
+ * @brief Quantize Hadamard-transformed DC terms in place
+ *
+ * @return Number of nonzero levels
+ */
+int h264_dsp_quant_dc(int16_t *dc, int count, int qp, bool intra);
+
+/**
+ * @brief Sum of absolute differences of a 16x16 block
+ */
+int h264_dsp_sad16(const uint8_t *a, int a_stride, const uint8_t *b, int b_stride);
+
+/**
+ * @brief Filter one 16-sample luma edge (8.7.2)
+ *
+ * @param pix First q0 sample
+ * @param xstride Step across the edge: 1 for vertical edges, the row
+ *                stride for horizontal ones
+ * @param ystride Step along the edge
+ * @param qp qPav of the two macroblocks
+ * @param bs Boundary strength of each 4-sample segment
+ */
+void h264_dsp_deblock_luma(uint8_t *pix, int xstride, int ystride, int qp,
+                           const uint8_t bs[4]);
+
+/**
+ * @brief Filter one 8-sample chroma edge, bs[k] covering samples 2k, 2k+1
+ */
+void h264_dsp_deblock_chroma(uint8_t *pix, int xstride, int ystride, int qp,
+                             const uint8_t bs[4]);
+
+#endif // H264_DSP_H
@@ -0,0 +1,1251 @@
+/**
+ * @file h264_enc.c
+ * @brief Software H.264 Baseline encoder implementation
+ */
+
+#include "h264/h264_enc.h"
+#include "h264/h264_bits.h"
+#include "h264/h264_cavlc.h"
+#include "h264/h264_dsp.h"
+#include "h264/h264_tables.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char *TAG = "h264_enc";
+
+#define QP_MIN 10
+#define QP_MAX 51
+
+#define NAL_SLICE 1
+#define NAL_IDR 5
+#define NAL_SPS 7
+#define NAL_PPS 8
+
+#define SLICE_P 5                   // slice_type 5-9: all slices of the picture alike
+#define SLICE_I 7
+
+#define ME_RANGE 32                 // Full-pel search limit around the candidates
+#define ME_STEPS 16                 // Diamond iterations
+#define SKIP_SAD 512                // Try P_Skip before searching below this SAD
+
+typedef enum {
+    MB_INTRA = 0,                   // Intra16x16
+    MB_INTER,                       // P_L0_16x16
+    MB_SKIP,                        // P_Skip
+} mb_type_t;
+
+/**
+ * @brief Per-macroblock state needed by later macroblocks and deblocking
+ */
+typedef struct {
+    uint8_t type;
+    uint8_t qp;
+    int16_t mv[2];                  // Quarter-pel
+    uint8_t nnz[24];                // TotalCoeff: luma 4x4 raster, then Cb and Cr 2x2
+} mb_info_t;
+
+struct h264_enc {
+    h264_enc_config_t config;
+    int mb_w, mb_h;
+    int stride_y, stride_c;         // Padded plane widths, mb_w * 16 and mb_w * 8
+    uint8_t *pictures;
+    uint8_t *cur[3];                // Source, padded to whole macroblocks
+    uint8_t *rec[3];                // Reconstruction of the picture being coded
+    uint8_t *ref[3];                // Previous reconstruction, deblocked
+    mb_info_t *mbs;
+    uint8_t *out;
+    size_t out_cap;
+    h264_bits_t bits;
+
+    bool idr_pending;
+    int gop_pos;                    // Pictures since the last IDR
+    int frame_num;
+    int idr_pic_id;
+    int qp;                         // QP of the next picture
+    int lambda;                     // Motion cost weight for that QP
+
+    int64_t last_us;
+    int64_t rc_fullness;            // Bits spent beyond the budget
+
+    // Macroblock work areas
+    uint8_t pred_y[256];
+    uint8_t pred_c[2][64];
+    int16_t luma[16][16];           // Per 4x4 raster block, raster levels
+    int16_t luma_dc[16];
+    int16_t chroma[2][4][16];
+    int16_t chroma_dc[2][4];
+};
+
+// blkIdx to 4x4 raster position within the macroblock (6.4.3)
+static const uint8_t s_blk_raster[16] = {
+    0, 1, 4, 5, 2, 3, 6, 7, 8, 9, 12, 13, 10, 11, 14, 15,
+};
+
+// Score of a lone +-1 after a run of zeros, for small-coefficient removal
+static const uint8_t s_decimate_table[16] = {
+    3, 2, 2, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+};
+
+static inline int clip(int v, int lo, int hi)
+{
+    return v < lo ? lo : v > hi ? hi : v;
+}
+
+static inline int median3(int a, int b, int c)
+{
+    int lo = a < b ? a : b;
+    int hi = a < b ? b : a;
+
+    return c < lo ? lo : c > hi ? hi : c;
+}
+
+/**
+ * @brief Motion cost weight, about 2^((QP - 12) / 6)
+ */
+static int lambda_for(int qp)
+{
+    static const uint8_t frac[6] = { 16, 18, 20, 23, 25, 29 };
+
+    if (qp < 12) {
+        return 1;
+    }
+    return (frac[(qp - 12) % 6] << ((qp - 12) / 6)) >> 4;
+}
+
+// --- Input ---
+
+/**
+ * @brief Convert YUYV 4:2:2 to planar 4:2:0, replicating edges into the padding
+ */
+static void load_yuyv(h264_enc_t *enc, const uint8_t *yuyv)
+{
+    int w = enc->config.width;
+    int h = enc->config.height;
+    int sy = enc->stride_y;
+    int sc = enc->stride_c;
+
+    for (int y = 0; y < h; y += 2) {
+        const uint8_t *r0 = yuyv + (size_t)y * w * 2;
+        const uint8_t *r1 = r0 + w * 2;
+        uint8_t *y0 = enc->cur[0] + y * sy;
+        uint8_t *y1 = y0 + sy;
+        uint8_t *u = enc->cur[1] + (y / 2) * sc;
+        uint8_t *v = enc->cur[2] + (y / 2) * sc;
+
+        for (int x = 0; x < w; x += 2, r0 += 4, r1 += 4) {
+            y0[x] = r0[0];
+            y0[x + 1] = r0[2];
+            y1[x] = r1[0];
+            y1[x + 1] = r1[2];
+            u[x / 2] = (r0[1] + r1[1] + 1) >> 1;
+            v[x / 2] = (r0[3] + r1[3] + 1) >> 1;
+        }
+        for (int x = w; x < sy; x++) {
+            y0[x] = y0[w - 1];
+            y1[x] = y1[w - 1];
+        }
+        for (int x = w / 2; x < sc; x++) {
+            u[x] = u[w / 2 - 1];
+            v[x] = v[w / 2 - 1];
+        }
+    }
+    for (int y = h; y < enc->mb_h * 16; y++) {
+        memcpy(enc->cur[0] + y * sy, enc->cur[0] + (h - 1) * sy, sy);
+    }
+    for (int y = h / 2; y < enc->mb_h * 8; y++) {
+        memcpy(enc->cur[1] + y * sc, enc->cur[1] + (h / 2 - 1) * sc, sc);
+        memcpy(enc->cur[2] + y * sc, enc->cur[2] + (h / 2 - 1) * sc, sc);
+    }
+}
+
+// --- Parameter sets and slice header ---
+
+static void write_sps(h264_enc_t *enc)
+{
+    h264_bits_t *b = &enc->bits;
+    int frame_mbs = enc->mb_w * enc->mb_h;
+    int level = frame_mbs <= 792 ? 21 : frame_mbs <= 1620 ? 22 : frame_mbs <= 3600 ? 31 : 40;
+    int crop_right = (enc->stride_y - enc->config.width) / 2;
+    int crop_bottom = (enc->mb_h * 16 - enc->config.height) / 2;
+
+    h264_bits_nal_start(b, 3, NAL_SPS);
+    h264_bits_put(b, 66, 8);                // profile_idc: Baseline
+    h264_bits_put(b, 0xc0, 8);              // constraint_set0/1: Constrained Baseline
+    h264_bits_put(b, level, 8);
+    h264_bits_ue(b, 0);                     // seq_parameter_set_id
+    h264_bits_ue(b, 0);                     // log2_max_frame_num_minus4
+    h264_bits_ue(b, 2);                     // pic_order_cnt_type: output order = decode order
+    h264_bits_ue(b, 1);                     // max_num_ref_frames
+    h264_bits_put(b, 0, 1);                 // gaps_in_frame_num_value_allowed_flag
+    h264_bits_ue(b, enc->mb_w - 1);
+    h264_bits_ue(b, enc->mb_h - 1);
+    h264_bits_put(b, 1, 1);                 // frame_mbs_only_flag
+    h264_bits_put(b, 1, 1);                 // direct_8x8_inference_flag
+    if (crop_right || crop_bottom) {
+        h264_bits_put(b, 1, 1);
+        h264_bits_ue(b, 0);
+        h264_bits_ue(b, crop_right);
+        h264_bits_ue(b, 0);
+        h264_bits_ue(b, crop_bottom);
+    } else {
+        h264_bits_put(b, 0, 1);
+    }
+
+    // VUI: full-range samples like the sensor's JPEGs, and no reordering so
+    // players can show each picture as soon as it arrives
+    h264_bits_put(b, 1, 1);                 // vui_parameters_present_flag
+    h264_bits_put(b, 0, 1);                 // aspect_ratio_info_present_flag
+    h264_bits_put(b, 0, 1);                 // overscan_info_present_flag
+    h264_bits_put(b, 1, 1);                 // video_signal_type_present_flag
+    h264_bits_put(b, 5, 3);                 // video_format: unspecified
+    h264_bits_put(b, 1, 1);                 // video_full_range_flag
+    h264_bits_put(b, 0, 1);                 // colour_description_present_flag
+    h264_bits_put(b, 0, 1);                 // chroma_loc_info_present_flag
+    h264_bits_put(b, 0, 1);                 // timing_info_present_flag
+    h264_bits_put(b, 0, 1);                 // nal_hrd_parameters_present_flag
+    h264_bits_put(b, 0, 1);                 // vcl_hrd_parameters_present_flag
+    h264_bits_put(b, 0, 1);                 // pic_struct_present_flag
+    h264_bits_put(b, 1, 1);                 // bitstream_restriction_flag
+    h264_bits_put(b, 1, 1);                 // motion_vectors_over_pic_boundaries_flag
+    h264_bits_ue(b, 0);                     // max_bytes_per_pic_denom
+    h264_bits_ue(b, 0);                     // max_bits_per_mb_denom
+    h264_bits_ue(b, 15);                    // log2_max_mv_length_horizontal
+    h264_bits_ue(b, 15);                    // log2_max_mv_length_vertical
+    h264_bits_ue(b, 0);                     // max_num_reorder_frames
+    h264_bits_ue(b, 1);                     // max_dec_frame_buffering
+    h264_bits_trailing(b);
+}
+
+static void write_pps(h264_enc_t *enc)
+{
+    h264_bits_t *b = &enc->bits;
+
+    h264_bits_nal_start(b, 3, NAL_PPS);
+    h264_bits_ue(b, 0);                     // pic_parameter_set_id
+    h264_bits_ue(b, 0);                     // seq_parameter_set_id
+    h264_bits_put(b, 0, 1);                 // entropy_coding_mode_flag: CAVLC
+    h264_bits_put(b, 0, 1);                 // bottom_field_pic_order_in_frame_present_flag
+    h264_bits_ue(b, 0);                     // num_slice_groups_minus1
+    h264_bits_ue(b, 0);                     // num_ref_idx_l0_default_active_minus1
+    h264_bits_ue(b, 0);                     // num_ref_idx_l1_default_active_minus1
+    h264_bits_put(b, 0, 1);                 // weighted_pred_flag
+    h264_bits_put(b, 0, 2);                 // weighted_bipred_idc
+    h264_bits_se(b, 0);                     // pic_init_qp_minus26
+    h264_bits_se(b, 0);                     // pic_init_qs_minus26
+    h264_bits_se(b, 0);                     // chroma_qp_index_offset
+    h264_bits_put(b, 1, 1);                 // deblocking_filter_control_present_flag
+    h264_bits_put(b, 0, 1);                 // constrained_intra_pred_flag
+    h264_bits_put(b, 0, 1);                 // redundant_pic_cnt_present_flag
+    h264_bits_trailing(b);
+}
+
+static void write_slice_header(h264_enc_t *enc, bool idr, int qp)
+{
+    h264_bits_t *b = &enc->bits;
+
+    h264_bits_nal_start(b, idr ? 3 : 2, idr ? NAL_IDR : NAL_SLICE);
+    h264_bits_ue(b, 0);                     // first_mb_in_slice
+    h264_bits_ue(b, idr ? SLICE_I : SLICE_P);
+    h264_bits_ue(b, 0);                     // pic_parameter_set_id
+    h264_bits_put(b, enc->frame_num, 4);
+    if (idr) {
+        h264_bits_ue(b, enc->idr_pic_id);
+    } else {
+        h264_bits_put(b, 0, 1);             // num_ref_idx_active_override_flag
+        h264_bits_put(b, 0, 1);             // ref_pic_list_modification_flag_l0
+    }
+    if (idr) {
+        h264_bits_put(b, 0, 1);             // no_output_of_prior_pics_flag
+        h264_bits_put(b, 0, 1);             // long_term_reference_flag
+    } else {
+        h264_bits_put(b, 0, 1);             // adaptive_ref_pic_marking_mode_flag
+    }
+    h264_bits_se(b, qp - 26);               // slice_qp_delta
+    h264_bits_ue(b, 0);                     // disable_deblocking_filter_idc
+    h264_bits_se(b, 0);                     // slice_alpha_c0_offset_div2
+    h264_bits_se(b, 0);                     // slice_beta_offset_div2
+}
+
+// --- Prediction ---
+
+/**
+ * @brief Intra16x16 luma prediction from the unfiltered reconstruction (8.3.3)
+ *
+ * @return false if the mode needs unavailable neighbours
+ */
+static bool predict_intra16(h264_enc_t *enc, int mbx, int mby, int mode, uint8_t *pred)
+{
+    int sy = enc->stride_y;
+    const uint8_t *rec = enc->rec[0] + mby * 16 * sy + mbx * 16;
+    bool top = mby > 0;
+    bool left = mbx > 0;
+
+    switch (mode) {
+    case 0:                                 // Vertical
+        if (!top) {
+            return false;
+        }
+        for (int y = 0; y < 16; y++) {
+            memcpy(pred + y * 16, rec - sy, 16);
+        }
+        return true;
+    case 1:                                 // Horizontal
+        if (!left) {
+            return false;
+        }
+        for (int y = 0; y < 16; y++) {
+            memset(pred + y * 16, rec[y * sy - 1], 16);
+        }
+        return true;
+    default: {                              // DC
+        int sum = 0;
+        int dc = 128;
+        for (int i = 0; i < 16; i++) {
+            sum += (top ? rec[i - sy] : 0) + (left ? rec[i * sy - 1] : 0);
+        }
+        if (top && left) {
+            dc = (sum + 16) >> 5;
+        } else if (top || left) {
+            dc = (sum + 8) >> 4;
+        }
+        memset(pred, dc, 256);
+        return true;
+    }
+    }
+}
+
+/**
+ * @brief Intra chroma prediction for one 8x8 plane (8.3.4)
+ *
+ * @param mode 0 DC, 1 horizontal, 2 vertical
+ * @return false if the mode needs unavailable neighbours
+ */
+static bool predict_intra_chroma(h264_enc_t *enc, int mbx, int mby, int mode, int plane,
+                                 uint8_t *pred)
+{
+    int sc = enc->stride_c;
+    const uint8_t *rec = enc->rec[plane] + mby * 8 * sc + mbx * 8;
+    bool top = mby > 0;
+    bool left = mbx > 0;
+
+    if (mode == 1) {
+        if (!left) {
+            return false;
+        }
+        for (int y = 0; y < 8; y++) {
+            memset(pred + y * 8, rec[y * sc - 1], 8);
+        }
+        return true;
+    }
+    if (mode == 2) {
+        if (!top) {
+            return false;
+        }
+        for (int y = 0; y < 8; y++) {
+            memcpy(pred + y * 8, rec - sc, 8);
+        }
+        return true;
+    }
+
+    // DC per 4x4 block; the off-diagonal blocks prefer their own edge
+    for (int by = 0; by < 2; by++) {
+        for (int bx = 0; bx < 2; bx++) {
+            int sum_top = 0, sum_left = 0;
+            for (int i = 0; i < 4; i++) {
+                sum_top += top ? rec[bx * 4 + i - sc] : 0;
+                sum_left += left ? rec[(by * 4 + i) * sc - 1] : 0;
+            }
+            int dc = 128;
+            if (bx == by) {
+                if (top && left) {
+                    dc = (sum_top + sum_left + 4) >> 3;
+                } else if (left) {
+                    dc = (sum_left + 2) >> 2;
+                } else if (top) {
+                    dc = (sum_top + 2) >> 2;
+                }
+            } else if (bx == 1) {
+                dc = top ? (sum_top + 2) >> 2 : left ? (sum_left + 2) >> 2 : 128;
+            } else {
+                dc = left ? (sum_left + 2) >> 2 : top ? (sum_top + 2) >> 2 : 128;
+            }
+            for (int y = 0; y < 4; y++) {
+                memset(pred + (by * 4 + y) * 8 + bx * 4, dc, 4);
+            }
+        }
+    }
+    return true;
+}
+
+static int sad8(const uint8_t *a, int a_stride, const uint8_t *b)
+{
+    int sad = 0;
+
+    for (int y = 0; y < 8; y++, a += a_stride, b += 8) {
+        for (int x = 0; x < 8; x++) {
+            sad += abs(a[x] - b[x]);
+        }
+    }
+    return sad;
+}
+
+/**
+ * @brief Pick and build the best Intra16x16 luma prediction
+ *
+ * @return Its SAD; the mode is stored through mode
+ */
+static int choose_intra16(h264_enc_t *enc, int mbx, int mby, int *mode)
+{
+    const uint8_t *src = enc->cur[0] + mby * 16 * enc->stride_y + mbx * 16;
+    uint8_t pred[256];
+    int best = -1;
+
+    for (int m = 0; m < 3; m++) {
+        if (!predict_intra16(enc, mbx, mby, m, pred)) {
+            continue;
+        }
+        int sad = h264_dsp_sad16(src, enc->stride_y, pred, 16);
+        if (best < 0 || sad < best) {
+            best = sad;
+            *mode = m;
+            memcpy(enc->pred_y, pred, 256);
+        }
+    }
+    return best;
+}
+
+/**
+ * @brief Pick and build the best intra chroma prediction for both planes
+ */
+static int choose_intra_chroma(h264_enc_t *enc, int mbx, int mby)
+{
+    int sc = enc->stride_c;
+    uint8_t pred[2][64];
+    int best = -1;
+    int mode = 0;
+
+    for (int m = 0; m < 3; m++) {
+        int sad = 0;
+        bool ok = true;
+        for (int p = 0; p < 2 && ok; p++) {
+            ok = predict_intra_chroma(enc, mbx, mby, m, 1 + p, pred[p]);
+            sad += ok ? sad8(enc->cur[1 + p] + mby * 8 * sc + mbx * 8, sc, pred[p]) : 0;
+        }
+        if (ok && (best < 0 || sad < best)) {
+            best = sad;
+            mode = m;
+            memcpy(enc->pred_c, pred, sizeof(pred));
+        }
+    }
+    return mode;
+}
+
+/**
+ * @brief Build the inter prediction for a full-pel luma motion vector
+ *
+ * Chroma vectors are half the luma vector, so odd luma components land on
+ * chroma half-samples and use the bilinear filter of 8.4.2.2.2.
+ */
+static void predict_inter(h264_enc_t *enc, int mbx, int mby, int mvx, int mvy)
+{
+    int sy = enc->stride_y;
+    int sc = enc->stride_c;
+    const uint8_t *ref = enc->ref[0] + (mby * 16 + mvy) * sy + mbx * 16 + mvx;
+
+    for (int y = 0; y < 16; y++) {
+        memcpy(enc->pred_y + y * 16, ref + y * sy, 16);
+    }
+
+    int cx = mbx * 64 + mvx * 4;            // Eighth-sample chroma position
+    int cy = mby * 64 + mvy * 4;
+    int fx = cx & 7, fy = cy & 7;
+    for (int p = 0; p < 2; p++) {
+        const uint8_t *c = enc->ref[1 + p] + (cy >> 3) * sc + (cx >> 3);
+        uint8_t *pred = enc->pred_c[p];
+        if (fx == 0 && fy == 0) {
+            for (int y = 0; y < 8; y++) {
+                memcpy(pred + y * 8, c + y * sc, 8);
+            }
+            continue;
+        }
+        int wa = (8 - fx) * (8 - fy), wb = fx * (8 - fy);
+        int wc = (8 - fx) * fy, wd = fx * fy;
+        int right = fx ? 1 : 0;             // Zero-weight taps stay inside the block
+        int down = fy ? sc : 0;
+        for (int y = 0; y < 8; y++, c += sc) {
+            for (int x = 0; x < 8; x++) {
+                pred[y * 8 + x] = (wa * c[x] + wb * c[x + right] + wc * c[x + down] +
+                                   wd * c[x + down + right] + 32) >> 6;
+            }
+        }
+    }
+}
+
+/**
+ * @brief Motion vector predictor and P_Skip vector for a 16x16 partition
+ *
+ * Follows 8.4.1.3 with C replaced by D at the right edge, and 8.4.1.1 for
+ * the skip vector. Intra neighbours are available but have no reference.
+ */
+static void predict_mv(h264_enc_t *enc, int mbx, int mby, int16_t pmv[2], int16_t skip[2])
+{
+    const mb_info_t *mb = enc->mbs + mby * enc->mb_w + mbx;
+    const mb_info_t *a = mbx > 0 ? mb - 1 : NULL;
+    const mb_info_t *b = mby > 0 ? mb - enc->mb_w : NULL;
+    const mb_info_t *c = mby > 0 && mbx < enc->mb_w - 1 ? mb - enc->mb_w + 1 : NULL;
+
+    if (!c) {
+        c = mbx > 0 && mby > 0 ? mb - enc->mb_w - 1 : NULL;
+    }
+
+    int ref[3], mv[3][2];
+    const mb_info_t *n[3] = { a, b, c };
+    for (int i = 0; i < 3; i++) {
+        bool inter = n[i] && n[i]->type != MB_INTRA;
+        ref[i] = inter ? 0 : -1;
+        mv[i][0] = inter ? n[i]->mv[0] : 0;
+        mv[i][1] = inter ? n[i]->mv[1] : 0;
+    }
+    if (!b && !c && a) {
+        for (int i = 1; i < 3; i++) {
+            ref[i] = ref[0];
+            mv[i][0] = mv[0][0];
+            mv[i][1] = mv[0][1];
+        }
+    }
+
+    int matches = (ref[0] == 0) + (ref[1] == 0) + (ref[2] == 0);
+    if (matches == 1) {
+        int i = ref[0] == 0 ? 0 : ref[1] == 0 ? 1 : 2;
+        pmv[0] = mv[i][0];
+        pmv[1] = mv[i][1];
+    } else {
+        pmv[0] = median3(mv[0][0], mv[1][0], mv[2][0]);
+        pmv[1] = median3(mv[0][1], mv[1][1], mv[2][1]);
+    }
+
+    bool zero = !a || !b ||
+                (a->type != MB_INTRA && a->mv[0] == 0 && a->mv[1] == 0) ||
+                (b->type != MB_INTRA && b->mv[0] == 0 && b->mv[1] == 0);
+    skip[0] = zero ? 0 : pmv[0];
+    skip[1] = zero ? 0 : pmv[1];
+}
+
+/**
+ * @brief Full-pel motion search: best of a few candidates, then a small diamond
+ *
+ * @return Cost of the best vector, SAD plus lambda-weighted vector bits
+ */
+static int motion_search(h264_enc_t *enc, int mbx, int mby, const int16_t pmv[2],
+                         int *best_x, int *best_y)
+{
+    int sy = enc->stride_y;
+    const uint8_t *src = enc->cur[0] + mby * 16 * sy + mbx * 16;
+    const uint8_t *ref = enc->ref[0] + mby * 16 * sy + mbx * 16;
+    int min_x = -mbx * 16, max_x = (enc->mb_w - 1 - mbx) * 16;
+    int min_y = -mby * 16, max_y = (enc->mb_h - 1 - mby) * 16;
+    const mb_info_t *mb = enc->mbs + mby * enc->mb_w + mbx;
+
+    min_x = min_x < -ME_RANGE ? -ME_RANGE : min_x;
+    max_x = max_x > ME_RANGE ? ME_RANGE : max_x;
+    min_y = min_y < -ME_RANGE ? -ME_RANGE : min_y;
+    max_y = max_y > ME_RANGE ? ME_RANGE : max_y;
+
+#define MV_COST(x, y) (h264_dsp_sad16(src, sy, ref + (y) * sy + (x), sy) + \
+                       enc->lambda * (h264_bits_se_size((x) * 4 - pmv[0]) + \
+                                      h264_bits_se_size((y) * 4 - pmv[1])))
+
+    int cand[4][2] = {
+        { 0, 0 },
+        { (pmv[0] + 2) >> 2, (pmv[1] + 2) >> 2 },
+        { mbx > 0 ? mb[-1].mv[0] / 4 : 0, mbx > 0 ? mb[-1].mv[1] / 4 : 0 },
+        { mby > 0 ? mb[-enc->mb_w].mv[0] / 4 : 0, mby > 0 ? mb[-enc->mb_w].mv[1] / 4 : 0 },
+    };
+    int bx = 0, by = 0;
+    int best = MV_COST(0, 0);
+    for (int i = 1; i < 4; i++) {
+        int x = clip(cand[i][0], min_x, max_x);
+        int y = clip(cand[i][1], min_y, max_y);
+        if (x == bx && y == by) {
+            continue;
+        }
+        int cost = MV_COST(x, y);
+        if (cost < best) {
+            best = cost;
+            bx = x;
+            by = y;
+        }
+    }
+
+    static const int8_t diamond[4][2] = { { -1, 0 }, { 1, 0 }, { 0, -1 }, { 0, 1 } };
+    for (int step = 0; step < ME_STEPS; step++) {
+        int nx = bx, ny = by;
+        for (int i = 0; i < 4; i++) {
+            int x = bx + diamond[i][0];
+            int y = by + diamond[i][1];
+            if (x < min_x || x > max_x || y < min_y || y > max_y) {
+                continue;
+            }
+            int cost = MV_COST(x, y);
+            if (cost < best) {
+                best = cost;
+                nx = x;
+                ny = y;
+            }
+        }
+        if (nx == bx && ny == by) {
+            break;
+        }
+        bx = nx;
+        by = ny;
+    }
+#undef MV_COST
+
+    *best_x = bx;
+    *best_y = by;
+    return best;
+}
+
+// --- Residual ---
+
+/**
+ * @brief Score of a block of levels in scan order; 9 means keep it
+ */
+static int decimate_score(const int16_t *coef, int first)
+{
+    int score = 0;
+    int i = 15;
+
+    while (i >= first && coef[h264_zigzag4x4[i]] == 0) {
+        i--;
+    }
+    while (i >= first) {
+        int v = coef[h264_zigzag4x4[i--]];
+        if (v > 1 || v < -1) {
+            return 9;
+        }
+        int run = 0;
+        while (i >= first && coef[h264_zigzag4x4[i]] == 0) {
+            i--;
+            run++;
+        }
+        score += s_decimate_table[run];
+    }
+    return score;
+}
+
+/**
+ * @brief Transform, quantize and reconstruct the luma of an Intra16x16 macroblock
+ *
+ * @return CodedBlockPatternLuma, 0 or 15
+ */
+static int code_luma_intra16(h264_enc_t *enc, int mbx, int mby, mb_info_t *mb)
+{
+    int sy = enc->stride_y;
+    const uint8_t *src = enc->cur[0] + mby * 16 * sy + mbx * 16;
+    uint8_t *rec = enc->rec[0] + mby * 16 * sy + mbx * 16;
+    int ac = 0;
+
+    for (int r = 0; r < 16; r++) {
+        int x = (r & 3) * 4, y = (r >> 2) * 4;
+        h264_dsp_sub_dct4(enc->luma[r], src + y * sy + x, sy, enc->pred_y + y * 16 + x, 16);
+        enc->luma_dc[r] = enc->luma[r][0];
+    }
+    h264_dsp_luma_dc_fwd(enc->luma_dc);
+    h264_dsp_quant_dc(enc->luma_dc, 16, mb->qp, true);
+    for (int r = 0; r < 16; r++) {
+        mb->nnz[r] = h264_dsp_quant4(enc->luma[r], mb->qp, true, 1);
+        ac += mb->nnz[r];
+    }
+    if (ac == 0) {
+        memset(mb->nnz, 0, 16);
+    }
+
+    int16_t dc[16];
+    memcpy(dc, enc->luma_dc, sizeof(dc));
+    h264_dsp_luma_dc_inv(dc, mb->qp);
+    for (int r = 0; r < 16; r++) {
+        int x = (r & 3) * 4, y = (r >> 2) * 4;
+        int16_t c[16];
+        if (ac) {
+            memcpy(c, enc->luma[r], sizeof(c));
+            h264_dsp_dequant4(c, mb->qp, 1);
+        } else {
+            memset(c, 0, sizeof(c));
+        }
+        c[0] = dc[r];
+        h264_dsp_idct4_add(rec + y * sy + x, sy, enc->pred_y + y * 16 + x, 16, c);
+    }
+    return ac ? 15 : 0;
+}
+
+/**
+ * @brief Transform, quantize and reconstruct the luma of an inter macroblock
+ *
+ * Blocks holding only a few scattered +-1 levels cost more bits than they
+ * are worth and are dropped, per 8x8 and for the whole macroblock.
+ *
+ * @return CodedBlockPatternLuma
+ */
+static int code_luma_inter(h264_enc_t *enc, int mbx, int mby, mb_info_t *mb)
+{
+    int sy = enc->stride_y;
+    const uint8_t *src = enc->cur[0] + mby * 16 * sy + mbx * 16;
+    uint8_t *rec = enc->rec[0] + mby * 16 * sy + mbx * 16;
+    int score8[4] = { 0 };
+    int cbp = 0;
+
+    for (int r = 0; r < 16; r++) {
+        int x = (r & 3) * 4, y = (r >> 2) * 4;
+        h264_dsp_sub_dct4(enc->luma[r], src + y * sy + x, sy, enc->pred_y + y * 16 + x, 16);
+        mb->nnz[r] = h264_dsp_quant4(enc->luma[r], mb->qp, false, 0);
+        if (mb->nnz[r]) {
+            score8[(y / 8) * 2 + x / 8] += decimate_score(enc->luma[r], 0);
+        }
+    }
+    int total = 0;
+    for (int b8 = 0; b8 < 4; b8++) {
+        if (score8[b8] < 4) {
+            score8[b8] = 0;
+        }
+        total += score8[b8];
+    }
+    for (int r = 0; r < 16; r++) {
+        int b8 = ((r >> 3) << 1) | ((r & 3) >> 1);
+        if (total < 6 || score8[b8] == 0) {
+            mb->nnz[r] = 0;
+        }
+        if (mb->nnz[r]) {
+            cbp |= 1 << b8;
+        }
+    }
+
+    for (int r = 0; r < 16; r++) {
+        int x = (r & 3) * 4, y = (r >> 2) * 4;
+        if (mb->nnz[r]) {
+            int16_t c[16];
+            memcpy(c, enc->luma[r], sizeof(c));
+            h264_dsp_dequant4(c, mb->qp, 0);
+            h264_dsp_idct4_add(rec + y * sy + x, sy, enc->pred_y + y * 16 + x, 16, c);
+        } else {
+            memset(enc->luma[r], 0, sizeof(enc->luma[r]));
+            for (int i = 0; i < 4; i++) {
+                memcpy(rec + (y + i) * sy + x, enc->pred_y + (y + i) * 16 + x, 4);
+            }
+        }
+    }
+    return cbp;
+}
+
+/**
+ * @brief Transform, quantize and reconstruct both chroma planes
+ *
+ * @return CodedBlockPatternChroma
+ */
+static int code_chroma(h264_enc_t *enc, int mbx, int mby, mb_info_t *mb, bool intra)
+{
+    int sc = enc->stride_c;
+    int qpc = h264_chroma_qp[mb->qp];
+    int dc_nz = 0, ac_nz = 0;
+
+    for (int p = 0; p < 2; p++) {
+        const uint8_t *src = enc->cur[1 + p] + mby * 8 * sc + mbx * 8;
+        int ac = 0, score = 0;
+        for (int r = 0; r < 4; r++) {
+            int x = (r & 1) * 4, y = (r >> 1) * 4;
+            h264_dsp_sub_dct4(enc->chroma[p][r], src + y * sc + x, sc,
+                              enc->pred_c[p] + y * 8 + x, 8);
+            enc->chroma_dc[p][r] = enc->chroma[p][r][0];
+            mb->nnz[16 + p * 4 + r] = h264_dsp_quant4(enc->chroma[p][r], qpc, intra, 1);
+            if (mb->nnz[16 + p * 4 + r]) {
+                ac += mb->nnz[16 + p * 4 + r];
+                score += decimate_score(enc->chroma[p][r], 1);
+            }
+        }
+        if (!intra && score < 7) {
+            memset(mb->nnz + 16 + p * 4, 0, 4);
+            ac = 0;
+        }
+        h264_dsp_chroma_dc_fwd(enc->chroma_dc[p]);
+        dc_nz += h264_dsp_quant_dc(enc->chroma_dc[p], 4, qpc, intra);
+        ac_nz += ac;
+    }
+    int cbp = ac_nz ? 2 : dc_nz ? 1 : 0;
+    if (cbp < 2) {
+        memset(mb->nnz + 16, 0, 8);
+    }
+
+    for (int p = 0; p < 2; p++) {
+        uint8_t *rec = enc->rec[1 + p] + mby * 8 * sc + mbx * 8;
+        int16_t dc[4];
+        memcpy(dc, enc->chroma_dc[p], sizeof(dc));
+        h264_dsp_chroma_dc_inv(dc, qpc);
+        for (int r = 0; r < 4; r++) {
+            int x = (r & 1) * 4, y = (r >> 1) * 4;
+            int16_t c[16];
+            if (mb->nnz[16 + p * 4 + r]) {
+                memcpy(c, enc->chroma[p][r], sizeof(c));
+                h264_dsp_dequant4(c, qpc, 1);
+            } else {
+                memset(enc->chroma[p][r], 0, sizeof(enc->chroma[p][r]));
+                memset(c, 0, sizeof(c));
+            }
+            c[0] = dc[r];
+            h264_dsp_idct4_add(rec + y * sc + x, sc, enc->pred_c[p] + y * 8 + x, 8, c);
+        }
+    }
+    return cbp;
+}
+
+// --- Macroblock syntax ---
+
+static int predict_nc(int na, int nb)
+{
+    if (na >= 0 && nb >= 0) {
+        return (na + nb + 1) >> 1;
+    }
+    return na >= 0 ? na : nb >= 0 ? nb : 0;
+}
+
+/**
+ * @brief nC of a luma 4x4 block at raster position r (9.2.1)
+ */
+static int luma_nc(const h264_enc_t *enc, int mbx, int mby, const mb_info_t *mb, int r)
+{
+    int x = r & 3, y = r >> 2;
+    int na = x > 0 ? mb->nnz[r - 1] : mbx > 0 ? mb[-1].nnz[r + 3] : -1;
+    int nb = y > 0 ? mb->nnz[r - 4] : mby > 0 ? mb[-enc->mb_w].nnz[r + 12] : -1;
+
+    return predict_nc(na, nb);
+}
+
+/**
+ * @brief nC of chroma AC block r of plane p
+ */
+static int chroma_nc(const h264_enc_t *enc, int mbx, int mby, const mb_info_t *mb,
+                     int p, int r)
+{
+    int i = 16 + p * 4 + r;
+    int na = (r & 1) ? mb->nnz[i - 1] : mbx > 0 ? mb[-1].nnz[i + 1] : -1;
+    int nb = (r & 2) ? mb->nnz[i - 2] : mby > 0 ? mb[-enc->mb_w].nnz[i + 2] : -1;
+
+    return predict_nc(na, nb);
+}
+
+static void write_chroma_residual(h264_enc_t *enc, int mbx, int mby, const mb_info_t *mb,
+                                  int cbp_chroma)
+{
+    int16_t scan[16];
+
+    if (cbp_chroma == 0) {
+        return;
+    }
+    for (int p = 0; p < 2; p++) {
+        h264_cavlc_block(&enc->bits, enc->chroma_dc[p], 4, -1);
+    }
+    if (cbp_chroma < 2) {
+        return;
+    }
+    for (int p = 0; p < 2; p++) {
+        for (int r = 0; r < 4; r++) {
+            for (int i = 1; i < 16; i++) {
+                scan[i - 1] = enc->chroma[p][r][h264_zigzag4x4[i]];
+            }
+            h264_cavlc_block(&enc->bits, scan, 15, chroma_nc(enc, mbx, mby, mb, p, r));
+        }
+    }
+}
+
+static void write_intra16(h264_enc_t *enc, int mbx, int mby, const mb_info_t *mb, bool p_slice,
+                          int mode, int chroma_mode, int cbp_luma, int cbp_chroma)
+{
+    h264_bits_t *b = &enc->bits;
+    int16_t scan[16];
+
+    h264_bits_ue(b, (p_slice ? 5 : 0) + 1 + mode + 4 * cbp_chroma + (cbp_luma ? 12 : 0));
+    h264_bits_ue(b, chroma_mode);
+    h264_bits_se(b, 0);                     // mb_qp_delta
+
+    for (int i = 0; i < 16; i++) {
+        scan[i] = enc->luma_dc[h264_zigzag4x4[i]];
+    }
+    h264_cavlc_block(b, scan, 16, luma_nc(enc, mbx, mby, mb, 0));
+    if (cbp_luma) {
+        for (int k = 0; k < 16; k++) {
+            int r = s_blk_raster[k];
+            for (int i = 1; i < 16; i++) {
+                scan[i - 1] = enc->luma[r][h264_zigzag4x4[i]];
+            }
+            h264_cavlc_block(b, scan, 15, luma_nc(enc, mbx, mby, mb, r));
+        }
+    }
+    write_chroma_residual(enc, mbx, mby, mb, cbp_chroma);
+}
+
+static void write_inter(h264_enc_t *enc, int mbx, int mby, const mb_info_t *mb,
+                        const int16_t pmv[2], int cbp_luma, int cbp_chroma)
+{
+    h264_bits_t *b = &enc->bits;
+    int cbp = cbp_luma | (cbp_chroma << 4);
+    int16_t scan[16];
+
+    h264_bits_ue(b, 0);                     // mb_type: P_L0_16x16
+    h264_bits_se(b, mb->mv[0] - pmv[0]);
+    h264_bits_se(b, mb->mv[1] - pmv[1]);
+    h264_bits_ue(b, h264_inter_cbp_code[cbp]);
+    if (cbp == 0) {
+        return;
+    }
+    h264_bits_se(b, 0);                     // mb_qp_delta
+    for (int k = 0; k < 16; k++) {
+        int r = s_blk_raster[k];
+        if (!(cbp_luma & (1 << (k >> 2)))) {
+            continue;
+        }
+        for (int i = 0; i < 16; i++) {
+            scan[i] = enc->luma[r][h264_zigzag4x4[i]];
+        }
+        h264_cavlc_block(b, scan, 16, luma_nc(enc, mbx, mby, mb, r));
+    }
+    write_chroma_residual(enc, mbx, mby, mb, cbp_chroma);
+}
+
+/**
+ * @brief Code one macroblock as Intra16x16
+ */
+static void encode_intra(h264_enc_t *enc, int mbx, int mby, mb_info_t *mb, int mode,
+                         bool p_slice)
+{
+    mb->type = MB_INTRA;
+    mb->mv[0] = mb->mv[1] = 0;
+    int chroma_mode = choose_intra_chroma(enc, mbx, mby);
+    int cbp_luma = code_luma_intra16(enc, mbx, mby, mb);
+    int cbp_chroma = code_chroma(enc, mbx, mby, mb, true);
+    write_intra16(enc, mbx, mby, mb, p_slice, mode, chroma_mode, cbp_luma, cbp_chroma);
+}
+
+/**
+ * @brief Code one macroblock of a P slice
+ *
+ * Skipped macroblocks only extend the run; the run is written ahead of the
+ * next coded macroblock or at the end of the slice.
+ */
+static void encode_p(h264_enc_t *enc, int mbx, int mby, mb_info_t *mb, int *skip_run)
+{
+    int sy = enc->stride_y;
+    const uint8_t *src = enc->cur[0] + mby * 16 * sy + mbx * 16;
+    int16_t pmv[2], skip[2];
+    int cbp_luma, cbp_chroma;
+
+    predict_mv(enc, mbx, mby, pmv, skip);
+    mb->type = MB_INTER;
+
+    // A still background codes to nothing at the skip vector: try it first
+    int sx = mbx * 16 + skip[0] / 4;
+    int sy0 = mby * 16 + skip[1] / 4;
+    bool skip_inside = sx >= 0 && sy0 >= 0 && sx <= enc->stride_y - 16 && sy0 <= enc->mb_h * 16 - 16;
+    if (skip_inside && h264_dsp_sad16(src, sy, enc->ref[0] + sy0 * sy + sx, sy) < SKIP_SAD) {
+        mb->mv[0] = skip[0];
+        mb->mv[1] = skip[1];
+        predict_inter(enc, mbx, mby, skip[0] / 4, skip[1] / 4);
+        if (code_luma_inter(enc, mbx, mby, mb) == 0 && code_chroma(enc, mbx, mby, mb, false) == 0) {
+            mb->type = MB_SKIP;
+            (*skip_run)++;
+            return;
+        }
+    }
+
+    int mvx, mvy, mode = 2;
+    int inter_cost = motion_search(enc, mbx, mby, pmv, &mvx, &mvy);
+    int intra_cost = choose_intra16(enc, mbx, mby, &mode) + enc->lambda * 24;
+
+    if (intra_cost < inter_cost) {
+        h264_bits_ue(&enc->bits, *skip_run);
+        *skip_run = 0;
+        encode_intra(enc, mbx, mby, mb, mode, true);
+        return;
+    }
+
+    mb->mv[0] = mvx * 4;
+    mb->mv[1] = mvy * 4;
+    predict_inter(enc, mbx, mby, mvx, mvy);
+    cbp_luma = code_luma_inter(enc, mbx, mby, mb);
+    cbp_chroma = code_chroma(enc, mbx, mby, mb, false);
+    if (cbp_luma == 0 && cbp_chroma == 0 && mb->mv[0] == skip[0] && mb->mv[1] == skip[1]) {
+        mb->type = MB_SKIP;
+        (*skip_run)++;
+        return;
+    }
+    h264_bits_ue(&enc->bits, *skip_run);
+    *skip_run = 0;
+    write_inter(enc, mbx, mby, mb, pmv, cbp_luma, cbp_chroma);
+}
+
+// --- Deblocking ---
+
+static int boundary_strength(const mb_info_t *p, int pr, const mb_info_t *q, int qr,
+                             bool mb_edge)
+{
+    if (p->type == MB_INTRA || q->type == MB_INTRA) {
+        return mb_edge ? 4 : 3;
+    }
+    if (p->nnz[pr] || q->nnz[qr]) {
+        return 2;
+    }
+    return abs(p->mv[0] - q->mv[0]) >= 4 || abs(p->mv[1] - q->mv[1]) >= 4;
+}
+
+/**
+ * @brief Deblock the reconstruction in macroblock order (8.7)
+ */
+static void deblock(h264_enc_t *enc)
+{
+    int sy = enc->stride_y;
+    int sc = enc->stride_c;
+
+    for (int mby = 0; mby < enc->mb_h; mby++) {
+        for (int mbx = 0; mbx < enc->mb_w; mbx++) {
+            const mb_info_t *q = enc->mbs + mby * enc->mb_w + mbx;
+            uint8_t bs_v[4][4], bs_h[4][4];
+
+            for (int e = 0; e < 4; e++) {
+                for (int k = 0; k < 4; k++) {
+                    bs_v[e][k] = e == 0 ? (mbx > 0 ? boundary_strength(q - 1, k * 4 + 3, q, k * 4, true) : 0)
+                                        : boundary_strength(q, k * 4 + e - 1, q, k * 4 + e, false);
+                    bs_h[e][k] = e == 0 ? (mby > 0 ? boundary_strength(q - enc->mb_w, 12 + k, q, k, true) : 0)
+                                        : boundary_strength(q, (e - 1) * 4 + k, q, e * 4 + k, false);
+                }
+            }
+
+            int qp_left = mbx > 0 ? (q[-1].qp + q->qp + 1) >> 1 : q->qp;
+            int qp_top = mby > 0 ? (q[-enc->mb_w].qp + q->qp + 1) >> 1 : q->qp;
+            int qpc = h264_chroma_qp[q->qp];
+            int qpc_left = mbx > 0 ? (h264_chroma_qp[q[-1].qp] + qpc + 1) >> 1 : qpc;
+            int qpc_top = mby > 0 ? (h264_chroma_qp[q[-enc->mb_w].qp] + qpc + 1) >> 1 : qpc;
+
+            uint8_t *y = enc->rec[0] + mby * 16 * sy + mbx * 16;
+            for (int e = 0; e < 4; e++) {
+                h264_dsp_deblock_luma(y + e * 4, 1, sy, e ? q->qp : qp_left, bs_v[e]);
+            }
+            for (int e = 0; e < 4; e++) {
+                h264_dsp_deblock_luma(y + e * 4 * sy, sy, 1, e ? q->qp : qp_top, bs_h[e]);
+            }
+            for (int p = 1; p < 3; p++) {
+                uint8_t *c = enc->rec[p] + mby * 8 * sc + mbx * 8;
+                h264_dsp_deblock_chroma(c, 1, sc, qpc_left, bs_v[0]);
+                h264_dsp_deblock_chroma(c + 4, 1, sc, qpc, bs_v[2]);
+                h264_dsp_deblock_chroma(c, sc, 1, qpc_top, bs_h[0]);
+                h264_dsp_deblock_chroma(c + 4 * sc, sc, 1, qpc, bs_h[2]);
+            }
+        }
+    }
+}
+
+// --- Rate control ---
+
+/**
+ * @brief Move QP toward the bitrate target after each picture
+ *
+ * Overspend is repaid over about a second. IDR pictures count against the
+ * budget but do not steer QP by themselves, since their size says little
+ * about the P pictures that follow.
+ */
+static void rate_control(h264_enc_t *enc, size_t bytes, bool idr, int64_t timestamp_us)
+{
+    int bitrate = enc->config.bitrate;
+    int64_t dt = enc->last_us ? timestamp_us - enc->last_us : 100000;
+
+    enc->last_us = timestamp_us;
+    if (bitrate <= 0) {
+        return;
+    }
+    dt = dt < 10000 ? 10000 : dt > 1000000 ? 1000000 : dt;
+
+    int64_t budget = (int64_t)bitrate * dt / 1000000;
+    int64_t bits = (int64_t)bytes * 8;
+    enc->rc_fullness += bits - budget;
+    if (enc->rc_fullness > 2 * (int64_t)bitrate) {
+        enc->rc_fullness = 2 * (int64_t)bitrate;
+    } else if (enc->rc_fullness < -(int64_t)bitrate / 2) {
+        enc->rc_fullness = -(int64_t)bitrate / 2;
+    }
+    if (idr) {
+        return;
+    }
+
+    int64_t target = budget - enc->rc_fullness * dt / 1000000;
+    if (target < budget / 4) {
+        target = budget / 4;
+    }
+    float delta = 6.0f * log2f((float)(bits > 0 ? bits : 1) / (float)target);
+    int step = clip((int)lroundf(delta * 0.5f), -4, 4);
+    enc->qp = clip(enc->qp + step, QP_MIN, QP_MAX);
+}
+
+// --- API ---
+
+esp_err_t h264_enc_create(const h264_enc_config_t *config, h264_enc_t **out)
+{
+    if (config->width <= 0 || config->height <= 0 || (config->width & 1) ||
+        (config->height & 1) || config->gop < 1) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    h264_enc_t *enc = heap_caps_calloc(1, sizeof(h264_enc_t), MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    if (!enc) {
+        enc = heap_caps_calloc(1, sizeof(h264_enc_t), MALLOC_CAP_8BIT);
+    }
+    if (!enc) {
+        return ESP_ERR_NO_MEM;
+    }
+    enc->config = *config;
+    enc->mb_w = (config->width + 15) / 16;
+    enc->mb_h = (config->height + 15) / 16;
+    enc->stride_y = enc->mb_w * 16;
+    enc->stride_c = enc->mb_w * 8;
+
+    size_t luma = (size_t)enc->stride_y * enc->mb_h * 16;
+    size_t picture = luma * 3 / 2;
+    enc->out_cap = luma + 1024;
+    enc->pictures = heap_caps_malloc(picture * 3, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    enc->out = heap_caps_malloc(enc->out_cap, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    enc->mbs = heap_caps_calloc(enc->mb_w * enc->mb_h, sizeof(mb_info_t),
+                                MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    if (!enc->pictures || !enc->out || !enc->mbs) {
+        h264_enc_destroy(enc);
+        return ESP_ERR_NO_MEM;
+    }
+    for (int i = 0; i < 3; i++) {
+        uint8_t *base = enc->pictures + picture * i;
+        uint8_t **planes = i == 0 ? enc->cur : i == 1 ? enc->rec : enc->ref;
+        planes[0] = base;
+        planes[1] = base + luma;
+        planes[2] = base + luma + luma / 4;
+    }
+
+    enc->qp = clip(config->qp, QP_MIN, QP_MAX);
+    enc->idr_pending = true;
+    ESP_LOGI(TAG, "%dx%d, GOP %d, %d bps, QP %d", config->width, config->height,
+             config->gop, config->bitrate, enc->qp);
+    *out = enc;
+    return ESP_OK;
+}
+
+void h264_enc_destroy(h264_enc_t *enc)
+{
+    if (!enc) {
+        return;
+    }
+    heap_caps_free(enc->pictures);
+    heap_caps_free(enc->out);
+    heap_caps_free(enc->mbs);
+    heap_caps_free(enc);
+}
+
+void h264_enc_set_rate(h264_enc_t *enc, int bitrate, int gop)
+{
+    enc->config.bitrate = bitrate;
+    enc->config.gop = gop > 0 ? gop : 1;
+    enc->rc_fullness = 0;
+}
+
+void h264_enc_request_idr(h264_enc_t *enc)
+{
+    enc->idr_pending = true;
+}
+
+esp_err_t h264_enc_encode(h264_enc_t *enc, const uint8_t *yuyv, int64_t timestamp_us,
+                          h264_frame_t *frame)
+{
+    bool idr = enc->idr_pending || enc->gop_pos >= enc->config.gop;
+    int qp = enc->qp;
+
+    load_yuyv(enc, yuyv);
+    h264_bits_init(&enc->bits, enc->out, enc->out_cap);
+    if (idr) {
+        enc->frame_num = 0;
+        enc->idr_pic_id = (enc->idr_pic_id + 1) & 0xffff;
+        write_sps(enc);
+        write_pps(enc);
+    }
+    enc->lambda = lambda_for(qp);
+    write_slice_header(enc, idr, qp);
+
+    int skip_run = 0;
+    for (int mby = 0; mby < enc->mb_h; mby++) {
+        for (int mbx = 0; mbx < enc->mb_w; mbx++) {
+            mb_info_t *mb = enc->mbs + mby * enc->mb_w + mbx;
+            mb->qp = qp;
+            if (idr) {
+                int mode = 2;
+                choose_intra16(enc, mbx, mby, &mode);
+                encode_intra(enc, mbx, mby, mb, mode, false);
+            } else {
+                encode_p(enc, mbx, mby, mb, &skip_run);
+            }
+        }
+        if (enc->bits.overflow) {
+            break;
+        }
+    }
+    if (skip_run > 0) {
+        h264_bits_ue(&enc->bits, skip_run);
+    }
+    h264_bits_trailing(&enc->bits);
+
+    if (enc->bits.overflow) {
+        // The reference is untouched, so the next P picture still decodes
+        ESP_LOGW(TAG, "Picture over %u bytes at QP %d, dropped", (unsigned)enc->out_cap, qp);
+        enc->qp = clip(qp + 6, QP_MIN, QP_MAX);
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    deblock(enc);
+    for (int i = 0; i < 3; i++) {
+        uint8_t *tmp = enc->ref[i];
+        enc->ref[i] = enc->rec[i];
+        enc->rec[i] = tmp;
+    }
+    enc->frame_num = (enc->frame_num + 1) & 15;
+    enc->gop_pos = idr ? 1 : enc->gop_pos + 1;
+    enc->idr_pending = false;
+    rate_control(enc, enc->bits.len, idr, timestamp_us);
+
+    frame->data = enc->out;
+    frame->len = enc->bits.len;
+    frame->idr = idr;
+    frame->qp = qp;
+    return ESP_OK;
+}
+
+bool h264_next_nal(const uint8_t *data, size_t len, size_t *pos,
+                   const uint8_t **nal, size_t *nal_len)
+{
+    size_t i = *pos;
+
+    while (i + 3 <= len && !(data[i] == 0 && data[i + 1] == 0 && data[i + 2] == 1)) {
+        i++;
+    }
+    if (i + 3 > len) {
+        *pos = len;
+        return false;
+    }
+    size_t start = i + 3;
+    size_t end = start;
+    while (end + 3 <= len && !(data[end] == 0 && data[end + 1] == 0 && data[end + 2] == 1)) {
+        end++;
+    }
+    if (end + 3 > len) {
+        end = len;
+    }
+    *pos = end;
+    while (end > start && data[end - 1] == 0) {
+        end--;                              // zero_byte of the next start code
+    }
+    *nal = data + start;
+    *nal_len = end - start;
+    return true;
+}
@@ -0,0 +1,103 @@
+/**
+ * @file h264_enc.h
+ * @brief Software H.264 Baseline encoder for YUYV camera frames
+ *
+ * Constrained Baseline profile, one slice per picture, CAVLC. I pictures
+ * use Intra16x16 prediction; P pictures use one full-pel motion vector per
+ * macroblock (P_L0_16x16 or P_Skip) with Intra16x16 as a fallback, and a
+ * single reference frame. The in-loop deblocking filter is applied, so
+ * the reconstructed reference is bit-exact with any conforming decoder.
+ *
+ * Rate control adjusts the frame QP to hold a target bitrate measured
+ * against the capture timestamps, so a variable frame rate still yields
+ * the requested bits per second.
+ */
+
+#ifndef H264_ENC_H
+#define H264_ENC_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+/**
+ * @brief Encoder configuration
+ */
+typedef struct {
+    int width;                  // Image width in pixels (even)
+    int height;                 // Image height in pixels (even)
+    int gop;                    // Pictures from one IDR to the next
+    int bitrate;                // Target bits per second, 0 for constant QP
+    int qp;                     // Constant QP, or the starting point (10-51)
+} h264_enc_config_t;
+
+/**
+ * @brief One encoded picture
+ */
+typedef struct {
+    uint8_t *data;              // Annex B access unit, 4-byte start codes; may be
+                                // rewritten in place (see h264_mp4_split_au())
+    size_t len;
+    bool idr;                   // Starts with SPS and PPS
+    int qp;
+} h264_frame_t;
+
+typedef struct h264_enc h264_enc_t;
+
+/**
+ * @brief Create an encoder
+ *
+ * Picture buffers come from PSRAM: about 6 bytes per pixel in total.
+ *
+ * @param config Encoder configuration
+ * @param enc Receives the encoder
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG or ESP_ERR_NO_MEM
+ */
+esp_err_t h264_enc_create(const h264_enc_config_t *config, h264_enc_t **enc);
+
+/**
+ * @brief Free an encoder
+ */
+void h264_enc_destroy(h264_enc_t *enc);
+
+/**
+ * @brief Change the rate targets; takes effect from the next picture
+ *
+ * @param bitrate Bits per second, 0 for constant QP
+ * @param gop Pictures from one IDR to the next
+ */
+void h264_enc_set_rate(h264_enc_t *enc, int bitrate, int gop);
+
+/**
+ * @brief Make the next picture an IDR, e.g. for a new viewer
+ */
+void h264_enc_request_idr(h264_enc_t *enc);
+
+/**
+ * @brief Encode one picture
+ *
+ * @param enc Encoder
+ * @param yuyv Packed YUYV 4:2:2, width * 2 bytes per row
+ * @param timestamp_us Capture time, for rate control
+ * @param frame Receives the access unit; valid until the next call
+ * @return ESP_OK on success, ESP_ERR_INVALID_SIZE if the picture did not
+ *         fit the output buffer (it is dropped and QP raised)
+ */
+esp_err_t h264_enc_encode(h264_enc_t *enc, const uint8_t *yuyv, int64_t timestamp_us,
+                          h264_frame_t *frame);
+
+/**
+ * @brief Iterate over the NAL units of an Annex B buffer
+ *
+ * @param data Byte stream
+ * @param len Its length
+ * @param pos Scan position, 0 to start; advanced past the unit returned
+ * @param nal Receives the NAL unit, header byte first, without start code
+ * @param nal_len Receives its length
+ * @return true if a unit was found
+ */
+bool h264_next_nal(const uint8_t *data, size_t len, size_t *pos,
+                   const uint8_t **nal, size_t *nal_len);
+
+#endif // H264_ENC_H
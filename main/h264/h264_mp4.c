@@ -0,0 +1,340 @@
+/**
+ * @file h264_mp4.c
+ * @brief Fragmented MP4 packaging implementation (ISO/IEC 14496-12 and -15)
+ */
+
+#include "h264/h264_mp4.h"
+#include "h264/h264_enc.h"
+#include <stdio.h>
+#include <string.h>
+
+#define NAL_SPS 7
+#define NAL_PPS 8
+
+#define BOX_DEPTH 8
+
+// Sample flags (8.8.3.1): sample_depends_on, sample_is_non_sync_sample
+#define SAMPLE_FLAGS_SYNC     0x02000000
+#define SAMPLE_FLAGS_NON_SYNC 0x01010000
+
+/**
+ * @brief Box writer; sizes are patched in when each box is closed
+ */
+typedef struct {
+    uint8_t *buf;
+    size_t cap;
+    size_t len;
+    bool overflow;
+    size_t open[BOX_DEPTH];
+    int depth;
+} box_writer_t;
+
+static void put_bytes(box_writer_t *w, const void *data, size_t len)
+{
+    if (w->overflow || len > w->cap - w->len) {
+        w->overflow = true;
+        return;
+    }
+    memcpy(w->buf + w->len, data, len);
+    w->len += len;
+}
+
+static void put_zeros(box_writer_t *w, size_t len)
+{
+    if (w->overflow || len > w->cap - w->len) {
+        w->overflow = true;
+        return;
+    }
+    memset(w->buf + w->len, 0, len);
+    w->len += len;
+}
+
+static void put_u8(box_writer_t *w, uint8_t v)
+{
+    put_bytes(w, &v, 1);
+}
+
+static void put_u16(box_writer_t *w, uint16_t v)
+{
+    uint8_t b[2] = { v >> 8, v };
+
+    put_bytes(w, b, 2);
+}
+
+static void put_u32(box_writer_t *w, uint32_t v)
+{
+    uint8_t b[4] = { v >> 24, v >> 16, v >> 8, v };
+
+    put_bytes(w, b, 4);
+}
+
+static void put_u64(box_writer_t *w, uint64_t v)
+{
+    put_u32(w, (uint32_t)(v >> 32));
+    put_u32(w, (uint32_t)v);
+}
+
+static void box_open(box_writer_t *w, const char *type)
+{
+    w->open[w->depth++] = w->len;
+    put_u32(w, 0);
+    put_bytes(w, type, 4);
+}
+
+/**
+ * @brief Open a full box: version and 24-bit flags follow the type
+ */
+static void full_box_open(box_writer_t *w, const char *type, uint8_t version, uint32_t flags)
+{
+    box_open(w, type);
+    put_u32(w, ((uint32_t)version << 24) | flags);
+}
+
+static void box_close(box_writer_t *w)
+{
+    size_t start = w->open[--w->depth];
+
+    if (!w->overflow) {
+        uint32_t size = w->len - start;
+        uint8_t *p = w->buf + start;
+        p[0] = size >> 24;
+        p[1] = size >> 16;
+        p[2] = size >> 8;
+        p[3] = size;
+    }
+}
+
+/**
+ * @brief Unity transformation matrix of mvhd and tkhd
+ */
+static void put_matrix(box_writer_t *w)
+{
+    static const uint32_t matrix[9] = {
+        0x00010000, 0, 0, 0, 0x00010000, 0, 0, 0, 0x40000000,
+    };
+
+    for (int i = 0; i < 9; i++) {
+        put_u32(w, matrix[i]);
+    }
+}
+
+bool h264_mp4_split_au(uint8_t *data, size_t len, h264_mp4_au_t *au)
+{
+    size_t pos = 0;
+    const uint8_t *nal;
+    size_t nal_len;
+
+    memset(au, 0, sizeof(*au));
+    while (h264_next_nal(data, len, &pos, &nal, &nal_len)) {
+        if (nal < data + 4 || nal[-4] != 0 || nal_len == 0) {
+            return false;
+        }
+        uint8_t *prefix = (uint8_t *)nal - 4;
+        prefix[0] = nal_len >> 24;
+        prefix[1] = nal_len >> 16;
+        prefix[2] = nal_len >> 8;
+        prefix[3] = nal_len;
+
+        int type = nal[0] & 0x1f;
+        if (type == NAL_SPS) {
+            au->sps = nal;
+            au->sps_len = nal_len;
+        } else if (type == NAL_PPS) {
+            au->pps = nal;
+            au->pps_len = nal_len;
+        } else if (!au->sample) {
+            au->sample = prefix;
+        }
+    }
+    if (!au->sample) {
+        return false;
+    }
+    au->sample_len = data + len - au->sample;
+    return true;
+}
+
+size_t h264_mp4_init_segment(uint8_t *out, size_t cap, int width, int height,
+                             const h264_mp4_au_t *au)
+{
+    box_writer_t w = { .buf = out, .cap = cap };
+
+    if (!au->sps || au->sps_len < 4 || !au->pps) {
+        return 0;
+    }
+
+    box_open(&w, "ftyp");
+    put_bytes(&w, "isom", 4);                   // major_brand
+    put_u32(&w, 0x200);                         // minor_version
+    put_bytes(&w, "isomiso6avc1mp41", 16);      // compatible_brands
+    box_close(&w);
+
+    box_open(&w, "moov");
+
+    full_box_open(&w, "mvhd", 0, 0);
+    put_u32(&w, 0);                             // creation_time
+    put_u32(&w, 0);                             // modification_time
+    put_u32(&w, H264_MP4_TIMESCALE);
+    put_u32(&w, 0);                             // duration: live, unknown
+    put_u32(&w, 0x00010000);                    // rate 1.0
+    put_u16(&w, 0x0100);                        // volume 1.0
+    put_zeros(&w, 10);
+    put_matrix(&w);
+    put_zeros(&w, 24);                          // pre_defined
+    put_u32(&w, 2);                             // next_track_ID
+    box_close(&w);
+
+    box_open(&w, "trak");
+    full_box_open(&w, "tkhd", 0, 0x000003);     // enabled, in movie
+    put_u32(&w, 0);
+    put_u32(&w, 0);
+    put_u32(&w, 1);                             // track_ID
+    put_u32(&w, 0);
+    put_u32(&w, 0);                             // duration
+    put_zeros(&w, 8);
+    put_u16(&w, 0);                             // layer
+    put_u16(&w, 0);                             // alternate_group
+    put_u16(&w, 0);                             // volume: video
+    put_u16(&w, 0);
+    put_matrix(&w);
+    put_u32(&w, (uint32_t)width << 16);         // 16.16 fixed point
+    put_u32(&w, (uint32_t)height << 16);
+    box_close(&w);
+
+    box_open(&w, "mdia");
+    full_box_open(&w, "mdhd", 0, 0);
+    put_u32(&w, 0);
+    put_u32(&w, 0);
+    put_u32(&w, H264_MP4_TIMESCALE);
+    put_u32(&w, 0);
+    put_u16(&w, 0x55c4);                        // language: und
+    put_u16(&w, 0);
+    box_close(&w);
+
+    full_box_open(&w, "hdlr", 0, 0);
+    put_u32(&w, 0);
+    put_bytes(&w, "vide", 4);
+    put_zeros(&w, 12);
+    put_bytes(&w, "VideoHandler", 13);          // Including the terminator
+    box_close(&w);
+
+    box_open(&w, "minf");
+    full_box_open(&w, "vmhd", 0, 0x000001);
+    put_zeros(&w, 8);                           // graphicsmode, opcolor
+    box_close(&w);
+
+    box_open(&w, "dinf");
+    full_box_open(&w, "dref", 0, 0);
+    put_u32(&w, 1);
+    full_box_open(&w, "url ", 0, 0x000001);     // Media is in this file
+    box_close(&w);
+    box_close(&w);
+    box_close(&w);
+
+    box_open(&w, "stbl");
+    full_box_open(&w, "stsd", 0, 0);
+    put_u32(&w, 1);
+    box_open(&w, "avc1");
+    put_zeros(&w, 6);
+    put_u16(&w, 1);                             // data_reference_index
+    put_zeros(&w, 16);
+    put_u16(&w, width);
+    put_u16(&w, height);
+    put_u32(&w, 0x00480000);                    // 72 dpi
+    put_u32(&w, 0x00480000);
+    put_u32(&w, 0);
+    put_u16(&w, 1);                             // frame_count
+    put_zeros(&w, 32);                          // compressorname
+    put_u16(&w, 0x0018);                        // depth
+    put_u16(&w, 0xffff);                        // pre_defined
+    box_open(&w, "avcC");
+    put_u8(&w, 1);                              // configurationVersion
+    put_u8(&w, au->sps[1]);                     // AVCProfileIndication
+    put_u8(&w, au->sps[2]);                     // profile_compatibility
+    put_u8(&w, au->sps[3]);                     // AVCLevelIndication
+    put_u8(&w, 0xff);                           // 4-byte NAL unit lengths
+    put_u8(&w, 0xe1);                           // One SPS
+    put_u16(&w, au->sps_len);
+    put_bytes(&w, au->sps, au->sps_len);
+    put_u8(&w, 1);                              // One PPS
+    put_u16(&w, au->pps_len);
+    put_bytes(&w, au->pps, au->pps_len);
+    box_close(&w);
+    box_close(&w);
+    box_close(&w);
+
+    // Samples live in the fragments; the sample tables stay empty
+    static const char *const empty[] = { "stts", "stsc", "stco" };
+    for (int i = 0; i < 3; i++) {
+        full_box_open(&w, empty[i], 0, 0);
+        put_u32(&w, 0);
+        box_close(&w);
+    }
+    full_box_open(&w, "stsz", 0, 0);
+    put_u32(&w, 0);
+    put_u32(&w, 0);
+    box_close(&w);
+
+    box_close(&w);                              // stbl
+    box_close(&w);                              // minf
+    box_close(&w);                              // mdia
+    box_close(&w);                              // trak
+
+    box_open(&w, "mvex");
+    full_box_open(&w, "trex", 0, 0);
+    put_u32(&w, 1);                             // track_ID
+    put_u32(&w, 1);                             // default_sample_description_index
+    put_u32(&w, 0);
+    put_u32(&w, 0);
+    put_u32(&w, 0);
+    box_close(&w);
+    box_close(&w);
+
+    box_close(&w);                              // moov
+    return w.overflow ? 0 : w.len;
+}
+
+size_t h264_mp4_fragment_header(uint8_t *out, uint32_t seq, uint64_t decode_time,
+                                uint32_t duration, size_t sample_len, bool sync)
+{
+    box_writer_t w = { .buf = out, .cap = H264_MP4_FRAGMENT_HEADER_SIZE };
+
+    box_open(&w, "moof");
+    full_box_open(&w, "mfhd", 0, 0);
+    put_u32(&w, seq);
+    box_close(&w);
+
+    box_open(&w, "traf");
+    full_box_open(&w, "tfhd", 0, 0x020000);     // default-base-is-moof
+    put_u32(&w, 1);
+    box_close(&w);
+    full_box_open(&w, "tfdt", 1, 0);
+    put_u64(&w, decode_time);
+    box_close(&w);
+    // data-offset, sample-duration, sample-size and sample-flags present
+    full_box_open(&w, "trun", 0, 0x000701);
+    put_u32(&w, 1);
+    size_t data_offset = w.len;
+    put_u32(&w, 0);
+    put_u32(&w, duration);
+    put_u32(&w, sample_len);
+    put_u32(&w, sync ? SAMPLE_FLAGS_SYNC : SAMPLE_FLAGS_NON_SYNC);
+    box_close(&w);
+    box_close(&w);                              // traf
+    box_close(&w);                              // moof
+
+    // The sample starts right after the mdat header
+    uint32_t offset = w.len + 8;
+    out[data_offset] = offset >> 24;
+    out[data_offset + 1] = offset >> 16;
+    out[data_offset + 2] = offset >> 8;
+    out[data_offset + 3] = offset;
+
+    put_u32(&w, 8 + sample_len);
+    put_bytes(&w, "mdat", 4);
+    return w.len;
+}
+
+void h264_mp4_codec_string(const h264_mp4_au_t *au, char *out)
+{
+    snprintf(out, 12, "avc1.%02x%02x%02x", au->sps[1], au->sps[2], au->sps[3]);
+}
@@ -0,0 +1,90 @@
+/**
+ * @file h264_mp4.h
+ * @brief Fragmented MP4 packaging of the H.264 encoder's output
+ *
+ * A live fMP4 stream is one init segment (ftyp + moov with the avcC
+ * decoder configuration) followed by one movie fragment (moof + mdat) per
+ * picture, as played by browsers' Media Source Extensions, ffplay and VLC.
+ *
+ * Samples are the encoder's access units rewritten in place from Annex B to
+ * 4-byte length prefixes, so fragment payloads go out straight from the
+ * encoder's buffer; only the fragment header is built separately.
+ */
+
+#ifndef H264_MP4_H
+#define H264_MP4_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Media timescale: 90 kHz, as for RTP video
+#define H264_MP4_TIMESCALE 90000
+
+// Size of the buffer h264_mp4_fragment_header() needs
+#define H264_MP4_FRAGMENT_HEADER_SIZE 108
+
+/**
+ * @brief An access unit split for packaging
+ */
+typedef struct {
+    const uint8_t *sps;         // Sequence parameter set NAL, NULL if absent
+    size_t sps_len;
+    const uint8_t *pps;         // Picture parameter set NAL, NULL if absent
+    size_t pps_len;
+    const uint8_t *sample;      // Remaining NAL units, length-prefixed
+    size_t sample_len;
+} h264_mp4_au_t;
+
+/**
+ * @brief Rewrite an access unit's start codes as lengths, in place
+ *
+ * Every NAL unit must start with a 4-byte start code, as the encoder
+ * writes them. SPS and PPS are split off for the init segment; the rest
+ * becomes the sample.
+ *
+ * @param data Annex B access unit, modified
+ * @param len Its length
+ * @param au Receives the parameter sets and the sample
+ * @return false if the data is not a 4-byte start code stream
+ */
+bool h264_mp4_split_au(uint8_t *data, size_t len, h264_mp4_au_t *au);
+
+/**
+ * @brief Build the init segment
+ *
+ * @param out Output buffer
+ * @param cap Its size; 640 bytes plus the parameter sets is enough
+ * @param width Picture width
+ * @param height Picture height
+ * @param au An IDR access unit's parameter sets
+ * @return Length written, 0 if cap was too small
+ */
+size_t h264_mp4_init_segment(uint8_t *out, size_t cap, int width, int height,
+                             const h264_mp4_au_t *au);
+
+/**
+ * @brief Build the moof box and mdat header for one sample
+ *
+ * The sample data itself follows the returned bytes.
+ *
+ * @param out Output buffer, H264_MP4_FRAGMENT_HEADER_SIZE bytes
+ * @param seq Fragment sequence number, from 1
+ * @param decode_time Sample decode time in H264_MP4_TIMESCALE units
+ * @param duration Sample duration in the same units
+ * @param sample_len Sample length
+ * @param sync true for an IDR picture
+ * @return Length written
+ */
+size_t h264_mp4_fragment_header(uint8_t *out, uint32_t seq, uint64_t decode_time,
+                                uint32_t duration, size_t sample_len, bool sync);
+
+/**
+ * @brief RFC 6381 codec string for the parameter sets, e.g. "avc1.42c01e"
+ *
+ * @param au Access unit with an SPS
+ * @param out Output, at least 12 bytes
+ */
+void h264_mp4_codec_string(const h264_mp4_au_t *au, char *out);
+
+#endif // H264_MP4_H
@@ -0,0 +1,52 @@
+/**
+ * @file h264_tables.h
+ * @brief Constant tables for the H.264 Baseline encoder
+ *
+ * CAVLC code tables (ITU-T H.264 tables 9-5, 9-7, 9-8, 9-9 and 9-10) stored
+ * as code value and length, plus the quantization and deblocking tables of
+ * clauses 8.5 and 8.7.
+ */
+
+#ifndef H264_TABLES_H
+#define H264_TABLES_H
+
+#include <stdint.h>
+
+// coeff_token, indexed [nC class][TotalCoeff][TrailingOnes]
+extern const uint8_t h264_coeff_token_len[4][17][4];
+extern const uint8_t h264_coeff_token_bits[4][17][4];
+
+// coeff_token for chroma DC (nC == -1), indexed [TotalCoeff][TrailingOnes]
+extern const uint8_t h264_chroma_dc_coeff_token_len[5][4];
+extern const uint8_t h264_chroma_dc_coeff_token_bits[5][4];
+
+// total_zeros, indexed [TotalCoeff - 1][total_zeros]
+extern const uint8_t h264_total_zeros_len[15][16];
+extern const uint8_t h264_total_zeros_bits[15][16];
+extern const uint8_t h264_chroma_dc_total_zeros_len[3][4];
+extern const uint8_t h264_chroma_dc_total_zeros_bits[3][4];
+
+// run_before, indexed [min(zerosLeft, 7) - 1][run_before]
+extern const uint8_t h264_run_before_len[7][15];
+extern const uint8_t h264_run_before_bits[7][15];
+
+// coded_block_pattern to codeNum for inter macroblocks (table 9-4)
+extern const uint8_t h264_inter_cbp_code[48];
+
+// Frame zigzag scan, scan position to raster position
+extern const uint8_t h264_zigzag4x4[16];
+
+// Forward quantization multipliers and dequantization scales, indexed
+// [QP % 6][position class]: 0 for (even, even), 1 for (odd, odd), 2 otherwise
+extern const uint16_t h264_quant_mf[6][3];
+extern const uint8_t h264_dequant_v[6][3];
+
+// QPc for chroma_qp_index_offset 0, indexed by QPY
+extern const uint8_t h264_chroma_qp[52];
+
+// Deblocking thresholds, indexed by indexA/indexB, and tC0 [indexA][bS - 1]
+extern const uint8_t h264_alpha[52];
+extern const uint8_t h264_beta[52];
+extern const uint8_t h264_tc0[52][3];
+
+#endif // H264_TABLES_H
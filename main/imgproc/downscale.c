@@ -0,0 +1,167 @@
+/**
+ * @file downscale.c
+ * @brief YUV422 (YUYV) frame downscaling implementation
+ */
+
+#include "imgproc/downscale.h"
+
+const char *downscale_kernel_name(downscale_kernel_t kernel)
+{
+    return kernel == DOWNSCALE_KERNEL_SWAR ? "swar" : "scalar";
+}
+
+/**
+ * @brief Reference kernel: rounded average of each 2x2 block
+ *
+ * Each 8-byte group (two pixel pairs) of two rows becomes one 4-byte pixel
+ * pair. Luma averages its 2x2 neighbourhood; chroma averages the two U (or
+ * V) samples of both rows.
+ */
+static void half_scalar(const uint8_t *src, int width, int height, uint8_t *dst)
+{
+    const int src_stride = width * 2;
+    const int groups = width / 4;
+
+    for (int y = 0; y < height / 2; y++) {
+        const uint8_t *r0 = src + (2 * y) * src_stride;
+        const uint8_t *r1 = r0 + src_stride;
+        uint8_t *out = dst + y * groups * 4;
+
+        for (int g = 0; g < groups; g++) {
+            const uint8_t *a = r0 + g * 8;
+            const uint8_t *b = r1 + g * 8;
+            out[0] = (a[0] + a[2] + b[0] + b[2] + 2) >> 2;     // Y
+            out[1] = (a[1] + a[5] + b[1] + b[5] + 2) >> 2;     // U
+            out[2] = (a[4] + a[6] + b[4] + b[6] + 2) >> 2;     // Y
+            out[3] = (a[3] + a[7] + b[3] + b[7] + 2) >> 2;     // V
+            out += 4;
+        }
+    }
+}
+
+// Per-byte averages of two words without carries between lanes
+static inline uint32_t avg_floor(uint32_t a, uint32_t b)
+{
+    return (a & b) + (((a ^ b) >> 1) & 0x7f7f7f7fu);
+}
+
+static inline uint32_t avg_ceil(uint32_t a, uint32_t b)
+{
+    return (a | b) - (((a ^ b) >> 1) & 0x7f7f7f7fu);
+}
+
+/**
+ * @brief SWAR kernel: four byte averages per word operation
+ *
+ * Rows are averaged vertically rounding up, then the lanes are shuffled so
+ * the horizontal pairs line up and averaged rounding down; the opposite
+ * rounding keeps the result within 1 of the exact average with no bias.
+ */
+static void half_swar(const uint8_t *src, int width, int height, uint8_t *dst)
+{
+    const int src_words = width / 2;
+    const int groups = width / 4;
+
+    for (int y = 0; y < height / 2; y++) {
+        const uint32_t *r0 = (const uint32_t *)src + (2 * y) * src_words;
+        const uint32_t *r1 = r0 + src_words;
+        uint32_t *out = (uint32_t *)dst + y * groups;
+
+        for (int g = 0; g < groups; g++) {
+            // Little-endian lanes: a = [Y0 U0 Y1 V0], b = [Y2 U1 Y3 V1]
+            uint32_t a = avg_ceil(r0[2 * g], r1[2 * g]);
+            uint32_t b = avg_ceil(r0[2 * g + 1], r1[2 * g + 1]);
+
+            // p = [Y0 U0 Y2 V0], q = [Y1 U1 Y3 V1]
+            uint32_t p = (a & 0xff00ffffu) | ((b << 16) & 0x00ff0000u);
+            uint32_t q = ((a >> 16) & 0x000000ffu) | (b & 0xffffff00u);
+            out[g] = avg_floor(p, q);
+        }
+    }
+}
+
+void downscale_yuyv_half(downscale_kernel_t kernel, const uint8_t *src, int width, int height,
+                         uint8_t *dst)
+{
+    if (kernel == DOWNSCALE_KERNEL_SWAR) {
+        half_swar(src, width, height, dst);
+    } else {
+        half_scalar(src, width, height, dst);
+    }
+}
+
+/**
+ * @brief Interpolate four samples with 8-bit weights
+ */
+static inline uint8_t lerp2d(int p00, int p01, int p10, int p11, int wx, int wy)
+{
+    int top = p00 * (256 - wx) + p01 * wx;
+    int bottom = p10 * (256 - wx) + p11 * wx;
+    return (uint8_t)((top * (256 - wy) + bottom * wy + 32768) >> 16);
+}
+
+/**
+ * @brief 16.16 source position of the first output sample and the step
+ *
+ * Sample centres are aligned, so the first position may be negative and
+ * is clamped by the caller.
+ */
+static inline void scale_step(int src_len, int dst_len, int32_t *start, int32_t *step)
+{
+    *step = (int32_t)(((int64_t)src_len << 16) / dst_len);
+    *start = *step / 2 - 32768;
+}
+
+void downscale_yuyv_resize(const uint8_t *src, int src_width, int src_height,
+                           uint8_t *dst, int dst_width, int dst_height)
+{
+    downscale_yuyv_resize_rows(src, src_width, src_height, dst, dst_width, dst_height,
+                               0, dst_height);
+}
+
+void downscale_yuyv_resize_rows(const uint8_t *src, int src_width, int src_height,
+                                uint8_t *dst, int dst_width, int dst_height,
+                                int first_row, int rows)
+{
+    const int src_stride = src_width * 2;
+    const int src_pairs = src_width / 2;
+    int32_t y_start, y_step, x_start, x_step, c_start, c_step;
+
+    scale_step(src_height, dst_height, &y_start, &y_step);
+    scale_step(src_width, dst_width, &x_start, &x_step);
+    scale_step(src_pairs, dst_width / 2, &c_start, &c_step);
+
+    int32_t fy = y_start + first_row * y_step;
+    for (int y = 0; y < rows; y++, fy += y_step) {
+        int32_t cy = fy < 0 ? 0 : fy;
+        int sy = cy >> 16;
+        int sy1 = sy + 1 < src_height ? sy + 1 : sy;
+        int wy = (cy >> 8) & 0xff;
+        const uint8_t *r0 = src + sy * src_stride;
+        const uint8_t *r1 = src + sy1 * src_stride;
+        uint8_t *out = dst + y * dst_width * 2;
+
+        // Luma: every output pixel, from the two nearest source pixels
+        int32_t fx = x_start;
+        for (int x = 0; x < dst_width; x++, fx += x_step) {
+            int32_t cx = fx < 0 ? 0 : fx;
+            int sx = cx >> 16;
+            int sx1 = sx + 1 < src_width ? sx + 1 : sx;
+            int wx = (cx >> 8) & 0xff;
+            out[2 * x] = lerp2d(r0[2 * sx], r0[2 * sx1], r1[2 * sx], r1[2 * sx1], wx, wy);
+        }
+
+        // Chroma: one U/V pair per output pixel pair
+        int32_t fc = c_start;
+        for (int c = 0; c < dst_width / 2; c++, fc += c_step) {
+            int32_t cc = fc < 0 ? 0 : fc;
+            int sc = cc >> 16;
+            int sc1 = sc + 1 < src_pairs ? sc + 1 : sc;
+            int wc = (cc >> 8) & 0xff;
+            out[4 * c + 1] = lerp2d(r0[4 * sc + 1], r0[4 * sc1 + 1],
+                                    r1[4 * sc + 1], r1[4 * sc1 + 1], wc, wy);
+            out[4 * c + 3] = lerp2d(r0[4 * sc + 3], r0[4 * sc1 + 3],
+                                    r1[4 * sc + 3], r1[4 * sc1 + 3], wc, wy);
+        }
+    }
+}
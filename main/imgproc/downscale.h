@@ -0,0 +1,86 @@
+/**
+ * @file downscale.h
+ * @brief YUV422 (YUYV) frame downscaling
+ *
+ * Frames are reduced by repeated 2x2 box halving, which can run in place
+ * on the camera frame buffer, followed by one bilinear resample to the
+ * exact target size. Halving has a portable scalar reference kernel and a
+ * SWAR kernel that averages four bytes per 32-bit operation.
+ *
+ * All buffers are packed YUYV (Y0 U Y1 V per pixel pair) without row
+ * padding and must be 4-byte aligned.
+ */
+
+#ifndef DOWNSCALE_H
+#define DOWNSCALE_H
+
+#include <stdint.h>
+
+/**
+ * @brief Halving kernel implementations
+ */
+typedef enum {
+    DOWNSCALE_KERNEL_SCALAR = 0,    // Exact rounded 2x2 average, one byte at a time
+    DOWNSCALE_KERNEL_SWAR,          // Four bytes per word, may differ from scalar by 1
+} downscale_kernel_t;
+
+/**
+ * @brief Get a kernel's name for logs and query parameters
+ *
+ * @param kernel Kernel
+ * @return Kernel name ("scalar" or "swar")
+ */
+const char *downscale_kernel_name(downscale_kernel_t kernel);
+
+/**
+ * @brief Halve a frame in both directions with a 2x2 box filter
+ *
+ * The output is (width / 2) x (height / 2) rounded down to an even width.
+ * dst may equal src to halve in place.
+ *
+ * @param kernel Kernel to use
+ * @param src Source frame
+ * @param width Source width in pixels (multiple of 4)
+ * @param height Source height in pixels
+ * @param dst Destination frame
+ */
+void downscale_yuyv_half(downscale_kernel_t kernel, const uint8_t *src, int width, int height,
+                         uint8_t *dst);
+
+/**
+ * @brief Resample a frame to an arbitrary smaller or equal size (bilinear)
+ *
+ * Meant for the final step after halving, where the scale factor is below
+ * two. src and dst must not overlap.
+ *
+ * @param src Source frame
+ * @param src_width Source width in pixels (even)
+ * @param src_height Source height in pixels
+ * @param dst Destination frame
+ * @param dst_width Destination width in pixels (even)
+ * @param dst_height Destination height in pixels
+ */
+void downscale_yuyv_resize(const uint8_t *src, int src_width, int src_height,
+                           uint8_t *dst, int dst_width, int dst_height);
+
+/**
+ * @brief Resample a band of output rows (bilinear)
+ *
+ * Same as downscale_yuyv_resize() but only produces output rows
+ * [first_row, first_row + rows), written to the start of dst. Lets a
+ * consumer such as the JPEG encoder take the output stripe by stripe.
+ *
+ * @param src Source frame
+ * @param src_width Source width in pixels (even)
+ * @param src_height Source height in pixels
+ * @param dst Destination rows
+ * @param dst_width Destination width in pixels (even)
+ * @param dst_height Full destination height in pixels
+ * @param first_row First output row to produce
+ * @param rows Number of rows to produce
+ */
+void downscale_yuyv_resize_rows(const uint8_t *src, int src_width, int src_height,
+                                uint8_t *dst, int dst_width, int dst_height,
+                                int first_row, int rows);
+
+#endif // DOWNSCALE_H
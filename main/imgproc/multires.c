@@ -0,0 +1,206 @@
+/**
+ * @file multires.c
+ * @brief Multi-resolution JPEG output implementation
+ */
+
+#include "imgproc/multires.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_cpu.h"
+#include "esp_heap_caps.h"
+#include <string.h>
+
+static const char *TAG = "multires";
+
+// Initial size of the per-output JPEG buffer (grows as needed)
+#define MULTIRES_JPEG_BUF_INITIAL (64 * 1024)
+
+/**
+ * @brief Growing PSRAM buffer collecting one JPEG
+ */
+typedef struct {
+    uint8_t *data;
+    size_t len;
+    size_t cap;
+} jpeg_buf_t;
+
+static esp_err_t jpeg_buf_append(const uint8_t *data, size_t len, void *ctx)
+{
+    jpeg_buf_t *buf = ctx;
+
+    if (buf->len + len > buf->cap) {
+        size_t cap = buf->cap ? buf->cap * 2 : MULTIRES_JPEG_BUF_INITIAL;
+        while (cap < buf->len + len) {
+            cap *= 2;
+        }
+        uint8_t *grown = heap_caps_realloc(buf->data, cap, MALLOC_CAP_SPIRAM);
+        if (grown == NULL) {
+            return ESP_ERR_NO_MEM;
+        }
+        buf->data = grown;
+        buf->cap = cap;
+    }
+    memcpy(buf->data + buf->len, data, len);
+    buf->len += len;
+    return ESP_OK;
+}
+
+/**
+ * @brief Encode one output, resampling stripe by stripe if the size differs
+ *
+ * Only one stripe of resampled rows exists at a time, so no full-size
+ * intermediate frame is needed.
+ */
+static esp_err_t encode_output(const uint8_t *level, int level_w, int level_h, int w, int h,
+                               int quality, jpeg_qtable_t qtable, jpeg_buf_t *buf,
+                               uint32_t *scale_us)
+{
+    jpeg_enc_config_t config = {
+        .width = w,
+        .height = h,
+        .quality = quality,
+        .qtable = qtable,
+        .output = jpeg_buf_append,
+        .ctx = buf,
+    };
+    jpeg_enc_t *enc;
+    esp_err_t err = jpeg_enc_begin(&config, &enc);
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    if (level_w == w && level_h == h) {
+        err = jpeg_enc_write_rows(enc, level, h);
+        *scale_us = 0;
+    } else {
+        uint8_t *stripe = heap_caps_malloc((size_t)w * 2 * JPEG_ENC_STRIPE_ROWS,
+                                           MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+        if (stripe == NULL) {
+            jpeg_enc_abort(enc);
+            return ESP_ERR_NO_MEM;
+        }
+        int64_t resample_us = 0;
+        for (int y = 0; y < h && err == ESP_OK; y += JPEG_ENC_STRIPE_ROWS) {
+            int rows = h - y < JPEG_ENC_STRIPE_ROWS ? h - y : JPEG_ENC_STRIPE_ROWS;
+            int64_t start = esp_timer_get_time();
+            downscale_yuyv_resize_rows(level, level_w, level_h, stripe, w, h, y, rows);
+            resample_us += esp_timer_get_time() - start;
+            err = jpeg_enc_write_rows(enc, stripe, rows);
+        }
+        heap_caps_free(stripe);
+        *scale_us = (uint32_t)resample_us;
+    }
+
+    if (err != ESP_OK) {
+        jpeg_enc_abort(enc);
+        return err;
+    }
+    return jpeg_enc_end(enc);
+}
+
+/**
+ * @brief Sort sizes by descending pixel count, dropping duplicates
+ */
+static int sort_sizes(const framesize_t *sizes, int count, framesize_t *sorted)
+{
+    int n = 0;
+
+    for (int i = 0; i < count && i < MULTIRES_MAX_OUTPUTS; i++) {
+        framesize_t fs = sizes[i];
+        uint32_t area = resolution[fs].width * resolution[fs].height;
+        bool dup = false;
+        int pos = n;
+
+        for (int j = 0; j < n; j++) {
+            if (sorted[j] == fs) {
+                dup = true;
+                break;
+            }
+            if (area > resolution[sorted[j]].width * resolution[sorted[j]].height && pos == n) {
+                pos = j;
+            }
+        }
+        if (dup) {
+            continue;
+        }
+        for (int j = n; j > pos; j--) {
+            sorted[j] = sorted[j - 1];
+        }
+        sorted[pos] = fs;
+        n++;
+    }
+    return n;
+}
+
+esp_err_t multires_encode(camera_fb_t *fb, const framesize_t *sizes, int count, int quality,
+                          jpeg_qtable_t qtable, downscale_kernel_t kernel,
+                          multires_output_cb_t cb, void *ctx)
+{
+    framesize_t sorted[MULTIRES_MAX_OUTPUTS];
+    int n = sort_sizes(sizes, count, sorted);
+
+    if (fb->format != PIXFORMAT_YUV422) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    // Current pyramid level, halved in place inside the frame buffer
+    uint8_t *level = fb->buf;
+    int level_w = fb->width;
+    int level_h = fb->height;
+
+    for (int i = 0; i < n; i++) {
+        int w = resolution[sorted[i]].width;
+        int h = resolution[sorted[i]].height;
+        if (w > level_w || h > level_h) {
+            ESP_LOGW(TAG, "Skipping %dx%d, larger than %dx%d frame", w, h, level_w, level_h);
+            continue;
+        }
+
+        int64_t scale_start = esp_timer_get_time();
+        while (level_w / 2 >= w && level_h / 2 >= h && level_w % 4 == 0) {
+            uint32_t cycles = esp_cpu_get_cycle_count();
+            downscale_yuyv_half(kernel, level, level_w, level_h, level);
+            cycles = esp_cpu_get_cycle_count() - cycles;
+            ESP_LOGI(TAG, "Halved %dx%d (%s): %lu cycles, %.1f MP/s", level_w, level_h,
+                     downscale_kernel_name(kernel), (unsigned long)cycles,
+                     (float)level_w * level_h * CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ / cycles);
+            level_w = (level_w / 4) * 2;
+            level_h /= 2;
+        }
+
+        uint32_t halve_us = (uint32_t)(esp_timer_get_time() - scale_start);
+
+        // Encode, resampling the remaining factor below two on the fly
+        multires_output_t out = {
+            .framesize = sorted[i],
+            .width = w,
+            .height = h,
+        };
+        jpeg_buf_t buf = { 0 };
+        uint32_t resample_us = 0;
+        int64_t encode_start = esp_timer_get_time();
+        esp_err_t err = encode_output(level, level_w, level_h, w, h, quality, qtable,
+                                      &buf, &resample_us);
+        uint32_t total_us = (uint32_t)(esp_timer_get_time() - encode_start);
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "JPEG encoding failed for %dx%d: %s", w, h, esp_err_to_name(err));
+            heap_caps_free(buf.data);
+            return err;
+        }
+        out.scale_us = halve_us + resample_us;
+        out.encode_us = total_us - resample_us;
+
+        ESP_LOGI(TAG, "%dx%d: %u bytes (scale %lu us, encode %lu us, %.1f MP/s)",
+                 w, h, buf.len, (unsigned long)out.scale_us, (unsigned long)out.encode_us,
+                 out.encode_us ? (float)w * h / out.encode_us : 0.0f);
+
+        out.jpeg = buf.data;
+        out.len = buf.len;
+        err = cb(&out, ctx);
+        heap_caps_free(buf.data);
+        if (err != ESP_OK) {
+            return err;
+        }
+    }
+    return ESP_OK;
+}
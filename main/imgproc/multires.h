@@ -0,0 +1,66 @@
+/**
+ * @file multires.h
+ * @brief Several JPEG resolutions from one YUV422 frame
+ *
+ * The frame is halved in place down a box-filter pyramid; each requested
+ * size is taken from the nearest pyramid level (bilinear for the remaining
+ * factor below two, one encoder stripe at a time) and JPEG-encoded with
+ * the in-tree baseline encoder.
+ */
+
+#ifndef MULTIRES_H
+#define MULTIRES_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_camera.h"
+#include "esp_err.h"
+#include "imgproc/downscale.h"
+#include "jpeg/jpeg_enc.h"
+
+// Maximum number of output sizes per frame
+#define MULTIRES_MAX_OUTPUTS 4
+
+/**
+ * @brief One encoded output, passed to the output callback
+ */
+typedef struct {
+    framesize_t framesize;
+    int width;
+    int height;
+    const uint8_t *jpeg;
+    size_t len;
+    uint32_t scale_us;          // Time spent downscaling to this size
+    uint32_t encode_us;         // Time spent JPEG-encoding this size
+} multires_output_t;
+
+/**
+ * @brief Output callback, called once per size in descending size order
+ *
+ * The JPEG data is only valid during the call.
+ *
+ * @return ESP_OK to continue, anything else aborts
+ */
+typedef esp_err_t (*multires_output_cb_t)(const multires_output_t *out, void *ctx);
+
+/**
+ * @brief Encode a YUV422 frame at several sizes
+ *
+ * Destroys the frame contents (halving runs in place). Sizes larger than
+ * the frame are skipped.
+ *
+ * @param fb YUV422 frame buffer
+ * @param sizes Requested sizes, any order, at most MULTIRES_MAX_OUTPUTS
+ * @param count Number of sizes
+ * @param quality JPEG quality (1-100, higher is better)
+ * @param qtable Quantization table set
+ * @param kernel Halving kernel
+ * @param cb Output callback
+ * @param ctx Callback context
+ * @return ESP_OK on success, error code otherwise
+ */
+esp_err_t multires_encode(camera_fb_t *fb, const framesize_t *sizes, int count, int quality,
+                          jpeg_qtable_t qtable, downscale_kernel_t kernel,
+                          multires_output_cb_t cb, void *ctx);
+
+#endif // MULTIRES_H
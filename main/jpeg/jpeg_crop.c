@@ -0,0 +1,236 @@
+/**
+ * @file jpeg_crop.c
+ * @brief Lossless MCU-aligned cropping implementation
+ */
+
+#include "jpeg/jpeg_crop.h"
+#include "jpeg/jpeg_tables.h"
+#include "esp_heap_caps.h"
+#include <stdbool.h>
+#include <string.h>
+
+// Returned by the block callback once the last rectangle is written
+#define CROP_DONE ESP_ERR_NOT_FINISHED
+
+/**
+ * @brief Cropping state
+ */
+typedef struct {
+    const jpeg_info_t *info;
+    const jpeg_crop_rect_t *rects;
+    int count;
+    int current;                        // Rectangle being written
+    bool started;                       // Its headers are out
+    bool inside;                        // The current MCU belongs to it
+    int mcu;                            // Current MCU, -1 before the first
+    int mcu_w, mcu_h;
+    int pred[JPEG_SCAN_MAX_COMPONENTS];
+    jpeg_huff_codes_t dc_codes[2];      // Luma, chroma
+    jpeg_huff_codes_t ac_codes[2];
+
+    jpeg_output_cb_t output;
+    void *ctx;
+    size_t out_len;
+    size_t *ends;
+    jpeg_writer_t writer;
+} crop_t;
+
+void jpeg_crop_mcu_size(const jpeg_info_t *info, int *mcu_w, int *mcu_h)
+{
+    int h = 1, v = 1;
+
+    if (info->ncomp > 1) {
+        for (int c = 0; c < info->ncomp; c++) {
+            h = info->comp[c].h > h ? info->comp[c].h : h;
+            v = info->comp[c].v > v ? info->comp[c].v : v;
+        }
+    }
+    *mcu_w = 8 * h;
+    *mcu_h = 8 * v;
+}
+
+static esp_err_t count_output(const uint8_t *data, size_t len, void *ctx)
+{
+    crop_t *crop = ctx;
+
+    crop->out_len += len;
+    return crop->output(data, len, crop->ctx);
+}
+
+/**
+ * @brief Write SOI through SOS for one rectangle
+ */
+static void write_headers(crop_t *crop, const jpeg_crop_rect_t *r)
+{
+    const jpeg_info_t *info = crop->info;
+    jpeg_writer_t *w = &crop->writer;
+    int x = r->x * crop->mcu_w;
+    int y = r->y * crop->mcu_h;
+    int width = r->w * crop->mcu_w;
+    int height = r->h * crop->mcu_h;
+
+    // Partial MCUs at the source's edges stay partial
+    width = x + width > info->width ? info->width - x : width;
+    height = y + height > info->height ? info->height - y : height;
+
+    jpeg_writer_u16(w, 0xffd8);         // SOI
+
+    // DQT, tables used by the components, zigzag order as parsed
+    uint8_t used = 0;
+    for (int c = 0; c < info->ncomp; c++) {
+        used |= 1 << info->comp[c].tq;
+    }
+    for (int t = 0; t < 4; t++) {
+        if (used & (1 << t)) {
+            jpeg_writer_u16(w, 0xffdb);
+            jpeg_writer_u16(w, 2 + 65);
+            jpeg_writer_byte(w, t);
+            for (int k = 0; k < 64; k++) {
+                jpeg_writer_byte(w, info->qt[t][k]);
+            }
+        }
+    }
+
+    // SOF0 with the source's sampling factors
+    jpeg_writer_u16(w, 0xffc0);
+    jpeg_writer_u16(w, 8 + 3 * info->ncomp);
+    jpeg_writer_byte(w, 8);
+    jpeg_writer_u16(w, height);
+    jpeg_writer_u16(w, width);
+    jpeg_writer_byte(w, info->ncomp);
+    for (int c = 0; c < info->ncomp; c++) {
+        jpeg_writer_byte(w, info->comp[c].id);
+        jpeg_writer_byte(w, (info->comp[c].h << 4) | info->comp[c].v);
+        jpeg_writer_byte(w, info->comp[c].tq);
+    }
+
+    // DHT, Annex K luma for the first component and chroma for the rest
+    bool chroma = info->ncomp > 1;
+    jpeg_writer_u16(w, 0xffc4);
+    jpeg_writer_u16(w, 2 + 2 * 17 + jpeg_huff_count(&jpeg_std_dc_luma) +
+                  jpeg_huff_count(&jpeg_std_ac_luma) +
+                  (chroma ? 2 * 17 + jpeg_huff_count(&jpeg_std_dc_chroma) +
+                   jpeg_huff_count(&jpeg_std_ac_chroma) : 0));
+    jpeg_writer_dht(w, 0x00, &jpeg_std_dc_luma);
+    jpeg_writer_dht(w, 0x10, &jpeg_std_ac_luma);
+    if (chroma) {
+        jpeg_writer_dht(w, 0x01, &jpeg_std_dc_chroma);
+        jpeg_writer_dht(w, 0x11, &jpeg_std_ac_chroma);
+    }
+
+    // SOS
+    jpeg_writer_u16(w, 0xffda);
+    jpeg_writer_u16(w, 6 + 2 * info->ncomp);
+    jpeg_writer_byte(w, info->ncomp);
+    for (int c = 0; c < info->ncomp; c++) {
+        jpeg_writer_byte(w, info->comp[c].id);
+        jpeg_writer_byte(w, c == 0 ? 0x00 : 0x11);
+    }
+    jpeg_writer_byte(w, 0);
+    jpeg_writer_byte(w, 63);
+    jpeg_writer_byte(w, 0);
+
+    memset(crop->pred, 0, sizeof(crop->pred));
+}
+
+/**
+ * @brief End the current rectangle's JPEG and move to the next
+ */
+static void finish_rect(crop_t *crop)
+{
+    jpeg_writer_align(&crop->writer);
+    jpeg_writer_u16(&crop->writer, 0xffd9);     // EOI
+    jpeg_writer_flush(&crop->writer);
+    crop->ends[crop->current++] = crop->out_len;
+    crop->started = false;
+}
+
+static esp_err_t crop_block(const jpeg_block_t *block, void *ctx)
+{
+    crop_t *crop = ctx;
+
+    if (block->mcu != crop->mcu) {
+        const jpeg_crop_rect_t *r = &crop->rects[crop->current];
+        int mx = block->mcu % crop->info->mcus_x;
+        int my = block->mcu / crop->info->mcus_x;
+
+        crop->mcu = block->mcu;
+        if (crop->started && my >= r->y + r->h) {
+            finish_rect(crop);
+            if (crop->current == crop->count) {
+                return CROP_DONE;
+            }
+            r++;
+        }
+        crop->inside = my >= r->y && my < r->y + r->h && mx >= r->x && mx < r->x + r->w;
+        if (crop->inside && !crop->started) {
+            write_headers(crop, r);
+            crop->started = true;
+        }
+    }
+    if (!crop->inside) {
+        return ESP_OK;
+    }
+
+    int table = block->comp == 0 ? 0 : 1;
+    jpeg_encode_block(&crop->writer, block->coef, &crop->pred[block->comp],
+                      &crop->dc_codes[table], &crop->ac_codes[table]);
+    return crop->writer.err;
+}
+
+esp_err_t jpeg_crop(const jpeg_info_t *info, const jpeg_crop_rect_t *rects, int count,
+                    jpeg_output_cb_t output, void *ctx, size_t *ends)
+{
+    for (int i = 0; i < count; i++) {
+        const jpeg_crop_rect_t *r = &rects[i];
+        if (r->w == 0 || r->h == 0 || r->x + r->w > info->mcus_x ||
+            r->y + r->h > info->mcus_y || (i > 0 && r->y < rects[i - 1].y + rects[i - 1].h)) {
+            return ESP_ERR_INVALID_ARG;
+        }
+    }
+    for (int c = 0; c < info->ncomp; c++) {
+        // Baseline DQT entries are 8-bit
+        for (int k = 0; k < 64; k++) {
+            if (info->qt[info->comp[c].tq][k] > 255) {
+                return ESP_ERR_NOT_SUPPORTED;
+            }
+        }
+    }
+    if (count == 0) {
+        return ESP_OK;
+    }
+
+    crop_t *crop = heap_caps_malloc(sizeof(crop_t), MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    if (crop == NULL) {
+        crop = heap_caps_malloc(sizeof(crop_t), MALLOC_CAP_8BIT);
+    }
+    if (crop == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    memset(crop, 0, offsetof(crop_t, writer));
+    crop->info = info;
+    crop->rects = rects;
+    crop->count = count;
+    crop->mcu = -1;
+    crop->output = output;
+    crop->ctx = ctx;
+    crop->ends = ends;
+    jpeg_crop_mcu_size(info, &crop->mcu_w, &crop->mcu_h);
+    jpeg_huff_build(&jpeg_std_dc_luma, &crop->dc_codes[0]);
+    jpeg_huff_build(&jpeg_std_ac_luma, &crop->ac_codes[0]);
+    jpeg_huff_build(&jpeg_std_dc_chroma, &crop->dc_codes[1]);
+    jpeg_huff_build(&jpeg_std_ac_chroma, &crop->ac_codes[1]);
+    jpeg_writer_init(&crop->writer, count_output, crop);
+
+    esp_err_t err = jpeg_scan_decode(info, crop_block, crop);
+    if (err == CROP_DONE) {
+        err = ESP_OK;
+    } else if (err == ESP_OK && crop->started) {
+        finish_rect(crop);              // Last rectangle reaches the bottom
+    }
+    if (err == ESP_OK) {
+        err = crop->writer.err;
+    }
+    heap_caps_free(crop);
+    return err;
+}
@@ -0,0 +1,60 @@
+/**
+ * @file jpeg_crop.h
+ * @brief Lossless MCU-aligned cropping of baseline JPEGs
+ *
+ * Cuts rectangles out of a JPEG in the coefficient domain, the way
+ * `jpegtran -crop` does for MCU-aligned offsets: the blocks inside each
+ * rectangle are entropy-coded again into a standalone JPEG with the
+ * original quantization tables, so the pixels of a crop are identical to
+ * the same region of the source.
+ */
+
+#ifndef JPEG_CROP_H
+#define JPEG_CROP_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "jpeg/jpeg_entropy.h"
+#include "jpeg/jpeg_scan.h"
+
+/**
+ * @brief Crop rectangle in MCUs
+ */
+typedef struct {
+    uint16_t x, y;
+    uint16_t w, h;
+} jpeg_crop_rect_t;
+
+/**
+ * @brief Width and height of one MCU in pixels
+ *
+ * @param info Parsed structure
+ * @param mcu_w Receives the MCU width
+ * @param mcu_h Receives the MCU height
+ */
+void jpeg_crop_mcu_size(const jpeg_info_t *info, int *mcu_w, int *mcu_h);
+
+/**
+ * @brief Write each rectangle as a standalone JPEG, one after the other
+ *
+ * The source scan is decoded once, so the rectangles must be in scan order
+ * and must not share MCU rows. Crops that reach the right or bottom edge
+ * keep the source's partial MCUs. Output uses the Annex K Huffman tables
+ * and no restart markers.
+ *
+ * @param info Source, parsed with jpeg_scan_parse()
+ * @param rects Rectangles, sorted by y with disjoint rows
+ * @param count Number of rectangles
+ * @param output Receives the JPEGs back to back
+ * @param ctx Passed to output
+ * @param ends Receives the total output length after each JPEG
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG for rectangles out of
+ *         bounds or out of order, ESP_ERR_NOT_SUPPORTED for 16-bit
+ *         quantization tables, ESP_ERR_INVALID_RESPONSE for corrupt scan
+ *         data, ESP_ERR_NO_MEM, or the output callback's error
+ */
+esp_err_t jpeg_crop(const jpeg_info_t *info, const jpeg_crop_rect_t *rects, int count,
+                    jpeg_output_cb_t output, void *ctx, size_t *ends);
+
+#endif // JPEG_CROP_H
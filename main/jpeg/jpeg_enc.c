@@ -0,0 +1,366 @@
+/**
+ * @file jpeg_enc.c
+ * @brief Baseline JPEG encoder implementation
+ */
+
+#include "jpeg/jpeg_enc.h"
+#include "jpeg/jpeg_tables.h"
+#include "jpeg/jpeg_entropy.h"
+#include "esp_heap_caps.h"
+#include <string.h>
+
+// AAN DCT constants with 8 fractional bits (as in IJG jfdctfst.c)
+#define FIX_0_382683433 98
+#define FIX_0_541196100 139
+#define FIX_0_707106781 181
+#define FIX_1_306562965 334
+#define MUL(v, c)       (((v) * (c)) >> 8)
+
+// Reciprocal quantizers carry 16 fractional bits
+#define RECIP_BITS      16
+
+struct jpeg_enc {
+    jpeg_enc_config_t config;
+
+    uint32_t recip[2][64];              // Natural order, AAN scaling folded in
+    jpeg_huff_codes_t dc_codes[2];
+    jpeg_huff_codes_t ac_codes[2];
+    int dc_pred[3];
+
+    uint8_t *stripe;                    // Partial stripe buffer
+    int stripe_rows;
+    int rows_written;
+
+    jpeg_writer_t writer;               // Last: the buffer is not cleared
+};
+
+// AAN output scale factors: 1 for k = 0, cos(k*pi/16) * sqrt(2) otherwise
+static const float s_aan_scale[8] = {
+    1.0f, 1.387039845f, 1.306562965f, 1.175875602f,
+    1.0f, 0.785694958f, 0.541196100f, 0.275899379f,
+};
+
+/**
+ * @brief Write SOI through SOS for a 3-component 4:2:2 image
+ */
+static void write_headers(jpeg_enc_t *enc, const uint8_t qt[2][64])
+{
+    jpeg_writer_t *w = &enc->writer;
+    static const uint8_t jfif[] = {
+        0xff, 0xd8,                                     // SOI
+        0xff, 0xe0, 0x00, 0x10, 'J', 'F', 'I', 'F', 0,  // APP0
+        0x01, 0x01, 0x00, 0x00, 0x01, 0x00, 0x01, 0x00, 0x00,
+    };
+    for (size_t i = 0; i < sizeof(jfif); i++) {
+        jpeg_writer_byte(w, jfif[i]);
+    }
+
+    // DQT, tables in zigzag order
+    jpeg_writer_u16(w, 0xffdb);
+    jpeg_writer_u16(w, 2 + 2 * 65);
+    for (int t = 0; t < 2; t++) {
+        jpeg_writer_byte(w, t);
+        for (int k = 0; k < 64; k++) {
+            jpeg_writer_byte(w, qt[t][jpeg_zigzag[k]]);
+        }
+    }
+
+    // SOF0: Y sampled 2x1, Cb and Cr 1x1
+    jpeg_writer_u16(w, 0xffc0);
+    jpeg_writer_u16(w, 8 + 3 * 3);
+    jpeg_writer_byte(w, 8);
+    jpeg_writer_u16(w, enc->config.height);
+    jpeg_writer_u16(w, enc->config.width);
+    jpeg_writer_byte(w, 3);
+    static const uint8_t components[3][3] = { { 1, 0x21, 0 }, { 2, 0x11, 1 }, { 3, 0x11, 1 } };
+    for (int c = 0; c < 3; c++) {
+        jpeg_writer_byte(w, components[c][0]);
+        jpeg_writer_byte(w, components[c][1]);
+        jpeg_writer_byte(w, components[c][2]);
+    }
+
+    // DHT
+    jpeg_writer_u16(w, 0xffc4);
+    jpeg_writer_u16(w, 2 + 4 * 17 + jpeg_huff_count(&jpeg_std_dc_luma) +
+                  jpeg_huff_count(&jpeg_std_ac_luma) + jpeg_huff_count(&jpeg_std_dc_chroma) +
+                  jpeg_huff_count(&jpeg_std_ac_chroma));
+    jpeg_writer_dht(w, 0x00, &jpeg_std_dc_luma);
+    jpeg_writer_dht(w, 0x10, &jpeg_std_ac_luma);
+    jpeg_writer_dht(w, 0x01, &jpeg_std_dc_chroma);
+    jpeg_writer_dht(w, 0x11, &jpeg_std_ac_chroma);
+
+    // SOS
+    static const uint8_t sos[] = {
+        0xff, 0xda, 0x00, 0x0c, 0x03, 0x01, 0x00, 0x02, 0x11, 0x03, 0x11, 0x00, 0x3f, 0x00,
+    };
+    for (size_t i = 0; i < sizeof(sos); i++) {
+        jpeg_writer_byte(w, sos[i]);
+    }
+}
+
+/**
+ * @brief In-place integer AAN forward DCT
+ *
+ * Output coefficient (u, v) is scaled by 8 * aan[u] * aan[v]; the scale is
+ * removed during quantization.
+ */
+static void fdct_aan(int32_t *data)
+{
+    for (int pass = 0; pass < 2; pass++) {
+        // Rows first (stride 1 within a row), then columns (stride 8)
+        const int step = pass == 0 ? 1 : 8;
+        const int next = pass == 0 ? 8 : 1;
+
+        for (int i = 0; i < 8; i++) {
+            int32_t *d = data + i * next;
+
+            int32_t tmp0 = d[0 * step] + d[7 * step];
+            int32_t tmp7 = d[0 * step] - d[7 * step];
+            int32_t tmp1 = d[1 * step] + d[6 * step];
+            int32_t tmp6 = d[1 * step] - d[6 * step];
+            int32_t tmp2 = d[2 * step] + d[5 * step];
+            int32_t tmp5 = d[2 * step] - d[5 * step];
+            int32_t tmp3 = d[3 * step] + d[4 * step];
+            int32_t tmp4 = d[3 * step] - d[4 * step];
+
+            // Even part
+            int32_t tmp10 = tmp0 + tmp3;
+            int32_t tmp13 = tmp0 - tmp3;
+            int32_t tmp11 = tmp1 + tmp2;
+            int32_t tmp12 = tmp1 - tmp2;
+
+            d[0 * step] = tmp10 + tmp11;
+            d[4 * step] = tmp10 - tmp11;
+
+            int32_t z1 = MUL(tmp12 + tmp13, FIX_0_707106781);
+            d[2 * step] = tmp13 + z1;
+            d[6 * step] = tmp13 - z1;
+
+            // Odd part
+            tmp10 = tmp4 + tmp5;
+            tmp11 = tmp5 + tmp6;
+            tmp12 = tmp6 + tmp7;
+
+            int32_t z5 = MUL(tmp10 - tmp12, FIX_0_382683433);
+            int32_t z2 = MUL(tmp10, FIX_0_541196100) + z5;
+            int32_t z4 = MUL(tmp12, FIX_1_306562965) + z5;
+            int32_t z3 = MUL(tmp11, FIX_0_707106781);
+
+            int32_t z11 = tmp7 + z3;
+            int32_t z13 = tmp7 - z3;
+
+            d[5 * step] = z13 + z2;
+            d[3 * step] = z13 - z2;
+            d[1 * step] = z11 + z4;
+            d[7 * step] = z11 - z4;
+        }
+    }
+}
+
+/**
+ * @brief Transform, quantize and entropy-code one 8x8 block
+ */
+static void encode_block(jpeg_enc_t *enc, int32_t *data, int table, int comp)
+{
+    const uint32_t *recip = enc->recip[table];
+    int16_t q[64];
+
+    fdct_aan(data);
+
+    // Quantize in zigzag order
+    for (int k = 0; k < 64; k++) {
+        int n = jpeg_zigzag[k];
+        int32_t v = data[n];
+        uint32_t a = v < 0 ? -v : v;
+        int32_t r = (int32_t)((a * recip[n] + (1u << (RECIP_BITS - 1))) >> RECIP_BITS);
+        q[k] = v < 0 ? -r : r;
+    }
+
+    jpeg_encode_block(&enc->writer, q, &enc->dc_pred[comp], &enc->dc_codes[table],
+                      &enc->ac_codes[table]);
+}
+
+/**
+ * @brief Encode one stripe of 16x8 MCUs
+ *
+ * @param rows Row pointers; missing rows below the image repeat the last one
+ */
+static void encode_stripe(jpeg_enc_t *enc, const uint8_t *const rows[JPEG_ENC_STRIPE_ROWS])
+{
+    const int width = enc->config.width;
+    const int last_px = width - 1;
+    const int last_pair = width / 2 - 1;
+    int32_t y0[64], y1[64], cb[64], cr[64];
+
+    for (int x0 = 0; x0 < width; x0 += 16) {
+        if (x0 + 16 <= width) {
+            // Whole MCU inside the image
+            for (int r = 0; r < 8; r++) {
+                const uint8_t *p = rows[r] + x0 * 2;
+                for (int c = 0; c < 4; c++) {
+                    y0[r * 8 + 2 * c] = p[4 * c] - 128;
+                    cb[r * 8 + c] = p[4 * c + 1] - 128;
+                    y0[r * 8 + 2 * c + 1] = p[4 * c + 2] - 128;
+                    cr[r * 8 + c] = p[4 * c + 3] - 128;
+                    y1[r * 8 + 2 * c] = p[16 + 4 * c] - 128;
+                    cb[r * 8 + c + 4] = p[16 + 4 * c + 1] - 128;
+                    y1[r * 8 + 2 * c + 1] = p[16 + 4 * c + 2] - 128;
+                    cr[r * 8 + c + 4] = p[16 + 4 * c + 3] - 128;
+                }
+            }
+        } else {
+            // Right edge: replicate the last column
+            for (int r = 0; r < 8; r++) {
+                const uint8_t *p = rows[r];
+                for (int c = 0; c < 8; c++) {
+                    int px0 = x0 + c < last_px ? x0 + c : last_px;
+                    int px1 = x0 + 8 + c < last_px ? x0 + 8 + c : last_px;
+                    int pair = x0 / 2 + c < last_pair ? x0 / 2 + c : last_pair;
+                    y0[r * 8 + c] = p[px0 * 2] - 128;
+                    y1[r * 8 + c] = p[px1 * 2] - 128;
+                    cb[r * 8 + c] = p[pair * 4 + 1] - 128;
+                    cr[r * 8 + c] = p[pair * 4 + 3] - 128;
+                }
+            }
+        }
+
+        encode_block(enc, y0, 0, 0);
+        encode_block(enc, y1, 0, 0);
+        encode_block(enc, cb, 1, 1);
+        encode_block(enc, cr, 1, 2);
+    }
+}
+
+/**
+ * @brief Encode a stripe from consecutive rows, padding below the image
+ */
+static void encode_rows(jpeg_enc_t *enc, const uint8_t *data, int count)
+{
+    const size_t stride = (size_t)enc->config.width * 2;
+    const uint8_t *rows[JPEG_ENC_STRIPE_ROWS];
+
+    for (int r = 0; r < JPEG_ENC_STRIPE_ROWS; r++) {
+        rows[r] = data + (r < count ? r : count - 1) * stride;
+    }
+    encode_stripe(enc, rows);
+}
+
+esp_err_t jpeg_enc_begin(const jpeg_enc_config_t *config, jpeg_enc_t **out)
+{
+    if (config->width <= 0 || config->height <= 0 || config->width % 2 != 0 ||
+        config->width > 65535 || config->height > 65535 || config->output == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    // Hot state (tables, bit writer) goes to internal RAM when available
+    jpeg_enc_t *enc = heap_caps_malloc(sizeof(jpeg_enc_t), MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    if (enc == NULL) {
+        enc = heap_caps_malloc(sizeof(jpeg_enc_t), MALLOC_CAP_8BIT);
+    }
+    if (enc == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    memset(enc, 0, offsetof(jpeg_enc_t, writer));
+    enc->config = *config;
+    jpeg_writer_init(&enc->writer, config->output, config->ctx);
+
+    enc->stripe = heap_caps_malloc((size_t)config->width * 2 * JPEG_ENC_STRIPE_ROWS,
+                                   MALLOC_CAP_8BIT);
+    if (enc->stripe == NULL) {
+        heap_caps_free(enc);
+        return ESP_ERR_NO_MEM;
+    }
+
+    uint8_t qt[2][64];
+    if (config->qtable == JPEG_QTABLE_FLAT) {
+        uint8_t flat[64];
+        memset(flat, 16, sizeof(flat));
+        jpeg_scale_qtable(flat, config->quality, qt[0]);
+        jpeg_scale_qtable(flat, config->quality, qt[1]);
+    } else {
+        jpeg_scale_qtable(jpeg_std_qt_luma, config->quality, qt[0]);
+        jpeg_scale_qtable(jpeg_std_qt_chroma, config->quality, qt[1]);
+    }
+
+    for (int t = 0; t < 2; t++) {
+        for (int n = 0; n < 64; n++) {
+            float divisor = qt[t][n] * s_aan_scale[n / 8] * s_aan_scale[n % 8] * 8.0f;
+            enc->recip[t][n] = (uint32_t)((1 << RECIP_BITS) / divisor + 0.5f);
+        }
+    }
+
+    jpeg_huff_build(&jpeg_std_dc_luma, &enc->dc_codes[0]);
+    jpeg_huff_build(&jpeg_std_ac_luma, &enc->ac_codes[0]);
+    jpeg_huff_build(&jpeg_std_dc_chroma, &enc->dc_codes[1]);
+    jpeg_huff_build(&jpeg_std_ac_chroma, &enc->ac_codes[1]);
+
+    write_headers(enc, (const uint8_t (*)[64])qt);
+    if (enc->writer.err != ESP_OK) {
+        esp_err_t err = enc->writer.err;
+        jpeg_enc_abort(enc);
+        return err;
+    }
+
+    *out = enc;
+    return ESP_OK;
+}
+
+esp_err_t jpeg_enc_write_rows(jpeg_enc_t *enc, const uint8_t *yuyv, int rows)
+{
+    const size_t stride = (size_t)enc->config.width * 2;
+
+    if (enc->rows_written + rows > enc->config.height) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    enc->rows_written += rows;
+
+    while (rows > 0 && enc->writer.err == ESP_OK) {
+        if (enc->stripe_rows == 0 && rows >= JPEG_ENC_STRIPE_ROWS) {
+            encode_rows(enc, yuyv, JPEG_ENC_STRIPE_ROWS);
+            yuyv += stride * JPEG_ENC_STRIPE_ROWS;
+            rows -= JPEG_ENC_STRIPE_ROWS;
+            continue;
+        }
+
+        int n = JPEG_ENC_STRIPE_ROWS - enc->stripe_rows;
+        if (n > rows) {
+            n = rows;
+        }
+        memcpy(enc->stripe + enc->stripe_rows * stride, yuyv, n * stride);
+        enc->stripe_rows += n;
+        yuyv += n * stride;
+        rows -= n;
+
+        if (enc->stripe_rows == JPEG_ENC_STRIPE_ROWS) {
+            encode_rows(enc, enc->stripe, JPEG_ENC_STRIPE_ROWS);
+            enc->stripe_rows = 0;
+        }
+    }
+    return enc->writer.err;
+}
+
+esp_err_t jpeg_enc_end(jpeg_enc_t *enc)
+{
+    esp_err_t err = ESP_ERR_INVALID_SIZE;
+
+    if (enc->rows_written == enc->config.height) {
+        if (enc->stripe_rows > 0) {
+            encode_rows(enc, enc->stripe, enc->stripe_rows);
+        }
+        jpeg_writer_align(&enc->writer);
+        jpeg_writer_u16(&enc->writer, 0xffd9);      // EOI
+        jpeg_writer_flush(&enc->writer);
+        err = enc->writer.err;
+    }
+
+    jpeg_enc_abort(enc);
+    return err;
+}
+
+void jpeg_enc_abort(jpeg_enc_t *enc)
+{
+    if (enc) {
+        heap_caps_free(enc->stripe);
+        heap_caps_free(enc);
+    }
+}
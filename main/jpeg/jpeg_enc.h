@@ -0,0 +1,97 @@
+/**
+ * @file jpeg_enc.h
+ * @brief Baseline JPEG encoder for YUV422 (YUYV) rows
+ *
+ * Encodes 4:2:2 baseline JPEG from packed YUYV rows as they arrive. Only
+ * one 8-row stripe is ever buffered, so a frame can be encoded while it is
+ * produced (e.g. by a row-wise downscaler) without a full-frame buffer.
+ * The compressed stream is handed to an output callback in small pieces.
+ *
+ * Forward DCT is the integer AAN algorithm with the DCT output scaling
+ * folded into reciprocal quantization tables; entropy coding uses the
+ * Annex K Huffman tables through per-symbol code lookups.
+ */
+
+#ifndef JPEG_ENC_H
+#define JPEG_ENC_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "jpeg/jpeg_entropy.h"
+
+// Rows per MCU stripe (4:2:2 MCUs are 16x8)
+#define JPEG_ENC_STRIPE_ROWS 8
+
+/**
+ * @brief Quantization table sets
+ */
+typedef enum {
+    JPEG_QTABLE_ANNEX_K = 0,    // Standard visually weighted tables
+    JPEG_QTABLE_FLAT,           // Uniform step for all frequencies (analysis)
+} jpeg_qtable_t;
+
+/**
+ * @brief Compressed output callback
+ *
+ * @return ESP_OK to continue; any other value aborts the encode
+ */
+typedef jpeg_output_cb_t jpeg_enc_output_cb_t;
+
+/**
+ * @brief Encoder configuration
+ */
+typedef struct {
+    int width;                  // Image width in pixels (even)
+    int height;                 // Image height in pixels
+    int quality;                // 1-100, higher is better
+    jpeg_qtable_t qtable;
+    jpeg_enc_output_cb_t output;
+    void *ctx;                  // Passed to output
+} jpeg_enc_config_t;
+
+typedef struct jpeg_enc jpeg_enc_t;
+
+/**
+ * @brief Start an image and write the JPEG headers
+ *
+ * @param config Encoder configuration
+ * @param enc Receives the encoder
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG, ESP_ERR_NO_MEM or the
+ *         output callback's error
+ */
+esp_err_t jpeg_enc_begin(const jpeg_enc_config_t *config, jpeg_enc_t **enc);
+
+/**
+ * @brief Feed image rows
+ *
+ * Any number of rows may be passed per call. Whole stripes are encoded
+ * straight from the caller's buffer; partial stripes are buffered.
+ *
+ * @param enc Encoder
+ * @param yuyv Packed YUYV rows, width * 2 bytes each
+ * @param rows Number of rows
+ * @return ESP_OK on success, ESP_ERR_INVALID_SIZE if more rows than the
+ *         image height are written, or the output callback's error
+ */
+esp_err_t jpeg_enc_write_rows(jpeg_enc_t *enc, const uint8_t *yuyv, int rows);
+
+/**
+ * @brief Finish the image and free the encoder
+ *
+ * Pads a partial last stripe, flushes the entropy coder and writes EOI.
+ * The encoder is freed even on error.
+ *
+ * @param enc Encoder
+ * @return ESP_OK on success, error code otherwise
+ */
+esp_err_t jpeg_enc_end(jpeg_enc_t *enc);
+
+/**
+ * @brief Free an encoder without finishing the image
+ *
+ * @param enc Encoder
+ */
+void jpeg_enc_abort(jpeg_enc_t *enc);
+
+#endif // JPEG_ENC_H
@@ -0,0 +1,207 @@
+/**
+ * @file jpeg_entropy.c
+ * @brief Baseline JPEG entropy coding implementation
+ */
+
+#include "jpeg/jpeg_entropy.h"
+#include <stdbool.h>
+#include <string.h>
+
+void jpeg_writer_init(jpeg_writer_t *w, jpeg_output_cb_t output, void *ctx)
+{
+    w->output = output;
+    w->ctx = ctx;
+    w->err = ESP_OK;
+    w->bit_acc = 0;
+    w->bit_count = 0;
+    w->len = 0;
+}
+
+void jpeg_writer_flush(jpeg_writer_t *w)
+{
+    if (w->len > 0 && w->err == ESP_OK) {
+        w->err = w->output(w->buf, w->len, w->ctx);
+    }
+    w->len = 0;
+}
+
+void jpeg_writer_align(jpeg_writer_t *w)
+{
+    if (w->bit_count > 0) {
+        jpeg_writer_bits(w, 0x7f, 7);
+    }
+    w->bit_acc = 0;
+    w->bit_count = 0;
+}
+
+void jpeg_writer_dht(jpeg_writer_t *w, uint8_t class_id, const jpeg_huff_spec_t *spec)
+{
+    int count = jpeg_huff_count(spec);
+
+    jpeg_writer_byte(w, class_id);
+    for (int i = 0; i < 16; i++) {
+        jpeg_writer_byte(w, spec->bits[i]);
+    }
+    for (int i = 0; i < count; i++) {
+        jpeg_writer_byte(w, spec->vals[i]);
+    }
+}
+
+/**
+ * @brief Magnitude category (number of bits) of a coefficient
+ */
+static inline int category(int v)
+{
+    unsigned a = v < 0 ? -v : v;
+    return a ? 32 - __builtin_clz(a) : 0;
+}
+
+void jpeg_encode_block(jpeg_writer_t *w, const int16_t coef[64], int *pred,
+                       const jpeg_huff_codes_t *dc, const jpeg_huff_codes_t *ac)
+{
+    // DC difference
+    int diff = coef[0] - *pred;
+    *pred = coef[0];
+    int nbits = category(diff);
+    jpeg_writer_bits(w, dc->code[nbits], dc->size[nbits]);
+    if (nbits) {
+        jpeg_writer_bits(w, (diff < 0 ? diff - 1 : diff) & ((1u << nbits) - 1), nbits);
+    }
+
+    // AC run-length/size symbols
+    int run = 0;
+    for (int k = 1; k < 64; k++) {
+        int v = coef[k];
+        if (v == 0) {
+            run++;
+            continue;
+        }
+        while (run > 15) {
+            jpeg_writer_bits(w, ac->code[0xf0], ac->size[0xf0]);
+            run -= 16;
+        }
+        nbits = category(v);
+        int sym = (run << 4) | nbits;
+        jpeg_writer_bits(w, ac->code[sym], ac->size[sym]);
+        jpeg_writer_bits(w, (v < 0 ? v - 1 : v) & ((1u << nbits) - 1), nbits);
+        run = 0;
+    }
+    if (run > 0) {
+        jpeg_writer_bits(w, ac->code[0x00], ac->size[0x00]);
+    }
+}
+
+void jpeg_count_block(const int16_t coef[64], int *pred, uint32_t dc_freq[257],
+                      uint32_t ac_freq[257])
+{
+    int diff = coef[0] - *pred;
+    *pred = coef[0];
+    dc_freq[category(diff)]++;
+
+    int run = 0;
+    for (int k = 1; k < 64; k++) {
+        int v = coef[k];
+        if (v == 0) {
+            run++;
+            continue;
+        }
+        while (run > 15) {
+            ac_freq[0xf0]++;
+            run -= 16;
+        }
+        ac_freq[(run << 4) | category(v)]++;
+        run = 0;
+    }
+    if (run > 0) {
+        ac_freq[0x00]++;
+    }
+}
+
+void jpeg_huff_optimal(uint32_t freq[257], jpeg_huff_spec_t *spec, uint8_t vals_buf[256])
+{
+    uint8_t bits[33] = { 0 };
+    uint8_t codesize[257] = { 0 };
+    int16_t others[257];
+
+    memset(others, -1, sizeof(others));
+
+    // Reserve one code point so no real code is all ones
+    freq[256] = 1;
+
+    // Repeatedly merge the two least frequent trees (K.2, figure K.1)
+    while (true) {
+        int c1 = -1, c2 = -1;
+        uint32_t v = UINT32_MAX;
+        for (int i = 0; i <= 256; i++) {
+            if (freq[i] && freq[i] <= v) {
+                v = freq[i];
+                c1 = i;
+            }
+        }
+        v = UINT32_MAX;
+        for (int i = 0; i <= 256; i++) {
+            if (freq[i] && freq[i] <= v && i != c1) {
+                v = freq[i];
+                c2 = i;
+            }
+        }
+        if (c2 < 0) {
+            break;
+        }
+
+        freq[c1] += freq[c2];
+        freq[c2] = 0;
+
+        codesize[c1]++;
+        while (others[c1] >= 0) {
+            c1 = others[c1];
+            codesize[c1]++;
+        }
+        others[c1] = c2;
+        codesize[c2]++;
+        while (others[c2] >= 0) {
+            c2 = others[c2];
+            codesize[c2]++;
+        }
+    }
+
+    for (int i = 0; i <= 256; i++) {
+        if (codesize[i]) {
+            bits[codesize[i]]++;
+        }
+    }
+
+    // Limit code lengths to 16 bits (K.2, figure K.3)
+    for (int i = 32; i > 16; i--) {
+        while (bits[i] > 0) {
+            int j = i - 2;
+            while (bits[j] == 0) {
+                j--;
+            }
+            bits[i] -= 2;
+            bits[i - 1]++;
+            bits[j + 1] += 2;
+            bits[j]--;
+        }
+    }
+
+    // Drop the reserved code from the longest length
+    int i = 16;
+    while (bits[i] == 0) {
+        i--;
+    }
+    bits[i]--;
+
+    memcpy(spec->bits, &bits[1], 16);
+
+    // Symbols sorted by code length, then by value (K.2, figure K.4)
+    int p = 0;
+    for (int len = 1; len <= 32; len++) {
+        for (int sym = 0; sym < 256; sym++) {
+            if (codesize[sym] == len) {
+                vals_buf[p++] = sym;
+            }
+        }
+    }
+    spec->vals = vals_buf;
+}
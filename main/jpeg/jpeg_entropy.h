@@ -0,0 +1,120 @@
+/**
+ * @file jpeg_entropy.h
+ * @brief Baseline JPEG entropy coding shared by the encoder and scan tools
+ *
+ * Blocks are passed as 64 quantized coefficients in zigzag order with an
+ * absolute DC value; DC prediction is tracked by the caller.
+ */
+
+#ifndef JPEG_ENTROPY_H
+#define JPEG_ENTROPY_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "jpeg/jpeg_tables.h"
+
+#define JPEG_WRITER_BUF_SIZE 1024
+
+/**
+ * @brief Output callback for compressed data
+ *
+ * @return ESP_OK to continue; any other value aborts
+ */
+typedef esp_err_t (*jpeg_output_cb_t)(const uint8_t *data, size_t len, void *ctx);
+
+/**
+ * @brief Buffered byte/bit writer with 0xFF stuffing for scan data
+ */
+typedef struct {
+    jpeg_output_cb_t output;
+    void *ctx;
+    esp_err_t err;              // First error; later output is dropped
+    uint32_t bit_acc;
+    int bit_count;
+    size_t len;
+    uint8_t buf[JPEG_WRITER_BUF_SIZE];
+} jpeg_writer_t;
+
+void jpeg_writer_init(jpeg_writer_t *w, jpeg_output_cb_t output, void *ctx);
+
+/**
+ * @brief Pass buffered bytes to the output callback
+ */
+void jpeg_writer_flush(jpeg_writer_t *w);
+
+static inline void jpeg_writer_byte(jpeg_writer_t *w, uint8_t byte)
+{
+    if (w->len == JPEG_WRITER_BUF_SIZE) {
+        jpeg_writer_flush(w);
+    }
+    w->buf[w->len++] = byte;
+}
+
+static inline void jpeg_writer_u16(jpeg_writer_t *w, uint16_t value)
+{
+    jpeg_writer_byte(w, value >> 8);
+    jpeg_writer_byte(w, value & 0xff);
+}
+
+/**
+ * @brief Append up to 16 bits of scan data, stuffing 0x00 after 0xFF
+ */
+static inline void jpeg_writer_bits(jpeg_writer_t *w, uint32_t code, int size)
+{
+    w->bit_acc = (w->bit_acc << size) | code;
+    w->bit_count += size;
+    while (w->bit_count >= 8) {
+        w->bit_count -= 8;
+        uint8_t byte = (w->bit_acc >> w->bit_count) & 0xff;
+        jpeg_writer_byte(w, byte);
+        if (byte == 0xff) {
+            jpeg_writer_byte(w, 0x00);
+        }
+    }
+}
+
+/**
+ * @brief Pad the last scan byte with 1 bits (F.1.2.3)
+ */
+void jpeg_writer_align(jpeg_writer_t *w);
+
+/**
+ * @brief Write a DHT table body (class/id byte, counts, symbols)
+ */
+void jpeg_writer_dht(jpeg_writer_t *w, uint8_t class_id, const jpeg_huff_spec_t *spec);
+
+/**
+ * @brief Entropy-code one block
+ *
+ * @param w Writer
+ * @param coef Quantized coefficients, zigzag order, absolute DC
+ * @param pred DC predictor, updated
+ * @param dc DC code lookup
+ * @param ac AC code lookup
+ */
+void jpeg_encode_block(jpeg_writer_t *w, const int16_t coef[64], int *pred,
+                       const jpeg_huff_codes_t *dc, const jpeg_huff_codes_t *ac);
+
+/**
+ * @brief Count the symbols jpeg_encode_block() would emit for a block
+ *
+ * @param coef Quantized coefficients, zigzag order, absolute DC
+ * @param pred DC predictor, updated
+ * @param dc_freq DC symbol counts to update (257 entries, see jpeg_huff_optimal())
+ * @param ac_freq AC symbol counts to update
+ */
+void jpeg_count_block(const int16_t coef[64], int *pred, uint32_t dc_freq[257],
+                      uint32_t ac_freq[257]);
+
+/**
+ * @brief Build an optimal length-limited Huffman table (Annex K.2)
+ *
+ * @param freq Symbol counts; entry 256 is overwritten to reserve the
+ *             all-ones code, and the counts are consumed
+ * @param spec Receives the code length counts; vals points at vals_buf
+ * @param vals_buf Storage for up to 256 symbols
+ */
+void jpeg_huff_optimal(uint32_t freq[257], jpeg_huff_spec_t *spec, uint8_t vals_buf[256]);
+
+#endif // JPEG_ENTROPY_H
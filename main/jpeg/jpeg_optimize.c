@@ -0,0 +1,332 @@
+/**
+ * @file jpeg_optimize.c
+ * @brief JPEG entropy re-coding and requantization implementation
+ */
+
+#include "jpeg/jpeg_optimize.h"
+#include "jpeg/jpeg_scan.h"
+#include "jpeg/jpeg_tables.h"
+#include "esp_timer.h"
+#include "esp_heap_caps.h"
+#include <string.h>
+
+/**
+ * @brief Working state for both passes
+ */
+typedef struct {
+    jpeg_info_t info;
+    uint32_t dc_freq[4][257];
+    uint32_t ac_freq[4][257];
+    jpeg_huff_spec_t dc_spec[4];
+    jpeg_huff_spec_t ac_spec[4];
+    uint8_t dc_vals[4][256];
+    uint8_t ac_vals[4][256];
+    jpeg_huff_codes_t dc_codes[4];
+    jpeg_huff_codes_t ac_codes[4];
+    uint8_t dc_used, ac_used;           // Bit per table referenced by the scan
+
+    bool requant;
+    uint16_t qt_new[4][64];             // Requantization targets, zigzag order
+
+    int pred[JPEG_SCAN_MAX_COMPONENTS];
+    int mcu;
+    int restart_num;
+
+    jpeg_output_cb_t output;
+    void *ctx;
+    size_t out_len;
+    jpeg_writer_t writer;
+} optimize_t;
+
+static esp_err_t count_output(const uint8_t *data, size_t len, void *ctx)
+{
+    optimize_t *opt = ctx;
+
+    opt->out_len += len;
+    return opt->output(data, len, opt->ctx);
+}
+
+/**
+ * @brief Start a new MCU, resetting prediction at restart boundaries
+ *
+ * @return true if the MCU follows a restart marker
+ */
+static bool next_mcu(optimize_t *opt, int mcu)
+{
+    if (mcu == opt->mcu) {
+        return false;
+    }
+    opt->mcu = mcu;
+    if (!jpeg_scan_is_restart(&opt->info, mcu)) {
+        return false;
+    }
+    memset(opt->pred, 0, sizeof(opt->pred));
+    return true;
+}
+
+/**
+ * @brief Coefficients to code for a block, requantized if enabled
+ *
+ * Each coefficient is rescaled from the original step to the new one,
+ * c' = round(c * Q / Q'), so no inverse or forward DCT is needed.
+ */
+static const int16_t *block_coefs(const optimize_t *opt, const jpeg_block_t *block,
+                                  int16_t tmp[64])
+{
+    if (!opt->requant) {
+        return block->coef;
+    }
+
+    int tq = opt->info.comp[block->comp].tq;
+    const uint16_t *from = opt->info.qt[tq];
+    const uint16_t *to = opt->qt_new[tq];
+    for (int k = 0; k < 64; k++) {
+        int c = block->coef[k];
+        if (c == 0 || from[k] == to[k]) {
+            tmp[k] = c;
+            continue;
+        }
+        uint32_t a = (uint32_t)(c < 0 ? -c : c) * from[k];
+        int r = (a + to[k] / 2) / to[k];
+        tmp[k] = c < 0 ? -r : r;
+    }
+    return tmp;
+}
+
+static esp_err_t count_block(const jpeg_block_t *block, void *ctx)
+{
+    optimize_t *opt = ctx;
+    const jpeg_component_t *comp = &opt->info.comp[block->comp];
+    int16_t tmp[64];
+
+    next_mcu(opt, block->mcu);
+    jpeg_count_block(block_coefs(opt, block, tmp), &opt->pred[block->comp],
+                     opt->dc_freq[comp->td], opt->ac_freq[comp->ta]);
+    return ESP_OK;
+}
+
+static esp_err_t encode_block(const jpeg_block_t *block, void *ctx)
+{
+    optimize_t *opt = ctx;
+    const jpeg_component_t *comp = &opt->info.comp[block->comp];
+    int16_t tmp[64];
+
+    if (next_mcu(opt, block->mcu)) {
+        jpeg_writer_align(&opt->writer);
+        jpeg_writer_byte(&opt->writer, 0xff);
+        jpeg_writer_byte(&opt->writer, 0xd0 + (opt->restart_num++ & 7));
+    }
+    jpeg_encode_block(&opt->writer, block_coefs(opt, block, tmp), &opt->pred[block->comp],
+                      &opt->dc_codes[comp->td], &opt->ac_codes[comp->ta]);
+    return opt->writer.err;
+}
+
+static void write_raw(jpeg_writer_t *w, const uint8_t *data, size_t len)
+{
+    for (size_t i = 0; i < len; i++) {
+        jpeg_writer_byte(w, data[i]);
+    }
+}
+
+/**
+ * @brief Write one DQT segment holding the requantized tables
+ */
+static void write_dqt(optimize_t *opt)
+{
+    jpeg_writer_t *w = &opt->writer;
+    size_t len = 2;
+
+    for (int t = 0; t < 4; t++) {
+        if (opt->info.qt_present & (1 << t)) {
+            len += 65;
+        }
+    }
+    jpeg_writer_u16(w, 0xffdb);
+    jpeg_writer_u16(w, len);
+    for (int t = 0; t < 4; t++) {
+        if (opt->info.qt_present & (1 << t)) {
+            jpeg_writer_byte(w, t);
+            for (int k = 0; k < 64; k++) {
+                jpeg_writer_byte(w, opt->qt_new[t][k]);
+            }
+        }
+    }
+}
+
+/**
+ * @brief Copy the headers before SOS without DHT, then add the new DHT
+ *
+ * When requantizing, the first DQT is replaced by the new tables and any
+ * further DQT segments are dropped.
+ */
+static void write_headers(optimize_t *opt)
+{
+    const uint8_t *data = opt->info.data;
+    jpeg_writer_t *w = &opt->writer;
+    bool dqt_written = false;
+    size_t pos = 2;
+
+    write_raw(w, data, 2);              // SOI
+    while (pos < opt->info.sos_offset) {
+        if (data[pos + 1] == 0xff) {
+            pos++;
+            continue;
+        }
+        if (data[pos + 1] == 0x01 || (data[pos + 1] & 0xf8) == 0xd0) {
+            write_raw(w, data + pos, 2);
+            pos += 2;
+            continue;
+        }
+        size_t seg = 2 + ((data[pos + 2] << 8) | data[pos + 3]);
+        if (data[pos + 1] == 0xdb && opt->requant) {
+            if (!dqt_written) {
+                write_dqt(opt);
+                dqt_written = true;
+            }
+        } else if (data[pos + 1] != 0xc4) {
+            write_raw(w, data + pos, seg);
+        }
+        pos += seg;
+    }
+
+    size_t dht_len = 2;
+    for (int t = 0; t < 4; t++) {
+        if (opt->dc_used & (1 << t)) {
+            dht_len += 17 + jpeg_huff_count(&opt->dc_spec[t]);
+        }
+        if (opt->ac_used & (1 << t)) {
+            dht_len += 17 + jpeg_huff_count(&opt->ac_spec[t]);
+        }
+    }
+    jpeg_writer_u16(w, 0xffc4);
+    jpeg_writer_u16(w, dht_len);
+    for (int t = 0; t < 4; t++) {
+        if (opt->dc_used & (1 << t)) {
+            jpeg_writer_dht(w, 0x00 | t, &opt->dc_spec[t]);
+        }
+        if (opt->ac_used & (1 << t)) {
+            jpeg_writer_dht(w, 0x10 | t, &opt->ac_spec[t]);
+        }
+    }
+
+    write_raw(w, data + opt->info.sos_offset, opt->info.scan_offset - opt->info.sos_offset);
+}
+
+/**
+ * @brief Derive coarser tables from the Annex K ones at the given quality
+ *
+ * A step is never made finer than the original; those coefficients are
+ * kept unchanged.
+ */
+static void setup_requant(optimize_t *opt, int quality)
+{
+    for (int t = 0; t < 4; t++) {
+        if (!(opt->info.qt_present & (1 << t))) {
+            continue;
+        }
+        uint8_t scaled[64];
+        jpeg_scale_qtable(t == opt->info.comp[0].tq ? jpeg_std_qt_luma : jpeg_std_qt_chroma,
+                          quality, scaled);
+        for (int k = 0; k < 64; k++) {
+            uint16_t q = scaled[jpeg_zigzag[k]];
+            opt->qt_new[t][k] = q > opt->info.qt[t][k] ? q : opt->info.qt[t][k];
+        }
+    }
+}
+
+/**
+ * @brief Two-pass re-encode, optionally requantizing
+ *
+ * @param quality Target quality, 0 to keep the coefficients
+ */
+static esp_err_t transcode(const uint8_t *jpeg, size_t len, int quality, jpeg_output_cb_t output,
+                           void *ctx, jpeg_optimize_stats_t *stats)
+{
+    // Decode tables and statistics are hot; prefer internal RAM
+    optimize_t *opt = heap_caps_malloc(sizeof(optimize_t), MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    if (opt == NULL) {
+        opt = heap_caps_malloc(sizeof(optimize_t), MALLOC_CAP_8BIT);
+    }
+    if (opt == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    memset(opt, 0, offsetof(optimize_t, writer));
+    opt->output = output;
+    opt->ctx = ctx;
+    jpeg_writer_init(&opt->writer, count_output, opt);
+
+    // Pass 1: statistics
+    int64_t start = esp_timer_get_time();
+    esp_err_t err = jpeg_scan_parse(jpeg, len, &opt->info);
+    for (int t = 0; t < 4 && err == ESP_OK && quality > 0; t++) {
+        // Baseline DQT entries are 8-bit
+        for (int k = 0; k < 64; k++) {
+            if (opt->info.qt[t][k] > 255) {
+                err = ESP_ERR_NOT_SUPPORTED;
+            }
+        }
+    }
+    if (err == ESP_OK && quality > 0) {
+        opt->requant = true;
+        setup_requant(opt, quality);
+    }
+    if (err == ESP_OK) {
+        err = jpeg_scan_decode(&opt->info, count_block, opt);
+    }
+    if (err != ESP_OK) {
+        heap_caps_free(opt);
+        return err;
+    }
+
+    for (int c = 0; c < opt->info.ncomp; c++) {
+        opt->dc_used |= 1 << opt->info.comp[c].td;
+        opt->ac_used |= 1 << opt->info.comp[c].ta;
+    }
+    for (int t = 0; t < 4; t++) {
+        if (opt->dc_used & (1 << t)) {
+            jpeg_huff_optimal(opt->dc_freq[t], &opt->dc_spec[t], opt->dc_vals[t]);
+            jpeg_huff_build(&opt->dc_spec[t], &opt->dc_codes[t]);
+        }
+        if (opt->ac_used & (1 << t)) {
+            jpeg_huff_optimal(opt->ac_freq[t], &opt->ac_spec[t], opt->ac_vals[t]);
+            jpeg_huff_build(&opt->ac_spec[t], &opt->ac_codes[t]);
+        }
+    }
+    int64_t counted = esp_timer_get_time();
+
+    // Pass 2: re-encode the same coefficients
+    memset(opt->pred, 0, sizeof(opt->pred));
+    opt->mcu = 0;
+    write_headers(opt);
+    err = jpeg_scan_decode(&opt->info, encode_block, opt);
+    if (err == ESP_OK) {
+        jpeg_writer_align(&opt->writer);
+        jpeg_writer_u16(&opt->writer, 0xffd9);      // EOI
+        jpeg_writer_flush(&opt->writer);
+        err = opt->writer.err;
+    }
+
+    if (stats) {
+        stats->in_len = opt->info.scan_end + 2;
+        stats->out_len = opt->out_len;
+        stats->count_us = (uint32_t)(counted - start);
+        stats->encode_us = (uint32_t)(esp_timer_get_time() - counted);
+    }
+    heap_caps_free(opt);
+    return err;
+}
+
+esp_err_t jpeg_optimize(const uint8_t *jpeg, size_t len, jpeg_output_cb_t output, void *ctx,
+                        jpeg_optimize_stats_t *stats)
+{
+    return transcode(jpeg, len, 0, output, ctx, stats);
+}
+
+esp_err_t jpeg_requantize(const uint8_t *jpeg, size_t len, int quality, jpeg_output_cb_t output,
+                          void *ctx, jpeg_optimize_stats_t *stats)
+{
+    if (quality < 1 || quality > 100) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    return transcode(jpeg, len, quality, output, ctx, stats);
+}
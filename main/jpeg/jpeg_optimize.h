@@ -0,0 +1,74 @@
+/**
+ * @file jpeg_optimize.h
+ * @brief JPEG size reduction by entropy re-coding and requantization
+ *
+ * Re-entropy-codes a baseline JPEG: the scan is decoded once to gather
+ * symbol statistics, optimal Huffman tables are built from them (Annex
+ * K.2), and the unchanged coefficients are coded again with the new
+ * tables. Decoded pixels are identical to the input; only the DHT segment
+ * and the scan data change. Sensor JPEGs use the generic Annex K tables,
+ * so this typically saves several percent.
+ *
+ * Requantization uses the same two passes but first rescales every
+ * quantized coefficient to a coarser table in the DCT domain, giving a
+ * smaller lower-quality version of a stored JPEG without decoding it to
+ * pixels.
+ */
+
+#ifndef JPEG_OPTIMIZE_H
+#define JPEG_OPTIMIZE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "jpeg/jpeg_entropy.h"
+
+/**
+ * @brief Optimization result
+ */
+typedef struct {
+    size_t in_len;              // Input size up to the end of the scan
+    size_t out_len;             // Bytes passed to the output callback
+    uint32_t count_us;          // Parse and statistics pass
+    uint32_t encode_us;         // Re-encoding pass
+} jpeg_optimize_stats_t;
+
+/**
+ * @brief Re-encode a JPEG with optimal Huffman tables
+ *
+ * Markers other than DHT (APPn, DQT, SOF, DRI, SOS) are copied unchanged
+ * and restart markers are kept at the same MCU positions.
+ *
+ * @param jpeg Baseline JPEG data
+ * @param len Data length
+ * @param output Receives the optimized JPEG in pieces
+ * @param ctx Passed to output
+ * @param stats Receives sizes and timing, may be NULL
+ * @return ESP_OK on success, ESP_ERR_NOT_SUPPORTED or ESP_ERR_INVALID_ARG
+ *         from parsing, ESP_ERR_INVALID_RESPONSE for corrupt scan data,
+ *         ESP_ERR_NO_MEM, or the output callback's error
+ */
+esp_err_t jpeg_optimize(const uint8_t *jpeg, size_t len, jpeg_output_cb_t output, void *ctx,
+                        jpeg_optimize_stats_t *stats);
+
+/**
+ * @brief Re-encode a JPEG at a lower quality in the DCT domain
+ *
+ * New tables are the Annex K tables scaled to the given quality (the
+ * first component's table uses the luma base, others the chroma base),
+ * but never finer than the original per coefficient. Huffman tables are
+ * optimized for the requantized coefficients.
+ *
+ * @param jpeg Baseline JPEG data
+ * @param len Data length
+ * @param quality Target quality, 1-100 (IJG scale)
+ * @param output Receives the requantized JPEG in pieces
+ * @param ctx Passed to output
+ * @param stats Receives sizes and timing, may be NULL
+ * @return Same as jpeg_optimize(); ESP_ERR_INVALID_ARG also for a quality
+ *         out of range
+ */
+esp_err_t jpeg_requantize(const uint8_t *jpeg, size_t len, int quality, jpeg_output_cb_t output,
+                          void *ctx, jpeg_optimize_stats_t *stats);
+
+#endif // JPEG_OPTIMIZE_H
@@ -0,0 +1,456 @@
+/**
+ * @file jpeg_scan.c
+ * @brief Baseline JPEG header parsing and coefficient decoding
+ */
+
+#include "jpeg/jpeg_scan.h"
+#include <string.h>
+
+/**
+ * @brief Entropy-coded segment reader
+ *
+ * Bits are kept MSB-aligned in a 32-bit accumulator. Stuffed zero bytes
+ * are removed; at a marker the reader stops advancing and supplies zero
+ * bits, leaving the marker for the restart logic.
+ */
+typedef struct {
+    const uint8_t *p;
+    const uint8_t *end;
+    uint32_t acc;
+    int bits;
+} bit_reader_t;
+
+static esp_err_t build_dec_table(const uint8_t bits[16], const uint8_t *vals, int count,
+                                 jpeg_huff_dec_t *t)
+{
+    int32_t code = 0;
+    int k = 0;
+
+    memcpy(t->bits, bits, 16);
+    memcpy(t->vals, vals, count);
+    memset(t->look_len, 0, sizeof(t->look_len));
+
+    for (int len = 1; len <= 16; len++) {
+        int n = bits[len - 1];
+        t->valoff[len] = k - code;
+        for (int i = 0; i < n; i++) {
+            // More codes than the length allows; checked before the
+            // lookup tables are indexed with it
+            if (code >= (1 << len)) {
+                return ESP_ERR_INVALID_ARG;
+            }
+            if (len <= 8) {
+                int shift = 8 - len;
+                for (int j = 0; j < (1 << shift); j++) {
+                    t->look_len[(code << shift) | j] = len;
+                    t->look_sym[(code << shift) | j] = vals[k];
+                }
+            }
+            code++;
+            k++;
+        }
+        t->maxcode[len] = n ? code - 1 : -1;
+        code <<= 1;
+    }
+    return ESP_OK;
+}
+
+static esp_err_t parse_dqt(const uint8_t *p, size_t len, jpeg_info_t *info)
+{
+    while (len > 0) {
+        int precision = p[0] >> 4;
+        int id = p[0] & 0x0f;
+        size_t size = 1 + 64 * (precision ? 2 : 1);
+        if (id > 3 || precision > 1 || len < size) {
+            return ESP_ERR_INVALID_ARG;
+        }
+        for (int k = 0; k < 64; k++) {
+            info->qt[id][k] = precision ? (p[1 + 2 * k] << 8) | p[2 + 2 * k] : p[1 + k];
+        }
+        info->qt_present |= 1 << id;
+        p += size;
+        len -= size;
+    }
+    return ESP_OK;
+}
+
+static esp_err_t parse_dht(const uint8_t *p, size_t len, jpeg_info_t *info)
+{
+    while (len > 0) {
+        if (len < 17) {
+            return ESP_ERR_INVALID_ARG;
+        }
+        int cls = p[0] >> 4;
+        int id = p[0] & 0x0f;
+        int count = 0;
+        for (int i = 0; i < 16; i++) {
+            count += p[1 + i];
+        }
+        if (cls > 1 || id > 3 || count > 256 || len < 17 + (size_t)count) {
+            return ESP_ERR_INVALID_ARG;
+        }
+        jpeg_huff_dec_t *t = cls ? &info->ac[id] : &info->dc[id];
+        esp_err_t err = build_dec_table(p + 1, p + 17, count, t);
+        if (err != ESP_OK) {
+            return err;
+        }
+        if (cls) {
+            info->ac_present |= 1 << id;
+        } else {
+            info->dc_present |= 1 << id;
+        }
+        p += 17 + count;
+        len -= 17 + count;
+    }
+    return ESP_OK;
+}
+
+static esp_err_t parse_sof(const uint8_t *p, size_t len, jpeg_info_t *info)
+{
+    if (len < 6 || p[0] != 8) {
+        return len < 6 ? ESP_ERR_INVALID_ARG : ESP_ERR_NOT_SUPPORTED;
+    }
+    info->height = (p[1] << 8) | p[2];
+    info->width = (p[3] << 8) | p[4];
+    info->ncomp = p[5];
+    if (info->height == 0 || info->width == 0) {
+        return ESP_ERR_NOT_SUPPORTED;     // Height defined by DNL
+    }
+    if (info->ncomp != 1 && info->ncomp != 3) {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    if (len < 6 + 3 * (size_t)info->ncomp) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    for (int c = 0; c < info->ncomp; c++) {
+        jpeg_component_t *comp = &info->comp[c];
+        comp->id = p[6 + 3 * c];
+        comp->h = p[7 + 3 * c] >> 4;
+        comp->v = p[7 + 3 * c] & 0x0f;
+        comp->tq = p[8 + 3 * c];
+        if (comp->h < 1 || comp->h > 4 || comp->v < 1 || comp->v > 4 || comp->tq > 3) {
+            return ESP_ERR_INVALID_ARG;
+        }
+    }
+    return ESP_OK;
+}
+
+static esp_err_t parse_sos(const uint8_t *p, size_t len, jpeg_info_t *info)
+{
+    if (info->ncomp == 0 || len < 1) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    int ns = p[0];
+    if (ns != info->ncomp) {
+        return ESP_ERR_NOT_SUPPORTED;     // Non-interleaved multi-scan
+    }
+    if (len < 4 + 2 * (size_t)ns) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    for (int i = 0; i < ns; i++) {
+        int c = 0;
+        while (c < info->ncomp && info->comp[c].id != p[1 + 2 * i]) {
+            c++;
+        }
+        if (c == info->ncomp) {
+            return ESP_ERR_INVALID_ARG;
+        }
+        info->comp[c].td = p[2 + 2 * i] >> 4;
+        info->comp[c].ta = p[2 + 2 * i] & 0x0f;
+        if (info->comp[c].td > 3 || info->comp[c].ta > 3 ||
+            !(info->dc_present & (1 << info->comp[c].td)) ||
+            !(info->ac_present & (1 << info->comp[c].ta)) ||
+            !(info->qt_present & (1 << info->comp[c].tq))) {
+            return ESP_ERR_INVALID_ARG;
+        }
+    }
+
+    // Spectral selection and approximation must cover the full block
+    const uint8_t *s = p + 1 + 2 * ns;
+    if (s[0] != 0 || s[1] != 63 || s[2] != 0) {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    return ESP_OK;
+}
+
+/**
+ * @brief Compute the MCU grid and block layout
+ */
+static esp_err_t setup_mcus(jpeg_info_t *info)
+{
+    if (info->ncomp == 1) {
+        // Single component scans are non-interleaved: one block per MCU
+        info->mcus_x = (info->width + 7) / 8;
+        info->mcus_y = (info->height + 7) / 8;
+        info->blocks_per_mcu = 1;
+        info->mcu_comp[0] = 0;
+        return ESP_OK;
+    }
+
+    int hmax = 1, vmax = 1;
+    for (int c = 0; c < info->ncomp; c++) {
+        hmax = info->comp[c].h > hmax ? info->comp[c].h : hmax;
+        vmax = info->comp[c].v > vmax ? info->comp[c].v : vmax;
+    }
+    info->mcus_x = (info->width + 8 * hmax - 1) / (8 * hmax);
+    info->mcus_y = (info->height + 8 * vmax - 1) / (8 * vmax);
+
+    int n = 0;
+    for (int c = 0; c < info->ncomp; c++) {
+        int blocks = info->comp[c].h * info->comp[c].v;
+        if (n + blocks > JPEG_SCAN_MAX_BLOCKS) {
+            return ESP_ERR_INVALID_ARG;
+        }
+        for (int b = 0; b < blocks; b++) {
+            info->mcu_comp[n++] = c;
+        }
+    }
+    info->blocks_per_mcu = n;
+    return ESP_OK;
+}
+
+/**
+ * @brief Find the marker that ends the entropy-coded segment
+ */
+static size_t find_scan_end(const uint8_t *data, size_t start, size_t len)
+{
+    for (size_t i = start; i + 1 < len; i++) {
+        if (data[i] == 0xff && data[i + 1] != 0x00 && data[i + 1] != 0xff &&
+            (data[i + 1] & 0xf8) != 0xd0) {
+            return i;
+        }
+    }
+    return len;
+}
+
+esp_err_t jpeg_scan_parse(const uint8_t *data, size_t len, jpeg_info_t *info)
+{
+    memset(info, 0, sizeof(*info));
+    info->data = data;
+    info->len = len;
+
+    if (len < 4 || data[0] != 0xff || data[1] != 0xd8) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    bool have_sof = false;
+    size_t pos = 2;
+    while (pos + 4 <= len) {
+        if (data[pos] != 0xff) {
+            return ESP_ERR_INVALID_ARG;
+        }
+        uint8_t marker = data[pos + 1];
+        if (marker == 0xff) {
+            pos++;                          // Fill byte
+            continue;
+        }
+        if (marker == 0x01 || (marker & 0xf8) == 0xd0) {
+            pos += 2;                       // Standalone marker
+            continue;
+        }
+        if (marker == 0xd9) {
+            return ESP_ERR_INVALID_ARG;     // EOI before any scan
+        }
+
+        size_t seg_len = (data[pos + 2] << 8) | data[pos + 3];
+        if (seg_len < 2 || pos + 2 + seg_len > len) {
+            return ESP_ERR_INVALID_ARG;
+        }
+        const uint8_t *p = data + pos + 4;
+        size_t plen = seg_len - 2;
+        esp_err_t err = ESP_OK;
+
+        switch (marker) {
+        case 0xdb:
+            err = parse_dqt(p, plen, info);
+            break;
+        case 0xc4:
+            err = parse_dht(p, plen, info);
+            break;
+        case 0xc0:
+        case 0xc1:
+            err = parse_sof(p, plen, info);
+            have_sof = true;
+            break;
+        case 0xdd:
+            if (plen < 2) {
+                return ESP_ERR_INVALID_ARG;
+            }
+            info->restart_interval = (p[0] << 8) | p[1];
+            break;
+        case 0xda:
+            if (!have_sof) {
+                return ESP_ERR_INVALID_ARG;
+            }
+            err = parse_sos(p, plen, info);
+            if (err == ESP_OK) {
+                err = setup_mcus(info);
+            }
+            if (err != ESP_OK) {
+                return err;
+            }
+            info->sos_offset = pos;
+            info->scan_offset = pos + 2 + seg_len;
+            info->scan_end = find_scan_end(data, info->scan_offset, len);
+            return ESP_OK;
+        default:
+            if (marker >= 0xc2 && marker <= 0xcf && marker != 0xc4 && marker != 0xc8 &&
+                marker != 0xcc) {
+                return ESP_ERR_NOT_SUPPORTED;   // Progressive, lossless, arithmetic
+            }
+            break;                          // APPn, COM and others are skipped
+        }
+        if (err != ESP_OK) {
+            return err;
+        }
+        pos += 2 + seg_len;
+    }
+    return ESP_ERR_INVALID_ARG;
+}
+
+static inline void fill_bits(bit_reader_t *br)
+{
+    while (br->bits <= 24) {
+        uint32_t byte = 0;
+        if (br->p < br->end) {
+            byte = br->p[0];
+            if (byte != 0xff) {
+                br->p++;
+            } else if (br->p + 1 < br->end && br->p[1] == 0x00) {
+                br->p += 2;
+            } else {
+                byte = 0;                   // Marker: stay put, pad with zeros
+            }
+        }
+        br->acc |= byte << (24 - br->bits);
+        br->bits += 8;
+    }
+}
+
+static inline int decode_symbol(bit_reader_t *br, const jpeg_huff_dec_t *t)
+{
+    fill_bits(br);
+
+    uint32_t look = br->acc >> 24;
+    int len = t->look_len[look];
+    if (len) {
+        br->acc <<= len;
+        br->bits -= len;
+        return t->look_sym[look];
+    }
+    for (len = 9; len <= 16; len++) {
+        int32_t code = br->acc >> (32 - len);
+        if (code <= t->maxcode[len]) {
+            br->acc <<= len;
+            br->bits -= len;
+            return t->vals[t->valoff[len] + code];
+        }
+    }
+    return -1;
+}
+
+/**
+ * @brief Read s magnitude bits and sign-extend them (F.2.2.1)
+ */
+static inline int32_t receive_extend(bit_reader_t *br, int s)
+{
+    fill_bits(br);
+
+    int32_t v = br->acc >> (32 - s);
+    br->acc <<= s;
+    br->bits -= s;
+    if (v < (1 << (s - 1))) {
+        v -= (1 << s) - 1;
+    }
+    return v;
+}
+
+static esp_err_t decode_block(bit_reader_t *br, const jpeg_huff_dec_t *dc,
+                              const jpeg_huff_dec_t *ac, int *pred, int16_t coef[64])
+{
+    memset(coef, 0, 64 * sizeof(int16_t));
+
+    int s = decode_symbol(br, dc);
+    if (s < 0 || s > 15) {
+        return ESP_ERR_INVALID_RESPONSE;
+    }
+    if (s) {
+        *pred += receive_extend(br, s);
+    }
+    coef[0] = *pred;
+
+    for (int k = 1; k < 64; k++) {
+        int rs = decode_symbol(br, ac);
+        if (rs < 0) {
+            return ESP_ERR_INVALID_RESPONSE;
+        }
+        int r = rs >> 4;
+        s = rs & 0x0f;
+        if (s == 0) {
+            if (r != 15) {
+                break;                      // EOB
+            }
+            k += 15;                        // ZRL
+            continue;
+        }
+        k += r;
+        if (k > 63) {
+            return ESP_ERR_INVALID_RESPONSE;
+        }
+        coef[k] = receive_extend(br, s);
+    }
+    return ESP_OK;
+}
+
+/**
+ * @brief Skip to and consume the next RSTn marker
+ */
+static esp_err_t restart(bit_reader_t *br)
+{
+    br->acc = 0;
+    br->bits = 0;
+    while (br->p + 1 < br->end) {
+        if (br->p[0] == 0xff && (br->p[1] & 0xf8) == 0xd0) {
+            br->p += 2;
+            return ESP_OK;
+        }
+        br->p++;
+    }
+    return ESP_ERR_INVALID_RESPONSE;
+}
+
+esp_err_t jpeg_scan_decode(const jpeg_info_t *info, jpeg_block_cb_t cb, void *ctx)
+{
+    bit_reader_t br = {
+        .p = info->data + info->scan_offset,
+        .end = info->data + info->scan_end,
+    };
+    int pred[JPEG_SCAN_MAX_COMPONENTS] = { 0 };
+    int mcus = info->mcus_x * info->mcus_y;
+    jpeg_block_t block;
+
+    for (int mcu = 0; mcu < mcus; mcu++) {
+        if (jpeg_scan_is_restart(info, mcu)) {
+            esp_err_t err = restart(&br);
+            if (err != ESP_OK) {
+                return err;
+            }
+            memset(pred, 0, sizeof(pred));
+        }
+
+        block.mcu = mcu;
+        for (int b = 0; b < info->blocks_per_mcu; b++) {
+            const jpeg_component_t *comp = &info->comp[info->mcu_comp[b]];
+            block.comp = info->mcu_comp[b];
+            esp_err_t err = decode_block(&br, &info->dc[comp->td], &info->ac[comp->ta],
+                                         &pred[block.comp], block.coef);
+            if (err == ESP_OK) {
+                err = cb(&block, ctx);
+            }
+            if (err != ESP_OK) {
+                return err;
+            }
+        }
+    }
+    return ESP_OK;
+}
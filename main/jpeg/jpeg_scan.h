@@ -0,0 +1,128 @@
+/**
+ * @file jpeg_scan.h
+ * @brief Baseline JPEG header parsing and coefficient decoding
+ *
+ * Parses the markers of a baseline (SOF0/SOF1) single-scan JPEG such as the
+ * sensor's output and Huffman-decodes its scan into quantized DCT blocks,
+ * without inverse DCT. Tools that work in the coefficient domain (entropy
+ * re-coding, requantization) are built on this.
+ */
+
+#ifndef JPEG_SCAN_H
+#define JPEG_SCAN_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+#define JPEG_SCAN_MAX_COMPONENTS 3
+#define JPEG_SCAN_MAX_BLOCKS     10     // Blocks per MCU (T.81 B.2.3)
+
+/**
+ * @brief Huffman decoding table
+ */
+typedef struct {
+    uint8_t bits[16];                   // Codes per length, as in DHT
+    uint8_t vals[256];
+    uint8_t look_len[256];              // 8-bit lookahead, 0 if code is longer
+    uint8_t look_sym[256];
+    int32_t maxcode[18];                // Largest code per length, -1 if none
+    int32_t valoff[17];                 // vals index minus smallest code per length
+} jpeg_huff_dec_t;
+
+/**
+ * @brief Frame component
+ */
+typedef struct {
+    uint8_t id;
+    uint8_t h, v;                       // Sampling factors
+    uint8_t tq;                         // Quantization table
+    uint8_t td, ta;                     // DC/AC Huffman tables (from SOS)
+} jpeg_component_t;
+
+/**
+ * @brief Parsed JPEG structure
+ *
+ * Offsets index the buffer passed to jpeg_scan_parse(), which must stay
+ * valid while the info is used.
+ */
+typedef struct {
+    const uint8_t *data;
+    size_t len;
+
+    uint16_t width, height;
+    int ncomp;
+    jpeg_component_t comp[JPEG_SCAN_MAX_COMPONENTS];
+    uint16_t restart_interval;          // MCUs per restart interval, 0 if none
+
+    uint16_t qt[4][64];                 // Quantization tables, zigzag order
+    uint8_t qt_present;                 // Bit per table
+    jpeg_huff_dec_t dc[4];
+    jpeg_huff_dec_t ac[4];
+    uint8_t dc_present, ac_present;     // Bit per table
+
+    int mcus_x, mcus_y;
+    int blocks_per_mcu;
+    uint8_t mcu_comp[JPEG_SCAN_MAX_BLOCKS];   // Component of each block in an MCU
+
+    size_t sos_offset;                  // Start of the SOS marker
+    size_t scan_offset;                 // First entropy-coded byte
+    size_t scan_end;                    // Marker ending the scan (normally EOI)
+} jpeg_info_t;
+
+/**
+ * @brief Decoded block
+ */
+typedef struct {
+    int16_t coef[64];                   // Quantized, zigzag order, absolute DC
+    int comp;                           // Component index
+    int mcu;                            // MCU index in scan order
+} jpeg_block_t;
+
+/**
+ * @brief Per-block callback
+ *
+ * @return ESP_OK to continue; any other value stops decoding
+ */
+typedef esp_err_t (*jpeg_block_cb_t)(const jpeg_block_t *block, void *ctx);
+
+/**
+ * @brief Parse the markers up to the start of the scan
+ *
+ * @param data JPEG data
+ * @param len Data length (trailing padding after EOI is allowed)
+ * @param info Receives the structure; large, avoid the stack
+ * @return ESP_OK on success, ESP_ERR_NOT_SUPPORTED for progressive,
+ *         lossless, arithmetic-coded or multi-scan images,
+ *         ESP_ERR_INVALID_ARG for malformed data
+ */
+esp_err_t jpeg_scan_parse(const uint8_t *data, size_t len, jpeg_info_t *info);
+
+/**
+ * @brief Decode every block of the scan in order
+ *
+ * Restart markers are consumed and DC prediction is reset at each one, so
+ * coefficients are independent of the restart interval.
+ *
+ * @param info Parsed structure
+ * @param cb Called for each block
+ * @param ctx Passed to cb
+ * @return ESP_OK on success, ESP_ERR_INVALID_RESPONSE for corrupt scan data,
+ *         or the callback's error
+ */
+esp_err_t jpeg_scan_decode(const jpeg_info_t *info, jpeg_block_cb_t cb, void *ctx);
+
+/**
+ * @brief Check whether an MCU starts a new restart interval
+ *
+ * @param info Parsed structure
+ * @param mcu MCU index
+ * @return true if a restart marker precedes this MCU
+ */
+static inline bool jpeg_scan_is_restart(const jpeg_info_t *info, int mcu)
+{
+    return info->restart_interval && mcu > 0 && mcu % info->restart_interval == 0;
+}
+
+#endif // JPEG_SCAN_H
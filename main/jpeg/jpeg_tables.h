@@ -0,0 +1,65 @@
+/**
+ * @file jpeg_tables.h
+ * @brief Baseline JPEG constants shared by the encoder and scan tools
+ */
+
+#ifndef JPEG_TABLES_H
+#define JPEG_TABLES_H
+
+#include <stdint.h>
+
+/**
+ * @brief Huffman table in DHT form
+ */
+typedef struct {
+    uint8_t bits[16];           // Number of codes of each length 1..16
+    const uint8_t *vals;        // Symbols in order of increasing code length
+} jpeg_huff_spec_t;
+
+/**
+ * @brief Huffman code lookup, indexed by symbol
+ */
+typedef struct {
+    uint16_t code[256];
+    uint8_t size[256];          // Code length in bits, 0 if the symbol is unused
+} jpeg_huff_codes_t;
+
+// Natural (row-major) coefficient index of each zigzag position
+extern const uint8_t jpeg_zigzag[64];
+
+// Annex K.1 quantization tables (natural order, quality 50)
+extern const uint8_t jpeg_std_qt_luma[64];
+extern const uint8_t jpeg_std_qt_chroma[64];
+
+// Annex K.3 Huffman tables
+extern const jpeg_huff_spec_t jpeg_std_dc_luma;
+extern const jpeg_huff_spec_t jpeg_std_ac_luma;
+extern const jpeg_huff_spec_t jpeg_std_dc_chroma;
+extern const jpeg_huff_spec_t jpeg_std_ac_chroma;
+
+/**
+ * @brief Number of symbols in a Huffman table
+ *
+ * @param spec Table
+ * @return Sum of spec->bits
+ */
+int jpeg_huff_count(const jpeg_huff_spec_t *spec);
+
+/**
+ * @brief Generate the codes of a Huffman table (Annex C)
+ *
+ * @param spec Table
+ * @param codes Lookup to populate
+ */
+void jpeg_huff_build(const jpeg_huff_spec_t *spec, jpeg_huff_codes_t *codes);
+
+/**
+ * @brief Scale a base quantization table with the IJG quality formula
+ *
+ * @param base Table at quality 50
+ * @param quality 1-100, higher is better
+ * @param out Scaled table (values 1-255)
+ */
+void jpeg_scale_qtable(const uint8_t *base, int quality, uint8_t *out);
+
+#endif // JPEG_TABLES_H
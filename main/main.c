@@ -12,9 +12,31 @@
 #include "esp_psram.h"
 #include "nvs_flash.h"
 #include "camera/camera.h"
+#include "camera/camera_service.h"
+#if CONFIG_GROWPOD_XCLK_CAL
+#include "camera/xclk_cal.h"
+#endif
 #include "wifi/wifi.h"
 #include "web_server/web_server.h"
 #include "settings/settings.h"
+#include "stream/stream.h"
+#if CONFIG_GROWPOD_H264_STREAM
+#include "stream/h264_stream.h"
+#endif
+#include "net/bounce_send.h"
+#include "net/mdns_txt.h"
+#if CONFIG_GROWPOD_UDP_STILL
+#include "net/udp_still.h"
+#endif
+#if CONFIG_GROWPOD_STATUS_EVENTS
+#include "net/status_events.h"
+#endif
+#if CONFIG_GROWPOD_TASK_STATS
+#include "diag/task_stats.h"
+#endif
+#if CONFIG_GROWPOD_HEAP_MONITOR
+#include "diag/heap_monitor.h"
+#endif
 
 static const char *TAG = "main";
 
@@ -38,6 +60,14 @@ void app_main(void)
         ESP_LOGE(TAG, "PSRAM not initialized!");
     }
     
+#if CONFIG_GROWPOD_HEAP_MONITOR
+    // Before the camera, so its frame buffer allocations are covered
+    ESP_LOGI(TAG, "Starting heap monitor...");
+    if (heap_monitor_init() != ESP_OK) {
+        ESP_LOGW(TAG, "Heap monitor unavailable");
+    }
+#endif
+    
     // Initialize camera
     ESP_LOGI(TAG, "Initializing camera...");
     if (camera_init() != ESP_OK) {
@@ -61,6 +91,42 @@ void app_main(void)
         settings_save(&settings);
     }
     
+#if CONFIG_GROWPOD_XCLK_CAL
+    // Per-framesize sensor clocks; the service restarts the driver if needed
+    ESP_LOGI(TAG, "Loading XCLK calibration...");
+    xclk_cal_init();
+#endif
+    
+    // From here on only the camera service touches the sensor
+    ESP_LOGI(TAG, "Starting camera service...");
+    if (camera_service_init() != ESP_OK) {
+        ESP_LOGE(TAG, "Camera service initialization failed!");
+        return;
+    }
+    
+    // Start capture/network stream pipeline
+    ESP_LOGI(TAG, "Starting stream pipeline...");
+    if (stream_init() != ESP_OK) {
+        ESP_LOGE(TAG, "Stream pipeline initialization failed!");
+        return;
+    }
+    
+#if CONFIG_GROWPOD_H264_STREAM
+    // Encoder task for /stream.mp4; the encoder itself is allocated per session
+    ESP_LOGI(TAG, "Starting H.264 stream...");
+    if (h264_stream_init() != ESP_OK) {
+        ESP_LOGW(TAG, "H.264 stream unavailable");
+    }
+#endif
+    
+#if CONFIG_GROWPOD_BOUNCE_SEND
+    // Allocate internal SRAM bounce buffers for capture transfers
+    ESP_LOGI(TAG, "Initializing bounce send path...");
+    if (bounce_send_init() != ESP_OK) {
+        ESP_LOGW(TAG, "Bounce send unavailable, sending directly from PSRAM");
+    }
+#endif
+    
     // Initialize WiFi
     ESP_LOGI(TAG, "Initializing WiFi...");
     if (wifi_init_sta() != ESP_OK) {
@@ -77,6 +143,35 @@ void app_main(void)
     }
     ESP_LOGI(TAG, "mDNS service started");
     
+    // Capabilities and state for fleet discovery without /status
+    if (mdns_txt_init() != ESP_OK) {
+        ESP_LOGW(TAG, "mDNS TXT records unavailable");
+    }
+    
+#if CONFIG_GROWPOD_UDP_STILL
+    // Still transfers over UDP with FEC, for lossy links
+    ESP_LOGI(TAG, "Starting UDP still server...");
+    if (udp_still_init() != ESP_OK) {
+        ESP_LOGW(TAG, "UDP still transfer unavailable");
+    }
+#endif
+    
+#if CONFIG_GROWPOD_STATUS_EVENTS
+    // Pushes status changes to /events subscribers
+    ESP_LOGI(TAG, "Starting status events...");
+    if (status_events_init() != ESP_OK) {
+        ESP_LOGW(TAG, "Status events unavailable");
+    }
+#endif
+    
+#if CONFIG_GROWPOD_TASK_STATS
+    // Per-task CPU share for /debug/tasks
+    ESP_LOGI(TAG, "Starting task statistics...");
+    if (task_stats_init() != ESP_OK) {
+        ESP_LOGW(TAG, "Task statistics unavailable");
+    }
+#endif
+    
     // Start web server
     ESP_LOGI(TAG, "Starting web server...");
     httpd_handle_t server = start_webserver();
@@ -0,0 +1,221 @@
+/**
+ * @file admission.c
+ * @brief Admission control implementation
+ */
+
+#include "net/admission.h"
+#include "freertos/FreeRTOS.h"
+#include <string.h>
+
+// Tokens are kept in thousandths; a request costs one whole token
+#define TOKEN 1000
+
+// Microseconds per minute, divided by TOKEN: rate tokens/min refill
+// rate * elapsed_us / REFILL_DIV thousandths
+#define REFILL_DIV 60000
+
+typedef struct {
+    int32_t milli;              // Tokens x TOKEN
+    int64_t stamp_us;           // Last refill
+} bucket_t;
+
+typedef struct {
+    uint32_t key;
+    bool used;
+    int64_t seen_us;
+    bucket_t buckets[ADMIT_CLASS_COUNT];
+} client_entry_t;
+
+static const char *const CLASS_NAMES[ADMIT_CLASS_COUNT] = {
+    [ADMIT_CAPTURE] = "capture",
+    [ADMIT_STREAM]  = "stream",
+    [ADMIT_CONTROL] = "control",
+    [ADMIT_STATUS]  = "status",
+};
+
+// A still every 5 s per client with a burst of 3 covers the web UI and
+// capture_wifi.py; the settings page sends 5 /control requests at once
+static const admission_config_t DEFAULT_CONFIG = {
+    .classes = {
+        [ADMIT_CAPTURE] = { .client = { 12, 3 },   .global = { 30, 6 } },
+        [ADMIT_STREAM]  = { .client = { 6, 2 },    .global = { 20, 4 } },
+        [ADMIT_CONTROL] = { .client = { 120, 20 }, .global = { 300, 40 } },
+        [ADMIT_STATUS]  = { .client = { 120, 10 }, .global = { 600, 30 } },
+    },
+    .max_streams = 3,
+};
+
+static admission_config_t s_config;
+static bucket_t s_global[ADMIT_CLASS_COUNT];
+static client_entry_t s_clients[ADMISSION_MAX_CLIENTS];
+static admission_stats_t s_stats;
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static void bucket_fill(bucket_t *b, const admit_limit_t *limit, int64_t now_us)
+{
+    b->milli = limit->burst * TOKEN;
+    b->stamp_us = now_us;
+}
+
+static void bucket_refill(bucket_t *b, const admit_limit_t *limit, int64_t now_us)
+{
+    int64_t gain = (now_us - b->stamp_us) * limit->rate / REFILL_DIV;
+    int64_t cap = (int64_t)limit->burst * TOKEN;
+
+    // Lowered limits take effect here too
+    if (b->milli + gain >= cap) {
+        b->milli = cap;
+        b->stamp_us = now_us;
+    } else {
+        // Keep the remainder, or a client polling faster than one
+        // thousandth of a token would never refill
+        b->milli += gain;
+        b->stamp_us += gain * REFILL_DIV / limit->rate;
+    }
+}
+
+/**
+ * @brief Seconds until the bucket holds a whole token, at least 1
+ */
+static uint32_t bucket_wait_s(const bucket_t *b, const admit_limit_t *limit)
+{
+    int64_t wait_us = (int64_t)(TOKEN - b->milli) * REFILL_DIV / limit->rate;
+    return wait_us < 1000000 ? 1 : (wait_us + 999999) / 1000000;
+}
+
+/**
+ * @brief Find a client's entry, replacing the least recently seen one
+ */
+static client_entry_t *client_entry(uint32_t key, int64_t now_us)
+{
+    client_entry_t *oldest = &s_clients[0];
+
+    for (int i = 0; i < ADMISSION_MAX_CLIENTS; i++) {
+        client_entry_t *e = &s_clients[i];
+        if (e->used && e->key == key) {
+            e->seen_us = now_us;
+            return e;
+        }
+        if (!e->used || (oldest->used && e->seen_us < oldest->seen_us)) {
+            oldest = e;
+        }
+    }
+
+    oldest->key = key;
+    oldest->used = true;
+    oldest->seen_us = now_us;
+    for (int c = 0; c < ADMIT_CLASS_COUNT; c++) {
+        bucket_fill(&oldest->buckets[c], &s_config.classes[c].client, now_us);
+    }
+    return oldest;
+}
+
+void admission_init(int64_t now_us)
+{
+    portENTER_CRITICAL(&s_lock);
+    s_config = DEFAULT_CONFIG;
+    memset(s_clients, 0, sizeof(s_clients));
+    memset(&s_stats, 0, sizeof(s_stats));
+    for (int c = 0; c < ADMIT_CLASS_COUNT; c++) {
+        bucket_fill(&s_global[c], &s_config.classes[c].global, now_us);
+    }
+    portEXIT_CRITICAL(&s_lock);
+}
+
+static admit_result_t check(admit_class_t cls, uint32_t client, int64_t now_us,
+                            uint32_t *retry_after_s)
+{
+    const admit_class_limits_t *limits = &s_config.classes[cls];
+    bucket_t *global = &s_global[cls];
+    bucket_t *own = NULL;
+
+    if (limits->client.rate) {
+        own = &client_entry(client, now_us)->buckets[cls];
+        bucket_refill(own, &limits->client, now_us);
+        if (own->milli < TOKEN) {
+            *retry_after_s = bucket_wait_s(own, &limits->client);
+            s_stats.client_limited[cls]++;
+            return ADMIT_CLIENT_LIMITED;
+        }
+    }
+    if (limits->global.rate) {
+        bucket_refill(global, &limits->global, now_us);
+        if (global->milli < TOKEN) {
+            *retry_after_s = bucket_wait_s(global, &limits->global);
+            s_stats.global_limited[cls]++;
+            return ADMIT_GLOBAL_LIMITED;
+        }
+        global->milli -= TOKEN;
+    }
+    // Only charged once the request is admitted
+    if (own) {
+        own->milli -= TOKEN;
+    }
+    s_stats.admitted[cls]++;
+    return ADMIT_OK;
+}
+
+admit_result_t admission_check(admit_class_t cls, uint32_t client, int64_t now_us,
+                               uint32_t *retry_after_s)
+{
+    portENTER_CRITICAL(&s_lock);
+    admit_result_t res = check(cls, client, now_us, retry_after_s);
+    portEXIT_CRITICAL(&s_lock);
+    return res;
+}
+
+admit_result_t admission_check_streams(uint32_t active)
+{
+    admit_result_t res = ADMIT_OK;
+
+    portENTER_CRITICAL(&s_lock);
+    if (s_config.max_streams && active >= s_config.max_streams) {
+        s_stats.streams_full++;
+        res = ADMIT_STREAMS_FULL;
+    }
+    portEXIT_CRITICAL(&s_lock);
+    return res;
+}
+
+void admission_get_config(admission_config_t *config)
+{
+    portENTER_CRITICAL(&s_lock);
+    *config = s_config;
+    portEXIT_CRITICAL(&s_lock);
+}
+
+esp_err_t admission_set_config(const admission_config_t *config)
+{
+    for (int c = 0; c < ADMIT_CLASS_COUNT; c++) {
+        const admit_class_limits_t *l = &config->classes[c];
+        if ((l->client.rate && !l->client.burst) || (l->global.rate && !l->global.burst)) {
+            return ESP_ERR_INVALID_ARG;
+        }
+    }
+    portENTER_CRITICAL(&s_lock);
+    s_config = *config;
+    portEXIT_CRITICAL(&s_lock);
+    return ESP_OK;
+}
+
+void admission_get_stats(admission_stats_t *stats)
+{
+    portENTER_CRITICAL(&s_lock);
+    *stats = s_stats;
+    portEXIT_CRITICAL(&s_lock);
+}
+
+const char *admission_class_name(admit_class_t cls)
+{
+    return cls < ADMIT_CLASS_COUNT ? CLASS_NAMES[cls] : "unknown";
+}
+
+admit_class_t admission_class_find(const char *name)
+{
+    for (int c = 0; c < ADMIT_CLASS_COUNT; c++) {
+        if (strcmp(name, CLASS_NAMES[c]) == 0) {
+            return c;
+        }
+    }
+    return ADMIT_CLASS_COUNT;
+}
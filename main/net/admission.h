@@ -0,0 +1,119 @@
+/**
+ * @file admission.h
+ * @brief Admission control: token buckets per endpoint class
+ *
+ * Each endpoint class has a global bucket and one bucket per client
+ * address. A request takes a token from both; if either is empty it is
+ * turned away before its handler touches the camera. An empty client
+ * bucket means that client is too fast (429); an empty global bucket means
+ * everyone together is (503). Both carry the time until the next token as
+ * Retry-After. New stream connections are also capped by a concurrent
+ * stream limit.
+ *
+ * The client table holds ADMISSION_MAX_CLIENTS addresses; the least
+ * recently seen one is replaced, so a flood of new addresses only ever
+ * gets fresh client buckets and is still held by the global bucket.
+ *
+ * Times are passed in. The httpd task and the UDP still server both
+ * check requests, so every call holds a spinlock; each is short.
+ */
+
+#ifndef ADMISSION_H
+#define ADMISSION_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+#define ADMISSION_MAX_CLIENTS 8
+
+/**
+ * @brief Endpoint classes with separate limits
+ */
+typedef enum {
+    ADMIT_CAPTURE,              // /capture, /capture_multi, /last, UDP still REQ
+    ADMIT_STREAM,               // New /stream and /stream.mp4 connections
+    ADMIT_CONTROL,              // /control, /control.cbor, /multicast
+    ADMIT_STATUS,               // /status, /status.cbor, /get_settings, /events
+    ADMIT_CLASS_COUNT
+} admit_class_t;
+
+/**
+ * @brief One bucket's limit
+ */
+typedef struct {
+    uint16_t rate;              // Requests per minute, 0 for no limit
+    uint16_t burst;             // Bucket size, at least 1 when rate is set
+} admit_limit_t;
+
+typedef struct {
+    admit_limit_t client;       // Per client address
+    admit_limit_t global;       // All clients together
+} admit_class_limits_t;
+
+typedef struct {
+    admit_class_limits_t classes[ADMIT_CLASS_COUNT];
+    uint8_t max_streams;        // Concurrent MJPEG + H.264 streams, 0 for no limit
+} admission_config_t;
+
+typedef enum {
+    ADMIT_OK,
+    ADMIT_CLIENT_LIMITED,       // 429 Too Many Requests
+    ADMIT_GLOBAL_LIMITED,       // 503 Service Unavailable
+    ADMIT_STREAMS_FULL,         // 503 Service Unavailable
+} admit_result_t;
+
+typedef struct {
+    uint32_t admitted[ADMIT_CLASS_COUNT];
+    uint32_t client_limited[ADMIT_CLASS_COUNT];
+    uint32_t global_limited[ADMIT_CLASS_COUNT];
+    uint32_t streams_full;
+} admission_stats_t;
+
+/**
+ * @brief Reset to the default limits with full buckets
+ */
+void admission_init(int64_t now_us);
+
+/**
+ * @brief Admit or reject a request
+ *
+ * @param cls Endpoint class
+ * @param client Client address key
+ * @param now_us Current time
+ * @param retry_after_s Receives the seconds until a retry can succeed
+ *                      when the request is rejected
+ */
+admit_result_t admission_check(admit_class_t cls, uint32_t client, int64_t now_us,
+                               uint32_t *retry_after_s);
+
+/**
+ * @brief Check the concurrent stream limit before admission_check()
+ *
+ * @param active Streams currently running
+ * @return ADMIT_OK or ADMIT_STREAMS_FULL
+ */
+admit_result_t admission_check_streams(uint32_t active);
+
+void admission_get_config(admission_config_t *config);
+
+/**
+ * @brief Replace the limits; buckets keep their tokens up to the new burst
+ *
+ * @return ESP_OK, or ESP_ERR_INVALID_ARG for a rate without a burst
+ */
+esp_err_t admission_set_config(const admission_config_t *config);
+
+void admission_get_stats(admission_stats_t *stats);
+
+/**
+ * @brief Class name as used by /limits, e.g. "capture"
+ */
+const char *admission_class_name(admit_class_t cls);
+
+/**
+ * @brief Class by name, ADMIT_CLASS_COUNT if unknown
+ */
+admit_class_t admission_class_find(const char *name);
+
+#endif // ADMISSION_H
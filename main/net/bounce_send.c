@@ -0,0 +1,158 @@
+/**
+ * @file bounce_send.c
+ * @brief Double-buffered bounce send path implementation
+ */
+
+#include "net/bounce_send.h"
+#include "net/http_raw.h"
+#include "esp_log.h"
+#include "esp_heap_caps.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include <string.h>
+
+#if CONFIG_GROWPOD_BOUNCE_ASYNC_MEMCPY
+#include "esp_async_memcpy.h"
+#endif
+
+static const char *TAG = "bounce_send";
+
+#ifdef CONFIG_GROWPOD_BOUNCE_CHUNK_SIZE
+#define BOUNCE_CHUNK_SIZE CONFIG_GROWPOD_BOUNCE_CHUNK_SIZE
+#else
+#define BOUNCE_CHUNK_SIZE (16 * 1024)
+#endif
+
+// DMA to/from PSRAM requires cache-line aligned addresses and sizes
+#define BOUNCE_DMA_ALIGN 64
+
+static uint8_t *s_bounce[2];
+static SemaphoreHandle_t s_lock;        // Serializes use of the shared buffers
+static SemaphoreHandle_t s_copy_done;   // Given from the DMA completion ISR
+
+#if CONFIG_GROWPOD_BOUNCE_ASYNC_MEMCPY
+static async_memcpy_handle_t s_mcp;
+
+/**
+ * @brief Async memcpy completion callback (ISR context)
+ */
+static bool IRAM_ATTR copy_done_cb(async_memcpy_handle_t mcp, async_memcpy_event_t *event, void *arg)
+{
+    BaseType_t high_task_woken = pdFALSE;
+    xSemaphoreGiveFromISR(s_copy_done, &high_task_woken);
+    return high_task_woken == pdTRUE;
+}
+#endif
+
+/**
+ * @brief Start copying one chunk into a bounce buffer
+ *
+ * Uses DMA when the driver is installed and the source chunk is suitably
+ * aligned, a CPU memcpy otherwise. Either way s_copy_done is given once
+ * the data is in place.
+ */
+static void start_copy(uint8_t *dst, const uint8_t *src, size_t n)
+{
+#if CONFIG_GROWPOD_BOUNCE_ASYNC_MEMCPY
+    if (s_mcp != NULL &&
+        ((uintptr_t)src % BOUNCE_DMA_ALIGN) == 0 &&
+        (n % BOUNCE_DMA_ALIGN) == 0 &&
+        esp_async_memcpy(s_mcp, dst, (void *)src, n, copy_done_cb, NULL) == ESP_OK) {
+        return;
+    }
+#endif
+    memcpy(dst, src, n);
+    xSemaphoreGive(s_copy_done);
+}
+
+esp_err_t bounce_send_init(void)
+{
+    s_lock = xSemaphoreCreateMutex();
+    s_copy_done = xSemaphoreCreateBinary();
+    if (s_lock == NULL || s_copy_done == NULL) {
+        ESP_LOGE(TAG, "Failed to create semaphores");
+        return ESP_ERR_NO_MEM;
+    }
+
+    for (int i = 0; i < 2; i++) {
+        s_bounce[i] = heap_caps_aligned_alloc(BOUNCE_DMA_ALIGN, BOUNCE_CHUNK_SIZE,
+                                              MALLOC_CAP_INTERNAL | MALLOC_CAP_DMA);
+        if (s_bounce[i] == NULL) {
+            ESP_LOGW(TAG, "Failed to allocate %d byte bounce buffer, sending from PSRAM",
+                     BOUNCE_CHUNK_SIZE);
+            heap_caps_free(s_bounce[0]);
+            s_bounce[0] = NULL;
+            return ESP_ERR_NO_MEM;
+        }
+    }
+
+#if CONFIG_GROWPOD_BOUNCE_ASYNC_MEMCPY
+    async_memcpy_config_t config = ASYNC_MEMCPY_DEFAULT_CONFIG();
+    config.backlog = 2;
+    config.dma_burst_size = 32;
+    esp_err_t err = esp_async_memcpy_install(&config, &s_mcp);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Async memcpy unavailable (%s), using CPU copies", esp_err_to_name(err));
+        s_mcp = NULL;
+    }
+#endif
+
+    ESP_LOGI(TAG, "Bounce send ready (2 x %d bytes internal SRAM, %s copies)",
+             BOUNCE_CHUNK_SIZE,
+#if CONFIG_GROWPOD_BOUNCE_ASYNC_MEMCPY
+             s_mcp ? "DMA" : "CPU"
+#else
+             "CPU"
+#endif
+             );
+    return ESP_OK;
+}
+
+esp_err_t bounce_send(httpd_req_t *req, const uint8_t *data, size_t len)
+{
+    if (s_bounce[0] == NULL || s_bounce[1] == NULL) {
+        return http_raw_send_all(req, data, len);
+    }
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+
+    esp_err_t res = ESP_OK;
+    size_t offset = 0;
+    int cur = 0;
+
+    // Prime the first buffer
+    size_t n = len < BOUNCE_CHUNK_SIZE ? len : BOUNCE_CHUNK_SIZE;
+    if (n > 0) {
+        start_copy(s_bounce[cur], data, n);
+    }
+
+    while (n > 0) {
+        xSemaphoreTake(s_copy_done, portMAX_DELAY);
+
+        // Kick off the next copy before sending this chunk so they overlap
+        size_t next_offset = offset + n;
+        size_t next_n = len - next_offset;
+        if (next_n > BOUNCE_CHUNK_SIZE) {
+            next_n = BOUNCE_CHUNK_SIZE;
+        }
+        if (next_n > 0) {
+            start_copy(s_bounce[cur ^ 1], data + next_offset, next_n);
+        }
+
+        res = http_raw_send_all(req, s_bounce[cur], n);
+        if (res != ESP_OK) {
+            // Let an in-flight copy finish before releasing the buffers
+            if (next_n > 0) {
+                xSemaphoreTake(s_copy_done, portMAX_DELAY);
+            }
+            break;
+        }
+
+        offset = next_offset;
+        n = next_n;
+        cur ^= 1;
+    }
+
+    xSemaphoreGive(s_lock);
+    return res;
+}
@@ -0,0 +1,44 @@
+/**
+ * @file bounce_send.h
+ * @brief Double-buffered PSRAM to internal SRAM bounce send path
+ *
+ * Frame buffers live in PSRAM, which is slow for lwIP to copy from and
+ * shares bandwidth with the camera's DMA writes. This path copies the frame
+ * into two alternating internal-SRAM bounce buffers (using async memcpy
+ * DMA where available) and overlaps each copy with the TCP send of the
+ * previous chunk.
+ */
+
+#ifndef BOUNCE_SEND_H
+#define BOUNCE_SEND_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "esp_http_server.h"
+
+/**
+ * @brief Allocate the bounce buffers and install the async memcpy driver
+ *
+ * If the DMA driver cannot be installed the path falls back to CPU copies;
+ * if the buffers cannot be allocated bounce_send() sends straight from the
+ * source buffer.
+ *
+ * @return ESP_OK on success, error code otherwise
+ */
+esp_err_t bounce_send_init(void);
+
+/**
+ * @brief Send data on the request socket through the bounce buffers
+ *
+ * Writes raw bytes only; the caller is responsible for the response
+ * headers (see http_raw_send_headers()).
+ *
+ * @param req HTTP request whose socket is written
+ * @param data Source data (typically a PSRAM frame buffer)
+ * @param len Number of bytes to send
+ * @return ESP_OK on success, ESP_FAIL if the socket errored
+ */
+esp_err_t bounce_send(httpd_req_t *req, const uint8_t *data, size_t len);
+
+#endif // BOUNCE_SEND_H
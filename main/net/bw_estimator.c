@@ -0,0 +1,240 @@
+/**
+ * @file bw_estimator.c
+ * @brief Per-connection bandwidth estimator and quality ladder controller
+ */
+
+#include "net/bw_estimator.h"
+
+#define BW_EWMA_ALPHA         0.25f
+#define BW_DEFAULT_THROUGHPUT 250000.0f    // Bytes/s with no samples and no RSSI
+#define BW_STRONG_THROUGHPUT  2000000.0f   // Bytes/s with no samples above the caps
+#define BW_MIN_SEND_US        500          // Shorter sends are clamped (socket buffer hits)
+
+// A rung fits if its rate times the margin is within the estimate
+#define BW_UP_MARGIN          1.3f
+#define BW_DOWN_MARGIN        1.0f
+
+// Share of the frame interval spent sending
+#define BW_UP_BLOCKING        0.5f
+#define BW_DOWN_BLOCKING      0.85f
+
+// A non-blocking link may be assumed this much faster than the current rate
+// even when the RSSI cap says otherwise, so weak links can still probe up
+#define BW_PROBE_FACTOR       2.0f
+
+// Failed up-switch backoff before the same rung is tried again
+#define BW_PROBE_FAIL_US      10000000     // Down within this time after going up = failed
+#define BW_BACKOFF_MIN_US     8000000
+#define BW_BACKOFF_MAX_US     64000000
+
+/**
+ * @brief Goodput cap per RSSI threshold (dBm, bytes/s, 0 = no cap)
+ */
+static const struct {
+    int rssi;
+    float cap;
+} s_rssi_caps[] = {
+    { -55, 0 },
+    { -62, 1500000 },
+    { -68, 900000 },
+    { -74, 450000 },
+    { -80, 220000 },
+    { -86, 100000 },
+};
+
+#define BW_RSSI_FLOOR_CAP     40000.0f
+
+float bw_estimator_rssi_cap(int rssi)
+{
+    if (rssi == 0) {
+        return 0;
+    }
+    for (size_t i = 0; i < sizeof(s_rssi_caps) / sizeof(s_rssi_caps[0]); i++) {
+        if (rssi >= s_rssi_caps[i].rssi) {
+            return s_rssi_caps[i].cap;
+        }
+    }
+    return BW_RSSI_FLOOR_CAP;
+}
+
+/**
+ * @brief Link rate a rung needs, scaled by the measured frame size
+ */
+static float required_rate(const bw_estimator_t *bw, int rung)
+{
+    const bw_ladder_t *ladder = bw->ladder;
+    float bytes = ladder->rung_bytes[rung];
+
+    if (bw->frame_bytes > 0) {
+        bytes = bw->frame_bytes * ladder->rung_bytes[rung] / ladder->rung_bytes[bw->rung];
+    }
+    return bytes * ladder->target_fps;
+}
+
+float bw_estimator_throughput(const bw_estimator_t *bw)
+{
+    float cap = bw_estimator_rssi_cap(bw->rssi);
+
+    if (bw->samples == 0) {
+        if (bw->rssi == 0) {
+            return BW_DEFAULT_THROUGHPUT;
+        }
+        return cap > 0 ? cap : BW_STRONG_THROUGHPUT;
+    }
+
+    // Blocking sends measure the link itself and are trusted. Sends that do
+    // not block are absorbed by the socket buffer and overstate the link;
+    // the RSSI bounds those, but never below a modest step above the
+    // current rate.
+    if (cap > 0 && bw->blocking < BW_UP_BLOCKING) {
+        float probe = required_rate(bw, bw->rung) * BW_PROBE_FACTOR;
+        if (cap < probe) {
+            cap = probe;
+        }
+        if (bw->throughput > cap) {
+            return cap;
+        }
+    }
+    return bw->throughput;
+}
+
+/**
+ * @brief Highest rung whose rate fits the estimate with a margin
+ */
+static int fitting_rung(const bw_estimator_t *bw, float est, float margin)
+{
+    int rung = 0;
+
+    for (int i = 1; i < bw->ladder->rung_count; i++) {
+        if (required_rate(bw, i) * margin <= est) {
+            rung = i;
+        }
+    }
+    return rung;
+}
+
+static void switch_rung(bw_estimator_t *bw, int rung, int64_t now_us)
+{
+    float ratio = (float)bw->ladder->rung_bytes[rung] / bw->ladder->rung_bytes[bw->rung];
+
+    if (rung < bw->rung && bw->last_up_us && now_us - bw->last_up_us < BW_PROBE_FAIL_US) {
+        // The last step up did not hold: keep away from that rung for a while
+        bw->backoff_us = bw->backoff_us ? bw->backoff_us * 2 : BW_BACKOFF_MIN_US;
+        if (bw->backoff_us > BW_BACKOFF_MAX_US) {
+            bw->backoff_us = BW_BACKOFF_MAX_US;
+        }
+        bw->blocked_rung = bw->rung;
+        bw->blocked_until_us = now_us + bw->backoff_us;
+    }
+    bw->last_up_us = rung > bw->rung ? now_us : 0;
+
+    // Predict the new rung's frame size and send share until measured
+    bw->frame_bytes *= ratio;
+    bw->blocking *= ratio;
+    bw->rung = rung;
+    bw->switches++;
+    bw->last_switch_us = now_us;
+    bw->down_since_us = 0;
+    bw->up_since_us = 0;
+}
+
+/**
+ * @brief Apply the down/up rules with their holds
+ */
+static bool evaluate(bw_estimator_t *bw, int64_t now_us)
+{
+    const bw_ladder_t *ladder = bw->ladder;
+    float est = bw_estimator_throughput(bw);
+    int rung = bw->rung;
+
+    // A blocking send is a direct link measurement; react to it without
+    // waiting for the average to catch up
+    float down_est = est;
+    if (bw->last_share > BW_UP_BLOCKING && bw->last_sample < down_est) {
+        down_est = bw->last_sample;
+    }
+
+    bool down = rung > 0 &&
+        (required_rate(bw, rung) > down_est * BW_DOWN_MARGIN || bw->blocking > BW_DOWN_BLOCKING);
+    if (down) {
+        bw->up_since_us = 0;
+        if (bw->down_since_us == 0) {
+            bw->down_since_us = now_us;
+        }
+        if (now_us - bw->down_since_us < ladder->down_hold_us) {
+            return false;
+        }
+        // Drop straight to a rung that fits, at least one step
+        int target = fitting_rung(bw, down_est, BW_UP_MARGIN);
+        switch_rung(bw, target < rung ? target : rung - 1, now_us);
+        return true;
+    }
+    bw->down_since_us = 0;
+
+    if (bw->backoff_us && bw->last_up_us == 0 && rung >= bw->blocked_rung) {
+        bw->backoff_us = 0;     // Reached the blocked rung's level some other way
+    }
+    bool up = rung + 1 < ladder->rung_count &&
+        required_rate(bw, rung + 1) * BW_UP_MARGIN <= est && bw->blocking < BW_UP_BLOCKING &&
+        !(rung + 1 == bw->blocked_rung && now_us < bw->blocked_until_us);
+    if (!up) {
+        bw->up_since_us = 0;
+        return false;
+    }
+    if (bw->up_since_us == 0) {
+        bw->up_since_us = now_us;
+    }
+    if (now_us - bw->up_since_us < ladder->up_hold_us ||
+        now_us - bw->last_switch_us < ladder->min_dwell_us) {
+        return false;
+    }
+    // One step at a time upwards
+    switch_rung(bw, rung + 1, now_us);
+    return true;
+}
+
+void bw_estimator_init(bw_estimator_t *bw, const bw_ladder_t *ladder, int rssi, int64_t now_us)
+{
+    *bw = (bw_estimator_t) {
+        .ladder = ladder,
+        .rssi = rssi,
+        .blocked_rung = -1,
+        .last_switch_us = now_us,
+    };
+    bw->rung = fitting_rung(bw, bw_estimator_throughput(bw), BW_UP_MARGIN);
+}
+
+void bw_estimator_set_rssi(bw_estimator_t *bw, int rssi)
+{
+    bw->rssi = rssi;
+}
+
+bool bw_estimator_on_send(bw_estimator_t *bw, size_t bytes, uint32_t send_us, int frame_rung,
+                          int64_t now_us)
+{
+    float sample = bytes * 1000000.0f / (send_us < BW_MIN_SEND_US ? BW_MIN_SEND_US : send_us);
+
+    // Frame size and send share as if the frame had been made at our rung
+    float scale = (float)bw->ladder->rung_bytes[bw->rung] / bw->ladder->rung_bytes[frame_rung];
+    float frame_bytes = bytes * scale;
+
+    if (bw->samples == 0) {
+        bw->throughput = sample;
+        bw->frame_bytes = frame_bytes;
+    } else {
+        bw->throughput += BW_EWMA_ALPHA * (sample - bw->throughput);
+        bw->frame_bytes += BW_EWMA_ALPHA * (frame_bytes - bw->frame_bytes);
+    }
+    bw->last_sample = sample;
+
+    bw->last_share = 0;
+    if (bw->last_send_us > 0 && now_us > bw->last_send_us) {
+        float share = scale * send_us / (now_us - bw->last_send_us);
+        bw->last_share = share > 1.0f ? 1.0f : share;
+        bw->blocking += BW_EWMA_ALPHA * (bw->last_share - bw->blocking);
+    }
+    bw->last_send_us = now_us;
+    bw->samples++;
+
+    return evaluate(bw, now_us);
+}
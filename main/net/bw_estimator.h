@@ -0,0 +1,122 @@
+/**
+ * @file bw_estimator.h
+ * @brief Per-connection bandwidth estimator and quality ladder controller
+ *
+ * Picks a rung from a ladder of frame settings (e.g. framesize/quality
+ * pairs) the way adaptive-bitrate video players do. Three signals feed the
+ * decision:
+ *
+ * - throughput: EWMA of bytes per microsecond spent in the send call
+ * - blocking: EWMA of the share of the frame interval spent sending; near
+ *   one means frames are queueing behind the link
+ * - RSSI: caps the throughput estimate and seeds it before any send
+ *
+ * Switching down is quick (a short hold), switching up is slow (a longer
+ * hold, a margin, and a minimum dwell after any switch). A step up that is
+ * undone shortly afterwards blocks that rung with an exponential backoff.
+ * Together these keep the controller from flapping on a noisy link.
+ *
+ * The estimator has no ESP-IDF dependencies; times are passed in so it can
+ * be driven by simulated traces on a host.
+ */
+
+#ifndef BW_ESTIMATOR_H
+#define BW_ESTIMATOR_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define BW_LADDER_MAX_RUNGS 8
+
+/**
+ * @brief Ladder description
+ */
+typedef struct {
+    int rung_count;
+    uint32_t rung_bytes[BW_LADDER_MAX_RUNGS];   // Nominal frame size, ascending
+    float target_fps;           // Frames the link must carry per second
+    uint32_t down_hold_us;      // Down condition must persist this long
+    uint32_t up_hold_us;        // Up condition must persist this long
+    uint32_t min_dwell_us;      // Minimum time on a rung before switching up
+} bw_ladder_t;
+
+/**
+ * @brief Estimator state for one connection
+ */
+typedef struct {
+    const bw_ladder_t *ladder;
+    int rung;                   // Current rung
+    float throughput;           // Bytes per second, 0 until known
+    float blocking;             // Share of the frame interval spent sending
+    float frame_bytes;          // Measured bytes per frame at the current rung
+    float last_sample;          // Throughput of the last send
+    float last_share;           // Interval share of the last send
+    int rssi;                   // dBm, 0 if unknown
+    uint32_t samples;
+    uint32_t switches;
+    int64_t last_send_us;
+    int64_t last_switch_us;
+    int64_t down_since_us;      // Down condition start, 0 if not met
+    int64_t up_since_us;        // Up condition start, 0 if not met
+    int64_t last_up_us;         // Time of the last step up, 0 if the last switch was down
+    int blocked_rung;           // Rung a failed step up may not retry yet, -1 if none
+    int64_t blocked_until_us;
+    uint32_t backoff_us;        // Doubles on each failed step up
+} bw_estimator_t;
+
+/**
+ * @brief Initialize and choose a starting rung from the RSSI alone
+ *
+ * @param bw Estimator
+ * @param ladder Ladder, must outlive the estimator
+ * @param rssi Current RSSI in dBm, 0 if unknown
+ * @param now_us Current time
+ */
+void bw_estimator_init(bw_estimator_t *bw, const bw_ladder_t *ladder, int rssi, int64_t now_us);
+
+/**
+ * @brief Update the RSSI
+ *
+ * @param bw Estimator
+ * @param rssi RSSI in dBm, 0 if unknown
+ */
+void bw_estimator_set_rssi(bw_estimator_t *bw, int rssi);
+
+/**
+ * @brief Feed one completed frame send and re-evaluate the rung
+ *
+ * When several connections share one encoder the frame may have been made
+ * at a lower rung than this connection's; its size and send time are then
+ * scaled to this connection's rung by the nominal size ratio.
+ *
+ * @param bw Estimator
+ * @param bytes Bytes sent
+ * @param send_us Time spent in the send call(s)
+ * @param frame_rung Rung the frame was produced at
+ * @param now_us Time the send completed
+ * @return true if the rung changed
+ */
+bool bw_estimator_on_send(bw_estimator_t *bw, size_t bytes, uint32_t send_us, int frame_rung,
+                          int64_t now_us);
+
+/**
+ * @brief Throughput estimate after the RSSI cap
+ *
+ * @param bw Estimator
+ * @return Bytes per second
+ */
+float bw_estimator_throughput(const bw_estimator_t *bw);
+
+/**
+ * @brief Upper bound on goodput for an RSSI
+ *
+ * A conservative TCP goodput figure per signal level; weaker signal means
+ * lower PHY rates and more retries.
+ *
+ * @param rssi RSSI in dBm, 0 if unknown
+ * @return Bytes per second, or 0 for no cap
+ */
+float bw_estimator_rssi_cap(int rssi);
+
+#endif // BW_ESTIMATOR_H
@@ -0,0 +1,322 @@
+/**
+ * @file cbor.c
+ * @brief Minimal CBOR writer and reader implementation
+ */
+
+#include "net/cbor.h"
+#include <string.h>
+
+// Major types
+#define MT_UINT     0
+#define MT_NINT     1
+#define MT_BYTES    2
+#define MT_TEXT     3
+#define MT_ARRAY    4
+#define MT_MAP      5
+#define MT_TAG      6
+#define MT_SIMPLE   7
+
+// Additional information values
+#define AI_1BYTE    24
+#define AI_2BYTE    25
+#define AI_4BYTE    26
+#define AI_8BYTE    27
+#define AI_INDEF    31
+
+#define SIMPLE_FALSE 20
+#define SIMPLE_TRUE  21
+#define BREAK        0xff
+
+static void put_bytes(cbor_writer_t *w, const void *data, size_t len)
+{
+    if (w->overflow || len > w->size - w->len) {
+        w->overflow = true;
+        return;
+    }
+    memcpy(w->buf + w->len, data, len);
+    w->len += len;
+}
+
+/**
+ * @brief Write an item head with the argument in its shortest form
+ */
+static void put_head(cbor_writer_t *w, int major, uint64_t arg)
+{
+    uint8_t head[9];
+    size_t len;
+
+    major <<= 5;
+    if (arg < AI_1BYTE) {
+        head[0] = major | arg;
+        len = 1;
+    } else if (arg <= 0xff) {
+        head[0] = major | AI_1BYTE;
+        head[1] = arg;
+        len = 2;
+    } else if (arg <= 0xffff) {
+        head[0] = major | AI_2BYTE;
+        head[1] = arg >> 8;
+        head[2] = arg;
+        len = 3;
+    } else if (arg <= 0xffffffff) {
+        head[0] = major | AI_4BYTE;
+        for (int i = 0; i < 4; i++) {
+            head[1 + i] = arg >> (24 - 8 * i);
+        }
+        len = 5;
+    } else {
+        head[0] = major | AI_8BYTE;
+        for (int i = 0; i < 8; i++) {
+            head[1 + i] = arg >> (56 - 8 * i);
+        }
+        len = 9;
+    }
+    put_bytes(w, head, len);
+}
+
+void cbor_writer_init(cbor_writer_t *w, uint8_t *buf, size_t size)
+{
+    w->buf = buf;
+    w->size = size;
+    w->len = 0;
+    w->overflow = false;
+}
+
+size_t cbor_writer_len(const cbor_writer_t *w)
+{
+    return w->overflow ? 0 : w->len;
+}
+
+void cbor_put_map(cbor_writer_t *w, size_t pairs)
+{
+    if (pairs == CBOR_INDEFINITE) {
+        uint8_t head = (MT_MAP << 5) | AI_INDEF;
+        put_bytes(w, &head, 1);
+    } else {
+        put_head(w, MT_MAP, pairs);
+    }
+}
+
+void cbor_put_break(cbor_writer_t *w)
+{
+    uint8_t b = BREAK;
+    put_bytes(w, &b, 1);
+}
+
+void cbor_put_int(cbor_writer_t *w, int64_t value)
+{
+    if (value >= 0) {
+        put_head(w, MT_UINT, (uint64_t)value);
+    } else {
+        // -1 - n without overflowing at INT64_MIN
+        put_head(w, MT_NINT, ~(uint64_t)value);
+    }
+}
+
+void cbor_put_text(cbor_writer_t *w, const char *text)
+{
+    size_t len = strlen(text);
+    put_head(w, MT_TEXT, len);
+    put_bytes(w, text, len);
+}
+
+void cbor_put_bool(cbor_writer_t *w, bool value)
+{
+    uint8_t b = (MT_SIMPLE << 5) | (value ? SIMPLE_TRUE : SIMPLE_FALSE);
+    put_bytes(w, &b, 1);
+}
+
+void cbor_put_float(cbor_writer_t *w, float value)
+{
+    uint32_t bits;
+    uint8_t out[5];
+
+    memcpy(&bits, &value, sizeof(bits));
+    out[0] = (MT_SIMPLE << 5) | AI_4BYTE;
+    for (int i = 0; i < 4; i++) {
+        out[1 + i] = bits >> (24 - 8 * i);
+    }
+    put_bytes(w, out, sizeof(out));
+}
+
+void cbor_reader_init(cbor_reader_t *r, const uint8_t *buf, size_t len)
+{
+    r->p = buf;
+    r->end = buf + len;
+}
+
+bool cbor_reader_done(const cbor_reader_t *r)
+{
+    return r->p == r->end;
+}
+
+/**
+ * @brief Read an item head
+ *
+ * @param major Receives the major type
+ * @param arg Receives the argument
+ * @param indefinite Receives whether the item has indefinite length
+ */
+static esp_err_t get_head(cbor_reader_t *r, int *major, uint64_t *arg, bool *indefinite)
+{
+    if (r->p >= r->end) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    uint8_t first = *r->p++;
+    int ai = first & 0x1f;
+    int extra;
+
+    *major = first >> 5;
+    *indefinite = false;
+    if (ai < AI_1BYTE) {
+        *arg = ai;
+        return ESP_OK;
+    }
+    if (ai == AI_INDEF) {
+        *arg = 0;
+        *indefinite = true;
+        return ESP_OK;
+    }
+    if (ai > AI_8BYTE) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    extra = 1 << (ai - AI_1BYTE);
+    if (r->end - r->p < extra) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    *arg = 0;
+    for (int i = 0; i < extra; i++) {
+        *arg = (*arg << 8) | *r->p++;
+    }
+    return ESP_OK;
+}
+
+esp_err_t cbor_get_map(cbor_reader_t *r, size_t *pairs)
+{
+    const uint8_t *start = r->p;
+    int major;
+    uint64_t arg;
+    bool indefinite;
+
+    if (get_head(r, &major, &arg, &indefinite) != ESP_OK || major != MT_MAP ||
+        (!indefinite && arg >= CBOR_INDEFINITE)) {
+        r->p = start;
+        return ESP_ERR_INVALID_ARG;
+    }
+    *pairs = indefinite ? CBOR_INDEFINITE : (size_t)arg;
+    return ESP_OK;
+}
+
+bool cbor_get_break(cbor_reader_t *r)
+{
+    if (r->p < r->end && *r->p == BREAK) {
+        r->p++;
+        return true;
+    }
+    return false;
+}
+
+esp_err_t cbor_get_int(cbor_reader_t *r, int64_t *value)
+{
+    const uint8_t *start = r->p;
+    int major;
+    uint64_t arg;
+    bool indefinite;
+
+    if (get_head(r, &major, &arg, &indefinite) != ESP_OK) {
+        r->p = start;
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (major == MT_SIMPLE && !indefinite && (arg == SIMPLE_FALSE || arg == SIMPLE_TRUE)) {
+        *value = arg == SIMPLE_TRUE;
+        return ESP_OK;
+    }
+    if ((major != MT_UINT && major != MT_NINT) || indefinite) {
+        r->p = start;
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (arg > INT64_MAX) {
+        r->p = start;
+        return ESP_ERR_INVALID_SIZE;
+    }
+    *value = major == MT_UINT ? (int64_t)arg : -1 - (int64_t)arg;
+    return ESP_OK;
+}
+
+esp_err_t cbor_get_text(cbor_reader_t *r, const char **text, size_t *len)
+{
+    const uint8_t *start = r->p;
+    int major;
+    uint64_t arg;
+    bool indefinite;
+
+    if (get_head(r, &major, &arg, &indefinite) != ESP_OK || major != MT_TEXT ||
+        indefinite || arg > (uint64_t)(r->end - r->p)) {
+        r->p = start;
+        return ESP_ERR_INVALID_ARG;
+    }
+    *text = (const char *)r->p;
+    *len = (size_t)arg;
+    r->p += arg;
+    return ESP_OK;
+}
+
+static esp_err_t skip(cbor_reader_t *r, int depth)
+{
+    int major;
+    uint64_t arg;
+    bool indefinite;
+
+    if (depth > CBOR_MAX_DEPTH) {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    if (get_head(r, &major, &arg, &indefinite) != ESP_OK) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    switch (major) {
+        case MT_UINT:
+        case MT_NINT:
+        case MT_SIMPLE:
+            // Floats carry their bytes as the argument; a lone break is malformed
+            return indefinite ? ESP_ERR_INVALID_ARG : ESP_OK;
+        case MT_BYTES:
+        case MT_TEXT:
+            if (indefinite) {
+                // Chunks of the same type until the break
+                while (!cbor_get_break(r)) {
+                    esp_err_t err = skip(r, depth + 1);
+                    if (err != ESP_OK) {
+                        return err;
+                    }
+                }
+                return ESP_OK;
+            }
+            if (arg > (uint64_t)(r->end - r->p)) {
+                return ESP_ERR_INVALID_ARG;
+            }
+            r->p += arg;
+            return ESP_OK;
+        case MT_TAG:
+            return skip(r, depth + 1);
+        default: {
+            // Arrays and maps: maps hold two items per entry
+            uint64_t items = indefinite ? UINT64_MAX : arg * (major == MT_MAP ? 2 : 1);
+            for (uint64_t i = 0; i < items; i++) {
+                if (indefinite && cbor_get_break(r)) {
+                    return ESP_OK;
+                }
+                esp_err_t err = skip(r, depth + 1);
+                if (err != ESP_OK) {
+                    return err;
+                }
+            }
+            return ESP_OK;
+        }
+    }
+}
+
+esp_err_t cbor_skip(cbor_reader_t *r)
+{
+    return skip(r, 0);
+}
@@ -0,0 +1,118 @@
+/**
+ * @file cbor.h
+ * @brief Minimal CBOR (RFC 8949) writer and reader
+ *
+ * Covers what the binary status and control API needs: maps, integers,
+ * text strings, booleans and 32-bit floats. The writer fills a caller
+ * buffer and the reader walks one in place (text strings are returned as
+ * pointers into it), so neither allocates. Integers are written in their
+ * shortest form.
+ *
+ * Write errors are sticky: calls after the buffer filled up do nothing
+ * and cbor_writer_len() reports 0, so a sequence of puts needs a single
+ * check at the end.
+ *
+ * No ESP-IDF dependencies beyond esp_err.h, so it can be driven on a host.
+ */
+
+#ifndef CBOR_H
+#define CBOR_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+// Map length passed to cbor_put_map() / returned by cbor_get_map() for
+// an indefinite-length map, which ends with a break
+#define CBOR_INDEFINITE SIZE_MAX
+
+// Nesting cbor_skip() follows before giving up
+#define CBOR_MAX_DEPTH 8
+
+/**
+ * @brief Output buffer being written
+ */
+typedef struct {
+    uint8_t *buf;
+    size_t size;
+    size_t len;
+    bool overflow;
+} cbor_writer_t;
+
+/**
+ * @brief Input buffer being read
+ */
+typedef struct {
+    const uint8_t *p;
+    const uint8_t *end;
+} cbor_reader_t;
+
+void cbor_writer_init(cbor_writer_t *w, uint8_t *buf, size_t size);
+
+/**
+ * @brief Bytes written, or 0 if the buffer was too small
+ */
+size_t cbor_writer_len(const cbor_writer_t *w);
+
+/**
+ * @brief Start a map of pairs key/value items, or CBOR_INDEFINITE
+ */
+void cbor_put_map(cbor_writer_t *w, size_t pairs);
+
+/**
+ * @brief End an indefinite-length map
+ */
+void cbor_put_break(cbor_writer_t *w);
+
+void cbor_put_int(cbor_writer_t *w, int64_t value);
+void cbor_put_text(cbor_writer_t *w, const char *text);
+void cbor_put_bool(cbor_writer_t *w, bool value);
+void cbor_put_float(cbor_writer_t *w, float value);
+
+void cbor_reader_init(cbor_reader_t *r, const uint8_t *buf, size_t len);
+
+/**
+ * @brief Whether the whole buffer was read
+ */
+bool cbor_reader_done(const cbor_reader_t *r);
+
+/**
+ * @brief Read a map header
+ *
+ * @param pairs Receives the number of pairs, or CBOR_INDEFINITE
+ * @return ESP_OK, or ESP_ERR_INVALID_ARG if the next item is not a map
+ */
+esp_err_t cbor_get_map(cbor_reader_t *r, size_t *pairs);
+
+/**
+ * @brief Consume a break if it is next (end of an indefinite map)
+ */
+bool cbor_get_break(cbor_reader_t *r);
+
+/**
+ * @brief Read an integer; true and false read as 1 and 0
+ *
+ * @return ESP_OK, ESP_ERR_INVALID_ARG for another type, or
+ *         ESP_ERR_INVALID_SIZE if the value does not fit an int64_t
+ */
+esp_err_t cbor_get_int(cbor_reader_t *r, int64_t *value);
+
+/**
+ * @brief Read a definite-length text string without copying it
+ *
+ * @param text Receives a pointer into the input (not NUL-terminated)
+ * @param len Receives its length
+ * @return ESP_OK or ESP_ERR_INVALID_ARG
+ */
+esp_err_t cbor_get_text(cbor_reader_t *r, const char **text, size_t *len);
+
+/**
+ * @brief Skip one item, including everything nested in it
+ *
+ * @return ESP_OK, ESP_ERR_INVALID_ARG for malformed input, or
+ *         ESP_ERR_NOT_SUPPORTED past CBOR_MAX_DEPTH
+ */
+esp_err_t cbor_skip(cbor_reader_t *r);
+
+#endif // CBOR_H
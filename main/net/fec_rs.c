@@ -0,0 +1,59 @@
+/**
+ * @file fec_rs.c
+ * @brief Reed-Solomon erasure code implementation
+ */
+
+#include "net/fec_rs.h"
+#include <string.h>
+
+#define GF_POLY 0x11d
+
+static uint8_t s_exp[510];                  // Doubled so log sums need no modulo
+static uint8_t s_log[256];
+
+void fec_rs_init(void)
+{
+    unsigned x = 1;
+
+    for (int i = 0; i < 255; i++) {
+        s_exp[i] = x;
+        s_exp[i + 255] = x;
+        s_log[x] = i;
+        x <<= 1;
+        if (x & 0x100) {
+            x ^= GF_POLY;
+        }
+    }
+}
+
+/**
+ * @brief Cauchy coefficient of data block i in parity row r
+ */
+static uint8_t cauchy(int k, int row, int i)
+{
+    uint8_t sum = (uint8_t)(k + row) ^ (uint8_t)i;     // x_r + y_i, never zero
+
+    return s_exp[255 - s_log[sum]];
+}
+
+void fec_rs_parity(const uint8_t *const *data, int k, size_t block_size, int row,
+                   uint8_t *out)
+{
+    uint8_t mul[256];
+
+    memset(out, 0, block_size);
+    for (int i = 0; i < k; i++) {
+        // One 256-entry product table per coefficient keeps the inner loop
+        // to a lookup and an XOR
+        int log_c = s_log[cauchy(k, row, i)];
+        mul[0] = 0;
+        for (int v = 1; v < 256; v++) {
+            mul[v] = s_exp[log_c + s_log[v]];
+        }
+
+        const uint8_t *src = data[i];
+        for (size_t b = 0; b < block_size; b++) {
+            out[b] ^= mul[src[b]];
+        }
+    }
+}
@@ -0,0 +1,43 @@
+/**
+ * @file fec_rs.h
+ * @brief Systematic Reed-Solomon erasure code over GF(2^8)
+ *
+ * A group of k data blocks is extended with parity blocks from a Cauchy
+ * matrix: parity row r is sum over i of data[i] / (x_r + y_i), with
+ * y_i = i and x_r = k + r. Any k distinct blocks of a group, data or
+ * parity, recover the data, and new parity rows can be generated on
+ * demand (up to 256 - k of them) when a receiver still misses blocks.
+ *
+ * Field: GF(2^8) with the polynomial x^8 + x^4 + x^3 + x^2 + 1 (0x11d).
+ *
+ * The code has no ESP-IDF dependencies so it can be checked on a host.
+ */
+
+#ifndef FEC_RS_H
+#define FEC_RS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Largest k + parity rows per group
+#define FEC_RS_MAX_BLOCKS 256
+
+/**
+ * @brief Build the field tables; call once before anything else
+ */
+void fec_rs_init(void);
+
+/**
+ * @brief Compute one parity block of a group
+ *
+ * @param data The group's k data blocks, each block_size bytes (pad the
+ *             last block of a message with zeros)
+ * @param k Number of data blocks
+ * @param block_size Block length
+ * @param row Parity row, 0 to FEC_RS_MAX_BLOCKS - k - 1
+ * @param out Receives the parity block
+ */
+void fec_rs_parity(const uint8_t *const *data, int k, size_t block_size, int row,
+                   uint8_t *out);
+
+#endif // FEC_RS_H
@@ -0,0 +1,86 @@
+/**
+ * @file http_raw.c
+ * @brief Raw HTTP response writing implementation
+ */
+
+#include "net/http_raw.h"
+#include "esp_log.h"
+#include <errno.h>
+#include <stdio.h>
+
+static const char *TAG = "http_raw";
+
+esp_err_t http_raw_send_all(httpd_req_t *req, const void *buf, size_t len)
+{
+    const char *p = (const char *)buf;
+
+    while (len > 0) {
+        int sent = httpd_send(req, p, len);
+        if (sent <= 0) {
+            ESP_LOGW(TAG, "Socket send failed (%d)", sent);
+            return ESP_FAIL;
+        }
+        p += sent;
+        len -= sent;
+    }
+    return ESP_OK;
+}
+
+esp_err_t http_raw_send_headers(httpd_req_t *req, const char *status,
+                                const char *content_type, long content_length,
+                                const char *extra_headers)
+{
+    char hdr[256];
+    int hlen;
+
+    if (content_length >= 0) {
+        hlen = snprintf(hdr, sizeof(hdr),
+                        "HTTP/1.1 %s\r\n"
+                        "Content-Type: %s\r\n"
+                        "Content-Length: %ld\r\n"
+                        "%s"
+                        "\r\n",
+                        status, content_type, content_length,
+                        extra_headers ? extra_headers : "");
+    } else {
+        hlen = snprintf(hdr, sizeof(hdr),
+                        "HTTP/1.1 %s\r\n"
+                        "Content-Type: %s\r\n"
+                        "%s"
+                        "\r\n",
+                        status, content_type,
+                        extra_headers ? extra_headers : "");
+    }
+
+    if (hlen < 0 || hlen >= (int)sizeof(hdr)) {
+        ESP_LOGE(TAG, "Response headers too long");
+        return ESP_ERR_INVALID_SIZE;
+    }
+    return http_raw_send_all(req, hdr, hlen);
+}
+
+esp_err_t http_raw_writev_all(int sockfd, struct iovec *iov, int iovcnt)
+{
+    while (iovcnt > 0) {
+        ssize_t sent = lwip_writev(sockfd, iov, iovcnt);
+        if (sent < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            ESP_LOGW(TAG, "writev failed on socket %d (errno %d)", sockfd, errno);
+            return ESP_FAIL;
+        }
+
+        // Skip fully written buffers and trim a partially written one
+        while (iovcnt > 0 && (size_t)sent >= iov->iov_len) {
+            sent -= iov->iov_len;
+            iov++;
+            iovcnt--;
+        }
+        if (iovcnt > 0) {
+            iov->iov_base = (char *)iov->iov_base + sent;
+            iov->iov_len -= sent;
+        }
+    }
+    return ESP_OK;
+}
@@ -0,0 +1,59 @@
+/**
+ * @file http_raw.h
+ * @brief Raw HTTP response writing on an httpd request's socket
+ *
+ * Used by send paths that bypass httpd's own response framing (chunked
+ * encoding) and need to write the status line, headers and body
+ * themselves.
+ */
+
+#ifndef HTTP_RAW_H
+#define HTTP_RAW_H
+
+#include <stddef.h>
+#include "lwip/sockets.h"
+#include "esp_err.h"
+#include "esp_http_server.h"
+
+/**
+ * @brief Send a buffer completely, retrying on partial writes
+ *
+ * @param req HTTP request whose session socket is written
+ * @param buf Data to send
+ * @param len Number of bytes to send
+ * @return ESP_OK on success, ESP_FAIL if the socket errored or timed out
+ */
+esp_err_t http_raw_send_all(httpd_req_t *req, const void *buf, size_t len);
+
+/**
+ * @brief Write a complete response header block
+ *
+ * Writes "HTTP/1.1 <status>", Content-Type, Content-Length (omitted when
+ * content_length is negative) and any extra header lines, followed by the
+ * blank line that ends the header block.
+ *
+ * @param req HTTP request to respond to
+ * @param status Status line text, e.g. "200 OK"
+ * @param content_type Value of the Content-Type header
+ * @param content_length Body length in bytes, or -1 for none
+ * @param extra_headers Additional "Name: value\r\n" lines, or NULL
+ * @return ESP_OK on success, error code otherwise
+ */
+esp_err_t http_raw_send_headers(httpd_req_t *req, const char *status,
+                                const char *content_type, long content_length,
+                                const char *extra_headers);
+
+/**
+ * @brief Write several buffers to a socket with vectored writes
+ *
+ * Issues one writev() per call in the common case and only loops when the
+ * TCP send buffer accepts a partial write. The iov array is modified.
+ *
+ * @param sockfd Socket descriptor (see httpd_req_to_sockfd())
+ * @param iov Buffers to write, in order
+ * @param iovcnt Number of entries in iov
+ * @return ESP_OK on success, ESP_FAIL if the socket errored or timed out
+ */
+esp_err_t http_raw_writev_all(int sockfd, struct iovec *iov, int iovcnt);
+
+#endif // HTTP_RAW_H
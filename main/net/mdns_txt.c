@@ -0,0 +1,152 @@
+/**
+ * @file mdns_txt.c
+ * @brief mDNS TXT record publisher implementation
+ */
+
+#include "net/mdns_txt.h"
+#include "camera/camera_service.h"
+#include "camera/camera_params.h"
+#if CONFIG_GROWPOD_UDP_STILL
+#include "net/udp_still.h"
+#endif
+#include "esp_app_desc.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "mdns.h"
+#include <stdio.h>
+
+static const char *TAG = "mdns_txt";
+
+#define MDNS_TXT_POLL_US        1000000
+#define MDNS_TXT_HTTP_PORT      "80"       // Streams share the HTTP server
+
+#define STRINGIFY_(x)           #x
+#define STRINGIFY(x)            STRINGIFY_(x)
+
+// Endpoints as registered by start_webserver()
+static const char *const ENDPOINTS = "capture,last,stream,preview,settings,status,control,"
+                                     "status.cbor,control.cbor,"
+                                     "multicast"
+#if CONFIG_GROWPOD_H264_STREAM
+                                     ",stream.mp4"
+#endif
+#if CONFIG_GROWPOD_YUV_MULTIRES
+                                     ",capture_multi"
+#endif
+#if CONFIG_GROWPOD_STATUS_EVENTS
+                                     ",events"
+#endif
+#if CONFIG_GROWPOD_ADMISSION
+                                     ",limits"
+#endif
+                                     ;
+
+/**
+ * @brief The published part of the camera state
+ */
+typedef struct {
+    camera_mode_t mode;
+    framesize_t framesize;
+    int quality;
+    uint32_t captures;
+} txt_state_t;
+
+// Owned by the esp_timer task after init
+static txt_state_t s_published;
+static int64_t s_published_us;
+static esp_timer_handle_t s_timer;
+
+static void read_state(txt_state_t *state)
+{
+    camera_service_stats_t stats;
+
+    camera_service_get_stats(&stats);
+    state->mode = stats.mode;
+    state->framesize = stats.still_framesize;
+    state->quality = stats.still_quality;
+    state->captures = stats.stills;
+}
+
+static esp_err_t publish(const txt_state_t *state)
+{
+    char quality[8];
+    char captures[12];
+
+    snprintf(quality, sizeof(quality), "%d", state->quality);
+    snprintf(captures, sizeof(captures), "%lu", (unsigned long)state->captures);
+    mdns_txt_item_t txt[] = {
+        { "txtvers", "1" },
+        { "fw", esp_app_get_description()->version },
+        { "api", ENDPOINTS },
+        { "sport", MDNS_TXT_HTTP_PORT },
+#if CONFIG_GROWPOD_UDP_STILL
+        { "uport", STRINGIFY(UDP_STILL_PORT) },
+#endif
+        { "fs", camera_framesize_name(state->framesize) },
+        { "q", quality },
+        { "mode", camera_mode_name(state->mode) },
+        { "cap", captures },
+    };
+
+    esp_err_t err = mdns_service_txt_set("_http", "_tcp", txt, sizeof(txt) / sizeof(txt[0]));
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Failed to set TXT records: %s", esp_err_to_name(err));
+        return err;
+    }
+    s_published = *state;
+    s_published_us = esp_timer_get_time();
+    return ESP_OK;
+}
+
+/**
+ * @brief Periodic check: republish changed state within the rate limits
+ */
+static void poll_state(void *arg)
+{
+    txt_state_t state;
+    read_state(&state);
+
+    bool profile_changed = state.mode != s_published.mode ||
+                           state.framesize != s_published.framesize ||
+                           state.quality != s_published.quality;
+    bool counter_changed = state.captures != s_published.captures;
+    int64_t since_us = esp_timer_get_time() - s_published_us;
+
+    if (profile_changed ||
+        (counter_changed && since_us >= (int64_t)MDNS_TXT_COUNTER_INTERVAL_MS * 1000)) {
+        if (publish(&state) == ESP_OK) {
+            ESP_LOGD(TAG, "TXT updated: %s q=%d mode=%s cap=%lu",
+                     camera_framesize_name(state.framesize), state.quality,
+                     camera_mode_name(state.mode), (unsigned long)state.captures);
+        }
+    }
+}
+
+esp_err_t mdns_txt_init(void)
+{
+    txt_state_t state;
+    read_state(&state);
+    esp_err_t err = publish(&state);
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    // The poll period is the limit for profile changes
+    const esp_timer_create_args_t args = {
+        .callback = poll_state,
+        .name = "mdns_txt",
+    };
+    err = esp_timer_create(&args, &s_timer);
+    if (err == ESP_OK) {
+        err = esp_timer_start_periodic(s_timer, MDNS_TXT_POLL_US);
+    }
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to start TXT update timer: %s", esp_err_to_name(err));
+        return err;
+    }
+
+    ESP_LOGI(TAG, "Advertising fw %s, %s q=%d in mDNS TXT",
+             esp_app_get_description()->version,
+             camera_framesize_name(state.framesize), state.quality);
+    return ESP_OK;
+}
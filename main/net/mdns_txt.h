@@ -0,0 +1,40 @@
+/**
+ * @file mdns_txt.h
+ * @brief Capability and state TXT records on the mDNS HTTP service
+ *
+ * Publishes what a fleet inventory needs on the _http._tcp service, so a
+ * client browsing mDNS learns it without a /status request per camera:
+ *
+ * - txtvers  TXT layout version (1)
+ * - fw       firmware version (esp_app_desc_t version)
+ * - api      comma-separated endpoints this build serves
+ * - sport    TCP port of /stream (and /stream.mp4)
+ * - uport    UDP still transfer port, only with CONFIG_GROWPOD_UDP_STILL
+ * - fs, q    still profile framesize name and JPEG quality
+ * - mode     still, stream or yuv
+ * - cap      still captures since boot
+ *
+ * State is polled once a second and republished only when it changed.
+ * Each change makes the responder announce the service again, so updates
+ * are rate-limited: profile and mode changes go out within a second,
+ * a capture counter that moved on its own at most every
+ * MDNS_TXT_COUNTER_INTERVAL_MS.
+ */
+
+#ifndef MDNS_TXT_H
+#define MDNS_TXT_H
+
+#include "esp_err.h"
+
+#define MDNS_TXT_COUNTER_INTERVAL_MS 10000
+
+/**
+ * @brief Publish the TXT records and start watching for changes
+ *
+ * Must be called after mdns_init_service() and camera_service_init().
+ *
+ * @return ESP_OK on success, error code otherwise
+ */
+esp_err_t mdns_txt_init(void);
+
+#endif // MDNS_TXT_H
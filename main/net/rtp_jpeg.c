@@ -0,0 +1,144 @@
+/**
+ * @file rtp_jpeg.c
+ * @brief RTP/JPEG packetization implementation
+ */
+
+#include "net/rtp_jpeg.h"
+#include "jpeg/jpeg_tables.h"
+#include <string.h>
+
+#define RTP_HEADER_SIZE   12
+#define JPEG_HEADER_SIZE  8
+
+// RFC 2435 3.1.7: restart intervals not aligned to packets
+#define RESTART_COUNT_UNALIGNED 0x3fff
+
+/**
+ * @brief Whether a table is missing (receivers assume Annex K) or equal to a spec
+ */
+static bool is_std_table(const jpeg_huff_dec_t *table, bool present,
+                         const jpeg_huff_spec_t *spec)
+{
+    if (!present) {
+        return true;
+    }
+    return memcmp(table->bits, spec->bits, 16) == 0 &&
+           memcmp(table->vals, spec->vals, jpeg_huff_count(spec)) == 0;
+}
+
+esp_err_t rtp_jpeg_prepare(const uint8_t *jpeg, size_t len, jpeg_info_t *info,
+                           int64_t timestamp_us, rtp_jpeg_frame_t *frame)
+{
+    esp_err_t err = jpeg_scan_parse(jpeg, len, info);
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    const jpeg_component_t *y = &info->comp[0];
+    const jpeg_component_t *cb = &info->comp[1];
+    const jpeg_component_t *cr = &info->comp[2];
+    if (info->ncomp != 3 || y->h != 2 || (y->v != 1 && y->v != 2) ||
+        cb->h != 1 || cb->v != 1 || cr->h != 1 || cr->v != 1 || cb->tq != cr->tq ||
+        cb->td != cr->td || cb->ta != cr->ta) {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    if (info->width > 2040 || info->height > 2040) {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    if (!is_std_table(&info->dc[y->td], info->dc_present & (1 << y->td), &jpeg_std_dc_luma) ||
+        !is_std_table(&info->ac[y->ta], info->ac_present & (1 << y->ta), &jpeg_std_ac_luma) ||
+        !is_std_table(&info->dc[cb->td], info->dc_present & (1 << cb->td), &jpeg_std_dc_chroma) ||
+        !is_std_table(&info->ac[cb->ta], info->ac_present & (1 << cb->ta), &jpeg_std_ac_chroma)) {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+
+    for (int k = 0; k < 64; k++) {
+        uint16_t luma = info->qt[y->tq][k];
+        uint16_t chroma = info->qt[cb->tq][k];
+        if (luma > 255 || chroma > 255) {
+            return ESP_ERR_NOT_SUPPORTED;
+        }
+        frame->qt[k] = luma;
+        frame->qt[64 + k] = chroma;
+    }
+
+    frame->scan = jpeg + info->scan_offset;
+    frame->scan_len = info->scan_end - info->scan_offset;
+    frame->type = (y->v == 2 ? 1 : 0) | (info->restart_interval ? 64 : 0);
+    frame->width8 = (info->width + 7) / 8;
+    frame->height8 = (info->height + 7) / 8;
+    frame->restart_interval = info->restart_interval;
+    frame->timestamp = (uint32_t)(timestamp_us * 9 / 100);
+    frame->offset = 0;
+    return ESP_OK;
+}
+
+bool rtp_jpeg_next(rtp_jpeg_session_t *session, rtp_jpeg_frame_t *frame,
+                   uint8_t *header, size_t *header_len,
+                   const uint8_t **payload, size_t *payload_len)
+{
+    if (frame->offset >= frame->scan_len) {
+        return false;
+    }
+
+    uint8_t *p = header + RTP_HEADER_SIZE;
+    size_t offset = frame->offset;
+
+    // Main JPEG header (3.1): type-specific, fragment offset, type, Q, size
+    p[0] = 0;
+    p[1] = offset >> 16;
+    p[2] = offset >> 8;
+    p[3] = offset;
+    p[4] = frame->type;
+    p[5] = 255;                             // Tables in-band
+    p[6] = frame->width8;
+    p[7] = frame->height8;
+    p += JPEG_HEADER_SIZE;
+
+    if (frame->restart_interval) {
+        p[0] = frame->restart_interval >> 8;
+        p[1] = frame->restart_interval;
+        p[2] = 0xc0 | (RESTART_COUNT_UNALIGNED >> 8);   // F = L = 1
+        p[3] = RESTART_COUNT_UNALIGNED & 0xff;
+        p += 4;
+    }
+
+    if (offset == 0) {
+        // Quantization table header (3.1.8), first packet only
+        p[0] = 0;
+        p[1] = 0;                           // 8-bit tables
+        p[2] = 0;
+        p[3] = sizeof(frame->qt);
+        memcpy(p + 4, frame->qt, sizeof(frame->qt));
+        p += 4 + sizeof(frame->qt);
+    }
+
+    size_t hlen = p - header;
+    size_t room = session->mtu_payload - hlen;
+    size_t len = frame->scan_len - offset;
+    if (len > room) {
+        len = room;
+    }
+    bool last = (offset + len == frame->scan_len);
+
+    // RTP header (RFC 3550 5.1); the marker bit ends the frame
+    header[0] = 0x80;
+    header[1] = (last ? 0x80 : 0) | RTP_JPEG_PAYLOAD_TYPE;
+    header[2] = session->seq >> 8;
+    header[3] = session->seq;
+    header[4] = frame->timestamp >> 24;
+    header[5] = frame->timestamp >> 16;
+    header[6] = frame->timestamp >> 8;
+    header[7] = frame->timestamp;
+    header[8] = session->ssrc >> 24;
+    header[9] = session->ssrc >> 16;
+    header[10] = session->ssrc >> 8;
+    header[11] = session->ssrc;
+    session->seq++;
+
+    *header_len = hlen;
+    *payload = frame->scan + offset;
+    *payload_len = len;
+    frame->offset = offset + len;
+    return true;
+}
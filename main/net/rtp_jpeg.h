@@ -0,0 +1,88 @@
+/**
+ * @file rtp_jpeg.h
+ * @brief RTP packetization of baseline JPEG frames (RFC 2435)
+ *
+ * RFC 2435 carries only the entropy-coded scan; receivers rebuild the
+ * headers from an 8-byte JPEG header per packet, assuming the Annex K
+ * Huffman tables. Quantization tables travel in-band in the first packet
+ * of each frame (Q = 255), so quality changes need no signalling.
+ *
+ * Headers are built into a small buffer while the scan data is sent
+ * straight from the frame buffer, one sendmsg() per packet.
+ *
+ * The packetizer has no ESP-IDF dependencies beyond esp_err.h so it can be
+ * driven on a host.
+ */
+
+#ifndef RTP_JPEG_H
+#define RTP_JPEG_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "jpeg/jpeg_scan.h"
+
+#define RTP_JPEG_PAYLOAD_TYPE 26        // Static payload type (RFC 3551)
+#define RTP_JPEG_CLOCK_RATE   90000
+
+// Largest header rtp_jpeg_next() writes: RTP, JPEG, restart marker and
+// two 8-bit quantization tables
+#define RTP_JPEG_MAX_HEADER   (12 + 8 + 4 + 4 + 128)
+
+/**
+ * @brief One frame being packetized
+ */
+typedef struct {
+    const uint8_t *scan;        // Entropy-coded data, inside the caller's JPEG
+    size_t scan_len;
+    uint8_t type;               // RFC 2435 type: 0 = 4:2:2, 1 = 4:2:0, +64 with restarts
+    uint8_t width8, height8;    // Picture size in 8-pixel units
+    uint16_t restart_interval;
+    uint8_t qt[128];            // Luma and chroma tables, zigzag order
+
+    uint32_t timestamp;         // RTP timestamp (90 kHz)
+    size_t offset;              // Next scan byte to send
+} rtp_jpeg_frame_t;
+
+/**
+ * @brief RTP session state shared by all frames
+ */
+typedef struct {
+    uint32_t ssrc;
+    uint16_t seq;               // Next sequence number
+    size_t mtu_payload;         // Largest UDP payload, headers included
+} rtp_jpeg_session_t;
+
+/**
+ * @brief Prepare a JPEG frame for packetization
+ *
+ * @param jpeg JPEG data, must stay valid until the last packet is sent
+ * @param len Its length
+ * @param info Scratch space for the parser; large, avoid the stack
+ * @param timestamp_us Capture time, converted to the 90 kHz RTP clock
+ * @param frame Receives the frame
+ * @return ESP_OK on success, ESP_ERR_NOT_SUPPORTED if the JPEG cannot be
+ *         carried (not YCbCr 4:2:2/4:2:0, non-standard Huffman tables,
+ *         16-bit quantization, larger than 2040 pixels), or the parser's
+ *         error
+ */
+esp_err_t rtp_jpeg_prepare(const uint8_t *jpeg, size_t len, jpeg_info_t *info,
+                           int64_t timestamp_us, rtp_jpeg_frame_t *frame);
+
+/**
+ * @brief Build the next packet of a frame
+ *
+ * @param session Session; its sequence number is advanced
+ * @param frame Frame from rtp_jpeg_prepare()
+ * @param header Receives the packet headers, RTP_JPEG_MAX_HEADER bytes
+ * @param header_len Receives the header length
+ * @param payload Receives the scan data following the headers
+ * @param payload_len Receives its length
+ * @return false once the whole frame has been packetized
+ */
+bool rtp_jpeg_next(rtp_jpeg_session_t *session, rtp_jpeg_frame_t *frame,
+                   uint8_t *header, size_t *header_len,
+                   const uint8_t **payload, size_t *payload_len);
+
+#endif // RTP_JPEG_H
@@ -0,0 +1,495 @@
+/**
+ * @file status_events.c
+ * @brief Server-Sent Events status channel implementation
+ */
+
+#include "net/status_events.h"
+#include "net/http_raw.h"
+#include "camera/camera_service.h"
+#include "camera/camera_params.h"
+#include "wifi/wifi.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_heap_caps.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "lwip/sockets.h"
+#include <errno.h>
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+static const char *TAG = "status_events";
+
+// Next to the other network tasks, away from the camera driver's core
+#if CONFIG_CAMERA_CORE1
+#define STATUS_EVENTS_CORE 0
+#else
+#define STATUS_EVENTS_CORE 1
+#endif
+
+#define STATUS_EVENTS_PRIORITY      3
+#define STATUS_EVENTS_STACK_SIZE    3072
+
+#ifndef STATUS_EVENTS_MSG_SIZE
+#define STATUS_EVENTS_MSG_SIZE      1024    // Fits a state or a tick of every delta
+#endif
+#define STATUS_EVENTS_RETRY_MS      2000    // EventSource reconnect delay
+
+// Health changes smaller than these are not worth an event
+#define STATUS_EVENTS_RSSI_STEP     3
+#define STATUS_EVENTS_HEAP_STEP     4096
+#define STATUS_EVENTS_PSRAM_STEP    65536
+#define STATUS_EVENTS_WATERMARK_STEP 1024
+
+/**
+ * @brief One subscriber
+ */
+typedef struct {
+    httpd_req_t *req;       // Detached (async) request
+    int sockfd;
+} events_client_t;
+
+/**
+ * @brief Everything the events describe, as last sent
+ */
+typedef struct {
+    camera_mode_t mode;
+    uint32_t stills;
+    uint32_t param_changes;
+    int params[CAMERA_PARAM_COUNT];
+    int rssi;
+    uint32_t heap, heap_min;
+    uint32_t psram, psram_min;
+} events_state_t;
+
+/**
+ * @brief Motion reports accumulated during a tick
+ */
+typedef struct {
+    uint32_t frames;        // Frames with any change
+    uint32_t changed;       // Largest change, MCUs
+    uint32_t total;         // MCUs in that frame
+} motion_t;
+
+static QueueHandle_t s_new_clients;
+static TaskHandle_t s_task;
+static atomic_int s_reserved;             // Connected plus pending subscribers
+
+// Owned by the event task
+static events_client_t s_clients[STATUS_EVENTS_MAX_CLIENTS];
+static int s_client_count;
+static events_state_t s_sent;
+static int64_t s_last_write_us;
+static char s_msg[STATUS_EVENTS_MSG_SIZE];
+static size_t s_len;
+static size_t s_event_start;                // Where the event being built begins
+static bool s_overflow;                     // It did not fit
+
+static motion_t s_motion;
+static portMUX_TYPE s_motion_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static status_events_stats_t s_stats;
+static portMUX_TYPE s_stats_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static void begin_msg(void)
+{
+    s_len = 0;
+    s_overflow = false;
+}
+
+static void append(const char *fmt, ...)
+{
+    va_list args;
+
+    if (s_overflow) {
+        return;
+    }
+    va_start(args, fmt);
+    int n = vsnprintf(s_msg + s_len, sizeof(s_msg) - s_len, fmt, args);
+    va_end(args);
+    if (n < 0 || (size_t)n >= sizeof(s_msg) - s_len) {
+        s_overflow = true;
+        return;
+    }
+    s_len += n;
+}
+
+static void begin_event(const char *name)
+{
+    s_event_start = s_len;
+    append("event: %s\ndata: {", name);
+}
+
+/**
+ * @brief Close the event, or take it back out if it did not fit
+ *
+ * Half an event would run into the next one on the subscriber's side, so
+ * the message only ever holds whole events.
+ */
+static void end_event(void)
+{
+    // Replace the trailing comma
+    if (!s_overflow && s_msg[s_len - 1] == ',') {
+        s_len--;
+    }
+    append("}\n\n");
+    if (s_overflow) {
+        ESP_LOGW(TAG, "Event dropped, %d byte message full", STATUS_EVENTS_MSG_SIZE);
+        s_len = s_event_start;
+        s_overflow = false;
+    }
+}
+
+/**
+ * @brief Append "name":value pairs for parameters that differ from since
+ *
+ * @param since Previous values, or NULL for all parameters
+ * @return Number of pairs appended
+ */
+static int append_params(const events_state_t *state, const events_state_t *since)
+{
+    int count = 0;
+
+    for (int i = 0; i < CAMERA_PARAM_COUNT; i++) {
+        if (since == NULL || state->params[i] != since->params[i]) {
+            append("\"%s\":%d,", camera_param_name(i), state->params[i]);
+            count++;
+        }
+    }
+    return count;
+}
+
+static void append_health(const events_state_t *state)
+{
+    append("\"rssi\":%d,\"heap\":%lu,\"heap_min\":%lu,\"psram\":%lu,\"psram_min\":%lu,",
+           state->rssi, (unsigned long)state->heap, (unsigned long)state->heap_min,
+           (unsigned long)state->psram, (unsigned long)state->psram_min);
+}
+
+static void read_health(events_state_t *state)
+{
+    state->rssi = wifi_get_rssi();
+    state->heap = heap_caps_get_free_size(MALLOC_CAP_INTERNAL);
+    state->heap_min = heap_caps_get_minimum_free_size(MALLOC_CAP_INTERNAL);
+    state->psram = heap_caps_get_free_size(MALLOC_CAP_SPIRAM);
+    state->psram_min = heap_caps_get_minimum_free_size(MALLOC_CAP_SPIRAM);
+}
+
+/**
+ * @brief Read the sensor parameters through the camera service
+ */
+static esp_err_t read_params(events_state_t *state)
+{
+    camera_status_t status;
+
+    esp_err_t err = camera_service_get_status(&status);
+    if (err != ESP_OK) {
+        return err;
+    }
+    for (int i = 0; i < CAMERA_PARAM_COUNT; i++) {
+        state->params[i] = camera_param_get(&status, i);
+    }
+    return ESP_OK;
+}
+
+static bool health_changed(const events_state_t *now, const events_state_t *sent)
+{
+    return abs(now->rssi - sent->rssi) >= STATUS_EVENTS_RSSI_STEP ||
+           labs((long)now->heap - (long)sent->heap) >= STATUS_EVENTS_HEAP_STEP ||
+           labs((long)now->psram - (long)sent->psram) >= STATUS_EVENTS_PSRAM_STEP ||
+           now->heap_min + STATUS_EVENTS_WATERMARK_STEP <= sent->heap_min ||
+           now->psram_min + STATUS_EVENTS_WATERMARK_STEP <= sent->psram_min;
+}
+
+/**
+ * @brief Whether the subscriber closed its end (or the socket failed)
+ */
+static bool peer_closed(int sockfd)
+{
+    char c;
+    int n = recv(sockfd, &c, 1, MSG_PEEK | MSG_DONTWAIT);
+    return n == 0 || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK);
+}
+
+/**
+ * @brief Write the message without blocking; a partial write is a failure
+ *
+ * Half an event cannot be completed later without holding every other
+ * subscriber back, so a socket that is that far behind is given up.
+ */
+static esp_err_t send_msg(int sockfd)
+{
+    int n = send(sockfd, s_msg, s_len, MSG_DONTWAIT);
+    return n == (int)s_len ? ESP_OK : ESP_FAIL;
+}
+
+/**
+ * @brief Complete a subscriber's async request and free its slot
+ */
+static void remove_client(int index)
+{
+    events_client_t *client = &s_clients[index];
+
+    httpd_sess_trigger_close(client->req->handle, client->sockfd);
+    httpd_req_async_handler_complete(client->req);
+    s_clients[index] = s_clients[--s_client_count];
+    atomic_fetch_sub(&s_reserved, 1);
+    ESP_LOGI(TAG, "Subscriber disconnected (%d remaining)", s_client_count);
+}
+
+/**
+ * @brief Build this tick's events from what changed since the last one
+ */
+static void build_deltas(void)
+{
+    camera_service_stats_t stats;
+    events_state_t now = s_sent;
+    motion_t motion;
+
+    camera_service_get_stats(&stats);
+    portENTER_CRITICAL(&s_motion_lock);
+    motion = s_motion;
+    s_motion = (motion_t){ 0 };
+    portEXIT_CRITICAL(&s_motion_lock);
+
+    begin_msg();
+
+    // The sensor is only asked once the service applied a change; a failed
+    // read leaves the counter behind so the next tick tries again
+    if (stats.param_changes != s_sent.param_changes && read_params(&now) == ESP_OK) {
+        now.param_changes = stats.param_changes;
+        size_t start = s_len;
+        begin_event("params");
+        if (append_params(&now, &s_sent) > 0) {
+            end_event();
+        } else {
+            s_len = start;
+        }
+    }
+
+    if (stats.mode != s_sent.mode) {
+        now.mode = stats.mode;
+        begin_event("mode");
+        append("\"mode\":\"%s\"", camera_mode_name(stats.mode));
+        end_event();
+    }
+
+    if (stats.stills != s_sent.stills) {
+        now.stills = stats.stills;
+        begin_event("capture");
+        append("\"captures\":%lu,\"new\":%lu,\"len\":%lu,\"still_ms\":%lu",
+               (unsigned long)stats.stills, (unsigned long)(stats.stills - s_sent.stills),
+               (unsigned long)stats.last_still_len,
+               (unsigned long)(stats.last_still_us / 1000));
+        end_event();
+    }
+
+    if (motion.frames > 0) {
+        begin_event("motion");
+        append("\"frames\":%lu,\"changed\":%lu,\"total\":%lu",
+               (unsigned long)motion.frames, (unsigned long)motion.changed,
+               (unsigned long)motion.total);
+        end_event();
+    }
+
+    read_health(&now);
+    if (health_changed(&now, &s_sent)) {
+        begin_event("health");
+        append_health(&now);
+        end_event();
+    } else {
+        // Keep what was sent as the reference so slow drifts still add up
+        now.rssi = s_sent.rssi;
+        now.heap = s_sent.heap;
+        now.heap_min = s_sent.heap_min;
+        now.psram = s_sent.psram;
+        now.psram_min = s_sent.psram_min;
+    }
+
+    s_sent = now;
+}
+
+/**
+ * @brief Send this tick's events, or a keep-alive, to every subscriber
+ */
+static void send_deltas(void)
+{
+    int64_t now = esp_timer_get_time();
+
+    build_deltas();
+    if (s_len == 0) {
+        if (now - s_last_write_us < (int64_t)STATUS_EVENTS_KEEPALIVE_MS * 1000) {
+            // Still check for closed subscribers to free their slots
+            for (int i = s_client_count - 1; i >= 0; i--) {
+                if (peer_closed(s_clients[i].sockfd)) {
+                    remove_client(i);
+                }
+            }
+            return;
+        }
+        append(":\n\n");
+    }
+
+    int i = 0;
+    while (i < s_client_count) {
+        if (peer_closed(s_clients[i].sockfd) || send_msg(s_clients[i].sockfd) != ESP_OK) {
+            remove_client(i);
+            continue;
+        }
+        i++;
+    }
+    s_last_write_us = now;
+
+    portENTER_CRITICAL(&s_stats_lock);
+    s_stats.ticks++;
+    s_stats.bytes += s_len * s_client_count;
+    portEXIT_CRITICAL(&s_stats_lock);
+}
+
+/**
+ * @brief Start a subscriber with the full state
+ */
+static void adopt_client(const events_client_t *client)
+{
+    // Without subscribers nothing was tracked; start from a fresh reading
+    if (s_client_count == 0) {
+        camera_service_stats_t stats;
+        camera_service_get_stats(&stats);
+        s_sent.mode = stats.mode;
+        s_sent.stills = stats.stills;
+        s_sent.param_changes = stats.param_changes;
+        read_params(&s_sent);
+        read_health(&s_sent);
+        s_last_write_us = esp_timer_get_time();     // The state below is a write
+        portENTER_CRITICAL(&s_motion_lock);
+        s_motion = (motion_t){ 0 };
+        portEXIT_CRITICAL(&s_motion_lock);
+    }
+    s_clients[s_client_count++] = *client;
+
+    begin_msg();
+    append("retry: %d\n", STATUS_EVENTS_RETRY_MS);
+    begin_event("state");
+    append("\"mode\":\"%s\",\"captures\":%lu,", camera_mode_name(s_sent.mode),
+           (unsigned long)s_sent.stills);
+    append_params(&s_sent, NULL);
+    append_health(&s_sent);
+    end_event();
+
+    if (http_raw_send_headers(client->req, "200 OK", "text/event-stream", -1,
+                              "Access-Control-Allow-Origin: *\r\n"
+                              "Cache-Control: no-cache\r\n") != ESP_OK ||
+        send_msg(client->sockfd) != ESP_OK) {
+        remove_client(s_client_count - 1);
+        return;
+    }
+
+    portENTER_CRITICAL(&s_stats_lock);
+    s_stats.bytes += s_len;
+    portEXIT_CRITICAL(&s_stats_lock);
+    ESP_LOGI(TAG, "Subscriber connected (%d total)", s_client_count);
+}
+
+/**
+ * @brief Event task: one pass per tick while anyone is subscribed
+ *
+ * New subscribers wake the task early, so their first state is not held
+ * back by the tick; the deltas due so far go out to the others first.
+ */
+static void event_task(void *arg)
+{
+    events_client_t client;
+
+    for (;;) {
+        ulTaskNotifyTake(pdTRUE, s_client_count > 0
+                                 ? pdMS_TO_TICKS(CONFIG_GROWPOD_STATUS_EVENTS_TICK_MS)
+                                 : portMAX_DELAY);
+
+        if (s_client_count > 0) {
+            send_deltas();
+        }
+        while (xQueueReceive(s_new_clients, &client, 0) == pdTRUE) {
+            adopt_client(&client);
+        }
+
+        portENTER_CRITICAL(&s_stats_lock);
+        s_stats.clients = s_client_count;
+        portEXIT_CRITICAL(&s_stats_lock);
+    }
+}
+
+esp_err_t status_events_init(void)
+{
+    atomic_init(&s_reserved, 0);
+
+    s_new_clients = xQueueCreate(STATUS_EVENTS_MAX_CLIENTS, sizeof(events_client_t));
+    if (s_new_clients == NULL) {
+        ESP_LOGE(TAG, "Failed to create subscriber queue");
+        return ESP_ERR_NO_MEM;
+    }
+
+    if (xTaskCreatePinnedToCore(event_task, "status_events", STATUS_EVENTS_STACK_SIZE, NULL,
+                                STATUS_EVENTS_PRIORITY, &s_task, STATUS_EVENTS_CORE) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create event task");
+        return ESP_ERR_NO_MEM;
+    }
+
+    ESP_LOGI(TAG, "Status events ready (tick %d ms, core %d)",
+             CONFIG_GROWPOD_STATUS_EVENTS_TICK_MS, STATUS_EVENTS_CORE);
+    return ESP_OK;
+}
+
+esp_err_t status_events_add_client(httpd_req_t *req)
+{
+    if (atomic_fetch_add(&s_reserved, 1) >= STATUS_EVENTS_MAX_CLIENTS) {
+        atomic_fetch_sub(&s_reserved, 1);
+        ESP_LOGW(TAG, "Rejecting subscriber, %d already connected", STATUS_EVENTS_MAX_CLIENTS);
+        return ESP_ERR_NO_MEM;
+    }
+
+    // Detach the request so the httpd task can return immediately
+    httpd_req_t *async_req = NULL;
+    esp_err_t err = httpd_req_async_handler_begin(req, &async_req);
+    if (err != ESP_OK) {
+        atomic_fetch_sub(&s_reserved, 1);
+        ESP_LOGE(TAG, "Failed to detach events request: %s", esp_err_to_name(err));
+        return err;
+    }
+
+    events_client_t client = {
+        .req = async_req,
+        .sockfd = httpd_req_to_sockfd(async_req),
+    };
+
+    // Cannot fail: the queue holds STATUS_EVENTS_MAX_CLIENTS and slots are reserved above
+    xQueueSend(s_new_clients, &client, 0);
+    xTaskNotifyGive(s_task);
+    return ESP_OK;
+}
+
+void status_events_post_motion(uint32_t changed_mcus, uint32_t total_mcus)
+{
+    if (changed_mcus == 0 || total_mcus == 0) {
+        return;
+    }
+
+    portENTER_CRITICAL(&s_motion_lock);
+    s_motion.frames++;
+    // Compare fractions; the frame geometry can change within a tick
+    if ((uint64_t)changed_mcus * (s_motion.total ? s_motion.total : 1) >=
+        (uint64_t)s_motion.changed * total_mcus) {
+        s_motion.changed = changed_mcus;
+        s_motion.total = total_mcus;
+    }
+    portEXIT_CRITICAL(&s_motion_lock);
+}
+
+void status_events_get_stats(status_events_stats_t *stats)
+{
+    portENTER_CRITICAL(&s_stats_lock);
+    *stats = s_stats;
+    portEXIT_CRITICAL(&s_stats_lock);
+}
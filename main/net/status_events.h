@@ -0,0 +1,93 @@
+/**
+ * @file status_events.h
+ * @brief Live status as Server-Sent Events (GET /events)
+ *
+ * Replaces polling /status for the settings page and dashboards. One task
+ * pinned to the network core owns every subscriber socket. It samples the
+ * camera service statistics, heap and RSSI once per tick while anyone is
+ * subscribed, and sends what changed since the last tick to all of them
+ * in a single write each. Nothing is built or sent for state that did not
+ * change, and nothing runs at all without subscribers.
+ *
+ * A new subscriber gets a "state" event with everything, then only
+ * deltas. All data lines are JSON objects:
+ *
+ * - state    mode, every /control parameter, captures, health fields
+ * - params   changed /control parameters, e.g. {"aec_value":400}
+ * - mode     {"mode":"stream"} when the camera mode changed
+ * - capture  {"captures":N,"new":n,"len":bytes,"still_ms":t} for the last
+ *            of the n stills taken during the tick
+ * - motion   {"frames":n,"changed":c,"total":t} for the frame with most
+ *            changed MCUs; only measured while a /stream?cr=1 client
+ *            runs, since that is where changed regions are detected
+ * - health   {"rssi":dBm,"heap":..,"heap_min":..,"psram":..,"psram_min":..}
+ *            when RSSI or free memory moved by more than a step, or a
+ *            minimum-free watermark fell
+ *
+ * Parameters are re-read from the sensor only after the service counted a
+ * successful change. Idle connections get a comment line every
+ * STATUS_EVENTS_KEEPALIVE_MS. A subscriber whose socket cannot take a
+ * tick's events at once is dropped; EventSource reconnects on its own and
+ * starts again from a fresh "state".
+ */
+
+#ifndef STATUS_EVENTS_H
+#define STATUS_EVENTS_H
+
+#include <stdint.h>
+#include "esp_err.h"
+#include "esp_http_server.h"
+
+// Maximum number of simultaneous subscribers
+#define STATUS_EVENTS_MAX_CLIENTS   3
+
+#define STATUS_EVENTS_KEEPALIVE_MS  15000
+
+/**
+ * @brief Subscriber statistics
+ */
+typedef struct {
+    uint32_t clients;           // Connected subscribers
+    uint32_t ticks;             // Ticks that had something to send
+    uint32_t bytes;             // Event bytes written since boot
+} status_events_stats_t;
+
+/**
+ * @brief Start the event task
+ *
+ * Must be called after camera_service_init() and once the network is up.
+ *
+ * @return ESP_OK on success, error code otherwise
+ */
+esp_err_t status_events_init(void);
+
+/**
+ * @brief Hand a request over to the event task
+ *
+ * Detaches the request from the httpd task; the caller must return from
+ * its handler immediately afterwards without touching the request.
+ *
+ * @param req HTTP request from the handler
+ * @return ESP_OK if the subscriber was queued, ESP_ERR_NO_MEM if all slots
+ *         are taken
+ */
+esp_err_t status_events_add_client(httpd_req_t *req);
+
+/**
+ * @brief Report the change detected in a stream frame
+ *
+ * Cheap and safe from any task; the largest change of a tick is sent.
+ *
+ * @param changed_mcus MCUs over the change threshold
+ * @param total_mcus MCUs in the frame
+ */
+void status_events_post_motion(uint32_t changed_mcus, uint32_t total_mcus);
+
+/**
+ * @brief Get a snapshot of the subscriber statistics
+ *
+ * @param stats Pointer to structure to populate
+ */
+void status_events_get_stats(status_events_stats_t *stats);
+
+#endif // STATUS_EVENTS_H
@@ -0,0 +1,702 @@
+/**
+ * @file udp_still.c
+ * @brief UDP still transfer implementation
+ */
+
+#include "net/udp_still.h"
+#include "net/fec_rs.h"
+#include "camera/camera_service.h"
+#include "camera/capture_store.h"
+#if CONFIG_GROWPOD_ADMISSION
+#include "net/admission.h"
+#endif
+#include "esp_log.h"
+#include "esp_random.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "lwip/sockets.h"
+#include "mbedtls/md.h"
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char *TAG = "udp_still";
+
+// Transfers run next to the stream network task, away from the camera driver
+#if CONFIG_CAMERA_CORE1
+#define UDP_STILL_CORE 0
+#else
+#define UDP_STILL_CORE 1
+#endif
+
+#define UDP_STILL_PRIORITY      4
+#define UDP_STILL_STACK_SIZE    4096
+
+#define UDP_STILL_END_MIN_US    30000   // END repeat interval: 2 RTT within these bounds
+#define UDP_STILL_END_MAX_US    300000
+#define UDP_STILL_SILENCE_US    2000000 // No feedback for this long aborts the transfer
+#define UDP_STILL_TIMEOUT_US    15000000
+#define UDP_STILL_MIN_KBPS      500
+#define UDP_STILL_MAX_KBPS      40000
+#define UDP_STILL_QUEUE_MS      10      // Delay growth that means the rate overran the link
+#define UDP_STILL_HEAVY_LOSS    0.25f   // Loss that lowers the rate even without queueing
+#define UDP_STILL_SEND_RETRIES  5       // Ticks to wait for TX buffers per datagram
+#define UDP_STILL_COOKIE_US     30000000 // Cookie epoch; a cookie is good for one to two
+
+#define HEADER_SIZE             8
+#define DATA_HEADER_SIZE        (HEADER_SIZE + 12)
+#define REQ_SIZE                (HEADER_SIZE + 6 + UDP_STILL_COOKIE_SIZE)
+#define MAX_DATAGRAM            (DATA_HEADER_SIZE + UDP_STILL_BLOCK_SIZE)
+
+/**
+ * @brief One transfer in progress
+ */
+typedef struct {
+    int sock;
+    struct sockaddr_in peer;
+    uint32_t id;
+    const uint8_t *data;
+    size_t len;
+    int blocks;                 // Data blocks
+    int groups;
+    uint16_t *next_row;         // Next parity row per group
+    uint8_t *needed;            // Blocks each group still needs (from the last NACK)
+
+    uint32_t rate_kbps;
+    int64_t next_send_us;       // Pacing: earliest time for the next datagram
+    uint32_t pass;
+    uint32_t sent_pass;         // Datagrams sent in the current pass
+    uint32_t sent_total;
+    bool done;
+
+    // Receiver's report on the last pass (NACK or DONE)
+    uint32_t fb_received;       // DATA datagrams it got
+    uint32_t fb_rx_kbps;        // Their arrival rate, 0 if too few to tell
+    uint32_t fb_queue_ms;       // Growth of their one-way delay over the pass
+} transfer_t;
+
+static int s_sock = -1;
+static uint8_t s_rx[MAX_DATAGRAM];
+static uint8_t s_parity[UDP_STILL_BLOCK_SIZE];
+static uint8_t s_pad[UDP_STILL_BLOCK_SIZE];    // Zero-padded last data block
+static uint8_t s_cookie_key[16];                // Random per boot
+
+// Link estimates carried from one transfer to the next, server task only
+static uint32_t s_rate_kbps = UDP_STILL_DEFAULT_KBPS;
+static int64_t s_rtt_us = UDP_STILL_END_MAX_US / 2;    // END to feedback, smoothed
+
+static udp_still_stats_t s_stats;
+static portMUX_TYPE s_stats_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static void put_u16(uint8_t *p, uint16_t v)
+{
+    p[0] = v >> 8;
+    p[1] = v;
+}
+
+static void put_u32(uint8_t *p, uint32_t v)
+{
+    p[0] = v >> 24;
+    p[1] = v >> 16;
+    p[2] = v >> 8;
+    p[3] = v;
+}
+
+static uint16_t get_u16(const uint8_t *p)
+{
+    return (p[0] << 8) | p[1];
+}
+
+static uint32_t get_u32(const uint8_t *p)
+{
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | (p[2] << 8) | p[3];
+}
+
+static void put_header(uint8_t *p, uint8_t type, uint32_t id)
+{
+    p[0] = 'G';
+    p[1] = 'P';
+    p[2] = type;
+    p[3] = 0;
+    put_u32(p + 4, id);
+}
+
+/**
+ * @brief Send a datagram, waiting briefly for TX buffers
+ */
+static bool send_datagram(int sock, const struct sockaddr_in *peer, struct iovec *iov, int iovcnt)
+{
+    struct msghdr msg = {
+        .msg_name = (void *)peer,
+        .msg_namelen = sizeof(*peer),
+        .msg_iov = iov,
+        .msg_iovlen = iovcnt,
+    };
+
+    for (int attempt = 0; attempt <= UDP_STILL_SEND_RETRIES; attempt++) {
+        if (sendmsg(sock, &msg, 0) >= 0) {
+            return true;
+        }
+        if (errno != ENOMEM && errno != ENOBUFS && errno != EAGAIN) {
+            break;
+        }
+        vTaskDelay(1);
+    }
+    return false;
+}
+
+static void send_error(int sock, const struct sockaddr_in *peer, uint32_t id, uint8_t code)
+{
+    uint8_t msg[HEADER_SIZE + 1];
+
+    put_header(msg, UDP_STILL_ERR, id);
+    msg[HEADER_SIZE] = code;
+    struct iovec iov = { .iov_base = msg, .iov_len = sizeof(msg) };
+    send_datagram(sock, peer, &iov, 1);
+}
+
+/**
+ * @brief Wait until the pacing rate allows the next datagram
+ *
+ * Datagrams within one tick go out back to back; the task sleeps once it
+ * is a tick or more ahead of the rate.
+ */
+static void pace(transfer_t *t, size_t bytes)
+{
+    int64_t now = esp_timer_get_time();
+    const int64_t tick_us = portTICK_PERIOD_MS * 1000;
+
+    if (t->next_send_us < now) {
+        t->next_send_us = now;              // No credit for idle time
+    }
+    int64_t ahead = t->next_send_us - now;
+    if (ahead >= tick_us) {
+        vTaskDelay(ahead / tick_us);
+    }
+    t->next_send_us += (int64_t)bytes * 8 * 1000 / t->rate_kbps;
+}
+
+/**
+ * @brief Data blocks in a group
+ */
+static int group_k(const transfer_t *t, int group)
+{
+    int first = group * UDP_STILL_GROUP_BLOCKS;
+    int k = t->blocks - first;
+
+    return k < UDP_STILL_GROUP_BLOCKS ? k : UDP_STILL_GROUP_BLOCKS;
+}
+
+/**
+ * @brief Send one block of a group: data if index < k, else parity
+ */
+static bool send_block(transfer_t *t, int group, int index)
+{
+    int k = group_k(t, group);
+    int first = group * UDP_STILL_GROUP_BLOCKS;
+    uint8_t header[DATA_HEADER_SIZE];
+    struct iovec iov[2];
+
+    put_header(header, UDP_STILL_DATA, t->id);
+    put_u32(header + HEADER_SIZE, t->len);
+    put_u16(header + HEADER_SIZE + 4, group);
+    header[HEADER_SIZE + 6] = index;
+    header[HEADER_SIZE + 7] = k;
+
+    if (index < k) {
+        size_t offset = (size_t)(first + index) * UDP_STILL_BLOCK_SIZE;
+        size_t len = t->len - offset;
+        iov[1].iov_base = (void *)(t->data + offset);
+        iov[1].iov_len = len < UDP_STILL_BLOCK_SIZE ? len : UDP_STILL_BLOCK_SIZE;
+    } else {
+        const uint8_t *blocks[UDP_STILL_GROUP_BLOCKS];
+        for (int i = 0; i < k; i++) {
+            size_t offset = (size_t)(first + i) * UDP_STILL_BLOCK_SIZE;
+            if (t->len - offset < UDP_STILL_BLOCK_SIZE) {
+                memset(s_pad, 0, sizeof(s_pad));
+                memcpy(s_pad, t->data + offset, t->len - offset);
+                blocks[i] = s_pad;
+            } else {
+                blocks[i] = t->data + offset;
+            }
+        }
+        fec_rs_parity(blocks, k, UDP_STILL_BLOCK_SIZE, index - k, s_parity);
+        iov[1].iov_base = s_parity;
+        iov[1].iov_len = UDP_STILL_BLOCK_SIZE;
+    }
+    iov[0].iov_base = header;
+    iov[0].iov_len = DATA_HEADER_SIZE;
+
+    pace(t, DATA_HEADER_SIZE + iov[1].iov_len);
+    put_u32(header + HEADER_SIZE + 8, (uint32_t)esp_timer_get_time());
+    if (!send_datagram(t->sock, &t->peer, iov, 2)) {
+        ESP_LOGW(TAG, "sendmsg failed (errno %d)", errno);
+        return false;
+    }
+    t->sent_pass++;
+    t->sent_total++;
+    return true;
+}
+
+/**
+ * @brief Send count more blocks of a group, fresh parity first
+ *
+ * Once the parity rows run out (256 - k of them), data blocks are
+ * repeated instead.
+ */
+static bool send_more(transfer_t *t, int group, int count)
+{
+    int k = group_k(t, group);
+
+    for (int n = 0; n < count; n++) {
+        int row = t->next_row[group]++;
+        int index = (k + row < FEC_RS_MAX_BLOCKS) ? k + row : row % k;
+        if (!send_block(t, group, index)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Read the receiver's report that follows the pass number
+ */
+static void parse_report(transfer_t *t, const uint8_t *p)
+{
+    t->fb_received = get_u32(p);
+    t->fb_rx_kbps = get_u32(p + 4);
+    t->fb_queue_ms = get_u16(p + 8);
+}
+
+/**
+ * @brief Handle feedback for this transfer, waiting up to timeout_us
+ *
+ * @return true if a DONE or a NACK for the current pass arrived
+ */
+static bool poll_feedback(transfer_t *t, int64_t timeout_us)
+{
+    int64_t deadline = esp_timer_get_time() + timeout_us;
+
+    while (true) {
+        int64_t remaining = deadline - esp_timer_get_time();
+        if (remaining < 0) {
+            remaining = 0;
+        }
+        struct timeval tv = { .tv_sec = remaining / 1000000, .tv_usec = remaining % 1000000 };
+        fd_set fds;
+        FD_ZERO(&fds);
+        FD_SET(t->sock, &fds);
+        if (select(t->sock + 1, &fds, NULL, NULL, &tv) <= 0) {
+            return false;
+        }
+
+        struct sockaddr_in from;
+        socklen_t from_len = sizeof(from);
+        int n = recvfrom(t->sock, s_rx, sizeof(s_rx), 0, (struct sockaddr *)&from, &from_len);
+        if (n < HEADER_SIZE || s_rx[0] != 'G' || s_rx[1] != 'P') {
+            continue;
+        }
+        uint8_t type = s_rx[2];
+        uint32_t id = get_u32(s_rx + 4);
+        bool ours = from.sin_addr.s_addr == t->peer.sin_addr.s_addr &&
+                    from.sin_port == t->peer.sin_port && id == t->id;
+        if (!ours) {
+            if (type == UDP_STILL_REQ && n >= REQ_SIZE) {
+                send_error(t->sock, &from, id, UDP_STILL_ERR_BUSY);
+            }
+            continue;
+        }
+
+        if (type == UDP_STILL_DONE) {
+            t->done = true;
+            if (n >= HEADER_SIZE + 14 && get_u32(s_rx + HEADER_SIZE) == t->pass) {
+                parse_report(t, s_rx + HEADER_SIZE + 4);
+            } else {
+                t->fb_rx_kbps = 0;
+            }
+            return true;
+        }
+        if (type != UDP_STILL_NACK || n < HEADER_SIZE + 16 ||
+            get_u32(s_rx + HEADER_SIZE) != t->pass) {
+            continue;                       // Duplicate REQ, stale NACK
+        }
+
+        parse_report(t, s_rx + HEADER_SIZE + 4);
+        int count = get_u16(s_rx + HEADER_SIZE + 14);
+        const uint8_t *entry = s_rx + HEADER_SIZE + 16;
+        memset(t->needed, 0, t->groups);
+        for (int i = 0; i < count && entry + 3 <= s_rx + n; i++, entry += 3) {
+            int group = get_u16(entry);
+            if (group < t->groups) {
+                t->needed[group] = entry[2];
+            }
+        }
+        return true;
+    }
+}
+
+/**
+ * @brief Adjust the pacing rate to the receiver's report on a pass
+ *
+ * Loss alone cannot tell a congested link from a noisy one, and FEC
+ * covers noise. So the rate drops when the datagrams queued up on the
+ * way, their one-way delay growing over the pass, and then to the rate
+ * they arrived at: what the bottleneck delivers. Otherwise it grows by a
+ * quarter, unless loss is heavy.
+ */
+static void adapt_rate(transfer_t *t, float loss)
+{
+    uint32_t rate = t->rate_kbps;
+
+    if (t->fb_rx_kbps == 0) {
+        return;                             // Repair pass too short to measure
+    }
+    if (t->fb_queue_ms >= UDP_STILL_QUEUE_MS) {
+        if (t->fb_rx_kbps < rate) {
+            rate = t->fb_rx_kbps;
+        }
+    } else if (loss > UDP_STILL_HEAVY_LOSS) {
+        rate = rate * 3 / 4;
+    } else {
+        rate = rate * 5 / 4;
+    }
+    if (rate < UDP_STILL_MIN_KBPS) {
+        rate = UDP_STILL_MIN_KBPS;
+    } else if (rate > UDP_STILL_MAX_KBPS) {
+        rate = UDP_STILL_MAX_KBPS;
+    }
+    t->rate_kbps = rate;
+}
+
+/**
+ * @brief Send END until the receiver answers the pass
+ *
+ * END is repeated every two round trips; the round trip is measured on
+ * every answer, so a lost END costs little on a fast link.
+ *
+ * @return true if a DONE or a NACK arrived
+ */
+static bool end_pass(transfer_t *t)
+{
+    uint8_t end[HEADER_SIZE + 8];
+    int64_t start = esp_timer_get_time();
+
+    put_header(end, UDP_STILL_END, t->id);
+    put_u32(end + HEADER_SIZE, t->pass);
+    put_u32(end + HEADER_SIZE + 4, t->sent_pass);
+    while (esp_timer_get_time() - start < UDP_STILL_SILENCE_US) {
+        int64_t sent = esp_timer_get_time();
+        struct iovec iov = { .iov_base = end, .iov_len = sizeof(end) };
+        send_datagram(t->sock, &t->peer, &iov, 1);
+
+        int64_t interval = 2 * s_rtt_us;
+        if (interval < UDP_STILL_END_MIN_US) {
+            interval = UDP_STILL_END_MIN_US;
+        } else if (interval > UDP_STILL_END_MAX_US) {
+            interval = UDP_STILL_END_MAX_US;
+        }
+        if (poll_feedback(t, interval)) {
+            // Answers to a repeated END may come from the first one; the
+            // estimate then errs short, and the next END comes early
+            s_rtt_us = (7 * s_rtt_us + (esp_timer_get_time() - sent)) / 8;
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Run passes until the receiver reports the image complete
+ */
+static esp_err_t run_transfer(transfer_t *t, int fec_percent)
+{
+    int64_t start = esp_timer_get_time();
+    float loss = 0;
+
+    for (t->pass = 0; !t->done; t->pass++) {
+        t->sent_pass = 0;
+        for (int g = 0; g < t->groups && !t->done; g++) {
+            int k = group_k(t, g);
+            int count;
+            if (t->pass == 0) {
+                for (int i = 0; i < k; i++) {
+                    if (!send_block(t, g, i)) {
+                        return ESP_FAIL;
+                    }
+                }
+                count = (k * fec_percent + 99) / 100;
+            } else if (t->needed[g]) {
+                // Cover the expected loss of the repair itself, plus one
+                count = (int)(t->needed[g] / (1.0f - loss)) + 1;
+            } else {
+                continue;
+            }
+            if (!send_more(t, g, count)) {
+                return ESP_FAIL;
+            }
+            // The receiver may finish before all parity is out
+            poll_feedback(t, 0);
+        }
+
+        if (!t->done && !end_pass(t)) {
+            ESP_LOGW(TAG, "Transfer %08lx: no feedback after pass %lu", (unsigned long)t->id,
+                     (unsigned long)t->pass);
+            return ESP_ERR_TIMEOUT;
+        }
+        if (t->done) {
+            adapt_rate(t, 0);
+            break;
+        }
+        if (esp_timer_get_time() - start > UDP_STILL_TIMEOUT_US) {
+            send_error(t->sock, &t->peer, t->id, UDP_STILL_ERR_TIMEOUT);
+            return ESP_ERR_TIMEOUT;
+        }
+
+        loss = t->sent_pass ? 1.0f - (float)t->fb_received / t->sent_pass : 0;
+        if (loss < 0) {
+            loss = 0;
+        } else if (loss > 0.9f) {
+            loss = 0.9f;
+        }
+        adapt_rate(t, loss);
+        ESP_LOGD(TAG, "Pass %lu: %lu sent, %.0f%% lost, arrived at %lu kbit/s, queued %lu ms, "
+                 "rate now %lu kbit/s", (unsigned long)t->pass, (unsigned long)t->sent_pass,
+                 loss * 100, (unsigned long)t->fb_rx_kbps, (unsigned long)t->fb_queue_ms,
+                 (unsigned long)t->rate_kbps);
+    }
+    return ESP_OK;
+}
+
+/**
+ * @brief Cookie for a client address and transfer id in a key epoch
+ *
+ * HMAC-SHA256 under the boot key, truncated: only whoever receives the
+ * camera's datagrams at that address can know it, and nothing is stored.
+ */
+static void make_cookie(const struct sockaddr_in *peer, uint32_t id, uint32_t epoch,
+                        uint8_t *cookie)
+{
+    uint8_t input[14];
+    uint8_t mac[32];
+
+    memcpy(input, &peer->sin_addr.s_addr, 4);
+    memcpy(input + 4, &peer->sin_port, 2);
+    put_u32(input + 6, id);
+    put_u32(input + 10, epoch);
+    mbedtls_md_hmac(mbedtls_md_info_from_type(MBEDTLS_MD_SHA256), s_cookie_key,
+                    sizeof(s_cookie_key), input, sizeof(input), mac);
+    memcpy(cookie, mac, UDP_STILL_COOKIE_SIZE);
+}
+
+/**
+ * @brief Whether a REQ carries the cookie of this or the previous epoch
+ */
+static bool cookie_valid(const struct sockaddr_in *peer, uint32_t id, const uint8_t *cookie)
+{
+    uint32_t epoch = esp_timer_get_time() / UDP_STILL_COOKIE_US;
+    uint8_t want[UDP_STILL_COOKIE_SIZE];
+
+    for (int e = 0; e < 2; e++) {
+        make_cookie(peer, id, epoch - e, want);
+        uint8_t diff = 0;
+        for (int i = 0; i < UDP_STILL_COOKIE_SIZE; i++) {
+            diff |= want[i] ^ cookie[i];
+        }
+        if (diff == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void send_cookie(const struct sockaddr_in *peer, uint32_t id)
+{
+    uint8_t msg[HEADER_SIZE + UDP_STILL_COOKIE_SIZE];
+
+    put_header(msg, UDP_STILL_COOKIE, id);
+    make_cookie(peer, id, esp_timer_get_time() / UDP_STILL_COOKIE_US, msg + HEADER_SIZE);
+    struct iovec iov = { .iov_base = msg, .iov_len = sizeof(msg) };
+    send_datagram(s_sock, peer, &iov, 1);
+}
+
+/**
+ * @brief Serve one REQ: capture, transfer, log
+ */
+static void handle_request(const struct sockaddr_in *peer, uint32_t id, const uint8_t *req, int len)
+{
+    uint32_t rate = s_rate_kbps;
+    int fec_percent = UDP_STILL_DEFAULT_FEC;
+    bool last = false;
+
+    if (len >= HEADER_SIZE + 5) {
+        if (get_u32(req + HEADER_SIZE)) {
+            rate = get_u32(req + HEADER_SIZE);
+        }
+        fec_percent = req[HEADER_SIZE + 4] > 100 ? 100 : req[HEADER_SIZE + 4];
+    }
+    if (len >= HEADER_SIZE + 6) {
+        last = req[HEADER_SIZE + 5] & 1;
+    }
+
+    int64_t start = esp_timer_get_time();
+    capture_snapshot_t *snap = last ? capture_store_get() : NULL;
+    if (snap == NULL) {
+        // Send from the PSRAM copy so the frame goes back to the driver at once
+        camera_fb_t *fb = camera_service_capture();
+        if (fb) {
+            esp_err_t err = capture_store_put(fb);
+            camera_service_release(fb);
+            if (err == ESP_OK) {
+                snap = capture_store_get();
+            }
+        }
+    }
+    if (snap == NULL) {
+        send_error(s_sock, peer, id, UDP_STILL_ERR_CAPTURE);
+        portENTER_CRITICAL(&s_stats_lock);
+        s_stats.failures++;
+        portEXIT_CRITICAL(&s_stats_lock);
+        return;
+    }
+    int64_t capture_time = esp_timer_get_time();
+
+    transfer_t t = {
+        .sock = s_sock,
+        .peer = *peer,
+        .id = id,
+        .data = snap->data,
+        .len = snap->len,
+        .blocks = (snap->len + UDP_STILL_BLOCK_SIZE - 1) / UDP_STILL_BLOCK_SIZE,
+        .rate_kbps = rate < UDP_STILL_MIN_KBPS ? UDP_STILL_MIN_KBPS :
+                     rate > UDP_STILL_MAX_KBPS ? UDP_STILL_MAX_KBPS : rate,
+    };
+    t.groups = (t.blocks + UDP_STILL_GROUP_BLOCKS - 1) / UDP_STILL_GROUP_BLOCKS;
+    t.next_row = calloc(t.groups, sizeof(uint16_t));
+    t.needed = calloc(t.groups, 1);
+    esp_err_t err = (t.next_row && t.needed) ? run_transfer(&t, fec_percent) : ESP_ERR_NO_MEM;
+    free(t.next_row);
+    free(t.needed);
+    capture_store_release(snap);
+
+    // The next transfer starts where this one ended
+    if (err == ESP_OK) {
+        s_rate_kbps = t.rate_kbps;
+    }
+
+    int64_t end = esp_timer_get_time();
+    uint32_t ms = (end - capture_time) / 1000;
+    portENTER_CRITICAL(&s_stats_lock);
+    if (err == ESP_OK) {
+        s_stats.transfers++;
+        s_stats.last_len = t.len;
+        s_stats.last_ms = ms;
+        s_stats.last_passes = t.pass + 1;
+        s_stats.last_datagrams = t.sent_total;
+        s_stats.last_kbps = t.rate_kbps;
+    } else {
+        s_stats.failures++;
+    }
+    portEXIT_CRITICAL(&s_stats_lock);
+
+    if (err == ESP_OK) {
+        ESP_LOGI(TAG, "Sent %u bytes in %lu ms (capture %lu ms): %lu datagrams for %d blocks, "
+                 "%lu pass(es), rate %lu kbit/s", (unsigned)t.len, (unsigned long)ms,
+                 (unsigned long)((capture_time - start) / 1000),
+                 (unsigned long)t.sent_total, t.blocks, (unsigned long)(t.pass + 1),
+                 (unsigned long)t.rate_kbps);
+    } else {
+        ESP_LOGW(TAG, "Transfer failed: %s", esp_err_to_name(err));
+    }
+}
+
+/**
+ * @brief Server task - serves one REQ at a time
+ */
+static void server_task(void *arg)
+{
+    struct sockaddr_in last_peer = { 0 };
+    uint32_t last_id = 0;
+
+    while (true) {
+        struct sockaddr_in from;
+        socklen_t from_len = sizeof(from);
+        int n = recvfrom(s_sock, s_rx, sizeof(s_rx), 0, (struct sockaddr *)&from, &from_len);
+        if (n < REQ_SIZE || s_rx[0] != 'G' || s_rx[1] != 'P' || s_rx[2] != UDP_STILL_REQ) {
+            continue;                       // Late DONE/NACK of a finished transfer
+        }
+
+        // Prove the source address before capturing anything for it; the
+        // cookie answer is shorter than the REQ, so it amplifies nothing
+        uint32_t id = get_u32(s_rx + 4);
+        if (!cookie_valid(&from, id, s_rx + HEADER_SIZE + 6)) {
+            send_cookie(&from, id);
+            continue;
+        }
+
+        // Clients repeat REQ until data arrives; those queued during a
+        // transfer must not start another one
+        if (id == last_id && from.sin_addr.s_addr == last_peer.sin_addr.s_addr &&
+            from.sin_port == last_peer.sin_port) {
+            continue;
+        }
+#if CONFIG_GROWPOD_ADMISSION
+        // A transfer is a capture like GET /capture; a refused REQ takes no
+        // token, so the client's repeats are not charged either
+        uint32_t retry_after_s;
+        if (admission_check(ADMIT_CAPTURE, from.sin_addr.s_addr, esp_timer_get_time(),
+                            &retry_after_s) != ADMIT_OK) {
+            ESP_LOGW(TAG, "REQ rejected by admission, retry after %lu s",
+                     (unsigned long)retry_after_s);
+            send_error(s_sock, &from, id, UDP_STILL_ERR_LIMITED);
+            continue;
+        }
+#endif
+        last_peer = from;
+        last_id = id;
+
+        // s_rx is reused for feedback during the transfer
+        uint8_t req[REQ_SIZE];
+        memcpy(req, s_rx, sizeof(req));
+        handle_request(&from, id, req, sizeof(req));
+    }
+}
+
+esp_err_t udp_still_init(void)
+{
+    fec_rs_init();
+    esp_fill_random(s_cookie_key, sizeof(s_cookie_key));
+
+    s_sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_IP);
+    if (s_sock < 0) {
+        ESP_LOGE(TAG, "Failed to create socket (errno %d)", errno);
+        return ESP_FAIL;
+    }
+    struct sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_port = htons(UDP_STILL_PORT),
+        .sin_addr.s_addr = htonl(INADDR_ANY),
+    };
+    if (bind(s_sock, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        ESP_LOGE(TAG, "Failed to bind port %d (errno %d)", UDP_STILL_PORT, errno);
+        close(s_sock);
+        s_sock = -1;
+        return ESP_FAIL;
+    }
+
+    if (xTaskCreatePinnedToCore(server_task, "udp_still", UDP_STILL_STACK_SIZE, NULL,
+                                UDP_STILL_PRIORITY, NULL, UDP_STILL_CORE) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create UDP still task");
+        return ESP_ERR_NO_MEM;
+    }
+
+    ESP_LOGI(TAG, "UDP still server on port %d", UDP_STILL_PORT);
+    return ESP_OK;
+}
+
+void udp_still_get_stats(udp_still_stats_t *stats)
+{
+    portENTER_CRITICAL(&s_stats_lock);
+    *stats = s_stats;
+    portEXIT_CRITICAL(&s_stats_lock);
+}
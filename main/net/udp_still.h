@@ -0,0 +1,110 @@
+/**
+ * @file udp_still.h
+ * @brief Still transfer over UDP with Reed-Solomon FEC and selective NACK
+ *
+ * An alternative to GET /capture for lossy links, where TCP stalls on
+ * retransmission timeouts and collapses its window. The JPEG is cut into
+ * blocks, the blocks into groups of up to UDP_STILL_GROUP_BLOCKS, and
+ * every group is sent with a few parity blocks (see fec_rs.h) so typical
+ * losses are repaired without a round trip. Whatever is still missing
+ * after a pass is requested per group, and answered with fresh parity
+ * blocks: any k blocks of a group do, so the receiver never has to name
+ * the lost ones. Sending is paced; the receiver reports how fast each
+ * pass arrived and how much its one-way delay grew, and the rate drops to
+ * the arrival rate only when that growth shows a queue building, since
+ * FEC already covers random loss. Each transfer starts at the rate the
+ * previous one ended with.
+ *
+ * Protocol (UDP port UDP_STILL_PORT, all fields big-endian). Every
+ * datagram starts with 'G' 'P', type, flags, u32 transfer id:
+ *
+ * - REQ   client → camera: u32 rate_kbps (0 = current estimate), u8 fec_percent,
+ *         u8 options (bit 0 = send the last capture instead of a new one),
+ *         u8[8] cookie (zeros until the camera has sent one)
+ * - COOKIE camera → client: u8[8] cookie; the answer to a REQ without a
+ *         valid cookie. The client repeats its REQ with it; nothing is
+ *         captured or sent before that, so a spoofed source address gets
+ *         no more than one datagram smaller than the REQ
+ * - DATA  camera → client: u32 total_len, u16 group, u8 index (0..k-1
+ *         data, k.. parity), u8 k, u32 send time (µs, camera clock), then
+ *         UDP_STILL_BLOCK_SIZE bytes (the last data block is shorter; pad
+ *         it with zeros for decoding)
+ * - END   camera → client: u32 pass, u32 datagrams sent in the pass;
+ *         repeated until feedback arrives
+ * - NACK  client → camera: u32 pass, report, u16 count, count × (u16 group,
+ *         u8 blocks still needed)
+ * - DONE  client → camera: u32 pass, report; sent as soon as the image
+ *         decodes, and again for every END that follows
+ * - ERR   camera → client: u8 code (UDP_STILL_ERR_*)
+ *
+ * A REQ that would start a transfer counts against the same capture
+ * admission limit as GET /capture (see admission.h); over it, the answer
+ * is ERR LIMITED.
+ *
+ * A report is u32 DATA datagrams received in the pass, u32 their arrival
+ * rate in kbit/s (0 if too few to tell), u16 growth of their one-way delay
+ * in ms (send time to arrival, minimum of the last few minus minimum of
+ * the first few).
+ *
+ * A receiver is implemented in capture_wifi.py (--udp).
+ */
+
+#ifndef UDP_STILL_H
+#define UDP_STILL_H
+
+#include <stdint.h>
+#include "esp_err.h"
+
+#define UDP_STILL_PORT          5006
+#define UDP_STILL_BLOCK_SIZE    1200    // Payload bytes per DATA datagram
+#define UDP_STILL_GROUP_BLOCKS  32      // Data blocks per FEC group
+#define UDP_STILL_COOKIE_SIZE   8
+
+#define UDP_STILL_DEFAULT_KBPS  8000    // Rate estimate before the first transfer
+#define UDP_STILL_DEFAULT_FEC   10      // Parity blocks, percent of data blocks
+
+// Datagram types
+#define UDP_STILL_REQ   1
+#define UDP_STILL_DATA  2
+#define UDP_STILL_END   3
+#define UDP_STILL_NACK  4
+#define UDP_STILL_DONE  5
+#define UDP_STILL_ERR   6
+#define UDP_STILL_COOKIE 7
+
+// ERR codes
+#define UDP_STILL_ERR_BUSY      1
+#define UDP_STILL_ERR_CAPTURE   2
+#define UDP_STILL_ERR_TIMEOUT   3
+#define UDP_STILL_ERR_LIMITED   4       // Over the capture admission limit
+
+/**
+ * @brief Transfer statistics
+ */
+typedef struct {
+    uint32_t transfers;         // Completed since boot
+    uint32_t failures;          // Aborted (capture failure, timeout)
+    uint32_t last_len;          // JPEG bytes of the last transfer
+    uint32_t last_ms;           // Duration of the last transfer
+    uint32_t last_passes;       // Passes it needed
+    uint32_t last_datagrams;    // DATA datagrams it sent
+    uint32_t last_kbps;         // Final pacing rate
+} udp_still_stats_t;
+
+/**
+ * @brief Start the UDP still server task
+ *
+ * Must be called after camera_service_init() and once the network is up.
+ *
+ * @return ESP_OK on success, error code otherwise
+ */
+esp_err_t udp_still_init(void);
+
+/**
+ * @brief Get a snapshot of the transfer statistics
+ *
+ * @param stats Pointer to structure to populate
+ */
+void udp_still_get_stats(udp_still_stats_t *stats);
+
+#endif // UDP_STILL_H
@@ -248,21 +248,26 @@ esp_err_t settings_read_from_camera(camera_settings_t *settings)
     }
     
     // Read current camera status
-    settings->version = SETTINGS_VERSION;
-    settings->framesize = s->status.framesize;
-    settings->quality = s->status.quality;
-    settings->aec = s->status.aec;
-    settings->aec_value = s->status.aec_value;
-    settings->ae_level = s->status.ae_level;
-    settings->agc = s->status.agc;
-    settings->agc_gain = s->status.agc_gain;
-    settings->brightness = s->status.brightness;
-    settings->contrast = s->status.contrast;
-    settings->saturation = s->status.saturation;
-    settings->sharpness = s->status.sharpness;
-    settings->awb = s->status.awb;
-    settings->hmirror = s->status.hmirror;
-    settings->vflip = s->status.vflip;
+    settings_from_status(&s->status, settings);
     
     return ESP_OK;
 }
+
+void settings_from_status(const camera_status_t *status, camera_settings_t *settings)
+{
+    settings->version = SETTINGS_VERSION;
+    settings->framesize = status->framesize;
+    settings->quality = status->quality;
+    settings->aec = status->aec;
+    settings->aec_value = status->aec_value;
+    settings->ae_level = status->ae_level;
+    settings->agc = status->agc;
+    settings->agc_gain = status->agc_gain;
+    settings->brightness = status->brightness;
+    settings->contrast = status->contrast;
+    settings->saturation = status->saturation;
+    settings->sharpness = status->sharpness;
+    settings->awb = status->awb;
+    settings->hmirror = status->hmirror;
+    settings->vflip = status->vflip;
+}
@@ -7,6 +7,7 @@
 #define SETTINGS_H
 
 #include "esp_err.h"
+#include "esp_camera.h"
 #include <stdint.h>
 
 #ifdef __cplusplus
@@ -91,6 +92,14 @@ esp_err_t settings_apply_to_camera(const camera_settings_t *settings);
  */
 esp_err_t settings_read_from_camera(camera_settings_t *settings);
 
+/**
+ * @brief Convert a sensor status snapshot to a settings structure
+ * 
+ * @param status Sensor status to convert
+ * @param settings Pointer to settings structure to populate
+ */
+void settings_from_status(const camera_status_t *status, camera_settings_t *settings);
+
 #ifdef __cplusplus
 }
 #endif
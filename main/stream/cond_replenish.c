@@ -0,0 +1,309 @@
+/**
+ * @file cond_replenish.c
+ * @brief Conditional replenishment implementation
+ */
+
+#include "stream/cond_replenish.h"
+#include "jpeg/jpeg_crop.h"
+#include "jpeg/jpeg_scan.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char *TAG = "cond_replenish";
+
+// A block changed if its mean moved by more than 4 levels (DC = 8 x mean)
+#define CR_DC_THRESHOLD       32
+
+#define CR_KEY_AREA_PERCENT   50           // Larger changes are sent whole
+#define CR_KEY_INTERVAL_US    30000000     // Resend the whole picture this often
+#define CR_KEEPALIVE_US       1000000      // Longest silence on a static scene
+#define CR_BAND_GAP_ROWS      1            // Changed rows this close share a patch
+#define CR_PATCH_HEADROOM     1024         // Per patch: JPEG headers
+
+static jpeg_info_t *s_info;
+static int16_t *s_ref;                     // Dequantized DC per block, as the clients have it
+static int16_t *s_cur;                     // Same for the frame being processed
+static size_t s_blocks;                    // Entries in s_ref/s_cur
+static size_t s_block_index;               // Decode position
+static uint8_t *s_patch_buf;
+static size_t s_patch_cap;
+static size_t s_patch_len;
+
+static bool s_key_pending = true;
+static uint16_t s_width, s_height;
+static int64_t s_last_key_us;
+static int64_t s_last_part_us;
+
+static esp_err_t collect_dc(const jpeg_block_t *block, void *ctx)
+{
+    const uint16_t *qt = s_info->qt[s_info->comp[block->comp].tq];
+
+    s_cur[s_block_index++] = block->coef[0] * qt[0];
+    return ESP_OK;
+}
+
+static esp_err_t patch_append(const uint8_t *data, size_t len, void *ctx)
+{
+    if (len > s_patch_cap - s_patch_len) {
+        return ESP_ERR_NO_MEM;
+    }
+    memcpy(s_patch_buf + s_patch_len, data, len);
+    s_patch_len += len;
+    return ESP_OK;
+}
+
+/**
+ * @brief Make room for a frame's signature and patches
+ */
+static esp_err_t ensure_buffers(size_t blocks, size_t len)
+{
+    if (blocks != s_blocks) {
+        heap_caps_free(s_ref);
+        heap_caps_free(s_cur);
+        s_ref = heap_caps_malloc(blocks * sizeof(int16_t), MALLOC_CAP_SPIRAM);
+        s_cur = heap_caps_malloc(blocks * sizeof(int16_t), MALLOC_CAP_SPIRAM);
+        s_blocks = (s_ref && s_cur) ? blocks : 0;
+        if (s_blocks == 0) {
+            return ESP_ERR_NO_MEM;
+        }
+        s_key_pending = true;
+    }
+
+    size_t cap = len + CR_MAX_PATCHES * CR_PATCH_HEADROOM;
+    if (cap > s_patch_cap) {
+        heap_caps_free(s_patch_buf);
+        s_patch_buf = heap_caps_malloc(cap, MALLOC_CAP_SPIRAM);
+        s_patch_cap = s_patch_buf ? cap : 0;
+        if (s_patch_buf == NULL) {
+            return ESP_ERR_NO_MEM;
+        }
+    }
+    return ESP_OK;
+}
+
+/**
+ * @brief Whether any block of an MCU moved past the threshold
+ */
+static bool mcu_changed(int mcu)
+{
+    size_t base = (size_t)mcu * s_info->blocks_per_mcu;
+
+    for (int b = 0; b < s_info->blocks_per_mcu; b++) {
+        if (abs(s_cur[base + b] - s_ref[base + b]) > CR_DC_THRESHOLD) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Group changed MCUs into at most CR_MAX_PATCHES row bands
+ *
+ * @return Number of rectangles, or -1 if the frame should be sent whole
+ */
+static int find_patches(jpeg_crop_rect_t rects[CR_MAX_PATCHES], uint32_t *changed)
+{
+    jpeg_crop_rect_t bands[CR_MAX_PATCHES + 1];
+    int count = 0;
+
+    *changed = 0;
+    for (int my = 0; my < s_info->mcus_y; my++) {
+        int x0 = -1, x1 = -1;
+        for (int mx = 0; mx < s_info->mcus_x; mx++) {
+            if (mcu_changed(my * s_info->mcus_x + mx)) {
+                x0 = x0 < 0 ? mx : x0;
+                x1 = mx;
+                (*changed)++;
+            }
+        }
+        if (x0 < 0) {
+            continue;
+        }
+
+        jpeg_crop_rect_t *last = count ? &bands[count - 1] : NULL;
+        if (last && my - (last->y + last->h) <= CR_BAND_GAP_ROWS) {
+            // Extend the current band
+            int right = last->x + last->w > x1 + 1 ? last->x + last->w : x1 + 1;
+            last->x = last->x < x0 ? last->x : x0;
+            last->w = right - last->x;
+            last->h = my + 1 - last->y;
+            continue;
+        }
+        bands[count++] = (jpeg_crop_rect_t) { .x = x0, .y = my, .w = x1 + 1 - x0, .h = 1 };
+
+        if (count > CR_MAX_PATCHES) {
+            // Too many bands: merge the closest neighbours
+            int best = 0;
+            for (int i = 1; i < count - 1; i++) {
+                int gap = bands[i + 1].y - (bands[i].y + bands[i].h);
+                if (gap < bands[best + 1].y - (bands[best].y + bands[best].h)) {
+                    best = i;
+                }
+            }
+            jpeg_crop_rect_t *a = &bands[best];
+            const jpeg_crop_rect_t *b = &bands[best + 1];
+            int right = a->x + a->w > b->x + b->w ? a->x + a->w : b->x + b->w;
+            a->x = a->x < b->x ? a->x : b->x;
+            a->w = right - a->x;
+            a->h = b->y + b->h - a->y;
+            memmove(&bands[best + 1], &bands[best + 2], (count - best - 2) * sizeof(bands[0]));
+            count--;
+        }
+    }
+
+    uint32_t area = 0;
+    for (int i = 0; i < count; i++) {
+        area += bands[i].w * bands[i].h;
+        rects[i] = bands[i];
+    }
+    if (area * 100 > (uint32_t)s_info->mcus_x * s_info->mcus_y * CR_KEY_AREA_PERCENT) {
+        return -1;
+    }
+    return count;
+}
+
+/**
+ * @brief Take the rectangles' blocks into the reference
+ */
+static void update_reference(const jpeg_crop_rect_t *rects, int count)
+{
+    int bpm = s_info->blocks_per_mcu;
+
+    for (int i = 0; i < count; i++) {
+        for (int my = rects[i].y; my < rects[i].y + rects[i].h; my++) {
+            size_t base = ((size_t)my * s_info->mcus_x + rects[i].x) * bpm;
+            memcpy(s_ref + base, s_cur + base, rects[i].w * bpm * sizeof(int16_t));
+        }
+    }
+}
+
+/**
+ * @brief Signature, comparison and patch coding
+ *
+ * Leaves frame->type at CR_FRAME_KEY when the frame should be sent whole.
+ */
+static esp_err_t process(const uint8_t *jpeg, size_t len, int64_t now_us, cr_frame_t *frame)
+{
+    if (s_info == NULL) {
+        s_info = heap_caps_malloc(sizeof(jpeg_info_t), MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+        if (s_info == NULL) {
+            s_info = heap_caps_malloc(sizeof(jpeg_info_t), MALLOC_CAP_8BIT);
+        }
+        if (s_info == NULL) {
+            return ESP_ERR_NO_MEM;
+        }
+    }
+
+    s_block_index = 0;
+    esp_err_t err = jpeg_scan_parse(jpeg, len, s_info);
+    if (err == ESP_OK) {
+        err = ensure_buffers((size_t)s_info->mcus_x * s_info->mcus_y * s_info->blocks_per_mcu,
+                             len);
+    }
+    if (err != ESP_OK) {
+        return err;
+    }
+    err = jpeg_scan_decode(s_info, collect_dc, NULL);
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    frame->total_mcus = s_info->mcus_x * s_info->mcus_y;
+    if (s_width != s_info->width || s_height != s_info->height ||
+        now_us - s_last_key_us >= CR_KEY_INTERVAL_US) {
+        s_key_pending = true;
+    }
+
+    jpeg_crop_rect_t rects[CR_MAX_PATCHES];
+    int count = find_patches(rects, &frame->changed_mcus);
+    if (s_key_pending || count < 0) {
+        frame->type = CR_FRAME_KEY;
+        return ESP_OK;
+    }
+    if (count == 0) {
+        frame->type = now_us - s_last_part_us >= CR_KEEPALIVE_US
+            ? CR_FRAME_KEEPALIVE : CR_FRAME_SKIP;
+        return ESP_OK;
+    }
+
+    size_t ends[CR_MAX_PATCHES];
+    s_patch_len = 0;
+    err = jpeg_crop(s_info, rects, count, patch_append, NULL, ends);
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    int mcu_w, mcu_h;
+    jpeg_crop_mcu_size(s_info, &mcu_w, &mcu_h);
+    for (int i = 0; i < count; i++) {
+        cr_patch_t *p = &frame->patches[i];
+        size_t start = i ? ends[i - 1] : 0;
+        p->x = rects[i].x * mcu_w;
+        p->y = rects[i].y * mcu_h;
+        p->width = rects[i].w * mcu_w;
+        p->height = rects[i].h * mcu_h;
+        p->width = p->x + p->width > s_info->width ? s_info->width - p->x : p->width;
+        p->height = p->y + p->height > s_info->height ? s_info->height - p->y : p->height;
+        p->data = s_patch_buf + start;
+        p->len = ends[i] - start;
+    }
+    frame->type = CR_FRAME_PATCHES;
+    frame->patch_count = count;
+    update_reference(rects, count);
+    return ESP_OK;
+}
+
+esp_err_t cond_replenish_process(const uint8_t *jpeg, size_t len, int64_t now_us,
+                                 cr_frame_t *frame)
+{
+    int64_t start = esp_timer_get_time();
+
+    memset(frame, 0, sizeof(*frame));
+    esp_err_t err = process(jpeg, len, now_us, frame);
+    if (err != ESP_OK || frame->type == CR_FRAME_KEY) {
+        // Whole frame: it becomes the reference if its signature is complete
+        bool complete = s_blocks && s_block_index == s_blocks;
+        if (complete) {
+            int16_t *tmp = s_ref;
+            s_ref = s_cur;
+            s_cur = tmp;
+            s_width = s_info->width;
+            s_height = s_info->height;
+        } else {
+            ESP_LOGW(TAG, "No signature for frame (%s), next frame is sent whole",
+                     esp_err_to_name(err));
+        }
+        s_key_pending = !complete;
+        s_last_key_us = now_us;
+        frame->type = CR_FRAME_KEY;
+        frame->patch_count = 0;
+    }
+    if (frame->type != CR_FRAME_SKIP) {
+        s_last_part_us = now_us;
+    }
+    frame->process_us = (uint32_t)(esp_timer_get_time() - start);
+    return err;
+}
+
+void cond_replenish_request_key(void)
+{
+    s_key_pending = true;
+}
+
+void cond_replenish_reset(void)
+{
+    heap_caps_free(s_ref);
+    heap_caps_free(s_cur);
+    heap_caps_free(s_patch_buf);
+    heap_caps_free(s_info);
+    s_ref = s_cur = NULL;
+    s_patch_buf = NULL;
+    s_info = NULL;
+    s_blocks = 0;
+    s_patch_cap = 0;
+    s_key_pending = true;
+}
@@ -0,0 +1,82 @@
+/**
+ * @file cond_replenish.h
+ * @brief Conditional replenishment for MJPEG streams
+ *
+ * Compares the dequantized DC coefficient of every block of a stream frame
+ * with the picture the clients already have. Unchanged frames cost nothing
+ * but a periodic keep-alive; changed regions go out as small standalone
+ * JPEG patches, cut losslessly from the frame at MCU boundaries, for the
+ * client to draw over its picture. Whole frames are sent when much of the
+ * picture changed, when the frame geometry changes, when a client joins,
+ * and periodically so texture changes that leave the DC unchanged are
+ * picked up.
+ *
+ * There is one reference picture, shared by every conditional-replenishment
+ * client; only the network task may call these functions.
+ */
+
+#ifndef COND_REPLENISH_H
+#define COND_REPLENISH_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+#define CR_MAX_PATCHES 4
+
+/**
+ * @brief What to send for a frame
+ */
+typedef enum {
+    CR_FRAME_KEY,               // The whole frame
+    CR_FRAME_PATCHES,           // Only the patches
+    CR_FRAME_KEEPALIVE,         // Nothing changed; an empty keep-alive part
+    CR_FRAME_SKIP,              // Nothing changed; nothing at all
+} cr_frame_type_t;
+
+/**
+ * @brief Changed region as a standalone JPEG
+ */
+typedef struct {
+    uint16_t x, y;              // Position in the frame, pixels
+    uint16_t width, height;
+    const uint8_t *data;        // Valid until the next cond_replenish_process()
+    size_t len;
+} cr_patch_t;
+
+/**
+ * @brief Replenishment decision for one frame
+ */
+typedef struct {
+    cr_frame_type_t type;
+    int patch_count;
+    cr_patch_t patches[CR_MAX_PATCHES];
+    uint32_t changed_mcus;      // MCUs over the change threshold
+    uint32_t total_mcus;
+    uint32_t process_us;        // Signature and patch coding time
+} cr_frame_t;
+
+/**
+ * @brief Decide what to send for a stream frame
+ *
+ * @param jpeg Frame data
+ * @param len Frame length
+ * @param now_us Current time
+ * @param frame Receives the decision; CR_FRAME_KEY on any error
+ * @return ESP_OK on success, or the JPEG parsing/coding error that forced
+ *         a whole frame
+ */
+esp_err_t cond_replenish_process(const uint8_t *jpeg, size_t len, int64_t now_us,
+                                 cr_frame_t *frame);
+
+/**
+ * @brief Send the next frame whole, e.g. because a client joined
+ */
+void cond_replenish_request_key(void);
+
+/**
+ * @brief Free the reference picture and buffers once no client needs them
+ */
+void cond_replenish_reset(void);
+
+#endif // COND_REPLENISH_H
@@ -0,0 +1,56 @@
+/**
+ * @file frame_queue.c
+ * @brief Lock-free SPSC frame descriptor ring implementation
+ */
+
+#include "stream/frame_queue.h"
+
+#define FRAME_QUEUE_MASK (FRAME_QUEUE_CAPACITY - 1)
+
+_Static_assert((FRAME_QUEUE_CAPACITY & FRAME_QUEUE_MASK) == 0,
+               "FRAME_QUEUE_CAPACITY must be a power of two");
+
+void frame_queue_init(frame_queue_t *q)
+{
+    atomic_init(&q->head, 0);
+    atomic_init(&q->tail, 0);
+}
+
+bool frame_queue_push(frame_queue_t *q, const frame_desc_t *desc)
+{
+    uint_fast32_t head = atomic_load_explicit(&q->head, memory_order_relaxed);
+    uint_fast32_t tail = atomic_load_explicit(&q->tail, memory_order_acquire);
+
+    if ((uint32_t)(head - tail) >= FRAME_QUEUE_CAPACITY) {
+        return false;
+    }
+
+    q->slots[head & FRAME_QUEUE_MASK] = *desc;
+
+    // Publish the slot contents before the new head becomes visible
+    atomic_store_explicit(&q->head, head + 1, memory_order_release);
+    return true;
+}
+
+bool frame_queue_pop(frame_queue_t *q, frame_desc_t *desc)
+{
+    uint_fast32_t tail = atomic_load_explicit(&q->tail, memory_order_relaxed);
+    uint_fast32_t head = atomic_load_explicit(&q->head, memory_order_acquire);
+
+    if (head == tail) {
+        return false;
+    }
+
+    *desc = q->slots[tail & FRAME_QUEUE_MASK];
+
+    // Release the slot back to the producer only after it has been read
+    atomic_store_explicit(&q->tail, tail + 1, memory_order_release);
+    return true;
+}
+
+uint32_t frame_queue_count(frame_queue_t *q)
+{
+    uint_fast32_t head = atomic_load_explicit(&q->head, memory_order_acquire);
+    uint_fast32_t tail = atomic_load_explicit(&q->tail, memory_order_acquire);
+    return (uint32_t)(head - tail);
+}
@@ -0,0 +1,81 @@
+/**
+ * @file frame_queue.h
+ * @brief Lock-free single-producer/single-consumer frame descriptor ring
+ *
+ * Used to hand captured frames from the capture task to the network task
+ * without a mutex. Exactly one task may push and exactly one task may pop;
+ * both operations are wait-free.
+ */
+
+#ifndef FRAME_QUEUE_H
+#define FRAME_QUEUE_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_camera.h"
+
+// Ring capacity (must be a power of two)
+#define FRAME_QUEUE_CAPACITY 4
+
+/**
+ * @brief Descriptor for one captured frame travelling through the pipeline
+ */
+typedef struct {
+    camera_fb_t *fb;        // Frame buffer owned by the driver until returned
+    int64_t timestamp_us;   // Time the frame was grabbed (esp_timer_get_time)
+    uint32_t seq;           // Monotonic frame sequence number
+    uint32_t gap_ms;        // Stream gap before this frame caused by a still (0 = none)
+} frame_desc_t;
+
+/**
+ * @brief SPSC ring of frame descriptors
+ *
+ * head is only written by the producer, tail only by the consumer.
+ * Both are free-running counters; the slot index is counter & (capacity - 1).
+ */
+typedef struct {
+    frame_desc_t slots[FRAME_QUEUE_CAPACITY];
+    atomic_uint_fast32_t head;
+    atomic_uint_fast32_t tail;
+} frame_queue_t;
+
+/**
+ * @brief Reset the ring to empty
+ *
+ * Must not be called while a producer or consumer is active.
+ *
+ * @param q Ring to initialize
+ */
+void frame_queue_init(frame_queue_t *q);
+
+/**
+ * @brief Push a descriptor (producer side only)
+ *
+ * @param q Ring
+ * @param desc Descriptor to copy into the ring
+ * @return true if pushed, false if the ring is full
+ */
+bool frame_queue_push(frame_queue_t *q, const frame_desc_t *desc);
+
+/**
+ * @brief Pop the oldest descriptor (consumer side only)
+ *
+ * @param q Ring
+ * @param desc Receives the popped descriptor
+ * @return true if a descriptor was popped, false if the ring is empty
+ */
+bool frame_queue_pop(frame_queue_t *q, frame_desc_t *desc);
+
+/**
+ * @brief Number of descriptors currently queued
+ *
+ * Exact when called from either the producer or the consumer; a snapshot
+ * otherwise.
+ *
+ * @param q Ring
+ * @return Queued descriptor count
+ */
+uint32_t frame_queue_count(frame_queue_t *q);
+
+#endif // FRAME_QUEUE_H
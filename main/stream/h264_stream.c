@@ -0,0 +1,420 @@
+/**
+ * @file h264_stream.c
+ * @brief H.264 live stream implementation
+ */
+
+#include "stream/h264_stream.h"
+#include "stream/frame_queue.h"
+#include "h264/h264_enc.h"
+#include "h264/h264_mp4.h"
+#include "net/http_raw.h"
+#include "camera/camera_service.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include <stdatomic.h>
+
+static const char *TAG = "h264_stream";
+
+// Encoding runs next to networking, away from the camera driver's core
+#if CONFIG_CAMERA_CORE1
+#define H264_STREAM_CORE 0
+#else
+#define H264_STREAM_CORE 1
+#endif
+
+#define H264_STREAM_PRIORITY      4
+#define H264_STREAM_STACK_SIZE    4096
+
+#define H264_FRAME_WAIT_MS        200      // Wake up at least this often while streaming
+#define H264_STATS_WINDOW_US      5000000  // Log throughput every 5 seconds
+#define H264_START_QP             30       // First picture's QP; rate control takes over
+#define H264_INIT_SEGMENT_SIZE    768
+
+/**
+ * @brief One connected client
+ */
+typedef struct {
+    httpd_req_t *req;       // Detached (async) request
+    int sockfd;
+    framesize_t framesize;  // Requested picture size
+    int bitrate;
+    int gop;
+    bool started;           // Init segment sent, fragments flowing
+    uint32_t seq;           // Fragments sent
+    int64_t start_us;       // Capture time of the client's first picture
+} h264_client_t;
+
+static QueueHandle_t s_new_clients;
+static TaskHandle_t s_task;
+static atomic_int s_reserved;             // Connected plus pending clients
+static uint32_t s_seq;                    // Frame sequence (camera service task only)
+
+// Frame hand-off: the sink fills s_pending and sets s_busy; the encoder
+// task clears s_busy once the frame is released. Frames arriving while
+// s_busy is set are dropped.
+static atomic_bool s_busy;
+static frame_desc_t s_pending;
+
+// Owned by the encoder task
+static h264_client_t s_clients[H264_STREAM_MAX_CLIENTS];
+static int s_client_count;
+static h264_enc_t *s_enc;                 // Allocated while a session runs
+static int s_width, s_height;
+static int64_t s_last_us;                 // Capture time of the previous picture
+static uint8_t s_init[H264_INIT_SEGMENT_SIZE];
+
+// Current stats window (encoder task only)
+static uint32_t s_window_frames;
+static uint64_t s_window_bytes;
+static int64_t s_window_encode_us;
+
+static h264_stream_stats_t s_stats;
+static portMUX_TYPE s_stats_lock = portMUX_INITIALIZER_UNLOCKED;
+
+/**
+ * @brief YUV stream frame sink - runs in the camera service task
+ */
+static bool yuv_sink(camera_fb_t *fb, int64_t timestamp_us, uint32_t gap_ms)
+{
+    if (atomic_load(&s_busy)) {
+        portENTER_CRITICAL(&s_stats_lock);
+        s_stats.frames_dropped++;
+        portEXIT_CRITICAL(&s_stats_lock);
+        return false;
+    }
+
+    s_pending = (frame_desc_t){
+        .fb = fb,
+        .timestamp_us = timestamp_us,
+        .seq = s_seq++,
+        .gap_ms = gap_ms,
+    };
+    atomic_store(&s_busy, true);
+    xTaskNotifyGive(s_task);
+    return true;
+}
+
+/**
+ * @brief Complete a client's async request and free its slot
+ */
+static void remove_client(int index)
+{
+    h264_client_t *client = &s_clients[index];
+
+    httpd_sess_trigger_close(client->req->handle, client->sockfd);
+    httpd_req_async_handler_complete(client->req);
+    s_clients[index] = s_clients[--s_client_count];
+    atomic_fetch_sub(&s_reserved, 1);
+    ESP_LOGI(TAG, "H.264 client disconnected (%d remaining)", s_client_count);
+}
+
+/**
+ * @brief Allocate the encoder and switch the camera to YUV streaming
+ */
+static esp_err_t start_session(const h264_client_t *client)
+{
+    h264_enc_config_t config = {
+        .width = resolution[client->framesize].width,
+        .height = resolution[client->framesize].height,
+        .gop = client->gop,
+        .bitrate = client->bitrate,
+        .qp = H264_START_QP,
+    };
+
+    esp_err_t err = h264_enc_create(&config, &s_enc);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Encoder allocation failed: %s", esp_err_to_name(err));
+        return err;
+    }
+    err = camera_service_set_mode(CAMERA_MODE_STREAM_YUV, client->framesize, 0);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Camera unavailable for H.264: %s%s", esp_err_to_name(err),
+                 err == ESP_ERR_INVALID_STATE ? " (MJPEG stream running)" : "");
+        h264_enc_destroy(s_enc);
+        s_enc = NULL;
+        return err;
+    }
+
+    s_width = config.width;
+    s_height = config.height;
+    s_last_us = 0;
+    ESP_LOGI(TAG, "H.264 session started (%s, %d bps, GOP %d)",
+             camera_framesize_name(client->framesize), client->bitrate, client->gop);
+    return ESP_OK;
+}
+
+/**
+ * @brief Leave YUV streaming and free the encoder
+ */
+static void stop_session(void)
+{
+    // s_busy stays set so the sink takes nothing more; the service cannot
+    // leave YUV mode while a frame is out
+    if (atomic_exchange(&s_busy, true)) {
+        camera_service_release(s_pending.fb);
+    }
+    camera_service_set_mode(CAMERA_MODE_STILL, 0, 0);
+    atomic_store(&s_busy, false);
+
+    h264_enc_destroy(s_enc);
+    s_enc = NULL;
+    ESP_LOGI(TAG, "H.264 session ended");
+}
+
+/**
+ * @brief Adopt a newly connected client
+ *
+ * Clients joining a running session get the session's framesize; rate
+ * settings always follow the latest client.
+ */
+static void adopt_client(const h264_client_t *client)
+{
+    s_clients[s_client_count++] = *client;
+
+    if (s_enc == NULL && start_session(client) != ESP_OK) {
+        http_raw_send_headers(client->req, "503 Service Unavailable", "text/plain", 0, NULL);
+        remove_client(s_client_count - 1);
+        return;
+    }
+    if (http_raw_send_headers(client->req, "200 OK", "video/mp4", -1,
+                              "Access-Control-Allow-Origin: *\r\n"
+                              "Cache-Control: no-cache\r\n") != ESP_OK) {
+        remove_client(s_client_count - 1);
+        return;
+    }
+
+    h264_enc_set_rate(s_enc, client->bitrate, client->gop);
+    h264_enc_request_idr(s_enc);
+    ESP_LOGI(TAG, "H.264 client connected (%d total, %d bps, GOP %d)",
+             s_client_count, client->bitrate, client->gop);
+}
+
+/**
+ * @brief Send one encoded picture to every client, dropping failed ones
+ *
+ * Clients that have not started yet wait for an IDR picture and get the
+ * init segment in the same write as their first fragment.
+ */
+static void send_picture(const h264_frame_t *frame, int64_t timestamp_us)
+{
+    h264_mp4_au_t au;
+    uint8_t header[H264_MP4_FRAGMENT_HEADER_SIZE];
+    size_t init_len = 0;
+
+    if (!h264_mp4_split_au(frame->data, frame->len, &au)) {
+        ESP_LOGE(TAG, "Malformed access unit");
+        return;
+    }
+
+    // The real duration is only known at the next picture; the previous
+    // interval is a good guess and decode times stay exact regardless
+    uint32_t duration = s_last_us ? (uint32_t)((timestamp_us - s_last_us) * 9 / 100)
+                                  : H264_MP4_TIMESCALE / 10;
+    s_last_us = timestamp_us;
+
+    int i = 0;
+    while (i < s_client_count) {
+        h264_client_t *client = &s_clients[i];
+        struct iovec iov[3];
+        int iovcnt = 0;
+
+        if (!client->started) {
+            if (!frame->idr) {
+                i++;
+                continue;
+            }
+            if (init_len == 0) {
+                init_len = h264_mp4_init_segment(s_init, sizeof(s_init), s_width, s_height, &au);
+                char codec[12];
+                h264_mp4_codec_string(&au, codec);
+                ESP_LOGI(TAG, "Init segment: %dx%d, %s", s_width, s_height, codec);
+            }
+            iov[iovcnt++] = (struct iovec){ .iov_base = s_init, .iov_len = init_len };
+            client->start_us = timestamp_us;
+        }
+
+        uint64_t decode_time = (uint64_t)(timestamp_us - client->start_us) * 9 / 100;
+        size_t hlen = h264_mp4_fragment_header(header, ++client->seq, decode_time, duration,
+                                               au.sample_len, frame->idr);
+        iov[iovcnt++] = (struct iovec){ .iov_base = header, .iov_len = hlen };
+        iov[iovcnt++] = (struct iovec){ .iov_base = (void *)au.sample, .iov_len = au.sample_len };
+
+        if (http_raw_writev_all(client->sockfd, iov, iovcnt) != ESP_OK) {
+            remove_client(i);
+            continue;
+        }
+        client->started = true;
+        i++;
+    }
+}
+
+/**
+ * @brief Encode the pending frame, give it back and send the result
+ */
+static void encode_pending(void)
+{
+    const frame_desc_t *desc = &s_pending;
+    camera_fb_t *fb = desc->fb;
+    int64_t timestamp_us = desc->timestamp_us;
+    h264_frame_t frame;
+    esp_err_t err = ESP_ERR_INVALID_SIZE;
+
+    int64_t start = esp_timer_get_time();
+    if (fb->width == s_width && fb->height == s_height && fb->len >= (size_t)s_width * s_height * 2) {
+        err = h264_enc_encode(s_enc, fb->buf, timestamp_us, &frame);
+    } else {
+        ESP_LOGW(TAG, "Skipping %dx%d frame", fb->width, fb->height);
+    }
+    int64_t encode_us = esp_timer_get_time() - start;
+
+    // The encoder keeps its own planar copy, so the frame can go back now
+    camera_service_release(fb);
+    atomic_store(&s_busy, false);
+    if (err != ESP_OK) {
+        return;
+    }
+
+    s_window_frames++;
+    s_window_bytes += frame.len;
+    s_window_encode_us += encode_us;
+    portENTER_CRITICAL(&s_stats_lock);
+    s_stats.frames_encoded++;
+    s_stats.qp = frame.qp;
+    portEXIT_CRITICAL(&s_stats_lock);
+
+    send_picture(&frame, timestamp_us);
+}
+
+/**
+ * @brief Encoder task - adopts clients, encodes frames and sends fragments
+ */
+static void encoder_task(void *arg)
+{
+    int64_t window_start = esp_timer_get_time();
+
+    while (true) {
+        // Adopt newly connected clients (block only while idle)
+        h264_client_t client;
+        TickType_t wait = (s_client_count == 0) ? portMAX_DELAY : 0;
+        while (xQueueReceive(s_new_clients, &client, wait) == pdTRUE) {
+            wait = 0;
+            if (s_enc == NULL) {
+                window_start = esp_timer_get_time();
+                s_window_frames = 0;
+                s_window_bytes = 0;
+                s_window_encode_us = 0;
+            }
+            adopt_client(&client);
+        }
+
+        // Wait for the camera service to hand over a frame
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(H264_FRAME_WAIT_MS));
+        if (s_enc != NULL && atomic_load(&s_busy)) {
+            encode_pending();
+        }
+
+        int64_t now = esp_timer_get_time();
+        if (now - window_start >= H264_STATS_WINDOW_US) {
+            float seconds = (now - window_start) / 1000000.0f;
+            float fps = s_window_frames / seconds;
+            uint32_t kbps = (uint32_t)(s_window_bytes * 8 / 1000 / seconds);
+            uint32_t avg_encode_us = s_window_frames ?
+                (uint32_t)(s_window_encode_us / s_window_frames) : 0;
+
+            portENTER_CRITICAL(&s_stats_lock);
+            s_stats.fps = fps;
+            s_stats.kbps = kbps;
+            s_stats.avg_encode_us = avg_encode_us;
+            portEXIT_CRITICAL(&s_stats_lock);
+
+            if (s_enc != NULL) {
+                ESP_LOGI(TAG, "H.264: %.1f fps, %lu kbit/s, encode %lu us/picture, %d client(s)",
+                         fps, (unsigned long)kbps, (unsigned long)avg_encode_us, s_client_count);
+            }
+            window_start = now;
+            s_window_frames = 0;
+            s_window_bytes = 0;
+            s_window_encode_us = 0;
+        }
+
+        portENTER_CRITICAL(&s_stats_lock);
+        s_stats.clients = s_client_count;
+        portEXIT_CRITICAL(&s_stats_lock);
+
+        if (s_client_count == 0 && s_enc != NULL) {
+            stop_session();
+            portENTER_CRITICAL(&s_stats_lock);
+            s_stats.fps = 0;
+            s_stats.kbps = 0;
+            portEXIT_CRITICAL(&s_stats_lock);
+        }
+    }
+}
+
+esp_err_t h264_stream_init(void)
+{
+    atomic_init(&s_reserved, 0);
+    atomic_init(&s_busy, false);
+
+    s_new_clients = xQueueCreate(H264_STREAM_MAX_CLIENTS, sizeof(h264_client_t));
+    if (s_new_clients == NULL) {
+        ESP_LOGE(TAG, "Failed to create H.264 client queue");
+        return ESP_ERR_NO_MEM;
+    }
+
+    if (xTaskCreatePinnedToCore(encoder_task, "h264_enc", H264_STREAM_STACK_SIZE, NULL,
+                                H264_STREAM_PRIORITY, &s_task, H264_STREAM_CORE) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create H.264 encoder task");
+        return ESP_ERR_NO_MEM;
+    }
+
+    camera_service_set_yuv_stream_sink(yuv_sink);
+
+    ESP_LOGI(TAG, "H.264 stream ready (encoder core %d)", H264_STREAM_CORE);
+    return ESP_OK;
+}
+
+esp_err_t h264_stream_add_client(httpd_req_t *req, framesize_t framesize, int bitrate, int gop)
+{
+    if (atomic_fetch_add(&s_reserved, 1) >= H264_STREAM_MAX_CLIENTS) {
+        atomic_fetch_sub(&s_reserved, 1);
+        ESP_LOGW(TAG, "Rejecting H.264 client, %d already connected", H264_STREAM_MAX_CLIENTS);
+        return ESP_ERR_NO_MEM;
+    }
+
+    // Detach the request so the httpd task can return immediately
+    httpd_req_t *async_req = NULL;
+    esp_err_t err = httpd_req_async_handler_begin(req, &async_req);
+    if (err != ESP_OK) {
+        atomic_fetch_sub(&s_reserved, 1);
+        ESP_LOGE(TAG, "Failed to detach H.264 request: %s", esp_err_to_name(err));
+        return err;
+    }
+
+    h264_client_t client = {
+        .req = async_req,
+        .sockfd = httpd_req_to_sockfd(async_req),
+        .framesize = framesize,
+        .bitrate = bitrate,
+        .gop = gop,
+    };
+
+    // Cannot fail: the queue holds H264_STREAM_MAX_CLIENTS and slots are reserved above
+    xQueueSend(s_new_clients, &client, 0);
+    return ESP_OK;
+}
+
+bool h264_stream_active(void)
+{
+    return atomic_load(&s_reserved) > 0;
+}
+
+void h264_stream_get_stats(h264_stream_stats_t *stats)
+{
+    portENTER_CRITICAL(&s_stats_lock);
+    *stats = s_stats;
+    portEXIT_CRITICAL(&s_stats_lock);
+}
@@ -0,0 +1,83 @@
+/**
+ * @file h264_stream.h
+ * @brief H.264 live stream as fragmented MP4 over HTTP
+ *
+ * While a client is connected the camera service runs in YUV stream mode
+ * and hands frames to an encoder task pinned to the network core. Each
+ * frame is encoded with the in-tree H.264 Baseline encoder, packaged as one
+ * movie fragment and written straight to every client's socket. Frames
+ * that arrive while the encoder is busy are dropped, so the stream runs at
+ * whatever rate the encoder sustains, up to the service's 10 FPS.
+ *
+ * The sensor cannot stream JPEG and YUV at once: an H.264 stream and the
+ * MJPEG stream exclude each other.
+ */
+
+#ifndef H264_STREAM_H
+#define H264_STREAM_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_camera.h"
+#include "esp_err.h"
+#include "esp_http_server.h"
+
+// Maximum number of simultaneous H.264 clients
+#define H264_STREAM_MAX_CLIENTS 2
+
+/**
+ * @brief H.264 stream statistics
+ */
+typedef struct {
+    uint32_t clients;           // Connected clients
+    float fps;                  // Pictures encoded per second (last window)
+    uint32_t kbps;              // Encoded bitrate (last window)
+    uint32_t avg_encode_us;     // Average encode time per picture
+    int qp;                     // QP of the last picture
+    uint32_t frames_encoded;    // Pictures encoded since boot
+    uint32_t frames_dropped;    // Frames skipped because the encoder was busy
+} h264_stream_stats_t;
+
+/**
+ * @brief Start the encoder task and register with the camera service
+ *
+ * Must be called after camera_service_init(). The encoder is only
+ * allocated while clients are connected.
+ *
+ * @return ESP_OK on success, error code otherwise
+ */
+esp_err_t h264_stream_init(void);
+
+/**
+ * @brief Hand a request over to the encoder task
+ *
+ * Detaches the request from the httpd task; the caller must return from
+ * its handler immediately afterwards without touching the request. The
+ * client receives the init segment and fragments from the next IDR
+ * picture on, which is requested at once.
+ *
+ * All clients share one encoder: the framesize is set by the first client
+ * of a session, while bitrate and GOP follow the latest client.
+ *
+ * @param req HTTP request from the handler
+ * @param framesize Picture size, used if no session is running
+ * @param bitrate Target bits per second, 0 for constant QP
+ * @param gop Pictures from one IDR to the next
+ * @return ESP_OK if the client was queued, ESP_ERR_NO_MEM if all slots
+ *         are taken
+ */
+esp_err_t h264_stream_add_client(httpd_req_t *req, framesize_t framesize, int bitrate, int gop);
+
+/**
+ * @brief Whether any H.264 client is connected or pending
+ */
+bool h264_stream_active(void);
+
+/**
+ * @brief Get a snapshot of the stream statistics
+ *
+ * @param stats Pointer to structure to populate
+ */
+void h264_stream_get_stats(h264_stream_stats_t *stats);
+
+#endif // H264_STREAM_H
@@ -0,0 +1,285 @@
+/**
+ * @file rtp_mcast.c
+ * @brief Multicast RTP/JPEG output implementation
+ */
+
+#include "stream/rtp_mcast.h"
+#include "net/rtp_jpeg.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_random.h"
+#include "esp_heap_caps.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "lwip/sockets.h"
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+
+static const char *TAG = "rtp_mcast";
+
+#define RTP_MCAST_MTU_PAYLOAD     1400     // UDP payload, below the WiFi MTU
+#define RTP_MCAST_SEND_RETRIES    5        // Ticks to wait for TX buffers per packet
+#define RTP_MCAST_STATS_WINDOW_US 5000000
+
+// Owned by the stream network task
+static int s_sock = -1;
+static struct sockaddr_in s_dest;
+static rtp_jpeg_session_t s_session;
+static jpeg_info_t *s_info;                 // Parser scratch, allocated once
+static int64_t s_tokens;                    // Rate cap bucket, bytes
+static int64_t s_tokens_us;                 // Last refill
+static bool s_warned_rejected;
+
+// Current stats window
+static int64_t s_window_start;
+static uint32_t s_window_frames;
+static uint64_t s_window_bytes;
+static int64_t s_window_send_us;
+
+static rtp_mcast_stats_t s_stats;
+static portMUX_TYPE s_stats_lock = portMUX_INITIALIZER_UNLOCKED;
+
+void rtp_mcast_config_default(rtp_mcast_config_t *config)
+{
+    memset(config, 0, sizeof(*config));
+    strcpy(config->group, RTP_MCAST_DEFAULT_GROUP);
+    config->port = RTP_MCAST_DEFAULT_PORT;
+    config->ttl = RTP_MCAST_DEFAULT_TTL;
+    config->max_kbps = RTP_MCAST_DEFAULT_KBPS;
+    config->quality = RTP_MCAST_DEFAULT_QUALITY;
+}
+
+esp_err_t rtp_mcast_open(const rtp_mcast_config_t *config)
+{
+    struct in_addr group;
+    if (inet_aton(config->group, &group) == 0 || !IN_MULTICAST(ntohl(group.s_addr))) {
+        ESP_LOGE(TAG, "Not a multicast group: %s", config->group);
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    if (s_info == NULL) {
+        s_info = heap_caps_malloc(sizeof(jpeg_info_t), MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+        if (s_info == NULL) {
+            return ESP_ERR_NO_MEM;
+        }
+    }
+
+    rtp_mcast_close();
+    s_sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_IP);
+    if (s_sock < 0) {
+        ESP_LOGE(TAG, "Failed to create socket (errno %d)", errno);
+        return ESP_FAIL;
+    }
+    uint8_t ttl = config->ttl;
+    if (setsockopt(s_sock, IPPROTO_IP, IP_MULTICAST_TTL, &ttl, sizeof(ttl)) < 0) {
+        ESP_LOGE(TAG, "Failed to set TTL (errno %d)", errno);
+        rtp_mcast_close();
+        return ESP_FAIL;
+    }
+
+    memset(&s_dest, 0, sizeof(s_dest));
+    s_dest.sin_family = AF_INET;
+    s_dest.sin_port = htons(config->port);
+    s_dest.sin_addr = group;
+
+    if (s_session.ssrc == 0) {
+        s_session.ssrc = esp_random();
+        s_session.seq = (uint16_t)esp_random();
+    }
+    s_session.mtu_payload = RTP_MCAST_MTU_PAYLOAD;
+    s_tokens = 0;
+    s_tokens_us = esp_timer_get_time();
+    s_warned_rejected = false;
+    s_window_start = s_tokens_us;
+    s_window_frames = 0;
+    s_window_bytes = 0;
+    s_window_send_us = 0;
+
+    portENTER_CRITICAL(&s_stats_lock);
+    memset(&s_stats, 0, sizeof(s_stats));
+    s_stats.active = true;
+    s_stats.config = *config;
+    portEXIT_CRITICAL(&s_stats_lock);
+
+    ESP_LOGI(TAG, "Multicast RTP/JPEG to %s:%u (TTL %u, cap %lu kbit/s)",
+             config->group, config->port, config->ttl, (unsigned long)config->max_kbps);
+    return ESP_OK;
+}
+
+void rtp_mcast_close(void)
+{
+    if (s_sock < 0) {
+        return;
+    }
+    close(s_sock);
+    s_sock = -1;
+
+    portENTER_CRITICAL(&s_stats_lock);
+    s_stats.active = false;
+    s_stats.kbps = 0;
+    portEXIT_CRITICAL(&s_stats_lock);
+    ESP_LOGI(TAG, "Multicast output stopped");
+}
+
+bool rtp_mcast_is_open(void)
+{
+    return s_sock >= 0;
+}
+
+/**
+ * @brief Take a frame's bytes from the rate cap bucket
+ *
+ * The bucket holds at most one second's worth, so a burst after an idle
+ * period stays short.
+ *
+ * @return false if the frame would exceed the cap
+ */
+static bool take_tokens(uint32_t max_kbps, size_t bytes, int64_t now)
+{
+    if (max_kbps == 0) {
+        return true;
+    }
+    int64_t cap = (int64_t)max_kbps * 1000 / 8;
+    s_tokens += (now - s_tokens_us) * max_kbps / 8000;
+    s_tokens_us = now;
+    if (s_tokens > cap) {
+        s_tokens = cap;
+    }
+    if (s_tokens < (int64_t)bytes) {
+        return false;
+    }
+    s_tokens -= bytes;
+    return true;
+}
+
+/**
+ * @brief Send one packet, waiting briefly for TX buffers
+ */
+static bool send_packet(struct iovec *iov)
+{
+    struct msghdr msg = {
+        .msg_name = &s_dest,
+        .msg_namelen = sizeof(s_dest),
+        .msg_iov = iov,
+        .msg_iovlen = 2,
+    };
+
+    for (int attempt = 0; attempt <= RTP_MCAST_SEND_RETRIES; attempt++) {
+        if (sendmsg(s_sock, &msg, 0) >= 0) {
+            return true;
+        }
+        if (errno != ENOMEM && errno != ENOBUFS && errno != EAGAIN) {
+            break;
+        }
+        vTaskDelay(1);
+    }
+    ESP_LOGW(TAG, "sendmsg failed (errno %d)", errno);
+    return false;
+}
+
+void rtp_mcast_send_frame(const camera_fb_t *fb, int64_t timestamp_us)
+{
+    if (s_sock < 0) {
+        return;
+    }
+
+    int64_t start = esp_timer_get_time();
+    rtp_jpeg_frame_t frame;
+    esp_err_t err = rtp_jpeg_prepare(fb->buf, fb->len, s_info, timestamp_us, &frame);
+    if (err != ESP_OK) {
+        if (!s_warned_rejected) {
+            ESP_LOGW(TAG, "Frame not carriable as RTP/JPEG: %s", esp_err_to_name(err));
+            s_warned_rejected = true;
+        }
+        portENTER_CRITICAL(&s_stats_lock);
+        s_stats.frames_rejected++;
+        portEXIT_CRITICAL(&s_stats_lock);
+        return;
+    }
+
+    // Wire size: scan data plus about 30 bytes of headers per packet
+    size_t packets = frame.scan_len / (RTP_MCAST_MTU_PAYLOAD - 32) + 1;
+    size_t bytes = frame.scan_len + packets * 32 + sizeof(frame.qt);
+    if (!take_tokens(s_stats.config.max_kbps, bytes, start)) {
+        portENTER_CRITICAL(&s_stats_lock);
+        s_stats.frames_skipped++;
+        portEXIT_CRITICAL(&s_stats_lock);
+        return;
+    }
+
+    uint8_t header[RTP_JPEG_MAX_HEADER];
+    size_t header_len;
+    const uint8_t *payload;
+    size_t payload_len;
+    uint32_t sent = 0;
+    bool ok = true;
+    while (rtp_jpeg_next(&s_session, &frame, header, &header_len, &payload, &payload_len)) {
+        struct iovec iov[2] = {
+            { .iov_base = header, .iov_len = header_len },
+            { .iov_base = (void *)payload, .iov_len = payload_len },
+        };
+        if (!send_packet(iov)) {
+            ok = false;
+            break;
+        }
+        sent++;
+        s_window_bytes += header_len + payload_len;
+    }
+    int64_t end = esp_timer_get_time();
+
+    s_window_frames++;
+    s_window_send_us += end - start;
+    portENTER_CRITICAL(&s_stats_lock);
+    s_stats.packets_sent += sent;
+    if (ok) {
+        s_stats.frames_sent++;
+    } else {
+        s_stats.send_errors++;
+    }
+    portEXIT_CRITICAL(&s_stats_lock);
+
+    if (end - s_window_start >= RTP_MCAST_STATS_WINDOW_US) {
+        float seconds = (end - s_window_start) / 1000000.0f;
+        uint32_t kbps = (uint32_t)(s_window_bytes * 8 / 1000 / seconds);
+        uint32_t avg_send_us = (uint32_t)(s_window_send_us / s_window_frames);
+
+        portENTER_CRITICAL(&s_stats_lock);
+        s_stats.kbps = kbps;
+        s_stats.avg_send_us = avg_send_us;
+        portEXIT_CRITICAL(&s_stats_lock);
+
+        ESP_LOGI(TAG, "Multicast: %.1f fps, %lu kbit/s, send %lu us/frame",
+                 s_window_frames / seconds, (unsigned long)kbps, (unsigned long)avg_send_us);
+        s_window_start = end;
+        s_window_frames = 0;
+        s_window_bytes = 0;
+        s_window_send_us = 0;
+    }
+}
+
+int rtp_mcast_sdp(const rtp_mcast_config_t *config, const char *origin_ip,
+                  char *out, size_t cap)
+{
+    int n = snprintf(out, cap,
+                     "v=0\r\n"
+                     "o=- %lu 1 IN IP4 %s\r\n"
+                     "s=GrowPod Camera\r\n"
+                     "c=IN IP4 %s/%u\r\n"
+                     "t=0 0\r\n"
+                     "m=video %u RTP/AVP %d\r\n"
+                     "a=rtpmap:%d JPEG/%d\r\n"
+                     "a=recvonly\r\n",
+                     (unsigned long)s_session.ssrc, origin_ip,
+                     config->group, config->ttl,
+                     config->port, RTP_JPEG_PAYLOAD_TYPE,
+                     RTP_JPEG_PAYLOAD_TYPE, RTP_JPEG_CLOCK_RATE);
+    return (n < 0 || (size_t)n >= cap) ? 0 : n;
+}
+
+void rtp_mcast_get_stats(rtp_mcast_stats_t *stats)
+{
+    portENTER_CRITICAL(&s_stats_lock);
+    *stats = s_stats;
+    portEXIT_CRITICAL(&s_stats_lock);
+}
@@ -0,0 +1,112 @@
+/**
+ * @file rtp_mcast.h
+ * @brief Multicast RTP/JPEG output of the MJPEG stream
+ *
+ * Sends every stream frame once, as RFC 2435 RTP packets to a multicast
+ * group, so any number of viewers on the LAN cost the device the same
+ * airtime and CPU as one. Viewers open the session description served at
+ * /multicast.sdp (ffplay, VLC); nothing is sent back to the device.
+ *
+ * The output is driven by the stream network task: it opens the socket
+ * when multicast is switched on and hands it each frame after the HTTP
+ * clients. A token bucket caps the rate; frames that would exceed it are
+ * skipped whole rather than sent partially.
+ */
+
+#ifndef RTP_MCAST_H
+#define RTP_MCAST_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_camera.h"
+#include "esp_err.h"
+
+#define RTP_MCAST_DEFAULT_GROUP   "239.255.42.42"
+#define RTP_MCAST_DEFAULT_PORT    5004
+#define RTP_MCAST_DEFAULT_TTL     1        // Stay on the local subnet
+#define RTP_MCAST_DEFAULT_KBPS    4000
+#define RTP_MCAST_DEFAULT_QUALITY 12
+
+/**
+ * @brief Multicast output settings
+ */
+typedef struct {
+    char group[16];             // IPv4 multicast group, dotted quad
+    uint16_t port;              // RTP port (even)
+    uint8_t ttl;                // IP TTL of the datagrams
+    uint32_t max_kbps;          // Rate cap, 0 for none
+    int quality;                // Stream JPEG quality (0-63, lower is better)
+} rtp_mcast_config_t;
+
+/**
+ * @brief Multicast output statistics
+ */
+typedef struct {
+    bool active;
+    rtp_mcast_config_t config;  // Valid while active
+    uint32_t frames_sent;       // Since the output was switched on
+    uint32_t frames_skipped;    // Over the rate cap
+    uint32_t frames_rejected;   // Not carriable as RTP/JPEG
+    uint32_t send_errors;       // Frames abandoned on a socket error
+    uint32_t packets_sent;
+    uint32_t kbps;              // Sent rate (last window)
+    uint32_t avg_send_us;       // Average time to packetize and send one frame
+} rtp_mcast_stats_t;
+
+/**
+ * @brief Fill a configuration with the defaults
+ *
+ * @param config Configuration to populate
+ */
+void rtp_mcast_config_default(rtp_mcast_config_t *config);
+
+/**
+ * @brief Open the multicast socket (stream network task only)
+ *
+ * Replaces a session that is already open; the RTP sequence continues.
+ *
+ * @param config Settings
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG for a non-multicast
+ *         group, ESP_FAIL if the socket could not be set up
+ */
+esp_err_t rtp_mcast_open(const rtp_mcast_config_t *config);
+
+/**
+ * @brief Close the multicast socket (stream network task only)
+ */
+void rtp_mcast_close(void);
+
+/**
+ * @brief Whether the output is open (stream network task only)
+ */
+bool rtp_mcast_is_open(void);
+
+/**
+ * @brief Send one JPEG frame to the group (stream network task only)
+ *
+ * @param fb Frame
+ * @param timestamp_us Capture time
+ */
+void rtp_mcast_send_frame(const camera_fb_t *fb, int64_t timestamp_us);
+
+/**
+ * @brief Write the session description (RFC 4566) for a configuration
+ *
+ * @param config Settings of the running output
+ * @param origin_ip Device address for the o= line
+ * @param out Output buffer
+ * @param cap Its size
+ * @return Length written, excluding the terminator
+ */
+int rtp_mcast_sdp(const rtp_mcast_config_t *config, const char *origin_ip,
+                  char *out, size_t cap);
+
+/**
+ * @brief Get a snapshot of the statistics
+ *
+ * @param stats Pointer to structure to populate
+ */
+void rtp_mcast_get_stats(rtp_mcast_stats_t *stats);
+
+#endif // RTP_MCAST_H
@@ -0,0 +1,702 @@
+/**
+ * @file stream.c
+ * @brief Core-pinned MJPEG capture/network pipeline implementation
+ */
+
+#include "stream/stream.h"
+#include "stream/frame_queue.h"
+#include "stream/cond_replenish.h"
+#include "stream/rtp_mcast.h"
+#include "net/http_raw.h"
+#include "net/bw_estimator.h"
+#if CONFIG_GROWPOD_STATUS_EVENTS
+#include "net/status_events.h"
+#endif
+#include "camera/camera_service.h"
+#include "wifi/wifi.h"
+#include "esp_camera.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include <stdatomic.h>
+#include <stdio.h>
+
+static const char *TAG = "stream";
+
+// Frames are captured by the camera service on the driver's core;
+// networking runs on the other one
+#if CONFIG_CAMERA_CORE1
+#define STREAM_NETWORK_CORE 0
+#else
+#define STREAM_NETWORK_CORE 1
+#endif
+
+#define STREAM_NETWORK_PRIORITY   5
+// Deepest paths: a conditional-replenishment decode, an lwIP send of a
+// patch or RTP packet, and the float stats log. An estimated 3.5 KB with
+// the FPU save area; check stack_free_min at /debug/tasks after changes
+#define STREAM_NETWORK_STACK_SIZE 6144
+
+#define STREAM_FRAME_WAIT_MS      200      // Wake up at least this often while streaming
+#define STREAM_STATS_WINDOW_US    5000000  // Log throughput every 5 seconds
+#define STREAM_RSSI_INTERVAL_US   2000000  // Refresh adaptive clients' RSSI
+
+// Profile for fixed-quality clients
+#define STREAM_DEFAULT_FRAMESIZE  FRAMESIZE_VGA
+
+static frame_queue_t s_queue;
+static QueueHandle_t s_new_clients;       // Detached clients waiting for the network task
+static QueueHandle_t s_mcast_requests;    // Latest multicast on/off request
+static TaskHandle_t s_network_task;
+static uint32_t s_seq;                    // Frame sequence (camera service task only)
+
+static bool s_active;                     // Camera service is in stream mode (network task only)
+static atomic_int s_reserved;             // Connected plus pending clients
+static bool s_sink_paused;                // Network task is about to block on the camera service
+static portMUX_TYPE s_sink_lock = portMUX_INITIALIZER_UNLOCKED;
+
+/**
+ * @brief One connected stream client
+ */
+typedef struct {
+    httpd_req_t *req;       // Detached (async) request
+    int sockfd;             // Underlying socket, used by the raw path
+    int quality;            // Requested stream JPEG quality
+    bool raw;               // Vectored raw-socket sends instead of httpd chunks
+    bool adaptive;          // Profile follows the bandwidth estimate
+    bool cr;                // Conditional replenishment: patches and keep-alives
+    bw_estimator_t bw;      // Adaptive clients only
+} stream_client_t;
+
+/**
+ * @brief Multicast output request
+ */
+typedef struct {
+    bool on;
+    rtp_mcast_config_t config;
+} mcast_request_t;
+
+/**
+ * @brief Adaptive stream ladder
+ *
+ * Nominal frame sizes are typical OV2640 output for an indoor scene; the
+ * estimator rescales them by the measured size of the current rung.
+ */
+static const bw_ladder_t s_ladder = {
+    .rung_count = 6,
+    .rung_bytes = { 6000, 9000, 16000, 24000, 36000, 56000 },
+    .target_fps = 10.0f,
+    .down_hold_us = 1000000,
+    .up_hold_us = 4000000,
+    .min_dwell_us = 3000000,
+};
+
+static const struct {
+    framesize_t framesize;
+    int quality;
+} s_rungs[] = {
+    { FRAMESIZE_QVGA, 20 },
+    { FRAMESIZE_QVGA, 12 },
+    { FRAMESIZE_VGA,  16 },
+    { FRAMESIZE_VGA,  10 },
+    { FRAMESIZE_SVGA, 10 },
+    { FRAMESIZE_XGA,  10 },
+};
+
+// Owned by the network task
+static stream_client_t s_clients[STREAM_MAX_CLIENTS];
+static int s_client_count;
+
+// Sensor profile (network task only)
+static int s_fixed_quality = 8;           // Latest fixed-quality client's request
+static int s_mcast_quality;               // Multicast output's, while it is open
+static int s_applied_rung = -1;           // Adaptive rung in use, -1 for the fixed profile
+static bool s_profile_dirty;              // Clients or rungs changed since the last update
+
+// Per-path send timing for the current stats window (index 1 = raw)
+static int64_t s_window_path_us[2];
+static uint32_t s_window_path_sends[2];
+
+static stream_stats_t s_stats;
+static portMUX_TYPE s_stats_lock = portMUX_INITIALIZER_UNLOCKED;
+
+/**
+ * @brief Stream frame sink - runs in the camera service task
+ *
+ * This is the ring's only producer.
+ */
+static bool stream_sink(camera_fb_t *fb, int64_t timestamp_us, uint32_t gap_ms)
+{
+    frame_desc_t desc = {
+        .fb = fb,
+        .timestamp_us = timestamp_us,
+        .seq = s_seq++,
+        .gap_ms = gap_ms,
+    };
+
+    // Checked and pushed under one lock: once pause_sink() returns, no
+    // frame can arrive behind the drain that follows it
+    portENTER_CRITICAL(&s_sink_lock);
+    bool paused = s_sink_paused;
+    bool pushed = !paused && frame_queue_push(&s_queue, &desc);
+    portEXIT_CRITICAL(&s_sink_lock);
+    if (paused) {
+        return false;
+    }
+    if (!pushed) {
+        portENTER_CRITICAL(&s_stats_lock);
+        s_stats.frames_dropped++;
+        portEXIT_CRITICAL(&s_stats_lock);
+        return false;
+    }
+
+    xTaskNotifyGive(s_network_task);
+    return true;
+}
+
+/**
+ * @brief Complete a client's async request and free its slot
+ */
+static void remove_client(int index)
+{
+    stream_client_t *client = &s_clients[index];
+
+    // The multipart response never completes, so the session cannot be reused
+    httpd_sess_trigger_close(client->req->handle, client->sockfd);
+    httpd_req_async_handler_complete(client->req);
+    s_clients[index] = s_clients[--s_client_count];
+    atomic_fetch_sub(&s_reserved, 1);
+    s_profile_dirty = true;
+    ESP_LOGI(TAG, "Stream client disconnected (%d remaining)", s_client_count);
+}
+
+/**
+ * @brief Send one part with httpd chunked encoding (three chunks per part)
+ */
+static esp_err_t send_part_chunked(httpd_req_t *req, const char *part_buf, size_t hlen,
+                                   const uint8_t *data, size_t len)
+{
+    esp_err_t res = httpd_resp_send_chunk(req, part_buf, hlen);
+    // A zero-length chunk would end the response
+    if (res == ESP_OK && len > 0) {
+        res = httpd_resp_send_chunk(req, (const char *)data, len);
+    }
+    if (res == ESP_OK) {
+        res = httpd_resp_send_chunk(req, "\r\n", 2);
+    }
+    return res;
+}
+
+/**
+ * @brief Send one part as a single vectored write straight from its buffer
+ */
+static esp_err_t send_part_raw(int sockfd, const char *part_buf, size_t hlen,
+                               const uint8_t *data, size_t len)
+{
+    struct iovec iov[3] = {
+        { .iov_base = (void *)part_buf, .iov_len = hlen },
+        { .iov_base = (void *)data,     .iov_len = len },
+        { .iov_base = (void *)"\r\n",   .iov_len = 2 },
+    };
+    return http_raw_writev_all(sockfd, iov, 3);
+}
+
+static esp_err_t send_part(const stream_client_t *client, const char *part_buf, size_t hlen,
+                           const uint8_t *data, size_t len)
+{
+    return client->raw
+        ? send_part_raw(client->sockfd, part_buf, hlen, data, len)
+        : send_part_chunked(client->req, part_buf, hlen, data, len);
+}
+
+/**
+ * @brief Send a conditional-replenishment client what the frame calls for
+ *
+ * @param frame_hdr Whole-frame part header without its final CRLF
+ */
+static esp_err_t send_replenishment(const stream_client_t *client, const cr_frame_t *cr,
+                                    const char *frame_hdr, size_t frame_hlen,
+                                    const camera_fb_t *fb)
+{
+    char part_buf[160];
+    size_t hlen;
+
+    switch (cr->type) {
+    case CR_FRAME_KEY:
+        hlen = snprintf(part_buf, sizeof(part_buf), "%.*sX-CR-Type: key\r\n\r\n",
+                        (int)frame_hlen, frame_hdr);
+        return send_part(client, part_buf, hlen, fb->buf, fb->len);
+
+    case CR_FRAME_PATCHES:
+        for (int i = 0; i < cr->patch_count; i++) {
+            const cr_patch_t *patch = &cr->patches[i];
+            hlen = snprintf(part_buf, sizeof(part_buf),
+                            "--frame\r\n"
+                            "Content-Type: image/jpeg\r\n"
+                            "Content-Length: %u\r\n"
+                            "X-CR-Type: patch\r\n"
+                            "X-CR-Rect: %u,%u,%u,%u\r\n\r\n",
+                            patch->len, patch->x, patch->y, patch->width, patch->height);
+            esp_err_t res = send_part(client, part_buf, hlen, patch->data, patch->len);
+            if (res != ESP_OK) {
+                return res;
+            }
+        }
+        return ESP_OK;
+
+    case CR_FRAME_KEEPALIVE:
+        hlen = snprintf(part_buf, sizeof(part_buf),
+                        "--frame\r\n"
+                        "Content-Type: text/plain\r\n"
+                        "Content-Length: 0\r\n"
+                        "X-CR-Type: keepalive\r\n\r\n");
+        return send_part(client, part_buf, hlen, NULL, 0);
+
+    default:
+        return ESP_OK;
+    }
+}
+
+/**
+ * @brief Send one frame to every connected client, dropping failed ones
+ */
+static void send_frame_to_clients(const frame_desc_t *desc)
+{
+    char part_buf[128];
+    camera_fb_t *fb = desc->fb;
+
+    // MJPEG frame boundary and headers; a still capture's interruption is
+    // announced on the first frame after it
+    size_t hlen = snprintf(part_buf, sizeof(part_buf),
+                           "--frame\r\n"
+                           "Content-Type: image/jpeg\r\n"
+                           "Content-Length: %u\r\n",
+                           fb->len);
+    if (desc->gap_ms) {
+        hlen += snprintf(part_buf + hlen, sizeof(part_buf) - hlen,
+                         "X-Stream-Gap-Ms: %lu\r\n", (unsigned long)desc->gap_ms);
+    }
+    size_t cr_hlen = hlen;
+    hlen += snprintf(part_buf + hlen, sizeof(part_buf) - hlen, "\r\n");
+
+    // One replenishment decision for all conditional-replenishment clients
+    cr_frame_t cr = { .type = CR_FRAME_SKIP };
+    for (int i = 0; i < s_client_count; i++) {
+        if (s_clients[i].cr) {
+            cond_replenish_process(fb->buf, fb->len, desc->timestamp_us, &cr);
+#if CONFIG_GROWPOD_STATUS_EVENTS
+            status_events_post_motion(cr.changed_mcus, cr.total_mcus);
+#endif
+            break;
+        }
+    }
+
+    int i = 0;
+    while (i < s_client_count) {
+        stream_client_t *client = &s_clients[i];
+        int64_t start = esp_timer_get_time();
+        esp_err_t res = client->cr
+            ? send_replenishment(client, &cr, part_buf, cr_hlen, fb)
+            : send_part(client, part_buf, hlen, fb->buf, fb->len);
+        int64_t end = esp_timer_get_time();
+        s_window_path_us[client->raw] += end - start;
+        s_window_path_sends[client->raw]++;
+
+        if (res != ESP_OK) {
+            remove_client(i);
+            continue;
+        }
+
+        // Frames from the fixed profile say nothing about the ladder
+        if (client->adaptive && s_applied_rung >= 0) {
+            int old_rung = client->bw.rung;
+            if (bw_estimator_on_send(&client->bw, hlen + fb->len + 2, (uint32_t)(end - start),
+                                     s_applied_rung, end)) {
+                ESP_LOGI(TAG, "Client %d: rung %d -> %d (%.0f KB/s, blocking %.2f)", i,
+                         old_rung, client->bw.rung, bw_estimator_throughput(&client->bw) / 1000,
+                         client->bw.blocking);
+                s_profile_dirty = true;
+            }
+        }
+        i++;
+    }
+}
+
+/**
+ * @brief Start a newly adopted client's response
+ *
+ * Raw clients get a plain (non-chunked) header block written directly to the
+ * socket; chunked clients had their headers set in stream_add_client() and
+ * httpd sends them with the first chunk.
+ */
+static esp_err_t begin_client(stream_client_t *client)
+{
+    if (!client->raw) {
+        return ESP_OK;
+    }
+    return http_raw_send_headers(client->req, "200 OK",
+                                 "multipart/x-mixed-replace; boundary=frame", -1,
+                                 "Access-Control-Allow-Origin: *\r\n"
+                                 "X-Framerate: 10\r\n"
+                                 "Cache-Control: no-cache\r\n");
+}
+
+/**
+ * @brief Stop or resume queueing frames from the camera service
+ */
+static void pause_sink(bool paused)
+{
+    portENTER_CRITICAL(&s_sink_lock);
+    s_sink_paused = paused;
+    portEXIT_CRITICAL(&s_sink_lock);
+}
+
+/**
+ * @brief Return every frame still in the ring to the camera service
+ *
+ * Must be done before blocking on a service request: with a single frame
+ * buffer the service cannot grab its next frame while we hold one, and a
+ * mode change that restarts the driver waits for all of them. Pause the
+ * sink first and keep it paused until the request returns, so none
+ * arrive meanwhile.
+ */
+static void drain_ring(void)
+{
+    frame_desc_t desc;
+
+    while (frame_queue_pop(&s_queue, &desc)) {
+        camera_service_release(desc.fb);
+    }
+}
+
+/**
+ * @brief Apply the sensor profile the connected clients call for
+ *
+ * All clients share the sensor, so while any adaptive client is connected
+ * the slowest one's rung is used for everyone; a slow client holds up the
+ * fan-out for the others anyway. Otherwise the fixed profile is used with
+ * the latest fixed-quality client's setting.
+ *
+ * @param force Apply even if the profile did not change
+ * @return ESP_OK on success, or the camera service's error (e.g.
+ *         ESP_ERR_INVALID_STATE while an H.264 stream holds the sensor)
+ */
+static esp_err_t update_profile(bool force)
+{
+    int rung = -1;
+
+    for (int i = 0; i < s_client_count; i++) {
+        if (s_clients[i].adaptive && (rung < 0 || s_clients[i].bw.rung < rung)) {
+            rung = s_clients[i].bw.rung;
+        }
+    }
+    s_profile_dirty = false;
+    if (rung == s_applied_rung && !force) {
+        return ESP_OK;
+    }
+
+    pause_sink(true);
+    drain_ring();
+    esp_err_t err;
+    if (rung >= 0) {
+        ESP_LOGI(TAG, "Stream profile: rung %d (%s, quality %d)", rung,
+                 camera_framesize_name(s_rungs[rung].framesize), s_rungs[rung].quality);
+        err = camera_service_set_mode(CAMERA_MODE_STREAM, s_rungs[rung].framesize,
+                                      s_rungs[rung].quality);
+    } else {
+        err = camera_service_set_mode(CAMERA_MODE_STREAM, STREAM_DEFAULT_FRAMESIZE,
+                                      s_fixed_quality);
+    }
+    pause_sink(false);
+    if (err != ESP_OK) {
+        return err;
+    }
+    s_applied_rung = rung;
+    return ESP_OK;
+}
+
+/**
+ * @brief Leave stream mode and return any frames still in the ring
+ */
+static void stop_capture(void)
+{
+    pause_sink(true);
+    drain_ring();
+    // Once the service has switched back, it no longer pushes frames
+    camera_service_set_mode(CAMERA_MODE_STILL, 0, 0);
+    pause_sink(false);
+    s_active = false;
+    s_applied_rung = -1;
+    s_profile_dirty = false;
+    drain_ring();
+    cond_replenish_reset();
+}
+
+/**
+ * @brief Apply a pending multicast request
+ *
+ * The multicast output counts as a fixed-quality client with the
+ * configured quality.
+ *
+ * @return true if the output was switched on
+ */
+static bool apply_multicast_request(void)
+{
+    mcast_request_t req;
+
+    if (xQueueReceive(s_mcast_requests, &req, 0) != pdTRUE) {
+        return false;
+    }
+    if (!req.on) {
+        rtp_mcast_close();
+        s_profile_dirty = true;
+        return false;
+    }
+    if (rtp_mcast_open(&req.config) != ESP_OK) {
+        return false;
+    }
+
+    s_mcast_quality = req.config.quality;
+    s_fixed_quality = req.config.quality;
+    if (update_profile(true) != ESP_OK && !s_active) {
+        ESP_LOGW(TAG, "Camera unavailable, multicast not started");
+        rtp_mcast_close();
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Network task - adopts new clients and fans frames out to them
+ */
+static void network_task(void *arg)
+{
+    int64_t window_start = esp_timer_get_time();
+    uint32_t window_frames = 0;
+    int64_t window_send_us = 0;
+    int64_t last_rssi_us = 0;
+
+    while (true) {
+        // Block only while idle; new clients and multicast requests notify
+        if (s_client_count == 0 && !rtp_mcast_is_open()) {
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        }
+
+        if (apply_multicast_request() && !s_active) {
+            s_active = true;
+            window_start = esp_timer_get_time();
+            window_frames = 0;
+            window_send_us = 0;
+        }
+
+        // Adopt newly connected clients
+        stream_client_t client;
+        while (xQueueReceive(s_new_clients, &client, 0) == pdTRUE) {
+            if (client.adaptive) {
+                bw_estimator_init(&client.bw, &s_ladder, wifi_get_rssi(), esp_timer_get_time());
+            }
+            s_clients[s_client_count++] = client;
+            if (begin_client(&client) != ESP_OK) {
+                remove_client(s_client_count - 1);
+                continue;
+            }
+            ESP_LOGI(TAG, "Stream client connected (%d total, %s%s%s)",
+                     s_client_count, client.raw ? "raw" : "chunked",
+                     client.adaptive ? ", adaptive" : "",
+                     client.cr ? ", conditional replenishment" : "");
+            if (client.cr) {
+                // The newcomer needs a whole picture to draw patches on
+                cond_replenish_request_key();
+            }
+
+            // Latest fixed-quality client's quality wins
+            if (!client.adaptive) {
+                s_fixed_quality = client.quality;
+            }
+            if (update_profile(!client.adaptive || !s_active) != ESP_OK && !s_active) {
+                // Sensor taken (H.264 stream started in between); nothing will flow
+                ESP_LOGW(TAG, "Camera unavailable, dropping stream client");
+                remove_client(s_client_count - 1);
+                continue;
+            }
+            if (!s_active) {
+                s_active = true;
+                window_start = esp_timer_get_time();
+                window_frames = 0;
+                window_send_us = 0;
+            }
+        }
+
+        // Wait for the camera service to publish a frame
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(STREAM_FRAME_WAIT_MS));
+
+        frame_desc_t desc;
+        while (frame_queue_pop(&s_queue, &desc)) {
+            int64_t send_start = esp_timer_get_time();
+            send_frame_to_clients(&desc);
+            rtp_mcast_send_frame(desc.fb, desc.timestamp_us);
+            camera_service_release(desc.fb);
+
+            window_send_us += esp_timer_get_time() - send_start;
+            window_frames++;
+        }
+
+        int64_t now = esp_timer_get_time();
+        if (now - last_rssi_us >= STREAM_RSSI_INTERVAL_US) {
+            int rssi = wifi_get_rssi();
+            for (int i = 0; i < s_client_count; i++) {
+                // Fixed-quality clients' estimators were never initialised
+                if (s_clients[i].adaptive) {
+                    bw_estimator_set_rssi(&s_clients[i].bw, rssi);
+                }
+            }
+            last_rssi_us = now;
+        }
+        // The multicast output keeps the sensor in use without any clients
+        if (s_profile_dirty && (s_client_count > 0 || rtp_mcast_is_open())) {
+            // On its own again, it goes back to its configured quality
+            bool requality = s_client_count == 0 && s_fixed_quality != s_mcast_quality;
+            if (requality) {
+                s_fixed_quality = s_mcast_quality;
+            }
+            update_profile(requality);
+        }
+
+        if (now - window_start >= STREAM_STATS_WINDOW_US) {
+            float fps = window_frames * 1000000.0f / (now - window_start);
+            uint32_t avg_send_us = window_frames ? (uint32_t)(window_send_us / window_frames) : 0;
+            uint32_t avg_chunked_us = s_window_path_sends[0] ?
+                (uint32_t)(s_window_path_us[0] / s_window_path_sends[0]) : 0;
+            uint32_t avg_raw_us = s_window_path_sends[1] ?
+                (uint32_t)(s_window_path_us[1] / s_window_path_sends[1]) : 0;
+
+            portENTER_CRITICAL(&s_stats_lock);
+            s_stats.fps = fps;
+            s_stats.avg_send_us = avg_send_us;
+            s_stats.avg_chunked_us = avg_chunked_us;
+            s_stats.avg_raw_us = avg_raw_us;
+            s_stats.frames_sent += window_frames;
+            s_stats.rung = s_applied_rung;
+            portEXIT_CRITICAL(&s_stats_lock);
+
+            ESP_LOGI(TAG, "Stream: %.1f fps to %d client(s), avg send %lu us/frame "
+                     "(chunked %lu us, raw %lu us per client)",
+                     fps, s_client_count, (unsigned long)avg_send_us,
+                     (unsigned long)avg_chunked_us, (unsigned long)avg_raw_us);
+            window_start = now;
+            window_frames = 0;
+            window_send_us = 0;
+            s_window_path_us[0] = s_window_path_us[1] = 0;
+            s_window_path_sends[0] = s_window_path_sends[1] = 0;
+        }
+
+        portENTER_CRITICAL(&s_stats_lock);
+        s_stats.clients = s_client_count;
+        portEXIT_CRITICAL(&s_stats_lock);
+
+        if (s_client_count == 0 && !rtp_mcast_is_open() && s_active) {
+            stop_capture();
+            portENTER_CRITICAL(&s_stats_lock);
+            s_stats.fps = 0;
+            s_stats.frames_sent += window_frames;
+            s_stats.rung = -1;
+            portEXIT_CRITICAL(&s_stats_lock);
+            window_frames = 0;
+            ESP_LOGI(TAG, "Stream ended");
+        }
+    }
+}
+
+esp_err_t stream_init(void)
+{
+    frame_queue_init(&s_queue);
+    atomic_init(&s_reserved, 0);
+    s_stats.rung = -1;
+
+    s_new_clients = xQueueCreate(STREAM_MAX_CLIENTS, sizeof(stream_client_t));
+    if (s_new_clients == NULL) {
+        ESP_LOGE(TAG, "Failed to create stream client queue");
+        return ESP_ERR_NO_MEM;
+    }
+    s_mcast_requests = xQueueCreate(1, sizeof(mcast_request_t));
+    if (s_mcast_requests == NULL) {
+        ESP_LOGE(TAG, "Failed to create multicast request queue");
+        return ESP_ERR_NO_MEM;
+    }
+
+    if (xTaskCreatePinnedToCore(network_task, "stream_net", STREAM_NETWORK_STACK_SIZE, NULL,
+                                STREAM_NETWORK_PRIORITY, &s_network_task,
+                                STREAM_NETWORK_CORE) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create stream network task");
+        return ESP_ERR_NO_MEM;
+    }
+
+    camera_service_set_stream_sink(stream_sink);
+
+    ESP_LOGI(TAG, "Stream pipeline ready (network core %d)", STREAM_NETWORK_CORE);
+    return ESP_OK;
+}
+
+esp_err_t stream_add_client(httpd_req_t *req, int quality, bool raw, bool adaptive, bool cr)
+{
+    // The latest fixed-quality client's quality goes straight to the sensor
+    if (!camera_param_in_range(CAMERA_PARAM_QUALITY, quality)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (atomic_fetch_add(&s_reserved, 1) >= STREAM_MAX_CLIENTS) {
+        atomic_fetch_sub(&s_reserved, 1);
+        ESP_LOGW(TAG, "Rejecting stream client, %d already connected", STREAM_MAX_CLIENTS);
+        return ESP_ERR_NO_MEM;
+    }
+
+    // Set response headers for MJPEG stream (raw clients write their own)
+    if (!raw) {
+        httpd_resp_set_type(req, "multipart/x-mixed-replace; boundary=frame");
+        httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
+        httpd_resp_set_hdr(req, "X-Framerate", "10");
+    }
+
+    // Detach the request so the httpd task can return immediately
+    httpd_req_t *async_req = NULL;
+    esp_err_t err = httpd_req_async_handler_begin(req, &async_req);
+    if (err != ESP_OK) {
+        atomic_fetch_sub(&s_reserved, 1);
+        ESP_LOGE(TAG, "Failed to detach stream request: %s", esp_err_to_name(err));
+        return err;
+    }
+
+    stream_client_t client = {
+        .req = async_req,
+        .sockfd = httpd_req_to_sockfd(async_req),
+        .quality = quality,
+        .raw = raw,
+        .adaptive = adaptive && !cr,
+        .cr = cr,
+    };
+
+    // Cannot fail: the queue holds STREAM_MAX_CLIENTS and slots are reserved above
+    xQueueSend(s_new_clients, &client, 0);
+    xTaskNotifyGive(s_network_task);
+    return ESP_OK;
+}
+
+void stream_set_multicast(const rtp_mcast_config_t *config)
+{
+    mcast_request_t req = { .on = config != NULL };
+
+    if (config) {
+        req.config = *config;
+    }
+    // Only the latest request matters
+    xQueueOverwrite(s_mcast_requests, &req);
+    xTaskNotifyGive(s_network_task);
+}
+
+void stream_get_stats(stream_stats_t *stats)
+{
+    portENTER_CRITICAL(&s_stats_lock);
+    *stats = s_stats;
+    portEXIT_CRITICAL(&s_stats_lock);
+}
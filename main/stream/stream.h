@@ -0,0 +1,102 @@
+/**
+ * @file stream.h
+ * @brief Core-pinned MJPEG capture/network pipeline
+ *
+ * The camera service task (pinned to the camera driver's core) grabs frames
+ * and hands them through a lock-free SPSC ring to a network task pinned to
+ * the other core, which fans each frame out to every connected /stream
+ * client and, when switched on, to the multicast RTP/JPEG output.
+ * The httpd task only performs the hand-off and is free to serve other
+ * requests while streams are running.
+ */
+
+#ifndef STREAM_H
+#define STREAM_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "esp_http_server.h"
+#include "stream/rtp_mcast.h"
+
+// Maximum number of simultaneous /stream clients
+#define STREAM_MAX_CLIENTS 4
+
+/**
+ * @brief Stream pipeline statistics
+ */
+typedef struct {
+    uint32_t clients;           // Connected stream clients
+    float fps;                  // Frames delivered per second (last window)
+    uint32_t frames_sent;       // Frames delivered since boot
+    uint32_t frames_dropped;    // Frames dropped because the ring was full
+    uint32_t avg_send_us;       // Average time to send one frame to all clients
+    uint32_t avg_chunked_us;    // Average per-client frame send, httpd chunked path
+    uint32_t avg_raw_us;        // Average per-client frame send, raw vectored path
+    int rung;                   // Adaptive ladder rung in use, -1 for the fixed profile
+} stream_stats_t;
+
+/**
+ * @brief Create the frame ring, start the network task and register with
+ *        the camera service
+ *
+ * Must be called after camera_service_init(). Nothing is captured until
+ * the first client connects.
+ *
+ * @return ESP_OK on success, error code otherwise
+ */
+esp_err_t stream_init(void);
+
+/**
+ * @brief Hand a /stream request over to the network task
+ *
+ * Sets the multipart response headers, detaches the request from the httpd
+ * task and queues it for the network task. The caller must return from its
+ * handler immediately afterwards without touching the request.
+ *
+ * Raw clients bypass httpd's chunked encoding: the network task writes a
+ * plain header block and then one vectored write (boundary, JPEG, CRLF)
+ * per frame straight from the frame buffer.
+ *
+ * Adaptive clients get a bandwidth estimator that picks a framesize and
+ * quality rung from their send throughput, send blocking and the RSSI.
+ * The sensor is shared, so the lowest rung among adaptive clients is
+ * streamed to all clients while any is connected.
+ *
+ * Conditional-replenishment clients get whole frames only when needed:
+ * changed regions as cropped JPEG parts with an X-CR-Rect header and, on
+ * a static scene, an empty keep-alive part about once a second (see
+ * cond_replenish.h). Their send times say little about the link, so
+ * adaptive is ignored for them.
+ *
+ * @param req HTTP request from the /stream handler
+ * @param quality JPEG quality to stream with (0-63, lower is better),
+ *                ignored for adaptive clients
+ * @param raw true for the raw-socket sender, false for httpd chunks
+ * @param adaptive true to follow the bandwidth estimate
+ * @param cr true for conditional replenishment
+ * @return ESP_OK if the client was queued, ESP_ERR_NO_MEM if all slots are taken,
+ *         ESP_ERR_INVALID_ARG for a quality out of range
+ */
+esp_err_t stream_add_client(httpd_req_t *req, int quality, bool raw, bool adaptive, bool cr);
+
+/**
+ * @brief Switch the multicast RTP/JPEG output on or off
+ *
+ * Applied asynchronously by the network task. While on, the output keeps
+ * the stream running like a fixed-quality client and gets every frame
+ * after the HTTP clients. Calling again with new settings replaces them.
+ * Check rtp_mcast_get_stats() for the result.
+ *
+ * @param config Output settings, NULL to switch off
+ */
+void stream_set_multicast(const rtp_mcast_config_t *config);
+
+/**
+ * @brief Get a snapshot of the pipeline statistics
+ *
+ * @param stats Pointer to structure to populate
+ */
+void stream_get_stats(stream_stats_t *stats);
+
+#endif // STREAM_H
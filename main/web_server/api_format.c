@@ -0,0 +1,311 @@
+/**
+ * @file api_format.c
+ * @brief Status and control payload formatting implementation
+ */
+
+#include "web_server/api_format.h"
+#include "camera/camera_params.h"
+#include "net/cbor.h"
+#include <stdio.h>
+#include <string.h>
+
+// Longest parameter name camera_params.h defines, plus the NUL
+#define PARAM_NAME_MAX 16
+
+const char *api_resolution(framesize_t framesize, int *width, int *height)
+{
+    // Use sensor status to determine resolution
+    // Note: Frame buffer dimensions can be unreliable on some cameras
+    switch (framesize) {
+        case FRAMESIZE_QXGA:   *width = 2048; *height = 1536; return "QXGA";
+        case FRAMESIZE_UXGA:   *width = 1600; *height = 1200; return "UXGA";
+        case FRAMESIZE_SXGA:   *width = 1280; *height = 1024; return "SXGA";
+        case FRAMESIZE_XGA:    *width = 1024; *height = 768;  return "XGA";
+        case FRAMESIZE_SVGA:   *width = 800;  *height = 600;  return "SVGA";
+        case FRAMESIZE_VGA:    *width = 640;  *height = 480;  return "VGA";
+        case FRAMESIZE_HVGA:   *width = 480;  *height = 320;  return "HVGA";
+        case FRAMESIZE_CIF:    *width = 400;  *height = 296;  return "CIF";
+        case FRAMESIZE_QVGA:   *width = 320;  *height = 240;  return "QVGA";
+        default:               *width = 0;    *height = 0;    return "UNKNOWN";
+    }
+}
+
+int api_status_json(const api_status_t *status, char *buf, size_t size)
+{
+    const camera_status_t *st = &status->camera;
+    const stream_stats_t *stream_stats = &status->stream;
+    const rtp_mcast_stats_t *mcast_stats = &status->mcast;
+    const camera_service_stats_t *cam_stats = &status->service;
+    int width, height;
+    const char *resolution_name = api_resolution(st->framesize, &width, &height);
+
+    // Current camera state including all photographic parameters
+    int n = snprintf(buf, size,
+        "{"
+        "\"status\":\"ready\","
+        "\"camera\":\"OV3660\","
+        "\"resolution\":\"%s\","
+        "\"width\":%d,"
+        "\"height\":%d,"
+        "\"quality\":%d,"
+        "\"framesize\":%d,"
+        "\"format\":\"JPEG\","
+        "\"psram\":true,"
+        "\"aec\":%d,"
+        "\"aec_value\":%d,"
+        "\"ae_level\":%d,"
+        "\"gain_ctrl\":%d,"
+        "\"agc_gain\":%d,"
+        "\"brightness\":%d,"
+        "\"contrast\":%d,"
+        "\"saturation\":%d,"
+        "\"sharpness\":%d,"
+        "\"awb\":%d,"
+        "\"hmirror\":%d,"
+        "\"vflip\":%d,"
+        "\"stream_clients\":%lu,"
+        "\"stream_fps\":%.1f,"
+        "\"stream_send_us\":%lu,"
+        "\"stream_chunked_us\":%lu,"
+        "\"stream_raw_us\":%lu,"
+        "\"stream_rung\":%d,"
+        "\"cam_queue_us\":%lu,"
+        "\"cam_queue_max_us\":%lu,"
+        "\"still_us\":%lu,"
+        "\"stream_gap_ms\":%lu,"
+        "\"stream_gap_max_ms\":%lu,"
+        "\"stream_fbs\":%lu,"
+        "\"stream_fb_dram\":%d,"
+        "\"fb_restarts\":%lu,"
+        "\"mcast_active\":%d,"
+        "\"mcast_kbps\":%lu,"
+        "\"mcast_send_us\":%lu,"
+        "\"mcast_skipped\":%lu,",
+        resolution_name, width, height, st->quality, st->framesize,
+        st->aec, st->aec_value, st->ae_level,
+        st->agc, st->agc_gain,
+        st->brightness, st->contrast, st->saturation, st->sharpness,
+        st->awb, st->hmirror, st->vflip,
+        (unsigned long)stream_stats->clients, stream_stats->fps,
+        (unsigned long)stream_stats->avg_send_us,
+        (unsigned long)stream_stats->avg_chunked_us,
+        (unsigned long)stream_stats->avg_raw_us,
+        stream_stats->rung,
+        (unsigned long)cam_stats->avg_queue_us,
+        (unsigned long)cam_stats->max_queue_us,
+        (unsigned long)cam_stats->last_still_us,
+        (unsigned long)cam_stats->last_gap_ms,
+        (unsigned long)cam_stats->max_gap_ms,
+        (unsigned long)cam_stats->stream_fb_count,
+        cam_stats->stream_fb_dram,
+        (unsigned long)cam_stats->fb_restarts,
+        mcast_stats->active,
+        (unsigned long)mcast_stats->kbps,
+        (unsigned long)mcast_stats->avg_send_us,
+        (unsigned long)mcast_stats->frames_skipped);
+    // Truncated: stop before size - n wraps around
+    if (n < 0 || (size_t)n >= size) {
+        return -1;
+    }
+#if CONFIG_GROWPOD_H264_STREAM
+    const h264_stream_stats_t *h264_stats = &status->h264;
+    n += snprintf(buf + n, size - n,
+        "\"h264_clients\":%lu,"
+        "\"h264_fps\":%.1f,"
+        "\"h264_kbps\":%lu,"
+        "\"h264_encode_us\":%lu,"
+        "\"h264_qp\":%d,"
+        "\"h264_dropped\":%lu,",
+        (unsigned long)h264_stats->clients, h264_stats->fps,
+        (unsigned long)h264_stats->kbps,
+        (unsigned long)h264_stats->avg_encode_us,
+        h264_stats->qp,
+        (unsigned long)h264_stats->frames_dropped);
+    if (n < 0 || (size_t)n >= size) {
+        return -1;
+    }
+#endif
+#if CONFIG_GROWPOD_UDP_STILL
+    const udp_still_stats_t *udp_stats = &status->udp;
+    n += snprintf(buf + n, size - n,
+        "\"udp_transfers\":%lu,"
+        "\"udp_failures\":%lu,"
+        "\"udp_last_ms\":%lu,"
+        "\"udp_last_passes\":%lu,"
+        "\"udp_last_kbps\":%lu,",
+        (unsigned long)udp_stats->transfers,
+        (unsigned long)udp_stats->failures,
+        (unsigned long)udp_stats->last_ms,
+        (unsigned long)udp_stats->last_passes,
+        (unsigned long)udp_stats->last_kbps);
+    if (n < 0 || (size_t)n >= size) {
+        return -1;
+    }
+#endif
+#if CONFIG_GROWPOD_STATUS_EVENTS
+    n += snprintf(buf + n, size - n,
+        "\"events_clients\":%lu,",
+        (unsigned long)status->events.clients);
+    if (n < 0 || (size_t)n >= size) {
+        return -1;
+    }
+#endif
+#if CONFIG_GROWPOD_HEAP_MONITOR
+    n += snprintf(buf + n, size - n,
+        "\"heap_free\":%lu,"
+        "\"heap_largest\":%lu,"
+        "\"psram_free\":%lu,"
+        "\"psram_largest\":%lu,"
+        "\"psram_largest_min\":%lu,"
+        "\"psram_frag\":%u,"
+        "\"alloc_failures\":%lu,",
+        (unsigned long)status->heap.free,
+        (unsigned long)status->heap.largest,
+        (unsigned long)status->psram.free,
+        (unsigned long)status->psram.largest,
+        (unsigned long)status->psram.largest_min,
+        status->psram.frag_permille,
+        (unsigned long)status->alloc_failures);
+    if (n < 0 || (size_t)n >= size) {
+        return -1;
+    }
+#endif
+    // Replace the trailing comma; the length stays the same
+    buf[n - 1] = '}';
+    return n;
+}
+
+static void put_pair(cbor_writer_t *w, const char *key, int64_t value)
+{
+    cbor_put_text(w, key);
+    cbor_put_int(w, value);
+}
+
+size_t api_status_cbor(const api_status_t *status, uint8_t *buf, size_t size)
+{
+    const camera_status_t *st = &status->camera;
+    cbor_writer_t w;
+    int width, height;
+    const char *resolution_name = api_resolution(st->framesize, &width, &height);
+
+    // Indefinite length: the field count depends on the build configuration
+    cbor_writer_init(&w, buf, size);
+    cbor_put_map(&w, CBOR_INDEFINITE);
+    cbor_put_text(&w, "status");
+    cbor_put_text(&w, "ready");
+    cbor_put_text(&w, "camera");
+    cbor_put_text(&w, "OV3660");
+    cbor_put_text(&w, "resolution");
+    cbor_put_text(&w, resolution_name);
+    put_pair(&w, "width", width);
+    put_pair(&w, "height", height);
+    cbor_put_text(&w, "format");
+    cbor_put_text(&w, "JPEG");
+    cbor_put_text(&w, "psram");
+    cbor_put_bool(&w, true);
+
+    // Every /control parameter, keyed by its /control name
+    for (int i = 0; i < CAMERA_PARAM_COUNT; i++) {
+        put_pair(&w, camera_param_name(i), camera_param_get(st, i));
+    }
+
+    put_pair(&w, "stream_clients", status->stream.clients);
+    cbor_put_text(&w, "stream_fps");
+    cbor_put_float(&w, status->stream.fps);
+    put_pair(&w, "stream_send_us", status->stream.avg_send_us);
+    put_pair(&w, "stream_chunked_us", status->stream.avg_chunked_us);
+    put_pair(&w, "stream_raw_us", status->stream.avg_raw_us);
+    put_pair(&w, "stream_rung", status->stream.rung);
+    put_pair(&w, "cam_queue_us", status->service.avg_queue_us);
+    put_pair(&w, "cam_queue_max_us", status->service.max_queue_us);
+    put_pair(&w, "still_us", status->service.last_still_us);
+    put_pair(&w, "stream_gap_ms", status->service.last_gap_ms);
+    put_pair(&w, "stream_gap_max_ms", status->service.max_gap_ms);
+    put_pair(&w, "stream_fbs", status->service.stream_fb_count);
+    put_pair(&w, "stream_fb_dram", status->service.stream_fb_dram);
+    put_pair(&w, "fb_restarts", status->service.fb_restarts);
+    put_pair(&w, "mcast_active", status->mcast.active);
+    put_pair(&w, "mcast_kbps", status->mcast.kbps);
+    put_pair(&w, "mcast_send_us", status->mcast.avg_send_us);
+    put_pair(&w, "mcast_skipped", status->mcast.frames_skipped);
+#if CONFIG_GROWPOD_H264_STREAM
+    put_pair(&w, "h264_clients", status->h264.clients);
+    cbor_put_text(&w, "h264_fps");
+    cbor_put_float(&w, status->h264.fps);
+    put_pair(&w, "h264_kbps", status->h264.kbps);
+    put_pair(&w, "h264_encode_us", status->h264.avg_encode_us);
+    put_pair(&w, "h264_qp", status->h264.qp);
+    put_pair(&w, "h264_dropped", status->h264.frames_dropped);
+#endif
+#if CONFIG_GROWPOD_UDP_STILL
+    put_pair(&w, "udp_transfers", status->udp.transfers);
+    put_pair(&w, "udp_failures", status->udp.failures);
+    put_pair(&w, "udp_last_ms", status->udp.last_ms);
+    put_pair(&w, "udp_last_passes", status->udp.last_passes);
+    put_pair(&w, "udp_last_kbps", status->udp.last_kbps);
+#endif
+#if CONFIG_GROWPOD_STATUS_EVENTS
+    put_pair(&w, "events_clients", status->events.clients);
+#endif
+#if CONFIG_GROWPOD_HEAP_MONITOR
+    put_pair(&w, "heap_free", status->heap.free);
+    put_pair(&w, "heap_largest", status->heap.largest);
+    put_pair(&w, "psram_free", status->psram.free);
+    put_pair(&w, "psram_largest", status->psram.largest);
+    put_pair(&w, "psram_largest_min", status->psram.largest_min);
+    put_pair(&w, "psram_frag", status->psram.frag_permille);
+    put_pair(&w, "alloc_failures", status->alloc_failures);
+#endif
+    cbor_put_break(&w);
+    return cbor_writer_len(&w);
+}
+
+esp_err_t api_control_cbor(const uint8_t *buf, size_t len,
+                           camera_param_change_t *changes, int *count)
+{
+    cbor_reader_t r;
+    size_t pairs;
+    int n = 0;
+
+    cbor_reader_init(&r, buf, len);
+    if (cbor_get_map(&r, &pairs) != ESP_OK) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    for (size_t i = 0; pairs == CBOR_INDEFINITE || i < pairs; i++) {
+        const char *key;
+        size_t key_len;
+        char name[PARAM_NAME_MAX];
+        int64_t value;
+
+        if (pairs == CBOR_INDEFINITE && cbor_get_break(&r)) {
+            break;
+        }
+        if (n == CAMERA_PARAM_COUNT) {
+            return ESP_ERR_INVALID_SIZE;
+        }
+        if (cbor_get_text(&r, &key, &key_len) != ESP_OK ||
+            cbor_get_int(&r, &value) != ESP_OK ||
+            value < INT32_MIN || value > INT32_MAX) {
+            return ESP_ERR_INVALID_ARG;
+        }
+        if (key_len >= sizeof(name)) {
+            return ESP_ERR_NOT_FOUND;
+        }
+        memcpy(name, key, key_len);
+        name[key_len] = '\0';
+
+        changes[n].param = camera_param_find(name);
+        if (changes[n].param == CAMERA_PARAM_COUNT) {
+            return ESP_ERR_NOT_FOUND;
+        }
+        changes[n].value = (int)value;
+        n++;
+    }
+
+    if (!cbor_reader_done(&r)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    *count = n;
+    return ESP_OK;
+}
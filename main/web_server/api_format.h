@@ -0,0 +1,111 @@
+/**
+ * @file api_format.h
+ * @brief Status and control payloads in JSON and CBOR
+ *
+ * /status and /status.cbor carry the same fields under the same keys;
+ * the camera parameters among them are named by camera_params.h, which
+ * also names the keys /control and /control.cbor accept. JSON is built
+ * with snprintf, CBOR with the net/cbor.h writer. Neither formatter nor
+ * the CBOR control parser allocates, and none of them touch the camera,
+ * so they can be benchmarked on a host.
+ */
+
+#ifndef API_FORMAT_H
+#define API_FORMAT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "camera/camera_service.h"
+#include "stream/stream.h"
+#include "stream/rtp_mcast.h"
+#if CONFIG_GROWPOD_H264_STREAM
+#include "stream/h264_stream.h"
+#endif
+#if CONFIG_GROWPOD_UDP_STILL
+#include "net/udp_still.h"
+#endif
+#if CONFIG_GROWPOD_STATUS_EVENTS
+#include "net/status_events.h"
+#endif
+#if CONFIG_GROWPOD_HEAP_MONITOR
+#include "diag/heap_monitor.h"
+#endif
+
+// Large enough for every field with the widest values
+#define API_STATUS_JSON_SIZE    1408
+#define API_STATUS_CBOR_SIZE    1024
+
+/**
+ * @brief Everything /status reports, gathered once per request
+ */
+typedef struct {
+    camera_status_t camera;
+    camera_service_stats_t service;
+    stream_stats_t stream;
+    rtp_mcast_stats_t mcast;
+#if CONFIG_GROWPOD_H264_STREAM
+    h264_stream_stats_t h264;
+#endif
+#if CONFIG_GROWPOD_UDP_STILL
+    udp_still_stats_t udp;
+#endif
+#if CONFIG_GROWPOD_STATUS_EVENTS
+    status_events_stats_t events;
+#endif
+#if CONFIG_GROWPOD_HEAP_MONITOR
+    heap_mon_stats_t heap;              // Internal RAM
+    heap_mon_stats_t psram;
+    uint32_t alloc_failures;
+#endif
+} api_status_t;
+
+/**
+ * @brief Frame geometry reported for a framesize
+ *
+ * @param framesize Sensor framesize
+ * @param width Receives the width, 0 if unknown
+ * @param height Receives the height, 0 if unknown
+ * @return Framesize name, "UNKNOWN" if not one the web UI offers
+ */
+const char *api_resolution(framesize_t framesize, int *width, int *height);
+
+/**
+ * @brief Format the status as a JSON object
+ *
+ * @param status Gathered status
+ * @param buf Output buffer, API_STATUS_JSON_SIZE bytes
+ * @param size Its size
+ * @return Length of the NUL-terminated object, -1 if it did not fit
+ */
+int api_status_json(const api_status_t *status, char *buf, size_t size);
+
+/**
+ * @brief Format the status as a CBOR map with the JSON object's keys
+ *
+ * @param status Gathered status
+ * @param buf Output buffer, API_STATUS_CBOR_SIZE bytes
+ * @param size Its size
+ * @return Encoded length, 0 if buf was too small
+ */
+size_t api_status_cbor(const api_status_t *status, uint8_t *buf, size_t size);
+
+/**
+ * @brief Parse a CBOR control request
+ *
+ * The body is one map from parameter names to integers (booleans are
+ * accepted for on/off parameters), e.g. {"aec": 0, "aec_value": 400}.
+ * Nothing is returned unless the whole map is valid.
+ *
+ * @param buf Request body
+ * @param len Its length
+ * @param changes Receives the changes in map order, CAMERA_PARAM_COUNT entries
+ * @param count Receives the number of changes
+ * @return ESP_OK, ESP_ERR_INVALID_ARG for malformed CBOR, a non-integer
+ *         value or trailing data, ESP_ERR_NOT_FOUND for an unknown name,
+ *         ESP_ERR_INVALID_SIZE for more than CAMERA_PARAM_COUNT entries
+ */
+esp_err_t api_control_cbor(const uint8_t *buf, size_t len,
+                           camera_param_change_t *changes, int *count);
+
+#endif // API_FORMAT_H
@@ -0,0 +1,108 @@
+/**
+ * @file html_template.c
+ * @brief Streaming HTML template implementation
+ */
+
+#include "web_server/html_template.h"
+#include "esp_log.h"
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+static const char *TAG = "html_tmpl";
+
+struct html_tmpl {
+    httpd_req_t *req;
+    esp_err_t err;              // First error; everything after it is skipped
+    size_t len;
+    char buf[HTML_TMPL_BUF_SIZE];
+};
+
+static void flush(html_tmpl_t *out)
+{
+    if (out->err == ESP_OK && out->len > 0) {
+        out->err = httpd_resp_send_chunk(out->req, out->buf, out->len);
+    }
+    out->len = 0;
+}
+
+/**
+ * @brief Write static template text
+ *
+ * Text that fits the buffer is coalesced with its neighbours; anything
+ * longer is sent in place as its own chunk.
+ */
+static void put_static(html_tmpl_t *out, const char *text, size_t len)
+{
+    if (len <= sizeof(out->buf) - out->len) {
+        memcpy(out->buf + out->len, text, len);
+        out->len += len;
+        return;
+    }
+    flush(out);
+    if (out->err == ESP_OK) {
+        out->err = httpd_resp_send_chunk(out->req, text, len);
+    }
+}
+
+void html_tmpl_printf(html_tmpl_t *out, const char *fmt, ...)
+{
+    va_list args;
+    int n;
+
+    if (out->err != ESP_OK) {
+        return;
+    }
+    for (int attempt = 0; attempt < 2; attempt++) {
+        size_t room = sizeof(out->buf) - out->len;
+        va_start(args, fmt);
+        n = vsnprintf(out->buf + out->len, room, fmt, args);
+        va_end(args);
+        if (n >= 0 && (size_t)n < room) {
+            out->len += n;
+            return;
+        }
+        // Retry once with an empty buffer
+        flush(out);
+        if (out->err != ESP_OK) {
+            return;
+        }
+    }
+    ESP_LOGE(TAG, "Slot output of %d bytes does not fit", n);
+    out->err = ESP_ERR_INVALID_SIZE;
+}
+
+esp_err_t html_tmpl_send(httpd_req_t *req, const char *tmpl, html_tmpl_fill_t fill, void *ctx)
+{
+    html_tmpl_t out = { .req = req, .err = ESP_OK, .len = 0 };
+    const char *p = tmpl;
+
+    while (out.err == ESP_OK) {
+        const char *open = strstr(p, "{{");
+        const char *close = open ? strstr(open + 2, "}}") : NULL;
+        if (!close) {
+            put_static(&out, p, strlen(p));
+            break;
+        }
+        put_static(&out, p, open - p);
+
+        size_t name_len = close - (open + 2);
+        char slot[HTML_TMPL_SLOT_MAX + 1];
+        if (name_len > HTML_TMPL_SLOT_MAX) {
+            ESP_LOGW(TAG, "Slot name too long at offset %d", (int)(open - tmpl));
+        } else {
+            memcpy(slot, open + 2, name_len);
+            slot[name_len] = '\0';
+            if (fill(&out, slot, ctx) == ESP_ERR_NOT_FOUND) {
+                ESP_LOGW(TAG, "Unknown slot '%s'", slot);
+            }
+        }
+        p = close + 2;
+    }
+
+    flush(&out);
+    if (out.err == ESP_OK) {
+        out.err = httpd_resp_send_chunk(req, NULL, 0);
+    }
+    return out.err;
+}
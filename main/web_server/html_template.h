@@ -0,0 +1,62 @@
+/**
+ * @file html_template.h
+ * @brief Streaming HTML templates with live slots
+ *
+ * A template is an ordinary string literal with {{name}} slots. Rendering
+ * walks it once: static text between slots goes out as response chunks
+ * straight from flash, and each slot is filled by a callback that prints
+ * into a small stack buffer. Short pieces are coalesced in that buffer so
+ * a slot and the text around it share a chunk; nothing is allocated and
+ * the page is never held in memory as a whole.
+ *
+ * Slot output is written verbatim, so callbacks must only print values
+ * that are safe in their position (numbers, names from fixed tables).
+ */
+
+#ifndef HTML_TEMPLATE_H
+#define HTML_TEMPLATE_H
+
+#include "esp_err.h"
+#include "esp_http_server.h"
+
+// Coalescing buffer on the rendering handler's stack
+#define HTML_TMPL_BUF_SIZE  256
+
+// Longest slot name, without the braces
+#define HTML_TMPL_SLOT_MAX  23
+
+typedef struct html_tmpl html_tmpl_t;
+
+/**
+ * @brief Fill one slot
+ *
+ * @param out Output to print into with html_tmpl_printf()
+ * @param slot Slot name (NUL-terminated, without braces)
+ * @param ctx Context passed to html_tmpl_send()
+ * @return ESP_OK, or ESP_ERR_NOT_FOUND for an unknown slot (left empty)
+ */
+typedef esp_err_t (*html_tmpl_fill_t)(html_tmpl_t *out, const char *slot, void *ctx);
+
+/**
+ * @brief Render a template as a chunked response
+ *
+ * The caller sets the content type beforehand. The final empty chunk is
+ * sent here.
+ *
+ * @param req HTTP request to respond to
+ * @param tmpl Template text
+ * @param fill Slot callback
+ * @param ctx Passed to fill
+ * @return ESP_OK, or the first send error (rendering stops there)
+ */
+esp_err_t html_tmpl_send(httpd_req_t *req, const char *tmpl, html_tmpl_fill_t fill, void *ctx);
+
+/**
+ * @brief Print into a slot
+ *
+ * One call's output must fit HTML_TMPL_BUF_SIZE; longer output is
+ * dropped and rendering fails with ESP_ERR_INVALID_SIZE.
+ */
+void html_tmpl_printf(html_tmpl_t *out, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+
+#endif // HTML_TEMPLATE_H
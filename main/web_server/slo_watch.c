@@ -0,0 +1,173 @@
+/**
+ * @file slo_watch.c
+ * @brief Request latency SLO implementation
+ */
+
+#include "web_server/slo_watch.h"
+#include "camera/camera_service.h"
+#include "stream/stream.h"
+#include "wifi/wifi.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "lwip/sockets.h"
+#include <string.h>
+
+static const char *TAG = "slo_watch";
+
+// Sessions looked at when counting open sockets
+#define SLO_MAX_SESSIONS 16
+
+static const char *const ENDPOINT_NAMES[SLO_ENDPOINT_COUNT] = {
+    [SLO_CAPTURE]       = "capture",
+    [SLO_LAST]          = "last",
+    [SLO_CAPTURE_MULTI] = "capture_multi",
+    [SLO_STATUS]        = "status",
+    [SLO_CONTROL]       = "control",
+    [SLO_PAGE]          = "page",
+};
+
+// A QXGA still takes ~190 ms to capture and ~200 ms to send on a good
+// link; status and control wait behind at most one capture
+static slo_endpoint_stats_t s_stats[SLO_ENDPOINT_COUNT] = {
+    [SLO_CAPTURE]       = { .slo_ms = 1500 },
+    [SLO_LAST]          = { .slo_ms = 1000 },
+    [SLO_CAPTURE_MULTI] = { .slo_ms = 2500 },
+    [SLO_STATUS]        = { .slo_ms = 400 },
+    [SLO_CONTROL]       = { .slo_ms = 500 },
+    [SLO_PAGE]          = { .slo_ms = 400 },
+};
+
+static slo_record_t s_ring[SLO_RING_SIZE];
+static uint32_t s_recorded;     // Records written since the last clear
+
+/**
+ * @brief A duration for the 32-bit fields, saturated past 71 minutes
+ */
+static uint32_t clamp_us(int64_t us)
+{
+    return us < UINT32_MAX ? (uint32_t)us : UINT32_MAX;
+}
+
+/**
+ * @brief Fill in everything about the request's surroundings
+ */
+static void snapshot(slo_record_t *rec, httpd_req_t *req)
+{
+    int fd = httpd_req_to_sockfd(req);
+    struct sockaddr_in6 addr;
+    socklen_t len = sizeof(addr);
+
+    rec->peer[0] = '\0';
+    if (getpeername(fd, (struct sockaddr *)&addr, &len) == 0) {
+        if (addr.sin6_family == AF_INET) {
+            inet_ntop(AF_INET, &((struct sockaddr_in *)&addr)->sin_addr, rec->peer, sizeof(rec->peer));
+        } else {
+            inet_ntop(AF_INET6, &addr.sin6_addr, rec->peer, sizeof(rec->peer));
+        }
+    }
+    len = sizeof(rec->sock_err);
+    if (getsockopt(fd, SOL_SOCKET, SO_ERROR, &rec->sock_err, &len) != 0) {
+        rec->sock_err = -1;
+    }
+
+    int fds[SLO_MAX_SESSIONS];
+    size_t count = SLO_MAX_SESSIONS;
+    rec->open_sockets = httpd_get_client_list(req->handle, &count, fds) == ESP_OK ? (int)count : -1;
+
+    rec->rssi = wifi_get_rssi();
+    rec->heap_free = heap_caps_get_free_size(MALLOC_CAP_INTERNAL);
+    rec->heap_largest = heap_caps_get_largest_free_block(MALLOC_CAP_INTERNAL);
+    rec->psram_free = heap_caps_get_free_size(MALLOC_CAP_SPIRAM);
+    rec->psram_largest = heap_caps_get_largest_free_block(MALLOC_CAP_SPIRAM);
+
+    camera_service_stats_t cam_stats;
+    camera_service_get_stats(&cam_stats);
+    rec->cam_queue_max_us = cam_stats.max_queue_us;
+    stream_stats_t stream_stats;
+    stream_get_stats(&stream_stats);
+    rec->stream_clients = stream_stats.clients;
+}
+
+void slo_end(slo_trace_t *t, httpd_req_t *req)
+{
+    int64_t end = esp_timer_get_time();
+    int64_t total_us = end - t->marks[0];
+    slo_endpoint_stats_t *stats = &s_stats[t->endpoint];
+
+    stats->requests++;
+    stats->total_us += total_us;
+    if (total_us > stats->max_us) {
+        stats->max_us = clamp_us(total_us);
+    }
+    if (total_us <= (int64_t)stats->slo_ms * 1000) {
+        return;
+    }
+
+    // Breach: everything below only runs for slow requests
+    stats->breaches++;
+    slo_record_t *rec = &s_ring[s_recorded++ % SLO_RING_SIZE];
+    rec->at_us = end;
+    rec->endpoint = t->endpoint;
+    rec->total_us = clamp_us(total_us);
+    rec->phases = t->phases;
+    rec->bytes = t->bytes;
+    for (int i = 0; i < t->phases; i++) {
+        rec->names[i] = t->names[i];
+        rec->phase_us[i] = clamp_us(t->marks[i + 1] - t->marks[i]);
+    }
+    snapshot(rec, req);
+
+    ESP_LOGW(TAG, "Slow %s request: %lu ms (SLO %lu ms), RSSI %d dBm",
+             ENDPOINT_NAMES[t->endpoint], (unsigned long)(total_us / 1000),
+             (unsigned long)stats->slo_ms, rec->rssi);
+}
+
+const char *slo_endpoint_name(slo_endpoint_t endpoint)
+{
+    return endpoint < SLO_ENDPOINT_COUNT ? ENDPOINT_NAMES[endpoint] : "unknown";
+}
+
+slo_endpoint_t slo_endpoint_find(const char *name)
+{
+    for (int i = 0; i < SLO_ENDPOINT_COUNT; i++) {
+        if (strcmp(name, ENDPOINT_NAMES[i]) == 0) {
+            return i;
+        }
+    }
+    return SLO_ENDPOINT_COUNT;
+}
+
+esp_err_t slo_set_threshold(slo_endpoint_t endpoint, uint32_t slo_ms)
+{
+    if (endpoint >= SLO_ENDPOINT_COUNT || slo_ms == 0 || slo_ms > SLO_MAX_MS) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    s_stats[endpoint].slo_ms = slo_ms;
+    return ESP_OK;
+}
+
+void slo_get_stats(slo_endpoint_t endpoint, slo_endpoint_stats_t *stats)
+{
+    *stats = s_stats[endpoint];
+}
+
+bool slo_get_record(int index, slo_record_t *record)
+{
+    uint32_t stored = s_recorded < SLO_RING_SIZE ? s_recorded : SLO_RING_SIZE;
+
+    if (index < 0 || (uint32_t)index >= stored) {
+        return false;
+    }
+    *record = s_ring[(s_recorded - 1 - index) % SLO_RING_SIZE];
+    return true;
+}
+
+void slo_clear(void)
+{
+    s_recorded = 0;
+    for (int i = 0; i < SLO_ENDPOINT_COUNT; i++) {
+        uint32_t slo_ms = s_stats[i].slo_ms;
+        memset(&s_stats[i], 0, sizeof(s_stats[i]));
+        s_stats[i].slo_ms = slo_ms;
+    }
+}
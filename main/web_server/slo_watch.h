@@ -0,0 +1,143 @@
+/**
+ * @file slo_watch.h
+ * @brief Request latency SLOs and slow-request capture
+ *
+ * Handlers keep a trace on their stack: slo_begin() at entry, slo_mark()
+ * at the end of each phase, slo_end() when the response is out. That is
+ * one timestamp per call. Only a request over its endpoint's threshold
+ * costs more: its phase timings are copied into a ring of records
+ * together with a snapshot of the socket, RSSI, heap and camera queue,
+ * for /debug/slow.
+ *
+ * Called from the httpd task only, so the counters and ring need no lock.
+ */
+
+#ifndef SLO_WATCH_H
+#define SLO_WATCH_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "esp_timer.h"
+#include "esp_http_server.h"
+
+#define SLO_MAX_PHASES  6
+#define SLO_RING_SIZE   16
+#define SLO_MAX_MS      600000      // Longest threshold accepted, 10 minutes
+
+/**
+ * @brief Endpoints with their own threshold
+ */
+typedef enum {
+    SLO_CAPTURE,                // /capture
+    SLO_LAST,                   // /last
+    SLO_CAPTURE_MULTI,          // /capture_multi
+    SLO_STATUS,                 // /status, /status.cbor
+    SLO_CONTROL,                // /control, /control.cbor
+    SLO_PAGE,                   // /, /settings
+    SLO_ENDPOINT_COUNT
+} slo_endpoint_t;
+
+/**
+ * @brief Per-request trace, on the handler's stack
+ */
+typedef struct {
+    slo_endpoint_t endpoint;
+    uint8_t phases;
+    const char *names[SLO_MAX_PHASES];      // String literals
+    int64_t marks[SLO_MAX_PHASES + 1];      // Start, then each phase end
+    uint32_t bytes;                         // Response body, if the handler knows it
+} slo_trace_t;
+
+/**
+ * @brief A request that breached its threshold
+ */
+typedef struct {
+    int64_t at_us;              // Completion time
+    slo_endpoint_t endpoint;
+    uint32_t total_us;
+    uint8_t phases;
+    const char *names[SLO_MAX_PHASES];
+    uint32_t phase_us[SLO_MAX_PHASES];
+    uint32_t bytes;
+    char peer[40];              // Client address
+    int sock_err;               // Pending SO_ERROR on the socket
+    int open_sockets;           // httpd sessions at completion
+    int rssi;                   // dBm, 0 if not associated
+    uint32_t heap_free;         // Internal RAM
+    uint32_t heap_largest;
+    uint32_t psram_free;
+    uint32_t psram_largest;
+    uint32_t cam_queue_max_us;  // Worst camera service queue latency so far
+    uint32_t stream_clients;
+} slo_record_t;
+
+/**
+ * @brief Per-endpoint counters
+ */
+typedef struct {
+    uint32_t slo_ms;            // Threshold
+    uint32_t requests;
+    uint32_t breaches;
+    uint32_t max_us;            // Saturates at UINT32_MAX (71 minutes)
+    uint64_t total_us;          // For the average
+} slo_endpoint_stats_t;
+
+static inline void slo_begin(slo_trace_t *t, slo_endpoint_t endpoint)
+{
+    t->endpoint = endpoint;
+    t->phases = 0;
+    t->bytes = 0;
+    t->marks[0] = esp_timer_get_time();
+}
+
+/**
+ * @brief End the named phase (a string literal); phases past
+ *        SLO_MAX_PHASES are folded into the last one
+ */
+static inline void slo_mark(slo_trace_t *t, const char *phase)
+{
+    if (t->phases == SLO_MAX_PHASES) {
+        t->marks[SLO_MAX_PHASES] = esp_timer_get_time();
+        return;
+    }
+    t->names[t->phases++] = phase;
+    t->marks[t->phases] = esp_timer_get_time();
+}
+
+/**
+ * @brief Finish a trace; records it if it breached the threshold
+ */
+void slo_end(slo_trace_t *t, httpd_req_t *req);
+
+const char *slo_endpoint_name(slo_endpoint_t endpoint);
+
+/**
+ * @brief Endpoint by name, SLO_ENDPOINT_COUNT if unknown
+ */
+slo_endpoint_t slo_endpoint_find(const char *name);
+
+/**
+ * @brief Change an endpoint's threshold
+ *
+ * @return ESP_OK, or ESP_ERR_INVALID_ARG for an unknown endpoint or a
+ *         threshold outside 1..SLO_MAX_MS
+ */
+esp_err_t slo_set_threshold(slo_endpoint_t endpoint, uint32_t slo_ms);
+
+void slo_get_stats(slo_endpoint_t endpoint, slo_endpoint_stats_t *stats);
+
+/**
+ * @brief Copy a slow-request record, newest first
+ *
+ * @param index 0 for the newest
+ * @return false past the oldest record
+ */
+bool slo_get_record(int index, slo_record_t *record);
+
+/**
+ * @brief Drop all records and reset the counters
+ */
+void slo_clear(void);
+
+#endif // SLO_WATCH_H
@@ -4,20 +4,208 @@
  */
 
 #include "web_server/web_server.h"
+#include "web_server/api_format.h"
+#include "web_server/html_template.h"
+#include "web_server/slo_watch.h"
 #include "camera/camera.h"
-#include "settings/settings.h"
+#include "camera/camera_service.h"
+#include "camera/capture_store.h"
+#include "stream/stream.h"
+#include "stream/rtp_mcast.h"
+#if CONFIG_GROWPOD_H264_STREAM
+#include "stream/h264_stream.h"
+#endif
+#include "net/http_raw.h"
+#include "net/bounce_send.h"
+#include "net/bw_estimator.h"
+#include "net/udp_still.h"
+#include "net/status_events.h"
+#include "net/admission.h"
+#if CONFIG_GROWPOD_TASK_STATS
+#include "diag/task_stats.h"
+#endif
+#if CONFIG_GROWPOD_HEAP_MONITOR
+#include "diag/heap_monitor.h"
+#endif
+#if CONFIG_GROWPOD_XCLK_CAL
+#include "camera/xclk_cal.h"
+#endif
+#include "imgproc/multires.h"
+#include "jpeg/jpeg_optimize.h"
+#include "wifi/wifi.h"
 #include "esp_log.h"
 #include "esp_timer.h"
+#include "esp_heap_caps.h"
 #include "esp_camera.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "lwip/sockets.h"
+#include <stdarg.h>
+#include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
 
 static const char *TAG = "web_server";
 
+#if CONFIG_GROWPOD_BOUNCE_SEND
+#define BOUNCE_SEND_DEFAULT true
+#else
+#define BOUNCE_SEND_DEFAULT false
+#endif
+
+// A map of every parameter with long names and 32-bit values fits easily
+#define CONTROL_CBOR_MAX_BODY 256
+
+/**
+ * @brief snprintf() at buf + *len, for responses built piece by piece
+ *
+ * @return false if the output did not fit; *len then stays at the end of
+ *         the last piece that did, and later calls are safe to make
+ */
+static bool __attribute__((format(printf, 4, 5)))
+appendf(char *buf, size_t size, int *len, const char *fmt, ...)
+{
+    va_list args;
+
+    if (*len < 0 || (size_t)*len >= size) {
+        return false;
+    }
+    va_start(args, fmt);
+    int n = vsnprintf(buf + *len, size - *len, fmt, args);
+    va_end(args);
+    if (n < 0 || (size_t)n >= size - *len) {
+        buf[*len] = '\0';
+        return false;
+    }
+    *len += n;
+    return true;
+}
+
+#if CONFIG_GROWPOD_ADMISSION
+// Retry-After for a full stream limit; streams last, so there is no
+// refill time to report
+#define STREAMS_FULL_RETRY_S 10
+
+/**
+ * @brief Admission key for the request's peer address
+ */
+static uint32_t client_key(httpd_req_t *req)
+{
+    struct sockaddr_in6 addr;
+    socklen_t len = sizeof(addr);
+    uint32_t words[4];
+
+    if (getpeername(httpd_req_to_sockfd(req), (struct sockaddr *)&addr, &len) != 0) {
+        return 0;
+    }
+    if (addr.sin6_family == AF_INET) {
+        return ((struct sockaddr_in *)&addr)->sin_addr.s_addr;
+    }
+    // IPv6 (including IPv4-mapped) folds to 32 bits; a collision only
+    // makes two clients share a bucket
+    memcpy(words, &addr.sin6_addr, sizeof(words));
+    return words[0] ^ words[1] ^ words[2] ^ words[3];
+}
+
+/**
+ * @brief Answer a rejected request with 429 or 503 and Retry-After
+ */
+static void send_rejection(httpd_req_t *req, admit_result_t res, uint32_t retry_after_s)
+{
+    char retry_after[12];
+
+    snprintf(retry_after, sizeof(retry_after), "%lu", (unsigned long)retry_after_s);
+    httpd_resp_set_status(req, res == ADMIT_CLIENT_LIMITED ? "429 Too Many Requests"
+                                                           : "503 Service Unavailable");
+    httpd_resp_set_hdr(req, "Retry-After", retry_after);
+    httpd_resp_send(req, res == ADMIT_STREAMS_FULL ? "Too many streams" : "Rate limited",
+                    HTTPD_RESP_USE_STRLEN);
+}
+#endif
+
+/**
+ * @brief Admission control for a handler, before it does any work
+ *
+ * @return true to go on, false if the request was already answered
+ */
+static bool admit(httpd_req_t *req, admit_class_t cls)
+{
+#if CONFIG_GROWPOD_ADMISSION
+    uint32_t retry_after_s = 0;
+    admit_result_t res = admission_check(cls, client_key(req), esp_timer_get_time(), &retry_after_s);
+    if (res != ADMIT_OK) {
+        ESP_LOGW(TAG, "%s request rejected (%s), retry after %lu s", admission_class_name(cls),
+                 res == ADMIT_CLIENT_LIMITED ? "client" : "global", (unsigned long)retry_after_s);
+        send_rejection(req, res, retry_after_s);
+        return false;
+    }
+#endif
+    return true;
+}
+
+/**
+ * @brief Admission control for a new stream, including the stream limit
+ */
+static bool admit_stream(httpd_req_t *req)
+{
+#if CONFIG_GROWPOD_ADMISSION
+    stream_stats_t stream_stats;
+    stream_get_stats(&stream_stats);
+    uint32_t active = stream_stats.clients;
+#if CONFIG_GROWPOD_H264_STREAM
+    h264_stream_stats_t h264_stats;
+    h264_stream_get_stats(&h264_stats);
+    active += h264_stats.clients;
+#endif
+    if (admission_check_streams(active) != ADMIT_OK) {
+        ESP_LOGW(TAG, "Stream rejected, %lu running", (unsigned long)active);
+        send_rejection(req, ADMIT_STREAMS_FULL, STREAMS_FULL_RETRY_S);
+        return false;
+    }
+#endif
+    return admit(req, ADMIT_STREAM);
+}
+
+/**
+ * @brief Live values shown on the root page, gathered once per request
+ */
+typedef struct {
+    camera_service_stats_t camera;
+    stream_stats_t stream;
+} root_page_state_t;
+
+static esp_err_t root_fill_slot(html_tmpl_t *out, const char *slot, void *ctx)
+{
+    const root_page_state_t *state = ctx;
+    
+    if (strcmp(slot, "mode") == 0) {
+        html_tmpl_printf(out, "%s", camera_mode_name(state->camera.mode));
+    } else if (strcmp(slot, "resolution") == 0) {
+        int width, height;
+        const char *name = api_resolution(state->camera.still_framesize, &width, &height);
+        html_tmpl_printf(out, "%s (%dx%d)", name, width, height);
+    } else if (strcmp(slot, "quality") == 0) {
+        html_tmpl_printf(out, "%d", state->camera.still_quality);
+    } else if (strcmp(slot, "captures") == 0) {
+        html_tmpl_printf(out, "%lu", (unsigned long)state->camera.stills);
+    } else if (strcmp(slot, "viewers") == 0) {
+        html_tmpl_printf(out, "%lu", (unsigned long)state->stream.clients);
+    } else if (strcmp(slot, "uptime") == 0) {
+        uint32_t s = esp_timer_get_time() / 1000000;
+        html_tmpl_printf(out, "%luh %02lum", (unsigned long)(s / 3600), (unsigned long)(s / 60 % 60));
+    } else if (strcmp(slot, "rssi") == 0) {
+        html_tmpl_printf(out, "%d", wifi_get_rssi());
+    } else {
+        return ESP_ERR_NOT_FOUND;
+    }
+    return ESP_OK;
+}
+
 /**
  * @brief Root page handler - display status and links
+ *
+ * Status values come from the service counters, so rendering never waits
+ * on the camera.
  */
 static esp_err_t root_get_handler(httpd_req_t *req)
 {
@@ -40,11 +228,14 @@ static esp_err_t root_get_handler(httpd_req_t *req)
         "<div class=\"container\">"
         "<h1>GrowPod ESP32-S3 Camera</h1>"
         "<div class=\"status\">"
-        "<p><strong>Status:</strong> Ready</p>"
-        "<p><strong>Resolution:</strong> QXGA (2048x1536)</p>"
+        "<p><strong>Status:</strong> Ready ({{mode}} mode)</p>"
+        "<p><strong>Resolution:</strong> {{resolution}}, quality {{quality}}</p>"
         "<p><strong>Format:</strong> JPEG</p>"
+        "<p><strong>Captures:</strong> {{captures}} &middot; <strong>Stream viewers:</strong> {{viewers}}</p>"
+        "<p><strong>Uptime:</strong> {{uptime}} &middot; <strong>WiFi:</strong> {{rssi}} dBm</p>"
         "</div>"
         "<p><a class=\"button\" href=\"/preview\">Live Preview</a></p>"
+        "<p><a class=\"button\" href=\"/preview_cr\">Low-Bandwidth Preview</a></p>"
         "<p><a class=\"button\" href=\"/settings\">Camera Settings</a></p>"
         "<p><a class=\"button\" href=\"/capture\">Capture Image</a></p>"
         "<p><a class=\"button\" href=\"/status\">Get Status (JSON)</a></p>"
@@ -52,9 +243,17 @@ static esp_err_t root_get_handler(httpd_req_t *req)
         "</body>"
         "</html>";
     
+    slo_trace_t trace;
+    slo_begin(&trace, SLO_PAGE);
+    root_page_state_t state;
+    camera_service_get_stats(&state.camera);
+    stream_get_stats(&state.stream);
+    
     httpd_resp_set_type(req, "text/html");
-    httpd_resp_send(req, html, strlen(html));
-    return ESP_OK;
+    esp_err_t res = html_tmpl_send(req, html, root_fill_slot, &state);
+    slo_mark(&trace, "render");
+    slo_end(&trace, req);
+    return res;
 }
 
 /**
@@ -118,7 +317,117 @@ static esp_err_t preview_get_handler(httpd_req_t *req)
 }
 
 /**
- * @brief Camera settings page with current value retrieval
+ * @brief Low-bandwidth preview page - draws /stream?cr=1 on a canvas
+ *
+ * The script splits the multipart stream itself, draws whole frames and
+ * places patches at their X-CR-Rect position.
+ */
+static esp_err_t preview_cr_get_handler(httpd_req_t *req)
+{
+    const char* html = 
+        "<!DOCTYPE html>"
+        "<html>"
+        "<head>"
+        "<meta charset=\"UTF-8\">"
+        "<meta name=\"viewport\" content=\"width=device-width, initial-scale=1.0\">"
+        "<title>Low-Bandwidth Preview - GrowPod</title>"
+        "<style>"
+        "body { font-family: Arial, sans-serif; margin: 20px; background: #f5f5f5; text-align: center; }"
+        "h1 { color: #333; margin-bottom: 10px; }"
+        ".container { background: white; padding: 20px; border-radius: 8px; box-shadow: 0 2px 4px rgba(0,0,0,0.1); max-width: 700px; margin: 0 auto; }"
+        "canvas { width: 100%; max-width: 640px; height: auto; display: block; margin: 20px auto; background: #ddd; }"
+        ".button { display: inline-block; padding: 12px 24px; margin: 8px; background: #2196F3; color: white; text-decoration: none; border-radius: 4px; font-size: 16px; }"
+        ".status-text { color: #666; margin: 10px 0; font-style: italic; }"
+        "</style>"
+        "</head>"
+        "<body>"
+        "<div class=\"container\">"
+        "<h1>Low-Bandwidth Preview</h1>"
+        "<p class=\"status-text\">Only changed regions are sent</p>"
+        "<canvas id=\"view\" width=\"640\" height=\"480\"></canvas>"
+        "<p class=\"status-text\" id=\"stats\"></p>"
+        "<p><a class=\"button\" href=\"/preview\">Full Preview</a> <a class=\"button\" href=\"/\">Back to Home</a></p>"
+        "</div>"
+        "<script>"
+        "var canvas = document.getElementById('view'), ctx = canvas.getContext('2d');"
+        "var bytes = 0, parts = { key: 0, patch: 0, keepalive: 0 }, queue = Promise.resolve();"
+        "function draw(type, rect, body) {"
+        "  queue = queue.then(function() {"
+        "    return createImageBitmap(new Blob([body], { type: 'image/jpeg' })).then(function(img) {"
+        "      if (type == 'key') { canvas.width = img.width; canvas.height = img.height; }"
+        "      ctx.drawImage(img, type == 'key' ? 0 : rect[0], type == 'key' ? 0 : rect[1]);"
+        "    });"
+        "  });"
+        "}"
+        "function field(head, re, def) { var m = re.exec(head); return m ? m[1] : def; }"
+        "function run() {"
+        "  fetch('/stream?cr=1').then(function(res) {"
+        "    var reader = res.body.getReader(), buf = new Uint8Array(0), text = new TextDecoder();"
+        "    function pump() {"
+        "      return reader.read().then(function(r) {"
+        "        if (r.done) throw 0;"
+        "        bytes += r.value.length;"
+        "        var b = new Uint8Array(buf.length + r.value.length); b.set(buf); b.set(r.value, buf.length); buf = b;"
+        "        for (;;) {"
+        "          var end = -1;"
+        "          for (var i = 0; i + 3 < buf.length; i++) {"
+        "            if (buf[i] == 13 && buf[i + 1] == 10 && buf[i + 2] == 13 && buf[i + 3] == 10) { end = i; break; }"
+        "          }"
+        "          if (end < 0) break;"
+        "          var head = text.decode(buf.subarray(0, end));"
+        "          var len = +field(head, /Content-Length: (\\d+)/i, 0);"
+        "          if (buf.length < end + 6 + len) break;"
+        "          var type = field(head, /X-CR-Type: (\\w+)/i, 'key');"
+        "          parts[type] = (parts[type] || 0) + 1;"
+        "          if (len) draw(type, field(head, /X-CR-Rect: ([\\d,]+)/i, '0,0').split(',').map(Number), buf.slice(end + 4, end + 4 + len));"
+        "          buf = buf.slice(end + 6 + len);"
+        "        }"
+        "        return pump();"
+        "      });"
+        "    }"
+        "    return pump();"
+        "  }).catch(function() { setTimeout(run, 2000); });"
+        "}"
+        "setInterval(function() {"
+        "  document.getElementById('stats').textContent = (bytes / 1024).toFixed(1) + ' KB/s, ' +"
+        "    parts.key + ' whole frames, ' + parts.patch + ' patches, ' + parts.keepalive + ' keep-alives';"
+        "  bytes = 0;"
+        "}, 1000);"
+        "run();"
+        "</script>"
+        "</body>"
+        "</html>";
+    
+    httpd_resp_set_type(req, "text/html");
+    httpd_resp_send(req, html, strlen(html));
+    return ESP_OK;
+}
+
+static esp_err_t settings_fill_slot(html_tmpl_t *out, const char *slot, void *ctx)
+{
+    const camera_status_t *st = ctx;
+    
+    if (strcmp(slot, "params") != 0) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    if (!st) {
+        html_tmpl_printf(out, "null");
+        return ESP_OK;
+    }
+    // Every /control parameter, as /status names them
+    for (int i = 0; i < CAMERA_PARAM_COUNT; i++) {
+        html_tmpl_printf(out, "%c\"%s\":%d", i == 0 ? '{' : ',',
+                         camera_param_name(i), camera_param_get(st, i));
+    }
+    html_tmpl_printf(out, "}");
+    return ESP_OK;
+}
+
+/**
+ * @brief Camera settings page, rendered with the current values
+ *
+ * The values are inlined into the script, so the form is filled without
+ * a round trip to /status; /events keeps it current afterwards.
  */
 static esp_err_t settings_get_handler(httpd_req_t *req)
 {
@@ -194,36 +503,43 @@ static esp_err_t settings_get_handler(httpd_req_t *req)
         "</div>"
         "</div>"
         "<script>"
-        "document.getElementById('aec_value').oninput = function() {"
-        "  document.getElementById('aec_value_display').textContent = this.value;"
-        "};"
-        "document.getElementById('ae_level').oninput = function() {"
-        "  document.getElementById('ae_level_display').textContent = this.value;"
-        "};"
-        "document.getElementById('agc_gain').oninput = function() {"
-        "  document.getElementById('agc_gain_display').textContent = this.value;"
-        "};"
+        "var current = {{params}};"
+        "var edited = {};"
+        "['aec', 'aec_value', 'ae_level', 'gain_ctrl', 'agc_gain'].forEach(function(id) {"
+        "  var el = document.getElementById(id), display = document.getElementById(id + '_display');"
+        "  el.oninput = el.onchange = function() {"
+        "    edited[id] = true;"
+        "    if (display) display.textContent = this.value;"
+        "  };"
+        "});"
+        "function showSettings(data) {"
+        "  ['aec', 'aec_value', 'ae_level', 'gain_ctrl', 'agc_gain'].forEach(function(id) {"
+        "    if (!(id in data) || edited[id]) return;"
+        "    var el = document.getElementById(id), display = document.getElementById(id + '_display');"
+        "    el.value = el.tagName == 'SELECT' ? (data[id] ? '1' : '0') : data[id];"
+        "    if (display) display.textContent = data[id];"
+        "  });"
+        "  document.getElementById('loading').style.display = 'none';"
+        "  document.getElementById('settings').style.display = 'block';"
+        "}"
         "function loadCurrentSettings() {"
         "  fetch('/status')"
         "  .then(function(response) { return response.json(); })"
-        "  .then(function(data) {"
-        "    document.getElementById('aec').value = data.aec_sensor ? '1' : '0';"
-        "    document.getElementById('aec_value').value = data.aec_value || 300;"
-        "    document.getElementById('aec_value_display').textContent = data.aec_value || 300;"
-        "    document.getElementById('ae_level').value = data.ae_level || 0;"
-        "    document.getElementById('ae_level_display').textContent = data.ae_level || 0;"
-        "    document.getElementById('gain_ctrl').value = data.gain_ctrl ? '1' : '0';"
-        "    document.getElementById('agc_gain').value = data.agc_gain || 0;"
-        "    document.getElementById('agc_gain_display').textContent = data.agc_gain || 0;"
-        "    document.getElementById('loading').style.display = 'none';"
-        "    document.getElementById('settings').style.display = 'block';"
-        "  })"
+        "  .then(showSettings)"
         "  .catch(function(err) {"
         "    console.error('Error loading settings:', err);"
         "    document.getElementById('loading').textContent = 'Error loading settings. Using defaults.';"
         "    document.getElementById('settings').style.display = 'block';"
         "  });"
         "}"
+        "function followSettings() {"
+        "  var events = new EventSource('/events'), opened = false;"
+        "  events.addEventListener('state', function(e) { opened = true; showSettings(JSON.parse(e.data)); });"
+        "  events.addEventListener('params', function(e) { showSettings(JSON.parse(e.data)); });"
+        "  events.onerror = function() {"
+        "    if (!opened) { events.close(); loadCurrentSettings(); }"
+        "  };"
+        "}"
         "function applySettings() {"
         "  var status = document.getElementById('status');"
         "  status.textContent = 'Applying settings...';"
@@ -250,112 +566,378 @@ static esp_err_t settings_get_handler(httpd_req_t *req)
         "  });"
         "}"
         "window.onload = function() {"
-        "  loadCurrentSettings();"
+        "  if (current) showSettings(current);"
+        "  if (window.EventSource) followSettings(); else if (!current) loadCurrentSettings();"
         "};"
         "</script>"
         "</body>"
         "</html>";
     
+    slo_trace_t trace;
+    slo_begin(&trace, SLO_PAGE);
+    camera_status_t st;
+    bool have_status = camera_service_get_status(&st) == ESP_OK;
+    slo_mark(&trace, "read");
+    
     httpd_resp_set_type(req, "text/html");
-    httpd_resp_send(req, html, strlen(html));
-    return ESP_OK;
+    esp_err_t res = html_tmpl_send(req, html, settings_fill_slot, have_status ? &st : NULL);
+    slo_mark(&trace, "render");
+    slo_end(&trace, req);
+    return res;
 }
 
 /**
- * @brief MJPEG stream handler - provides live video feed
+ * @brief MJPEG stream handler - hands the connection to the stream pipeline
  */
 static esp_err_t stream_handler(httpd_req_t *req)
 {
-    camera_fb_t *fb = NULL;
-    esp_err_t res = ESP_OK;
-    char part_buf[128];
-    
-    ESP_LOGI(TAG, "Stream started");
-    
-    // Set response headers for MJPEG stream
-    httpd_resp_set_type(req, "multipart/x-mixed-replace; boundary=frame");
-    httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
-    httpd_resp_set_hdr(req, "X-Framerate", "10");
+    if (!admit_stream(req)) {
+        return ESP_OK;
+    }
     
-    // Get quality parameter from URL query (default to 8 for medium quality)
+    // Get quality parameter from URL query (default to 8 for medium quality),
+    // the send path (?raw=0 selects the httpd chunked sender), whether
+    // the profile follows the link (?adaptive=1) and whether only changes
+    // are sent (?cr=1)
     char query[64];
     int quality = 8;
+    bool raw = true;
+    bool adaptive = false;
+    bool cr = false;
     if (httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK) {
         char param[8];
         if (httpd_query_key_value(query, "quality", param, sizeof(param)) == ESP_OK) {
-            quality = atoi(param);
+            // The sensor's range; anything else would reach the profile as is
+            char *end;
+            long value = strtol(param, &end, 10);
+            if (end == param || *end != '\0' ||
+                !camera_param_in_range(CAMERA_PARAM_QUALITY, (int)value)) {
+                httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "quality must be 0-63");
+                return ESP_FAIL;
+            }
+            quality = (int)value;
             ESP_LOGI(TAG, "Stream quality parameter: %d", quality);
         }
+        if (httpd_query_key_value(query, "raw", param, sizeof(param)) == ESP_OK) {
+            raw = atoi(param) != 0;
+        }
+        if (httpd_query_key_value(query, "adaptive", param, sizeof(param)) == ESP_OK) {
+            adaptive = atoi(param) != 0;
+        }
+        if (httpd_query_key_value(query, "cr", param, sizeof(param)) == ESP_OK) {
+            cr = atoi(param) != 0;
+        }
     }
     
-    // Temporarily switch to lower resolution for streaming
-    sensor_t *s = esp_camera_sensor_get();
-    if (s == NULL) {
-        ESP_LOGE(TAG, "Failed to get camera sensor");
+#if CONFIG_GROWPOD_H264_STREAM
+    // The sensor is in YUV mode while an H.264 stream runs
+    if (h264_stream_active()) {
+        httpd_resp_set_status(req, "503 Service Unavailable");
+        httpd_resp_send(req, "H.264 stream running", HTTPD_RESP_USE_STRLEN);
+        return ESP_OK;
+    }
+#endif
+
+    // Frames are captured and sent by the core-pinned pipeline tasks;
+    // this handler returns as soon as the connection has been handed over
+    esp_err_t res = stream_add_client(req, quality, raw, adaptive, cr);
+    if (res == ESP_ERR_NO_MEM) {
+        httpd_resp_set_status(req, "503 Service Unavailable");
+        httpd_resp_send(req, "Too many stream clients", HTTPD_RESP_USE_STRLEN);
+        return ESP_OK;
+    }
+    if (res != ESP_OK) {
+        httpd_resp_send_500(req);
         return ESP_FAIL;
     }
     
-    // Save original settings
-    framesize_t original_framesize = s->status.framesize;
-    int original_quality = s->status.quality;
-    
-    ESP_LOGI(TAG, "Original framesize: %d, quality: %d", original_framesize, original_quality);
-    
-    // Set streaming settings (VGA = 640x480 for smooth streaming)
-    s->set_framesize(s, FRAMESIZE_VGA);
-    s->set_quality(s, quality);
+    ESP_LOGI(TAG, "Stream started");
+    return ESP_OK;
+}
+
+#if CONFIG_GROWPOD_H264_STREAM
+/**
+ * @brief H.264 stream handler - fragmented MP4 from the software encoder
+ */
+static esp_err_t stream_mp4_handler(httpd_req_t *req)
+{
+    if (!admit_stream(req)) {
+        return ESP_OK;
+    }
     
-    ESP_LOGI(TAG, "Set stream to VGA, quality: %d", quality);
+    // ?framesize=VGA&bitrate=250000&gop=50 (bitrate=0 for constant QP)
+    framesize_t framesize = FRAMESIZE_VGA;
+    int bitrate = CONFIG_GROWPOD_H264_BITRATE;
+    int gop = CONFIG_GROWPOD_H264_GOP;
+    char query[96];
+    if (httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK) {
+        char param[16];
+        if (httpd_query_key_value(query, "framesize", param, sizeof(param)) == ESP_OK) {
+            framesize = camera_framesize_find(param);
+            if (framesize == FRAMESIZE_INVALID) {
+                httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Unknown framesize");
+                return ESP_FAIL;
+            }
+        }
+        if (httpd_query_key_value(query, "bitrate", param, sizeof(param)) == ESP_OK) {
+            bitrate = atoi(param);
+            if (bitrate < 0) {
+                bitrate = CONFIG_GROWPOD_H264_BITRATE;
+            }
+        }
+        if (httpd_query_key_value(query, "gop", param, sizeof(param)) == ESP_OK) {
+            gop = atoi(param);
+            if (gop < 1 || gop > 1000) {
+                gop = CONFIG_GROWPOD_H264_GOP;
+            }
+        }
+    }
+
+    stream_stats_t stream_stats;
+    rtp_mcast_stats_t mcast_stats;
+    stream_get_stats(&stream_stats);
+    rtp_mcast_get_stats(&mcast_stats);
+    if (stream_stats.clients > 0 || mcast_stats.active) {
+        httpd_resp_set_status(req, "503 Service Unavailable");
+        httpd_resp_send(req, "MJPEG stream running", HTTPD_RESP_USE_STRLEN);
+        return ESP_OK;
+    }
+
+    esp_err_t res = h264_stream_add_client(req, framesize, bitrate, gop);
+    if (res == ESP_ERR_NO_MEM) {
+        httpd_resp_set_status(req, "503 Service Unavailable");
+        httpd_resp_send(req, "Too many H.264 clients", HTTPD_RESP_USE_STRLEN);
+        return ESP_OK;
+    }
+    if (res != ESP_OK) {
+        httpd_resp_send_500(req);
+        return ESP_FAIL;
+    }
+
+    ESP_LOGI(TAG, "H.264 stream started");
+    return ESP_OK;
+}
+#endif
+
+/**
+ * @brief Multicast control handler - switches the RTP/JPEG output
+ *
+ * Without parameters, reports the current state.
+ */
+static esp_err_t multicast_handler(httpd_req_t *req)
+{
+    if (!admit(req, ADMIT_CONTROL)) {
+        return ESP_OK;
+    }
     
-    // Stream frames continuously
-    while (true) {
-        fb = esp_camera_fb_get();
-        if (!fb) {
-            ESP_LOGE(TAG, "Camera capture failed during stream");
-            res = ESP_FAIL;
-            break;
+    // ?on=1&group=239.255.42.42&port=5004&ttl=1&kbps=4000&quality=12, ?on=0
+    char query[160];
+    if (httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK) {
+        char param[20];
+        rtp_mcast_config_t config;
+        rtp_mcast_config_default(&config);
+
+        if (httpd_query_key_value(query, "on", param, sizeof(param)) == ESP_OK &&
+            atoi(param) == 0) {
+            stream_set_multicast(NULL);
+            httpd_resp_set_type(req, "application/json");
+            httpd_resp_sendstr(req, "{\"on\":false}");
+            return ESP_OK;
         }
-        
-        // Send MJPEG frame boundary and headers
-        size_t hlen = snprintf(part_buf, sizeof(part_buf),
-                              "--frame\r\n"
-                              "Content-Type: image/jpeg\r\n"
-                              "Content-Length: %u\r\n\r\n",
-                              fb->len);
-        
-        res = httpd_resp_send_chunk(req, part_buf, hlen);
-        if (res != ESP_OK) {
-            esp_camera_fb_return(fb);
-            break;
+        if (httpd_query_key_value(query, "group", param, sizeof(param)) == ESP_OK) {
+            struct in_addr group;
+            if (inet_aton(param, &group) == 0 || !IN_MULTICAST(ntohl(group.s_addr))) {
+                httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Not a multicast group");
+                return ESP_FAIL;
+            }
+            strlcpy(config.group, param, sizeof(config.group));
         }
-        
-        // Send JPEG data
-        res = httpd_resp_send_chunk(req, (const char *)fb->buf, fb->len);
-        if (res != ESP_OK) {
-            esp_camera_fb_return(fb);
-            break;
+        if (httpd_query_key_value(query, "port", param, sizeof(param)) == ESP_OK) {
+            int port = atoi(param);
+            if (port < 1024 || port > 65534 || (port & 1)) {
+                httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Port must be even, 1024-65534");
+                return ESP_FAIL;
+            }
+            config.port = port;
         }
-        
-        // Send final boundary
-        res = httpd_resp_send_chunk(req, "\r\n", 2);
-        if (res != ESP_OK) {
-            esp_camera_fb_return(fb);
-            break;
+        if (httpd_query_key_value(query, "ttl", param, sizeof(param)) == ESP_OK) {
+            int ttl = atoi(param);
+            config.ttl = (ttl < 1) ? 1 : (ttl > 32) ? 32 : ttl;
         }
-        
-        esp_camera_fb_return(fb);
-        fb = NULL;
-        
-        // Small delay between frames (100ms = ~10 FPS)
-        vTaskDelay(pdMS_TO_TICKS(100));
+        if (httpd_query_key_value(query, "kbps", param, sizeof(param)) == ESP_OK) {
+            int kbps = atoi(param);
+            // A frame larger than one second's budget would never go out
+            config.max_kbps = (kbps <= 0) ? 0 : (kbps < 500) ? 500 : (kbps > 20000) ? 20000 : kbps;
+        }
+        if (httpd_query_key_value(query, "quality", param, sizeof(param)) == ESP_OK) {
+            int quality = atoi(param);
+            config.quality = (quality < 4) ? 4 : (quality > 63) ? 63 : quality;
+        }
+
+#if CONFIG_GROWPOD_H264_STREAM
+        if (h264_stream_active()) {
+            httpd_resp_set_status(req, "503 Service Unavailable");
+            httpd_resp_sendstr(req, "H.264 stream running");
+            return ESP_OK;
+        }
+#endif
+        stream_set_multicast(&config);
+
+        char json[192];
+        snprintf(json, sizeof(json),
+                 "{\"on\":true,\"group\":\"%s\",\"port\":%u,\"ttl\":%u,"
+                 "\"kbps\":%lu,\"quality\":%d,\"sdp\":\"/multicast.sdp\"}",
+                 config.group, config.port, config.ttl,
+                 (unsigned long)config.max_kbps, config.quality);
+        httpd_resp_set_type(req, "application/json");
+        httpd_resp_sendstr(req, json);
+        return ESP_OK;
+    }
+
+    rtp_mcast_stats_t st;
+    rtp_mcast_get_stats(&st);
+    char json[320];
+    snprintf(json, sizeof(json),
+             "{\"on\":%s,\"group\":\"%s\",\"port\":%u,\"ttl\":%u,\"kbps\":%lu,"
+             "\"quality\":%d,\"frames_sent\":%lu,\"frames_skipped\":%lu,"
+             "\"frames_rejected\":%lu,\"send_errors\":%lu,\"packets_sent\":%lu,"
+             "\"sent_kbps\":%lu,\"send_us\":%lu}",
+             st.active ? "true" : "false", st.config.group, st.config.port, st.config.ttl,
+             (unsigned long)st.config.max_kbps, st.config.quality,
+             (unsigned long)st.frames_sent, (unsigned long)st.frames_skipped,
+             (unsigned long)st.frames_rejected, (unsigned long)st.send_errors,
+             (unsigned long)st.packets_sent, (unsigned long)st.kbps,
+             (unsigned long)st.avg_send_us);
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_sendstr(req, json);
+    return ESP_OK;
+}
+
+/**
+ * @brief Session description of the running multicast output
+ */
+static esp_err_t multicast_sdp_handler(httpd_req_t *req)
+{
+    rtp_mcast_stats_t st;
+    rtp_mcast_get_stats(&st);
+    if (!st.active) {
+        httpd_resp_send_err(req, HTTPD_404_NOT_FOUND, "Multicast is off");
+        return ESP_FAIL;
+    }
+
+    // Origin: the address this client reached us on
+    struct sockaddr_in local;
+    socklen_t local_len = sizeof(local);
+    char origin[16] = "0.0.0.0";
+    if (getsockname(httpd_req_to_sockfd(req), (struct sockaddr *)&local, &local_len) == 0) {
+        inet_ntoa_r(local.sin_addr, origin, sizeof(origin));
+    }
+
+    char sdp[320];
+    int len = rtp_mcast_sdp(&st.config, origin, sdp, sizeof(sdp));
+    httpd_resp_set_type(req, "application/sdp");
+    httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
+    httpd_resp_send(req, sdp, len);
+    return ESP_OK;
+}
+
+/**
+ * @brief Fixed-capacity output buffer for the JPEG optimizer
+ */
+typedef struct {
+    uint8_t *data;
+    size_t len;
+    size_t cap;
+} optimize_buf_t;
+
+static esp_err_t optimize_buf_append(const uint8_t *data, size_t len, void *ctx)
+{
+    optimize_buf_t *buf = ctx;
+    
+    if (len > buf->cap - buf->len) {
+        return ESP_ERR_NO_MEM;
+    }
+    memcpy(buf->data + buf->len, data, len);
+    buf->len += len;
+    return ESP_OK;
+}
+
+/**
+ * @brief Re-encode a captured JPEG with optimized Huffman tables
+ *
+ * @param fb Captured frame
+ * @param quality Requantize to this quality (1-100), 0 for a lossless re-code
+ * @param len Receives the optimized length
+ * @return PSRAM copy to free with heap_caps_free(), or NULL to send the
+ *         original frame
+ */
+static uint8_t *optimize_capture(const camera_fb_t *fb, int quality, size_t *len)
+{
+    if (fb->format != PIXFORMAT_JPEG) {
+        return NULL;
     }
     
-    // Restore original settings
-    s->set_framesize(s, original_framesize);
-    s->set_quality(s, original_quality);
+    // Optimal tables shrink the scan in practice; leave room for a larger DHT
+    optimize_buf_t buf = { .cap = fb->len + 1024 };
+    buf.data = heap_caps_malloc(buf.cap, MALLOC_CAP_SPIRAM);
+    if (buf.data == NULL) {
+        ESP_LOGW(TAG, "No memory for optimized copy, sending original");
+        return NULL;
+    }
     
-    ESP_LOGI(TAG, "Stream ended");
-    return res;
+    jpeg_optimize_stats_t stats;
+    esp_err_t err = quality > 0
+        ? jpeg_requantize(fb->buf, fb->len, quality, optimize_buf_append, &buf, &stats)
+        : jpeg_optimize(fb->buf, fb->len, optimize_buf_append, &buf, &stats);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Re-encoding failed (%s), sending original", esp_err_to_name(err));
+        heap_caps_free(buf.data);
+        return NULL;
+    }
+    
+    ESP_LOGI(TAG, "%s: %u -> %u bytes (%.1f%% saved, count %lu us, encode %lu us)",
+             quality > 0 ? "Requantized" : "Huffman optimized", stats.in_len, stats.out_len,
+             100.0f * ((float)stats.in_len - stats.out_len) / stats.in_len,
+             (unsigned long)stats.count_us, (unsigned long)stats.encode_us);
+    *len = buf.len;
+    return buf.data;
+}
+
+/**
+ * @brief Adaptive capture ladder
+ *
+ * Batched captures share one sensor profile, so a connection adapts by
+ * requantizing its copy in the DCT domain instead of changing the
+ * framesize. Nominal sizes are for a UXGA indoor scene; the estimator
+ * rescales them by what it measures.
+ */
+static const bw_ladder_t s_capture_ladder = {
+    .rung_count = 6,
+    .rung_bytes = { 32000, 52000, 74000, 108000, 157000, 350000 },
+    .target_fps = 0.5f,         // A still should arrive within two seconds
+};
+
+// Requantization quality per rung, 0 = the sensor's own encoding
+static const int s_capture_rung_quality[] = { 20, 40, 60, 75, 85, 0 };
+
+/**
+ * @brief Per-connection estimator for /capture?adaptive=1
+ *
+ * Lives in the httpd session context and is freed with the session.
+ */
+static bw_estimator_t *capture_estimator(httpd_req_t *req)
+{
+    if (req->sess_ctx == NULL) {
+        bw_estimator_t *bw = malloc(sizeof(bw_estimator_t));
+        if (bw == NULL) {
+            return NULL;
+        }
+        bw_estimator_init(bw, &s_capture_ladder, wifi_get_rssi(), esp_timer_get_time());
+        req->sess_ctx = bw;
+    } else {
+        bw_estimator_set_rssi(req->sess_ctx, wifi_get_rssi());
+    }
+    return req->sess_ctx;
 }
 
 /**
@@ -363,118 +945,527 @@ static esp_err_t stream_handler(httpd_req_t *req)
  */
 static esp_err_t capture_handler(httpd_req_t *req)
 {
-    int64_t start_time = esp_timer_get_time();
+    if (!admit(req, ADMIT_CAPTURE)) {
+        return ESP_OK;
+    }
+    
+    slo_trace_t trace;
+    slo_begin(&trace, SLO_CAPTURE);
+    int64_t start_time = trace.marks[0];
     
     ESP_LOGI(TAG, "Image capture requested");
     
-    // Capture image
-    camera_fb_t *fb = camera_capture_image();
+    // ?bounce=0 selects the plain httpd_resp_send path for comparison
+    bool use_bounce = BOUNCE_SEND_DEFAULT;
+    // ?optimize=1 re-codes the JPEG losslessly with optimized Huffman tables
+    bool optimize = false;
+    // ?adaptive=1 picks a quality for this connection's measured bandwidth
+    bool adaptive = false;
+    char query[64];
+    if (httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK) {
+        char param[8];
+        if (httpd_query_key_value(query, "bounce", param, sizeof(param)) == ESP_OK) {
+            use_bounce = use_bounce && atoi(param) != 0;
+        }
+        if (httpd_query_key_value(query, "optimize", param, sizeof(param)) == ESP_OK) {
+            optimize = atoi(param) != 0;
+        }
+        if (httpd_query_key_value(query, "adaptive", param, sizeof(param)) == ESP_OK) {
+            adaptive = atoi(param) != 0;
+        }
+    }
+    bw_estimator_t *bw = adaptive ? capture_estimator(req) : NULL;
+    int rung = bw ? bw->rung : -1;
+    int quality = rung >= 0 ? s_capture_rung_quality[rung] : 0;
+    
+    // Capture image (concurrent requests may share one frame)
+    camera_fb_t *fb = camera_service_capture();
+    slo_mark(&trace, "capture");
     if (!fb) {
         const char* error_msg = "Failed to capture image";
         httpd_resp_set_status(req, "500 Internal Server Error");
         httpd_resp_send(req, error_msg, strlen(error_msg));
+        slo_end(&trace, req);
         return ESP_FAIL;
     }
     
-    int64_t capture_time = esp_timer_get_time();
+    int64_t capture_time = trace.marks[trace.phases];
     ESP_LOGI(TAG, "Image captured: %d bytes, %dx%d (capture: %lld ms)", 
              fb->len, fb->width, fb->height,
              (capture_time - start_time) / 1000);
     
-    // Send image
-    ESP_LOGI(TAG, "Starting image transfer (%d bytes)...", fb->len);
-    httpd_resp_set_type(req, "image/jpeg");
-    httpd_resp_set_hdr(req, "Content-Disposition", "inline; filename=capture.jpg");
+    const uint8_t *body = fb->buf;
+    size_t body_len = fb->len;
+    uint8_t *optimized = (optimize || quality > 0) ? optimize_capture(fb, quality, &body_len) : NULL;
+    if (optimized) {
+        body = optimized;
+    }
+    char original_len[16];
+    snprintf(original_len, sizeof(original_len), "%u", fb->len);
+    char rung_str[8];
+    char estimate_str[16];
+    if (bw) {
+        snprintf(rung_str, sizeof(rung_str), "%d", rung);
+        snprintf(estimate_str, sizeof(estimate_str), "%.0f", bw_estimator_throughput(bw));
+    }
     
-    esp_err_t res = httpd_resp_send(req, (const char *)fb->buf, fb->len);
+    // Send image
+    ESP_LOGI(TAG, "Starting image transfer (%u bytes)...", body_len);
+    slo_mark(&trace, "prepare");
+    int64_t send_start = trace.marks[trace.phases];
+    esp_err_t res;
+#if CONFIG_GROWPOD_BOUNCE_SEND
+    if (use_bounce) {
+        // Bounce path writes its own headers so the body can go out in pieces
+        // with a Content-Length instead of chunked encoding
+        char extra[192];
+        int n = snprintf(extra, sizeof(extra),
+                         "Content-Disposition: inline; filename=capture.jpg\r\n");
+        if (optimized) {
+            n += snprintf(extra + n, sizeof(extra) - n, "X-Original-Length: %s\r\n",
+                          original_len);
+        }
+        if (bw) {
+            snprintf(extra + n, sizeof(extra) - n,
+                     "X-Adaptive-Rung: %s\r\nX-Bandwidth-Estimate: %s\r\n",
+                     rung_str, estimate_str);
+        }
+        res = http_raw_send_headers(req, "200 OK", "image/jpeg", body_len, extra);
+        if (res == ESP_OK) {
+            res = bounce_send(req, body, body_len);
+        }
+    } else
+#endif
+    {
+        httpd_resp_set_type(req, "image/jpeg");
+        httpd_resp_set_hdr(req, "Content-Disposition", "inline; filename=capture.jpg");
+        if (optimized) {
+            httpd_resp_set_hdr(req, "X-Original-Length", original_len);
+        }
+        if (bw) {
+            httpd_resp_set_hdr(req, "X-Adaptive-Rung", rung_str);
+            httpd_resp_set_hdr(req, "X-Bandwidth-Estimate", estimate_str);
+        }
+        res = httpd_resp_send(req, (const char *)body, body_len);
+    }
+    heap_caps_free(optimized);
     
-    int64_t send_time = esp_timer_get_time();
-    ESP_LOGI(TAG, "Image sent (send: %lld ms, total: %lld ms)", 
+    slo_mark(&trace, "send");
+    trace.bytes = body_len;
+    int64_t send_time = trace.marks[trace.phases];
+    if (bw && res == ESP_OK &&
+        bw_estimator_on_send(bw, body_len, (uint32_t)(send_time - send_start), rung, send_time)) {
+        ESP_LOGI(TAG, "Adaptive capture: rung %d -> %d (%.0f KB/s)", rung, bw->rung,
+                 bw_estimator_throughput(bw) / 1000);
+    }
+    ESP_LOGI(TAG, "Image sent via %s path (send: %lld ms, total: %lld ms)", 
+             use_bounce ? "bounce" : "direct",
              (send_time - capture_time) / 1000,
              (send_time - start_time) / 1000);
     
+    // Keep a copy for /last (after the transfer, so it adds no latency)
+    capture_store_put(fb);
+    
     // Return frame buffer
-    esp_camera_fb_return(fb);
+    camera_service_release(fb);
     
+    slo_mark(&trace, "store");
+    slo_end(&trace, req);
     return res;
 }
 
+// Chunked responses of generated data are batched to this size
+#define CHUNK_SINK_SIZE (8 * 1024)
+
 /**
- * @brief Status handler - returns JSON status
+ * @brief Collects small output pieces into larger response chunks
  */
-static esp_err_t status_handler(httpd_req_t *req)
+typedef struct {
+    httpd_req_t *req;
+    uint8_t *buf;
+    size_t len;
+    size_t sent;                // Bytes already sent as chunks
+} chunk_sink_t;
+
+static esp_err_t chunk_sink_flush(chunk_sink_t *sink)
 {
-    sensor_t *s = esp_camera_sensor_get();
-    if (s == NULL) {
-        httpd_resp_send_500(req);
-        return ESP_FAIL;
+    if (sink->len == 0) {
+        return ESP_OK;
     }
-    
-    int width = 0, height = 0;
-    const char* resolution_name = "UNKNOWN";
-    int quality = s->status.quality;
-    int framesize = s->status.framesize;
-    
-    // Use sensor status to determine resolution
-    // Note: Frame buffer dimensions can be unreliable on some cameras
-    switch (s->status.framesize) {
-        case FRAMESIZE_QXGA:   width = 2048; height = 1536; resolution_name = "QXGA"; break;
-        case FRAMESIZE_UXGA:   width = 1600; height = 1200; resolution_name = "UXGA"; break;
-        case FRAMESIZE_SXGA:   width = 1280; height = 1024; resolution_name = "SXGA"; break;
-        case FRAMESIZE_XGA:    width = 1024; height = 768;  resolution_name = "XGA"; break;
-        case FRAMESIZE_SVGA:   width = 800;  height = 600;  resolution_name = "SVGA"; break;
-        case FRAMESIZE_VGA:    width = 640;  height = 480;  resolution_name = "VGA"; break;
-        case FRAMESIZE_HVGA:   width = 480;  height = 320;  resolution_name = "HVGA"; break;
-        case FRAMESIZE_CIF:    width = 400;  height = 296;  resolution_name = "CIF"; break;
-        case FRAMESIZE_QVGA:   width = 320;  height = 240;  resolution_name = "QVGA"; break;
-        default:               width = 0;    height = 0;    resolution_name = "UNKNOWN"; break;
-    }
-    
-    ESP_LOGI(TAG, "Status: sensor.framesize=%d (%s %dx%d), quality=%d",
-             framesize, resolution_name, width, height, quality);
-    
-    // Build JSON response with current camera state including all photographic parameters
-    char json_response[512];
-    snprintf(json_response, sizeof(json_response),
-        "{"
-        "\"status\":\"ready\","
-        "\"camera\":\"OV3660\","
-        "\"resolution\":\"%s\","
-        "\"width\":%d,"
-        "\"height\":%d,"
-        "\"quality\":%d,"
-        "\"framesize\":%d,"
-        "\"format\":\"JPEG\","
-        "\"psram\":true,"
-        "\"aec\":%d,"
-        "\"aec_value\":%d,"
-        "\"ae_level\":%d,"
-        "\"gain_ctrl\":%d,"
-        "\"agc_gain\":%d,"
-        "\"brightness\":%d,"
-        "\"contrast\":%d,"
-        "\"saturation\":%d,"
-        "\"sharpness\":%d,"
-        "\"awb\":%d,"
-        "\"hmirror\":%d,"
-        "\"vflip\":%d"
-        "}",
-        resolution_name, width, height, quality, framesize,
-        s->status.aec, s->status.aec_value, s->status.ae_level,
-        s->status.agc, s->status.agc_gain,
-        s->status.brightness, s->status.contrast, s->status.saturation, s->status.sharpness,
-        s->status.awb, s->status.hmirror, s->status.vflip);
-    
+    esp_err_t res = httpd_resp_send_chunk(sink->req, (const char *)sink->buf, sink->len);
+    sink->sent += sink->len;
+    sink->len = 0;
+    return res;
+}
+
+static esp_err_t chunk_sink_write(const uint8_t *data, size_t len, void *ctx)
+{
+    chunk_sink_t *sink = ctx;
+    
+    while (len > 0) {
+        size_t n = CHUNK_SINK_SIZE - sink->len;
+        if (n > len) {
+            n = len;
+        }
+        memcpy(sink->buf + sink->len, data, n);
+        sink->len += n;
+        data += n;
+        len -= n;
+        if (sink->len == CHUNK_SINK_SIZE) {
+            esp_err_t res = chunk_sink_flush(sink);
+            if (res != ESP_OK) {
+                return res;
+            }
+        }
+    }
+    return ESP_OK;
+}
+
+/**
+ * @brief Last capture handler - serve the stored capture, optionally smaller
+ *
+ * ?quality=N (1-100) requantizes the stored JPEG in the DCT domain and
+ * streams the result as it is coded; without it the copy is sent as is.
+ */
+static esp_err_t last_handler(httpd_req_t *req)
+{
+    if (!admit(req, ADMIT_CAPTURE)) {
+        return ESP_OK;
+    }
+    
+    int quality = 0;
+    char query[64];
+    if (httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK) {
+        char param[8];
+        if (httpd_query_key_value(query, "quality", param, sizeof(param)) == ESP_OK) {
+            quality = atoi(param);
+            if (quality < 1 || quality > 100) {
+                httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "quality must be 1-100");
+                return ESP_FAIL;
+            }
+        }
+    }
+    
+    slo_trace_t trace;
+    slo_begin(&trace, SLO_LAST);
+    
+    capture_snapshot_t *snap = capture_store_get();
+    if (snap == NULL) {
+        httpd_resp_send_err(req, HTTPD_404_NOT_FOUND, "No capture stored yet");
+        slo_end(&trace, req);
+        return ESP_FAIL;
+    }
+    slo_mark(&trace, "lookup");
+    
+    char age[24];
+    char original_len[16];
+    snprintf(age, sizeof(age), "%lld", (esp_timer_get_time() - snap->timestamp_us) / 1000);
+    snprintf(original_len, sizeof(original_len), "%u", snap->len);
+    httpd_resp_set_type(req, "image/jpeg");
+    httpd_resp_set_hdr(req, "Content-Disposition", "inline; filename=last.jpg");
+    httpd_resp_set_hdr(req, "X-Capture-Age-Ms", age);
+    
+    esp_err_t res = ESP_FAIL;
+    chunk_sink_t sink = { .req = req };
+    if (quality > 0) {
+        sink.buf = heap_caps_malloc(CHUNK_SINK_SIZE, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    }
+    if (sink.buf) {
+        httpd_resp_set_hdr(req, "X-Original-Length", original_len);
+        jpeg_optimize_stats_t stats;
+        res = jpeg_requantize(snap->data, snap->len, quality, chunk_sink_write, &sink, &stats);
+        if (res == ESP_OK) {
+            res = chunk_sink_flush(&sink);
+        }
+        if (res == ESP_OK) {
+            res = httpd_resp_send_chunk(req, NULL, 0);
+            ESP_LOGI(TAG, "Requantized last capture to q%d: %u -> %u bytes "
+                     "(count %lu us, encode %lu us)", quality, stats.in_len, stats.out_len,
+                     (unsigned long)stats.count_us, (unsigned long)stats.encode_us);
+        } else {
+            ESP_LOGW(TAG, "Requantization failed: %s", esp_err_to_name(res));
+        }
+        heap_caps_free(sink.buf);
+    }
+    
+    // Nothing sent yet (no quality, no memory, unsupported image): send as is
+    if (res != ESP_OK && sink.sent == 0) {
+        res = httpd_resp_send(req, (const char *)snap->data, snap->len);
+        sink.sent = snap->len;
+    }
+    
+    capture_store_release(snap);
+    slo_mark(&trace, "send");
+    trace.bytes = sink.sent;
+    slo_end(&trace, req);
+    return res;
+}
+
+#if CONFIG_GROWPOD_YUV_MULTIRES
+/**
+ * @brief Send one multires output as a multipart/mixed part
+ */
+static esp_err_t send_multires_part(const multires_output_t *out, void *ctx)
+{
+    httpd_req_t *req = ctx;
+    char part_buf[192];
+    
+    size_t hlen = snprintf(part_buf, sizeof(part_buf),
+                           "--multires\r\n"
+                           "Content-Type: image/jpeg\r\n"
+                           "Content-Length: %u\r\n"
+                           "X-Resolution: %s %dx%d\r\n"
+                           "X-Timing-Us: scale=%lu encode=%lu\r\n\r\n",
+                           out->len, camera_framesize_name(out->framesize),
+                           out->width, out->height,
+                           (unsigned long)out->scale_us, (unsigned long)out->encode_us);
+    esp_err_t res = httpd_resp_send_chunk(req, part_buf, hlen);
+    if (res == ESP_OK) {
+        res = httpd_resp_send_chunk(req, (const char *)out->jpeg, out->len);
+    }
+    if (res == ESP_OK) {
+        res = httpd_resp_send_chunk(req, "\r\n", 2);
+    }
+    return res;
+}
+
+/**
+ * @brief Multi-resolution capture handler - several JPEGs from one frame
+ *
+ * Captures one YUV422 frame at the largest requested size and returns a
+ * multipart/mixed response with one JPEG part per size.
+ */
+static esp_err_t capture_multi_handler(httpd_req_t *req)
+{
+    if (!admit(req, ADMIT_CAPTURE)) {
+        return ESP_OK;
+    }
+    
+    framesize_t sizes[MULTIRES_MAX_OUTPUTS] = { FRAMESIZE_QXGA, FRAMESIZE_VGA };
+    int count = 2;
+    int quality = 80;
+    jpeg_qtable_t qtable = JPEG_QTABLE_ANNEX_K;
+    downscale_kernel_t kernel = DOWNSCALE_KERNEL_SWAR;
+    
+    // ?sizes=QXGA,VGA,QVGA&quality=80&tables=flat&kernel=scalar
+    char query[128];
+    if (httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK) {
+        char param[64];
+        if (httpd_query_key_value(query, "sizes", param, sizeof(param)) == ESP_OK) {
+            count = 0;
+            for (char *name = strtok(param, ","); name && count < MULTIRES_MAX_OUTPUTS;
+                 name = strtok(NULL, ",")) {
+                framesize_t fs = camera_framesize_find(name);
+                if (fs == FRAMESIZE_INVALID) {
+                    httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Unknown size");
+                    return ESP_FAIL;
+                }
+                sizes[count++] = fs;
+            }
+        }
+        if (httpd_query_key_value(query, "quality", param, sizeof(param)) == ESP_OK) {
+            quality = atoi(param);
+            if (quality < 1 || quality > 100) {
+                quality = 80;
+            }
+        }
+        if (httpd_query_key_value(query, "tables", param, sizeof(param)) == ESP_OK &&
+            strcmp(param, "flat") == 0) {
+            qtable = JPEG_QTABLE_FLAT;
+        }
+        if (httpd_query_key_value(query, "kernel", param, sizeof(param)) == ESP_OK &&
+            strcmp(param, "scalar") == 0) {
+            kernel = DOWNSCALE_KERNEL_SCALAR;
+        }
+    }
+    if (count == 0) {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "No sizes");
+        return ESP_FAIL;
+    }
+    
+    // Capture at the largest requested size
+    framesize_t largest = sizes[0];
+    for (int i = 1; i < count; i++) {
+        if (resolution[sizes[i]].width > resolution[largest].width) {
+            largest = sizes[i];
+        }
+    }
+    
+    slo_trace_t trace;
+    slo_begin(&trace, SLO_CAPTURE_MULTI);
+    int64_t start_time = trace.marks[0];
+    camera_fb_t *fb = NULL;
+    esp_err_t err = camera_service_capture_yuv(largest, &fb);
+    slo_mark(&trace, "capture");
+    if (err == ESP_ERR_INVALID_STATE) {
+        httpd_resp_set_status(req, "503 Service Unavailable");
+        httpd_resp_sendstr(req, "Multi-resolution capture unavailable while streaming");
+        slo_end(&trace, req);
+        return ESP_FAIL;
+    } else if (err != ESP_OK) {
+        httpd_resp_send_500(req);
+        slo_end(&trace, req);
+        return ESP_FAIL;
+    }
+    ESP_LOGI(TAG, "YUV frame captured: %dx%d (capture: %lld ms)",
+             fb->width, fb->height, (esp_timer_get_time() - start_time) / 1000);
+    
+    httpd_resp_set_type(req, "multipart/mixed; boundary=multires");
+    err = multires_encode(fb, sizes, count, quality, qtable, kernel, send_multires_part, req);
+    camera_service_release(fb);
+    if (err != ESP_OK) {
+        slo_end(&trace, req);
+        return ESP_FAIL;
+    }
+    
+    httpd_resp_send_chunk(req, "--multires--\r\n", 14);
+    httpd_resp_send_chunk(req, NULL, 0);
+    slo_mark(&trace, "encode+send");
+    slo_end(&trace, req);
+    ESP_LOGI(TAG, "Multi-resolution capture sent (total: %lld ms)",
+             (esp_timer_get_time() - start_time) / 1000);
+    return ESP_OK;
+}
+#endif
+
+/**
+ * @brief Gather everything /status and /status.cbor report
+ */
+static esp_err_t read_status(api_status_t *status)
+{
+    esp_err_t err = camera_service_get_status(&status->camera);
+    if (err != ESP_OK) {
+        return err;
+    }
+    camera_service_get_stats(&status->service);
+    stream_get_stats(&status->stream);
+    rtp_mcast_get_stats(&status->mcast);
+#if CONFIG_GROWPOD_H264_STREAM
+    h264_stream_get_stats(&status->h264);
+#endif
+#if CONFIG_GROWPOD_UDP_STILL
+    udp_still_get_stats(&status->udp);
+#endif
+#if CONFIG_GROWPOD_STATUS_EVENTS
+    status_events_get_stats(&status->events);
+#endif
+#if CONFIG_GROWPOD_HEAP_MONITOR
+    heap_monitor_get_stats(HEAP_MON_INTERNAL, &status->heap);
+    heap_monitor_get_stats(HEAP_MON_PSRAM, &status->psram);
+    status->alloc_failures = heap_monitor_failures();
+#endif
+    return ESP_OK;
+}
+
+/**
+ * @brief Status handler - returns JSON status
+ */
+static esp_err_t status_handler(httpd_req_t *req)
+{
+    if (!admit(req, ADMIT_STATUS)) {
+        return ESP_OK;
+    }
+    
+    slo_trace_t trace;
+    slo_begin(&trace, SLO_STATUS);
+    api_status_t status;
+    if (read_status(&status) != ESP_OK) {
+        httpd_resp_send_500(req);
+        slo_end(&trace, req);
+        return ESP_FAIL;
+    }
+    slo_mark(&trace, "read");
+    
+    ESP_LOGI(TAG, "Status: sensor.framesize=%d (%s), quality=%d",
+             status.camera.framesize, camera_framesize_name(status.camera.framesize),
+             status.camera.quality);
+    
+    char json_response[API_STATUS_JSON_SIZE];
+    int len = api_status_json(&status, json_response, sizeof(json_response));
+    if (len < 0) {
+        ESP_LOGE(TAG, "Status JSON truncated");
+        httpd_resp_send_500(req);
+        slo_end(&trace, req);
+        return ESP_FAIL;
+    }
+    
     httpd_resp_set_type(req, "application/json");
-    httpd_resp_send(req, json_response, strlen(json_response));
+    httpd_resp_send(req, json_response, len);
+    slo_mark(&trace, "send");
+    trace.bytes = len;
+    slo_end(&trace, req);
     return ESP_OK;
 }
 
+/**
+ * @brief Status handler - the same fields as /status in CBOR
+ */
+static esp_err_t status_cbor_handler(httpd_req_t *req)
+{
+    if (!admit(req, ADMIT_STATUS)) {
+        return ESP_OK;
+    }
+    
+    slo_trace_t trace;
+    slo_begin(&trace, SLO_STATUS);
+    api_status_t status;
+    if (read_status(&status) != ESP_OK) {
+        httpd_resp_send_500(req);
+        slo_end(&trace, req);
+        return ESP_FAIL;
+    }
+    slo_mark(&trace, "read");
+    
+    uint8_t cbor[API_STATUS_CBOR_SIZE];
+    size_t len = api_status_cbor(&status, cbor, sizeof(cbor));
+    if (len == 0) {
+        ESP_LOGE(TAG, "CBOR status does not fit %d bytes", API_STATUS_CBOR_SIZE);
+        httpd_resp_send_500(req);
+        slo_end(&trace, req);
+        return ESP_FAIL;
+    }
+    
+    httpd_resp_set_type(req, "application/cbor");
+    httpd_resp_send(req, (const char *)cbor, len);
+    slo_mark(&trace, "send");
+    trace.bytes = len;
+    slo_end(&trace, req);
+    return ESP_OK;
+}
+
+#if CONFIG_GROWPOD_STATUS_EVENTS
+/**
+ * @brief Events handler - hands the connection to the status event task
+ */
+static esp_err_t events_handler(httpd_req_t *req)
+{
+    if (!admit(req, ADMIT_STATUS)) {
+        return ESP_OK;
+    }
+    
+    esp_err_t res = status_events_add_client(req);
+    if (res == ESP_ERR_NO_MEM) {
+        httpd_resp_set_status(req, "503 Service Unavailable");
+        httpd_resp_send(req, "Too many event subscribers", HTTPD_RESP_USE_STRLEN);
+        return ESP_OK;
+    }
+    if (res != ESP_OK) {
+        httpd_resp_send_500(req);
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
+#endif
+
 /**
  * @brief Control handler - adjust camera settings
  */
 static esp_err_t control_handler(httpd_req_t *req)
 {
+    if (!admit(req, ADMIT_CONTROL)) {
+        return ESP_OK;
+    }
+    
     char buf[128];
     char var[32];
     char val[32];
@@ -501,135 +1492,603 @@ static esp_err_t control_handler(httpd_req_t *req)
     int value = atoi(val);
     ESP_LOGI(TAG, "Control request: %s = %d", var, value);
     
-    sensor_t *s = esp_camera_sensor_get();
-    if (s == NULL) {
-        ESP_LOGE(TAG, "Failed to get camera sensor");
+    slo_trace_t trace;
+    slo_begin(&trace, SLO_CONTROL);
+    
+    camera_param_t param = camera_param_find(var);
+    if (param == CAMERA_PARAM_COUNT) {
+        ESP_LOGW(TAG, "Unknown control variable: %s", var);
+        httpd_resp_send_404(req);
+        slo_end(&trace, req);
+        return ESP_FAIL;
+    }
+    
+    // The camera service applies the change and persists it to NVS
+    esp_err_t err = camera_service_set_param(param, value);
+    slo_mark(&trace, "apply");
+    if (err != ESP_OK) {
         httpd_resp_send_500(req);
+        slo_end(&trace, req);
         return ESP_FAIL;
     }
     
-    int res = 0;
+    httpd_resp_set_type(req, "text/plain");
+    httpd_resp_send(req, "OK", 2);
+    slo_mark(&trace, "send");
+    slo_end(&trace, req);
+    return ESP_OK;
+}
+
+/**
+ * @brief CBOR control handler - apply several settings in one request
+ */
+static esp_err_t control_cbor_handler(httpd_req_t *req)
+{
+    if (!admit(req, ADMIT_CONTROL)) {
+        return ESP_OK;
+    }
+    
+    slo_trace_t trace;
+    slo_begin(&trace, SLO_CONTROL);
+    uint8_t body[CONTROL_CBOR_MAX_BODY];
     
-    // Apply camera setting based on variable name
-    if (strcmp(var, "aec") == 0) {
-        // Auto Exposure Control
-        res = s->set_exposure_ctrl(s, value);
-        ESP_LOGI(TAG, ">>> Set AEC (Auto Exposure Control) to %d, result: %d", value, res);
+    if (req->content_len == 0 || req->content_len > sizeof(body)) {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Expected a CBOR map body");
+        slo_end(&trace, req);
+        return ESP_FAIL;
     }
-    else if (strcmp(var, "aec_value") == 0) {
-        // Manual Exposure Value
-        res = s->set_aec_value(s, value);
-        ESP_LOGI(TAG, ">>> Set AEC_VALUE (Manual Exposure) to %d, result: %d", value, res);
+    size_t len = 0;
+    while (len < req->content_len) {
+        int ret = httpd_req_recv(req, (char *)body + len, req->content_len - len);
+        if (ret == HTTPD_SOCK_ERR_TIMEOUT) {
+            continue;
+        }
+        if (ret <= 0) {
+            slo_end(&trace, req);
+            return ESP_FAIL;
+        }
+        len += ret;
     }
-    else if (strcmp(var, "ae_level") == 0) {
-        // AE Level (exposure compensation)
-        res = s->set_ae_level(s, value);
-        ESP_LOGI(TAG, ">>> Set AE_LEVEL (Exposure Compensation) to %d, result: %d", value, res);
+    slo_mark(&trace, "recv");
+    
+    camera_param_change_t changes[CAMERA_PARAM_COUNT];
+    int count;
+    esp_err_t err = api_control_cbor(body, len, changes, &count);
+    if (err == ESP_ERR_NOT_FOUND) {
+        httpd_resp_send_err(req, HTTPD_404_NOT_FOUND, "Unknown control variable");
+        slo_end(&trace, req);
+        return ESP_FAIL;
+    }
+    if (err != ESP_OK) {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Malformed CBOR control map");
+        slo_end(&trace, req);
+        return ESP_FAIL;
+    }
+    
+    ESP_LOGI(TAG, "CBOR control request: %d change(s)", count);
+    
+    // One service request: applied together with a single NVS write
+    err = camera_service_set_params(changes, count);
+    slo_mark(&trace, "apply");
+    if (err != ESP_OK) {
+        httpd_resp_send_500(req);
+        slo_end(&trace, req);
+        return ESP_FAIL;
     }
-    else if (strcmp(var, "gain_ctrl") == 0) {
-        // Auto Gain Control
-        res = s->set_gain_ctrl(s, value);
-        ESP_LOGI(TAG, ">>> Set GAIN_CTRL (Auto Gain Control) to %d, result: %d", value, res);
+    
+    httpd_resp_set_status(req, "204 No Content");
+    httpd_resp_send(req, NULL, 0);
+    slo_mark(&trace, "send");
+    slo_end(&trace, req);
+    return ESP_OK;
+}
+
+#if CONFIG_GROWPOD_ADMISSION
+/**
+ * @brief Read a uint16_t query value into *value if present
+ *
+ * @return false if present but out of range
+ */
+static bool query_u16(const char *query, const char *key, uint16_t *value)
+{
+    char param[8];
+    if (httpd_query_key_value(query, key, param, sizeof(param)) != ESP_OK) {
+        return true;
     }
-    else if (strcmp(var, "agc_gain") == 0) {
-        // Manual Gain Value
-        res = s->set_agc_gain(s, value);
-        ESP_LOGI(TAG, ">>> Set AGC_GAIN (Manual Gain) to %d, result: %d", value, res);
+    int v = atoi(param);
+    if (v < 0 || v > UINT16_MAX) {
+        return false;
     }
-    else if (strcmp(var, "quality") == 0) {
-        // JPEG Quality (0-63, lower is better)
-        res = s->set_quality(s, value);
-        ESP_LOGI(TAG, ">>> Set QUALITY (JPEG Quality) to %d, result: %d", value, res);
+    *value = v;
+    return true;
+}
+
+/**
+ * @brief Admission limits handler - report or change the limits
+ *
+ * ?class=capture&rate=12&burst=3&global_rate=30&global_burst=6 changes a
+ * class (rates per minute, 0 for no limit), ?max_streams=N the stream
+ * limit. Always replies with the limits in effect and the counters.
+ */
+static esp_err_t limits_handler(httpd_req_t *req)
+{
+    if (!admit(req, ADMIT_CONTROL)) {
+        return ESP_OK;
     }
-    else if (strcmp(var, "framesize") == 0) {
-        // Frame size / resolution
-        // Common values: QXGA=10 (2048x1536), UXGA=9 (1600x1200), SXGA=8 (1280x1024), 
-        //                XGA=7 (1024x768), SVGA=6 (800x600), VGA=5 (640x480)
-        ESP_LOGI(TAG, ">>> Setting FRAMESIZE from %d to %d", s->status.framesize, value);
-        res = s->set_framesize(s, (framesize_t)value);
-        ESP_LOGI(TAG, ">>> Set FRAMESIZE (Resolution) to %d, result: %d", value, res);
-        
-        // Discard any buffered frames after resolution change
-        camera_fb_t *fb = esp_camera_fb_get();
-        if (fb) {
-            ESP_LOGI(TAG, ">>> Discarded old frame buffer (%dx%d)", fb->width, fb->height);
-            esp_camera_fb_return(fb);
-        }
-        // Get a fresh frame to verify new resolution
-        fb = esp_camera_fb_get();
-        if (fb) {
-            ESP_LOGI(TAG, ">>> New frame buffer captured (%dx%d)", fb->width, fb->height);
-            esp_camera_fb_return(fb);
-        } else {
-            ESP_LOGW(TAG, ">>> Failed to capture verification frame");
+    
+    admission_config_t config;
+    admission_get_config(&config);
+    
+    char query[128];
+    if (httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK) {
+        char param[16];
+        bool valid = true;
+        if (httpd_query_key_value(query, "class", param, sizeof(param)) == ESP_OK) {
+            admit_class_t cls = admission_class_find(param);
+            if (cls == ADMIT_CLASS_COUNT) {
+                httpd_resp_send_err(req, HTTPD_404_NOT_FOUND, "Unknown class");
+                return ESP_FAIL;
+            }
+            admit_class_limits_t *limits = &config.classes[cls];
+            valid = query_u16(query, "rate", &limits->client.rate) &&
+                    query_u16(query, "burst", &limits->client.burst) &&
+                    query_u16(query, "global_rate", &limits->global.rate) &&
+                    query_u16(query, "global_burst", &limits->global.burst);
         }
-    }
-    else if (strcmp(var, "brightness") == 0) {
-        // Brightness (-2 to +2)
-        if (s->set_brightness) {
-            res = s->set_brightness(s, value);
-            ESP_LOGI(TAG, ">>> Set BRIGHTNESS to %d, result: %d", value, res);
-        } else {
-            ESP_LOGW(TAG, ">>> BRIGHTNESS not supported by this camera");
-            res = -1;
+        if (httpd_query_key_value(query, "max_streams", param, sizeof(param)) == ESP_OK) {
+            int max_streams = atoi(param);
+            valid = valid && max_streams >= 0 && max_streams <= STREAM_MAX_CLIENTS;
+            config.max_streams = max_streams;
+        }
+        if (!valid || admission_set_config(&config) != ESP_OK) {
+            httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Invalid limit");
+            return ESP_FAIL;
         }
+        ESP_LOGI(TAG, "Admission limits updated: %s", query);
     }
-    else if (strcmp(var, "contrast") == 0) {
-        // Contrast (-2 to +2)
-        if (s->set_contrast) {
-            res = s->set_contrast(s, value);
-            ESP_LOGI(TAG, ">>> Set CONTRAST to %d, result: %d", value, res);
-        } else {
-            ESP_LOGW(TAG, ">>> CONTRAST not supported by this camera");
-            res = -1;
+    
+    admission_stats_t stats;
+    admission_get_stats(&stats);
+    
+    char json[768];
+    int n = 0;
+    bool fits = appendf(json, sizeof(json), &n, "{\"max_streams\":%d,\"streams_full\":%lu",
+                        config.max_streams, (unsigned long)stats.streams_full);
+    for (int c = 0; c < ADMIT_CLASS_COUNT && fits; c++) {
+        const admit_class_limits_t *limits = &config.classes[c];
+        fits = appendf(json, sizeof(json), &n,
+            ",\"%s\":{"
+            "\"rate\":%u,"
+            "\"burst\":%u,"
+            "\"global_rate\":%u,"
+            "\"global_burst\":%u,"
+            "\"admitted\":%lu,"
+            "\"limited\":%lu,"
+            "\"global_limited\":%lu}",
+            admission_class_name(c),
+            limits->client.rate, limits->client.burst,
+            limits->global.rate, limits->global.burst,
+            (unsigned long)stats.admitted[c],
+            (unsigned long)stats.client_limited[c],
+            (unsigned long)stats.global_limited[c]);
+    }
+    if (!fits || !appendf(json, sizeof(json), &n, "}")) {
+        ESP_LOGE(TAG, "Limits JSON truncated");
+        httpd_resp_send_500(req);
+        return ESP_FAIL;
+    }
+    
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_send(req, json, n);
+    return ESP_OK;
+}
+#endif
+
+/**
+ * @brief Slow-request handler - SLO counters and the slow-request ring
+ *
+ * ?endpoint=capture&slo_ms=800 changes a threshold, ?clear=1 drops the
+ * records and counters. Records are sent newest first, one chunk each.
+ */
+static esp_err_t debug_slow_handler(httpd_req_t *req)
+{
+    if (!admit(req, ADMIT_STATUS)) {
+        return ESP_OK;
+    }
+    
+    char query[64];
+    if (httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK) {
+        char param[24];
+        if (httpd_query_key_value(query, "endpoint", param, sizeof(param)) == ESP_OK) {
+            slo_endpoint_t endpoint = slo_endpoint_find(param);
+            char slo_ms[12];
+            char *end = NULL;
+            unsigned long value = 0;
+            if (endpoint != SLO_ENDPOINT_COUNT &&
+                httpd_query_key_value(query, "slo_ms", slo_ms, sizeof(slo_ms)) == ESP_OK) {
+                value = strtoul(slo_ms, &end, 10);
+            }
+            // Anything over SLO_MAX_MS, including what strtoul() saturated, is refused
+            if (end == NULL || end == slo_ms || *end != '\0' || value > SLO_MAX_MS ||
+                slo_set_threshold(endpoint, value) != ESP_OK) {
+                httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST,
+                                    "Expected endpoint and slo_ms of 1-600000");
+                return ESP_FAIL;
+            }
+        }
+        if (httpd_query_key_value(query, "clear", param, sizeof(param)) == ESP_OK &&
+            atoi(param) != 0) {
+            slo_clear();
         }
     }
-    else if (strcmp(var, "saturation") == 0) {
-        // Saturation (-2 to +2)
-        if (s->set_saturation) {
-            res = s->set_saturation(s, value);
-            ESP_LOGI(TAG, ">>> Set SATURATION to %d, result: %d", value, res);
-        } else {
-            ESP_LOGW(TAG, ">>> SATURATION not supported by this camera");
-            res = -1;
+    
+    char buf[768];
+    int n = 0;
+    bool fits = appendf(buf, sizeof(buf), &n, "{\"uptime_ms\":%lld,\"endpoints\":{",
+                        esp_timer_get_time() / 1000);
+    for (int i = 0; i < SLO_ENDPOINT_COUNT && fits; i++) {
+        slo_endpoint_stats_t stats;
+        slo_get_stats(i, &stats);
+        fits = appendf(buf, sizeof(buf), &n,
+            "%s\"%s\":{\"slo_ms\":%lu,\"requests\":%lu,\"breaches\":%lu,"
+            "\"avg_ms\":%lu,\"max_ms\":%lu}",
+            i ? "," : "", slo_endpoint_name(i),
+            (unsigned long)stats.slo_ms, (unsigned long)stats.requests,
+            (unsigned long)stats.breaches,
+            (unsigned long)(stats.requests ? stats.total_us / stats.requests / 1000 : 0),
+            (unsigned long)(stats.max_us / 1000));
+    }
+    if (!fits || !appendf(buf, sizeof(buf), &n, "},\"slow\":[")) {
+        ESP_LOGE(TAG, "Slow-request JSON truncated");
+        httpd_resp_send_500(req);
+        return ESP_FAIL;
+    }
+    httpd_resp_set_type(req, "application/json");
+    if (httpd_resp_send_chunk(req, buf, n) != ESP_OK) {
+        return ESP_FAIL;
+    }
+    
+    slo_record_t rec;
+    for (int i = 0; slo_get_record(i, &rec); i++) {
+        n = 0;
+        fits = appendf(buf, sizeof(buf), &n,
+            "%s{\"endpoint\":\"%s\",\"age_ms\":%lld,\"total_ms\":%lu,\"phases_ms\":{",
+            i ? "," : "", slo_endpoint_name(rec.endpoint),
+            (esp_timer_get_time() - rec.at_us) / 1000, (unsigned long)(rec.total_us / 1000));
+        for (int p = 0; p < rec.phases && fits; p++) {
+            fits = appendf(buf, sizeof(buf), &n, "%s\"%s\":%lu",
+                           p ? "," : "", rec.names[p], (unsigned long)(rec.phase_us[p] / 1000));
+        }
+        fits = fits && appendf(buf, sizeof(buf), &n,
+            "},\"bytes\":%lu,\"peer\":\"%s\",\"sock_err\":%d,\"open_sockets\":%d,"
+            "\"rssi\":%d,\"heap\":%lu,\"heap_largest\":%lu,\"psram\":%lu,"
+            "\"psram_largest\":%lu,\"cam_queue_max_us\":%lu,\"stream_clients\":%lu}",
+            (unsigned long)rec.bytes, rec.peer, rec.sock_err, rec.open_sockets,
+            rec.rssi, (unsigned long)rec.heap_free, (unsigned long)rec.heap_largest,
+            (unsigned long)rec.psram_free, (unsigned long)rec.psram_largest,
+            (unsigned long)rec.cam_queue_max_us, (unsigned long)rec.stream_clients);
+        // Half a record would leave the JSON broken; end the response unterminated
+        if (!fits) {
+            ESP_LOGE(TAG, "Slow-request record truncated");
+            return ESP_FAIL;
+        }
+        if (httpd_resp_send_chunk(req, buf, n) != ESP_OK) {
+            return ESP_FAIL;
         }
     }
-    else if (strcmp(var, "sharpness") == 0) {
-        // Sharpness (-2 to +2)
-        if (s->set_sharpness) {
-            res = s->set_sharpness(s, value);
-            ESP_LOGI(TAG, ">>> Set SHARPNESS to %d, result: %d", value, res);
-        } else {
-            ESP_LOGW(TAG, ">>> SHARPNESS not supported by this camera");
-            res = -1;
+    
+    httpd_resp_send_chunk(req, "]}", 2);
+    return httpd_resp_send_chunk(req, NULL, 0);
+}
+
+#if CONFIG_GROWPOD_TASK_STATS
+/**
+ * @brief Append one heap capability's figures at buf + *len, as appendf()
+ */
+static bool heap_json(char *buf, size_t size, int *len, const char *name, uint32_t caps)
+{
+    multi_heap_info_t info;
+    heap_caps_get_info(&info, caps);
+    return appendf(buf, size, len,
+        "\"%s\":{\"free\":%u,\"allocated\":%u,\"largest\":%u,\"min_free\":%u,\"blocks\":%u}",
+        name, (unsigned)info.total_free_bytes, (unsigned)info.total_allocated_bytes,
+        (unsigned)info.largest_free_block, (unsigned)info.minimum_free_bytes,
+        (unsigned)info.allocated_blocks);
+}
+
+/**
+ * @brief Task handler - CPU share, stack high-water and heap use
+ *
+ * ?window=5 takes CPU shares over the last 5 s instead of the full
+ * window. Tasks are sent busiest first, a few per chunk.
+ */
+static esp_err_t debug_tasks_handler(httpd_req_t *req)
+{
+    if (!admit(req, ADMIT_STATUS)) {
+        return ESP_OK;
+    }
+    
+    int window_s = CONFIG_GROWPOD_TASK_STATS_WINDOW_S;
+    char query[32];
+    if (httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK) {
+        char param[8];
+        if (httpd_query_key_value(query, "window", param, sizeof(param)) == ESP_OK) {
+            window_s = atoi(param);
         }
     }
-    else {
-        ESP_LOGW(TAG, "Unknown control variable: %s", var);
-        httpd_resp_send_404(req);
+    
+    task_stats_row_t rows[TASK_STATS_MAX_TASKS];
+    task_stats_summary_t summary;
+    if (task_stats_get(window_s, rows, TASK_STATS_MAX_TASKS, &summary) != ESP_OK) {
+        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "No samples yet");
         return ESP_FAIL;
     }
     
-    // If setting was successfully applied, save to NVS
-    if (res == 0) {
-        camera_settings_t settings;
-        if (settings_read_from_camera(&settings) == ESP_OK) {
-            esp_err_t save_err = settings_save(&settings);
-            if (save_err != ESP_OK) {
-                ESP_LOGW(TAG, "Failed to save settings to NVS: %s", esp_err_to_name(save_err));
-            } else {
-                ESP_LOGI(TAG, "Settings saved to NVS");
+    char buf[512];
+    int n = 0;
+    bool fits = appendf(buf, sizeof(buf), &n, "{\"window_ms\":%lu,\"core_load\":[",
+                        (unsigned long)summary.window_ms);
+    for (int c = 0; c < portNUM_PROCESSORS && fits; c++) {
+        fits = appendf(buf, sizeof(buf), &n, "%s%u.%u", c ? "," : "",
+                       summary.core_load_permille[c] / 10, summary.core_load_permille[c] % 10);
+    }
+    fits = fits &&
+           appendf(buf, sizeof(buf), &n, "],\"tasks_total\":%d,\"heap\":{", summary.tasks_total) &&
+           heap_json(buf, sizeof(buf), &n, "internal", MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT) &&
+           appendf(buf, sizeof(buf), &n, ",") &&
+           heap_json(buf, sizeof(buf), &n, "dma", MALLOC_CAP_DMA) &&
+           appendf(buf, sizeof(buf), &n, ",") &&
+           heap_json(buf, sizeof(buf), &n, "psram", MALLOC_CAP_SPIRAM) &&
+           appendf(buf, sizeof(buf), &n, "},\"tasks\":[");
+    if (!fits) {
+        ESP_LOGE(TAG, "Task stats JSON truncated");
+        httpd_resp_send_500(req);
+        return ESP_FAIL;
+    }
+    httpd_resp_set_type(req, "application/json");
+    if (httpd_resp_send_chunk(req, buf, n) != ESP_OK) {
+        return ESP_FAIL;
+    }
+    
+    n = 0;
+    for (int i = 0; i < summary.tasks; i++) {
+        const task_stats_row_t *row = &rows[i];
+        fits = appendf(buf, sizeof(buf), &n,
+            "%s{\"name\":\"%s\",\"prio\":%u,\"core\":%d,\"state\":\"%c\",\"cpu\":%u.%u,"
+            "\"stack_free\":%lu,\"stack_psram\":%s}",
+            i ? "," : "", row->name, row->priority, row->core, row->state,
+            row->cpu_permille / 10, row->cpu_permille % 10,
+            (unsigned long)row->stack_free_min, row->stack_in_psram ? "true" : "false");
+        if (!fits && n > 0) {
+            // Full: send the rows before it and retry it in an empty buffer
+            if (httpd_resp_send_chunk(req, buf, n) != ESP_OK) {
+                return ESP_FAIL;
             }
+            n = 0;
+            i--;
+            continue;
+        }
+        if (!fits) {
+            ESP_LOGE(TAG, "Task stats row truncated");
+            return ESP_FAIL;
         }
+    }
+    if (n > 0 && httpd_resp_send_chunk(req, buf, n) != ESP_OK) {
+        return ESP_FAIL;
+    }
+    
+    httpd_resp_send_chunk(req, "]}", 2);
+    return httpd_resp_send_chunk(req, NULL, 0);
+}
+#endif
+
+#if CONFIG_GROWPOD_HEAP_MONITOR
+#if CONFIG_GROWPOD_HEAP_SITES
+// Longest site object: 11 bytes a caller, ten-digit counts, the keys and a NUL
+#define HEAP_SITE_JSON_MAX  (CONFIG_HEAP_TRACING_STACK_DEPTH * 11 + 80)
+#endif
+
+/**
+ * @brief Heap handler - fragmentation per capability, failed allocations
+ *        and, in debug builds, live allocations by call site
+ *
+ * Each capability and its history go out in their own chunk.
+ */
+static esp_err_t debug_heap_handler(httpd_req_t *req)
+{
+    if (!admit(req, ADMIT_STATUS)) {
+        return ESP_OK;
+    }
+    
+    httpd_resp_set_type(req, "application/json");
+    int64_t now = esp_timer_get_time();
+    char buf[768];
+    int n = snprintf(buf, sizeof(buf),
+        "{\"uptime_ms\":%lld,\"period_s\":%d,\"still_fb\":%u,\"failures_total\":%lu,\"caps\":{",
+        now / 1000, CONFIG_GROWPOD_HEAP_MONITOR_PERIOD_S, HEAP_MONITOR_STILL_FB_BYTES,
+        (unsigned long)heap_monitor_failures());
+    if (httpd_resp_send_chunk(req, buf, n) != ESP_OK) {
+        return ESP_FAIL;
+    }
+    
+    for (int cap = 0; cap < HEAP_MON_COUNT; cap++) {
+        heap_mon_stats_t st;
+        heap_monitor_get_stats(cap, &st);
+        n = snprintf(buf, sizeof(buf),
+            "%s\"%s\":{\"free\":%lu,\"largest\":%lu,\"frag\":%u.%u,\"frag_max\":%u.%u,"
+            "\"largest_min\":%lu,\"largest_min_age_ms\":%lld,\"min_free\":%lu,"
+            "\"allocated\":%lu,\"blocks\":%lu,\"free_blocks\":%lu,\"history\":[",
+            cap ? "," : "", heap_monitor_cap_name(cap),
+            (unsigned long)st.free, (unsigned long)st.largest,
+            st.frag_permille / 10, st.frag_permille % 10,
+            st.frag_max_permille / 10, st.frag_max_permille % 10,
+            (unsigned long)st.largest_min, (now - st.largest_min_at_us) / 1000,
+            (unsigned long)st.min_free, (unsigned long)st.allocated,
+            (unsigned long)st.blocks, (unsigned long)st.free_blocks);
         
-        httpd_resp_set_type(req, "text/plain");
-        httpd_resp_send(req, "OK", 2);
+        // Oldest first, as [free, largest] pairs
+        heap_mon_point_t points[HEAP_MONITOR_HISTORY];
+        int count = heap_monitor_get_history(cap, points, HEAP_MONITOR_HISTORY);
+        for (int i = 0; i < count; i++) {
+            if (n > (int)sizeof(buf) - 32) {
+                if (httpd_resp_send_chunk(req, buf, n) != ESP_OK) {
+                    return ESP_FAIL;
+                }
+                n = 0;
+            }
+            n += snprintf(buf + n, sizeof(buf) - n, "%s[%lu,%lu]", i ? "," : "",
+                          (unsigned long)points[i].free, (unsigned long)points[i].largest);
+        }
+        n += snprintf(buf + n, sizeof(buf) - n, "]}");
+        if (httpd_resp_send_chunk(req, buf, n) != ESP_OK) {
+            return ESP_FAIL;
+        }
+    }
+    
+    n = snprintf(buf, sizeof(buf), "},\"failures\":[");
+    heap_mon_failure_t failure;
+    for (int i = 0; heap_monitor_get_failure(i, &failure); i++) {
+        if (n > (int)sizeof(buf) - 128) {
+            if (httpd_resp_send_chunk(req, buf, n) != ESP_OK) {
+                return ESP_FAIL;
+            }
+            n = 0;
+        }
+        n += snprintf(buf + n, sizeof(buf) - n,
+            "%s{\"age_ms\":%lld,\"size\":%lu,\"caps\":\"0x%lx\",\"free\":%lu,\"largest\":%lu}",
+            i ? "," : "", (now - failure.at_us) / 1000, (unsigned long)failure.size,
+            (unsigned long)failure.caps, (unsigned long)failure.free,
+            (unsigned long)failure.largest);
+    }
+    n += snprintf(buf + n, sizeof(buf) - n, "]");
+    if (httpd_resp_send_chunk(req, buf, n) != ESP_OK) {
+        return ESP_FAIL;
+    }
+    
+#if CONFIG_GROWPOD_HEAP_SITES
+    // Resolve the callers with addr2line against the build's ELF
+    heap_mon_site_t sites[HEAP_MONITOR_SITES];
+    heap_mon_trace_t trace;
+    int count = heap_monitor_get_sites(sites, HEAP_MONITOR_SITES, &trace);
+    _Static_assert(HEAP_SITE_JSON_MAX <= sizeof(buf), "A heap site must fit an empty buffer");
+    n = 0;
+    bool fits = appendf(buf, sizeof(buf), &n,
+        ",\"trace\":{\"records\":%lu,\"capacity\":%lu,\"overflowed\":%s},\"sites\":[",
+        (unsigned long)trace.records, (unsigned long)trace.capacity,
+        trace.overflowed ? "true" : "false");
+    for (int i = 0; i < count && fits; i++) {
+        if (n > (int)sizeof(buf) - HEAP_SITE_JSON_MAX) {
+            if (httpd_resp_send_chunk(req, buf, n) != ESP_OK) {
+                return ESP_FAIL;
+            }
+            n = 0;
+        }
+        fits = appendf(buf, sizeof(buf), &n, "%s{\"callers\":\"", i ? "," : "");
+        for (int f = 0; f < CONFIG_HEAP_TRACING_STACK_DEPTH && fits; f++) {
+            fits = appendf(buf, sizeof(buf), &n, "%s0x%08lx", f ? ":" : "",
+                           (unsigned long)sites[i].callers[f]);
+        }
+        fits = fits && appendf(buf, sizeof(buf), &n,
+            "\",\"count\":%lu,\"bytes\":%lu,\"psram_bytes\":%lu}",
+            (unsigned long)sites[i].count, (unsigned long)sites[i].bytes,
+            (unsigned long)sites[i].psram_bytes);
+    }
+    if (!fits || !appendf(buf, sizeof(buf), &n, "]")) {
+        // Past the first chunk: leave the response unterminated
+        ESP_LOGE(TAG, "Heap sites JSON truncated");
+        return ESP_FAIL;
+    }
+    if (httpd_resp_send_chunk(req, buf, n) != ESP_OK) {
+        return ESP_FAIL;
+    }
+#endif
+    
+    httpd_resp_send_chunk(req, "}", 1);
+    return httpd_resp_send_chunk(req, NULL, 0);
+}
+#endif
+
+#if CONFIG_GROWPOD_XCLK_CAL
+/**
+ * @brief XCLK calibration handler - run state and per-framesize results
+ *
+ * ?run=1 starts a run (503 while streaming or already running), ?clear=1
+ * forgets the saved clocks; drivers keep theirs until the next restart.
+ * Each framesize goes out in its own chunk.
+ */
+static esp_err_t debug_xclk_handler(httpd_req_t *req)
+{
+    if (!admit(req, ADMIT_STATUS)) {
         return ESP_OK;
-    } else {
-        httpd_resp_send_500(req);
+    }
+    
+    char query[32];
+    if (httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK) {
+        char param[8];
+        if (httpd_query_key_value(query, "clear", param, sizeof(param)) == ESP_OK &&
+            atoi(param) != 0 && xclk_cal_clear() != ESP_OK) {
+            httpd_resp_send_500(req);
+            return ESP_FAIL;
+        }
+        if (httpd_query_key_value(query, "run", param, sizeof(param)) == ESP_OK &&
+            atoi(param) != 0) {
+            esp_err_t err = camera_service_calibrate_xclk();
+            if (err == ESP_ERR_INVALID_STATE) {
+                httpd_resp_set_status(req, "503 Service Unavailable");
+                httpd_resp_sendstr(req, "Calibration needs the camera idle: stop streams first");
+                return ESP_FAIL;
+            } else if (err != ESP_OK) {
+                httpd_resp_send_500(req);
+                return ESP_FAIL;
+            }
+        }
+    }
+    
+    httpd_resp_set_type(req, "application/json");
+    int done;
+    bool running = xclk_cal_progress(&done);
+    char buf[768];
+    int n = snprintf(buf, sizeof(buf),
+        "{\"running\":%s,\"done\":%d,\"points\":%d,\"default_mhz\":%lu,\"max_err\":%u.%u,"
+        "\"framesizes\":[",
+        running ? "true" : "false", running ? done : 0, XCLK_CAL_POINTS,
+        (unsigned long)(CAMERA_XCLK_DEFAULT_HZ / 1000000),
+        XCLK_CAL_MAX_ERR_PERMILLE / 10, XCLK_CAL_MAX_ERR_PERMILLE % 10);
+    if (httpd_resp_send_chunk(req, buf, n) != ESP_OK) {
         return ESP_FAIL;
     }
+    
+    for (int size = 0; size < XCLK_CAL_SIZES; size++) {
+        xclk_cal_entry_t entry;
+        bool calibrated = xclk_cal_entry(size, &entry);
+        n = snprintf(buf, sizeof(buf),
+            "%s{\"framesize\":\"%s\",\"quality\":%d,\"calibrated\":%s,\"xclk_mhz\":%lu,"
+            "\"clocks\":[",
+            size ? "," : "", camera_framesize_name(entry.framesize), entry.quality,
+            calibrated ? "true" : "false",
+            (unsigned long)(xclk_cal_get(entry.framesize) / 1000000));
+        for (int c = 0; calibrated && c < XCLK_CAL_CLOCKS; c++) {
+            const xclk_cal_point_t *p = &entry.points[c];
+            // fps in tenths, error rate in percent with one decimal
+            uint32_t fps10 = p->interval_us ? 10000000 / p->interval_us : 0;
+            n += snprintf(buf + n, sizeof(buf) - n,
+                "%s{\"mhz\":%lu,\"interval_us\":%lu,\"fps\":%lu.%lu,\"err\":%u.%u,"
+                "\"jpeg_bytes\":%lu}",
+                c ? "," : "", (unsigned long)(xclk_cal_clock_hz(c) / 1000000),
+                (unsigned long)p->interval_us, (unsigned long)(fps10 / 10),
+                (unsigned long)(fps10 % 10), p->error_permille / 10, p->error_permille % 10,
+                (unsigned long)p->jpeg_bytes);
+        }
+        n += snprintf(buf + n, sizeof(buf) - n, "]}");
+        if (httpd_resp_send_chunk(req, buf, n) != ESP_OK) {
+            return ESP_FAIL;
+        }
+    }
+    
+    httpd_resp_send_chunk(req, "]}", 2);
+    return httpd_resp_send_chunk(req, NULL, 0);
 }
+#endif
 
 /**
  * @brief Favicon handler - returns 204 No Content
@@ -661,6 +2120,28 @@ static const httpd_uri_t capture_uri = {
     .user_ctx  = NULL
 };
 
+/**
+ * @brief URI handler structure for last capture endpoint
+ */
+static const httpd_uri_t last_uri = {
+    .uri       = "/last",
+    .method    = HTTP_GET,
+    .handler   = last_handler,
+    .user_ctx  = NULL
+};
+
+#if CONFIG_GROWPOD_YUV_MULTIRES
+/**
+ * @brief URI handler structure for multi-resolution capture endpoint
+ */
+static const httpd_uri_t capture_multi_uri = {
+    .uri       = "/capture_multi",
+    .method    = HTTP_GET,
+    .handler   = capture_multi_handler,
+    .user_ctx  = NULL
+};
+#endif
+
 /**
  * @brief URI handler structure for preview page
  */
@@ -671,6 +2152,16 @@ static const httpd_uri_t preview_uri = {
     .user_ctx  = NULL
 };
 
+/**
+ * @brief URI handler structure for the low-bandwidth preview page
+ */
+static const httpd_uri_t preview_cr_uri = {
+    .uri       = "/preview_cr",
+    .method    = HTTP_GET,
+    .handler   = preview_cr_get_handler,
+    .user_ctx  = NULL
+};
+
 /**
  * @brief URI handler structure for settings page
  */
@@ -691,6 +2182,35 @@ static const httpd_uri_t stream_uri = {
     .user_ctx  = NULL
 };
 
+#if CONFIG_GROWPOD_H264_STREAM
+/**
+ * @brief URI handler structure for the H.264 stream
+ */
+static const httpd_uri_t stream_mp4_uri = {
+    .uri       = "/stream.mp4",
+    .method    = HTTP_GET,
+    .handler   = stream_mp4_handler,
+    .user_ctx  = NULL
+};
+#endif
+
+/**
+ * @brief URI handler structures for the multicast output
+ */
+static const httpd_uri_t multicast_uri = {
+    .uri       = "/multicast",
+    .method    = HTTP_GET,
+    .handler   = multicast_handler,
+    .user_ctx  = NULL
+};
+
+static const httpd_uri_t multicast_sdp_uri = {
+    .uri       = "/multicast.sdp",
+    .method    = HTTP_GET,
+    .handler   = multicast_sdp_handler,
+    .user_ctx  = NULL
+};
+
 /**
  * @brief URI handler structure for status endpoint
  */
@@ -701,6 +2221,28 @@ static const httpd_uri_t status_uri = {
     .user_ctx  = NULL
 };
 
+#if CONFIG_GROWPOD_STATUS_EVENTS
+/**
+ * @brief URI handler structure for the status event stream
+ */
+static const httpd_uri_t events_uri = {
+    .uri       = "/events",
+    .method    = HTTP_GET,
+    .handler   = events_handler,
+    .user_ctx  = NULL
+};
+#endif
+
+/**
+ * @brief URI handler structure for the CBOR status endpoint
+ */
+static const httpd_uri_t status_cbor_uri = {
+    .uri       = "/status.cbor",
+    .method    = HTTP_GET,
+    .handler   = status_cbor_handler,
+    .user_ctx  = NULL
+};
+
 /**
  * @brief URI handler structure for control endpoint
  */
@@ -711,6 +2253,74 @@ static const httpd_uri_t control_uri = {
     .user_ctx  = NULL
 };
 
+/**
+ * @brief URI handler structure for the CBOR control endpoint
+ */
+static const httpd_uri_t control_cbor_uri = {
+    .uri       = "/control.cbor",
+    .method    = HTTP_POST,
+    .handler   = control_cbor_handler,
+    .user_ctx  = NULL
+};
+
+/**
+ * @brief URI handler structure for the slow-request log
+ */
+static const httpd_uri_t debug_slow_uri = {
+    .uri       = "/debug/slow",
+    .method    = HTTP_GET,
+    .handler   = debug_slow_handler,
+    .user_ctx  = NULL
+};
+
+#if CONFIG_GROWPOD_TASK_STATS
+/**
+ * @brief URI handler structure for task statistics
+ */
+static const httpd_uri_t debug_tasks_uri = {
+    .uri       = "/debug/tasks",
+    .method    = HTTP_GET,
+    .handler   = debug_tasks_handler,
+    .user_ctx  = NULL
+};
+#endif
+
+#if CONFIG_GROWPOD_HEAP_MONITOR
+/**
+ * @brief URI handler structure for the heap monitor
+ */
+static const httpd_uri_t debug_heap_uri = {
+    .uri       = "/debug/heap",
+    .method    = HTTP_GET,
+    .handler   = debug_heap_handler,
+    .user_ctx  = NULL
+};
+#endif
+
+#if CONFIG_GROWPOD_XCLK_CAL
+/**
+ * @brief URI handler structure for XCLK calibration
+ */
+static const httpd_uri_t debug_xclk_uri = {
+    .uri       = "/debug/xclk",
+    .method    = HTTP_GET,
+    .handler   = debug_xclk_handler,
+    .user_ctx  = NULL
+};
+#endif
+
+#if CONFIG_GROWPOD_ADMISSION
+/**
+ * @brief URI handler structure for admission limits
+ */
+static const httpd_uri_t limits_uri = {
+    .uri       = "/limits",
+    .method    = HTTP_GET,
+    .handler   = limits_handler,
+    .user_ctx  = NULL
+};
+#endif
+
 /**
  * @brief URI handler structure for favicon
  */
@@ -725,19 +2335,51 @@ httpd_handle_t start_webserver(void)
 {
     httpd_handle_t server = NULL;
     httpd_config_t config = HTTPD_DEFAULT_CONFIG();
-    config.max_uri_handlers = 16;
+    config.max_uri_handlers = 24;
     config.stack_size = 8192;
     
+#if CONFIG_GROWPOD_ADMISSION
+    admission_init(esp_timer_get_time());
+#endif
+    
     ESP_LOGI(TAG, "Starting HTTP server on port %d", config.server_port);
     if (httpd_start(&server, &config) == ESP_OK) {
         ESP_LOGI(TAG, "Registering URI handlers");
         httpd_register_uri_handler(server, &root_uri);
         httpd_register_uri_handler(server, &preview_uri);
+        httpd_register_uri_handler(server, &preview_cr_uri);
         httpd_register_uri_handler(server, &settings_uri);
         httpd_register_uri_handler(server, &stream_uri);
+#if CONFIG_GROWPOD_H264_STREAM
+        httpd_register_uri_handler(server, &stream_mp4_uri);
+#endif
+        httpd_register_uri_handler(server, &multicast_uri);
+        httpd_register_uri_handler(server, &multicast_sdp_uri);
         httpd_register_uri_handler(server, &capture_uri);
+        httpd_register_uri_handler(server, &last_uri);
+#if CONFIG_GROWPOD_YUV_MULTIRES
+        httpd_register_uri_handler(server, &capture_multi_uri);
+#endif
         httpd_register_uri_handler(server, &status_uri);
+        httpd_register_uri_handler(server, &status_cbor_uri);
+#if CONFIG_GROWPOD_STATUS_EVENTS
+        httpd_register_uri_handler(server, &events_uri);
+#endif
         httpd_register_uri_handler(server, &control_uri);
+        httpd_register_uri_handler(server, &control_cbor_uri);
+#if CONFIG_GROWPOD_ADMISSION
+        httpd_register_uri_handler(server, &limits_uri);
+#endif
+        httpd_register_uri_handler(server, &debug_slow_uri);
+#if CONFIG_GROWPOD_TASK_STATS
+        httpd_register_uri_handler(server, &debug_tasks_uri);
+#endif
+#if CONFIG_GROWPOD_HEAP_MONITOR
+        httpd_register_uri_handler(server, &debug_heap_uri);
+#endif
+#if CONFIG_GROWPOD_XCLK_CAL
+        httpd_register_uri_handler(server, &debug_xclk_uri);
+#endif
         httpd_register_uri_handler(server, &favicon_uri);
         ESP_LOGI(TAG, "HTTP server started successfully");
         return server;
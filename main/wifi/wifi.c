@@ -249,3 +249,13 @@ esp_err_t mdns_init_service(void)
     
     return ESP_OK;
 }
+
+int wifi_get_rssi(void)
+{
+    wifi_ap_record_t ap_info;
+    
+    if (esp_wifi_sta_get_ap_info(&ap_info) != ESP_OK) {
+        return 0;
+    }
+    return ap_info.rssi;
+}
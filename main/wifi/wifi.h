@@ -30,4 +30,11 @@ esp_err_t wifi_init_sta(void);
  */
 esp_err_t mdns_init_service(void);
 
+/**
+ * @brief Get the signal strength of the current access point
+ * 
+ * @return RSSI in dBm, or 0 if not connected
+ */
+int wifi_get_rssi(void);
+
 #endif // WIFI_H
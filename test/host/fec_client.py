@@ -0,0 +1,55 @@
+#!/usr/bin/env python3
+"""
+Decode the firmware's parity with the client's Reed-Solomon decoder.
+
+Runs test_fec_rs --vectors for a few groups, erases data blocks, and checks
+that capture_wifi.rs_decode() recovers them from the parity rows. The
+client's network libraries are not needed for this and are stubbed.
+
+Usage: fec_client.py <test_fec_rs> <capture_wifi.py directory>
+"""
+
+import os
+import random
+import subprocess
+import sys
+import types
+
+
+def stub_modules():
+    requests = types.ModuleType('requests')
+    requests.exceptions = types.SimpleNamespace(Timeout=Exception, ConnectionError=Exception)
+    sys.modules.setdefault('requests', requests)
+
+    zeroconf = types.ModuleType('zeroconf')
+    zeroconf.Zeroconf = zeroconf.ServiceBrowser = object
+    zeroconf.ServiceListener = type('ServiceListener', (), {})
+    sys.modules.setdefault('zeroconf', zeroconf)
+
+
+def main():
+    binary, client_dir = sys.argv[1], sys.argv[2]
+    stub_modules()
+    sys.path.insert(0, os.path.abspath(client_dir))
+    import capture_wifi
+
+    size = capture_wifi.UDP_BLOCK_SIZE
+    rng = random.Random(1)
+    failed = 0
+    for k, rows, erased in ((1, 1, 1), (4, 4, 4), (32, 8, 8), (32, 8, 3)):
+        raw = subprocess.run([binary, '--vectors', str(k), str(rows), str(k)],
+                             check=True, capture_output=True).stdout
+        blocks = [raw[i * size:(i + 1) * size] for i in range(k + rows)]
+        lost = rng.sample(range(k), erased)
+        sent = rng.sample(range(rows), erased)
+        received = {i: blocks[i] for i in range(k) if i not in lost}
+        received.update({k + r: blocks[k + r] for r in sent})
+        ok = capture_wifi.rs_decode(k, received) == blocks[:k]
+        print('k=%d, %d of %d parity rows for %d lost blocks: %s'
+              % (k, erased, rows, erased, 'ok' if ok else 'WRONG'))
+        failed += not ok
+    sys.exit(1 if failed else 0)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,152 @@
+#!/usr/bin/env python3
+"""
+Replay an allocation trace against a model of the PSRAM heap.
+
+The model is an address-ordered free list with best fit (TLSF is a
+good-fit allocator), 4-byte alignment, an 8-byte block header and
+immediate coalescing. Every 10 min it takes the sample heap_monitor
+would: free bytes and the largest free block. Reports the smallest
+largest block and the allocations that failed, in particular the QXGA
+JPEG frame buffer.
+
+Usage:
+  heap_replay.py <trace> [heap bytes]
+  heap_replay.py --generate <seed> <hours> <clients/h> <max client KB>
+                 [--max-failures N] [--expect-fb-failure]
+
+--generate replays a heap_trace_gen.py trace without writing it out; the
+two checks make the run fail unless its outcome is as expected.
+"""
+
+import bisect
+import os
+import sys
+
+HEADER = 8
+PSRAM_HEAP = 8 * 1024 * 1024 - 512 * 1024
+SAMPLE_S = 600
+
+
+class Heap:
+    def __init__(self, size):
+        self.free = [(0, size)]             # (address, size), address order
+        self.live = {}                      # id -> (address, size)
+
+    def alloc(self, n):
+        n = (n + HEADER + 3) & ~3
+        best = None
+        for i, (_, size) in enumerate(self.free):
+            if size >= n and (best is None or size < self.free[best][1]):
+                best = i
+        if best is None:
+            return None
+        addr, size = self.free[best]
+        if size - n >= 16:
+            self.free[best] = (addr + n, size - n)
+        else:
+            n = size
+            del self.free[best]
+        return (addr, n)
+
+    def release(self, block):
+        addr, n = block
+        i = bisect.bisect(self.free, (addr, 0))
+        self.free.insert(i, (addr, n))
+        if i + 1 < len(self.free) and addr + n == self.free[i + 1][0]:
+            self.free[i] = (addr, n + self.free[i + 1][1])
+            del self.free[i + 1]
+        if i > 0 and self.free[i - 1][0] + self.free[i - 1][1] == addr:
+            self.free[i - 1] = (self.free[i - 1][0], self.free[i - 1][1] + self.free[i][1])
+            del self.free[i]
+
+    def total_free(self):
+        return sum(size for _, size in self.free)
+
+    def largest(self):
+        return max((size for _, size in self.free), default=0)
+
+
+def replay(lines, heap_size=PSRAM_HEAP):
+    """Replay trace lines; return (smallest largest block and when, failures)."""
+    heap = Heap(heap_size)
+    failures = []
+    worst = (heap_size, 0)
+    next_sample = 0
+    for line in lines:
+        fields = line.split()
+        t = float(fields[0])
+        while t >= next_sample:
+            free, largest = heap.total_free(), heap.largest()
+            if largest < worst[0]:
+                worst = (largest, next_sample)
+            if next_sample % (6 * 3600) == 0:
+                print('  %5.0f h  free %8d  largest %8d  frag %4d  free blocks %d'
+                      % (next_sample / 3600, free, largest, 1000 - largest * 1000 // free,
+                         len(heap.free)))
+            next_sample += SAMPLE_S
+        if fields[1] == 'a':
+            block = heap.alloc(int(fields[3]))
+            if block is None:
+                failures.append((t, int(fields[3]), fields[4], heap.total_free(),
+                                 heap.largest()))
+            else:
+                heap.live[fields[2]] = block
+        else:
+            block = heap.live.pop(fields[2], None)
+            if block:
+                heap.release(block)
+    return worst, failures
+
+
+def report(worst, failures):
+    print('  smallest largest block %d at %.1f h, %d failed allocations'
+          % (worst[0], worst[1] / 3600, len(failures)))
+    fb_failures = [f for f in failures if f[2] == 'fb_qxga']
+    if fb_failures:
+        t, size, _, free, largest = fb_failures[0]
+        print('  first QXGA frame buffer failure at %.1f h: needed %d, free %d, largest %d'
+              % (t / 3600, size, free, largest))
+    tags = {}
+    for failure in failures:
+        tags[failure[2]] = tags.get(failure[2], 0) + 1
+    if tags:
+        print('  failures by tag:', tags)
+    return fb_failures
+
+
+def main():
+    args = sys.argv[1:]
+    max_failures = None
+    expect_fb_failure = '--expect-fb-failure' in args
+    if expect_fb_failure:
+        args.remove('--expect-fb-failure')
+    if '--max-failures' in args:
+        i = args.index('--max-failures')
+        max_failures = int(args[i + 1])
+        del args[i:i + 2]
+
+    if len(args) == 5 and args[0] == '--generate':
+        sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+        from heap_trace_gen import generate
+        seed, hours, rate, max_kb = int(args[1]), float(args[2]), float(args[3]), int(args[4])
+        print('seed %d, %g h, %g client buffers/h of 20-%d KB' % (seed, hours, rate, max_kb))
+        worst, failures = replay(generate(seed, hours, rate, max_kb))
+    elif len(args) in (1, 2):
+        with open(args[0]) as trace:
+            worst, failures = replay(trace, int(args[1]) if len(args) > 1 else PSRAM_HEAP)
+    else:
+        sys.exit(__doc__.strip())
+
+    fb_failures = report(worst, failures)
+    ok = True
+    if max_failures is not None and len(failures) > max_failures:
+        print('  more than %d failed allocations' % max_failures)
+        ok = False
+    if expect_fb_failure and not fb_failures:
+        print('  expected the QXGA frame buffer to fail')
+        ok = False
+    sys.exit(0 if ok else 1)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,119 @@
+#!/usr/bin/env python3
+"""
+Write a synthetic PSRAM allocation trace of the firmware's flows.
+
+- Stills once a minute: the capture_store copy is made before the old
+  one is freed, then the Huffman re-optimization buffer.
+- H.264/YUV stream sessions, about every 2 h for 5-30 min: the driver
+  restart swaps the QXGA JPEG frame buffer for two VGA YUV buffers plus
+  the encoder's pictures. A still taken during a session briefly swaps
+  them back and clones the frame.
+- Client buffers (SSE, async requests, mallocs over 16 KB land in PSRAM)
+  with log-normal lifetimes.
+
+Trace lines are "<t_s> a <id> <size> <tag>" and "<t_s> f <id>", in time
+order; heap_replay.py replays them.
+
+Usage: heap_trace_gen.py <seed> <hours> [clients/h] [max client KB] > trace
+"""
+
+import heapq
+import random
+import sys
+
+FB_QXGA = 2048 * 1536 // 5
+FB_YUV = 640 * 480 * 2
+H264_PICTURES = 640 * 480 * 3 // 2 * 3
+H264_OUT = 128 * 1024
+
+
+def generate(seed, hours, rate=4, max_kb=64):
+    """Return the trace lines of one run."""
+    rng = random.Random(seed)
+    events = []
+    ids = [0]
+
+    def at(t, line):
+        heapq.heappush(events, (t, len(events), line))
+
+    def alloc(t, size, tag):
+        ids[0] += 1
+        name = '%s%d' % (tag, ids[0])
+        at(t, 'a %s %d %s' % (name, size, tag))
+        return name
+
+    def free(t, name):
+        at(t, 'f %s' % name)
+
+    end = hours * 3600
+    fb = alloc(0, FB_QXGA, 'fb_qxga')
+    store = None
+
+    sessions = []
+    t = rng.expovariate(1 / 7200)
+    while t < end:
+        length = rng.uniform(300, 1800)
+        sessions.append((t, t + length))
+        t += length + rng.expovariate(1 / 7200)
+
+    actions = [(a, 'start') for a, _ in sessions] + [(b, 'stop') for _, b in sessions]
+    actions += [(float(t), 'still') for t in range(60, int(end), 60)]
+    actions.sort()
+    yuv, encoder = [], []
+    for t, what in actions:
+        if what == 'start':
+            free(t, fb)
+            yuv = [alloc(t + 0.1, FB_YUV, 'fb_yuv') for _ in range(2)]
+            encoder = [alloc(t + 0.2, H264_PICTURES, 'h264_pic'),
+                       alloc(t + 0.2, H264_OUT, 'h264_out')]
+        elif what == 'stop':
+            for name in encoder + yuv:
+                free(t, name)
+            yuv, encoder = [], []
+            fb = alloc(t + 0.1, FB_QXGA, 'fb_qxga')
+        else:
+            size = int(rng.uniform(250e3, 480e3))
+            clone = None
+            if yuv:
+                # grab_still_yuv_stream(): JPEG profile, clone, back to YUV
+                for name in yuv:
+                    free(t, name)
+                still_fb = alloc(t + 0.01, FB_QXGA, 'fb_qxga')
+                clone = alloc(t + 0.2, size + 64, 'clone')
+                free(t + 0.21, still_fb)
+                yuv = [alloc(t + 0.22, FB_YUV, 'fb_yuv') for _ in range(2)]
+            # capture_store_put(): the new copy, then the old one goes
+            new = alloc(t + 0.3, size + 32, 'store')
+            if store:
+                free(t + 0.31, store)
+            store = new
+            optimize = alloc(t + 0.32, size, 'optimize')
+            free(t + 0.6, optimize)
+            if clone:
+                free(t + 0.7, clone)
+
+    t = 0.0
+    while t < end:
+        t += rng.expovariate(rate / 3600)
+        name = alloc(t, rng.randint(20, max_kb) * 1024, 'client')
+        free(t + rng.lognormvariate(7, 1.5), name)
+
+    lines = []
+    while events:
+        t, _, line = heapq.heappop(events)
+        lines.append('%.3f %s' % (t, line))
+    return lines
+
+
+def main():
+    if len(sys.argv) < 3:
+        sys.exit(__doc__.strip().splitlines()[-1])
+    args = [int(sys.argv[1]), float(sys.argv[2])]
+    args += [float(sys.argv[3])] if len(sys.argv) > 3 else []
+    args += [int(sys.argv[4])] if len(sys.argv) > 4 else []
+    for line in generate(*args):
+        print(line)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,223 @@
+/**
+ * @file host_jpeg.c
+ * @brief Synthetic frames, in-memory JPEG encoding and decoding for the host tests
+ */
+
+#include "host_jpeg.h"
+#include "jpeg/jpeg_enc.h"
+#include "jpeg/jpeg_scan.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if HOST_HAVE_LIBJPEG
+#include <setjmp.h>
+#include <stdio.h>
+#include <jpeglib.h>
+#endif
+
+#define SQUARE_SIZE     32
+#define SQUARE_STEP     8
+
+esp_err_t host_buf_output(const uint8_t *data, size_t len, void *ctx)
+{
+    host_buf_t *buf = ctx;
+
+    if (buf->len + len > buf->cap) {
+        size_t cap = buf->cap ? buf->cap * 2 : 4096;
+        while (cap < buf->len + len) {
+            cap *= 2;
+        }
+        uint8_t *grown = realloc(buf->data, cap);
+        if (grown == NULL) {
+            return ESP_ERR_NO_MEM;
+        }
+        buf->data = grown;
+        buf->cap = cap;
+    }
+    memcpy(buf->data + buf->len, data, len);
+    buf->len += len;
+    return ESP_OK;
+}
+
+void host_buf_free(host_buf_t *buf)
+{
+    free(buf->data);
+    memset(buf, 0, sizeof(*buf));
+}
+
+/**
+ * @brief Fixed noise in [-8, 7] for a sample position
+ */
+static int noise(int x, int y)
+{
+    uint32_t h = (uint32_t)x * 374761393u + (uint32_t)y * 668265263u;
+    h = (h ^ (h >> 13)) * 1274126177u;
+    return (int)((h >> 16) & 15) - 8;
+}
+
+static uint8_t clamp_u8(int v)
+{
+    return v < 0 ? 0 : v > 255 ? 255 : (uint8_t)v;
+}
+
+uint8_t *host_scene_yuyv(int width, int height, int frame)
+{
+    uint8_t *yuyv = malloc((size_t)width * height * 2);
+    const int sq_x = 16 + frame * SQUARE_STEP;
+    const int sq_y = height / 3;
+
+    for (int y = 0; y < height; y++) {
+        uint8_t *row = yuyv + (size_t)y * width * 2;
+        for (int x = 0; x < width; x++) {
+            int luma = 40 + 150 * x / width + 30 * y / height;
+            luma += (int)(20 * sin(x * 0.21) * cos(y * 0.13));
+            if (x > width / 2 && y > height / 2) {
+                luma = 230 - luma / 2;          // Hard-edged panel
+            }
+            if (x >= sq_x && x < sq_x + SQUARE_SIZE && y >= sq_y && y < sq_y + SQUARE_SIZE) {
+                luma = 250;
+            }
+            row[2 * x] = clamp_u8(luma + noise(x, y));
+            if (x % 2 == 0) {
+                row[2 * x + 1] = clamp_u8(128 + 60 * x / width - 30);
+                row[2 * x + 3] = clamp_u8(128 + 50 * y / height - 25 + noise(y, x) / 2);
+            }
+        }
+    }
+    return yuyv;
+}
+
+esp_err_t host_jpeg_encode(const uint8_t *yuyv, int width, int height, int quality,
+                           host_buf_t *out)
+{
+    jpeg_enc_config_t config = {
+        .width = width,
+        .height = height,
+        .quality = quality,
+        .qtable = JPEG_QTABLE_ANNEX_K,
+        .output = host_buf_output,
+        .ctx = out,
+    };
+    jpeg_enc_t *enc;
+
+    esp_err_t err = jpeg_enc_begin(&config, &enc);
+    if (err != ESP_OK) {
+        return err;
+    }
+    err = jpeg_enc_write_rows(enc, yuyv, height);
+    if (err != ESP_OK) {
+        jpeg_enc_abort(enc);
+        return err;
+    }
+    return jpeg_enc_end(enc);
+}
+
+typedef struct {
+    int16_t *coef;
+    size_t blocks;
+    size_t cap;
+} coef_list_t;
+
+static esp_err_t collect_block(const jpeg_block_t *block, void *ctx)
+{
+    coef_list_t *list = ctx;
+
+    if (list->blocks == list->cap) {
+        list->cap = list->cap ? list->cap * 2 : 1024;
+        list->coef = realloc(list->coef, list->cap * 64 * sizeof(int16_t));
+    }
+    memcpy(list->coef + list->blocks * 64, block->coef, 64 * sizeof(int16_t));
+    list->blocks++;
+    return ESP_OK;
+}
+
+esp_err_t host_jpeg_coefs(const uint8_t *jpeg, size_t len, int16_t **coef, size_t *blocks)
+{
+    jpeg_info_t *info = malloc(sizeof(jpeg_info_t));
+    coef_list_t list = { 0 };
+
+    esp_err_t err = jpeg_scan_parse(jpeg, len, info);
+    if (err == ESP_OK) {
+        err = jpeg_scan_decode(info, collect_block, &list);
+    }
+    free(info);
+    *coef = list.coef;
+    *blocks = list.blocks;
+    return err;
+}
+
+#if HOST_HAVE_LIBJPEG
+typedef struct {
+    struct jpeg_error_mgr mgr;
+    jmp_buf jump;
+} decode_error_t;
+
+static void decode_error_exit(j_common_ptr cinfo)
+{
+    longjmp(((decode_error_t *)cinfo->err)->jump, 1);
+}
+
+static void decode_quiet(j_common_ptr cinfo, int level)
+{
+}
+
+uint8_t *host_jpeg_decode(const uint8_t *jpeg, size_t len, int *width, int *height)
+{
+    struct jpeg_decompress_struct cinfo;
+    decode_error_t error;
+    uint8_t *volatile ycc = NULL;
+
+    cinfo.err = jpeg_std_error(&error.mgr);
+    error.mgr.error_exit = decode_error_exit;
+    error.mgr.emit_message = decode_quiet;
+    if (setjmp(error.jump)) {
+        jpeg_destroy_decompress(&cinfo);
+        free(ycc);
+        return NULL;
+    }
+
+    jpeg_create_decompress(&cinfo);
+    jpeg_mem_src(&cinfo, (unsigned char *)jpeg, len);
+    jpeg_read_header(&cinfo, TRUE);
+    cinfo.out_color_space = JCS_YCbCr;
+    cinfo.do_fancy_upsampling = FALSE;
+    jpeg_start_decompress(&cinfo);
+
+    const size_t stride = (size_t)cinfo.output_width * 3;
+    ycc = malloc(stride * cinfo.output_height);
+    while (cinfo.output_scanline < cinfo.output_height) {
+        JSAMPROW row = ycc + stride * cinfo.output_scanline;
+        jpeg_read_scanlines(&cinfo, &row, 1);
+    }
+    jpeg_finish_decompress(&cinfo);
+
+    *width = cinfo.output_width;
+    *height = cinfo.output_height;
+    jpeg_destroy_decompress(&cinfo);
+    return ycc;
+}
+
+double host_psnr(const uint8_t *ycc, const uint8_t *yuyv, int width, int height, int channel)
+{
+    double sum = 0;
+    long count = 0;
+
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            if (channel != 0 && x % 2) {
+                continue;
+            }
+            const uint8_t *pair = yuyv + ((size_t)y * width + (x & ~1)) * 2;
+            int src = channel == 0 ? pair[(x & 1) * 2] : pair[channel == 1 ? 1 : 3];
+            int diff = ycc[((size_t)y * width + x) * 3 + channel] - src;
+            sum += diff * diff;
+            count++;
+        }
+    }
+    if (sum == 0) {
+        return 99;
+    }
+    return 10 * log10(255.0 * 255.0 * count / sum);
+}
+#endif
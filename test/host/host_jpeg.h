@@ -0,0 +1,86 @@
+/**
+ * @file host_jpeg.h
+ * @brief Synthetic frames, in-memory JPEG encoding and decoding for the host tests
+ *
+ * Encoding goes through the firmware's jpeg_enc. Decoding uses libjpeg and
+ * is only available when the tests were configured with it
+ * (HOST_HAVE_LIBJPEG); it is the independent check on the firmware's
+ * output.
+ */
+
+#ifndef HOST_JPEG_H
+#define HOST_JPEG_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+/**
+ * @brief Growable output buffer
+ */
+typedef struct {
+    uint8_t *data;
+    size_t len;
+    size_t cap;
+} host_buf_t;
+
+/**
+ * @brief jpeg_output_cb_t appending to the host_buf_t passed as ctx
+ */
+esp_err_t host_buf_output(const uint8_t *data, size_t len, void *ctx);
+
+/**
+ * @brief Free a buffer's data and empty it
+ */
+void host_buf_free(host_buf_t *buf);
+
+/**
+ * @brief Render one frame of a synthetic scene as packed YUYV
+ *
+ * Gradients, a sinusoidal texture, sharp edges and fixed per-pixel noise,
+ * with a 32x32 square that moves 8 pixels right per frame. Frames differ
+ * only where the square was or is.
+ *
+ * @return Frame, free with free()
+ */
+uint8_t *host_scene_yuyv(int width, int height, int frame);
+
+/**
+ * @brief Encode a YUYV frame with jpeg_enc (Annex K tables)
+ *
+ * @param out Receives the JPEG, appended
+ */
+esp_err_t host_jpeg_encode(const uint8_t *yuyv, int width, int height, int quality,
+                           host_buf_t *out);
+
+/**
+ * @brief Decode the quantized coefficients of every block with jpeg_scan
+ *
+ * @param coef Receives 64 coefficients per block in scan order, zigzag
+ *             order within a block; free with free()
+ * @param blocks Receives the block count
+ * @return jpeg_scan_parse() or jpeg_scan_decode() result
+ */
+esp_err_t host_jpeg_coefs(const uint8_t *jpeg, size_t len, int16_t **coef, size_t *blocks);
+
+#if HOST_HAVE_LIBJPEG
+/**
+ * @brief Decode a JPEG with libjpeg to interleaved YCbCr
+ *
+ * Chroma is upsampled by replication, so the samples of a 4:2:2 pixel pair
+ * come back unchanged at both pixels.
+ *
+ * @return 3 bytes per pixel, free with free(); NULL if libjpeg rejected it
+ */
+uint8_t *host_jpeg_decode(const uint8_t *jpeg, size_t len, int *width, int *height);
+
+/**
+ * @brief PSNR of one channel of a decoded frame against the YUYV source
+ *
+ * @param channel 0 for Y, 1 for Cb, 2 for Cr
+ * @return PSNR in dB, 99 for identical channels
+ */
+double host_psnr(const uint8_t *ycc, const uint8_t *yuyv, int width, int height, int channel);
+#endif
+
+#endif // HOST_JPEG_H
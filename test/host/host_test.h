@@ -0,0 +1,48 @@
+/**
+ * @file host_test.h
+ * @brief Minimal assertion and timing helpers for the host tests
+ *
+ * Each test is a plain executable: CHECK() reports a failure and counts
+ * it, and main() returns host_test_result() so ctest sees the outcome.
+ */
+
+#ifndef HOST_TEST_H
+#define HOST_TEST_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+static int s_host_test_failures;
+
+#define CHECK(cond) do { \
+        if (!(cond)) { \
+            fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+            s_host_test_failures++; \
+        } \
+    } while (0)
+
+/**
+ * @brief Monotonic time in microseconds
+ */
+static inline int64_t host_time_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/**
+ * @brief Print the verdict and return the process exit code
+ */
+static inline int host_test_result(const char *name)
+{
+    if (s_host_test_failures) {
+        printf("%s: %d check(s) failed\n", name, s_host_test_failures);
+        return 1;
+    }
+    printf("%s: passed\n", name);
+    return 0;
+}
+
+#endif // HOST_TEST_H
@@ -0,0 +1,232 @@
+#!/usr/bin/env python3
+"""
+Check capture_wifi.py's mDNS discovery against a fake zeroconf.
+
+The fake browser announces services from a script of (delay, event, name,
+ServiceInfo) steps on a thread of its own, as zeroconf does. Covers parsing
+the firmware's TXT records (and records that are not a GrowPod camera's),
+the fleet inventory through add/update/remove, hostname resolution, and
+giving up on time when nothing answers.
+
+Usage: mdns_listener.py <capture_wifi.py directory>
+"""
+
+import os
+import socket
+import sys
+import threading
+import time
+import types
+
+FAILED = 0
+
+
+def check(cond, what):
+    global FAILED
+    if not cond:
+        print('FAILED: ' + what)
+        FAILED += 1
+
+
+class ServiceInfo:
+    def __init__(self, server, ip=None, port=80, **txt):
+        self.server = server
+        self.addresses = [socket.inet_aton(ip)] if ip else []
+        self.port = port
+        self.properties = {k.encode(): (v.encode() if v is not None else None)
+                           for k, v in txt.items()}
+
+
+def camera_txt(**overrides):
+    """TXT records as main/net/mdns_txt.c publishes them"""
+    txt = {'txtvers': '1', 'fw': 'v1.4.0', 'api': 'capture,stream,status,events',
+           'sport': '80', 'uport': '5006', 'fs': 'UXGA', 'q': '10', 'mode': 'still',
+           'cap': '42'}
+    txt.update(overrides)
+    return {k: v for k, v in txt.items() if v is not False}
+
+
+class FakeZeroconf:
+    """Serves the ServiceInfo of the scenario's services"""
+    scenario = []               # (delay s, 'add'|'update'|'remove', name, info)
+    fail = False
+    instances = []
+
+    def __init__(self):
+        if FakeZeroconf.fail:
+            raise OSError('no multicast interface')
+        self.services = {}
+        self.closed = False
+        FakeZeroconf.instances.append(self)
+
+    def get_service_info(self, type_, name):
+        return self.services.get(name)
+
+    def close(self):
+        self.closed = True
+
+
+class FakeBrowser:
+    """Runs the scenario on a thread, like zeroconf's browser"""
+    instances = []
+
+    def __init__(self, zc, type_, listener):
+        self.cancelled = threading.Event()
+        FakeBrowser.instances.append(self)
+        threading.Thread(target=self._run, args=(zc, type_, listener), daemon=True).start()
+
+    def _run(self, zc, type_, listener):
+        for delay, event, name, info in FakeZeroconf.scenario:
+            if self.cancelled.wait(delay):
+                return
+            if event == 'remove':
+                zc.services.pop(name, None)
+                listener.remove_service(zc, type_, name)
+                continue
+            if info is not None:
+                zc.services[name] = info
+            getattr(listener, event + '_service')(zc, type_, name)
+
+    def cancel(self):
+        self.cancelled.set()
+
+
+def stub_modules():
+    requests = types.ModuleType('requests')
+    requests.exceptions = types.SimpleNamespace(Timeout=Exception, ConnectionError=Exception)
+    sys.modules.setdefault('requests', requests)
+
+    zeroconf = types.ModuleType('zeroconf')
+    zeroconf.Zeroconf = FakeZeroconf
+    zeroconf.ServiceBrowser = FakeBrowser
+    zeroconf.ServiceListener = type('ServiceListener', (), {})
+    sys.modules['zeroconf'] = zeroconf
+
+
+def test_txt(cw):
+    cam = cw.parse_camera_txt(ServiceInfo('growpod-a.local.', '10.0.0.5', 80, **camera_txt()))
+    check(cam == {'host': 'growpod-a.local', 'ip': '10.0.0.5', 'port': 80,
+                  'firmware': 'v1.4.0', 'endpoints': ['capture', 'stream', 'status', 'events'],
+                  'stream_port': 80, 'udp_port': 5006, 'framesize': 'UXGA', 'quality': 10,
+                  'mode': 'still', 'captures': 42}, 'full record: %r' % (cam,))
+
+    # Built without the UDP still transfer, stream port left to the default
+    cam = cw.parse_camera_txt(ServiceInfo('growpod-b.local.', '10.0.0.6', 8080,
+                                          **camera_txt(uport=False, sport=False)))
+    check(cam is not None and cam['udp_port'] is None, 'no uport')
+    check(cam is not None and cam['stream_port'] == 8080, 'sport defaults to the port')
+
+    # Optional counters missing, a key without a value, no address yet
+    cam = cw.parse_camera_txt(ServiceInfo('growpod-c.local.', None,
+                                          **camera_txt(q=False, cap=False, api=None)))
+    check(cam is not None and cam['ip'] is None, 'no address')
+    check(cam is not None and cam['quality'] == -1 and cam['captures'] == 0, 'defaults')
+    check(cam is not None and cam['endpoints'] == [''], 'valueless api')
+
+    # Other devices' services
+    check(cw.parse_camera_txt(ServiceInfo('printer.local.', '10.0.0.9')) is None, 'no TXT')
+    check(cw.parse_camera_txt(ServiceInfo('nas.local.', '10.0.0.9', path='/')) is None,
+          'foreign TXT')
+    check(cw.parse_camera_txt(ServiceInfo('x.local.', '10.0.0.9', **camera_txt(txtvers='2')))
+          is None, 'future txtvers')
+    check(cw.parse_camera_txt(ServiceInfo('x.local.', '10.0.0.9', **camera_txt(fw=False)))
+          is None, 'no fw')
+    check(cw.parse_camera_txt(ServiceInfo('x.local.', '10.0.0.9', **camera_txt(q='high')))
+          is None, 'malformed number')
+
+
+def test_inventory(cw):
+    zc = FakeZeroconf()
+    listener = cw.CameraServiceListener()
+    a = ServiceInfo('growpod-a.local.', '10.0.0.5', **camera_txt())
+    zc.services = {'a': a, 'printer': ServiceInfo('printer.local.', '10.0.0.9')}
+    listener.add_service(zc, '_http._tcp.local.', 'a')
+    listener.add_service(zc, '_http._tcp.local.', 'printer')
+    listener.add_service(zc, '_http._tcp.local.', 'vanished')
+    check(list(listener.inventory) == ['a'], 'only cameras are listed')
+
+    # A capture bumps the counter in the TXT record
+    zc.services['a'] = ServiceInfo('growpod-a.local.', '10.0.0.5', **camera_txt(cap='43'))
+    listener.update_service(zc, '_http._tcp.local.', 'a')
+    check(listener.inventory['a']['captures'] == 43, 'update')
+    listener.remove_service(zc, '_http._tcp.local.', 'a')
+    listener.remove_service(zc, '_http._tcp.local.', 'a')
+    check(listener.inventory == {}, 'remove')
+    check(not listener.found, 'no hostname, nothing resolved')
+
+
+def test_resolve(cw):
+    cam = ServiceInfo('growpod-camera.local.', '10.0.0.7', **camera_txt())
+    other = ServiceInfo('growpod-other.local.', '10.0.0.8', **camera_txt())
+    no_addr = ServiceInfo('growpod-camera.local.', None, **camera_txt())
+
+    # Found as soon as it answers, with or without .local in the name asked for
+    for name in ('growpod-camera', 'growpod-camera.local'):
+        FakeZeroconf.scenario = [(0.05, 'add', 'other', other), (0.15, 'add', 'cam', cam)]
+        start = time.time()
+        ip = cw.resolve_mdns_fast(name, timeout=3.0)
+        elapsed = time.time() - start
+        check(ip == '10.0.0.7', 'resolve %s: %r' % (name, ip))
+        check(elapsed < 1.0, 'resolve %s returned after %.2f s' % (name, elapsed))
+        check(FakeBrowser.instances[-1].cancelled.is_set(), 'browser cancelled')
+        check(FakeZeroconf.instances[-1].closed, 'zeroconf closed')
+
+    # An answer without an address does not count; a later one with it does
+    FakeZeroconf.scenario = [(0.05, 'add', 'cam', no_addr), (0.1, 'update', 'cam', cam)]
+    check(cw.resolve_mdns_fast('growpod-camera', timeout=2.0) == '10.0.0.7', 'address later')
+
+    # Nothing answers: None once the timeout is up, and not long after
+    for scenario in ([], [(0.05, 'add', 'other', other)], [(5.0, 'add', 'cam', cam)]):
+        FakeZeroconf.scenario = scenario
+        start = time.time()
+        ip = cw.resolve_mdns_fast('growpod-camera', timeout=0.5)
+        elapsed = time.time() - start
+        check(ip is None, 'timeout returns None')
+        check(0.5 <= elapsed < 0.9, 'timeout took %.2f s' % elapsed)
+        check(FakeBrowser.instances[-1].cancelled.is_set(), 'browser cancelled on timeout')
+        check(FakeZeroconf.instances[-1].closed, 'zeroconf closed on timeout')
+
+    # No usable network, or no zeroconf library
+    FakeZeroconf.fail = True
+    check(cw.resolve_mdns_fast('growpod-camera', timeout=0.5) is None, 'zeroconf error')
+    FakeZeroconf.fail = False
+    cw.ZEROCONF_AVAILABLE = False
+    check(cw.resolve_mdns_fast('growpod-camera', timeout=0.5) is None, 'no zeroconf')
+    check(cw.discover_fleet(timeout=0.5) == [], 'no zeroconf, no fleet')
+    cw.ZEROCONF_AVAILABLE = True
+
+
+def test_fleet(cw):
+    FakeZeroconf.scenario = [
+        (0.02, 'add', 'b', ServiceInfo('growpod-b.local.', '10.0.0.6', **camera_txt())),
+        (0.02, 'add', 'a', ServiceInfo('growpod-a.local.', '10.0.0.5', **camera_txt())),
+        (0.02, 'add', 'p', ServiceInfo('printer.local.', '10.0.0.9')),
+        (0.02, 'add', 'c', ServiceInfo('growpod-c.local.', '10.0.0.4', **camera_txt())),
+        (0.02, 'remove', 'c', None),
+        (2.0, 'add', 'late', ServiceInfo('growpod-d.local.', '10.0.0.3', **camera_txt())),
+    ]
+    start = time.time()
+    fleet = cw.discover_fleet(timeout=0.5)
+    elapsed = time.time() - start
+    check([c['host'] for c in fleet] == ['growpod-a.local', 'growpod-b.local'],
+          'fleet: %r' % [c['host'] for c in fleet])
+    check(elapsed < 0.9, 'fleet browse took %.2f s' % elapsed)
+    check(FakeBrowser.instances[-1].cancelled.is_set(), 'fleet browser cancelled')
+
+
+def main():
+    stub_modules()
+    sys.path.insert(0, os.path.abspath(sys.argv[1]))
+    import capture_wifi
+    capture_wifi.log = lambda message, prefix='*': None
+
+    test_txt(capture_wifi)
+    test_inventory(capture_wifi)
+    test_resolve(capture_wifi)
+    test_fleet(capture_wifi)
+    print('mdns_listener: %s' % ('%d check(s) failed' % FAILED if FAILED else 'passed'))
+    sys.exit(1 if FAILED else 0)
+
+
+if __name__ == '__main__':
+    main()
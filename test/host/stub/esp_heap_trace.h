@@ -0,0 +1,38 @@
+/**
+ * @file esp_heap_trace.h
+ * @brief Host stub of the standalone heap trace API
+ *
+ * Declarations only: a test that reads the trace provides the records.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+typedef struct {
+    uint32_t ccount;
+    void *address;
+    size_t size;
+    void *alloced_by[CONFIG_HEAP_TRACING_STACK_DEPTH];
+    void *freed_by[CONFIG_HEAP_TRACING_STACK_DEPTH];
+} heap_trace_record_t;
+
+typedef struct {
+    size_t count;
+    size_t capacity;
+    size_t high_water_mark;
+    bool has_overflowed;
+} heap_trace_summary_t;
+
+typedef enum {
+    HEAP_TRACE_ALL,
+    HEAP_TRACE_LEAKS,
+} heap_trace_mode_t;
+
+esp_err_t heap_trace_init_standalone(heap_trace_record_t *records, size_t num_records);
+esp_err_t heap_trace_start(heap_trace_mode_t mode);
+esp_err_t heap_trace_summary(heap_trace_summary_t *summary);
+esp_err_t heap_trace_get(size_t index, heap_trace_record_t *record);
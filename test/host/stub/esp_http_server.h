@@ -0,0 +1,30 @@
+/**
+ * @file esp_http_server.h
+ * @brief Host stub of the HTTP server types the tested headers name
+ */
+
+#pragma once
+
+#include <sys/types.h>
+#include "esp_err.h"
+
+typedef void *httpd_handle_t;
+
+/**
+ * @brief The request fields the firmware reads
+ */
+typedef struct httpd_req {
+    httpd_handle_t handle;
+    void *user_ctx;
+} httpd_req_t;
+
+// Defined by the tests that check what is sent
+int httpd_send(httpd_req_t *req, const char *buf, size_t buf_len);
+esp_err_t httpd_resp_send_chunk(httpd_req_t *r, const char *buf, ssize_t buf_len);
+
+// Defined by the tests that take requests over (async handlers)
+esp_err_t httpd_req_async_handler_begin(httpd_req_t *r, httpd_req_t **out);
+esp_err_t httpd_req_async_handler_complete(httpd_req_t *r);
+int httpd_req_to_sockfd(httpd_req_t *r);
+esp_err_t httpd_sess_trigger_close(httpd_handle_t handle, int sockfd);
+esp_err_t httpd_get_client_list(httpd_handle_t handle, size_t *fds, int *client_fds);
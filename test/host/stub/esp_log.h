@@ -0,0 +1,17 @@
+/**
+ * @file esp_log.h
+ * @brief Host stub of the ESP-IDF log macros
+ *
+ * Warnings and errors go to stderr; info and debug lines are compiled,
+ * so their arguments are still type-checked, but not printed.
+ */
+
+#pragma once
+
+#include <stdio.h>
+
+#define ESP_LOGE(tag, fmt, ...) fprintf(stderr, "E %s: " fmt "\n", tag, ##__VA_ARGS__)
+#define ESP_LOGW(tag, fmt, ...) fprintf(stderr, "W %s: " fmt "\n", tag, ##__VA_ARGS__)
+#define ESP_EARLY_LOGW          ESP_LOGW
+#define ESP_LOGI(tag, fmt, ...) do { if (0) printf(fmt, ##__VA_ARGS__); } while (0)
+#define ESP_LOGD(tag, fmt, ...) do { if (0) printf(fmt, ##__VA_ARGS__); } while (0)
@@ -0,0 +1,15 @@
+/**
+ * @file esp_memory_utils.h
+ * @brief Host stub of the address range checks, with the ESP32-S3 map
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// External RAM as mapped through the data cache
+static inline bool esp_ptr_external_ram(const void *p)
+{
+    return (uintptr_t)p >= 0x3c000000 && (uintptr_t)p < 0x3e000000;
+}
@@ -0,0 +1,61 @@
+/**
+ * @file FreeRTOS.h
+ * @brief Host stub of the FreeRTOS types, on pthreads
+ *
+ * One tick is one millisecond. Critical sections are mutexes, so they
+ * exclude other threads as a spinlock excludes the other core.
+ */
+
+#pragma once
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef int BaseType_t;
+typedef unsigned UBaseType_t;
+typedef uint32_t TickType_t;
+typedef uint8_t StackType_t;            // Bytes, as on the Xtensa port
+
+#define pdTRUE                  1
+#define pdFALSE                 0
+#define pdPASS                  pdTRUE
+#define pdFAIL                  pdFALSE
+#define portMAX_DELAY           ((TickType_t)0xffffffffu)
+#define portTICK_PERIOD_MS      1
+#define pdMS_TO_TICKS(ms)       ((TickType_t)(ms))
+#define tskNO_AFFINITY          0x7fffffff
+#define portNUM_PROCESSORS      2
+#define configMAX_TASK_NAME_LEN 16
+#define configRUN_TIME_COUNTER_TYPE uint32_t
+#define IRAM_ATTR               // No IRAM: portmacro.h brings in esp_attr.h on target
+
+typedef pthread_mutex_t portMUX_TYPE;
+#define portMUX_INITIALIZER_UNLOCKED PTHREAD_MUTEX_INITIALIZER
+#define portENTER_CRITICAL(mux) pthread_mutex_lock(mux)
+#define portEXIT_CRITICAL(mux)  pthread_mutex_unlock(mux)
+
+/**
+ * @brief Counting semaphore; binary ones are capped at one
+ */
+typedef struct host_sem {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    unsigned count;
+    unsigned max;
+    bool is_static;
+    uint64_t given_seq;         // Global order of the last give, 0 if never given
+} host_sem_t;
+
+typedef host_sem_t StaticSemaphore_t;
+typedef host_sem_t *SemaphoreHandle_t;
+typedef struct host_queue *QueueHandle_t;
+typedef pthread_t *TaskHandle_t;
+
+/**
+ * @brief Global order of semaphore gives so far
+ *
+ * Lets a test tell in which order requests were answered.
+ */
+uint64_t host_sem_give_count(void);
@@ -0,0 +1,18 @@
+/**
+ * @file semphr.h
+ * @brief Host stub of the FreeRTOS semaphore API
+ */
+
+#pragma once
+
+#include "freertos/FreeRTOS.h"
+
+SemaphoreHandle_t xSemaphoreCreateBinary(void);
+SemaphoreHandle_t xSemaphoreCreateBinaryStatic(StaticSemaphore_t *buffer);
+SemaphoreHandle_t xSemaphoreCreateMutex(void);
+BaseType_t xSemaphoreTake(SemaphoreHandle_t sem, TickType_t ticks);
+BaseType_t xSemaphoreGive(SemaphoreHandle_t sem);
+void vSemaphoreDelete(SemaphoreHandle_t sem);
+
+// Interrupts are threads here, so a give from one is an ordinary give
+#define xSemaphoreGiveFromISR(sem, woken) (*(woken) = pdFALSE, xSemaphoreGive(sem))
@@ -0,0 +1,61 @@
+/**
+ * @file task.h
+ * @brief Host stub of the FreeRTOS task API: tasks are detached pthreads
+ */
+
+#pragma once
+
+#include "freertos/FreeRTOS.h"
+
+typedef void (*TaskFunction_t)(void *arg);
+
+typedef enum {
+    eRunning = 0,
+    eReady,
+    eBlocked,
+    eSuspended,
+    eDeleted,
+    eInvalid
+} eTaskState;
+
+/**
+ * @brief One task's entry in uxTaskGetSystemState(), with the core ID
+ */
+typedef struct {
+    TaskHandle_t xHandle;
+    const char *pcTaskName;
+    UBaseType_t xTaskNumber;
+    eTaskState eCurrentState;
+    UBaseType_t uxCurrentPriority;
+    UBaseType_t uxBasePriority;
+    configRUN_TIME_COUNTER_TYPE ulRunTimeCounter;
+    StackType_t *pxStackBase;
+    uint32_t usStackHighWaterMark;
+    BaseType_t xCoreID;
+} TaskStatus_t;
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char *name, uint32_t stack_size,
+                                   void *arg, UBaseType_t priority, TaskHandle_t *handle,
+                                   BaseType_t core);
+TickType_t xTaskGetTickCount(void);
+
+// No scheduler to ask: defined by the tests that report on tasks
+UBaseType_t uxTaskGetSystemState(TaskStatus_t *status, UBaseType_t count,
+                                 configRUN_TIME_COUNTER_TYPE *total);
+
+/**
+ * @brief Task notifications, as a counting semaphore
+ *
+ * Handles are NULL here, so there is one notification value for the
+ * process; enough for the tests, which run one notified task at a time.
+ */
+uint32_t ulTaskNotifyTake(BaseType_t clear_on_exit, TickType_t ticks);
+BaseType_t xTaskNotifyGive(TaskHandle_t task);
+void vTaskDelay(TickType_t ticks);
+
+/**
+ * @brief Sleep until *wake + ticks and advance *wake
+ *
+ * Weak, so a test can replace it to run a periodic task step by step.
+ */
+void vTaskDelayUntil(TickType_t *wake, TickType_t ticks);
@@ -0,0 +1,335 @@
+/**
+ * @file freertos_host.c
+ * @brief Host stub of the FreeRTOS semaphore, queue and task APIs
+ */
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include <errno.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+static atomic_uint_fast64_t s_gives;
+
+/**
+ * @brief Absolute CLOCK_REALTIME deadline for a wait of some ticks
+ */
+static struct timespec deadline(TickType_t ticks)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    ts.tv_sec += ticks / 1000;
+    ts.tv_nsec += (long)(ticks % 1000) * 1000000;
+    if (ts.tv_nsec >= 1000000000) {
+        ts.tv_sec++;
+        ts.tv_nsec -= 1000000000;
+    }
+    return ts;
+}
+
+/**
+ * @brief Wait on a condition for at most some ticks
+ *
+ * @return false once the time is up
+ */
+static bool wait_cond(pthread_cond_t *cond, pthread_mutex_t *lock, TickType_t ticks,
+                      const struct timespec *until)
+{
+    if (ticks == 0) {
+        return false;
+    }
+    if (ticks == portMAX_DELAY) {
+        pthread_cond_wait(cond, lock);
+        return true;
+    }
+    return pthread_cond_timedwait(cond, lock, until) != ETIMEDOUT;
+}
+
+uint64_t host_sem_give_count(void)
+{
+    return atomic_load(&s_gives);
+}
+
+static SemaphoreHandle_t sem_init(host_sem_t *sem, unsigned count, unsigned max, bool is_static)
+{
+    pthread_mutex_init(&sem->lock, NULL);
+    pthread_cond_init(&sem->cond, NULL);
+    sem->count = count;
+    sem->max = max;
+    sem->is_static = is_static;
+    sem->given_seq = 0;
+    return sem;
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinary(void)
+{
+    host_sem_t *sem = malloc(sizeof(*sem));
+    return sem ? sem_init(sem, 0, 1, false) : NULL;
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinaryStatic(StaticSemaphore_t *buffer)
+{
+    return sem_init(buffer, 0, 1, true);
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void)
+{
+    host_sem_t *sem = malloc(sizeof(*sem));
+    return sem ? sem_init(sem, 1, 1, false) : NULL;
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t sem, TickType_t ticks)
+{
+    struct timespec until = deadline(ticks);
+    BaseType_t taken = pdTRUE;
+
+    pthread_mutex_lock(&sem->lock);
+    while (sem->count == 0) {
+        if (!wait_cond(&sem->cond, &sem->lock, ticks, &until)) {
+            taken = sem->count > 0 ? pdTRUE : pdFALSE;
+            break;
+        }
+    }
+    if (taken) {
+        sem->count--;
+    }
+    pthread_mutex_unlock(&sem->lock);
+    return taken;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t sem)
+{
+    BaseType_t given = pdFALSE;
+
+    pthread_mutex_lock(&sem->lock);
+    if (sem->count < sem->max) {
+        sem->count++;
+        sem->given_seq = atomic_fetch_add(&s_gives, 1) + 1;
+        given = pdTRUE;
+        pthread_cond_signal(&sem->cond);
+    }
+    pthread_mutex_unlock(&sem->lock);
+    return given;
+}
+
+void vSemaphoreDelete(SemaphoreHandle_t sem)
+{
+    pthread_cond_destroy(&sem->cond);
+    pthread_mutex_destroy(&sem->lock);
+    // A static semaphore's buffer stays readable, e.g. its given_seq
+    if (!sem->is_static) {
+        free(sem);
+    }
+}
+
+/**
+ * @brief Fixed-size ring of item copies
+ */
+struct host_queue {
+    pthread_mutex_t lock;
+    pthread_cond_t not_empty;
+    pthread_cond_t not_full;
+    size_t item_size;
+    unsigned length;
+    unsigned head;              // Oldest item
+    unsigned count;
+    uint8_t *items;
+};
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size)
+{
+    QueueHandle_t q = calloc(1, sizeof(*q));
+    if (q == NULL) {
+        return NULL;
+    }
+    q->items = malloc((size_t)length * item_size);
+    if (q->items == NULL) {
+        free(q);
+        return NULL;
+    }
+    pthread_mutex_init(&q->lock, NULL);
+    pthread_cond_init(&q->not_empty, NULL);
+    pthread_cond_init(&q->not_full, NULL);
+    q->item_size = item_size;
+    q->length = length;
+    return q;
+}
+
+static BaseType_t queue_send(QueueHandle_t q, const void *item, TickType_t ticks, bool front)
+{
+    struct timespec until = deadline(ticks);
+
+    pthread_mutex_lock(&q->lock);
+    while (q->count == q->length) {
+        if (!wait_cond(&q->not_full, &q->lock, ticks, &until) && q->count == q->length) {
+            pthread_mutex_unlock(&q->lock);
+            return pdFALSE;
+        }
+    }
+    unsigned slot;
+    if (front) {
+        q->head = (q->head + q->length - 1) % q->length;
+        slot = q->head;
+    } else {
+        slot = (q->head + q->count) % q->length;
+    }
+    memcpy(q->items + (size_t)slot * q->item_size, item, q->item_size);
+    q->count++;
+    pthread_cond_signal(&q->not_empty);
+    pthread_mutex_unlock(&q->lock);
+    return pdTRUE;
+}
+
+BaseType_t xQueueSend(QueueHandle_t queue, const void *item, TickType_t ticks)
+{
+    return queue_send(queue, item, ticks, false);
+}
+
+BaseType_t xQueueSendToFront(QueueHandle_t queue, const void *item, TickType_t ticks)
+{
+    return queue_send(queue, item, ticks, true);
+}
+
+BaseType_t xQueueOverwrite(QueueHandle_t queue, const void *item)
+{
+    // Only defined for queues of length one
+    pthread_mutex_lock(&queue->lock);
+    memcpy(queue->items + (size_t)queue->head * queue->item_size, item, queue->item_size);
+    queue->count = 1;
+    pthread_cond_signal(&queue->not_empty);
+    pthread_mutex_unlock(&queue->lock);
+    return pdTRUE;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t q, void *item, TickType_t ticks)
+{
+    struct timespec until = deadline(ticks);
+
+    pthread_mutex_lock(&q->lock);
+    while (q->count == 0) {
+        if (!wait_cond(&q->not_empty, &q->lock, ticks, &until) && q->count == 0) {
+            pthread_mutex_unlock(&q->lock);
+            return pdFALSE;
+        }
+    }
+    memcpy(item, q->items + (size_t)q->head * q->item_size, q->item_size);
+    q->head = (q->head + 1) % q->length;
+    q->count--;
+    pthread_cond_signal(&q->not_full);
+    pthread_mutex_unlock(&q->lock);
+    return pdTRUE;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t q)
+{
+    pthread_mutex_lock(&q->lock);
+    UBaseType_t count = q->count;
+    pthread_mutex_unlock(&q->lock);
+    return count;
+}
+
+void vQueueDelete(QueueHandle_t q)
+{
+    pthread_cond_destroy(&q->not_full);
+    pthread_cond_destroy(&q->not_empty);
+    pthread_mutex_destroy(&q->lock);
+    free(q->items);
+    free(q);
+}
+
+typedef struct {
+    TaskFunction_t fn;
+    void *arg;
+} task_start_t;
+
+static void *task_trampoline(void *p)
+{
+    task_start_t start = *(task_start_t *)p;
+    free(p);
+    start.fn(start.arg);
+    return NULL;
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char *name, uint32_t stack_size,
+                                   void *arg, UBaseType_t priority, TaskHandle_t *handle,
+                                   BaseType_t core)
+{
+    pthread_t thread;
+    task_start_t *start = malloc(sizeof(*start));
+
+    if (start == NULL) {
+        return pdFAIL;
+    }
+    start->fn = fn;
+    start->arg = arg;
+    if (pthread_create(&thread, NULL, task_trampoline, start) != 0) {
+        free(start);
+        return pdFAIL;
+    }
+    pthread_detach(thread);
+    if (handle) {
+        *handle = NULL;
+    }
+    return pdPASS;
+}
+
+static pthread_mutex_t s_notify_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t s_notify_cond = PTHREAD_COND_INITIALIZER;
+static uint32_t s_notify_value;
+
+uint32_t ulTaskNotifyTake(BaseType_t clear_on_exit, TickType_t ticks)
+{
+    struct timespec until = deadline(ticks);
+    uint32_t value;
+
+    pthread_mutex_lock(&s_notify_lock);
+    while (s_notify_value == 0) {
+        if (!wait_cond(&s_notify_cond, &s_notify_lock, ticks, &until)) {
+            break;
+        }
+    }
+    value = s_notify_value;
+    if (value > 0) {
+        s_notify_value = clear_on_exit ? 0 : value - 1;
+    }
+    pthread_mutex_unlock(&s_notify_lock);
+    return value;
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task)
+{
+    pthread_mutex_lock(&s_notify_lock);
+    s_notify_value++;
+    pthread_cond_signal(&s_notify_cond);
+    pthread_mutex_unlock(&s_notify_lock);
+    return pdPASS;
+}
+
+TickType_t xTaskGetTickCount(void)
+{
+    struct timespec ts;
+
+    // Wraps like the real count; callers compare ticks by difference
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (TickType_t)((int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000);
+}
+
+void vTaskDelay(TickType_t ticks)
+{
+    usleep((useconds_t)ticks * 1000);
+}
+
+__attribute__((weak)) void vTaskDelayUntil(TickType_t *wake, TickType_t ticks)
+{
+    *wake += ticks;
+    TickType_t left = *wake - xTaskGetTickCount();
+    // Past deadlines wrap to large values; do not sleep for those
+    if (left <= ticks) {
+        vTaskDelay(left);
+    }
+}
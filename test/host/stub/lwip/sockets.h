@@ -0,0 +1,14 @@
+/**
+ * @file sockets.h
+ * @brief Host stub of the lwIP socket API: the host's BSD sockets
+ */
+
+#pragma once
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#define lwip_writev writev
@@ -0,0 +1,19 @@
+/**
+ * @file strlcpy.c
+ * @brief strlcpy() as newlib has it
+ */
+
+#include "strlcpy.h"
+#include <string.h>
+
+size_t strlcpy(char *dst, const char *src, size_t size)
+{
+    size_t len = strlen(src);
+
+    if (size > 0) {
+        size_t n = len < size ? len : size - 1;
+        memcpy(dst, src, n);
+        dst[n] = '\0';
+    }
+    return len;
+}
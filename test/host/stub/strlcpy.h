@@ -0,0 +1,13 @@
+/**
+ * @file strlcpy.h
+ * @brief strlcpy() for C libraries older than glibc 2.38
+ *
+ * Newlib has it; CMake force-includes this header only where the host's
+ * string.h does not declare it.
+ */
+
+#pragma once
+
+#include <stddef.h>
+
+size_t strlcpy(char *dst, const char *src, size_t size);
@@ -0,0 +1,293 @@
+/**
+ * @file test_admission.c
+ * @brief Admission control, and a load model of the httpd task
+ *
+ * Checks the buckets against the default limits: the burst, 429 and 503
+ * with their Retry-After, refill for clients polling faster than the
+ * refill step, the LRU client table, the stream cap and the limit
+ * validation. Then replays 10 minutes of traffic through a model of the
+ * single httpd task, which serves one request at a time in arrival
+ * order: a legitimate client taking a still every 5 s, next to a script
+ * hammering /capture and opening streams, and optionally a swarm of 20
+ * addresses. Prints the legitimate client's latency with and without
+ * admission.
+ */
+
+#include "host_test.h"
+#include "net/admission.h"
+#include <stdbool.h>
+#include <stdlib.h>
+
+#define SIM_US          (600LL * 1000000)   // 10 minutes
+#define CAPTURE_US      180000              // Sensor and JPEG for a QXGA still
+#define STILL_BYTES     400000
+#define LINK_BPS        2500000             // Usable WiFi throughput
+#define STREAM_BPS      400000              // One VGA MJPEG stream
+#define REJECT_US       300                 // Parse and the 429/503 reply
+#define STREAM_OPEN_US  2000                // Hand-off to the stream pipeline
+#define HARD_STREAMS    4                   // STREAM_MAX_CLIENTS
+#define MAX_SOURCES     32
+#define MAX_SAMPLES     1024
+
+static void test_buckets(void)
+{
+    uint32_t retry = 0;
+    admission_stats_t stats;
+
+    // Capture: a burst of 3, then one still per 5 s
+    admission_init(0);
+    for (int i = 0; i < 3; i++) {
+        CHECK(admission_check(ADMIT_CAPTURE, 1, 0, &retry) == ADMIT_OK);
+    }
+    CHECK(admission_check(ADMIT_CAPTURE, 1, 0, &retry) == ADMIT_CLIENT_LIMITED);
+    CHECK(retry == 5);
+    CHECK(admission_check(ADMIT_CAPTURE, 1, 4999999, &retry) == ADMIT_CLIENT_LIMITED);
+    CHECK(retry == 1);
+    CHECK(admission_check(ADMIT_CAPTURE, 1, 5000000, &retry) == ADMIT_OK);
+
+    // Classes are independent
+    CHECK(admission_check(ADMIT_STATUS, 1, 5000000, &retry) == ADMIT_OK);
+
+    // Polling every 100 us still refills on time
+    admission_init(0);
+    int admitted = 0;
+    for (int64_t t = 0; t <= 5000000; t += 100) {
+        admitted += admission_check(ADMIT_CAPTURE, 7, t, &retry) == ADMIT_OK;
+    }
+    CHECK(admitted == 4);
+
+    // The global bucket: 503, and the rejected client is not charged
+    admission_init(0);
+    for (uint32_t ip = 10; ip < 16; ip++) {
+        CHECK(admission_check(ADMIT_CAPTURE, ip, 0, &retry) == ADMIT_OK);
+    }
+    CHECK(admission_check(ADMIT_CAPTURE, 99, 0, &retry) == ADMIT_GLOBAL_LIMITED);
+    CHECK(retry == 2);
+    CHECK(admission_check(ADMIT_CAPTURE, 99, 2000000, &retry) == ADMIT_OK);
+    CHECK(admission_check(ADMIT_CAPTURE, 99, 4000000, &retry) == ADMIT_OK);
+    admission_get_stats(&stats);
+    CHECK(stats.admitted[ADMIT_CAPTURE] == 8);
+    CHECK(stats.global_limited[ADMIT_CAPTURE] == 1);
+    CHECK(stats.client_limited[ADMIT_CAPTURE] == 0);
+
+    // A flood of new addresses evicts the least recently seen client,
+    // which comes back with a full bucket
+    admission_init(0);
+    for (int i = 0; i < 3; i++) {
+        admission_check(ADMIT_CAPTURE, 1, 0, &retry);
+    }
+    for (uint32_t ip = 0; ip < ADMISSION_MAX_CLIENTS - 1; ip++) {
+        admission_check(ADMIT_STATUS, 200 + ip, 1 + ip, &retry);
+    }
+    CHECK(admission_check(ADMIT_CAPTURE, 1, 100, &retry) == ADMIT_CLIENT_LIMITED);
+    for (uint32_t ip = 0; ip < ADMISSION_MAX_CLIENTS; ip++) {
+        admission_check(ADMIT_STATUS, 300 + ip, 200 + ip, &retry);
+    }
+    CHECK(admission_check(ADMIT_CAPTURE, 1, 300, &retry) == ADMIT_OK);
+
+    // Streams
+    CHECK(admission_check_streams(2) == ADMIT_OK);
+    CHECK(admission_check_streams(3) == ADMIT_STREAMS_FULL);
+
+    // Configuration
+    admission_config_t config;
+    admission_get_config(&config);
+    config.classes[ADMIT_CAPTURE].client.burst = 0;
+    CHECK(admission_set_config(&config) == ESP_ERR_INVALID_ARG);
+    config.classes[ADMIT_CAPTURE].client.rate = 0;
+    config.max_streams = 0;
+    CHECK(admission_set_config(&config) == ESP_OK);
+    // Without a client limit only the global bucket's last two tokens count
+    CHECK(admission_check(ADMIT_CAPTURE, 1, 400, &retry) == ADMIT_OK);
+    CHECK(admission_check(ADMIT_CAPTURE, 1, 400, &retry) == ADMIT_OK);
+    CHECK(admission_check(ADMIT_CAPTURE, 1, 400, &retry) == ADMIT_GLOBAL_LIMITED);
+    CHECK(admission_check_streams(100) == ADMIT_OK);
+
+    for (int c = 0; c < ADMIT_CLASS_COUNT; c++) {
+        CHECK((int)admission_class_find(admission_class_name(c)) == c);
+    }
+    CHECK(admission_class_find("stills") == ADMIT_CLASS_COUNT);
+}
+
+typedef enum {
+    SOURCE_LEGIT,
+    SOURCE_HAMMER,              // Comes straight back, ignoring Retry-After
+    SOURCE_SWARM,
+    SOURCE_STREAMER,
+} source_kind_t;
+
+typedef struct {
+    source_kind_t kind;
+    uint32_t ip;
+    int64_t next_us;
+    int64_t period_us;          // 0 for a closed loop
+    bool queued;
+} source_t;
+
+typedef struct {
+    const char *name;
+    int legit_p50_ms;
+    int legit_p99_ms;
+    int legit_served;
+    int legit_rejected;
+    int streams;
+    long captures;
+    long rejections;
+} load_result_t;
+
+static uint32_t s_rand = 1;
+
+static uint32_t rand_next(void)
+{
+    s_rand = s_rand * 1103515245u + 12345u;
+    return s_rand >> 8;
+}
+
+static int cmp_i64(const void *a, const void *b)
+{
+    int64_t x = *(const int64_t *)a, y = *(const int64_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+static load_result_t simulate(const char *name, bool script, bool swarm, bool admission)
+{
+    source_t src[MAX_SOURCES];
+    source_t *queue[MAX_SOURCES];
+    int64_t arrive[MAX_SOURCES];
+    static int64_t latency[MAX_SAMPLES];
+    int sources = 0, head = 0, queued = 0, served = 0;
+    load_result_t res = { .name = name };
+
+    admission_init(0);
+    s_rand = 1;
+    src[sources++] = (source_t){ SOURCE_LEGIT, 1, 1000000, 5000000, false };
+    if (script) {
+        for (int i = 0; i < 4; i++) {
+            src[sources++] = (source_t){ SOURCE_HAMMER, 2, 0, 0, false };
+        }
+        src[sources++] = (source_t){ SOURCE_STREAMER, 3, 500000, 1000000, false };
+    }
+    if (swarm) {
+        for (int i = 0; i < 20; i++) {
+            src[sources++] = (source_t){ SOURCE_SWARM, 100 + i, 77000 * i, 2000000, false };
+        }
+    }
+
+    int64_t now = 0;
+    while (now < SIM_US) {
+        // Queue the arrivals up to now; when idle, jump to the next one
+        int64_t next = SIM_US;
+        for (int i = 0; i < sources; i++) {
+            if (!src[i].queued && src[i].next_us < next) {
+                next = src[i].next_us;
+            }
+        }
+        if (queued == 0 && next > now) {
+            now = next;
+        }
+        for (int i = 0; i < sources; i++) {
+            if (!src[i].queued && src[i].next_us <= now) {
+                int slot = (head + queued++) % MAX_SOURCES;
+                queue[slot] = &src[i];
+                arrive[slot] = src[i].next_us;
+                src[i].queued = true;
+            }
+        }
+        if (queued == 0) {
+            continue;
+        }
+        source_t *s = queue[head];
+        int64_t arrived = arrive[head];
+        head = (head + 1) % MAX_SOURCES;
+        queued--;
+
+        // What the handlers do: the stream cap first, then the buckets
+        bool stream = s->kind == SOURCE_STREAMER;
+        admit_result_t admit = ADMIT_OK;
+        uint32_t retry;
+        if (admission && stream) {
+            admit = admission_check_streams(res.streams);
+        }
+        if (admission && admit == ADMIT_OK) {
+            admit = admission_check(stream ? ADMIT_STREAM : ADMIT_CAPTURE, s->ip, now, &retry);
+        }
+        bool ok = admit == ADMIT_OK;
+        if (ok && stream) {
+            ok = res.streams < HARD_STREAMS;
+            res.streams += ok;
+            now += STREAM_OPEN_US;
+        } else if (ok) {
+            now += CAPTURE_US + (int64_t)STILL_BYTES * 1000000 /
+                   (LINK_BPS - (int64_t)res.streams * STREAM_BPS);
+            res.captures++;
+        } else {
+            now += REJECT_US;
+            res.rejections++;
+        }
+
+        s->queued = false;
+        if (s->kind == SOURCE_LEGIT) {
+            if (ok && served < MAX_SAMPLES) {
+                latency[served++] = now - arrived;
+            } else if (!ok) {
+                res.legit_rejected++;
+            }
+        }
+        // Open-loop sources keep their schedule with +-250 ms of jitter
+        if (s->period_us) {
+            s->next_us += s->period_us - 250000 + rand_next() % 500000;
+            while (s->next_us < now) {
+                s->next_us += s->period_us;
+            }
+        } else {
+            s->next_us = now;
+        }
+    }
+
+    res.legit_served = served;
+    if (served) {
+        qsort(latency, served, sizeof(latency[0]), cmp_i64);
+        res.legit_p50_ms = latency[served / 2] / 1000;
+        res.legit_p99_ms = latency[served * 99 / 100] / 1000;
+    }
+    printf("%-28s legit p50 %5d ms, p99 %5d ms, %3d served, %3d rejected; "
+           "%d streams, %4.0f captures/min\n", name, res.legit_p50_ms, res.legit_p99_ms,
+           served, res.legit_rejected, res.streams, res.captures / 10.0);
+    return res;
+}
+
+static void test_load(void)
+{
+    load_result_t quiet = simulate("no abuse", false, false, true);
+    load_result_t open = simulate("script, no admission", true, false, false);
+    load_result_t held = simulate("script, admission", true, false, true);
+    load_result_t open_swarm = simulate("script+swarm, no admission", true, true, false);
+    load_result_t held_swarm = simulate("script+swarm, admission", true, true, true);
+
+    // Admission never gets in the way of a well-behaved client on its own
+    CHECK(quiet.legit_rejected == 0 && quiet.legit_served >= 115);
+    CHECK(quiet.legit_p99_ms < 400);
+
+    // The script queues everyone behind its stills and takes every stream
+    CHECK(open.legit_p50_ms > 2000);
+    CHECK(open.streams == HARD_STREAMS);
+
+    // Admission turns the script away cheaply and keeps a stream free
+    CHECK(held.legit_rejected == 0);
+    CHECK(held.legit_p99_ms < 1000);
+    CHECK(held.streams == 3);
+    CHECK(held.captures * 2 < open.captures);
+
+    // Against a swarm the global bucket holds the latency, but the
+    // legitimate client gets only its share of it
+    CHECK(open_swarm.legit_p50_ms > 10000);
+    CHECK(held_swarm.legit_p99_ms < 1000);
+    CHECK(held_swarm.legit_rejected > held_swarm.legit_served);
+}
+
+int main(void)
+{
+    test_buckets();
+    test_load();
+    return host_test_result("admission");
+}
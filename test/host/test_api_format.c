@@ -0,0 +1,532 @@
+/**
+ * @file test_api_format.c
+ * @brief CBOR codec, status formats and the CBOR control parser
+ *
+ * Round-trips the CBOR writer and reader at the integer size boundaries
+ * and checks the error cases. The status is formatted both ways and every
+ * CBOR pair must appear in the JSON object with the same value; the
+ * widest values must fit the documented buffer sizes, and JSON into any
+ * smaller buffer must fail without writing past it. The control parser
+ * is checked on valid and malformed maps, then fuzzed with a fixed seed.
+ * Prints the encode and parse times against the query-string /control.
+ */
+
+#include "host_test.h"
+#include "web_server/api_format.h"
+#include "camera/camera_params.h"
+#include "net/cbor.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define BENCH_RUNS      200000
+#define FUZZ_RUNS       1000000
+
+static uint32_t s_rand = 1;
+
+static uint32_t rand_next(void)
+{
+    s_rand ^= s_rand << 13;
+    s_rand ^= s_rand >> 17;
+    s_rand ^= s_rand << 5;
+    return s_rand;
+}
+
+static void test_cbor_ints(void)
+{
+    static const int64_t values[] = {
+        0, 1, 23, 24, 255, 256, 65535, 65536, 4294967295LL, 4294967296LL, INT64_MAX,
+        -1, -24, -25, -256, -257, -65536, -65537, -4294967296LL, -4294967297LL, INT64_MIN,
+    };
+    // Head plus argument bytes for each
+    static const size_t sizes[] = { 1, 1, 1, 2, 2, 3, 3, 5, 5, 9, 9,
+                                    1, 1, 2, 2, 3, 3, 5, 5, 9, 9 };
+    const size_t n = sizeof(values) / sizeof(values[0]);
+
+    for (size_t i = 0; i < n; i++) {
+        uint8_t buf[16];
+        cbor_writer_t w;
+        cbor_reader_t r;
+        int64_t v = 0;
+
+        cbor_writer_init(&w, buf, sizeof(buf));
+        cbor_put_int(&w, values[i]);
+        CHECK(cbor_writer_len(&w) == sizes[i]);
+        cbor_reader_init(&r, buf, cbor_writer_len(&w));
+        CHECK(cbor_get_int(&r, &v) == ESP_OK && v == values[i]);
+        CHECK(cbor_reader_done(&r));
+
+        // One byte short fails, and stays failed
+        cbor_writer_init(&w, buf, sizes[i] - 1);
+        cbor_put_int(&w, values[i]);
+        cbor_put_bool(&w, true);
+        CHECK(cbor_writer_len(&w) == 0 && w.overflow);
+
+        // Truncated input is rejected without moving
+        cbor_reader_init(&r, buf, sizes[i] - 1);
+        CHECK(cbor_get_int(&r, &v) != ESP_OK && r.p == buf);
+    }
+
+    // Above INT64_MAX, either sign
+    static const uint8_t big[] = { 0x1b, 0x80, 0, 0, 0, 0, 0, 0, 0 };
+    static const uint8_t big_neg[] = { 0x3b, 0x80, 0, 0, 0, 0, 0, 0, 0 };
+    cbor_reader_t r;
+    int64_t v;
+    cbor_reader_init(&r, big, sizeof(big));
+    CHECK(cbor_get_int(&r, &v) == ESP_ERR_INVALID_SIZE);
+    cbor_reader_init(&r, big_neg, sizeof(big_neg));
+    CHECK(cbor_get_int(&r, &v) == ESP_ERR_INVALID_SIZE);
+}
+
+static void test_cbor_items(void)
+{
+    uint8_t buf[128];
+    cbor_writer_t w;
+    cbor_reader_t r;
+    size_t pairs = 0, len = 0;
+    const char *text = NULL;
+    int64_t v = 0;
+
+    cbor_writer_init(&w, buf, sizeof(buf));
+    cbor_put_map(&w, CBOR_INDEFINITE);
+    cbor_put_text(&w, "on");
+    cbor_put_bool(&w, true);
+    cbor_put_text(&w, "off");
+    cbor_put_bool(&w, false);
+    cbor_put_text(&w, "fps");
+    cbor_put_float(&w, 9.5f);
+    cbor_put_text(&w, "");
+    cbor_put_map(&w, 1);
+    cbor_put_text(&w, "a");
+    cbor_put_int(&w, -7);
+    cbor_put_break(&w);
+    size_t n = cbor_writer_len(&w);
+    CHECK(n > 0);
+
+    static const uint8_t fps[] = { 0xfa, 0x41, 0x18, 0x00, 0x00 };     // 9.5f
+    CHECK(memcmp(buf + 14, fps, sizeof(fps)) == 0);
+
+    cbor_reader_init(&r, buf, n);
+    CHECK(cbor_get_map(&r, &pairs) == ESP_OK && pairs == CBOR_INDEFINITE);
+    CHECK(cbor_get_text(&r, &text, &len) == ESP_OK && len == 2 && memcmp(text, "on", 2) == 0);
+    CHECK(cbor_get_int(&r, &v) == ESP_OK && v == 1);
+    CHECK(cbor_get_text(&r, &text, &len) == ESP_OK && len == 3);
+    CHECK(cbor_get_int(&r, &v) == ESP_OK && v == 0);
+    CHECK(cbor_get_text(&r, &text, &len) == ESP_OK);
+    CHECK(cbor_get_int(&r, &v) == ESP_ERR_INVALID_ARG);       // A float is not an integer
+    CHECK(cbor_skip(&r) == ESP_OK);
+    CHECK(cbor_get_text(&r, &text, &len) == ESP_OK && len == 0);
+    CHECK(cbor_get_text(&r, &text, &len) == ESP_ERR_INVALID_ARG);
+    CHECK(cbor_skip(&r) == ESP_OK);
+    CHECK(cbor_get_break(&r) && cbor_reader_done(&r));
+
+    // A text string longer than the input
+    static const uint8_t long_text[] = { 0x65, 'a', 'b' };
+    cbor_reader_init(&r, long_text, sizeof(long_text));
+    CHECK(cbor_get_text(&r, &text, &len) == ESP_ERR_INVALID_ARG);
+    cbor_reader_init(&r, long_text, sizeof(long_text));
+    CHECK(cbor_skip(&r) == ESP_ERR_INVALID_ARG);
+
+    // Nesting past the limit, and a lone break
+    uint8_t deep[CBOR_MAX_DEPTH + 3];
+    memset(deep, 0x81, sizeof(deep) - 1);                   // [[[...
+    deep[sizeof(deep) - 1] = 0x00;
+    cbor_reader_init(&r, deep, sizeof(deep));
+    CHECK(cbor_skip(&r) == ESP_ERR_NOT_SUPPORTED);
+    cbor_reader_init(&r, deep, CBOR_MAX_DEPTH);
+    CHECK(cbor_skip(&r) == ESP_ERR_INVALID_ARG);
+    static const uint8_t lone_break[] = { 0xff };
+    cbor_reader_init(&r, lone_break, 1);
+    CHECK(cbor_skip(&r) == ESP_ERR_INVALID_ARG);
+}
+
+static void fill_status(api_status_t *st)
+{
+    memset(st, 0, sizeof(*st));
+    st->camera = (camera_status_t){
+        .framesize = FRAMESIZE_QXGA, .quality = 4, .aec = 1, .aec_value = 300, .ae_level = -1,
+        .agc = 1, .agc_gain = 5, .brightness = 1, .contrast = 1, .saturation = -1,
+        .sharpness = 2, .awb = 1,
+    };
+    st->service = (camera_service_stats_t){
+        .avg_queue_us = 154, .max_queue_us = 21034, .last_still_us = 187345,
+        .last_gap_ms = 412, .max_gap_ms = 980,
+    };
+    st->stream = (stream_stats_t){
+        .clients = 1, .fps = 9.8f, .avg_send_us = 18342, .avg_chunked_us = 21877,
+        .avg_raw_us = 17120, .rung = 2,
+    };
+#if CONFIG_GROWPOD_UDP_STILL
+    st->udp = (udp_still_stats_t){
+        .transfers = 12, .failures = 1, .last_ms = 176, .last_passes = 1, .last_kbps = 21000,
+    };
+#endif
+#if CONFIG_GROWPOD_STATUS_EVENTS
+    st->events.clients = 1;
+#endif
+}
+
+/**
+ * @brief Find a key's value in the JSON object
+ *
+ * @return Pointer to the value, NULL if the key is missing
+ */
+static const char *json_value(const char *json, const char *key, size_t key_len)
+{
+    char pattern[40];
+
+    if (key_len + 4 > sizeof(pattern)) {
+        return NULL;
+    }
+    pattern[0] = '"';
+    memcpy(pattern + 1, key, key_len);
+    memcpy(pattern + 1 + key_len, "\":", 3);
+    const char *p = strstr(json, pattern);
+    return p ? p + key_len + 3 : NULL;
+}
+
+/**
+ * @brief Check that both formats carry the same keys and values
+ */
+static void check_same_fields(const char *json, const uint8_t *cbor, size_t cbor_len)
+{
+    cbor_reader_t r;
+    size_t pairs;
+    int keys = 0, json_keys = 1, mismatched = 0;
+
+    for (const char *p = json; *p; p++) {
+        json_keys += *p == ',';
+    }
+
+    cbor_reader_init(&r, cbor, cbor_len);
+    CHECK(cbor_get_map(&r, &pairs) == ESP_OK && pairs == CBOR_INDEFINITE);
+    while (!cbor_get_break(&r)) {
+        const char *key, *text;
+        size_t key_len, text_len;
+        int64_t v;
+
+        if (cbor_get_text(&r, &key, &key_len) != ESP_OK) {
+            mismatched++;
+            break;
+        }
+        const char *jv = json_value(json, key, key_len);
+        keys++;
+        if (jv == NULL) {
+            printf("  %.*s missing from the JSON\n", (int)key_len, key);
+            mismatched++;
+            cbor_skip(&r);
+        } else if (cbor_get_text(&r, &text, &text_len) == ESP_OK) {
+            mismatched += jv[0] != '"' || strncmp(jv + 1, text, text_len) != 0 ||
+                          jv[1 + text_len] != '"';
+        } else if (r.p < r.end && *r.p == 0xf5) {
+            mismatched += strncmp(jv, "true", 4) != 0;
+            r.p++;
+        } else if (cbor_get_int(&r, &v) == ESP_OK) {
+            mismatched += strtoll(jv, NULL, 10) != v;
+        } else if (r.end - r.p >= 5 && *r.p == 0xfa) {
+            uint32_t bits = (uint32_t)r.p[1] << 24 | r.p[2] << 16 | r.p[3] << 8 | r.p[4];
+            float f;
+            memcpy(&f, &bits, sizeof(f));
+            mismatched += fabs(strtod(jv, NULL) - f) > 0.051 * (1 + fabs(f) * 1e-6);
+            r.p += 5;
+        } else {
+            mismatched++;
+            cbor_skip(&r);
+        }
+    }
+    CHECK(cbor_reader_done(&r));
+    CHECK(mismatched == 0);
+    CHECK(keys == json_keys);
+}
+
+static void test_status(void)
+{
+    api_status_t st;
+    char json[API_STATUS_JSON_SIZE];
+    uint8_t cbor[API_STATUS_CBOR_SIZE];
+
+    fill_status(&st);
+    int json_len = api_status_json(&st, json, sizeof(json));
+    size_t cbor_len = api_status_cbor(&st, cbor, sizeof(cbor));
+    CHECK(json_len > 0 && (size_t)json_len == strlen(json));
+    CHECK(cbor_len > 0);
+    check_same_fields(json, cbor, cbor_len);
+    printf("status: JSON %d bytes, CBOR %zu bytes\n", json_len, cbor_len);
+
+    // Widest values: every counter at its maximum, every signed field at -1
+    static char wide_json[8192];
+    static uint8_t wide_cbor[8192];
+    memset(&st, 0xff, sizeof(st));
+    st.camera.framesize = FRAMESIZE_QXGA;
+    st.stream.fps = -1e9f;
+#if CONFIG_GROWPOD_H264_STREAM
+    st.h264.fps = -1e9f;
+#endif
+    json_len = api_status_json(&st, wide_json, sizeof(wide_json));
+    cbor_len = api_status_cbor(&st, wide_cbor, sizeof(wide_cbor));
+    printf("widest: JSON %d of %d bytes, CBOR %zu of %d bytes\n", json_len,
+           API_STATUS_JSON_SIZE, cbor_len, API_STATUS_CBOR_SIZE);
+    CHECK(json_len > 0 && json_len < API_STATUS_JSON_SIZE);
+    CHECK(cbor_len > 0 && cbor_len <= API_STATUS_CBOR_SIZE);
+    check_same_fields(wide_json, wide_cbor, cbor_len);
+    CHECK(api_status_cbor(&st, wide_cbor, cbor_len - 1) == 0);
+
+    // Every smaller buffer fails and nothing is written past it
+    int overrun = 0, wrong = 0;
+    for (size_t size = 1; size <= (size_t)json_len + 1; size++) {
+        memset(json, 'X', sizeof(json));
+        int n = api_status_json(&st, json, size);
+        for (size_t i = size; i < sizeof(json); i++) {
+            if (json[i] != 'X') {
+                overrun++;
+                break;
+            }
+        }
+        if (size <= (size_t)json_len) {
+            wrong += n != -1;
+        } else {
+            wrong += n != json_len || strcmp(json, wide_json) != 0;
+        }
+    }
+    CHECK(overrun == 0);
+    CHECK(wrong == 0);
+}
+
+/**
+ * @brief Encode a control map of name/value pairs
+ */
+static size_t control_map(uint8_t *buf, size_t size, size_t pairs, const char *const *names,
+                          const int64_t *values, int count)
+{
+    cbor_writer_t w;
+
+    cbor_writer_init(&w, buf, size);
+    cbor_put_map(&w, pairs);
+    for (int i = 0; i < count; i++) {
+        cbor_put_text(&w, names[i]);
+        cbor_put_int(&w, values[i]);
+    }
+    if (pairs == CBOR_INDEFINITE) {
+        cbor_put_break(&w);
+    }
+    return cbor_writer_len(&w);
+}
+
+static void test_control(void)
+{
+    static const char *const names[] = { "aec", "aec_value", "ae_level", "gain_ctrl",
+                                         "agc_gain" };
+    static const int64_t values[] = { 0, 400, -1, 0, 12 };
+    camera_param_change_t changes[CAMERA_PARAM_COUNT];
+    uint8_t buf[256];
+    int count = -1;
+
+    size_t len = control_map(buf, sizeof(buf), 5, names, values, 5);
+    CHECK(api_control_cbor(buf, len, changes, &count) == ESP_OK && count == 5);
+    CHECK(changes[1].param == CAMERA_PARAM_AEC_VALUE && changes[1].value == 400);
+    CHECK(changes[2].param == CAMERA_PARAM_AE_LEVEL && changes[2].value == -1);
+
+    len = control_map(buf, sizeof(buf), CBOR_INDEFINITE, names, values, 5);
+    CHECK(api_control_cbor(buf, len, changes, &count) == ESP_OK && count == 5);
+    len = control_map(buf, sizeof(buf), 0, names, values, 0);
+    CHECK(api_control_cbor(buf, len, changes, &count) == ESP_OK && count == 0);
+
+    // Booleans for on/off parameters
+    static const uint8_t with_bool[] = { 0xa1, 0x63, 'a', 'w', 'b', 0xf4 };
+    CHECK(api_control_cbor(with_bool, sizeof(with_bool), changes, &count) == ESP_OK);
+    CHECK(count == 1 && changes[0].param == CAMERA_PARAM_AWB && changes[0].value == 0);
+
+    // Malformed: truncated, trailing data, not a map, a count beyond the pairs
+    count = -1;
+    len = control_map(buf, sizeof(buf), 5, names, values, 5);
+    CHECK(api_control_cbor(buf, len - 1, changes, &count) == ESP_ERR_INVALID_ARG);
+    buf[len] = 0;
+    CHECK(api_control_cbor(buf, len + 1, changes, &count) == ESP_ERR_INVALID_ARG);
+    CHECK(api_control_cbor(buf + 1, len - 1, changes, &count) == ESP_ERR_INVALID_ARG);
+    len = control_map(buf, sizeof(buf), 6, names, values, 5);
+    CHECK(api_control_cbor(buf, len, changes, &count) == ESP_ERR_INVALID_ARG);
+    CHECK(count == -1);
+
+    // Unknown names, including one longer than any parameter
+    static const char *const unknown[] = { "aec", "exposure" };
+    static const char *const too_long[] = { "aec_value_aec_value" };
+    len = control_map(buf, sizeof(buf), 2, unknown, values, 2);
+    CHECK(api_control_cbor(buf, len, changes, &count) == ESP_ERR_NOT_FOUND);
+    len = control_map(buf, sizeof(buf), 1, too_long, values, 1);
+    CHECK(api_control_cbor(buf, len, changes, &count) == ESP_ERR_NOT_FOUND);
+
+    // Values outside int, and non-integer values
+    static const int64_t huge[] = { (int64_t)INT32_MAX + 1 };
+    static const int64_t tiny[] = { (int64_t)INT32_MIN - 1 };
+    len = control_map(buf, sizeof(buf), 1, names, huge, 1);
+    CHECK(api_control_cbor(buf, len, changes, &count) == ESP_ERR_INVALID_ARG);
+    len = control_map(buf, sizeof(buf), 1, names, tiny, 1);
+    CHECK(api_control_cbor(buf, len, changes, &count) == ESP_ERR_INVALID_ARG);
+    static const uint8_t text_value[] = { 0xa1, 0x63, 'a', 'e', 'c', 0x61, '1' };
+    CHECK(api_control_cbor(text_value, sizeof(text_value), changes, &count) ==
+          ESP_ERR_INVALID_ARG);
+
+    // More entries than there are parameters
+    const char *all[CAMERA_PARAM_COUNT + 1];
+    int64_t zeros[CAMERA_PARAM_COUNT + 1] = { 0 };
+    for (int i = 0; i <= CAMERA_PARAM_COUNT; i++) {
+        all[i] = camera_param_name(i % CAMERA_PARAM_COUNT);
+    }
+    len = control_map(buf, sizeof(buf), CAMERA_PARAM_COUNT, all, zeros, CAMERA_PARAM_COUNT);
+    CHECK(api_control_cbor(buf, len, changes, &count) == ESP_OK &&
+          count == CAMERA_PARAM_COUNT);
+    len = control_map(buf, sizeof(buf), CBOR_INDEFINITE, all, zeros, CAMERA_PARAM_COUNT + 1);
+    CHECK(api_control_cbor(buf, len, changes, &count) == ESP_ERR_INVALID_SIZE);
+}
+
+/**
+ * @brief Valid control maps with a few random edits
+ */
+static void test_control_fuzz(void)
+{
+    static const char *const names[] = { "aec", "aec_value", "ae_level", "gain_ctrl",
+                                         "agc_gain" };
+    static const int64_t values[] = { 0, 400, -1, 0, 12 };
+    uint8_t seed[64], buf[64];
+    camera_param_change_t changes[CAMERA_PARAM_COUNT];
+    int accepted = 0, invalid = 0;
+    size_t seed_len = control_map(seed, sizeof(seed), CBOR_INDEFINITE, names, values, 5);
+
+    for (int run = 0; run < FUZZ_RUNS; run++) {
+        size_t len = seed_len;
+        memcpy(buf, seed, len);
+        for (int edits = 1 + rand_next() % 3; edits > 0; edits--) {
+            uint32_t r = rand_next();
+            size_t at = (r >> 8) % len;
+            switch (r % 4) {
+                case 0: buf[at] = (uint8_t)(r >> 24); break;           // Any byte
+                case 1: buf[at] ^= 1 << ((r >> 24) % 8); break;        // One bit
+                case 2: len = at + 1; break;                            // Truncate
+                case 3:                                                 // Drop a byte
+                    memmove(buf + at, buf + at + 1, len - at - 1);
+                    len = len > 1 ? len - 1 : 1;
+                    break;
+            }
+        }
+        // Heap copy so ASan sees reads past the body
+        uint8_t *body = malloc(len ? len : 1);
+        memcpy(body, buf, len);
+        int count = -1;
+        if (api_control_cbor(body, len, changes, &count) == ESP_OK) {
+            accepted++;
+            invalid += count < 0 || count > CAMERA_PARAM_COUNT;
+            for (int i = 0; i < count && i < CAMERA_PARAM_COUNT; i++) {
+                invalid += changes[i].param >= CAMERA_PARAM_COUNT;
+            }
+        } else {
+            invalid += count != -1;
+        }
+        free(body);
+    }
+    printf("control fuzz: %d of %d bodies accepted\n", accepted, FUZZ_RUNS);
+    CHECK(invalid == 0);
+    CHECK(accepted > 0);
+}
+
+/**
+ * @brief Same contract as ESP-IDF's httpd_query_key_value()
+ */
+static esp_err_t query_key_value(const char *query, const char *key, char *val, size_t size)
+{
+    size_t key_len = strlen(key);
+
+    for (const char *p = query; p && *p;) {
+        const char *amp = strchr(p, '&');
+        size_t seg = amp ? (size_t)(amp - p) : strlen(p);
+        if (seg > key_len && p[key_len] == '=' && strncmp(p, key, key_len) == 0) {
+            size_t len = seg - key_len - 1;
+            len = len < size - 1 ? len : size - 1;
+            memcpy(val, p + key_len + 1, len);
+            val[len] = '\0';
+            return ESP_OK;
+        }
+        p = amp ? amp + 1 : NULL;
+    }
+    return ESP_ERR_NOT_FOUND;
+}
+
+/**
+ * @brief control_handler's parsing of one /control query
+ */
+static esp_err_t parse_query(const char *query, camera_param_change_t *change)
+{
+    char var[32], val[32];
+
+    if (query_key_value(query, "var", var, sizeof(var)) != ESP_OK ||
+        query_key_value(query, "val", val, sizeof(val)) != ESP_OK) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    change->param = camera_param_find(var);
+    change->value = atoi(val);
+    return change->param == CAMERA_PARAM_COUNT ? ESP_ERR_NOT_FOUND : ESP_OK;
+}
+
+static void bench(void)
+{
+    static const char *const queries[] = { "var=aec&val=0", "var=aec_value&val=400",
+                                           "var=ae_level&val=-1", "var=gain_ctrl&val=0",
+                                           "var=agc_gain&val=12" };
+    static const char *const names[] = { "aec", "aec_value", "ae_level", "gain_ctrl",
+                                         "agc_gain" };
+    static const int64_t values[] = { 0, 400, -1, 0, 12 };
+    volatile size_t sink = 0;
+    api_status_t st;
+    char json[API_STATUS_JSON_SIZE];
+    uint8_t cbor[API_STATUS_CBOR_SIZE];
+    camera_param_change_t changes[CAMERA_PARAM_COUNT];
+    int count;
+
+    fill_status(&st);
+    int64_t start = host_time_us();
+    for (int i = 0; i < BENCH_RUNS; i++) {
+        st.stream.avg_send_us = i;
+        sink += api_status_json(&st, json, sizeof(json));
+    }
+    double json_ns = (host_time_us() - start) * 1000.0 / BENCH_RUNS;
+    start = host_time_us();
+    for (int i = 0; i < BENCH_RUNS; i++) {
+        st.stream.avg_send_us = i;
+        sink += api_status_cbor(&st, cbor, sizeof(cbor));
+    }
+    double cbor_ns = (host_time_us() - start) * 1000.0 / BENCH_RUNS;
+    printf("status encode: JSON %.0f ns, CBOR %.0f ns\n", json_ns, cbor_ns);
+
+    // The settings page's exposure changes: five /control requests or one map
+    uint8_t body[128];
+    size_t body_len = control_map(body, sizeof(body), 5, names, values, 5);
+    size_t query_len = 0;
+    for (int k = 0; k < 5; k++) {
+        query_len += strlen(queries[k]);
+    }
+    start = host_time_us();
+    for (int i = 0; i < BENCH_RUNS; i++) {
+        for (int k = 0; k < 5; k++) {
+            sink += parse_query(queries[k], &changes[k]) + changes[k].value;
+        }
+    }
+    double query_ns = (host_time_us() - start) * 1000.0 / BENCH_RUNS;
+    start = host_time_us();
+    for (int i = 0; i < BENCH_RUNS; i++) {
+        sink += api_control_cbor(body, body_len, changes, &count) + changes[1].value;
+    }
+    double map_ns = (host_time_us() - start) * 1000.0 / BENCH_RUNS;
+    printf("control, 5 parameters: 5 queries of %zu bytes %.0f ns, one map of %zu bytes %.0f ns\n",
+           query_len, query_ns, body_len, map_ns);
+    (void)sink;
+}
+
+int main(void)
+{
+    test_cbor_ints();
+    test_cbor_items();
+    test_status();
+    test_control();
+    test_control_fuzz();
+    bench();
+    return host_test_result("api_format");
+}
@@ -0,0 +1,279 @@
+/**
+ * @file test_bounce_send.c
+ * @brief Double-buffered bounce send path
+ *
+ * Sends frames through bounce_send() into a socket stub that may accept
+ * partial writes or fail, with a DMA stub that finishes each copy on a
+ * thread of its own after a delay. Checks that every byte arrives in
+ * order, that a chunk is sent only once the next chunk's copy is under
+ * way, that no copy writes the buffer being sent, and that a send error
+ * waits for the copy in flight before returning.
+ */
+
+#include "host_test.h"
+#include "net/bounce_send.h"
+#include "esp_async_memcpy.h"
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define CHUNK           CONFIG_GROWPOD_BOUNCE_CHUNK_SIZE
+#define FRAME_MAX       (300 * 1024)
+
+static pthread_mutex_t s_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// Socket side
+static uint8_t s_received[FRAME_MAX];
+static size_t s_received_len;
+static size_t s_max_write;              // 0 to take everything offered
+static long s_fail_at = -1;             // Fail the write reaching this many bytes
+static int s_overlaps;                  // Sends from a buffer a copy is writing
+static int s_early_sends;               // Chunks sent before the next copy started
+static int s_expect_chunks;             // DMA-copied chunks in the frame, 0 to not check
+static int s_frame_copies;              // s_copies_started when the frame began
+
+// DMA side
+static int s_install_err = ESP_OK;
+static int s_copy_delay_us;
+static int s_copies_started;
+static int s_copies_in_flight;
+static uint8_t *s_copy_dst;
+static size_t s_copy_n;
+static int s_misaligned;
+
+struct copy_job {
+    async_memcpy_handle_t mcp;
+    void *dst;
+    const void *src;
+    size_t n;
+    async_memcpy_isr_cb_t cb;
+    void *args;
+};
+
+static void *copy_thread(void *arg)
+{
+    struct copy_job *job = arg;
+    async_memcpy_event_t event = { 0 };
+
+    usleep(s_copy_delay_us);
+    memcpy(job->dst, job->src, job->n);
+    pthread_mutex_lock(&s_lock);
+    s_copies_in_flight--;
+    s_copy_dst = NULL;
+    pthread_mutex_unlock(&s_lock);
+    job->cb(job->mcp, &event, job->args);
+    free(job);
+    return NULL;
+}
+
+esp_err_t esp_async_memcpy_install(const async_memcpy_config_t *config,
+                                   async_memcpy_handle_t *mcp)
+{
+    *mcp = s_install_err == ESP_OK ? (async_memcpy_handle_t)&s_lock : NULL;
+    return s_install_err;
+}
+
+esp_err_t esp_async_memcpy(async_memcpy_handle_t mcp, void *dst, void *src, size_t n,
+                           async_memcpy_isr_cb_t cb_isr, void *cb_args)
+{
+    struct copy_job *job = malloc(sizeof(*job));
+    *job = (struct copy_job){ mcp, dst, src, n, cb_isr, cb_args };
+
+    pthread_mutex_lock(&s_lock);
+    s_misaligned += ((uintptr_t)src % 64) != 0 || ((uintptr_t)dst % 64) != 0 || n % 64 != 0;
+    s_copies_started++;
+    s_copies_in_flight++;
+    s_copy_dst = dst;
+    s_copy_n = n;
+    pthread_mutex_unlock(&s_lock);
+
+    pthread_t thread;
+    pthread_create(&thread, NULL, copy_thread, job);
+    pthread_detach(thread);
+    return ESP_OK;
+}
+
+int httpd_send(httpd_req_t *req, const char *buf, size_t buf_len)
+{
+    size_t n = s_max_write && buf_len > s_max_write ? s_max_write : buf_len;
+
+    pthread_mutex_lock(&s_lock);
+    if (s_copy_dst != NULL && (const uint8_t *)buf < s_copy_dst + s_copy_n &&
+        (const uint8_t *)buf + n > s_copy_dst) {
+        s_overlaps++;
+    }
+    // The copy of the chunk after this one is started before this one is sent
+    if (s_expect_chunks && s_received_len % CHUNK == 0) {
+        int chunk = s_received_len / CHUNK;
+        int need = chunk + 2 < s_expect_chunks ? chunk + 2 : s_expect_chunks;
+        s_early_sends += s_copies_started - s_frame_copies < need;
+    }
+    pthread_mutex_unlock(&s_lock);
+
+    if (s_fail_at >= 0 && s_received_len + n >= (size_t)s_fail_at) {
+        return -1;
+    }
+    memcpy(s_received + s_received_len, buf, n);
+    s_received_len += n;
+    return n;
+}
+
+static void reset(void)
+{
+    s_received_len = 0;
+    s_max_write = 0;
+    s_fail_at = -1;
+    s_overlaps = 0;
+    s_early_sends = 0;
+    s_expect_chunks = 0;
+    s_copies_started = 0;
+    s_misaligned = 0;
+}
+
+/**
+ * @brief Send len bytes from data and check they arrived whole and in order
+ */
+static void send_frame(const uint8_t *data, size_t len)
+{
+    s_received_len = 0;
+    s_frame_copies = s_copies_started;
+    CHECK(bounce_send(NULL, data, len) == ESP_OK);
+    CHECK(s_received_len == len);
+    CHECK(memcmp(s_received, data, len) == 0);
+}
+
+static uint8_t *make_frame(void)
+{
+    uint8_t *frame = aligned_alloc(64, FRAME_MAX + 64);
+    for (size_t i = 0; i < FRAME_MAX + 64; i++) {
+        frame[i] = (uint8_t)(i * 7 + (i >> 11));
+    }
+    return frame;
+}
+
+/**
+ * @brief Whole frames of several sizes, with DMA copies
+ */
+static void test_order(const uint8_t *frame)
+{
+    static const size_t lens[] = { 0, 64, CHUNK, CHUNK + 64, 3 * CHUNK, 9 * CHUNK + 1024 };
+
+    reset();
+    s_copy_delay_us = 200;
+    for (size_t t = 0; t < sizeof(lens) / sizeof(lens[0]); t++) {
+        s_expect_chunks = (lens[t] + CHUNK - 1) / CHUNK;
+        send_frame(frame, lens[t]);
+        CHECK(s_copies_started - s_frame_copies == s_expect_chunks);
+    }
+    s_expect_chunks = 0;
+    CHECK(s_overlaps == 0);
+    CHECK(s_early_sends == 0);
+    CHECK(s_misaligned == 0);
+    CHECK(s_copies_in_flight == 0);
+
+    // A source the DMA cannot read falls back to CPU copies
+    send_frame(frame + 1, 5 * CHUNK + 7);
+    CHECK(s_copies_started == s_frame_copies);
+
+    // An aligned frame with a ragged tail: DMA for all but the last chunk
+    send_frame(frame, 4 * CHUNK + 100);
+    CHECK(s_copies_started - s_frame_copies == 4);
+    CHECK(s_misaligned == 0);
+}
+
+/**
+ * @brief The socket taking a little at a time, and odd amounts
+ */
+static void test_partial_writes(const uint8_t *frame)
+{
+    static const size_t max_writes[] = { 1460, 5000, CHUNK - 1, 1 };
+
+    reset();
+    s_copy_delay_us = 50;
+    for (size_t t = 0; t < sizeof(max_writes) / sizeof(max_writes[0]); t++) {
+        s_max_write = max_writes[t];
+        s_expect_chunks = max_writes[t] == 1 ? 3 : 8;
+        send_frame(frame, max_writes[t] == 1 ? 2 * CHUNK + 64 : 7 * CHUNK + 320);
+    }
+    CHECK(s_overlaps == 0);
+    CHECK(s_early_sends == 0);
+    CHECK(s_copies_in_flight == 0);
+}
+
+/**
+ * @brief A send error while the next chunk's copy is still in flight
+ *
+ * bounce_send() must not return, and give the buffers up, before that
+ * copy completes; the next frame then goes out intact.
+ */
+static void test_error(const uint8_t *frame)
+{
+    // Fails in the first chunk, the second chunk's copy held back
+    reset();
+    s_copy_delay_us = 20000;
+    s_fail_at = CHUNK / 2;
+    CHECK(bounce_send(NULL, frame, 6 * CHUNK) == ESP_FAIL);
+    pthread_mutex_lock(&s_lock);
+    CHECK(s_copies_in_flight == 0);
+    pthread_mutex_unlock(&s_lock);
+    CHECK(s_copies_started == 2);
+
+    // Fails in the last chunk, with no copy left to wait for
+    reset();
+    s_copy_delay_us = 100;
+    s_fail_at = 3 * CHUNK - 10;
+    CHECK(bounce_send(NULL, frame, 3 * CHUNK) == ESP_FAIL);
+    CHECK(s_received_len < 3 * CHUNK);
+
+    // Fails on a partial write in the middle
+    reset();
+    s_max_write = 1000;
+    s_fail_at = 2 * CHUNK + 3000;
+    CHECK(bounce_send(NULL, frame, 5 * CHUNK) == ESP_FAIL);
+    pthread_mutex_lock(&s_lock);
+    CHECK(s_copies_in_flight == 0);
+    pthread_mutex_unlock(&s_lock);
+
+    // No completion left over to be taken for the next frame's first copy
+    reset();
+    s_copy_delay_us = 2000;
+    send_frame(frame + 64, 4 * CHUNK);
+    CHECK(s_overlaps == 0);
+}
+
+/**
+ * @brief Without the DMA driver every copy is a CPU copy
+ */
+static void test_cpu_copies(const uint8_t *frame)
+{
+    reset();
+    send_frame(frame, 6 * CHUNK + 64);
+    s_max_write = 777;
+    send_frame(frame, 2 * CHUNK);
+    s_fail_at = CHUNK + 5;
+    CHECK(bounce_send(NULL, frame, 3 * CHUNK) == ESP_FAIL);
+    s_fail_at = -1;
+    send_frame(frame, 3 * CHUNK);
+    CHECK(s_copies_started == 0);
+}
+
+int main(int argc, char **argv)
+{
+    uint8_t *frame = make_frame();
+
+    // The driver is installed once, so each mode is its own run
+    if (argc > 1 && strcmp(argv[1], "--cpu") == 0) {
+        s_install_err = ESP_ERR_NOT_SUPPORTED;
+        CHECK(bounce_send_init() == ESP_OK);
+        test_cpu_copies(frame);
+    } else {
+        CHECK(bounce_send_init() == ESP_OK);
+        test_order(frame);
+        test_partial_writes(frame);
+        test_error(frame);
+    }
+
+    free(frame);
+    return host_test_result("bounce_send");
+}
@@ -0,0 +1,273 @@
+/**
+ * @file test_bw_estimator.c
+ * @brief Bandwidth estimator and quality ladder, replayed against link traces
+ *
+ * Drives the stream's ladder through a simulated TCP connection: a 64 KB
+ * send buffer (CONFIG_LWIP_TCP_SND_BUF_DEFAULT) drained at the trace's
+ * link rate. A send returns at once while the buffer has room and blocks
+ * for the rest. Frames are produced every 100 ms, or when the previous
+ * send returns if that is later. Each scenario checks that the controller
+ * settles on a rung the link can carry, reacts to drops and does not flap.
+ */
+
+#include "host_test.h"
+#include "net/bw_estimator.h"
+#include <stdlib.h>
+
+#define SND_BUF             65535.0
+#define FRAME_US            100000
+#define SEND_MIN_US         200         // A send that does not block
+#define FRAME_NOISE         0.15        // Frame size varies +-15% around the rung
+#define MAX_DOWNS           32
+
+// The stream's ladder (stream.c)
+static const bw_ladder_t s_ladder = {
+    .rung_count = 6,
+    .rung_bytes = { 6000, 9000, 16000, 24000, 36000, 56000 },
+    .target_fps = 10.0f,
+    .down_hold_us = 1000000,
+    .up_hold_us = 4000000,
+    .min_dwell_us = 3000000,
+};
+
+typedef double (*rate_fn_t)(int64_t t_us);
+
+typedef struct {
+    int switches;
+    int final_rung;
+    int64_t last_switch_us;
+    int64_t frames;
+    int downs;
+    int64_t down_us[MAX_DOWNS]; // Times of the switches down
+} sim_result_t;
+
+static uint32_t s_rand = 1;
+
+/**
+ * @brief Uniform in [-1, 1)
+ */
+static double rand_unit(void)
+{
+    s_rand = s_rand * 1103515245u + 12345u;
+    return ((s_rand >> 8) & 0xffff) / 32768.0 - 1.0;
+}
+
+/**
+ * @brief Replay a link trace for a duration
+ *
+ * @param rate Link rate in bytes/s at a time
+ * @param rssi RSSI reported to the estimator
+ * @param duration_us Trace length
+ * @param rung_at Receives the rung every 100 ms, may be NULL
+ */
+static sim_result_t simulate(rate_fn_t rate, int rssi, int64_t duration_us, int *rung_at)
+{
+    bw_estimator_t bw;
+    sim_result_t res = { 0 };
+    double queued = 0;
+    int64_t now = 0;
+    int64_t next_frame = 0;
+
+    s_rand = 1;
+    bw_estimator_init(&bw, &s_ladder, rssi, now);
+
+    while (now < duration_us) {
+        // Idle until the next frame, draining the send buffer
+        for (; now < next_frame; now += 1000) {
+            queued -= rate(now) / 1000.0;
+            queued = queued < 0 ? 0 : queued;
+        }
+
+        int rung = bw.rung;
+        double bytes = s_ladder.rung_bytes[rung] * (1 + FRAME_NOISE * rand_unit());
+        int64_t start = now;
+        queued += bytes;
+        while (queued > SND_BUF) {
+            queued -= rate(now) / 1000.0;
+            now += 1000;
+        }
+        uint32_t send_us = now - start > SEND_MIN_US ? (uint32_t)(now - start) : SEND_MIN_US;
+        now = start + send_us;
+
+        if (bw_estimator_on_send(&bw, (size_t)bytes, send_us, rung, now)) {
+            res.switches++;
+            res.last_switch_us = now;
+            if (bw.rung < rung && res.downs < MAX_DOWNS) {
+                res.down_us[res.downs++] = now;
+            }
+        }
+        res.frames++;
+        for (int64_t t = start / FRAME_US; rung_at && t <= now / FRAME_US; t++) {
+            if (t < duration_us / FRAME_US) {
+                rung_at[t] = bw.rung;
+            }
+        }
+        next_frame = start + FRAME_US > now ? start + FRAME_US : now;
+    }
+    res.final_rung = bw.rung;
+    return res;
+}
+
+/**
+ * @brief Highest rung whose nominal rate a link carries
+ */
+static int carried_rung(double rate)
+{
+    int rung = 0;
+    for (int i = 1; i < s_ladder.rung_count; i++) {
+        if (s_ladder.rung_bytes[i] * s_ladder.target_fps <= rate) {
+            rung = i;
+        }
+    }
+    return rung;
+}
+
+static double fps(const sim_result_t *res, int64_t duration_us)
+{
+    return res->frames * 1e6 / duration_us;
+}
+
+static void report(const char *name, const sim_result_t *res, int64_t duration_us)
+{
+    printf("%-26s rung %d, %2d switches, last at %5.1f s, %.1f fps\n", name, res->final_rung,
+           res->switches, res->last_switch_us / 1e6, fps(res, duration_us));
+}
+
+/**
+ * @brief Check that failed probes come back at growing intervals
+ */
+static void check_backoff(const sim_result_t *res)
+{
+    for (int i = 2; i < res->downs; i++) {
+        int64_t gap = res->down_us[i] - res->down_us[i - 1];
+        int64_t prev = res->down_us[i - 1] - res->down_us[i - 2];
+        CHECK(gap > prev);
+    }
+}
+
+static double rate_constant(int64_t t)
+{
+    return 600000;
+}
+
+static double rate_step(int64_t t)
+{
+    return t < 20000000 ? 1200000 : t < 40000000 ? 150000 : 800000;
+}
+
+static double rate_noisy(int64_t t)
+{
+    // Changes every 100 ms
+    uint32_t h = (uint32_t)(t / 100000) * 2654435761u;
+    h ^= h >> 15;
+    return 400000 * (1 + 0.4 * ((h & 0xffff) / 32768.0 - 1.0));
+}
+
+static double rate_square(int64_t t)
+{
+    return (t / 1000000) % 2 ? 700000 : 300000;
+}
+
+static double rate_250k(int64_t t)
+{
+    return 250000;
+}
+
+static double rate_80k(int64_t t)
+{
+    return 80000;
+}
+
+static void test_constant(void)
+{
+    const int64_t duration = 60000000;
+    sim_result_t res = simulate(rate_constant, 0, duration, NULL);
+    report("constant 600 KB/s", &res, duration);
+    CHECK(res.final_rung == carried_rung(600000));
+    CHECK(res.switches <= 3);
+    CHECK(res.last_switch_us < 15000000);
+    CHECK(fps(&res, duration) > 9.8);
+}
+
+static void test_step(void)
+{
+    const int64_t duration = 80000000;
+    static int rung_at[800];
+    sim_result_t res = simulate(rate_step, 0, duration, rung_at);
+    report("step 1.2M/150K/800K", &res, duration);
+
+    // Top rung before the drop, a rung 150 KB/s carries within 2 s of it,
+    // and back up once the link recovers
+    CHECK(rung_at[199] == s_ladder.rung_count - 1);
+    int reacted = -1;
+    for (int t = 200; t < 400 && reacted < 0; t++) {
+        if (rung_at[t] <= carried_rung(150000)) {
+            reacted = t;
+        }
+    }
+    printf("  down within %.1f s of the drop\n", (reacted - 200) / 10.0);
+    CHECK(reacted >= 0 && reacted < 220);
+    CHECK(res.final_rung == carried_rung(800000));
+    CHECK(res.switches <= 12);
+    CHECK(fps(&res, duration) > 9);
+    check_backoff(&res);
+}
+
+static void test_no_flapping(void)
+{
+    const int64_t duration = 120000000;
+    static int rung_at[1200];
+
+    // The 64 KB send buffer hides the link from non-blocking sends, so the
+    // controller keeps probing the rung above; the backoff must space the
+    // probes out and keep time spent above the link short
+    sim_result_t res = simulate(rate_noisy, 0, duration, rung_at);
+    report("noisy 400 KB/s +-40%", &res, duration);
+    int over = 0;
+    for (int t = 0; t < 1200; t++) {
+        over += rung_at[t] > carried_rung(400000);
+    }
+    printf("  %.1f%% of the time above the link, %d failed probes\n", over / 12.0, res.downs);
+    CHECK(over < 120);
+    CHECK(res.final_rung <= carried_rung(400000) + 1);
+    CHECK(fps(&res, duration) > 9.5);
+    check_backoff(&res);
+
+    // The average (500 KB/s) is a little below the top rung, which is held
+    // at a reduced frame rate rather than switched every period
+    res = simulate(rate_square, 0, duration, NULL);
+    report("square 300/700 KB/s, 2 s", &res, duration);
+    CHECK(res.switches <= 3);
+    CHECK(fps(&res, duration) > 8);
+}
+
+static void test_rssi(void)
+{
+    const int64_t duration = 60000000;
+
+    // The cap seeds a low start, and the non-blocking link still climbs
+    sim_result_t res = simulate(rate_250k, -82, duration, NULL);
+    report("250 KB/s at -82 dBm", &res, duration);
+    CHECK(res.final_rung >= 1 && res.final_rung <= carried_rung(250000));
+    CHECK(res.switches <= 4);
+
+    // Probes above what the link carries fail and back off
+    res = simulate(rate_80k, -88, duration, NULL);
+    report("80 KB/s at -88 dBm", &res, duration);
+    CHECK(res.final_rung <= carried_rung(80000) + 1);
+    CHECK(res.switches <= 8);
+
+    CHECK(bw_estimator_rssi_cap(0) == 0);
+    CHECK(bw_estimator_rssi_cap(-50) == 0);
+    CHECK(bw_estimator_rssi_cap(-70) > bw_estimator_rssi_cap(-85));
+    CHECK(bw_estimator_rssi_cap(-95) > 0);
+}
+
+int main(void)
+{
+    test_constant();
+    test_step();
+    test_no_flapping();
+    test_rssi();
+    return host_test_result("bw_estimator");
+}
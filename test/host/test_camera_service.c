@@ -0,0 +1,370 @@
+/**
+ * @file test_camera_service.c
+ * @brief Camera service request ordering and still preemption of the stream
+ *
+ * Runs the real service task against a simulated driver: frames take a
+ * framesize-dependent time to arrive, sensor framesize changes and driver
+ * restarts take time, and the driver's buffer count is enforced. Checks
+ * that a capture is served ahead of requests queued before it, that a
+ * still interrupts the stream for a bounded time, and that gap_ms is set
+ * on exactly the first stream frame after each still. Prints the queueing
+ * latency, still latency and stream gap figures.
+ *
+ * Built twice: with CONFIG_GROWPOD_STREAM_FB_COUNT 1 the stream shares the
+ * still driver, with 2 it has its own and a still restarts the driver.
+ */
+
+#include "host_test.h"
+#include "camera/camera.h"
+#include "camera/camera_service.h"
+#include "settings/settings.h"
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// Simulated driver timing
+#define FRAME_MS_SMALL      33      // Up to SVGA, ~30 fps
+#define FRAME_MS_LARGE      66      // XGA and up, ~15 fps
+#define SENSOR_SWITCH_MS    10      // set_framesize() register writes
+#define DRIVER_RESTART_MS   120     // esp_camera_deinit() + esp_camera_init()
+
+// The service's stream pacing (camera_service.c)
+#define STREAM_INTERVAL_MS  100
+
+#define POOL_FRAMES         4
+#define MAX_STREAM_FRAMES   256
+#define STILLS              6
+
+static sensor_t s_sensor;
+static pthread_mutex_t s_drv_lock = PTHREAD_MUTEX_INITIALIZER;
+static camera_fb_t s_pool[POOL_FRAMES];
+static bool s_pool_out[POOL_FRAMES];
+static uint8_t s_pool_data[POOL_FRAMES][2048];
+static int s_fb_count = 1;
+static int s_frames_out;
+static int s_overdrawn;                 // Grabs beyond the driver's buffers
+static int s_restarts;
+static int s_restarts_with_frames_out;
+static int s_saves;
+
+static int frame_ms(framesize_t framesize)
+{
+    return framesize >= FRAMESIZE_XGA ? FRAME_MS_LARGE : FRAME_MS_SMALL;
+}
+
+// Simulated driver: esp32-camera and camera.c
+
+static int set_framesize(sensor_t *s, framesize_t framesize)
+{
+    usleep(SENSOR_SWITCH_MS * 1000);
+    s->status.framesize = framesize;
+    return 0;
+}
+
+static int set_quality(sensor_t *s, int quality)
+{
+    s->status.quality = quality;
+    return 0;
+}
+
+static int set_brightness(sensor_t *s, int level)
+{
+    s->status.brightness = level;
+    return 0;
+}
+
+sensor_t *esp_camera_sensor_get(void)
+{
+    return &s_sensor;
+}
+
+camera_fb_t *esp_camera_fb_get(void)
+{
+    usleep(frame_ms(s_sensor.status.framesize) * 1000);
+
+    pthread_mutex_lock(&s_drv_lock);
+    camera_fb_t *fb = NULL;
+    if (s_frames_out >= s_fb_count) {
+        // The real driver would time out here
+        s_overdrawn++;
+    } else {
+        for (int i = 0; i < POOL_FRAMES; i++) {
+            if (!s_pool_out[i]) {
+                s_pool_out[i] = true;
+                s_frames_out++;
+                fb = &s_pool[i];
+                break;
+            }
+        }
+    }
+    pthread_mutex_unlock(&s_drv_lock);
+
+    if (fb) {
+        fb->buf = s_pool_data[fb - s_pool];
+        fb->len = 512 + (size_t)s_sensor.status.framesize * 64;
+        fb->width = fb->height = s_sensor.status.framesize;
+        fb->format = PIXFORMAT_JPEG;
+        gettimeofday(&fb->timestamp, NULL);
+    }
+    return fb;
+}
+
+void esp_camera_fb_return(camera_fb_t *fb)
+{
+    pthread_mutex_lock(&s_drv_lock);
+    int i = (int)(fb - s_pool);
+    CHECK(i >= 0 && i < POOL_FRAMES && s_pool_out[i]);
+    s_pool_out[i] = false;
+    s_frames_out--;
+    pthread_mutex_unlock(&s_drv_lock);
+}
+
+void camera_profile_default(camera_profile_t *profile)
+{
+    *profile = (camera_profile_t){
+        .pixel_format = PIXFORMAT_JPEG,
+        .frame_size = FRAMESIZE_QXGA,
+        .jpeg_quality = 4,
+        .fb_count = 1,
+        .fb_location = CAMERA_FB_IN_PSRAM,
+        .grab_mode = CAMERA_GRAB_LATEST,
+        .xclk_hz = CAMERA_XCLK_DEFAULT_HZ,
+    };
+}
+
+esp_err_t camera_reconfigure(const camera_profile_t *profile)
+{
+    pthread_mutex_lock(&s_drv_lock);
+    // Deinit frees the buffers; the service must have all of them back
+    if (s_frames_out > 0) {
+        s_restarts_with_frames_out++;
+    }
+    s_restarts++;
+    pthread_mutex_unlock(&s_drv_lock);
+
+    usleep(DRIVER_RESTART_MS * 1000);
+    s_fb_count = (int)profile->fb_count;
+    s_sensor.status.framesize = profile->frame_size;
+    s_sensor.status.quality = profile->jpeg_quality;
+    return ESP_OK;
+}
+
+camera_fb_t *camera_capture_image(void)
+{
+    // As camera.c: drop the frame buffered before the request
+    camera_fb_t *fb = esp_camera_fb_get();
+    if (fb) {
+        esp_camera_fb_return(fb);
+    }
+    return esp_camera_fb_get();
+}
+
+// Settings in NVS
+
+void settings_from_status(const camera_status_t *status, camera_settings_t *settings)
+{
+    memset(settings, 0, sizeof(*settings));
+    settings->framesize = status->framesize;
+    settings->quality = status->quality;
+}
+
+esp_err_t settings_apply_to_camera(const camera_settings_t *settings)
+{
+    return ESP_OK;
+}
+
+esp_err_t settings_save(const camera_settings_t *settings)
+{
+    s_saves++;
+    return ESP_OK;
+}
+
+// Stream sink
+
+typedef struct {
+    int64_t at_us;
+    uint32_t gap_ms;
+} stream_frame_t;
+
+static pthread_mutex_t s_sink_lock = PTHREAD_MUTEX_INITIALIZER;
+static stream_frame_t s_frames[MAX_STREAM_FRAMES];
+static int s_frame_count;
+
+static bool stream_sink(camera_fb_t *fb, int64_t timestamp_us, uint32_t gap_ms)
+{
+    pthread_mutex_lock(&s_sink_lock);
+    if (s_frame_count < MAX_STREAM_FRAMES) {
+        s_frames[s_frame_count++] = (stream_frame_t){ .at_us = timestamp_us, .gap_ms = gap_ms };
+    }
+    pthread_mutex_unlock(&s_sink_lock);
+    // Let the service return it, as a sink with no room would
+    return false;
+}
+
+/**
+ * @brief A request submitted without waiting for it
+ */
+typedef struct {
+    camera_request_t req;
+    camera_future_t future;
+} pending_t;
+
+static void submit(pending_t *p, camera_req_type_t type)
+{
+    p->req.type = type;
+    camera_future_init(&p->future);
+    p->req.future = &p->future;
+    CHECK(camera_service_submit(&p->req) == ESP_OK);
+}
+
+/**
+ * @brief Order in which the service answered a waited-for request
+ */
+static uint64_t answered(const pending_t *p)
+{
+    return p->future.done_buf.given_seq;
+}
+
+static void test_capture_jumps_queue(void)
+{
+    // Keeps the service busy: a framesize change grabs two frames
+    static const camera_param_change_t busy_change = {
+        .param = CAMERA_PARAM_FRAMESIZE, .value = FRAMESIZE_SXGA,
+    };
+    static const camera_param_change_t change = {
+        .param = CAMERA_PARAM_BRIGHTNESS, .value = 1,
+    };
+    pending_t busy, status[3], param, capture;
+
+    busy.req.set_param.changes = &busy_change;
+    busy.req.set_param.count = 1;
+    submit(&busy, CAMERA_REQ_SET_PARAM);
+    usleep(20 * 1000);
+
+    for (int i = 0; i < 3; i++) {
+        submit(&status[i], CAMERA_REQ_GET_STATUS);
+    }
+    param.req.set_param.changes = &change;
+    param.req.set_param.count = 1;
+    submit(&param, CAMERA_REQ_SET_PARAM);
+    int64_t capture_submit = host_time_us();
+    submit(&capture, CAMERA_REQ_CAPTURE);
+
+    CHECK(camera_future_wait(&busy.future) == ESP_OK);
+    CHECK(camera_future_wait(&capture.future) == ESP_OK);
+    int64_t capture_us = host_time_us() - capture_submit;
+    for (int i = 0; i < 3; i++) {
+        CHECK(camera_future_wait(&status[i].future) == ESP_OK);
+        CHECK(answered(&capture) < answered(&status[i]));
+    }
+    CHECK(camera_future_wait(&param.future) == ESP_OK);
+    CHECK(answered(&capture) < answered(&param));
+    CHECK(answered(&busy) < answered(&capture));
+    CHECK(capture.future.fb != NULL);
+    if (capture.future.fb) {
+        camera_service_release(capture.future.fb);
+    }
+    CHECK(s_sensor.status.brightness == 1);
+
+    camera_service_stats_t stats;
+    camera_service_get_stats(&stats);
+    printf("capture behind a busy request and 4 queued ones: answered first, "
+           "%lld ms submit to frame\n", (long long)(capture_us / 1000));
+    printf("queueing: avg %lu us, max %lu us\n",
+           (unsigned long)stats.avg_queue_us, (unsigned long)stats.max_queue_us);
+}
+
+static void test_stills_preempt_stream(void)
+{
+    const int still_ms = 2 * frame_ms(FRAMESIZE_SXGA);
+    const int resume_ms = 2 * FRAME_MS_SMALL;
+    // Worst case: the still arrives just after a frame and the stream's
+    // next frame is already due when it is done
+    int bound_ms = STREAM_INTERVAL_MS + 2 * SENSOR_SWITCH_MS + still_ms + resume_ms;
+#if CONFIG_GROWPOD_STREAM_FB_COUNT > 1
+    bound_ms += 2 * DRIVER_RESTART_MS;
+#endif
+    // Scheduling slack on a loaded host
+    bound_ms += 50;
+
+    camera_service_set_stream_sink(stream_sink);
+    CHECK(camera_service_set_mode(CAMERA_MODE_STREAM, FRAMESIZE_VGA, 12) == ESP_OK);
+
+    int64_t still_total_us = 0;
+    for (int i = 0; i < STILLS; i++) {
+        usleep(250 * 1000);
+        int64_t start = host_time_us();
+        camera_fb_t *fb = camera_service_capture();
+        still_total_us += host_time_us() - start;
+        CHECK(fb != NULL);
+        if (fb) {
+            // A copy, so the stream does not wait for it
+            CHECK((size_t)fb->len == 512 + (size_t)FRAMESIZE_SXGA * 64);
+            camera_service_release(fb);
+        }
+    }
+    usleep(250 * 1000);
+    CHECK(camera_service_set_mode(CAMERA_MODE_STILL, 0, 0) == ESP_OK);
+
+    pthread_mutex_lock(&s_sink_lock);
+    int gaps = 0;
+    uint32_t max_gap = 0;
+    uint64_t gap_total = 0;
+    int64_t max_interval_us = 0;
+    CHECK(s_frame_count > STILLS * 2);
+    CHECK(s_frames[0].gap_ms == 0);
+    for (int i = 1; i < s_frame_count; i++) {
+        int64_t interval_us = s_frames[i].at_us - s_frames[i - 1].at_us;
+        if (s_frames[i].gap_ms) {
+            // Measured from the previous frame, and bounded
+            gaps++;
+            gap_total += s_frames[i].gap_ms;
+            max_gap = s_frames[i].gap_ms > max_gap ? s_frames[i].gap_ms : max_gap;
+            CHECK(llabs(interval_us / 1000 - (int64_t)s_frames[i].gap_ms) <= 1);
+            CHECK((int)s_frames[i].gap_ms <= bound_ms);
+            // Only the first frame after a still
+            CHECK(i + 1 >= s_frame_count || s_frames[i + 1].gap_ms == 0);
+        } else {
+            // No still in between: regular pacing
+            CHECK(interval_us < (STREAM_INTERVAL_MS + 40) * 1000);
+            max_interval_us = interval_us > max_interval_us ? interval_us : max_interval_us;
+        }
+    }
+    CHECK(gaps == STILLS);
+    pthread_mutex_unlock(&s_sink_lock);
+
+    camera_service_stats_t stats;
+    camera_service_get_stats(&stats);
+    CHECK(stats.max_gap_ms == max_gap);
+    printf("%d stream frames, %d stills: gap avg %lu ms, max %lu ms (bound %d ms), "
+           "max interval otherwise %lld ms\n",
+           s_frame_count, STILLS, (unsigned long)(gaps ? gap_total / gaps : 0),
+           (unsigned long)max_gap, bound_ms, (long long)(max_interval_us / 1000));
+    printf("still latency while streaming: avg %lld ms (service: avg %lu us, last %lu us)\n",
+           (long long)(still_total_us / STILLS / 1000),
+           (unsigned long)stats.avg_still_us, (unsigned long)stats.last_still_us);
+    printf("queueing: avg %lu us, max %lu us; %d driver restarts\n",
+           (unsigned long)stats.avg_queue_us, (unsigned long)stats.max_queue_us, s_restarts);
+}
+
+int main(void)
+{
+    s_sensor.status.framesize = FRAMESIZE_UXGA;
+    s_sensor.status.quality = 4;
+    s_sensor.set_framesize = set_framesize;
+    s_sensor.set_quality = set_quality;
+    s_sensor.set_brightness = set_brightness;
+    for (int i = 0; i < POOL_FRAMES; i++) {
+        s_pool[i].buf = s_pool_data[i];
+    }
+
+    CHECK(camera_service_init() == ESP_OK);
+    test_capture_jumps_queue();
+    test_stills_preempt_stream();
+
+    CHECK(s_overdrawn == 0);
+    CHECK(s_restarts_with_frames_out == 0);
+    CHECK(s_saves == 2);
+    printf("stream driver buffers: %d\n", CONFIG_GROWPOD_STREAM_FB_COUNT);
+    return host_test_result("camera_service");
+}
@@ -0,0 +1,227 @@
+/**
+ * @file test_cond_replenish.c
+ * @brief Conditional replenishment on synthetic footage
+ *
+ * Feeds jpeg_enc frames of the synthetic scene through
+ * cond_replenish_process() and checks each decision: the first frame,
+ * joins, geometry changes, the key interval and large changes send whole
+ * frames; a static scene is skipped with a keep-alive per second; a moving
+ * square goes out as patches that cover every changed pixel. With libjpeg,
+ * patches must decode to the same pixels as the region of the whole
+ * frame. A 12 s replay with sensor noise reports the bytes sent against
+ * plain MJPEG.
+ */
+
+#include "host_test.h"
+#include "host_jpeg.h"
+#include "stream/cond_replenish.h"
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define WIDTH           640
+#define HEIGHT          480
+#define QUALITY         80
+#define FRAME_US        100000
+
+static uint32_t s_rand = 7;
+
+/**
+ * @brief Encode a scene frame, with temporal noise of +-amplitude on luma
+ */
+static void encode_frame(int width, int height, int frame, int amplitude, host_buf_t *out)
+{
+    uint8_t *yuyv = host_scene_yuyv(width, height, frame);
+
+    for (size_t i = 0; amplitude && i < (size_t)width * height * 2; i += 2) {
+        s_rand = s_rand * 1103515245u + 12345u;
+        int v = yuyv[i] + (int)((s_rand >> 16) % (2 * amplitude + 1)) - amplitude;
+        yuyv[i] = v < 0 ? 0 : v > 255 ? 255 : (uint8_t)v;
+    }
+    out->len = 0;
+    CHECK(host_jpeg_encode(yuyv, width, height, QUALITY, out) == ESP_OK);
+    free(yuyv);
+}
+
+static cr_frame_type_t process(const host_buf_t *jpeg, int64_t now_us, cr_frame_t *frame)
+{
+    CHECK(cond_replenish_process(jpeg->data, jpeg->len, now_us, frame) == ESP_OK);
+    return frame->type;
+}
+
+/**
+ * @brief Check that every pixel that differs between two frames is patched
+ */
+static int uncovered_pixels(int frame_a, int frame_b, const cr_frame_t *frame)
+{
+    uint8_t *a = host_scene_yuyv(WIDTH, HEIGHT, frame_a);
+    uint8_t *b = host_scene_yuyv(WIDTH, HEIGHT, frame_b);
+    int uncovered = 0;
+
+    for (int y = 0; y < HEIGHT; y++) {
+        for (int x = 0; x < WIDTH; x++) {
+            size_t i = ((size_t)y * WIDTH + x) * 2;
+            if (a[i] == b[i]) {
+                continue;
+            }
+            bool covered = false;
+            for (int p = 0; p < frame->patch_count; p++) {
+                const cr_patch_t *r = &frame->patches[p];
+                covered |= x >= r->x && x < r->x + r->width && y >= r->y && y < r->y + r->height;
+            }
+            uncovered += !covered;
+        }
+    }
+    free(b);
+    free(a);
+    return uncovered;
+}
+
+#if HOST_HAVE_LIBJPEG
+/**
+ * @brief Check that each patch decodes to the whole frame's pixels
+ */
+static void check_patch_pixels(const host_buf_t *jpeg, const cr_frame_t *frame)
+{
+    int w = 0, h = 0;
+    uint8_t *full = host_jpeg_decode(jpeg->data, jpeg->len, &w, &h);
+    CHECK(full != NULL);
+
+    for (int p = 0; full && p < frame->patch_count; p++) {
+        const cr_patch_t *r = &frame->patches[p];
+        int pw = 0, ph = 0;
+        uint8_t *patch = host_jpeg_decode(r->data, r->len, &pw, &ph);
+        CHECK(patch != NULL && pw == r->width && ph == r->height);
+        int diff = 0;
+        for (int y = 0; patch && pw == r->width && y < ph; y++) {
+            diff += memcmp(patch + (size_t)y * pw * 3,
+                           full + ((size_t)(r->y + y) * w + r->x) * 3, (size_t)pw * 3) != 0;
+        }
+        CHECK(diff == 0);
+        free(patch);
+    }
+    free(full);
+}
+#endif
+
+static void test_decisions(void)
+{
+    host_buf_t jpeg = { 0 };
+    cr_frame_t frame;
+    int64_t now = 0;
+
+    cond_replenish_reset();
+    encode_frame(WIDTH, HEIGHT, 0, 0, &jpeg);
+    CHECK(process(&jpeg, now, &frame) == CR_FRAME_KEY);
+    CHECK(frame.total_mcus == (WIDTH / 16) * (HEIGHT / 8));
+
+    // Static: nothing, then a keep-alive once a second has passed
+    CHECK(process(&jpeg, now += FRAME_US, &frame) == CR_FRAME_SKIP);
+    CHECK(frame.changed_mcus == 0);
+    CHECK(process(&jpeg, now += 900000, &frame) == CR_FRAME_KEEPALIVE);
+    CHECK(process(&jpeg, now += FRAME_US, &frame) == CR_FRAME_SKIP);
+
+    // The square moves: patches over the old and the new position
+    encode_frame(WIDTH, HEIGHT, 1, 0, &jpeg);
+    CHECK(process(&jpeg, now += FRAME_US, &frame) == CR_FRAME_PATCHES);
+    CHECK(frame.patch_count >= 1 && frame.patch_count <= CR_MAX_PATCHES);
+    CHECK(frame.changed_mcus > 0 && frame.changed_mcus * 10 < frame.total_mcus);
+    CHECK(uncovered_pixels(0, 1, &frame) == 0);
+    size_t patch_bytes = 0;
+    for (int p = 0; p < frame.patch_count; p++) {
+        patch_bytes += frame.patches[p].len;
+    }
+    CHECK(patch_bytes * 5 < jpeg.len);
+#if HOST_HAVE_LIBJPEG
+    check_patch_pixels(&jpeg, &frame);
+#endif
+
+    // The patches became the reference
+    CHECK(process(&jpeg, now += FRAME_US, &frame) == CR_FRAME_SKIP);
+
+    // A client joins
+    cond_replenish_request_key();
+    CHECK(process(&jpeg, now += FRAME_US, &frame) == CR_FRAME_KEY);
+    CHECK(process(&jpeg, now += FRAME_US, &frame) == CR_FRAME_SKIP);
+
+    // Key interval
+    CHECK(process(&jpeg, now += 30000000, &frame) == CR_FRAME_KEY);
+
+    // Most of the picture changes: lights on
+    uint8_t *bright = host_scene_yuyv(WIDTH, HEIGHT, 1);
+    for (size_t i = 0; i < (size_t)WIDTH * HEIGHT * 2; i += 2) {
+        bright[i] = bright[i] > 195 ? 255 : bright[i] + 60;
+    }
+    host_buf_t lit = { 0 };
+    CHECK(host_jpeg_encode(bright, WIDTH, HEIGHT, QUALITY, &lit) == ESP_OK);
+    CHECK(process(&lit, now += FRAME_US, &frame) == CR_FRAME_KEY);
+    CHECK(frame.changed_mcus * 2 > frame.total_mcus);
+    host_buf_free(&lit);
+    free(bright);
+
+    // New geometry
+    encode_frame(320, 240, 1, 0, &jpeg);
+    CHECK(process(&jpeg, now += FRAME_US, &frame) == CR_FRAME_KEY);
+    CHECK(process(&jpeg, now += FRAME_US, &frame) == CR_FRAME_SKIP);
+
+    // A corrupt frame goes out whole, and so does the next one
+    host_buf_t broken = { 0 };
+    host_buf_output(jpeg.data, 200, &broken);
+    CHECK(cond_replenish_process(broken.data, broken.len, now += FRAME_US, &frame) != ESP_OK);
+    CHECK(frame.type == CR_FRAME_KEY);
+    CHECK(process(&jpeg, now += FRAME_US, &frame) == CR_FRAME_KEY);
+    CHECK(process(&jpeg, now += FRAME_US, &frame) == CR_FRAME_SKIP);
+    host_buf_free(&broken);
+
+    host_buf_free(&jpeg);
+}
+
+/**
+ * @brief 12 s at 10 fps: static, the square crossing, static again
+ */
+static void test_replay(void)
+{
+    host_buf_t jpeg = { 0 };
+    cr_frame_t frame;
+    size_t mjpeg = 0, cr = 0;
+    int counts[4] = { 0 };
+    uint32_t process_us = 0;
+
+    cond_replenish_reset();
+    for (int i = 0; i < 120; i++) {
+        int pos = i < 30 ? 0 : i < 90 ? i - 29 : 61;
+        encode_frame(WIDTH, HEIGHT, pos, 2, &jpeg);
+        CHECK(cond_replenish_process(jpeg.data, jpeg.len, (int64_t)i * FRAME_US, &frame) ==
+              ESP_OK);
+        counts[frame.type]++;
+        process_us += frame.process_us;
+        mjpeg += jpeg.len;
+        if (frame.type == CR_FRAME_KEY) {
+            cr += jpeg.len;
+        }
+        for (int p = 0; p < frame.patch_count; p++) {
+            cr += frame.patches[p].len;
+        }
+        if (i >= 30 && i < 90) {
+            CHECK(frame.type == CR_FRAME_PATCHES);
+        }
+    }
+    printf("replay %dx%d q%d, 120 frames: %d key, %d patch, %d keep-alive, %d skipped\n",
+           WIDTH, HEIGHT, QUALITY, counts[CR_FRAME_KEY], counts[CR_FRAME_PATCHES],
+           counts[CR_FRAME_KEEPALIVE], counts[CR_FRAME_SKIP]);
+    printf("  MJPEG %zu KB, replenishment %zu KB (%.1f%%), %u us per frame\n", mjpeg / 1024,
+           cr / 1024, 100.0 * cr / mjpeg, process_us / 120);
+    CHECK(counts[CR_FRAME_KEY] == 1);
+    CHECK(counts[CR_FRAME_KEEPALIVE] >= 4);
+    CHECK(cr * 10 < mjpeg);
+
+    cond_replenish_reset();
+    host_buf_free(&jpeg);
+}
+
+int main(void)
+{
+    test_decisions();
+    test_replay();
+    return host_test_result("cond_replenish");
+}
@@ -0,0 +1,180 @@
+/**
+ * @file test_downscale.c
+ * @brief YUYV halving kernels and bilinear resampling
+ *
+ * The scalar kernel is checked against an independent 2x2 average, the
+ * SWAR kernel against the scalar one (within 1, no bias against the exact
+ * average), in-place halving
+ * against out-of-place, and banded resampling against the whole frame.
+ * Prints the halving throughput of both kernels at QXGA.
+ */
+
+#include "host_test.h"
+#include "imgproc/downscale.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define BENCH_WIDTH     2048
+#define BENCH_HEIGHT    1536
+#define BENCH_RUNS      20
+
+static uint32_t s_rand = 12345;
+
+static uint8_t rand_byte(void)
+{
+    s_rand = s_rand * 1103515245u + 12345u;
+    return (uint8_t)(s_rand >> 16);
+}
+
+typedef enum { FILL_RANDOM, FILL_ZERO, FILL_FULL, FILL_CHECKER } fill_t;
+
+static uint8_t *make_frame(int width, int height, fill_t fill)
+{
+    size_t len = (size_t)width * height * 2;
+    uint8_t *frame = malloc(len);
+    for (size_t i = 0; i < len; i++) {
+        switch (fill) {
+            case FILL_RANDOM:  frame[i] = rand_byte(); break;
+            case FILL_ZERO:    frame[i] = 0; break;
+            case FILL_FULL:    frame[i] = 255; break;
+            case FILL_CHECKER: frame[i] = ((i / 2 + i / (width * 2)) & 1) ? 255 : 0; break;
+        }
+    }
+    return frame;
+}
+
+/**
+ * @brief Sum of a 2x2 block, one sample at a time from pixel coordinates
+ */
+static int reference_sum(const uint8_t *src, int width, int x, int y, int byte)
+{
+    const uint8_t *r0 = src + (size_t)(2 * y) * width * 2;
+    const uint8_t *r1 = r0 + width * 2;
+    int sum;
+
+    if (byte == 0 || byte == 2) {
+        // Luma of output pixel px covers source pixels 2px and 2px + 1
+        int px = 2 * x + byte / 2;
+        sum = r0[4 * px] + r0[4 * px + 2] + r1[4 * px] + r1[4 * px + 2];
+    } else {
+        // U (byte 1) or V (byte 3) of the two source pairs under the output pair
+        int off = byte;
+        sum = r0[8 * x + off] + r0[8 * x + 4 + off] + r1[8 * x + off] + r1[8 * x + 4 + off];
+    }
+    return sum;
+}
+
+static void test_half(int width, int height, fill_t fill)
+{
+    uint8_t *src = make_frame(width, height, fill);
+    size_t out_len = (size_t)(width / 2) * (height / 2) * 2;
+    uint8_t *scalar = malloc(out_len);
+    uint8_t *swar = malloc(out_len);
+
+    downscale_yuyv_half(DOWNSCALE_KERNEL_SCALAR, src, width, height, scalar);
+    downscale_yuyv_half(DOWNSCALE_KERNEL_SWAR, src, width, height, swar);
+
+    int wrong = 0;
+    int max_diff = 0;
+    int64_t bias_x4 = 0;
+    for (int y = 0; y < height / 2; y++) {
+        for (int x = 0; x < width / 4; x++) {
+            for (int b = 0; b < 4; b++) {
+                size_t i = ((size_t)y * (width / 4) + x) * 4 + b;
+                int sum = reference_sum(src, width, x, y, b);
+                wrong += scalar[i] != (sum + 2) >> 2;
+                int diff = swar[i] - scalar[i];
+                bias_x4 += 4 * swar[i] - sum;
+                max_diff = abs(diff) > max_diff ? abs(diff) : max_diff;
+            }
+        }
+    }
+    CHECK(wrong == 0);
+    CHECK(max_diff <= 1);
+    // The opposite roundings cancel out over a random frame: mean error under 0.02
+    if (fill == FILL_RANDOM && out_len >= 100000) {
+        CHECK(llabs(bias_x4) * 50 <= (int64_t)out_len * 4);
+    }
+
+    // In place gives the same result for both kernels
+    for (int k = 0; k < 2; k++) {
+        downscale_kernel_t kernel = k ? DOWNSCALE_KERNEL_SWAR : DOWNSCALE_KERNEL_SCALAR;
+        uint8_t *frame = malloc((size_t)width * height * 2);
+        memcpy(frame, src, (size_t)width * height * 2);
+        downscale_yuyv_half(kernel, frame, width, height, frame);
+        CHECK(memcmp(frame, k ? swar : scalar, out_len) == 0);
+        free(frame);
+    }
+
+    free(swar);
+    free(scalar);
+    free(src);
+}
+
+static void test_resize(void)
+{
+    const int sw = 320, sh = 240;
+    uint8_t *src = make_frame(sw, sh, FILL_RANDOM);
+    uint8_t *full = malloc((size_t)sw * sh * 2);
+    uint8_t *band = malloc((size_t)sw * sh * 2);
+
+    // Same size: every sample lands on a source sample
+    downscale_yuyv_resize(src, sw, sh, full, sw, sh);
+    CHECK(memcmp(full, src, (size_t)sw * sh * 2) == 0);
+
+    // Bands of 16 rows, as the JPEG encoder takes them, match the whole frame
+    const int dw = 200, dh = 150;
+    downscale_yuyv_resize(src, sw, sh, full, dw, dh);
+    for (int row = 0; row < dh; row += 16) {
+        int rows = dh - row < 16 ? dh - row : 16;
+        downscale_yuyv_resize_rows(src, sw, sh, band, dw, dh, row, rows);
+        CHECK(memcmp(band, full + (size_t)row * dw * 2, (size_t)rows * dw * 2) == 0);
+    }
+
+    // A flat frame stays flat
+    memset(src, 77, (size_t)sw * sh * 2);
+    downscale_yuyv_resize(src, sw, sh, full, dw, dh);
+    int off = 0;
+    for (int i = 0; i < dw * dh * 2; i++) {
+        off += full[i] != 77;
+    }
+    CHECK(off == 0);
+
+    free(band);
+    free(full);
+    free(src);
+}
+
+static void bench_half(void)
+{
+    uint8_t *src = make_frame(BENCH_WIDTH, BENCH_HEIGHT, FILL_RANDOM);
+    uint8_t *dst = malloc((size_t)BENCH_WIDTH * BENCH_HEIGHT / 2);
+    double mpix = (double)BENCH_WIDTH * BENCH_HEIGHT * BENCH_RUNS / 1e6;
+
+    for (int k = 0; k < 2; k++) {
+        downscale_kernel_t kernel = k ? DOWNSCALE_KERNEL_SWAR : DOWNSCALE_KERNEL_SCALAR;
+        int64_t start = host_time_us();
+        for (int i = 0; i < BENCH_RUNS; i++) {
+            downscale_yuyv_half(kernel, src, BENCH_WIDTH, BENCH_HEIGHT, dst);
+        }
+        int64_t elapsed = host_time_us() - start;
+        printf("halve %dx%d, %s: %.0f MP/s\n", BENCH_WIDTH, BENCH_HEIGHT,
+               downscale_kernel_name(kernel), elapsed ? mpix * 1e6 / elapsed : 0.0);
+    }
+    free(dst);
+    free(src);
+}
+
+int main(void)
+{
+    test_half(16, 2, FILL_RANDOM);
+    test_half(64, 10, FILL_RANDOM);
+    test_half(640, 480, FILL_RANDOM);
+    test_half(648, 486, FILL_RANDOM);
+    test_half(64, 8, FILL_ZERO);
+    test_half(64, 8, FILL_FULL);
+    test_half(64, 8, FILL_CHECKER);
+    test_resize();
+    bench_half();
+    return host_test_result("downscale");
+}
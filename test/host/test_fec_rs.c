@@ -0,0 +1,296 @@
+/**
+ * @file test_fec_rs.c
+ * @brief Reed-Solomon erasure code
+ *
+ * Checks fec_rs_parity() against its definition with a bit-serial field
+ * multiply, and that any k blocks of a group recover the data: erasures
+ * are solved with a Gauss-Jordan decoder written here independently of
+ * the firmware's tables. Prints the parity throughput for the UDP still
+ * transfer's groups.
+ *
+ * With --vectors k rows seed, writes a group's data blocks followed by its
+ * parity rows to stdout instead, for fec_client.py to decode with the
+ * client's decoder.
+ */
+
+#include "host_test.h"
+#include "net/fec_rs.h"
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define BLOCK_SIZE      1200        // UDP_BLOCK_SIZE in udp_still.c and the client
+#define BENCH_K         32
+#define BENCH_ROWS      4
+#define BENCH_GROUPS    2000
+
+static uint32_t s_rand;
+
+static uint32_t rand_next(void)
+{
+    s_rand = s_rand * 1103515245u + 12345u;
+    return s_rand >> 8;
+}
+
+/**
+ * @brief GF(2^8) multiply, shift and add, polynomial 0x11d
+ */
+static uint8_t gf_mul(uint8_t a, uint8_t b)
+{
+    unsigned p = 0, x = a;
+
+    for (; b; b >>= 1) {
+        if (b & 1) {
+            p ^= x;
+        }
+        x <<= 1;
+        if (x & 0x100) {
+            x ^= 0x11d;
+        }
+    }
+    return (uint8_t)p;
+}
+
+static uint8_t gf_inv(uint8_t a)
+{
+    for (int b = 1; b < 256; b++) {
+        if (gf_mul(a, (uint8_t)b) == 1) {
+            return (uint8_t)b;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Coefficient of data block i in parity row r: 1 / ((k + r) ^ i)
+ */
+static uint8_t coef(int k, int row, int i)
+{
+    return gf_inv((uint8_t)((k + row) ^ i));
+}
+
+static uint8_t **make_group(int k)
+{
+    uint8_t **data = malloc(k * sizeof(uint8_t *));
+    for (int i = 0; i < k; i++) {
+        data[i] = malloc(BLOCK_SIZE);
+        for (int b = 0; b < BLOCK_SIZE; b++) {
+            data[i][b] = (uint8_t)rand_next();
+        }
+    }
+    return data;
+}
+
+static void free_group(uint8_t **data, int k)
+{
+    for (int i = 0; i < k; i++) {
+        free(data[i]);
+    }
+    free(data);
+}
+
+/**
+ * @brief Recover erased data blocks from parity rows
+ *
+ * @param data Group with the erased blocks' contents destroyed
+ * @param erased Indices of the erased blocks
+ * @param rows Parity rows received, one per erased block
+ * @param parity Those rows' blocks
+ * @return true if the system was solvable
+ */
+static bool recover(uint8_t **data, int k, const int *erased, int n, const int *rows,
+                    uint8_t **parity)
+{
+    uint8_t m[n][n];
+    uint8_t rhs[n][BLOCK_SIZE];
+
+    // Move the known blocks to the right-hand side
+    for (int r = 0; r < n; r++) {
+        memcpy(rhs[r], parity[r], BLOCK_SIZE);
+        for (int i = 0; i < k; i++) {
+            bool lost = false;
+            for (int e = 0; e < n; e++) {
+                lost |= erased[e] == i;
+            }
+            if (lost) {
+                continue;
+            }
+            uint8_t c = coef(k, rows[r], i);
+            for (int b = 0; b < BLOCK_SIZE; b++) {
+                rhs[r][b] ^= gf_mul(c, data[i][b]);
+            }
+        }
+        for (int e = 0; e < n; e++) {
+            m[r][e] = coef(k, rows[r], erased[e]);
+        }
+    }
+
+    for (int col = 0; col < n; col++) {
+        int pivot = col;
+        while (pivot < n && m[pivot][col] == 0) {
+            pivot++;
+        }
+        if (pivot == n) {
+            return false;
+        }
+        uint8_t tmp[BLOCK_SIZE];          // n is at most a few dozen
+        memcpy(tmp, m[col], n);
+        memcpy(m[col], m[pivot], n);
+        memcpy(m[pivot], tmp, n);
+        memcpy(tmp, rhs[col], BLOCK_SIZE);
+        memcpy(rhs[col], rhs[pivot], BLOCK_SIZE);
+        memcpy(rhs[pivot], tmp, BLOCK_SIZE);
+
+        uint8_t inv = gf_inv(m[col][col]);
+        for (int j = 0; j < n; j++) {
+            m[col][j] = gf_mul(m[col][j], inv);
+        }
+        for (int b = 0; b < BLOCK_SIZE; b++) {
+            rhs[col][b] = gf_mul(rhs[col][b], inv);
+        }
+        for (int r = 0; r < n; r++) {
+            uint8_t f = m[r][col];
+            if (r == col || f == 0) {
+                continue;
+            }
+            for (int j = 0; j < n; j++) {
+                m[r][j] ^= gf_mul(f, m[col][j]);
+            }
+            for (int b = 0; b < BLOCK_SIZE; b++) {
+                rhs[r][b] ^= gf_mul(f, rhs[col][b]);
+            }
+        }
+    }
+    for (int e = 0; e < n; e++) {
+        memcpy(data[erased[e]], rhs[e], BLOCK_SIZE);
+    }
+    return true;
+}
+
+static void test_definition(void)
+{
+    static const int ks[] = { 1, 7, 32 };
+
+    for (size_t t = 0; t < sizeof(ks) / sizeof(ks[0]); t++) {
+        int k = ks[t];
+        uint8_t **data = make_group(k);
+        uint8_t out[BLOCK_SIZE];
+        const int rows[] = { 0, 1, FEC_RS_MAX_BLOCKS - k - 1 };
+
+        for (int r = 0; r < 3; r++) {
+            fec_rs_parity((const uint8_t *const *)data, k, BLOCK_SIZE, rows[r], out);
+            int wrong = 0;
+            for (int b = 0; b < BLOCK_SIZE; b++) {
+                uint8_t want = 0;
+                for (int i = 0; i < k; i++) {
+                    want ^= gf_mul(coef(k, rows[r], i), data[i][b]);
+                }
+                wrong += out[b] != want;
+            }
+            CHECK(wrong == 0);
+        }
+        free_group(data, k);
+    }
+}
+
+/**
+ * @brief Erase random blocks and recover them from random parity rows
+ */
+static void test_erasures(int k, int max_erased, int runs)
+{
+    uint8_t **data = make_group(k);
+    uint8_t **orig = make_group(k);
+    uint8_t **parity = make_group(max_erased);
+    int failed = 0;
+
+    for (int i = 0; i < k; i++) {
+        memcpy(orig[i], data[i], BLOCK_SIZE);
+    }
+    for (int run = 0; run < runs; run++) {
+        int n = 1 + rand_next() % max_erased;
+        int erased[n], rows[n];
+
+        // Distinct blocks and rows; late rows are what NACK rounds send
+        for (int e = 0; e < n; e++) {
+            bool again;
+            do {
+                erased[e] = rand_next() % k;
+                rows[e] = rand_next() % (FEC_RS_MAX_BLOCKS - k);
+                again = false;
+                for (int j = 0; j < e; j++) {
+                    again |= erased[j] == erased[e] || rows[j] == rows[e];
+                }
+            } while (again);
+            fec_rs_parity((const uint8_t *const *)orig, k, BLOCK_SIZE, rows[e], parity[e]);
+        }
+        for (int e = 0; e < n; e++) {
+            memset(data[erased[e]], 0xa5, BLOCK_SIZE);
+        }
+        failed += !recover(data, k, erased, n, rows, parity);
+        for (int i = 0; i < k; i++) {
+            failed += memcmp(data[i], orig[i], BLOCK_SIZE) != 0;
+            memcpy(data[i], orig[i], BLOCK_SIZE);
+        }
+    }
+    CHECK(failed == 0);
+
+    free_group(parity, max_erased);
+    free_group(orig, k);
+    free_group(data, k);
+}
+
+static void bench_parity(void)
+{
+    uint8_t **data = make_group(BENCH_K);
+    uint8_t out[BLOCK_SIZE];
+
+    int64_t start = host_time_us();
+    for (int g = 0; g < BENCH_GROUPS; g++) {
+        for (int r = 0; r < BENCH_ROWS; r++) {
+            fec_rs_parity((const uint8_t *const *)data, BENCH_K, BLOCK_SIZE, r, out);
+        }
+    }
+    int64_t elapsed = host_time_us() - start;
+    double mb = (double)BENCH_GROUPS * BENCH_K * BLOCK_SIZE / 1e6;
+    printf("parity k=%d, %d rows (%d%%): %.0f MB/s of data, %.1f us per group\n", BENCH_K,
+           BENCH_ROWS, BENCH_ROWS * 100 / BENCH_K, elapsed ? mb * 1e6 / elapsed : 0.0,
+           (double)elapsed / BENCH_GROUPS);
+    free_group(data, BENCH_K);
+}
+
+/**
+ * @brief Write a group and its parity rows to stdout
+ */
+static int write_vectors(int k, int rows, uint32_t seed)
+{
+    s_rand = seed;
+    uint8_t **data = make_group(k);
+    uint8_t out[BLOCK_SIZE];
+
+    for (int i = 0; i < k; i++) {
+        fwrite(data[i], 1, BLOCK_SIZE, stdout);
+    }
+    for (int r = 0; r < rows; r++) {
+        fec_rs_parity((const uint8_t *const *)data, k, BLOCK_SIZE, r, out);
+        fwrite(out, 1, BLOCK_SIZE, stdout);
+    }
+    free_group(data, k);
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    fec_rs_init();
+    if (argc == 5 && strcmp(argv[1], "--vectors") == 0) {
+        return write_vectors(atoi(argv[2]), atoi(argv[3]), (uint32_t)atoi(argv[4]));
+    }
+
+    s_rand = 1;
+    test_definition();
+    test_erasures(1, 1, 20);
+    test_erasures(4, 4, 200);
+    test_erasures(32, 8, 200);
+    test_erasures(200, 20, 10);
+    bench_parity();
+    return host_test_result("fec_rs");
+}
@@ -0,0 +1,141 @@
+/**
+ * @file test_frame_queue.c
+ * @brief SPSC frame ring: capacity, order, and a two-thread stress run
+ *
+ * The stress run pushes millions of descriptors from one thread and pops
+ * them in another, retrying when the ring is full or empty as the camera
+ * service and the network task do. Every field of each descriptor is
+ * derived from its sequence number, so a lost, duplicated, reordered or
+ * torn slot shows up as a mismatch.
+ *
+ * Usage: test_frame_queue [items]   (default 4000000)
+ */
+
+#include "host_test.h"
+#include "stream/frame_queue.h"
+#include <pthread.h>
+#include <sched.h>
+#include <stdlib.h>
+
+static frame_queue_t s_queue;
+static uint32_t s_items = 4000000;
+static uint64_t s_full_retries;
+static uint64_t s_empty_retries;
+
+static frame_desc_t make_desc(uint32_t seq)
+{
+    frame_desc_t desc = {
+        .fb = (camera_fb_t *)(uintptr_t)(((uintptr_t)seq + 1) * 16),
+        .timestamp_us = (int64_t)seq * 33333 + 7,
+        .seq = seq,
+        .gap_ms = seq ^ 0x5a5a5a5au,
+    };
+    return desc;
+}
+
+static bool desc_matches(const frame_desc_t *desc, uint32_t seq)
+{
+    frame_desc_t want = make_desc(seq);
+    return desc->fb == want.fb && desc->timestamp_us == want.timestamp_us &&
+           desc->seq == want.seq && desc->gap_ms == want.gap_ms;
+}
+
+static void test_capacity_and_order(void)
+{
+    frame_desc_t desc;
+
+    frame_queue_init(&s_queue);
+    CHECK(frame_queue_count(&s_queue) == 0);
+    CHECK(!frame_queue_pop(&s_queue, &desc));
+
+    for (uint32_t i = 0; i < FRAME_QUEUE_CAPACITY; i++) {
+        desc = make_desc(i);
+        CHECK(frame_queue_push(&s_queue, &desc));
+    }
+    desc = make_desc(FRAME_QUEUE_CAPACITY);
+    CHECK(!frame_queue_push(&s_queue, &desc));
+    CHECK(frame_queue_count(&s_queue) == FRAME_QUEUE_CAPACITY);
+
+    // Run the counters around the ring several times
+    uint32_t next_push = FRAME_QUEUE_CAPACITY;
+    for (uint32_t i = 0; i < 10 * FRAME_QUEUE_CAPACITY; i++) {
+        CHECK(frame_queue_pop(&s_queue, &desc));
+        CHECK(desc_matches(&desc, i));
+        frame_desc_t in = make_desc(next_push++);
+        CHECK(frame_queue_push(&s_queue, &in));
+    }
+    for (uint32_t i = 10 * FRAME_QUEUE_CAPACITY; i < next_push; i++) {
+        CHECK(frame_queue_pop(&s_queue, &desc));
+        CHECK(desc_matches(&desc, i));
+    }
+    CHECK(frame_queue_count(&s_queue) == 0);
+    CHECK(!frame_queue_pop(&s_queue, &desc));
+}
+
+static void *producer(void *arg)
+{
+    for (uint32_t seq = 0; seq < s_items; seq++) {
+        frame_desc_t desc = make_desc(seq);
+        while (!frame_queue_push(&s_queue, &desc)) {
+            s_full_retries++;
+            sched_yield();
+        }
+    }
+    return NULL;
+}
+
+static void *consumer(void *arg)
+{
+    uint32_t *mismatches = arg;
+    uint32_t expected = 0;
+
+    while (expected < s_items) {
+        frame_desc_t desc;
+        if (!frame_queue_pop(&s_queue, &desc)) {
+            s_empty_retries++;
+            sched_yield();
+            continue;
+        }
+        if (!desc_matches(&desc, expected)) {
+            if (*mismatches < 5) {
+                fprintf(stderr, "item %u: got seq %u\n", expected, desc.seq);
+            }
+            (*mismatches)++;
+            // Resynchronise so one fault is not reported for every later item
+            expected = desc.seq;
+        }
+        expected++;
+    }
+    return NULL;
+}
+
+static void test_two_threads(void)
+{
+    pthread_t prod, cons;
+    uint32_t mismatches = 0;
+
+    frame_queue_init(&s_queue);
+    int64_t start = host_time_us();
+    CHECK(pthread_create(&cons, NULL, consumer, &mismatches) == 0);
+    CHECK(pthread_create(&prod, NULL, producer, NULL) == 0);
+    pthread_join(prod, NULL);
+    pthread_join(cons, NULL);
+    int64_t elapsed = host_time_us() - start;
+
+    CHECK(mismatches == 0);
+    CHECK(frame_queue_count(&s_queue) == 0);
+    printf("%u items in %lld ms: %.2f M items/s, %llu full and %llu empty retries\n",
+           s_items, (long long)(elapsed / 1000),
+           elapsed ? s_items / (double)elapsed : 0.0,
+           (unsigned long long)s_full_retries, (unsigned long long)s_empty_retries);
+}
+
+int main(int argc, char **argv)
+{
+    if (argc > 1) {
+        s_items = (uint32_t)strtoul(argv[1], NULL, 0);
+    }
+    test_capacity_and_order();
+    test_two_threads();
+    return host_test_result("frame_queue");
+}
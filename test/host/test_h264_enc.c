@@ -0,0 +1,566 @@
+/**
+ * @file test_h264_enc.c
+ * @brief H.264 encoder and its fragmented MP4 packaging
+ *
+ * Encodes a synthetic sequence: the test scene panned two pixels a frame,
+ * with fresh sensor-like noise in every frame so P pictures cost bits at
+ * any QP. Checks the NAL unit types and order of each access unit, the
+ * SPS and slice header fields, the GOP cadence and forced IDRs, that rate
+ * control settles on the target bitrate, and that every fragment's boxes
+ * nest and add up. Prints encode speed and bitrate next to MJPEG's for
+ * the same frames.
+ */
+
+#include "host_test.h"
+#include "host_jpeg.h"
+#include "h264/h264_enc.h"
+#include "h264/h264_mp4.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define WIDTH           320
+#define HEIGHT          240
+#define FPS             10
+#define PAN_PX          2           // Per frame, even so YUYV pairs stay whole
+#define SEQ_FRAMES      150
+
+#define BENCH_WIDTH     640
+#define BENCH_HEIGHT    480
+#define BENCH_FRAMES    40
+#define BENCH_BITRATE   1000000
+#define BENCH_QUALITY   80
+
+static uint32_t s_rand = 1;
+
+static uint32_t rand_next(void)
+{
+    s_rand ^= s_rand << 13;
+    s_rand ^= s_rand >> 17;
+    s_rand ^= s_rand << 5;
+    return s_rand;
+}
+
+/**
+ * @brief Scene wide enough to pan across for a whole sequence
+ */
+typedef struct {
+    uint8_t *yuyv;
+    int width;              // The scene's
+    int out_width;          // The frames'
+    int height;
+    uint8_t *frame;
+} source_t;
+
+static void source_init(source_t *src, int width, int height, int frames)
+{
+    src->width = width + PAN_PX * frames;
+    src->out_width = width;
+    src->height = height;
+    src->yuyv = host_scene_yuyv(src->width, height, 0);
+    src->frame = malloc((size_t)width * height * 2);
+}
+
+static void source_free(source_t *src)
+{
+    free(src->yuyv);
+    free(src->frame);
+}
+
+/**
+ * @brief Frame n: the scene shifted left by n * PAN_PX, plus noise on luma
+ */
+static const uint8_t *source_frame(source_t *src, int n)
+{
+    for (int y = 0; y < src->height; y++) {
+        const uint8_t *in = src->yuyv + ((size_t)y * src->width + n * PAN_PX) * 2;
+        uint8_t *out = src->frame + (size_t)y * src->out_width * 2;
+        memcpy(out, in, src->out_width * 2);
+        for (int x = 0; x < src->out_width * 2; x += 2) {
+            int v = out[x] + (int)(rand_next() % 7) - 3;
+            out[x] = v < 0 ? 0 : v > 255 ? 255 : v;
+        }
+    }
+    return src->frame;
+}
+
+// --- Bitstream reading ---
+
+/**
+ * @brief RBSP reader over a NAL unit, emulation prevention bytes removed
+ */
+typedef struct {
+    uint8_t rbsp[256];
+    size_t len;
+    size_t bit;
+} rbsp_t;
+
+static void rbsp_init(rbsp_t *r, const uint8_t *nal, size_t len)
+{
+    int zeros = 0;
+
+    r->len = 0;
+    r->bit = 8;                         // Past the NAL header
+    for (size_t i = 0; i < len && r->len < sizeof(r->rbsp); i++) {
+        if (zeros >= 2 && nal[i] == 3) {
+            zeros = 0;
+            continue;
+        }
+        zeros = nal[i] == 0 ? zeros + 1 : 0;
+        r->rbsp[r->len++] = nal[i];
+    }
+}
+
+static unsigned rbsp_u(rbsp_t *r, int n)
+{
+    unsigned v = 0;
+
+    for (int i = 0; i < n; i++, r->bit++) {
+        int bit = r->bit / 8 < r->len ? (r->rbsp[r->bit / 8] >> (7 - r->bit % 8)) & 1 : 0;
+        v = (v << 1) | bit;
+    }
+    return v;
+}
+
+static unsigned rbsp_ue(rbsp_t *r)
+{
+    int zeros = 0;
+
+    while (rbsp_u(r, 1) == 0 && zeros < 32) {
+        zeros++;
+    }
+    return (1u << zeros) - 1 + rbsp_u(r, zeros);
+}
+
+/**
+ * @brief NAL unit types of an Annex B access unit, in order
+ *
+ * @return Number of units, or -1 if one lacks its 4-byte start code or
+ *         has the forbidden bit set
+ */
+static int nal_types(const h264_frame_t *frame, int *types, int max)
+{
+    size_t pos = 0;
+    const uint8_t *nal;
+    size_t nal_len;
+    int n = 0;
+
+    while (h264_next_nal(frame->data, frame->len, &pos, &nal, &nal_len) && n < max) {
+        if (nal < frame->data + 4 || memcmp(nal - 4, "\0\0\0\1", 4) != 0 || (nal[0] & 0x80)) {
+            return -1;
+        }
+        types[n++] = nal[0] & 0x1f;
+    }
+    return n;
+}
+
+/**
+ * @brief The unit of a given type in an access unit
+ */
+static const uint8_t *find_nal(const h264_frame_t *frame, int type, size_t *len)
+{
+    size_t pos = 0;
+    const uint8_t *nal;
+
+    while (h264_next_nal(frame->data, frame->len, &pos, &nal, len)) {
+        if ((nal[0] & 0x1f) == type) {
+            return nal;
+        }
+    }
+    return NULL;
+}
+
+static h264_enc_t *create(int width, int height, int gop, int bitrate, int qp)
+{
+    h264_enc_config_t config = {
+        .width = width, .height = height, .gop = gop, .bitrate = bitrate, .qp = qp,
+    };
+    h264_enc_t *enc = NULL;
+
+    CHECK(h264_enc_create(&config, &enc) == ESP_OK);
+    return enc;
+}
+
+// --- Tests ---
+
+static void test_invalid_config(void)
+{
+    h264_enc_config_t config = { .width = WIDTH, .height = HEIGHT, .gop = 0, .qp = 30 };
+    h264_enc_t *enc = NULL;
+
+    CHECK(h264_enc_create(&config, &enc) == ESP_ERR_INVALID_ARG);
+    config.gop = 10;
+    config.width = WIDTH + 1;
+    CHECK(h264_enc_create(&config, &enc) == ESP_ERR_INVALID_ARG);
+    config.width = WIDTH;
+    config.height = 0;
+    CHECK(h264_enc_create(&config, &enc) == ESP_ERR_INVALID_ARG);
+}
+
+/**
+ * @brief SPS, PPS and IDR slice on every GOP boundary and on request,
+ *        one non-IDR slice otherwise
+ */
+static void test_nal_types(void)
+{
+    const int gop = 12;
+    source_t src;
+    h264_enc_t *enc = create(WIDTH, HEIGHT, gop, 0, 30);
+
+    source_init(&src, WIDTH, HEIGHT, 40);
+    int since_idr = 0;
+    int frame_num = 0;
+    for (int n = 0; n < 40; n++) {
+        // Forced IDR mid-GOP; the cadence restarts from it
+        if (n == 30) {
+            h264_enc_request_idr(enc);
+        }
+        h264_frame_t frame;
+        CHECK(h264_enc_encode(enc, source_frame(&src, n), (int64_t)n * 1000000 / FPS,
+                              &frame) == ESP_OK);
+        bool want_idr = n == 0 || n == 30 || since_idr == gop;
+        CHECK(frame.idr == want_idr);
+        CHECK(frame.qp == 30);
+
+        int types[8];
+        int count = nal_types(&frame, types, 8);
+        if (want_idr) {
+            CHECK(count == 3 && types[0] == 7 && types[1] == 8 && types[2] == 5);
+            since_idr = 0;
+            frame_num = 0;
+        } else {
+            CHECK(count == 1 && types[0] == 1);
+        }
+        since_idr++;
+
+        // The slice header: first MB 0, slice type I or P, frame_num
+        // counting up from the IDR (log2_max_frame_num 4)
+        size_t len;
+        const uint8_t *slice = find_nal(&frame, want_idr ? 5 : 1, &len);
+        CHECK(slice != NULL);
+        if (slice) {
+            rbsp_t r;
+            rbsp_init(&r, slice, len);
+            CHECK((slice[0] >> 5) != 0);            // nal_ref_idc: every picture is a reference
+            CHECK(rbsp_ue(&r) == 0);
+            CHECK(rbsp_ue(&r) % 5 == (want_idr ? 2u : 0u));
+            CHECK(rbsp_ue(&r) == 0);
+            CHECK(rbsp_u(&r, 4) == (unsigned)(frame_num & 15));
+        }
+        frame_num++;
+    }
+    h264_enc_destroy(enc);
+    source_free(&src);
+}
+
+/**
+ * @brief SPS fields: Constrained Baseline, picture size with cropping
+ */
+static void test_sps(int width, int height)
+{
+    source_t src;
+    h264_enc_t *enc = create(width, height, 10, 0, 30);
+    h264_frame_t frame;
+    size_t len;
+
+    source_init(&src, width, height, 1);
+    CHECK(h264_enc_encode(enc, source_frame(&src, 0), 0, &frame) == ESP_OK);
+    const uint8_t *sps = find_nal(&frame, 7, &len);
+    CHECK(sps != NULL);
+    if (sps) {
+        rbsp_t r;
+        rbsp_init(&r, sps, len);
+        CHECK(rbsp_u(&r, 8) == 66);                  // profile_idc
+        CHECK(rbsp_u(&r, 8) == 0xc0);                // constraint_set0/1
+        rbsp_u(&r, 8);                               // level_idc
+        CHECK(rbsp_ue(&r) == 0);                     // seq_parameter_set_id
+        CHECK(rbsp_ue(&r) == 0);                     // log2_max_frame_num_minus4
+        CHECK(rbsp_ue(&r) == 2);                     // pic_order_cnt_type
+        CHECK(rbsp_ue(&r) == 1);                     // max_num_ref_frames
+        rbsp_u(&r, 1);
+        int mb_w = rbsp_ue(&r) + 1;
+        int mb_h = rbsp_ue(&r) + 1;
+        CHECK(rbsp_u(&r, 1) == 1);                   // frame_mbs_only_flag
+        rbsp_u(&r, 1);
+        int crop_right = 0, crop_bottom = 0;
+        if (rbsp_u(&r, 1)) {
+            rbsp_ue(&r);
+            crop_right = rbsp_ue(&r);
+            rbsp_ue(&r);
+            crop_bottom = rbsp_ue(&r);
+        }
+        // Crop units are two samples in 4:2:0
+        CHECK(mb_w * 16 - 2 * crop_right == width);
+        CHECK(mb_h * 16 - 2 * crop_bottom == height);
+    }
+    h264_enc_destroy(enc);
+    source_free(&src);
+}
+
+/**
+ * @brief Bitrate over the last two thirds of a sequence at a target
+ *
+ * @param qp_avg Receives the mean QP over the same pictures
+ * @return Bits per second
+ */
+static double run_rate(int bitrate, int gop, double *qp_avg)
+{
+    source_t src;
+    h264_enc_t *enc = create(WIDTH, HEIGHT, gop, bitrate, 30);
+    int64_t bits = 0;
+    int qp_sum = 0, counted = 0;
+
+    source_init(&src, WIDTH, HEIGHT, SEQ_FRAMES);
+    for (int n = 0; n < SEQ_FRAMES; n++) {
+        h264_frame_t frame;
+        esp_err_t err = h264_enc_encode(enc, source_frame(&src, n),
+                                        (int64_t)n * 1000000 / FPS, &frame);
+        CHECK(err == ESP_OK);
+        if (err == ESP_OK && n >= SEQ_FRAMES / 3) {
+            bits += (int64_t)frame.len * 8;
+            qp_sum += frame.qp;
+            counted++;
+        }
+    }
+    h264_enc_destroy(enc);
+    source_free(&src);
+    *qp_avg = counted ? (double)qp_sum / counted : 0;
+    return (double)bits * FPS / (counted ? counted : 1);
+}
+
+static void test_rate_control(void)
+{
+    static const int targets[] = { 150000, 400000, 1000000 };
+    double last_qp = 99;
+
+    for (size_t t = 0; t < sizeof(targets) / sizeof(targets[0]); t++) {
+        double qp;
+        double rate = run_rate(targets[t], 30, &qp);
+        printf("target %4d kbps: %4.0f kbps (%+.1f%%), mean QP %.1f\n", targets[t] / 1000,
+               rate / 1000, (rate - targets[t]) * 100 / targets[t], qp);
+        CHECK(rate > targets[t] * 0.85 && rate < targets[t] * 1.15);
+        CHECK(qp < last_qp);
+        last_qp = qp;
+    }
+
+    // Constant QP leaves QP alone
+    double qp;
+    run_rate(0, 30, &qp);
+    CHECK(qp == 30);
+}
+
+static uint32_t be32(const uint8_t *p)
+{
+    return (uint32_t)p[0] << 24 | p[1] << 16 | p[2] << 8 | p[3];
+}
+
+/**
+ * @brief Offset of a box's first child, 0 if it has none
+ *
+ * stsd and dref are full boxes with an entry count before their entries;
+ * avc1 has the visual sample entry fields before avcC.
+ */
+static size_t children_at(const uint8_t *box)
+{
+    static const struct {
+        char type[5];
+        size_t offset;
+    } containers[] = {
+        { "moov", 8 }, { "trak", 8 }, { "mdia", 8 }, { "minf", 8 }, { "dinf", 8 },
+        { "stbl", 8 }, { "mvex", 8 }, { "moof", 8 }, { "traf", 8 },
+        { "stsd", 16 }, { "dref", 16 }, { "avc1", 86 },
+    };
+
+    for (size_t i = 0; i < sizeof(containers) / sizeof(containers[0]); i++) {
+        if (memcmp(box + 4, containers[i].type, 4) == 0) {
+            return containers[i].offset;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Walk the boxes in [p, end), recursing into containers
+ *
+ * @return false unless the boxes exactly tile the range at every level
+ */
+static bool boxes_ok(const uint8_t *p, const uint8_t *end, int depth)
+{
+    while (p < end) {
+        if (end - p < 8) {
+            return false;
+        }
+        uint32_t size = be32(p);
+        if (size < 8 || size > (size_t)(end - p)) {
+            return false;
+        }
+        size_t inner = children_at(p);
+        if (inner && (inner > size || !boxes_ok(p + inner, p + size, depth + 1))) {
+            return false;
+        }
+        p += size;
+    }
+    return depth < 8;
+}
+
+/**
+ * @brief The first box of a type, depth first, in [p, end)
+ */
+static const uint8_t *find_box(const uint8_t *p, const uint8_t *end, const char *type)
+{
+    while (end - p >= 8) {
+        uint32_t size = be32(p);
+        if (size < 8 || size > (size_t)(end - p)) {
+            return NULL;
+        }
+        if (memcmp(p + 4, type, 4) == 0) {
+            return p;
+        }
+        size_t inner = children_at(p);
+        const uint8_t *found = inner ? find_box(p + inner, p + size, type) : NULL;
+        if (found) {
+            return found;
+        }
+        p += size;
+    }
+    return NULL;
+}
+
+/**
+ * @brief Package a sequence as fMP4 and check every box
+ */
+static void test_mp4(void)
+{
+    const int gop = 8;
+    const uint32_t duration = H264_MP4_TIMESCALE / FPS;
+    source_t src;
+    h264_enc_t *enc = create(WIDTH, HEIGHT, gop, 300000, 30);
+    uint8_t init[1024];
+    size_t init_len = 0;
+
+    source_init(&src, WIDTH, HEIGHT, 20);
+    for (int n = 0; n < 20; n++) {
+        h264_frame_t frame;
+        CHECK(h264_enc_encode(enc, source_frame(&src, n), (int64_t)n * 1000000 / FPS,
+                              &frame) == ESP_OK);
+        h264_mp4_au_t au;
+        CHECK(h264_mp4_split_au(frame.data, frame.len, &au));
+        CHECK((au.sps != NULL) == frame.idr && (au.pps != NULL) == frame.idr);
+
+        if (n == 0) {
+            char codec[12];
+            h264_mp4_codec_string(&au, codec);
+            CHECK(strncmp(codec, "avc1.42c0", 9) == 0);
+
+            init_len = h264_mp4_init_segment(init, sizeof(init), WIDTH, HEIGHT, &au);
+            CHECK(init_len > 0);
+            CHECK(boxes_ok(init, init + init_len, 0));
+            CHECK(memcmp(init + 4, "ftyp", 4) == 0);
+            CHECK(find_box(init, init + init_len, "mvex") != NULL);
+            // avcC carries the parameter sets as sent in the IDR
+            const uint8_t *avcc = find_box(init, init + init_len, "avcC");
+            CHECK(avcc != NULL);
+            if (avcc) {
+                CHECK(avcc[8] == 1 && avcc[9] == 66 && (avcc[12] & 3) == 3);
+                CHECK((avcc[14] << 8 | avcc[15]) == (int)au.sps_len);
+                CHECK(memcmp(avcc + 16, au.sps, au.sps_len) == 0);
+                const uint8_t *pps = avcc + 16 + au.sps_len;
+                CHECK(pps[0] == 1 && (pps[1] << 8 | pps[2]) == (int)au.pps_len);
+                CHECK(memcmp(pps + 3, au.pps, au.pps_len) == 0);
+            }
+            // Too small a buffer is refused, not overrun
+            CHECK(h264_mp4_init_segment(init, init_len - 1, WIDTH, HEIGHT, &au) == 0);
+        }
+
+        // The sample: length-prefixed NAL units filling it exactly
+        size_t pos = 0;
+        int units = 0;
+        while (pos + 4 <= au.sample_len) {
+            uint32_t len = be32(au.sample + pos);
+            CHECK(len > 0 && pos + 4 + len <= au.sample_len);
+            int type = au.sample[pos + 4] & 0x1f;
+            CHECK(type == (frame.idr ? 5 : 1));
+            pos += 4 + len;
+            units++;
+        }
+        CHECK(pos == au.sample_len && units == 1);
+
+        uint8_t hdr[H264_MP4_FRAGMENT_HEADER_SIZE];
+        size_t hdr_len = h264_mp4_fragment_header(hdr, n + 1, (uint64_t)n * duration,
+                                                  duration, au.sample_len, frame.idr);
+        CHECK(hdr_len <= sizeof(hdr));
+        uint32_t moof_len = be32(hdr);
+        CHECK(memcmp(hdr + 4, "moof", 4) == 0 && moof_len + 8 == hdr_len);
+        CHECK(boxes_ok(hdr, hdr + moof_len, 0));
+        CHECK(memcmp(hdr + moof_len + 4, "mdat", 4) == 0);
+        CHECK(be32(hdr + moof_len) == 8 + au.sample_len);
+
+        const uint8_t *mfhd = find_box(hdr, hdr + moof_len, "mfhd");
+        const uint8_t *tfdt = find_box(hdr, hdr + moof_len, "tfdt");
+        const uint8_t *trun = find_box(hdr, hdr + moof_len, "trun");
+        CHECK(mfhd && tfdt && trun);
+        if (mfhd && tfdt && trun) {
+            CHECK(be32(mfhd + 12) == (uint32_t)n + 1);
+            CHECK(tfdt[8] == 1);                        // 64-bit decode time
+            CHECK(((uint64_t)be32(tfdt + 12) << 32 | be32(tfdt + 16)) ==
+                  (uint64_t)n * duration);
+            CHECK(be32(trun + 12) == 1);                // sample_count
+            CHECK(be32(trun + 16) == hdr_len);          // data_offset: past mdat's header
+            CHECK(be32(trun + 20) == duration);
+            CHECK(be32(trun + 24) == au.sample_len);
+            // sample_is_non_sync_sample only off IDR pictures
+            CHECK(((be32(trun + 28) >> 16) & 1) == !frame.idr);
+        }
+    }
+    h264_enc_destroy(enc);
+    source_free(&src);
+}
+
+/**
+ * @brief Encode speed and bitrate against MJPEG for the same frames
+ */
+static void bench_vs_mjpeg(void)
+{
+    source_t src;
+    h264_enc_t *enc = create(BENCH_WIDTH, BENCH_HEIGHT, 30, BENCH_BITRATE, 30);
+    int64_t h264_us = 0, jpeg_us = 0;
+    size_t h264_bytes = 0, jpeg_bytes = 0;
+
+    source_init(&src, BENCH_WIDTH, BENCH_HEIGHT, BENCH_FRAMES);
+    for (int n = 0; n < BENCH_FRAMES; n++) {
+        const uint8_t *yuyv = source_frame(&src, n);
+        h264_frame_t frame;
+        int64_t start = host_time_us();
+        CHECK(h264_enc_encode(enc, yuyv, (int64_t)n * 1000000 / FPS, &frame) == ESP_OK);
+        h264_us += host_time_us() - start;
+        h264_bytes += frame.len;
+
+        host_buf_t jpeg = { 0 };
+        start = host_time_us();
+        CHECK(host_jpeg_encode(yuyv, BENCH_WIDTH, BENCH_HEIGHT, BENCH_QUALITY, &jpeg) == ESP_OK);
+        jpeg_us += host_time_us() - start;
+        jpeg_bytes += jpeg.len;
+        host_buf_free(&jpeg);
+    }
+    h264_enc_destroy(enc);
+    source_free(&src);
+
+    printf("%dx%d at %d fps, %d frames:\n", BENCH_WIDTH, BENCH_HEIGHT, FPS, BENCH_FRAMES);
+    printf("  H.264 %4d kbps target: %6.1f fps encode, %5.0f kbps\n", BENCH_BITRATE / 1000,
+           h264_us ? BENCH_FRAMES * 1e6 / h264_us : 0.0,
+           (double)h264_bytes * 8 * FPS / BENCH_FRAMES / 1000);
+    printf("  MJPEG quality %d:    %6.1f fps encode, %5.0f kbps\n", BENCH_QUALITY,
+           jpeg_us ? BENCH_FRAMES * 1e6 / jpeg_us : 0.0,
+           (double)jpeg_bytes * 8 * FPS / BENCH_FRAMES / 1000);
+}
+
+int main(void)
+{
+    test_invalid_config();
+    test_nal_types();
+    test_sps(WIDTH, HEIGHT);
+    test_sps(800, 600);                 // 600 rows: 38 MB rows, cropped by 8
+    test_rate_control();
+    test_mp4();
+    bench_vs_mjpeg();
+    return host_test_result("h264_enc");
+}
@@ -0,0 +1,219 @@
+/**
+ * @file test_heap_monitor.c
+ * @brief Heap fragmentation monitor on a scripted heap
+ *
+ * The heap summary, the failed-allocation hook and the heap trace are
+ * stubbed here; the sampler task runs one period per sample() call. Checks
+ * the history order, the worst values since boot, the failure ring and
+ * the grouping of traced allocations by call stack.
+ */
+
+#include "host_test.h"
+#include "diag/heap_monitor.h"
+#include "esp_heap_caps.h"
+#include "esp_heap_trace.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include <string.h>
+
+#define PSRAM_FREE      8000000
+#define TRACE_RECORDS   40
+
+static multi_heap_info_t s_heap[HEAP_MON_COUNT];
+static esp_alloc_failed_hook_t s_failed_hook;
+static heap_trace_record_t s_trace[TRACE_RECORDS];
+static SemaphoreHandle_t s_tick;
+static SemaphoreHandle_t s_parked;
+
+static heap_mon_cap_t cap_of(uint32_t caps)
+{
+    return caps & MALLOC_CAP_SPIRAM ? HEAP_MON_PSRAM :
+           caps & MALLOC_CAP_DMA ? HEAP_MON_DMA : HEAP_MON_INTERNAL;
+}
+
+void heap_caps_get_info(multi_heap_info_t *info, uint32_t caps)
+{
+    *info = s_heap[cap_of(caps)];
+}
+
+esp_err_t heap_caps_register_failed_alloc_callback(esp_alloc_failed_hook_t callback)
+{
+    s_failed_hook = callback;
+    return ESP_OK;
+}
+
+esp_err_t heap_trace_init_standalone(heap_trace_record_t *records, size_t num_records)
+{
+    return ESP_OK;
+}
+
+esp_err_t heap_trace_start(heap_trace_mode_t mode)
+{
+    return ESP_OK;
+}
+
+esp_err_t heap_trace_summary(heap_trace_summary_t *summary)
+{
+    memset(summary, 0, sizeof(*summary));
+    summary->count = TRACE_RECORDS;
+    summary->capacity = CONFIG_GROWPOD_HEAP_SITES_RECORDS;
+    return ESP_OK;
+}
+
+esp_err_t heap_trace_get(size_t index, heap_trace_record_t *record)
+{
+    *record = s_trace[index];
+    return ESP_OK;
+}
+
+/**
+ * @brief The sampler's period: park until the test asks for a sample
+ */
+void vTaskDelayUntil(TickType_t *wake, TickType_t ticks)
+{
+    xSemaphoreGive(s_parked);
+    xSemaphoreTake(s_tick, portMAX_DELAY);
+}
+
+static void sample(void)
+{
+    xSemaphoreGive(s_tick);
+    xSemaphoreTake(s_parked, portMAX_DELAY);
+}
+
+static void set_heap(heap_mon_cap_t cap, size_t free, size_t largest)
+{
+    s_heap[cap].total_free_bytes = free;
+    s_heap[cap].largest_free_block = largest;
+    s_heap[cap].minimum_free_bytes = free / 2;
+    s_heap[cap].allocated_blocks = 400;
+    s_heap[cap].free_blocks = 30;
+}
+
+static void test_samples(void)
+{
+    heap_mon_stats_t st;
+    heap_mon_point_t points[HEAP_MONITOR_HISTORY];
+
+    // The first sample is taken by init; then 70 periods, with the PSRAM
+    // largest block dropping below a QXGA frame buffer for 20 of them
+    for (int t = 0; t < 70; t++) {
+        if (t == 30) {
+            set_heap(HEAP_MON_PSRAM, PSRAM_FREE, 500000);
+        } else if (t == 50) {
+            set_heap(HEAP_MON_PSRAM, PSRAM_FREE, 3000000);
+        }
+        sample();
+    }
+
+    heap_monitor_get_stats(HEAP_MON_PSRAM, &st);
+    CHECK(st.free == PSRAM_FREE && st.largest == 3000000);
+    CHECK(st.frag_permille == 625);
+    CHECK(st.frag_max_permille == 938);
+    CHECK(st.largest_min == 500000);
+    CHECK(st.min_free == PSRAM_FREE / 2 && st.blocks == 400 && st.free_blocks == 30);
+    heap_monitor_get_stats(HEAP_MON_INTERNAL, &st);
+    CHECK(st.free == 200000 && st.largest_min == 110000);
+
+    // The newest 60 of 71 samples, oldest first
+    CHECK(heap_monitor_get_history(HEAP_MON_PSRAM, points, HEAP_MONITOR_HISTORY) ==
+          HEAP_MONITOR_HISTORY);
+    CHECK(points[0].largest == 4000000 && points[19].largest == 4000000);
+    CHECK(points[20].largest == 500000 && points[39].largest == 500000);
+    CHECK(points[40].largest == 3000000 && points[59].largest == 3000000);
+    CHECK(heap_monitor_get_history(HEAP_MON_PSRAM, points, 5) == 5);
+    CHECK(points[0].largest == 3000000);
+    CHECK(heap_monitor_get_history(HEAP_MON_DMA, points, 1) == 1 && points[0].free == 180000);
+}
+
+static void test_failures(void)
+{
+    heap_mon_failure_t failure;
+
+    CHECK(s_failed_hook != NULL);
+    CHECK(!heap_monitor_get_failure(0, &failure));
+    for (int i = 0; i < 10; i++) {
+        s_failed_hook(HEAP_MONITOR_STILL_FB_BYTES + i, MALLOC_CAP_SPIRAM, "heap_caps_malloc");
+    }
+    CHECK(heap_monitor_failures() == 10);
+
+    // The ring keeps the newest 8, newest first
+    CHECK(heap_monitor_get_failure(0, &failure));
+    CHECK(failure.size == HEAP_MONITOR_STILL_FB_BYTES + 9 && failure.caps == MALLOC_CAP_SPIRAM);
+    CHECK(heap_monitor_get_failure(HEAP_MONITOR_FAILURES - 1, &failure));
+    CHECK(failure.size == HEAP_MONITOR_STILL_FB_BYTES + 2);
+    CHECK(!heap_monitor_get_failure(HEAP_MONITOR_FAILURES, &failure));
+    CHECK(!heap_monitor_get_failure(-1, &failure));
+}
+
+static void test_sites(void)
+{
+    heap_mon_site_t sites[HEAP_MONITOR_SITES];
+    heap_mon_trace_t trace;
+    uint32_t count = 0, bytes = 0, psram = 0;
+
+    // 40 live allocations from 25 stacks: 5 shared by 4 records, 20 single
+    for (int i = 0; i < TRACE_RECORDS; i++) {
+        s_trace[i].size = 100 + i;
+        s_trace[i].address = (void *)(uintptr_t)(i % 2 ? 0x3c100000 : 0x3fc90000);
+        s_trace[i].alloced_by[0] = (void *)(uintptr_t)(0x42000000 + (i < 20 ? i % 5 : i));
+        s_trace[i].alloced_by[1] = (void *)(uintptr_t)0x42001234;
+    }
+
+    int n = heap_monitor_get_sites(sites, HEAP_MONITOR_SITES, &trace);
+    CHECK(n == HEAP_MONITOR_SITES);
+    CHECK(trace.records == TRACE_RECORDS && trace.capacity == CONFIG_GROWPOD_HEAP_SITES_RECORDS);
+    CHECK(!trace.overflowed);
+    for (int i = 0; i < n; i++) {
+        count += sites[i].count;
+        bytes += sites[i].bytes;
+        psram += sites[i].psram_bytes;
+        if (i > 0) {
+            CHECK(sites[i].bytes <= sites[i - 1].bytes);
+        }
+    }
+    CHECK(count == TRACE_RECORDS);
+    CHECK(bytes == TRACE_RECORDS * 100 + TRACE_RECORDS * (TRACE_RECORDS - 1) / 2);
+    CHECK(psram == 2400);                       // The odd-numbered records
+
+    // Most bytes first: 104 + 109 + 114 + 119
+    CHECK(sites[0].count == 4 && sites[0].bytes == 446);
+    CHECK(sites[0].callers[0] == 0x42000004 && sites[0].callers[1] == 0x42001234);
+
+    // The last two stacks share the overflow slot, which has no stack
+    bool shared = false;
+    for (int i = 0; i < n; i++) {
+        if (sites[i].callers[0] == 0) {
+            shared = sites[i].count == 2 && sites[i].bytes == 138 + 139;
+        }
+    }
+    CHECK(shared);
+
+    n = heap_monitor_get_sites(sites, 3, &trace);
+    count = 0;
+    for (int i = 0; i < n; i++) {
+        count += sites[i].count;
+    }
+    CHECK(n == 3 && count == TRACE_RECORDS);
+    CHECK(heap_monitor_get_sites(sites, 0, &trace) == 0);
+}
+
+int main(void)
+{
+    s_tick = xSemaphoreCreateBinary();
+    s_parked = xSemaphoreCreateBinary();
+    set_heap(HEAP_MON_INTERNAL, 200000, 110000);
+    set_heap(HEAP_MON_DMA, 180000, 100000);
+    set_heap(HEAP_MON_PSRAM, PSRAM_FREE, 4000000);
+
+    CHECK(heap_monitor_init() == ESP_OK);
+    xSemaphoreTake(s_parked, portMAX_DELAY);
+    CHECK(strcmp(heap_monitor_cap_name(HEAP_MON_PSRAM), "psram") == 0);
+    CHECK(strcmp(heap_monitor_cap_name(HEAP_MON_COUNT), "unknown") == 0);
+
+    test_samples();
+    test_failures();
+    test_sites();
+    return host_test_result("heap_monitor");
+}
@@ -0,0 +1,258 @@
+/**
+ * @file test_html_template.c
+ * @brief Streaming HTML templates: substitution, chunking and overflow
+ *
+ * Chunks are collected as httpd_resp_send_chunk() would send them. Checks
+ * slot substitution in every position, unknown and over-long slot names,
+ * unterminated braces, coalescing of short pieces and zero-copy sends of
+ * long static text, slot output that fits only after a flush and output
+ * that does not fit at all, and that send errors stop the render.
+ */
+
+#include "host_test.h"
+#include "web_server/html_template.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_CHUNKS  64
+
+static char s_out[8192];
+static size_t s_out_len;
+static int s_chunks;                    // Data chunks, not counting the final empty one
+static size_t s_chunk_len[MAX_CHUNKS];
+static const char *s_chunk_ptr[MAX_CHUNKS];
+static bool s_finished;
+static int s_fail_at = -1;              // Chunk call that fails, -1 for none
+static int s_calls;
+
+esp_err_t httpd_resp_send_chunk(httpd_req_t *r, const char *buf, ssize_t buf_len)
+{
+    CHECK(!s_finished);
+    if (s_calls++ == s_fail_at) {
+        return ESP_FAIL;
+    }
+    if (buf == NULL || buf_len == 0) {
+        s_finished = true;
+        return ESP_OK;
+    }
+    CHECK(s_out_len + buf_len < sizeof(s_out) && s_chunks < MAX_CHUNKS);
+    memcpy(s_out + s_out_len, buf, buf_len);
+    s_out_len += buf_len;
+    s_chunk_len[s_chunks] = buf_len;
+    s_chunk_ptr[s_chunks] = buf;
+    s_chunks++;
+    return ESP_OK;
+}
+
+static void reset(void)
+{
+    s_out_len = 0;
+    s_out[0] = '\0';
+    s_chunks = 0;
+    s_finished = false;
+    s_fail_at = -1;
+    s_calls = 0;
+}
+
+/**
+ * @brief Render and NUL-terminate what was sent
+ */
+static esp_err_t render(const char *tmpl, html_tmpl_fill_t fill, void *ctx)
+{
+    httpd_req_t req = { 0 };
+
+    reset();
+    esp_err_t err = html_tmpl_send(&req, tmpl, fill, ctx);
+    s_out[s_out_len] = '\0';
+    return err;
+}
+
+typedef struct {
+    int calls;
+    char last[HTML_TMPL_SLOT_MAX + 2];
+} fill_log_t;
+
+static esp_err_t fill_values(html_tmpl_t *out, const char *slot, void *ctx)
+{
+    fill_log_t *log = ctx;
+
+    log->calls++;
+    snprintf(log->last, sizeof(log->last), "%s", slot);
+    if (strcmp(slot, "mode") == 0) {
+        html_tmpl_printf(out, "%s", "stream");
+    } else if (strcmp(slot, "captures") == 0) {
+        html_tmpl_printf(out, "%d", 42);
+    } else if (strcmp(slot, "empty") == 0) {
+        // Known, prints nothing
+    } else if (strcmp(slot, "abcdefghijklmnopqrstuvw") == 0) {
+        html_tmpl_printf(out, "max");
+    } else {
+        return ESP_ERR_NOT_FOUND;
+    }
+    return ESP_OK;
+}
+
+static void test_substitution(void)
+{
+    fill_log_t log = { 0 };
+
+    CHECK(render("<p>Mode: {{mode}}, {{captures}} captures</p>", fill_values, &log) == ESP_OK);
+    CHECK(strcmp(s_out, "<p>Mode: stream, 42 captures</p>") == 0);
+    CHECK(log.calls == 2);
+    // Short page: one coalesced chunk, then the terminator
+    CHECK(s_chunks == 1 && s_finished);
+
+    // Slots at either end, back to back, and printing nothing
+    CHECK(render("{{mode}}{{captures}}{{empty}}|{{captures}}", fill_values, &log) == ESP_OK);
+    CHECK(strcmp(s_out, "stream42|42") == 0);
+
+    // No slots, and nothing at all
+    CHECK(render("<html></html>", fill_values, &log) == ESP_OK);
+    CHECK(strcmp(s_out, "<html></html>") == 0);
+    CHECK(render("", fill_values, &log) == ESP_OK);
+    CHECK(s_out_len == 0 && s_chunks == 0 && s_finished);
+
+    // Single braces and JS objects are just text
+    CHECK(render("var p = {a: 1}; {{mode}} }", fill_values, &log) == ESP_OK);
+    CHECK(strcmp(s_out, "var p = {a: 1}; stream }") == 0);
+}
+
+static void test_unknown(void)
+{
+    fill_log_t log = { 0 };
+
+    // Unknown: left empty, the rest renders
+    CHECK(render("a{{nope}}b{{mode}}c", fill_values, &log) == ESP_OK);
+    CHECK(strcmp(s_out, "abstreamc") == 0);
+    CHECK(log.calls == 2);
+
+    // The longest name is looked up; one more and it is not even asked for
+    log = (fill_log_t){ 0 };
+    CHECK(render("[{{abcdefghijklmnopqrstuvw}}]", fill_values, &log) == ESP_OK);
+    CHECK(strcmp(s_out, "[max]") == 0 && log.calls == 1);
+    log = (fill_log_t){ 0 };
+    CHECK(render("[{{abcdefghijklmnopqrstuvwx}}]{{mode}}", fill_values, &log) == ESP_OK);
+    CHECK(strcmp(s_out, "[]stream") == 0 && log.calls == 1);
+    CHECK(strcmp(log.last, "mode") == 0);
+
+    // Unterminated: the rest goes out as text
+    log = (fill_log_t){ 0 };
+    CHECK(render("{{mode}} and {{mode", fill_values, &log) == ESP_OK);
+    CHECK(strcmp(s_out, "stream and {{mode") == 0 && log.calls == 1);
+
+    // An empty name is a slot like any other
+    log = (fill_log_t){ 0 };
+    CHECK(render("<{{}}>", fill_values, &log) == ESP_OK);
+    CHECK(strcmp(s_out, "<>") == 0 && log.calls == 1 && log.last[0] == '\0');
+}
+
+static esp_err_t fill_sized(html_tmpl_t *out, const char *slot, void *ctx)
+{
+    int len = atoi(slot);
+    char *text = malloc(len + 1);
+
+    memset(text, 'x', len);
+    text[len] = '\0';
+    html_tmpl_printf(out, "%s", text);
+    free(text);
+    return ESP_OK;
+}
+
+static esp_err_t fill_pieces(html_tmpl_t *out, const char *slot, void *ctx)
+{
+    // Many short prints, as the settings page's parameter object does
+    for (int i = 0; i < 100; i++) {
+        html_tmpl_printf(out, "\"p%d\":%d,", i, i * 7);
+    }
+    return ESP_OK;
+}
+
+static void test_chunking(void)
+{
+    char tmpl[1024], big[600];
+
+    // Long static text goes out in place, not copied
+    memset(big, 'a', sizeof(big) - 1);
+    big[sizeof(big) - 1] = '\0';
+    snprintf(tmpl, sizeof(tmpl), "hi{{3}}%s{{2}}", big);
+    CHECK(render(tmpl, fill_sized, NULL) == ESP_OK);
+    CHECK(s_out_len == 2 + 3 + 599 + 2);
+    CHECK(s_chunks == 3);
+    CHECK(s_chunk_len[0] == 5 && s_chunk_len[1] == 599 && s_chunk_len[2] == 2);
+    CHECK(s_chunk_ptr[1] == tmpl + 7);
+
+    // Text up to the full buffer is still coalesced
+    memset(big, 'b', HTML_TMPL_BUF_SIZE);
+    big[HTML_TMPL_BUF_SIZE] = '\0';
+    CHECK(render(big, fill_sized, NULL) == ESP_OK);
+    CHECK(s_chunks == 1 && s_chunk_ptr[0] != big && s_out_len == HTML_TMPL_BUF_SIZE);
+
+    // Many short prints add up to several full chunks, nothing lost
+    CHECK(render("{{x}}", fill_pieces, NULL) == ESP_OK);
+    char expect[2048];
+    size_t n = 0;
+    for (int i = 0; i < 100; i++) {
+        n += snprintf(expect + n, sizeof(expect) - n, "\"p%d\":%d,", i, i * 7);
+    }
+    CHECK(s_out_len == n && memcmp(s_out, expect, n) == 0);
+    // Each chunk but the last is full to within one print
+    for (int i = 0; i < s_chunks; i++) {
+        CHECK(s_chunk_len[i] <= HTML_TMPL_BUF_SIZE);
+        CHECK(i == s_chunks - 1 || s_chunk_len[i] > HTML_TMPL_BUF_SIZE - 12);
+    }
+}
+
+static void test_overflow(void)
+{
+    char tmpl[512];
+
+    // Fits only once what is buffered has been flushed
+    memset(tmpl, 's', 200);
+    strcpy(tmpl + 200, "{{100}}end");
+    CHECK(render(tmpl, fill_sized, NULL) == ESP_OK);
+    CHECK(s_out_len == 303 && s_chunks == 2);
+    CHECK(s_chunk_len[0] == 200 && memcmp(s_out + 300, "end", 3) == 0);
+
+    // The most one print can hold: the buffer less the terminator
+    CHECK(render("<{{255}}>", fill_sized, NULL) == ESP_OK);
+    CHECK(s_out_len == 257);
+
+    // Too long for any buffer: the render stops with an error, and the
+    // response is left unterminated so the client sees it fail
+    CHECK(render("<{{256}}>", fill_sized, NULL) == ESP_ERR_INVALID_SIZE);
+    CHECK(s_out_len == 1 && s_out[0] == '<' && !s_finished);
+    CHECK(render("head {{1000}} tail {{3}}", fill_sized, NULL) == ESP_ERR_INVALID_SIZE);
+    CHECK(strcmp(s_out, "head ") == 0 && !s_finished);
+}
+
+static void test_send_error(void)
+{
+    char tmpl[1024];
+    httpd_req_t req = { 0 };
+
+    // Fails on the second chunk: nothing is sent after it
+    memset(tmpl, 'a', 300);
+    strcpy(tmpl + 300, "{{10}}");
+    memset(tmpl + 306, 'b', 300);
+    tmpl[606] = '\0';
+    for (int fail_at = 0; fail_at < 4; fail_at++) {
+        reset();
+        s_fail_at = fail_at;
+        esp_err_t err = html_tmpl_send(&req, tmpl, fill_sized, NULL);
+        // Chunks: 300 a's in place, the slot, 300 b's in place, terminator
+        CHECK(err == ESP_FAIL);
+        CHECK(s_calls == fail_at + 1);
+        CHECK(s_chunks == fail_at);
+        CHECK(!s_finished);
+    }
+}
+
+int main(void)
+{
+    test_substitution();
+    test_unknown();
+    test_chunking();
+    test_overflow();
+    test_send_error();
+    return host_test_result("test_html_template");
+}
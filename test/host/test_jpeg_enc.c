@@ -0,0 +1,244 @@
+/**
+ * @file test_jpeg_enc.c
+ * @brief Stripe-based baseline JPEG encoder
+ *
+ * Checks argument and row-count errors, that output does not depend on how
+ * rows are fed, and that a failing output callback aborts the encode. With
+ * libjpeg, the output is decoded and compared with libjpeg's own 4:2:2
+ * IFAST encoding at the same quality: size and PSNR per channel. Prints
+ * the QXGA encode throughput.
+ */
+
+#include "host_test.h"
+#include "host_jpeg.h"
+#include "jpeg/jpeg_enc.h"
+#include <stdlib.h>
+#include <string.h>
+
+#if HOST_HAVE_LIBJPEG
+#include <stdio.h>
+#include <jpeglib.h>
+#endif
+
+#define BENCH_WIDTH     2048
+#define BENCH_HEIGHT    1536
+#define BENCH_RUNS      5
+
+static const int s_sizes[][2] = { { 38, 21 }, { 320, 240 }, { 1600, 1200 } };
+#if HOST_HAVE_LIBJPEG
+static const int s_qualities[] = { 50, 80, 90 };
+#endif
+
+static esp_err_t failing_output(const uint8_t *data, size_t len, void *ctx)
+{
+    size_t *budget = ctx;
+    if (len > *budget) {
+        return ESP_FAIL;
+    }
+    *budget -= len;
+    return ESP_OK;
+}
+
+static esp_err_t null_output(const uint8_t *data, size_t len, void *ctx)
+{
+    return ESP_OK;
+}
+
+static void test_errors(void)
+{
+    jpeg_enc_t *enc;
+    jpeg_enc_config_t config = { 64, 16, 80, JPEG_QTABLE_ANNEX_K, null_output, NULL };
+
+    config.width = 63;
+    CHECK(jpeg_enc_begin(&config, &enc) == ESP_ERR_INVALID_ARG);
+    config.width = 64;
+    config.height = 0;
+    CHECK(jpeg_enc_begin(&config, &enc) == ESP_ERR_INVALID_ARG);
+    config.height = 16;
+    config.output = NULL;
+    CHECK(jpeg_enc_begin(&config, &enc) == ESP_ERR_INVALID_ARG);
+    config.output = null_output;
+
+    uint8_t *frame = host_scene_yuyv(64, 16, 0);
+
+    // More rows than the image has, then too few at the end
+    CHECK(jpeg_enc_begin(&config, &enc) == ESP_OK);
+    CHECK(jpeg_enc_write_rows(enc, frame, 17) == ESP_ERR_INVALID_SIZE);
+    CHECK(jpeg_enc_write_rows(enc, frame, 15) == ESP_OK);
+    CHECK(jpeg_enc_end(enc) == ESP_ERR_INVALID_SIZE);
+
+    free(frame);
+
+    // The callback's error ends the encode, whether the first or the last
+    // piece of output fails
+    frame = host_scene_yuyv(320, 240, 0);
+    host_buf_t full = { 0 };
+    CHECK(host_jpeg_encode(frame, 320, 240, 80, &full) == ESP_OK);
+    const size_t budgets[] = { 0, full.len / 2, full.len - 1 };
+    config = (jpeg_enc_config_t){ 320, 240, 80, JPEG_QTABLE_ANNEX_K, failing_output, NULL };
+    for (int i = 0; i < 3; i++) {
+        size_t budget = budgets[i];
+        config.ctx = &budget;
+        esp_err_t err = jpeg_enc_begin(&config, &enc);
+        if (err == ESP_OK) {
+            err = jpeg_enc_write_rows(enc, frame, 240);
+            if (err == ESP_OK) {
+                err = jpeg_enc_end(enc);
+            } else {
+                jpeg_enc_abort(enc);
+            }
+        }
+        CHECK(err == ESP_FAIL);
+    }
+    host_buf_free(&full);
+    free(frame);
+}
+
+static void test_row_feeding(int width, int height)
+{
+    uint8_t *frame = host_scene_yuyv(width, height, 1);
+    host_buf_t whole = { 0 };
+    host_buf_t fed = { 0 };
+    jpeg_enc_config_t config = { width, height, 80, JPEG_QTABLE_ANNEX_K, host_buf_output, &fed };
+    jpeg_enc_t *enc;
+
+    CHECK(host_jpeg_encode(frame, width, height, 80, &whole) == ESP_OK);
+    CHECK(whole.len > 4 && whole.data[0] == 0xff && whole.data[1] == 0xd8);
+    CHECK(whole.data[whole.len - 2] == 0xff && whole.data[whole.len - 1] == 0xd9);
+
+    // Ragged chunks: partial stripes, whole stripes, and both in one call
+    CHECK(jpeg_enc_begin(&config, &enc) == ESP_OK);
+    static const int chunks[] = { 1, 3, 8, 5, 13, 2, 16, 7 };
+    int row = 0;
+    for (int i = 0; row < height; i = (i + 1) % 8) {
+        int n = chunks[i] < height - row ? chunks[i] : height - row;
+        CHECK(jpeg_enc_write_rows(enc, frame + (size_t)row * width * 2, n) == ESP_OK);
+        row += n;
+    }
+    CHECK(jpeg_enc_end(enc) == ESP_OK);
+    CHECK(fed.len == whole.len && memcmp(fed.data, whole.data, whole.len) == 0);
+
+    host_buf_free(&fed);
+    host_buf_free(&whole);
+    free(frame);
+}
+
+#if HOST_HAVE_LIBJPEG
+/**
+ * @brief Encode the same frame with libjpeg: 4:2:2, IFAST DCT, Annex K tables
+ */
+static void libjpeg_encode(const uint8_t *yuyv, int width, int height, int quality,
+                           uint8_t **out, unsigned long *out_len)
+{
+    struct jpeg_compress_struct cinfo;
+    struct jpeg_error_mgr jerr;
+
+    cinfo.err = jpeg_std_error(&jerr);
+    jpeg_create_compress(&cinfo);
+    *out = NULL;
+    jpeg_mem_dest(&cinfo, out, out_len);
+    cinfo.image_width = width;
+    cinfo.image_height = height;
+    cinfo.input_components = 3;
+    cinfo.in_color_space = JCS_YCbCr;
+    jpeg_set_defaults(&cinfo);
+    jpeg_set_quality(&cinfo, quality, TRUE);
+    cinfo.dct_method = JDCT_IFAST;
+    cinfo.comp_info[0].h_samp_factor = 2;
+    cinfo.comp_info[0].v_samp_factor = 1;
+    jpeg_start_compress(&cinfo, TRUE);
+
+    // Chroma repeated at both pixels of a pair downsamples back unchanged
+    uint8_t *row = malloc((size_t)width * 3);
+    while (cinfo.next_scanline < cinfo.image_height) {
+        const uint8_t *src = yuyv + (size_t)cinfo.next_scanline * width * 2;
+        for (int x = 0; x < width; x++) {
+            row[x * 3] = src[x * 2];
+            row[x * 3 + 1] = src[(x & ~1) * 2 + 1];
+            row[x * 3 + 2] = src[(x & ~1) * 2 + 3];
+        }
+        JSAMPROW rows[1] = { row };
+        jpeg_write_scanlines(&cinfo, rows, 1);
+    }
+    free(row);
+    jpeg_finish_compress(&cinfo);
+    jpeg_destroy_compress(&cinfo);
+}
+
+static void test_against_libjpeg(int width, int height, int quality)
+{
+    uint8_t *frame = host_scene_yuyv(width, height, 2);
+    host_buf_t ours = { 0 };
+    uint8_t *ref = NULL;
+    unsigned long ref_len = 0;
+    int w = 0, h = 0;
+
+    CHECK(host_jpeg_encode(frame, width, height, quality, &ours) == ESP_OK);
+    libjpeg_encode(frame, width, height, quality, &ref, &ref_len);
+
+    uint8_t *ours_ycc = host_jpeg_decode(ours.data, ours.len, &w, &h);
+    CHECK(ours_ycc != NULL && w == width && h == height);
+    uint8_t *ref_ycc = host_jpeg_decode(ref, ref_len, &w, &h);
+    CHECK(ref_ycc != NULL);
+    if (ours_ycc == NULL || ref_ycc == NULL) {
+        free(ours_ycc);
+        free(ref_ycc);
+        free(ref);
+        host_buf_free(&ours);
+        free(frame);
+        return;
+    }
+
+    printf("%4dx%-4d q%d: %7zu bytes (libjpeg %7lu), PSNR", width, height, quality,
+           ours.len, ref_len);
+    for (int c = 0; c < 3; c++) {
+        double p = host_psnr(ours_ycc, frame, width, height, c);
+        double p_ref = host_psnr(ref_ycc, frame, width, height, c);
+        printf(" %.2f (%.2f)", p, p_ref);
+        CHECK(p > p_ref - 0.5);
+        CHECK(c != 0 || p > 30);
+    }
+    printf(" dB\n");
+    CHECK(ours.len * 100 < ref_len * 105 && ours.len * 100 > ref_len * 95);
+
+    free(ref_ycc);
+    free(ours_ycc);
+    free(ref);
+    host_buf_free(&ours);
+    free(frame);
+}
+#endif
+
+static void bench_encode(void)
+{
+    uint8_t *frame = host_scene_yuyv(BENCH_WIDTH, BENCH_HEIGHT, 0);
+    host_buf_t out = { 0 };
+
+    int64_t start = host_time_us();
+    for (int i = 0; i < BENCH_RUNS; i++) {
+        out.len = 0;
+        CHECK(host_jpeg_encode(frame, BENCH_WIDTH, BENCH_HEIGHT, 80, &out) == ESP_OK);
+    }
+    int64_t elapsed = host_time_us() - start;
+    double mpix = (double)BENCH_WIDTH * BENCH_HEIGHT * BENCH_RUNS / 1e6;
+    printf("encode %dx%d q80: %zu bytes, %.1f MP/s\n", BENCH_WIDTH, BENCH_HEIGHT, out.len,
+           elapsed ? mpix * 1e6 / elapsed : 0.0);
+
+    host_buf_free(&out);
+    free(frame);
+}
+
+int main(void)
+{
+    test_errors();
+    for (size_t s = 0; s < sizeof(s_sizes) / sizeof(s_sizes[0]); s++) {
+        test_row_feeding(s_sizes[s][0], s_sizes[s][1]);
+#if HOST_HAVE_LIBJPEG
+        for (size_t q = 0; q < sizeof(s_qualities) / sizeof(s_qualities[0]); q++) {
+            test_against_libjpeg(s_sizes[s][0], s_sizes[s][1], s_qualities[q]);
+        }
+#endif
+    }
+    bench_encode();
+    return host_test_result("jpeg_enc");
+}
@@ -0,0 +1,259 @@
+/**
+ * @file test_jpeg_optimize.c
+ * @brief Lossless Huffman re-optimization
+ *
+ * Optimizes the encoder's output and checks that the scan decodes to the
+ * same coefficients, that the file got smaller, and, with libjpeg, that it
+ * decodes to the same pixels. libjpeg output with restart markers is
+ * optimized too, and compared with libjpeg's own optimize_coding. DHT
+ * segments with more codes than a length allows must be rejected, and
+ * truncated or damaged files handled cleanly. Prints the savings and
+ * timing.
+ */
+
+#include "host_test.h"
+#include "host_jpeg.h"
+#include "jpeg/jpeg_optimize.h"
+#include "jpeg/jpeg_scan.h"
+#include <stdlib.h>
+#include <string.h>
+
+#if HOST_HAVE_LIBJPEG
+#include <stdio.h>
+#include <jpeglib.h>
+#endif
+
+#define FUZZ_RUNS       300
+
+static bool same_coefs(const uint8_t *a, size_t a_len, const uint8_t *b, size_t b_len)
+{
+    int16_t *ca = NULL, *cb = NULL;
+    size_t na = 0, nb = 0;
+    bool same = host_jpeg_coefs(a, a_len, &ca, &na) == ESP_OK &&
+                host_jpeg_coefs(b, b_len, &cb, &nb) == ESP_OK &&
+                na == nb && memcmp(ca, cb, na * 64 * sizeof(int16_t)) == 0;
+    free(cb);
+    free(ca);
+    return same;
+}
+
+#if HOST_HAVE_LIBJPEG
+static bool same_pixels(const uint8_t *a, size_t a_len, const uint8_t *b, size_t b_len)
+{
+    int aw = 0, ah = 0, bw = 0, bh = 0;
+    uint8_t *pa = host_jpeg_decode(a, a_len, &aw, &ah);
+    uint8_t *pb = host_jpeg_decode(b, b_len, &bw, &bh);
+    bool same = pa && pb && aw == bw && ah == bh && memcmp(pa, pb, (size_t)aw * ah * 3) == 0;
+    free(pb);
+    free(pa);
+    return same;
+}
+#endif
+
+static void check_optimized(const char *label, const uint8_t *jpeg, size_t len)
+{
+    host_buf_t out = { 0 };
+    jpeg_optimize_stats_t stats;
+
+    CHECK(jpeg_optimize(jpeg, len, host_buf_output, &out, &stats) == ESP_OK);
+    CHECK(stats.out_len == out.len && stats.in_len <= len);
+    CHECK(out.len < len);
+    CHECK(same_coefs(jpeg, len, out.data, out.len));
+#if HOST_HAVE_LIBJPEG
+    CHECK(same_pixels(jpeg, len, out.data, out.len));
+#endif
+    printf("%-22s %7zu -> %7zu bytes (%4.1f%% saved), %u + %u us\n", label, len, out.len,
+           100.0 * (len - out.len) / len, (unsigned)stats.count_us, (unsigned)stats.encode_us);
+
+    // Already optimal: a second pass cannot do better
+    host_buf_t again = { 0 };
+    CHECK(jpeg_optimize(out.data, out.len, host_buf_output, &again, NULL) == ESP_OK);
+    CHECK(again.len <= out.len);
+
+    host_buf_free(&again);
+    host_buf_free(&out);
+}
+
+static void test_encoder_output(void)
+{
+    static const int sizes[][3] = { { 38, 21, 80 }, { 320, 240, 50 }, { 320, 240, 90 },
+                                    { 1600, 1200, 80 } };
+
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        uint8_t *frame = host_scene_yuyv(sizes[i][0], sizes[i][1], 0);
+        host_buf_t jpeg = { 0 };
+        char label[32];
+
+        CHECK(host_jpeg_encode(frame, sizes[i][0], sizes[i][1], sizes[i][2], &jpeg) == ESP_OK);
+        snprintf(label, sizeof(label), "jpeg_enc %dx%d q%d", sizes[i][0], sizes[i][1],
+                 sizes[i][2]);
+        check_optimized(label, jpeg.data, jpeg.len);
+
+        host_buf_free(&jpeg);
+        free(frame);
+    }
+}
+
+#if HOST_HAVE_LIBJPEG
+/**
+ * @brief Encode with libjpeg, 4:2:0 with restart markers every 4 MCUs
+ */
+static void libjpeg_encode(const uint8_t *yuyv, int width, int height, bool optimize,
+                           uint8_t **out, unsigned long *out_len)
+{
+    struct jpeg_compress_struct cinfo;
+    struct jpeg_error_mgr jerr;
+
+    cinfo.err = jpeg_std_error(&jerr);
+    jpeg_create_compress(&cinfo);
+    *out = NULL;
+    jpeg_mem_dest(&cinfo, out, out_len);
+    cinfo.image_width = width;
+    cinfo.image_height = height;
+    cinfo.input_components = 3;
+    cinfo.in_color_space = JCS_YCbCr;
+    jpeg_set_defaults(&cinfo);
+    jpeg_set_quality(&cinfo, 75, TRUE);
+    cinfo.restart_interval = 4;
+    cinfo.optimize_coding = optimize;
+    jpeg_start_compress(&cinfo, TRUE);
+
+    uint8_t *row = malloc((size_t)width * 3);
+    while (cinfo.next_scanline < cinfo.image_height) {
+        const uint8_t *src = yuyv + (size_t)cinfo.next_scanline * width * 2;
+        for (int x = 0; x < width; x++) {
+            row[x * 3] = src[x * 2];
+            row[x * 3 + 1] = src[(x & ~1) * 2 + 1];
+            row[x * 3 + 2] = src[(x & ~1) * 2 + 3];
+        }
+        JSAMPROW rows[1] = { row };
+        jpeg_write_scanlines(&cinfo, rows, 1);
+    }
+    free(row);
+    jpeg_finish_compress(&cinfo);
+    jpeg_destroy_compress(&cinfo);
+}
+
+static void test_libjpeg_output(void)
+{
+    uint8_t *frame = host_scene_yuyv(640, 480, 0);
+    uint8_t *plain = NULL, *optimal = NULL;
+    unsigned long plain_len = 0, optimal_len = 0;
+
+    libjpeg_encode(frame, 640, 480, false, &plain, &plain_len);
+    libjpeg_encode(frame, 640, 480, true, &optimal, &optimal_len);
+    check_optimized("libjpeg 640x480 DRI 4", plain, plain_len);
+
+    // Within 0.5% of libjpeg's own optimized tables
+    host_buf_t out = { 0 };
+    CHECK(jpeg_optimize(plain, plain_len, host_buf_output, &out, NULL) == ESP_OK);
+    printf("libjpeg optimize_coding: %lu bytes\n", optimal_len);
+    CHECK(out.len * 1000 <= optimal_len * 1005);
+
+    host_buf_free(&out);
+    free(optimal);
+    free(plain);
+    free(frame);
+}
+#endif
+
+/**
+ * @brief Find a table's 16 code counts in the DHT segment
+ */
+static uint8_t *find_dht_bits(uint8_t *jpeg, size_t len, uint8_t class_id)
+{
+    for (size_t i = 2; i + 4 < len; ) {
+        size_t seg = (size_t)(jpeg[i + 2] << 8 | jpeg[i + 3]);
+        if (jpeg[i + 1] == 0xda) {
+            break;
+        }
+        if (jpeg[i + 1] == 0xc4) {
+            for (size_t t = i + 4; t < i + 2 + seg; ) {
+                int count = 0;
+                for (int n = 0; n < 16; n++) {
+                    count += jpeg[t + 1 + n];
+                }
+                if (jpeg[t] == class_id) {
+                    return jpeg + t + 1;
+                }
+                t += 17 + count;
+            }
+        }
+        i += 2 + seg;
+    }
+    return NULL;
+}
+
+static void test_malformed(void)
+{
+    uint8_t *frame = host_scene_yuyv(320, 240, 0);
+    host_buf_t jpeg = { 0 };
+    host_buf_t out = { 0 };
+
+    CHECK(host_jpeg_encode(frame, 320, 240, 80, &jpeg) == ESP_OK);
+    uint8_t *copy = malloc(jpeg.len);
+
+    // DC luma with three 1-bit codes, the value count unchanged
+    memcpy(copy, jpeg.data, jpeg.len);
+    uint8_t *bits = find_dht_bits(copy, jpeg.len, 0x00);
+    CHECK(bits != NULL && bits[0] == 0 && bits[1] == 1 && bits[2] == 5);
+    if (bits) {
+        bits[0] = 3;
+        bits[1] = 0;
+        bits[2] = 3;
+        CHECK(jpeg_optimize(copy, jpeg.len, host_buf_output, &out, NULL) == ESP_ERR_INVALID_ARG);
+    }
+
+    // AC luma with both 1-bit codes and 160 2-bit codes: the 2-bit codes
+    // would index the 8-bit lookup past its end
+    memcpy(copy, jpeg.data, jpeg.len);
+    bits = find_dht_bits(copy, jpeg.len, 0x10);
+    CHECK(bits != NULL);
+    if (bits) {
+        memset(bits, 0, 16);
+        bits[0] = 2;
+        bits[1] = 160;
+        CHECK(jpeg_optimize(copy, jpeg.len, host_buf_output, &out, NULL) == ESP_ERR_INVALID_ARG);
+    }
+
+    // A truncated scan is padded with zeros, as libjpeg does, and the
+    // padded coefficients are what gets re-encoded
+    jpeg_info_t *info = malloc(sizeof(jpeg_info_t));
+    CHECK(jpeg_scan_parse(jpeg.data, jpeg.len, info) == ESP_OK);
+    size_t truncated = info->scan_offset + 100;
+    free(info);
+    out.len = 0;
+    CHECK(jpeg_optimize(jpeg.data, truncated, host_buf_output, &out, NULL) == ESP_OK);
+    CHECK(same_coefs(jpeg.data, truncated, out.data, out.len));
+
+    // Damaged copies must fail or succeed without touching memory they
+    // do not own (run under ASan to see the latter)
+    uint32_t seed = 1;
+    int rejected = 0;
+    for (int i = 0; i < FUZZ_RUNS; i++) {
+        memcpy(copy, jpeg.data, jpeg.len);
+        for (int n = 0; n < 4; n++) {
+            seed = seed * 1103515245u + 12345u;
+            size_t at = (seed >> 8) % jpeg.len;
+            copy[at] ^= (uint8_t)(1 + (seed >> 3) % 255);
+        }
+        out.len = 0;
+        rejected += jpeg_optimize(copy, jpeg.len, host_buf_output, &out, NULL) != ESP_OK;
+    }
+    printf("damaged copies rejected: %d/%d\n", rejected, FUZZ_RUNS);
+
+    free(copy);
+    host_buf_free(&out);
+    host_buf_free(&jpeg);
+    free(frame);
+}
+
+int main(void)
+{
+    test_encoder_output();
+#if HOST_HAVE_LIBJPEG
+    test_libjpeg_output();
+#endif
+    test_malformed();
+    return host_test_result("jpeg_optimize");
+}
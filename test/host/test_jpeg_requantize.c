@@ -0,0 +1,161 @@
+/**
+ * @file test_jpeg_requantize.c
+ * @brief DCT-domain requantization
+ *
+ * Requantizes a q95 encoder output to lower qualities and checks the new
+ * tables (Annex K at the target, never finer than the original) and every
+ * coefficient against c' = round(c * Q / Q'). With libjpeg, the result is
+ * compared with decoding and re-encoding at the same quality with
+ * optimized tables: size, and PSNR against the original frame.
+ */
+
+#include "host_test.h"
+#include "host_jpeg.h"
+#include "jpeg/jpeg_optimize.h"
+#include "jpeg/jpeg_scan.h"
+#include "jpeg/jpeg_tables.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define WIDTH           1024
+#define HEIGHT          768
+#define SOURCE_QUALITY  95
+
+static const int s_qualities[] = { 85, 70, 50, 30, 20 };
+
+/**
+ * @brief Check the requantized tables and coefficients against the source
+ */
+static void check_coefs(const uint8_t *src, size_t src_len, const uint8_t *out, size_t out_len,
+                        int quality)
+{
+    jpeg_info_t *a = malloc(sizeof(jpeg_info_t));
+    jpeg_info_t *b = malloc(sizeof(jpeg_info_t));
+    int16_t *ca = NULL, *cb = NULL;
+    size_t na = 0, nb = 0;
+
+    CHECK(jpeg_scan_parse(src, src_len, a) == ESP_OK);
+    CHECK(jpeg_scan_parse(out, out_len, b) == ESP_OK);
+    CHECK(host_jpeg_coefs(src, src_len, &ca, &na) == ESP_OK);
+    CHECK(host_jpeg_coefs(out, out_len, &cb, &nb) == ESP_OK);
+    CHECK(na == nb && na > 0);
+
+    // Annex K at the target quality, but never finer than the original
+    int wrong_tables = 0;
+    for (int t = 0; t < 2; t++) {
+        uint8_t scaled[64];
+        jpeg_scale_qtable(t == 0 ? jpeg_std_qt_luma : jpeg_std_qt_chroma, quality, scaled);
+        for (int k = 0; k < 64; k++) {
+            uint16_t want = scaled[jpeg_zigzag[k]];
+            want = want > a->qt[t][k] ? want : a->qt[t][k];
+            wrong_tables += b->qt[t][k] != want;
+        }
+    }
+    CHECK(wrong_tables == 0);
+
+    // Blocks come in MCU order: Y Y Cb Cr
+    int wrong_coefs = 0;
+    for (size_t i = 0; i < na && na == nb; i++) {
+        int t = i % 4 < 2 ? 0 : 1;
+        for (int k = 0; k < 64; k++) {
+            int c = ca[i * 64 + k];
+            int from = a->qt[t][k], to = b->qt[t][k];
+            int r = (abs(c) * from + to / 2) / to;
+            wrong_coefs += cb[i * 64 + k] != (c < 0 ? -r : r);
+        }
+    }
+    CHECK(wrong_coefs == 0);
+
+    free(cb);
+    free(ca);
+    free(b);
+    free(a);
+}
+
+#if HOST_HAVE_LIBJPEG
+/**
+ * @brief Decode, re-encode at the quality and optimize: the baseline
+ */
+static size_t reencode(const uint8_t *jpeg, size_t len, int quality, host_buf_t *out)
+{
+    int w = 0, h = 0;
+    uint8_t *ycc = host_jpeg_decode(jpeg, len, &w, &h);
+    uint8_t *yuyv = malloc((size_t)w * h * 2);
+    host_buf_t plain = { 0 };
+
+    for (size_t p = 0; p < (size_t)w * h; p += 2) {
+        yuyv[p * 2] = ycc[p * 3];
+        yuyv[p * 2 + 1] = ycc[p * 3 + 1];
+        yuyv[p * 2 + 2] = ycc[p * 3 + 3];
+        yuyv[p * 2 + 3] = ycc[p * 3 + 2];
+    }
+    CHECK(host_jpeg_encode(yuyv, w, h, quality, &plain) == ESP_OK);
+    CHECK(jpeg_optimize(plain.data, plain.len, host_buf_output, out, NULL) == ESP_OK);
+
+    host_buf_free(&plain);
+    free(yuyv);
+    free(ycc);
+    return out->len;
+}
+#endif
+
+int main(void)
+{
+    uint8_t *frame = host_scene_yuyv(WIDTH, HEIGHT, 0);
+    host_buf_t src = { 0 };
+    host_buf_t out = { 0 };
+
+    CHECK(host_jpeg_encode(frame, WIDTH, HEIGHT, SOURCE_QUALITY, &src) == ESP_OK);
+    CHECK(jpeg_requantize(src.data, src.len, 0, host_buf_output, &out, NULL) ==
+          ESP_ERR_INVALID_ARG);
+    CHECK(jpeg_requantize(src.data, src.len, 101, host_buf_output, &out, NULL) ==
+          ESP_ERR_INVALID_ARG);
+
+    // At a finer quality every step is kept: only the Huffman tables change
+    out.len = 0;
+    CHECK(jpeg_requantize(src.data, src.len, 100, host_buf_output, &out, NULL) == ESP_OK);
+    check_coefs(src.data, src.len, out.data, out.len, 100);
+    CHECK(out.len < src.len);
+
+    printf("%dx%d q%d source: %zu bytes\n", WIDTH, HEIGHT, SOURCE_QUALITY, src.len);
+    size_t prev = src.len;
+    for (size_t i = 0; i < sizeof(s_qualities) / sizeof(s_qualities[0]); i++) {
+        int q = s_qualities[i];
+        jpeg_optimize_stats_t stats;
+
+        out.len = 0;
+        CHECK(jpeg_requantize(src.data, src.len, q, host_buf_output, &out, &stats) == ESP_OK);
+        CHECK(stats.out_len == out.len);
+        CHECK(out.len < prev);
+        prev = out.len;
+        check_coefs(src.data, src.len, out.data, out.len, q);
+        printf("  q%d: %7zu bytes in %u + %u us", q, out.len, (unsigned)stats.count_us,
+               (unsigned)stats.encode_us);
+
+#if HOST_HAVE_LIBJPEG
+        // No worse than a decode and re-encode of about the same size
+        host_buf_t base = { 0 };
+        reencode(src.data, src.len, q, &base);
+        int w = 0, h = 0;
+        uint8_t *ours = host_jpeg_decode(out.data, out.len, &w, &h);
+        uint8_t *theirs = host_jpeg_decode(base.data, base.len, &w, &h);
+        CHECK(ours != NULL && theirs != NULL);
+        if (ours && theirs) {
+            double p = host_psnr(ours, frame, WIDTH, HEIGHT, 0);
+            double p_base = host_psnr(theirs, frame, WIDTH, HEIGHT, 0);
+            printf(", luma PSNR %.2f dB; re-encoded %7zu bytes, %.2f dB", p, base.len, p_base);
+            CHECK(p >= p_base - 0.1);
+            CHECK(out.len * 100 <= base.len * 105);
+        }
+        free(theirs);
+        free(ours);
+        host_buf_free(&base);
+#endif
+        printf("\n");
+    }
+
+    host_buf_free(&out);
+    host_buf_free(&src);
+    free(frame);
+    return host_test_result("jpeg_requantize");
+}
@@ -0,0 +1,316 @@
+/**
+ * @file test_rtp_jpeg.c
+ * @brief RTP/JPEG packetization (RFC 2435)
+ *
+ * Packetizes the firmware's JPEGs at several MTUs and checks every packet
+ * as a receiver would: the RTP header (version, payload type, sequence
+ * numbers, timestamp, SSRC, the marker bit on the last packet only), the
+ * JPEG header (type, Q, size, contiguous fragment offsets), the restart
+ * marker header, and the quantization table header on the first packet,
+ * which must carry the tables of the JPEG's DQT segments. The payloads put
+ * back together by offset must be the scan data exactly. JPEGs RFC 2435
+ * cannot describe are refused.
+ */
+
+#include "host_test.h"
+#include "host_jpeg.h"
+#include "net/rtp_jpeg.h"
+#include "jpeg/jpeg_optimize.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define SSRC            0x1234abcdu
+
+static jpeg_info_t s_info;          // Large: keep off the stack
+
+/**
+ * @brief Encode the test scene
+ */
+static host_buf_t make_jpeg(int width, int height, int quality)
+{
+    host_buf_t jpeg = { 0 };
+    uint8_t *yuyv = host_scene_yuyv(width, height, 0);
+
+    CHECK(host_jpeg_encode(yuyv, width, height, quality, &jpeg) == ESP_OK);
+    free(yuyv);
+    return jpeg;
+}
+
+/**
+ * @brief Insert a segment before SOS
+ */
+static void insert_segment(host_buf_t *jpeg, const uint8_t *seg, size_t len)
+{
+    for (size_t i = 2; i + 1 < jpeg->len; i++) {
+        if (jpeg->data[i] == 0xff && jpeg->data[i + 1] == 0xda) {
+            jpeg->data = realloc(jpeg->data, jpeg->len + len);
+            memmove(jpeg->data + i + len, jpeg->data + i, jpeg->len - i);
+            memcpy(jpeg->data + i, seg, len);
+            jpeg->len += len;
+            jpeg->cap = jpeg->len;
+            return;
+        }
+    }
+    CHECK(!"no SOS");
+}
+
+/**
+ * @brief Segment of a marker type, walking the headers from SOI
+ *
+ * @param nth Which of several such segments, from 0
+ * @return Its contents after the length field, NULL if absent
+ */
+static const uint8_t *find_segment(const host_buf_t *jpeg, uint8_t marker, int nth,
+                                   size_t *len)
+{
+    size_t i = 2;
+
+    while (i + 4 <= jpeg->len && jpeg->data[i] == 0xff) {
+        size_t seg_len = jpeg->data[i + 2] << 8 | jpeg->data[i + 3];
+        if (jpeg->data[i + 1] == marker && nth-- == 0) {
+            *len = seg_len - 2;
+            return jpeg->data + i + 4;
+        }
+        if (jpeg->data[i + 1] == 0xda) {
+            break;
+        }
+        i += 2 + seg_len;
+    }
+    return NULL;
+}
+
+/**
+ * @brief The 8-bit quantization table with a given id, zigzag order
+ */
+static const uint8_t *find_qt(const host_buf_t *jpeg, int id)
+{
+    size_t len;
+    const uint8_t *seg;
+
+    for (int n = 0; (seg = find_segment(jpeg, 0xdb, n, &len)) != NULL; n++) {
+        for (size_t i = 0; i + 65 <= len; i += 65) {
+            if ((seg[i] & 0x0f) == id && (seg[i] >> 4) == 0) {
+                return seg + i + 1;
+            }
+        }
+    }
+    return NULL;
+}
+
+static uint32_t be(const uint8_t *p, int bytes)
+{
+    uint32_t v = 0;
+
+    for (int i = 0; i < bytes; i++) {
+        v = v << 8 | p[i];
+    }
+    return v;
+}
+
+/**
+ * @brief Packetize one frame and check each packet as a receiver would
+ *
+ * @param type_420 Expected RFC 2435 type before the restart flag
+ * @return Number of packets
+ */
+static int check_frame(const host_buf_t *jpeg, rtp_jpeg_session_t *session,
+                       int64_t timestamp_us, int type_420)
+{
+    rtp_jpeg_frame_t frame;
+    CHECK(rtp_jpeg_prepare(jpeg->data, jpeg->len, &s_info, timestamp_us, &frame) == ESP_OK);
+
+    // The scan, found independently: after the SOS header, up to EOI
+    size_t sos_len;
+    const uint8_t *sos = find_segment(jpeg, 0xda, 0, &sos_len);
+    CHECK(sos != NULL);
+    if (!sos) {
+        return 0;
+    }
+    const uint8_t *scan = sos + sos_len;
+    size_t scan_len = jpeg->data + jpeg->len - 2 - scan;
+    CHECK(be(jpeg->data + jpeg->len - 2, 2) == 0xffd9);
+    CHECK(frame.scan == scan && frame.scan_len == scan_len);
+
+    // Tables and restart interval from the headers
+    size_t sof_len, dri_len;
+    const uint8_t *sof = find_segment(jpeg, 0xc0, 0, &sof_len);
+    const uint8_t *dri = find_segment(jpeg, 0xdd, 0, &dri_len);
+    int width = be(sof + 3, 2), height = be(sof + 1, 2);
+    const uint8_t *qt_luma = find_qt(jpeg, sof[6 + 2]);
+    const uint8_t *qt_chroma = find_qt(jpeg, sof[9 + 2]);
+    int restart = dri ? be(dri, 2) : 0;
+    CHECK(qt_luma && qt_chroma);
+
+    uint8_t *rebuilt = malloc(scan_len);
+    memset(rebuilt, 0xee, scan_len);
+    uint32_t ts = (uint32_t)(timestamp_us * 9 / 100);
+    uint16_t seq = session->seq;
+    size_t expect_offset = 0;
+    int packets = 0;
+    bool marker_seen = false;
+
+    uint8_t header[RTP_JPEG_MAX_HEADER];
+    size_t header_len, payload_len;
+    const uint8_t *payload;
+    while (rtp_jpeg_next(session, &frame, header, &header_len, &payload, &payload_len)) {
+        bool first = packets == 0;
+
+        // RTP: V=2, no padding, extension or CSRCs; PT 26; the marker
+        // on the last packet only
+        CHECK(header[0] == 0x80);
+        CHECK((header[1] & 0x7f) == RTP_JPEG_PAYLOAD_TYPE);
+        CHECK(!marker_seen);
+        marker_seen = header[1] & 0x80;
+        CHECK(be(header + 2, 2) == (uint16_t)(seq + packets));
+        CHECK(be(header + 4, 4) == ts);
+        CHECK(be(header + 8, 4) == SSRC);
+
+        // JPEG header: type-specific 0, offset, type, Q 255, size in 8s
+        const uint8_t *jh = header + 12;
+        CHECK(jh[0] == 0);
+        size_t offset = be(jh + 1, 3);
+        CHECK(offset == expect_offset);
+        CHECK(jh[4] == (type_420 | (restart ? 64 : 0)));
+        CHECK(jh[5] == 255);
+        CHECK(jh[6] == (width + 7) / 8 && jh[7] == (height + 7) / 8);
+        const uint8_t *p = jh + 8;
+
+        // Restart marker header (3.1.7): interval, F = L = 1, count 0x3fff
+        if (restart) {
+            CHECK(be(p, 2) == (uint32_t)restart);
+            CHECK(be(p + 2, 2) == 0xffff);
+            p += 4;
+        }
+
+        // Quantization table header (3.1.8) in the first packet only
+        if (first) {
+            CHECK(p[0] == 0 && p[1] == 0 && be(p + 2, 2) == 128);
+            CHECK(memcmp(p + 4, qt_luma, 64) == 0);
+            CHECK(memcmp(p + 4 + 64, qt_chroma, 64) == 0);
+            p += 4 + 128;
+        }
+        CHECK(header_len == (size_t)(p - header));
+
+        // Fills the MTU unless it is the last packet
+        CHECK(header_len + payload_len <= session->mtu_payload);
+        CHECK(payload_len > 0);
+        CHECK(marker_seen == (offset + payload_len == scan_len));
+        if (!marker_seen) {
+            CHECK(header_len + payload_len == session->mtu_payload);
+        }
+        CHECK(payload == scan + offset);
+        if (offset + payload_len <= scan_len) {
+            memcpy(rebuilt + offset, payload, payload_len);
+        }
+        expect_offset = offset + payload_len;
+        packets++;
+    }
+    CHECK(marker_seen);
+    CHECK(expect_offset == scan_len);
+    CHECK(memcmp(rebuilt, scan, scan_len) == 0);
+    CHECK(session->seq == (uint16_t)(seq + packets));
+
+    // Exhausted: no more packets
+    CHECK(!rtp_jpeg_next(session, &frame, header, &header_len, &payload, &payload_len));
+    free(rebuilt);
+    return packets;
+}
+
+static void test_mtus(void)
+{
+    static const size_t mtus[] = { 1400, 1200, 576, RTP_JPEG_MAX_HEADER + 1 };
+    host_buf_t jpeg = make_jpeg(640, 480, 80);
+
+    for (size_t t = 0; t < sizeof(mtus) / sizeof(mtus[0]); t++) {
+        rtp_jpeg_session_t session = { .ssrc = SSRC, .seq = 100, .mtu_payload = mtus[t] };
+        int packets = check_frame(&jpeg, &session, 1234567, 0);
+        printf("640x480 q80 %zu bytes, MTU %4zu: %d packets\n", jpeg.len, mtus[t], packets);
+        CHECK(packets > 1);
+    }
+    host_buf_free(&jpeg);
+}
+
+/**
+ * @brief Sequence numbers carry across frames and wrap; timestamps follow
+ *        the capture clock
+ */
+static void test_sequence(void)
+{
+    host_buf_t small = make_jpeg(160, 120, 50);
+    rtp_jpeg_session_t session = { .ssrc = SSRC, .seq = 65530, .mtu_payload = 600 };
+
+    int total = 0;
+    for (int n = 0; n < 5; n++) {
+        total += check_frame(&small, &session, 1000000000LL + n * 100000, 0);
+    }
+    CHECK(session.seq == (uint16_t)(65530 + total));
+    CHECK(total > 6);                   // So the sequence number wrapped
+
+    // One packet for a frame that fits
+    session.mtu_payload = 1400 + small.len;
+    CHECK(check_frame(&small, &session, 0, 0) == 1);
+    host_buf_free(&small);
+}
+
+/**
+ * @brief 4:2:0 sampling and a restart interval, patched into the headers
+ */
+static void test_variants(void)
+{
+    host_buf_t jpeg = make_jpeg(320, 240, 70);
+    rtp_jpeg_session_t session = { .ssrc = SSRC, .seq = 7, .mtu_payload = 1000 };
+    static const uint8_t dri[] = { 0xff, 0xdd, 0x00, 0x04, 0x00, 0x28 };
+
+    // The packetizer looks only at the headers, so the scan can stay as it is
+    insert_segment(&jpeg, dri, sizeof(dri));
+    check_frame(&jpeg, &session, 5000, 0);
+
+    size_t sof_len;
+    uint8_t *sof = (uint8_t *)find_segment(&jpeg, 0xc0, 0, &sof_len);
+    CHECK(sof[7] == 0x21);
+    sof[7] = 0x22;
+    check_frame(&jpeg, &session, 5000, 1);
+    host_buf_free(&jpeg);
+}
+
+/**
+ * @brief What RFC 2435 cannot carry is refused
+ */
+static void test_unsupported(void)
+{
+    rtp_jpeg_frame_t frame;
+
+    // Optimized Huffman tables: receivers would assume Annex K's
+    host_buf_t jpeg = make_jpeg(320, 240, 80);
+    host_buf_t optimized = { 0 };
+    CHECK(jpeg_optimize(jpeg.data, jpeg.len, host_buf_output, &optimized, NULL) == ESP_OK);
+    CHECK(rtp_jpeg_prepare(optimized.data, optimized.len, &s_info, 0, &frame) ==
+          ESP_ERR_NOT_SUPPORTED);
+    host_buf_free(&optimized);
+
+    // 4:4:4 chroma
+    size_t sof_len;
+    uint8_t *sof = (uint8_t *)find_segment(&jpeg, 0xc0, 0, &sof_len);
+    sof[7] = 0x11;
+    CHECK(rtp_jpeg_prepare(jpeg.data, jpeg.len, &s_info, 0, &frame) == ESP_ERR_NOT_SUPPORTED);
+    sof[7] = 0x21;
+
+    // Wider than the 8-bit width field allows
+    sof[3] = 2048 >> 8;
+    sof[4] = 2048 & 0xff;
+    CHECK(rtp_jpeg_prepare(jpeg.data, jpeg.len, &s_info, 0, &frame) == ESP_ERR_NOT_SUPPORTED);
+    host_buf_free(&jpeg);
+
+    // Not a JPEG at all
+    static const uint8_t junk[] = { 0x00, 0x01, 0x02, 0x03 };
+    CHECK(rtp_jpeg_prepare(junk, sizeof(junk), &s_info, 0, &frame) != ESP_OK);
+}
+
+int main(void)
+{
+    test_mtus();
+    test_sequence();
+    test_variants();
+    test_unsupported();
+    return host_test_result("rtp_jpeg");
+}
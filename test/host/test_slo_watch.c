@@ -0,0 +1,240 @@
+/**
+ * @file test_slo_watch.c
+ * @brief Request SLO thresholds, the slow-request ring and clearing
+ *
+ * Traces are backdated instead of slept through: a request "took" as long
+ * as its start mark lies in the past. Checks the threshold comparison
+ * either side of the limit and for thresholds and requests too long for
+ * 32-bit microseconds, the accepted threshold range, phases, the counters,
+ * the ring of the newest SLO_RING_SIZE records and what slo_clear() keeps.
+ * The request is a loopback TCP connection so the peer address is real.
+ */
+
+#include "host_test.h"
+#include "web_server/slo_watch.h"
+#include "camera/camera_service.h"
+#include "stream/stream.h"
+#include "wifi/wifi.h"
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#define MS  1000LL
+#define SEC 1000000LL
+
+static int s_conn = -1;
+
+void camera_service_get_stats(camera_service_stats_t *stats)
+{
+    memset(stats, 0, sizeof(*stats));
+    stats->max_queue_us = 190000;
+}
+
+void stream_get_stats(stream_stats_t *stats)
+{
+    memset(stats, 0, sizeof(*stats));
+    stats->clients = 2;
+}
+
+int wifi_get_rssi(void)
+{
+    return -67;
+}
+
+int httpd_req_to_sockfd(httpd_req_t *r)
+{
+    return s_conn;
+}
+
+esp_err_t httpd_get_client_list(httpd_handle_t handle, size_t *fds, int *client_fds)
+{
+    *fds = 3;
+    return ESP_OK;
+}
+
+/**
+ * @brief A connected loopback socket for the snapshot to look at
+ */
+static int loopback_conn(int *listener)
+{
+    struct sockaddr_in addr = { .sin_family = AF_INET, .sin_addr.s_addr = htonl(INADDR_LOOPBACK) };
+    socklen_t len = sizeof(addr);
+
+    *listener = socket(AF_INET, SOCK_STREAM, 0);
+    if (bind(*listener, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(*listener, 1) != 0 ||
+        getsockname(*listener, (struct sockaddr *)&addr, &len) != 0) {
+        return -1;
+    }
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    return connect(fd, (struct sockaddr *)&addr, sizeof(addr)) == 0 ? fd : -1;
+}
+
+/**
+ * @brief End a request that took duration_us, in phases of equal length
+ */
+static void request(slo_endpoint_t endpoint, int64_t duration_us, int phases, uint32_t bytes)
+{
+    static const char *const names[] = { "queue", "capture", "encode", "send", "a", "b", "c", "d" };
+    httpd_req_t req = { 0 };
+    slo_trace_t t;
+
+    slo_begin(&t, endpoint);
+    int64_t start = t.marks[0] - duration_us;
+    t.marks[0] = start;
+    for (int p = 0; p < phases; p++) {
+        slo_mark(&t, names[p]);
+        // Backdate the phase end to keep the phases evenly spread
+        t.marks[p < SLO_MAX_PHASES ? p + 1 : SLO_MAX_PHASES] =
+            start + duration_us * (p + 1) / phases;
+    }
+    t.bytes = bytes;
+    slo_end(&t, &req);
+}
+
+static uint32_t breaches(slo_endpoint_t endpoint)
+{
+    slo_endpoint_stats_t stats;
+    slo_get_stats(endpoint, &stats);
+    return stats.breaches;
+}
+
+static void test_threshold(void)
+{
+    slo_endpoint_stats_t stats;
+
+    slo_clear();
+    slo_get_stats(SLO_CAPTURE, &stats);
+    CHECK(stats.slo_ms == 1500);
+
+    // The trace ends a few microseconds after it is backdated: stay clear
+    // of the limit on the short side, step just over it on the long one
+    request(SLO_CAPTURE, 1500 * MS - 20 * MS, 2, 0);
+    CHECK(breaches(SLO_CAPTURE) == 0);
+    request(SLO_CAPTURE, 1500 * MS + 1, 2, 0);
+    CHECK(breaches(SLO_CAPTURE) == 1);
+
+    // Thresholds are per endpoint
+    request(SLO_STATUS, 1000 * MS, 1, 0);
+    CHECK(breaches(SLO_STATUS) == 1);
+    CHECK(breaches(SLO_CAPTURE) == 1);
+
+    // Accepted range
+    CHECK(slo_set_threshold(SLO_CAPTURE, 0) == ESP_ERR_INVALID_ARG);
+    CHECK(slo_set_threshold(SLO_CAPTURE, SLO_MAX_MS + 1) == ESP_ERR_INVALID_ARG);
+    // Would have wrapped to a 704 ms threshold in 32 bits
+    CHECK(slo_set_threshold(SLO_CAPTURE, 4294968) == ESP_ERR_INVALID_ARG);
+    CHECK(slo_set_threshold(SLO_ENDPOINT_COUNT, 1000) == ESP_ERR_INVALID_ARG);
+    slo_get_stats(SLO_CAPTURE, &stats);
+    CHECK(stats.slo_ms == 1500);
+    CHECK(slo_set_threshold(SLO_CAPTURE, 1) == ESP_OK);
+    CHECK(slo_set_threshold(SLO_CAPTURE, SLO_MAX_MS) == ESP_OK);
+
+    // The largest threshold holds for a request of several minutes...
+    request(SLO_CAPTURE, 300 * SEC, 2, 0);
+    CHECK(breaches(SLO_CAPTURE) == 1);
+    // ...and a request longer than 32-bit microseconds reach (71 minutes)
+    // is a breach, not a wrapped-around short one
+    request(SLO_CAPTURE, 4400 * SEC, 1, 0);
+    CHECK(breaches(SLO_CAPTURE) == 2);
+    slo_get_stats(SLO_CAPTURE, &stats);
+    CHECK(stats.max_us == UINT32_MAX);
+    slo_record_t rec;
+    CHECK(slo_get_record(0, &rec));
+    CHECK(rec.total_us == UINT32_MAX);
+    CHECK(rec.phases == 1 && rec.phase_us[0] == UINT32_MAX);
+
+    CHECK(slo_set_threshold(SLO_CAPTURE, 1500) == ESP_OK);
+}
+
+static void test_record(void)
+{
+    slo_endpoint_stats_t stats;
+    slo_record_t rec;
+
+    slo_clear();
+    request(SLO_LAST, 200 * MS, 2, 1000);
+    request(SLO_LAST, 400 * MS, 2, 1000);
+    request(SLO_LAST, 1200 * MS, 4, 54321);
+    slo_get_stats(SLO_LAST, &stats);
+    CHECK(stats.requests == 3 && stats.breaches == 1);
+    CHECK(stats.max_us >= 1200 * MS && stats.max_us < 1210 * MS);
+    CHECK(stats.total_us / stats.requests / 1000 == 600);
+
+    CHECK(!slo_get_record(1, &rec) && !slo_get_record(-1, &rec));
+    CHECK(slo_get_record(0, &rec));
+    CHECK(rec.endpoint == SLO_LAST && rec.bytes == 54321);
+    CHECK(rec.total_us >= 1200 * MS && rec.total_us < 1210 * MS);
+    CHECK(rec.phases == 4);
+    CHECK(strcmp(rec.names[0], "queue") == 0 && strcmp(rec.names[3], "send") == 0);
+    for (int p = 0; p < 4; p++) {
+        CHECK(rec.phase_us[p] == 300 * MS);
+    }
+
+    // The snapshot
+    CHECK(strcmp(rec.peer, "127.0.0.1") == 0);
+    CHECK(rec.sock_err == 0);
+    CHECK(rec.open_sockets == 3);
+    CHECK(rec.rssi == -67);
+    CHECK(rec.cam_queue_max_us == 190000);
+    CHECK(rec.stream_clients == 2);
+
+    // Phases past SLO_MAX_PHASES fold into the last one
+    request(SLO_LAST, 1600 * MS, SLO_MAX_PHASES + 2, 0);
+    CHECK(slo_get_record(0, &rec));
+    CHECK(rec.phases == SLO_MAX_PHASES);
+    CHECK(rec.phase_us[0] == 200 * MS);
+    CHECK(rec.phase_us[SLO_MAX_PHASES - 1] == 600 * MS);
+}
+
+static void test_ring(void)
+{
+    slo_record_t rec;
+
+    slo_clear();
+    CHECK(!slo_get_record(0, &rec));
+
+    // More breaches than the ring holds: the newest SLO_RING_SIZE, newest first
+    for (uint32_t i = 1; i <= SLO_RING_SIZE + 5; i++) {
+        request(SLO_PAGE, 500 * MS, 1, i);
+        request(SLO_PAGE, 10 * MS, 1, 0);       // Not recorded
+    }
+    for (int i = 0; i < SLO_RING_SIZE; i++) {
+        CHECK(slo_get_record(i, &rec));
+        CHECK(rec.bytes == SLO_RING_SIZE + 5 - (uint32_t)i);
+    }
+    CHECK(!slo_get_record(SLO_RING_SIZE, &rec));
+    CHECK(breaches(SLO_PAGE) == SLO_RING_SIZE + 5);
+
+    // Clearing drops records and counters, and keeps the thresholds
+    CHECK(slo_set_threshold(SLO_PAGE, 250) == ESP_OK);
+    slo_clear();
+    slo_endpoint_stats_t stats;
+    slo_get_stats(SLO_PAGE, &stats);
+    CHECK(stats.slo_ms == 250);
+    CHECK(stats.requests == 0 && stats.breaches == 0 && stats.max_us == 0 &&
+          stats.total_us == 0);
+    CHECK(!slo_get_record(0, &rec));
+
+    // Recording starts over from the first slot
+    request(SLO_PAGE, 300 * MS, 1, 77);
+    CHECK(slo_get_record(0, &rec) && rec.bytes == 77);
+    CHECK(!slo_get_record(1, &rec));
+}
+
+int main(void)
+{
+    int listener;
+
+    s_conn = loopback_conn(&listener);
+    CHECK(s_conn >= 0);
+
+    test_threshold();
+    test_record();
+    test_ring();
+
+    close(s_conn);
+    close(listener);
+    return host_test_result("test_slo_watch");
+}
@@ -0,0 +1,481 @@
+/**
+ * @file test_status_events.c
+ * @brief Server-Sent Events framing and deltas, through the event task
+ *
+ * Subscribers are socket pairs: the event task writes to one end, the
+ * test reads the other and splits what arrives into events. Checks the
+ * headers and the opening "state", that each tick sends only what
+ * changed (and the sensor is read only after a counted change), the
+ * health steps, disconnects and the subscriber cap, and that a tick with
+ * every event at its widest fits the message buffer.
+ *
+ * Built a second time with STATUS_EVENTS_MSG_SIZE 192, where the state
+ * and large deltas do not fit: those events are left out whole and the
+ * stream stays well-formed.
+ */
+
+#include "host_test.h"
+#include "net/status_events.h"
+#include "net/http_raw.h"
+#include "camera/camera_service.h"
+#include "wifi/wifi.h"
+#include <poll.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#define TICK_MS         CONFIG_GROWPOD_STATUS_EVENTS_TICK_MS
+#define QUIET_MS        (5 * TICK_MS)   // Long enough to see a tick that should not come
+#define MAX_EVENTS      8
+
+static pthread_mutex_t s_lock = PTHREAD_MUTEX_INITIALIZER;
+static camera_service_stats_t s_stats;
+static camera_status_t s_status;
+static int s_status_reads;
+static int s_rssi = -55;
+static int s_completed;
+static int s_closed;
+
+void camera_service_get_stats(camera_service_stats_t *stats)
+{
+    pthread_mutex_lock(&s_lock);
+    *stats = s_stats;
+    pthread_mutex_unlock(&s_lock);
+}
+
+esp_err_t camera_service_get_status(camera_status_t *status)
+{
+    pthread_mutex_lock(&s_lock);
+    *status = s_status;
+    s_status_reads++;
+    pthread_mutex_unlock(&s_lock);
+    return ESP_OK;
+}
+
+const char *camera_mode_name(camera_mode_t mode)
+{
+    return mode == CAMERA_MODE_STILL ? "still" : mode == CAMERA_MODE_STREAM ? "stream" : "yuv";
+}
+
+int wifi_get_rssi(void)
+{
+    pthread_mutex_lock(&s_lock);
+    int rssi = s_rssi;
+    pthread_mutex_unlock(&s_lock);
+    return rssi;
+}
+
+// A subscriber's request carries its socket in user_ctx
+esp_err_t httpd_req_async_handler_begin(httpd_req_t *r, httpd_req_t **out)
+{
+    *out = malloc(sizeof(**out));
+    **out = *r;
+    return ESP_OK;
+}
+
+esp_err_t httpd_req_async_handler_complete(httpd_req_t *r)
+{
+    free(r);
+    __atomic_fetch_add(&s_completed, 1, __ATOMIC_SEQ_CST);
+    return ESP_OK;
+}
+
+int httpd_req_to_sockfd(httpd_req_t *r)
+{
+    return (int)(intptr_t)r->user_ctx;
+}
+
+esp_err_t httpd_sess_trigger_close(httpd_handle_t handle, int sockfd)
+{
+    __atomic_fetch_add(&s_closed, 1, __ATOMIC_SEQ_CST);
+    return ESP_OK;
+}
+
+esp_err_t http_raw_send_headers(httpd_req_t *req, const char *status,
+                                const char *content_type, long content_length,
+                                const char *extra_headers)
+{
+    char buf[256];
+    int n = snprintf(buf, sizeof(buf), "HTTP/1.1 %s\r\nContent-Type: %s\r\n%s\r\n",
+                     status, content_type, extra_headers ? extra_headers : "");
+    return send(httpd_req_to_sockfd(req), buf, n, 0) == n ? ESP_OK : ESP_FAIL;
+}
+
+/**
+ * @brief One subscriber: the test's end of the pair, and the request
+ */
+typedef struct {
+    int fd;
+    httpd_req_t req;
+} sub_t;
+
+typedef struct {
+    char name[16];
+    char data[1024];
+} event_t;
+
+static bool subscribe(sub_t *sub)
+{
+    int fds[2];
+
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0) {
+        return false;
+    }
+    sub->fd = fds[1];
+    sub->req = (httpd_req_t){ .user_ctx = (void *)(intptr_t)fds[0] };
+    if (status_events_add_client(&sub->req) != ESP_OK) {
+        close(fds[0]);
+        close(fds[1]);
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Read what arrives within timeout_ms, until the writes stop
+ *
+ * @return Bytes read, 0 if nothing came
+ */
+static size_t read_msg(int fd, char *buf, size_t size, int timeout_ms)
+{
+    size_t len = 0;
+    struct pollfd p = { .fd = fd, .events = POLLIN };
+
+    while (len < size - 1 && poll(&p, 1, len ? TICK_MS / 2 : timeout_ms) == 1) {
+        ssize_t n = recv(fd, buf + len, size - 1 - len, 0);
+        if (n <= 0) {
+            break;
+        }
+        len += n;
+    }
+    buf[len] = '\0';
+    return len;
+}
+
+/**
+ * @brief Split a message into events, checking the framing on the way
+ *
+ * Every event must be "event: <name>\ndata: {...}\n\n" with the object on
+ * one line and no dangling comma; a "retry:" line may lead.
+ *
+ * @return Number of events, -1 if the framing is broken
+ */
+static int parse_events(const char *msg, event_t *events, int max, bool *retry)
+{
+    int count = 0;
+
+    *retry = strncmp(msg, "retry: ", 7) == 0;
+    if (*retry) {
+        msg = strchr(msg, '\n') + 1;
+    }
+    while (*msg) {
+        const char *name = msg + 7;
+        const char *name_end = strchr(name, '\n');
+        if (strncmp(msg, "event: ", 7) != 0 || name_end == NULL ||
+            strncmp(name_end + 1, "data: {", 7) != 0 || count == max) {
+            return -1;
+        }
+        const char *data = name_end + 7;
+        const char *end = strstr(data, "\n\n");
+        size_t len = end ? (size_t)(end - data) : 0;
+        if (end == NULL || memchr(data, '\n', len) || data[len - 1] != '}' ||
+            (len >= 2 && data[len - 2] == ',') || len >= sizeof(events->data) ||
+            (size_t)(name_end - name) >= sizeof(events->name)) {
+            return -1;
+        }
+        memcpy(events[count].name, name, name_end - name);
+        events[count].name[name_end - name] = '\0';
+        memcpy(events[count].data, data, len);
+        events[count].data[len] = '\0';
+        count++;
+        msg = end + 2;
+    }
+    return count;
+}
+
+/**
+ * @brief Read the next tick's events
+ *
+ * @return Number of events, 0 if nothing came, -1 if the framing is broken
+ */
+static int next_events(sub_t *sub, event_t *events, int timeout_ms)
+{
+    char msg[4096];
+    bool retry;
+
+    if (read_msg(sub->fd, msg, sizeof(msg), timeout_ms) == 0) {
+        return 0;
+    }
+    int count = parse_events(msg, events, MAX_EVENTS, &retry);
+    return retry ? -1 : count;
+}
+
+#define UPDATE(stmt) do { \
+        pthread_mutex_lock(&s_lock); \
+        stmt; \
+        pthread_mutex_unlock(&s_lock); \
+    } while (0)
+
+/**
+ * @brief Headers, then retry and the full state
+ */
+static void open_stream(sub_t *sub, event_t *state)
+{
+    char msg[4096];
+    event_t events[MAX_EVENTS];
+    bool retry;
+
+    CHECK(subscribe(sub));
+    CHECK(read_msg(sub->fd, msg, sizeof(msg), 1000) > 0);
+    char *body = strstr(msg, "\r\n\r\n");
+    CHECK(body != NULL);
+    if (body == NULL) {
+        return;
+    }
+    body[2] = '\0';
+    CHECK(strstr(msg, "HTTP/1.1 200 OK\r\n") == msg);
+    CHECK(strstr(msg, "Content-Type: text/event-stream\r\n") != NULL);
+    CHECK(strstr(msg, "Cache-Control: no-cache\r\n") != NULL);
+
+    // The state may have come in the same read as the headers
+    body += 4;
+    if (*body == '\0' && read_msg(sub->fd, msg, sizeof(msg), 1000) > 0) {
+        body = msg;
+    }
+    int count = parse_events(body, events, MAX_EVENTS, &retry);
+    CHECK(retry && strncmp(body, "retry: 2000\n", 12) == 0);
+#ifdef STATUS_EVENTS_MSG_SIZE
+    // Too large for the buffer: left out rather than cut
+    CHECK(count == 0);
+#else
+    CHECK(count == 1);
+    if (count == 1) {
+        CHECK(strcmp(events[0].name, "state") == 0);
+        *state = events[0];
+    }
+#endif
+}
+
+/**
+ * @brief Every delta at once, with the widest values each can take
+ */
+static void widest_tick(void)
+{
+    UPDATE(
+        s_status.aec = 255; s_status.aec_value = 65535; s_status.ae_level = -128;
+        s_status.agc = 255; s_status.agc_gain = 255; s_status.quality = 255;
+        s_status.framesize = 255; s_status.brightness = -128; s_status.contrast = -128;
+        s_status.saturation = -128; s_status.sharpness = -128; s_status.awb = 255;
+        s_status.hmirror = 255; s_status.vflip = 255; s_stats.param_changes++;
+        s_stats.mode = CAMERA_MODE_STREAM_YUV; s_stats.stills += 1000000000;
+        s_stats.last_still_len = UINT32_MAX; s_stats.last_still_us = UINT32_MAX;
+        s_rssi = -128);
+    status_events_post_motion(UINT32_MAX - 1, UINT32_MAX);
+    status_events_post_motion(UINT32_MAX, UINT32_MAX);
+}
+
+#ifdef STATUS_EVENTS_MSG_SIZE
+
+static void test_truncation(void)
+{
+    sub_t sub;
+    event_t state, events[MAX_EVENTS];
+
+    open_stream(&sub, &state);
+
+    // The parameters do not fit; the events after them still do
+    widest_tick();
+    int count = next_events(&sub, events, 1000);
+    CHECK(count >= 2);
+    for (int i = 0; i < count; i++) {
+        CHECK(strcmp(events[i].name, "params") != 0);
+    }
+    CHECK(count >= 1 && strcmp(events[0].name, "mode") == 0);
+
+    // Smaller deltas get through as before
+    UPDATE(s_status.vflip = 0; s_stats.param_changes++);
+    CHECK(next_events(&sub, events, 1000) == 1);
+    CHECK(strcmp(events[0].data, "{\"vflip\":0}") == 0);
+
+    close(sub.fd);
+}
+
+#else
+
+static int status_reads(void)
+{
+    pthread_mutex_lock(&s_lock);
+    int reads = s_status_reads;
+    pthread_mutex_unlock(&s_lock);
+    return reads;
+}
+
+static void test_state(void)
+{
+    sub_t sub;
+    event_t state = { 0 };
+
+    UPDATE(s_stats.mode = CAMERA_MODE_STILL; s_stats.stills = 7;
+           s_status.aec_value = 300; s_status.ae_level = -2; s_status.framesize = 13;
+           s_status.quality = 10; s_rssi = -55);
+    open_stream(&sub, &state);
+
+    CHECK(strncmp(state.data, "{\"mode\":\"still\",\"captures\":7,\"aec\":0,\"aec_value\":300,"
+                  "\"ae_level\":-2,", 60) == 0);
+    CHECK(strstr(state.data, "\"framesize\":13,\"brightness\":0") != NULL);
+    CHECK(strstr(state.data, "\"vflip\":0,\"rssi\":-55,\"heap\":0,\"heap_min\":0,"
+                             "\"psram\":0,\"psram_min\":0}") != NULL);
+    for (int i = 0; i < CAMERA_PARAM_COUNT; i++) {
+        char key[32];
+        snprintf(key, sizeof(key), "\"%s\":", camera_param_name(i));
+        CHECK(strstr(state.data, key) != NULL);
+    }
+
+    // Nothing changed: nothing sent
+    event_t events[MAX_EVENTS];
+    CHECK(next_events(&sub, events, QUIET_MS) == 0);
+
+    close(sub.fd);
+}
+
+static void test_deltas(void)
+{
+    sub_t sub;
+    event_t state, events[MAX_EVENTS];
+
+    open_stream(&sub, &state);
+
+    // A counted change: the sensor is read, the changed parameter sent
+    int reads = status_reads();
+    UPDATE(s_status.aec_value = 400; s_stats.param_changes++);
+    CHECK(next_events(&sub, events, 1000) == 1);
+    CHECK(strcmp(events[0].name, "params") == 0);
+    CHECK(strcmp(events[0].data, "{\"aec_value\":400}") == 0);
+    CHECK(status_reads() == reads + 1);
+
+    // A counted change that left the values alone: read, nothing sent
+    UPDATE(s_stats.param_changes++);
+    CHECK(next_events(&sub, events, QUIET_MS) == 0);
+    CHECK(status_reads() == reads + 2);
+
+    // A value that moved without a counted change is not looked for
+    UPDATE(s_status.contrast = 2);
+    CHECK(next_events(&sub, events, QUIET_MS) == 0);
+    CHECK(status_reads() == reads + 2);
+    UPDATE(s_status.brightness = -1; s_stats.param_changes++);
+    CHECK(next_events(&sub, events, 1000) == 1);
+    CHECK(strcmp(events[0].data, "{\"brightness\":-1,\"contrast\":2}") == 0);
+
+    // Several kinds of change in one tick, in one message
+    UPDATE(s_stats.mode = CAMERA_MODE_STREAM; s_stats.stills += 3;
+           s_stats.last_still_len = 81234; s_stats.last_still_us = 182500);
+    status_events_post_motion(10, 100);
+    status_events_post_motion(30, 120);
+    status_events_post_motion(0, 120);
+    status_events_post_motion(20, 100);
+    int count = next_events(&sub, events, 1000);
+    CHECK(count == 3);
+    if (count == 3) {
+        CHECK(strcmp(events[0].name, "mode") == 0);
+        CHECK(strcmp(events[0].data, "{\"mode\":\"stream\"}") == 0);
+        CHECK(strcmp(events[1].name, "capture") == 0);
+        CHECK(strcmp(events[1].data, "{\"captures\":10,\"new\":3,\"len\":81234,"
+                                     "\"still_ms\":182}") == 0);
+        CHECK(strcmp(events[2].name, "motion") == 0);
+        CHECK(strcmp(events[2].data, "{\"frames\":3,\"changed\":30,\"total\":120}") == 0);
+    }
+
+    // Health: small RSSI moves are held back until they add up to a step
+    UPDATE(s_rssi = -57);
+    CHECK(next_events(&sub, events, QUIET_MS) == 0);
+    UPDATE(s_rssi = -58);
+    CHECK(next_events(&sub, events, 1000) == 1);
+    CHECK(strcmp(events[0].name, "health") == 0);
+    CHECK(strncmp(events[0].data, "{\"rssi\":-58,", 12) == 0);
+    UPDATE(s_rssi = -56);
+    CHECK(next_events(&sub, events, QUIET_MS) == 0);
+
+    close(sub.fd);
+}
+
+static void test_subscribers(void)
+{
+    sub_t subs[STATUS_EVENTS_MAX_CLIENTS + 1];
+    event_t state, events[MAX_EVENTS];
+    status_events_stats_t stats;
+
+    // The previous tests' subscribers are gone once a tick noticed
+    usleep(3 * TICK_MS * 1000);
+    status_events_get_stats(&stats);
+    CHECK(stats.clients == 0);
+    CHECK(s_closed == 2 && s_completed == 2);
+
+    for (int i = 0; i < STATUS_EVENTS_MAX_CLIENTS; i++) {
+        open_stream(&subs[i], &state);
+    }
+    CHECK(!subscribe(&subs[STATUS_EVENTS_MAX_CLIENTS]));
+
+    // Every subscriber gets the same delta
+    UPDATE(s_stats.stills++);
+    for (int i = 0; i < STATUS_EVENTS_MAX_CLIENTS; i++) {
+        CHECK(next_events(&subs[i], events, 1000) == 1);
+        CHECK(strcmp(events[0].name, "capture") == 0);
+    }
+
+    // One leaves; the rest carry on and its slot is free again
+    close(subs[1].fd);
+    usleep(3 * TICK_MS * 1000);
+    UPDATE(s_stats.stills++);
+    CHECK(next_events(&subs[0], events, 1000) == 1);
+    CHECK(next_events(&subs[2], events, 1000) == 1);
+    status_events_get_stats(&stats);
+    CHECK(stats.clients == STATUS_EVENTS_MAX_CLIENTS - 1);
+    open_stream(&subs[1], &state);
+
+    for (int i = 0; i < STATUS_EVENTS_MAX_CLIENTS; i++) {
+        close(subs[i].fd);
+    }
+    usleep(3 * TICK_MS * 1000);
+    status_events_get_stats(&stats);
+    CHECK(stats.clients == 0);
+}
+
+static void test_widest(void)
+{
+    sub_t sub;
+    event_t state, events[MAX_EVENTS];
+    char msg[4096];
+    bool retry;
+
+    open_stream(&sub, &state);
+    widest_tick();
+    size_t len = read_msg(sub.fd, msg, sizeof(msg), 1000);
+    CHECK(parse_events(msg, events, MAX_EVENTS, &retry) == 5);
+
+    // The stub heap reads 0; real free sizes are up to 10 digits
+    CHECK(len + 4 * 9 < 1024);
+    printf("Widest tick: %zu bytes of a 1024 byte message\n", len);
+
+    close(sub.fd);
+}
+
+#endif
+
+int main(void)
+{
+    signal(SIGPIPE, SIG_IGN);
+    CHECK(status_events_init() == ESP_OK);
+
+#ifdef STATUS_EVENTS_MSG_SIZE
+    test_truncation();
+    return host_test_result("test_status_events_small");
+#else
+    test_state();
+    test_deltas();
+    test_subscribers();
+    test_widest();
+    return host_test_result("test_status_events");
+#endif
+}
@@ -0,0 +1,266 @@
+/**
+ * @file test_task_stats.c
+ * @brief Task statistics on a scripted scheduler
+ *
+ * uxTaskGetSystemState() reports a task table the test advances by hand;
+ * the sampler task runs one period per step() call, and steps are a few
+ * milliseconds apart so the window length is measurable. Checks CPU shares
+ * over windows of different lengths (across a counter wrap), per-core load
+ * from the idle tasks, the order of the rows, the clamp to the samples
+ * taken and to the ring, and the cap at TASK_STATS_MAX_TASKS.
+ */
+
+#include "host_test.h"
+#include "diag/task_stats.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#define STEP_MS     20
+#define MAX_SCRIPT  (TASK_STATS_MAX_TASKS + 1)
+
+typedef struct {
+    char name[configMAX_TASK_NAME_LEN];
+    int core;
+    eTaskState state;
+    uint32_t runtime;
+    StackType_t *stack;
+} script_task_t;
+
+static script_task_t s_tasks[MAX_SCRIPT];
+static int s_task_count;
+static uint32_t s_total;
+static SemaphoreHandle_t s_tick;
+static SemaphoreHandle_t s_parked;
+
+UBaseType_t uxTaskGetSystemState(TaskStatus_t *status, UBaseType_t count,
+                                 configRUN_TIME_COUNTER_TYPE *total)
+{
+    if ((UBaseType_t)s_task_count > count) {
+        return 0;
+    }
+    for (int i = 0; i < s_task_count; i++) {
+        status[i] = (TaskStatus_t){
+            .pcTaskName = s_tasks[i].name,
+            .xTaskNumber = i + 1,
+            .eCurrentState = s_tasks[i].state,
+            .uxCurrentPriority = 5,
+            .ulRunTimeCounter = s_tasks[i].runtime,
+            .pxStackBase = s_tasks[i].stack,
+            .usStackHighWaterMark = 1000 + i,
+            .xCoreID = s_tasks[i].core,
+        };
+    }
+    *total = s_total;
+    return s_task_count;
+}
+
+/**
+ * @brief The sampler's period: park until the test asks for a sample
+ */
+void vTaskDelayUntil(TickType_t *wake, TickType_t ticks)
+{
+    xSemaphoreGive(s_parked);
+    xSemaphoreTake(s_tick, portMAX_DELAY);
+}
+
+static int add_task(const char *name, int core)
+{
+    script_task_t *t = &s_tasks[s_task_count];
+
+    snprintf(t->name, sizeof(t->name), "%s", name);
+    t->core = core;
+    t->state = eBlocked;
+    return s_task_count++;
+}
+
+/**
+ * @brief One period: the total counter and the given tasks advance, then a sample
+ *
+ * @param used Run time per task, in the order the tasks were added
+ */
+static void step(const uint32_t *used)
+{
+    for (int i = 0; i < s_task_count; i++) {
+        s_tasks[i].runtime += used[i];
+    }
+    s_total += 1000000;
+    usleep(STEP_MS * 1000);
+    xSemaphoreGive(s_tick);
+    xSemaphoreTake(s_parked, portMAX_DELAY);
+}
+
+static const task_stats_row_t *find(const task_stats_row_t *rows, int n, const char *name)
+{
+    for (int i = 0; i < n; i++) {
+        if (strcmp(rows[i].name, name) == 0) {
+            return &rows[i];
+        }
+    }
+    return NULL;
+}
+
+static bool window_about(const task_stats_summary_t *summary, int steps)
+{
+    return summary->window_ms >= (uint32_t)(steps * STEP_MS) &&
+           summary->window_ms < (uint32_t)(steps * STEP_MS + 200);
+}
+
+static void test_window(void)
+{
+    task_stats_row_t rows[TASK_STATS_MAX_TASKS];
+    task_stats_summary_t summary;
+
+    add_task("IDLE0", 0);
+    int idle1 = add_task("IDLE1", 1);
+    int cam = add_task("camera", 0);
+    int web = add_task("httpd", tskNO_AFFINITY);
+    // Both counters wrap within the first steps
+    s_total = UINT32_MAX - 1500000;
+    s_tasks[idle1].runtime = UINT32_MAX - 500000;
+    s_tasks[web].stack = (StackType_t *)0x3c100000;
+    s_tasks[cam].state = eRunning;
+
+    CHECK(task_stats_init() == ESP_OK);
+    xSemaphoreTake(s_parked, portMAX_DELAY);
+    // One sample is no window yet
+    CHECK(task_stats_get(5, rows, TASK_STATS_MAX_TASKS, &summary) == ESP_ERR_INVALID_STATE);
+
+    // Four quiet periods, then two busy ones with a task started in the last
+    static const uint32_t quiet[] = { 900000, 1000000, 100000, 0 };
+    static const uint32_t busy[] = { 400000, 750000, 600000, 250000, 50000 };
+    for (int i = 0; i < 4; i++) {
+        step(quiet);
+    }
+    step(busy);
+    int ota = add_task("ota", 1);
+    s_tasks[ota].state = eReady;
+    step(busy);
+
+    // The last period
+    CHECK(task_stats_get(1, rows, TASK_STATS_MAX_TASKS, &summary) == ESP_OK);
+    CHECK(summary.tasks == 5 && summary.tasks_total == 5);
+    CHECK(window_about(&summary, 1));
+    CHECK(summary.core_load_permille[0] == 600 && summary.core_load_permille[1] == 250);
+    CHECK(rows[0].cpu_permille == 750 && strcmp(rows[0].name, "IDLE1") == 0);
+    CHECK(strcmp(rows[1].name, "camera") == 0 && rows[1].cpu_permille == 600);
+    CHECK(strcmp(rows[2].name, "IDLE0") == 0 && rows[2].cpu_permille == 400);
+    CHECK(strcmp(rows[3].name, "httpd") == 0 && rows[3].cpu_permille == 250);
+    // New within the window: all its run time counts
+    CHECK(strcmp(rows[4].name, "ota") == 0 && rows[4].cpu_permille == 50);
+    for (int i = 1; i < summary.tasks; i++) {
+        CHECK(rows[i - 1].cpu_permille >= rows[i].cpu_permille);
+    }
+
+    // The other fields
+    const task_stats_row_t *row = find(rows, summary.tasks, "httpd");
+    CHECK(row && row->core == -1 && row->state == 'B' && row->stack_in_psram);
+    CHECK(row && row->priority == 5 && row->stack_free_min == 1000 + (uint32_t)web);
+    row = find(rows, summary.tasks, "camera");
+    CHECK(row && row->core == 0 && row->state == 'X' && !row->stack_in_psram);
+    row = find(rows, summary.tasks, "ota");
+    CHECK(row && row->core == 1 && row->state == 'R');
+
+    // Three periods: one quiet, two busy
+    CHECK(task_stats_get(3, rows, TASK_STATS_MAX_TASKS, &summary) == ESP_OK);
+    CHECK(window_about(&summary, 3));
+    CHECK(find(rows, summary.tasks, "camera")->cpu_permille == 433);
+    CHECK(find(rows, summary.tasks, "ota")->cpu_permille == 16);
+    CHECK(summary.core_load_permille[0] == 1000 - 566);
+    CHECK(summary.core_load_permille[1] == 1000 - 833);
+
+    // Longer than the samples so far: the six periods there are
+    CHECK(task_stats_get(100, rows, TASK_STATS_MAX_TASKS, &summary) == ESP_OK);
+    CHECK(window_about(&summary, 6));
+    CHECK(find(rows, summary.tasks, "camera")->cpu_permille == 266);
+    CHECK(summary.core_load_permille[0] == 1000 - 733);
+
+    // Shorter than one period is one period
+    CHECK(task_stats_get(0, rows, TASK_STATS_MAX_TASKS, &summary) == ESP_OK);
+    CHECK(window_about(&summary, 1));
+    CHECK(summary.core_load_permille[0] == 600);
+}
+
+static void test_ring(void)
+{
+    task_stats_row_t rows[TASK_STATS_MAX_TASKS];
+    task_stats_summary_t summary;
+    uint32_t used[MAX_SCRIPT] = { 0 };
+
+    // Past the ring: the window stops at CONFIG_GROWPOD_TASK_STATS_WINDOW_S
+    // periods, all of them in this phase
+    used[2] = 200000;
+    for (int i = 0; i < CONFIG_GROWPOD_TASK_STATS_WINDOW_S + 3; i++) {
+        step(used);
+    }
+    CHECK(task_stats_get(100, rows, TASK_STATS_MAX_TASKS, &summary) == ESP_OK);
+    CHECK(window_about(&summary, CONFIG_GROWPOD_TASK_STATS_WINDOW_S));
+    CHECK(find(rows, summary.tasks, "camera")->cpu_permille == 200);
+    CHECK(task_stats_get(CONFIG_GROWPOD_TASK_STATS_WINDOW_S - 1, rows,
+                         TASK_STATS_MAX_TASKS, &summary) == ESP_OK);
+    CHECK(window_about(&summary, CONFIG_GROWPOD_TASK_STATS_WINDOW_S - 1));
+    // Idle tasks that did not run: both cores fully loaded
+    CHECK(summary.core_load_permille[0] == 1000 && summary.core_load_permille[1] == 1000);
+}
+
+static void test_row_cap(void)
+{
+    task_stats_row_t rows[TASK_STATS_MAX_TASKS];
+    task_stats_summary_t summary;
+    uint32_t used[MAX_SCRIPT];
+    char name[configMAX_TASK_NAME_LEN];
+
+    // Exactly as many tasks as are tracked
+    while (s_task_count < TASK_STATS_MAX_TASKS) {
+        snprintf(name, sizeof(name), "t%02d", s_task_count);
+        add_task(name, tskNO_AFFINITY);
+    }
+    for (int i = 0; i < MAX_SCRIPT; i++) {
+        used[i] = 1000 * i;
+    }
+    step(used);
+    CHECK(task_stats_get(1, rows, TASK_STATS_MAX_TASKS, &summary) == ESP_OK);
+    CHECK(summary.tasks == TASK_STATS_MAX_TASKS && summary.tasks_total == TASK_STATS_MAX_TASKS);
+    CHECK(rows[0].cpu_permille == 39 && strcmp(rows[0].name, "t39") == 0);
+
+    // Fewer rows than tasks: the rows fill, the total still counts them all
+    CHECK(task_stats_get(1, rows, 8, &summary) == ESP_OK);
+    CHECK(summary.tasks == 8 && summary.tasks_total == TASK_STATS_MAX_TASKS);
+
+    // One task more: the sample is skipped and the last one stands
+    add_task("t40", tskNO_AFFINITY);
+    step(used);
+    CHECK(task_stats_get(1, rows, TASK_STATS_MAX_TASKS, &summary) == ESP_OK);
+    CHECK(summary.tasks == TASK_STATS_MAX_TASKS && summary.tasks_total == TASK_STATS_MAX_TASKS);
+    CHECK(window_about(&summary, 1));
+    CHECK(find(rows, summary.tasks, "t40") == NULL);
+    CHECK(rows[0].cpu_permille == 39);
+
+    // Sampling goes on once it is gone; the two samples either side of the
+    // skipped one span three periods
+    s_task_count--;
+    step(used);
+    CHECK(task_stats_get(2, rows, TASK_STATS_MAX_TASKS, &summary) == ESP_OK);
+    CHECK(summary.tasks == TASK_STATS_MAX_TASKS);
+    CHECK(window_about(&summary, 3));
+    CHECK(rows[0].cpu_permille == 39 && rows[0].stack_free_min == 1039);
+}
+
+int main(void)
+{
+    task_stats_row_t rows[1];
+    task_stats_summary_t summary;
+
+    s_tick = xSemaphoreCreateBinary();
+    s_parked = xSemaphoreCreateBinary();
+    // Not started
+    CHECK(task_stats_get(5, rows, 1, &summary) == ESP_ERR_INVALID_STATE);
+
+    test_window();
+    test_ring();
+    test_row_cap();
+    return host_test_result("test_task_stats");
+}
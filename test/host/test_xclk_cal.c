@@ -0,0 +1,347 @@
+/**
+ * @file test_xclk_cal.c
+ * @brief Sensor clock calibration on synthetic frame timestamps
+ *
+ * Timestamps come from a model of the sensor and the DVP bus: the frame
+ * interval follows XCLK down to the sensor's top frame rate, and frames
+ * that would carry more data than the bus moves are dropped. Checks the
+ * median interval and the lost, truncated and skipped frame counts, the
+ * stability limit and the 3% margin, the clock chosen per framesize in a
+ * full run, a framesize that overruns at every clock, and the table's
+ * round trip through a fake NVS.
+ */
+
+#include "host_test.h"
+#include "camera/xclk_cal.h"
+#include "camera/camera.h"
+#include "nvs.h"
+#include <string.h>
+
+#define FRAMES          48
+#define T0_US           1000000
+
+// What the bus moves before the DMA falls behind
+#define BUS_BYTES_PER_S 2500000
+
+// Sensor frame interval at 20 MHz and JPEG size, by size index
+static const struct {
+    uint32_t interval_us;
+    uint32_t jpeg_bytes;
+} MODEL[XCLK_CAL_SIZES] = {
+    { 30000,  8000 },           // QVGA: at the sensor's top rate already
+    { 33333,  20000 },          // VGA
+    { 40000,  30000 },          // SVGA
+    { 50000,  45000 },          // XGA
+    { 66667,  150000 },         // SXGA: overruns at 24 MHz
+    { 66667,  190000 },         // UXGA: overruns from 20 MHz
+    { 133333, 700000 },         // QXGA: overruns at every clock
+};
+
+// Top frame rate, whatever the clock
+#define MIN_INTERVAL_US 30000
+
+// One blob; xclk_cal keeps its table under a single key
+static uint8_t s_nvs[1024];
+static size_t s_nvs_len;
+static bool s_nvs_fail;
+
+esp_err_t nvs_open(const char *namespace_name, nvs_open_mode_t open_mode, nvs_handle_t *out_handle)
+{
+    CHECK(strcmp(namespace_name, "xclk_cal") == 0);
+    *out_handle = 1;
+    return s_nvs_fail ? ESP_FAIL : ESP_OK;
+}
+
+void nvs_close(nvs_handle_t handle)
+{
+}
+
+esp_err_t nvs_get_blob(nvs_handle_t handle, const char *key, void *out_value, size_t *length)
+{
+    if (s_nvs_len == 0) {
+        return ESP_ERR_NVS_NOT_FOUND;
+    }
+    CHECK(*length >= s_nvs_len);
+    memcpy(out_value, s_nvs, s_nvs_len);
+    *length = s_nvs_len;
+    return ESP_OK;
+}
+
+esp_err_t nvs_set_blob(nvs_handle_t handle, const char *key, const void *value, size_t length)
+{
+    CHECK(length <= sizeof(s_nvs));
+    memcpy(s_nvs, value, length);
+    s_nvs_len = length;
+    return ESP_OK;
+}
+
+esp_err_t nvs_erase_key(nvs_handle_t handle, const char *key)
+{
+    if (s_nvs_len == 0) {
+        return ESP_ERR_NVS_NOT_FOUND;
+    }
+    s_nvs_len = 0;
+    return ESP_OK;
+}
+
+esp_err_t nvs_commit(nvs_handle_t handle)
+{
+    return ESP_OK;
+}
+
+/**
+ * @brief Evenly spaced timestamps with a little jitter
+ */
+static void steady(int64_t *stamps, int count, uint32_t interval_us)
+{
+    for (int i = 0; i < count; i++) {
+        stamps[i] = T0_US + (int64_t)i * interval_us + (i % 3 - 1) * (int64_t)interval_us / 200;
+    }
+}
+
+/**
+ * @brief Timestamps as the model delivers them for one size and clock
+ *
+ * The share of frames over the bus's rate is dropped, spread evenly, and
+ * the frame after each drop arrives truncated: the DMA overflowed inside
+ * it. Past half the frames dropped, the gaps alone would read as a slower
+ * sensor; the truncated frames are what give an overrun away.
+ *
+ * @param truncated Receives the frames delivered truncated
+ * @return Frames the bus dropped on the way
+ */
+static int model_frames(int size, int clock, int64_t *stamps, int *truncated)
+{
+    uint32_t hz = xclk_cal_clock_hz(clock);
+    uint32_t interval = (uint32_t)((uint64_t)MODEL[size].interval_us * CAMERA_XCLK_DEFAULT_HZ / hz);
+    if (interval < MIN_INTERVAL_US) {
+        interval = MIN_INTERVAL_US;
+    }
+    uint64_t rate = (uint64_t)MODEL[size].jpeg_bytes * 1000000 / interval;
+    uint64_t over = rate > BUS_BYTES_PER_S ? rate - BUS_BYTES_PER_S : 0;
+
+    int n = 0, dropped = 0;
+    bool after_drop = false;
+    *truncated = 0;
+    for (int slot = 0; n < FRAMES; slot++) {
+        if ((slot + 1) * over / rate > slot * over / rate) {
+            dropped++;
+            after_drop = true;
+            continue;
+        }
+        stamps[n++] = T0_US + (int64_t)slot * interval + (slot % 3 - 1) * (int64_t)interval / 200;
+        *truncated += after_drop;
+        after_drop = false;
+    }
+    return dropped;
+}
+
+static void test_measure(void)
+{
+    int64_t stamps[100];
+    xclk_cal_point_t point;
+
+    // Steady: the interval despite the jitter, no errors
+    steady(stamps, FRAMES, 50000);
+    xclk_cal_measure(stamps, FRAMES, 0, &point);
+    CHECK(point.measured && point.error_permille == 0);
+    CHECK(point.interval_us >= 49500 && point.interval_us <= 50500);
+
+    // A gap of three intervals hides two frames: 2 of 32 slots
+    steady(stamps, 30, 50000);
+    for (int i = 10; i < 30; i++) {
+        stamps[i] += 100000;
+    }
+    xclk_cal_measure(stamps, 30, 0, &point);
+    CHECK(point.interval_us >= 49500 && point.interval_us <= 50500);
+    CHECK(point.error_permille == 2 * 1000 / 32);
+
+    // Timeouts are lost frames and break the chain, without a gap
+    steady(stamps, 30, 50000);
+    stamps[5] = 0;
+    stamps[6] = 0;
+    xclk_cal_measure(stamps, 30, 0, &point);
+    CHECK(point.interval_us >= 49500 && point.interval_us <= 50500);
+    CHECK(point.error_permille == 2 * 1000 / 30);
+
+    // Truncated frames count against the slots seen
+    steady(stamps, 60, 50000);
+    xclk_cal_measure(stamps, 60, 1, &point);
+    CHECK(point.error_permille == 1000 / 60);
+    xclk_cal_measure(stamps, 60, 3, &point);
+    CHECK(point.error_permille == 3 * 1000 / 60);
+
+    // Only the first XCLK_CAL_MAX_FRAMES are looked at: the gap after them is not
+    steady(stamps, 100, 40000);
+    for (int i = XCLK_CAL_MAX_FRAMES; i < 100; i++) {
+        stamps[i] += 400000;
+    }
+    xclk_cal_measure(stamps, 100, 0, &point);
+    CHECK(point.error_permille == 0 && point.interval_us >= 39600 && point.interval_us <= 40400);
+
+    // Nothing to measure: every grab timed out, one frame, or none
+    memset(stamps, 0, sizeof(stamps));
+    xclk_cal_measure(stamps, FRAMES, 0, &point);
+    CHECK(point.measured && point.interval_us == 0 && point.error_permille == 1000);
+    steady(stamps, 1, 50000);
+    xclk_cal_measure(stamps, 1, 0, &point);
+    CHECK(point.interval_us == 0 && point.error_permille == 1000);
+    xclk_cal_measure(stamps, 0, 0, &point);
+    CHECK(point.interval_us == 0 && point.error_permille == 1000);
+
+    // More errors than slots saturate
+    steady(stamps, 10, 50000);
+    xclk_cal_measure(stamps, 10, 20, &point);
+    CHECK(point.error_permille == 1000);
+}
+
+static void test_pick(void)
+{
+    xclk_cal_point_t points[XCLK_CAL_CLOCKS] = {
+        { .interval_us = 200000, .measured = true },
+        { .interval_us = 125000, .measured = true },
+        { .interval_us = 100000, .measured = true },
+        { .interval_us = 83333, .measured = true },
+    };
+
+    CHECK(xclk_cal_pick(points) == 3);
+
+    // At the limit is stable, one more is not
+    points[3].error_permille = XCLK_CAL_MAX_ERR_PERMILLE;
+    CHECK(xclk_cal_pick(points) == 3);
+    points[3].error_permille = XCLK_CAL_MAX_ERR_PERMILLE + 1;
+    CHECK(xclk_cal_pick(points) == 2);
+
+    // Within 3% of a slower clock is not worth the bus load; just over is
+    points[3].error_permille = 0;
+    points[3].interval_us = 97001;
+    CHECK(xclk_cal_pick(points) == 2);
+    points[3].interval_us = 96999;
+    CHECK(xclk_cal_pick(points) == 3);
+
+    // Unmeasured and frameless points are passed over
+    points[3].measured = false;
+    points[2].interval_us = 0;
+    CHECK(xclk_cal_pick(points) == 1);
+
+    // Nothing stable
+    for (int c = 0; c < XCLK_CAL_CLOCKS; c++) {
+        points[c] = (xclk_cal_point_t){ .interval_us = 100000, .error_permille = 500,
+                                        .measured = true };
+    }
+    CHECK(xclk_cal_pick(points) == -1);
+}
+
+/**
+ * @brief A full calibration run on the model, as the camera service drives it
+ */
+static esp_err_t run(void)
+{
+    int64_t stamps[FRAMES];
+    int done;
+
+    xclk_cal_begin();
+    for (int size = 0; size < XCLK_CAL_SIZES; size++) {
+        for (int clock = 0; clock < XCLK_CAL_CLOCKS; clock++) {
+            xclk_cal_point_t point;
+            int truncated;
+            model_frames(size, clock, stamps, &truncated);
+            xclk_cal_measure(stamps, FRAMES, truncated, &point);
+            point.jpeg_bytes = MODEL[size].jpeg_bytes;
+            xclk_cal_record(size, clock, &point);
+            CHECK(xclk_cal_progress(&done) && done == size * XCLK_CAL_CLOCKS + clock + 1);
+        }
+    }
+    esp_err_t err = xclk_cal_finish();
+    CHECK(!xclk_cal_progress(&done) && done == XCLK_CAL_POINTS);
+    return err;
+}
+
+static void test_run(void)
+{
+    static const uint32_t expect_hz[XCLK_CAL_SIZES] = {
+        20000000,       // QVGA: 24 MHz is no faster at the top frame rate
+        24000000, 24000000, 24000000,
+        20000000,       // SXGA
+        16000000,       // UXGA
+        0,              // QXGA: no stable clock
+    };
+    xclk_cal_entry_t entry;
+    int64_t stamps[FRAMES];
+    int quality;
+
+    // Nothing saved: the default clock for every framesize
+    CHECK(xclk_cal_init() == ESP_ERR_NVS_NOT_FOUND);
+    for (int size = 0; size < XCLK_CAL_SIZES; size++) {
+        CHECK(xclk_cal_get(xclk_cal_framesize(size, &quality)) == CAMERA_XCLK_DEFAULT_HZ);
+        CHECK(!xclk_cal_entry(size, &entry) && entry.xclk_hz == 0);
+        CHECK(entry.framesize == xclk_cal_framesize(size, &quality) && entry.quality == quality);
+    }
+
+    // The model drops frames where it should
+    int truncated;
+    CHECK(model_frames(0, 3, stamps, &truncated) == 0 && truncated == 0);
+    CHECK(model_frames(5, 2, stamps, &truncated) > 0 && truncated > 0);
+    CHECK(model_frames(5, 1, stamps, &truncated) == 0);
+    for (int clock = 0; clock < XCLK_CAL_CLOCKS; clock++) {
+        CHECK(model_frames(6, clock, stamps, &truncated) > 0);
+    }
+
+    CHECK(run() == ESP_OK);
+    for (int size = 0; size < XCLK_CAL_SIZES; size++) {
+        framesize_t framesize = xclk_cal_framesize(size, &quality);
+        CHECK(xclk_cal_entry(size, &entry));
+        CHECK(entry.framesize == framesize && entry.quality == quality);
+        CHECK(entry.xclk_hz == expect_hz[size]);
+        CHECK(xclk_cal_get(framesize) == (expect_hz[size] ? expect_hz[size] : CAMERA_XCLK_DEFAULT_HZ));
+        CHECK(entry.points[0].jpeg_bytes == MODEL[size].jpeg_bytes);
+    }
+
+    // The all-overrun size: every point measured, every one over the limit
+    CHECK(xclk_cal_entry(6, &entry));
+    for (int clock = 0; clock < XCLK_CAL_CLOCKS; clock++) {
+        CHECK(entry.points[clock].measured && entry.points[clock].interval_us > 0);
+        CHECK(entry.points[clock].error_permille > XCLK_CAL_MAX_ERR_PERMILLE);
+    }
+    // Uncalibrated framesizes keep the default
+    CHECK(xclk_cal_get(FRAMESIZE_HD) == CAMERA_XCLK_DEFAULT_HZ);
+}
+
+static void test_nvs(void)
+{
+    xclk_cal_entry_t entry;
+    int quality;
+
+    // Saved by the run, loaded back as is
+    CHECK(s_nvs_len > 0);
+    CHECK(xclk_cal_init() == ESP_OK);
+    CHECK(xclk_cal_get(xclk_cal_framesize(5, &quality)) == 16000000);
+
+    // A table from another layout is ignored
+    s_nvs[0]++;
+    CHECK(xclk_cal_init() == ESP_ERR_INVALID_VERSION);
+    s_nvs[0]--;
+
+    // Cleared in memory and in NVS; clearing twice is fine
+    CHECK(xclk_cal_clear() == ESP_OK);
+    CHECK(s_nvs_len == 0);
+    CHECK(xclk_cal_get(xclk_cal_framesize(5, &quality)) == CAMERA_XCLK_DEFAULT_HZ);
+    CHECK(!xclk_cal_entry(5, &entry));
+    CHECK(xclk_cal_clear() == ESP_OK);
+    CHECK(xclk_cal_init() == ESP_ERR_NVS_NOT_FOUND);
+
+    // A failed save still leaves the new table in use
+    s_nvs_fail = true;
+    CHECK(run() == ESP_FAIL);
+    CHECK(xclk_cal_get(xclk_cal_framesize(5, &quality)) == 16000000);
+    s_nvs_fail = false;
+}
+
+int main(void)
+{
+    test_measure();
+    test_pick();
+    test_run();
+    test_nvs();
+    return host_test_result("test_xclk_cal");
+}